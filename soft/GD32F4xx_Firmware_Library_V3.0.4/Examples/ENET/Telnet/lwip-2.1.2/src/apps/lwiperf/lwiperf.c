@@ -9,10 +9,13 @@
  *
  * This is a simple performance measuring client/server to check your bandwith using
  * iPerf2 on a PC as server/client.
- * It is currently a minimal implementation providing a TCP client/server only.
+ * It implements TCP and UDP tests (UDP only if LWIP_UDP is enabled), parallel
+ * streams, simultaneous/individual bidirectional tests and reverse tests.
+ * Next to the legacy report function, an extended report function can be used
+ * that gets interval reports, UDP loss/jitter, CPU load and pbuf/heap high-water
+ * marks.
  *
  * @todo:
- * - implement UDP mode
  * - protect combined sessions handling (via 'related_master_state') against reallocation
  *   (this is a pointer address, currently, so if the same memory is allocated again,
  *    session pairs (tx/rx) can be confused on reallocation)
@@ -52,11 +55,14 @@
 #include "lwip/apps/lwiperf.h"
 
 #include "lwip/tcp.h"
+#include "lwip/udp.h"
 #include "lwip/sys.h"
+#include "lwip/timeouts.h"
+#include "lwip/stats.h"
 
 #include <string.h>
 
-/* Currently, only TCP is implemented */
+/* TCP is always needed, UDP tests are only available with LWIP_UDP */
 #if LWIP_TCP && LWIP_CALLBACK_API
 
 /** Specify the idle timeout (in seconds) after that the test fails */
@@ -67,6 +73,39 @@
 #error LWIPERF_TCP_MAX_IDLE_SEC must fit into an u8_t
 #endif
 
+/** Specify the idle timeout (in seconds) after that a UDP server session fails */
+#ifndef LWIPERF_UDP_MAX_IDLE_SEC
+#define LWIPERF_UDP_MAX_IDLE_SEC    10U
+#endif
+
+/** Period (in milliseconds) at which UDP clients send the datagrams that are due */
+#ifndef LWIPERF_UDP_TX_INTERVAL_MS
+#define LWIPERF_UDP_TX_INTERVAL_MS  1U
+#endif
+
+/** Number of times a UDP client sends the final datagram while waiting for
+ * the server report, and the interval (in milliseconds) between retries */
+#ifndef LWIPERF_UDP_FIN_RETRIES
+#define LWIPERF_UDP_FIN_RETRIES     10U
+#endif
+#ifndef LWIPERF_UDP_FIN_INTERVAL_MS
+#define LWIPERF_UDP_FIN_INTERVAL_MS 250U
+#endif
+
+/** Microsecond clock used to timestamp UDP datagrams (for jitter, may wrap).
+ * Define this to a timer based clock to get sub-millisecond jitter values.
+ */
+#ifndef LWIPERF_TIME_US
+#define LWIPERF_TIME_US()           (sys_now() * 1000U)
+#endif
+
+/* Define LWIPERF_IDLE_TIME_MS() to a function returning the number of
+ * milliseconds the CPU has been idle (e.g. counted in the idle task) to get
+ * the CPU load of a test reported. No port in this tree provides it, so there
+ * is no default: without it, every report carries LWIPERF_CPU_LOAD_UNKNOWN
+ * (0xFF) instead of a load value, never a (misleading) 0.
+ */
+
 /** Change this if you don't want to lwiperf to listen to any IP version */
 #ifndef LWIPERF_SERVER_IP_TYPE
 #define LWIPERF_SERVER_IP_TYPE      IPADDR_TYPE_ANY
@@ -89,13 +128,39 @@ typedef struct _lwiperf_settings {
 #define LWIPERF_FLAGS_ANSWER_TEST 0x80000000
 #define LWIPERF_FLAGS_ANSWER_NOW  0x00000001
   u32_t flags;
-  u32_t num_threads; /* unused for now */
+  u32_t num_threads;
   u32_t remote_port;
-  u32_t buffer_len; /* unused for now */
-  u32_t win_band; /* TCP window / UDP rate: unused for now */
+  u32_t buffer_len; /* UDP datagram length, unused for TCP */
+  u32_t win_band; /* TCP window (unused) / UDP rate in bits per second */
   u32_t amount; /* pos. value: bytes?; neg. values: time (unit is 10ms: 1/100 second) */
 } lwiperf_settings_t;
 
+/** Header in front of every UDP datagram (followed by the settings) */
+typedef struct _lwiperf_udp_hdr {
+  s32_t id; /* negative for the final datagram */
+  u32_t tv_sec;
+  u32_t tv_usec;
+} lwiperf_udp_hdr_t;
+
+/** Report returned by the UDP server for the final datagram */
+typedef struct _lwiperf_udp_server_report {
+#define LWIPERF_UDP_REPORT_VERSION1 0x80000000
+  u32_t flags;
+  u32_t total_len1;
+  u32_t total_len2;
+  u32_t stop_sec;
+  u32_t stop_usec;
+  u32_t error_cnt;
+  u32_t outorder_cnt;
+  u32_t datagrams;
+  u32_t jitter1;
+  u32_t jitter2;
+} lwiperf_udp_server_report_t;
+
+#define LWIPERF_UDP_HDR_LEN         (sizeof(lwiperf_udp_hdr_t) + sizeof(lwiperf_settings_t))
+#define LWIPERF_UDP_DEFAULT_LEN     1470U
+#define LWIPERF_UDP_DEFAULT_RATE    1000000U
+
 /** Basic connection handle */
 struct _lwiperf_state_base;
 typedef struct _lwiperf_state_base lwiperf_state_base_t;
@@ -106,8 +171,24 @@ struct _lwiperf_state_base {
   u8_t tcp;
   /* 1=server, 0=client */
   u8_t server;
+  /* 1=listener (no test running on this handle) */
+  u8_t listener;
+  /* stream index for parallel tests */
+  u8_t stream;
   /* master state used to abort sessions (e.g. listener, main client) */
   lwiperf_state_base_t *related_master_state;
+  /* reporting */
+  lwiperf_report_fn report_fn;
+  lwiperf_report_ext_fn report_ext_fn;
+  void *report_arg;
+  u32_t time_started;
+  u32_t bytes_transferred;
+  u32_t interval_ms;
+  u32_t interval_time;
+  u32_t interval_bytes;
+#ifdef LWIPERF_IDLE_TIME_MS
+  u32_t idle_started;
+#endif
 };
 
 /** Connection handle for a TCP iperf session */
@@ -115,20 +196,51 @@ typedef struct _lwiperf_state_tcp {
   lwiperf_state_base_t base;
   struct tcp_pcb *server_pcb;
   struct tcp_pcb *conn_pcb;
-  u32_t time_started;
-  lwiperf_report_fn report_fn;
-  void *report_arg;
   u8_t poll_count;
   u8_t next_num;
-  /* 1=start server when client is closed */
-  u8_t client_tradeoff_mode;
-  u32_t bytes_transferred;
+  /* client: 1=only send the settings (reverse test) */
+  u8_t header_only;
+  /* listener of a client: connections left to accept */
+  u8_t accept_count;
   lwiperf_settings_t settings;
   u8_t have_settings_buf;
   u8_t specific_remote;
   ip_addr_t remote_addr;
 } lwiperf_state_tcp_t;
 
+#if LWIP_UDP
+/** Handle for a UDP iperf listener, server session or client */
+typedef struct _lwiperf_state_udp {
+  lwiperf_state_base_t base;
+  /* owned by listeners and clients, borrowed from the listener by server sessions */
+  struct udp_pcb *pcb;
+  /* server session: the listener this session was created by */
+  struct _lwiperf_state_udp *listener;
+  ip_addr_t remote_addr;
+  u16_t remote_port;
+  u16_t datagram_len;
+  /* client: 1=only send the settings (reverse test) */
+  u8_t header_only;
+  /* client: number of final datagrams sent, server: 1=final datagram received */
+  u8_t fin_count;
+  /* listener: 1=belongs to a client and only accepts tests from remote_addr */
+  u8_t specific_remote;
+  /* listener of a client: sessions left to accept */
+  u8_t accept_count;
+  s32_t next_id;
+  u32_t datagrams;
+  u32_t lost;
+  u32_t out_of_order;
+  /* jitter in us, scaled by 16 */
+  u32_t jitter;
+  u32_t last_transit;
+  u32_t last_rx;
+  /* duration until the final datagram */
+  u32_t ms_duration;
+  lwiperf_settings_t settings;
+} lwiperf_state_udp_t;
+#endif /* LWIP_UDP */
+
 /** List of active iperf sessions */
 static lwiperf_state_base_t *lwiperf_all_connections;
 /** A const buffer to send from: we want to measure sending, not copying! */
@@ -178,8 +290,10 @@ static const u8_t lwiperf_txbuf_const[1600] = {
 static err_t lwiperf_tcp_poll(void *arg, struct tcp_pcb *tpcb);
 static void lwiperf_tcp_err(void *arg, err_t err);
 static err_t lwiperf_start_tcp_server_impl(const ip_addr_t *local_addr, u16_t local_port,
-                                           lwiperf_report_fn report_fn, void *report_arg,
+                                           const lwiperf_state_base_t *report_from,
                                            lwiperf_state_base_t *related_master_state, lwiperf_state_tcp_t **state);
+static void lwiperf_conn_report(lwiperf_state_base_t *s, enum lwiperf_report_type report_type);
+static void lwiperf_close_silent(lwiperf_state_base_t *s);
 
 
 /** Add an iperf session to the 'active' list */
@@ -212,6 +326,7 @@ lwiperf_list_remove(lwiperf_state_base_t *item)
   }
 }
 
+#if LWIP_UDP
 static lwiperf_state_base_t *
 lwiperf_list_find(lwiperf_state_base_t *item)
 {
@@ -223,25 +338,150 @@ lwiperf_list_find(lwiperf_state_base_t *item)
   }
   return NULL;
 }
+#endif /* LWIP_UDP */
 
-/** Call the report function of an iperf tcp session */
+/** Count the running server sessions of a master (gives the stream index) */
+static u8_t
+lwiperf_list_count_sessions(lwiperf_state_base_t *master, u8_t tcp)
+{
+  lwiperf_state_base_t *iter;
+  u8_t count = 0;
+  for (iter = lwiperf_all_connections; iter != NULL; iter = iter->next) {
+    if ((iter->related_master_state == master) && (iter->tcp == tcp) &&
+        iter->server && !iter->listener) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/** Copy the reporting setup of a session to a new session */
 static void
-lwip_tcp_conn_report(lwiperf_state_tcp_t *conn, enum lwiperf_report_type report_type)
+lwiperf_base_init(lwiperf_state_base_t *s, const lwiperf_state_base_t *report_from)
 {
-  if ((conn != NULL) && (conn->report_fn != NULL)) {
-    u32_t now, duration_ms, bandwidth_kbitpsec;
-    now = sys_now();
-    duration_ms = now - conn->time_started;
-    if (duration_ms == 0) {
-      bandwidth_kbitpsec = 0;
+  s->stream = report_from->stream;
+  s->report_fn = report_from->report_fn;
+  s->report_ext_fn = report_from->report_ext_fn;
+  s->report_arg = report_from->report_arg;
+  s->interval_ms = report_from->interval_ms;
+}
+
+static u32_t
+lwiperf_bandwidth(u32_t bytes, u32_t duration_ms)
+{
+  if (duration_ms == 0) {
+    return 0;
+  }
+  return (bytes / duration_ms) * 8U;
+}
+
+/** Call the report function(s) of an iperf session. 'report' must have the
+ * addresses and UDP statistics filled in, the rest is done here.
+ */
+static void
+lwiperf_report(lwiperf_state_base_t *s, enum lwiperf_report_type report_type,
+               u32_t ms_duration, struct lwiperf_report *report)
+{
+  u32_t now = sys_now();
+
+  if ((report_type != LWIPERF_INTERVAL) && (s->report_fn != NULL)) {
+    s->report_fn(s->report_arg, report_type,
+                 report->local_addr, report->local_port,
+                 report->remote_addr, report->remote_port,
+                 s->bytes_transferred, ms_duration, lwiperf_bandwidth(s->bytes_transferred, ms_duration));
+  }
+  if (s->report_ext_fn == NULL) {
+    return;
+  }
+
+  report->report_type = report_type;
+  report->udp = (u8_t)!s->tcp;
+  report->stream = s->stream;
+  if (report_type == LWIPERF_INTERVAL) {
+    report->ms_start = s->interval_time - s->time_started;
+    report->ms_duration = now - s->interval_time;
+    report->bytes_transferred = s->bytes_transferred - s->interval_bytes;
+    s->interval_time = now;
+    s->interval_bytes = s->bytes_transferred;
+  } else {
+    report->ms_duration = ms_duration;
+    report->bytes_transferred = s->bytes_transferred;
+  }
+  report->bandwidth_kbitpsec = lwiperf_bandwidth(report->bytes_transferred, report->ms_duration);
+#ifdef LWIPERF_IDLE_TIME_MS
+  {
+    u32_t elapsed = now - s->time_started;
+    u32_t idle = (u32_t)LWIPERF_IDLE_TIME_MS() - s->idle_started;
+    if ((elapsed < 100) || (idle >= elapsed)) {
+      report->cpu_load = 0;
     } else {
-      bandwidth_kbitpsec = (conn->bytes_transferred / duration_ms) * 8U;
+      report->cpu_load = (u8_t)(100 - LWIP_MIN(100, idle / (elapsed / 100)));
     }
-    conn->report_fn(conn->report_arg, report_type,
-                    &conn->conn_pcb->local_ip, conn->conn_pcb->local_port,
-                    &conn->conn_pcb->remote_ip, conn->conn_pcb->remote_port,
-                    conn->bytes_transferred, duration_ms, bandwidth_kbitpsec);
   }
+#else
+  report->cpu_load = LWIPERF_CPU_LOAD_UNKNOWN;
+#endif
+#if MEMP_STATS
+  report->pbuf_pool_max = (u16_t)lwip_stats.memp[MEMP_PBUF_POOL]->max;
+  report->pbuf_max = (u16_t)lwip_stats.memp[MEMP_PBUF]->max;
+#endif
+#if MEM_STATS
+  report->mem_max = lwip_stats.mem.max;
+#endif
+  s->report_ext_fn(s->report_arg, report);
+}
+
+/** Timer callback for interval reports */
+static void
+lwiperf_interval_tmr(void *arg)
+{
+  lwiperf_state_base_t *s = (lwiperf_state_base_t *)arg;
+
+  lwiperf_conn_report(s, LWIPERF_INTERVAL);
+  sys_timeout(s->interval_ms, lwiperf_interval_tmr, s);
+}
+
+/** (Re-)start the statistics of a session when the test starts */
+static void
+lwiperf_stats_start(lwiperf_state_base_t *s)
+{
+  s->time_started = sys_now();
+  s->interval_time = s->time_started;
+  s->interval_bytes = s->bytes_transferred;
+#ifdef LWIPERF_IDLE_TIME_MS
+  s->idle_started = (u32_t)LWIPERF_IDLE_TIME_MS();
+#endif
+  /* high-water marks are global: concurrent tests share them */
+#if MEM_STATS
+  lwip_stats.mem.max = lwip_stats.mem.used;
+#endif
+#if MEMP_STATS
+  lwip_stats.memp[MEMP_PBUF_POOL]->max = lwip_stats.memp[MEMP_PBUF_POOL]->used;
+  lwip_stats.memp[MEMP_PBUF]->max = lwip_stats.memp[MEMP_PBUF]->used;
+#endif
+  if (s->interval_ms != 0) {
+    sys_untimeout(lwiperf_interval_tmr, s);
+    sys_timeout(s->interval_ms, lwiperf_interval_tmr, s);
+  }
+}
+
+/** Call the report function of an iperf tcp session */
+static void
+lwip_tcp_conn_report(lwiperf_state_tcp_t *conn, enum lwiperf_report_type report_type)
+{
+  struct lwiperf_report report;
+
+  if ((conn->conn_pcb == NULL) ||
+      ((conn->base.report_fn == NULL) && (conn->base.report_ext_fn == NULL))) {
+    /* listener or silent close */
+    return;
+  }
+  memset(&report, 0, sizeof(report));
+  report.local_addr = &conn->conn_pcb->local_ip;
+  report.local_port = conn->conn_pcb->local_port;
+  report.remote_addr = &conn->conn_pcb->remote_ip;
+  report.remote_port = conn->conn_pcb->remote_port;
+  lwiperf_report(&conn->base, report_type, sys_now() - conn->base.time_started, &report);
 }
 
 /** Close an iperf tcp session */
@@ -251,6 +491,7 @@ lwiperf_tcp_close(lwiperf_state_tcp_t *conn, enum lwiperf_report_type report_typ
   err_t err;
 
   lwiperf_list_remove(&conn->base);
+  sys_untimeout(lwiperf_interval_tmr, &conn->base);
   lwip_tcp_conn_report(conn, report_type);
   if (conn->conn_pcb != NULL) {
     tcp_arg(conn->conn_pcb, NULL);
@@ -289,7 +530,7 @@ lwiperf_tcp_client_send_more(lwiperf_state_tcp_t *conn)
     if (conn->settings.amount & PP_HTONL(0x80000000)) {
       /* this session is time-limited */
       u32_t now = sys_now();
-      u32_t diff_ms = now - conn->time_started;
+      u32_t diff_ms = now - conn->base.time_started;
       u32_t time = (u32_t) - (s32_t)lwip_htonl(conn->settings.amount);
       u32_t time_ms = time * 10;
       if (diff_ms >= time_ms) {
@@ -301,30 +542,36 @@ lwiperf_tcp_client_send_more(lwiperf_state_tcp_t *conn)
       /* this session is byte-limited */
       u32_t amount_bytes = lwip_htonl(conn->settings.amount);
       /* @todo: this can send up to 1*MSS more than requested... */
-      if (amount_bytes >= conn->bytes_transferred) {
+      if (amount_bytes >= conn->base.bytes_transferred) {
         /* all requested bytes transferred -> close the connection */
         lwiperf_tcp_close(conn, LWIPERF_TCP_DONE_CLIENT);
         return ERR_OK;
       }
     }
+    if (conn->header_only && (conn->base.bytes_transferred >= sizeof(lwiperf_settings_t))) {
+      /* reverse test: the remote side starts sending when we close, and
+         there is nothing to report for this side */
+      lwiperf_close_silent(&conn->base);
+      return ERR_OK;
+    }
 
-    if (conn->bytes_transferred < 24) {
+    if (conn->base.bytes_transferred < 24) {
       /* transmit the settings a first time */
-      txptr = &((u8_t *)&conn->settings)[conn->bytes_transferred];
-      txlen_max = (u16_t)(24 - conn->bytes_transferred);
+      txptr = &((u8_t *)&conn->settings)[conn->base.bytes_transferred];
+      txlen_max = (u16_t)(24 - conn->base.bytes_transferred);
       apiflags = TCP_WRITE_FLAG_COPY;
-    } else if (conn->bytes_transferred < 48) {
+    } else if (conn->base.bytes_transferred < 48) {
       /* transmit the settings a second time */
-      txptr = &((u8_t *)&conn->settings)[conn->bytes_transferred - 24];
-      txlen_max = (u16_t)(48 - conn->bytes_transferred);
+      txptr = &((u8_t *)&conn->settings)[conn->base.bytes_transferred - 24];
+      txlen_max = (u16_t)(48 - conn->base.bytes_transferred);
       apiflags = TCP_WRITE_FLAG_COPY | TCP_WRITE_FLAG_MORE;
       send_more = 1;
     } else {
       /* transmit data */
       /* @todo: every x bytes, transmit the settings again */
-      txptr = LWIP_CONST_CAST(void *, &lwiperf_txbuf_const[conn->bytes_transferred % 10]);
+      txptr = LWIP_CONST_CAST(void *, &lwiperf_txbuf_const[conn->base.bytes_transferred % 10]);
       txlen_max = TCP_MSS;
-      if (conn->bytes_transferred == 48) { /* @todo: fix this for intermediate settings, too */
+      if (conn->base.bytes_transferred == 48) { /* @todo: fix this for intermediate settings, too */
         txlen_max = TCP_MSS - 24;
       }
       apiflags = 0; /* no copying needed */
@@ -339,7 +586,7 @@ lwiperf_tcp_client_send_more(lwiperf_state_tcp_t *conn)
     } while ((err == ERR_MEM) && (txlen >= (TCP_MSS / 2)));
 
     if (err == ERR_OK) {
-      conn->bytes_transferred += txlen;
+      conn->base.bytes_transferred += txlen;
     } else {
       send_more = 0;
     }
@@ -376,7 +623,7 @@ lwiperf_tcp_client_connected(void *arg, struct tcp_pcb *tpcb, err_t err)
     return ERR_OK;
   }
   conn->poll_count = 0;
-  conn->time_started = sys_now();
+  lwiperf_stats_start(&conn->base);
   return lwiperf_tcp_client_send_more(conn);
 }
 
@@ -384,8 +631,9 @@ lwiperf_tcp_client_connected(void *arg, struct tcp_pcb *tpcb, err_t err)
  * receive test has finished.
  */
 static err_t
-lwiperf_tx_start_impl(const ip_addr_t *remote_ip, u16_t remote_port, lwiperf_settings_t *settings, lwiperf_report_fn report_fn,
-                      void *report_arg, lwiperf_state_base_t *related_master_state, lwiperf_state_tcp_t **new_conn)
+lwiperf_tx_start_impl(const ip_addr_t *remote_ip, u16_t remote_port, lwiperf_settings_t *settings,
+                      const lwiperf_state_base_t *report_from, lwiperf_state_base_t *related_master_state,
+                      lwiperf_state_tcp_t **new_conn)
 {
   err_t err;
   lwiperf_state_tcp_t *client_conn;
@@ -408,13 +656,11 @@ lwiperf_tx_start_impl(const ip_addr_t *remote_ip, u16_t remote_port, lwiperf_set
   }
   memset(client_conn, 0, sizeof(lwiperf_state_tcp_t));
   client_conn->base.tcp = 1;
+  lwiperf_base_init(&client_conn->base, report_from);
   client_conn->base.related_master_state = related_master_state;
+  client_conn->base.time_started = sys_now(); /* set again on 'connected' */
   client_conn->conn_pcb = newpcb;
-  client_conn->time_started = sys_now(); /* @todo: set this again on 'connected' */
-  client_conn->report_fn = report_fn;
-  client_conn->report_arg = report_arg;
   client_conn->next_num = 4; /* initial nr is '4' since the header has 24 byte */
-  client_conn->bytes_transferred = 0;
   memcpy(&client_conn->settings, settings, sizeof(*settings));
   client_conn->have_settings_buf = 1;
 
@@ -442,7 +688,7 @@ lwiperf_tx_start_passive(lwiperf_state_tcp_t *conn)
   lwiperf_state_tcp_t *new_conn = NULL;
   u16_t remote_port = (u16_t)lwip_htonl(conn->settings.remote_port);
 
-  ret = lwiperf_tx_start_impl(&conn->conn_pcb->remote_ip, remote_port, &conn->settings, conn->report_fn, conn->report_arg,
+  ret = lwiperf_tx_start_impl(&conn->conn_pcb->remote_ip, remote_port, &conn->settings, &conn->base,
     conn->base.related_master_state, &new_conn);
   if (ret == ERR_OK) {
     LWIP_ASSERT("new_conn != NULL", new_conn != NULL);
@@ -483,7 +729,7 @@ lwiperf_tcp_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
 
   conn->poll_count = 0;
 
-  if ((!conn->have_settings_buf) || ((conn->bytes_transferred - 24) % (1024 * 128) == 0)) {
+  if ((!conn->have_settings_buf) || ((conn->base.bytes_transferred - 24) % (1024 * 128) == 0)) {
     /* wait for 24-byte header */
     if (p->tot_len < sizeof(lwiperf_settings_t)) {
       lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_LOCAL_DATAERROR);
@@ -517,9 +763,9 @@ lwiperf_tcp_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
         }
       }
     }
-    conn->bytes_transferred += sizeof(lwiperf_settings_t);
-    if (conn->bytes_transferred <= 24) {
-      conn->time_started = sys_now();
+    conn->base.bytes_transferred += sizeof(lwiperf_settings_t);
+    if (conn->base.bytes_transferred <= 24) {
+      lwiperf_stats_start(&conn->base);
       tcp_recved(tpcb, p->tot_len);
       pbuf_free(p);
       return ERR_OK;
@@ -553,7 +799,7 @@ lwiperf_tcp_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err)
     packet_idx += q->len;
   }
   LWIP_ASSERT("count mismatch", packet_idx == p->tot_len);
-  conn->bytes_transferred += packet_idx;
+  conn->base.bytes_transferred += packet_idx;
   tcp_recved(tpcb, tot_len);
   pbuf_free(p);
   return ERR_OK;
@@ -565,7 +811,17 @@ lwiperf_tcp_err(void *arg, err_t err)
 {
   lwiperf_state_tcp_t *conn = (lwiperf_state_tcp_t *)arg;
   LWIP_UNUSED_ARG(err);
-  lwiperf_tcp_close(conn, LWIPERF_TCP_ABORTED_REMOTE);
+  /* the pcb is already freed, so it must not be closed (and its addresses are gone) */
+  lwiperf_list_remove(&conn->base);
+  sys_untimeout(lwiperf_interval_tmr, &conn->base);
+  if ((conn->base.report_fn != NULL) || (conn->base.report_ext_fn != NULL)) {
+    struct lwiperf_report report;
+    memset(&report, 0, sizeof(report));
+    report.local_addr = IP_ADDR_ANY;
+    report.remote_addr = IP_ADDR_ANY;
+    lwiperf_report(&conn->base, LWIPERF_TCP_ABORTED_REMOTE, sys_now() - conn->base.time_started, &report);
+  }
+  LWIPERF_FREE(lwiperf_state_tcp_t, conn);
 }
 
 /** TCP poll callback, try to send more data */
@@ -617,11 +873,10 @@ lwiperf_tcp_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
   memset(conn, 0, sizeof(lwiperf_state_tcp_t));
   conn->base.tcp = 1;
   conn->base.server = 1;
+  lwiperf_base_init(&conn->base, &s->base);
   conn->base.related_master_state = &s->base;
+  conn->base.time_started = sys_now();
   conn->conn_pcb = newpcb;
-  conn->time_started = sys_now();
-  conn->report_fn = s->report_fn;
-  conn->report_arg = s->report_arg;
 
   /* setup the tcp rx connection */
   tcp_arg(newpcb, conn);
@@ -632,58 +887,20 @@ lwiperf_tcp_accept(void *arg, struct tcp_pcb *newpcb, err_t err)
   if (s->specific_remote) {
     /* this listener belongs to a client, so make the client the master of the newly created connection */
     conn->base.related_master_state = s->base.related_master_state;
-    /* if dual mode or (tradeoff mode AND client is done): close the listener */
-    if (!s->client_tradeoff_mode || !lwiperf_list_find(s->base.related_master_state)) {
-      /* prevent report when closing: this is expected */
-      s->report_fn = NULL;
-      lwiperf_tcp_close(s, LWIPERF_TCP_ABORTED_LOCAL);
+    /* one connection per client stream: close the listener when all are accepted */
+    if (--s->accept_count == 0) {
+      lwiperf_close_silent(&s->base);
     }
   }
+  conn->base.stream = lwiperf_list_count_sessions(conn->base.related_master_state, 1);
   lwiperf_list_add(&conn->base);
   return ERR_OK;
 }
 
-/**
- * @ingroup iperf
- * Start a TCP iperf server on the default TCP port (5001) and listen for
- * incoming connections from iperf clients.
- *
- * @returns a connection handle that can be used to abort the server
- *          by calling @ref lwiperf_abort()
- */
-void *
-lwiperf_start_tcp_server_default(lwiperf_report_fn report_fn, void *report_arg)
-{
-  return lwiperf_start_tcp_server(IP_ADDR_ANY, LWIPERF_TCP_PORT_DEFAULT,
-                                  report_fn, report_arg);
-}
-
-/**
- * @ingroup iperf
- * Start a TCP iperf server on a specific IP address and port and listen for
- * incoming connections from iperf clients.
- *
- * @returns a connection handle that can be used to abort the server
- *          by calling @ref lwiperf_abort()
- */
-void *
-lwiperf_start_tcp_server(const ip_addr_t *local_addr, u16_t local_port,
-                         lwiperf_report_fn report_fn, void *report_arg)
-{
-  err_t err;
-  lwiperf_state_tcp_t *state = NULL;
-
-  err = lwiperf_start_tcp_server_impl(local_addr, local_port, report_fn, report_arg,
-    NULL, &state);
-  if (err == ERR_OK) {
-    return state;
-  }
-  return NULL;
-}
-
-static err_t lwiperf_start_tcp_server_impl(const ip_addr_t *local_addr, u16_t local_port,
-                                           lwiperf_report_fn report_fn, void *report_arg,
-                                           lwiperf_state_base_t *related_master_state, lwiperf_state_tcp_t **state)
+static err_t
+lwiperf_start_tcp_server_impl(const ip_addr_t *local_addr, u16_t local_port,
+                              const lwiperf_state_base_t *report_from,
+                              lwiperf_state_base_t *related_master_state, lwiperf_state_tcp_t **state)
 {
   err_t err;
   struct tcp_pcb *pcb;
@@ -704,16 +921,19 @@ static err_t lwiperf_start_tcp_server_impl(const ip_addr_t *local_addr, u16_t lo
   memset(s, 0, sizeof(lwiperf_state_tcp_t));
   s->base.tcp = 1;
   s->base.server = 1;
+  s->base.listener = 1;
+  lwiperf_base_init(&s->base, report_from);
   s->base.related_master_state = related_master_state;
-  s->report_fn = report_fn;
-  s->report_arg = report_arg;
 
   pcb = tcp_new_ip_type(LWIPERF_SERVER_IP_TYPE);
   if (pcb == NULL) {
+    LWIPERF_FREE(lwiperf_state_tcp_t, s);
     return ERR_MEM;
   }
   err = tcp_bind(pcb, local_addr, local_port);
   if (err != ERR_OK) {
+    tcp_close(pcb);
+    LWIPERF_FREE(lwiperf_state_tcp_t, s);
     return err;
   }
   s->server_pcb = tcp_listen_with_backlog(pcb, 1);
@@ -734,36 +954,579 @@ static err_t lwiperf_start_tcp_server_impl(const ip_addr_t *local_addr, u16_t lo
   return ERR_OK;
 }
 
-/**
- * @ingroup iperf
- * Start a TCP iperf client to the default TCP port (5001).
- *
- * @returns a connection handle that can be used to abort the client
- *          by calling @ref lwiperf_abort()
+#if LWIP_UDP
+static void lwiperf_udp_session_tmr(void *arg);
+static void lwiperf_udp_client_tmr(void *arg);
+static void lwiperf_udp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
+
+/** Call the report function of an iperf udp session */
+static void
+lwiperf_udp_report(lwiperf_state_udp_t *conn, enum lwiperf_report_type report_type)
+{
+  struct lwiperf_report report;
+  u32_t ms_duration = conn->ms_duration;
+
+  if (conn->base.listener ||
+      ((conn->base.report_fn == NULL) && (conn->base.report_ext_fn == NULL))) {
+    return;
+  }
+  memset(&report, 0, sizeof(report));
+  report.local_addr = &conn->pcb->local_ip;
+  report.local_port = conn->pcb->local_port;
+  report.remote_addr = &conn->remote_addr;
+  report.remote_port = conn->remote_port;
+  report.datagrams = conn->datagrams;
+  report.datagrams_lost = conn->lost;
+  report.datagrams_out_of_order = conn->out_of_order;
+  report.jitter_us = conn->jitter >> 4;
+  if (conn->fin_count == 0) {
+    /* test not finished (yet) */
+    ms_duration = sys_now() - conn->base.time_started;
+  }
+  lwiperf_report(&conn->base, report_type, ms_duration, &report);
+}
+
+/** Check if a udp listener has sessions left */
+static u8_t
+lwiperf_udp_has_sessions(lwiperf_state_udp_t *listener)
+{
+  lwiperf_state_base_t *iter;
+  for (iter = lwiperf_all_connections; iter != NULL; iter = iter->next) {
+    if (!iter->tcp && (((lwiperf_state_udp_t *)iter)->listener == listener)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** Close an iperf udp session, client or listener */
+static void
+lwiperf_udp_close(lwiperf_state_udp_t *conn, enum lwiperf_report_type report_type)
+{
+  lwiperf_state_udp_t *listener = conn->listener;
+
+  lwiperf_list_remove(&conn->base);
+  sys_untimeout(lwiperf_interval_tmr, &conn->base);
+  sys_untimeout(lwiperf_udp_session_tmr, conn);
+  sys_untimeout(lwiperf_udp_client_tmr, conn);
+  lwiperf_udp_report(conn, report_type);
+  if (listener == NULL) {
+    /* server sessions share the pcb of their listener */
+    udp_remove(conn->pcb);
+  }
+  LWIPERF_FREE(lwiperf_state_udp_t, conn);
+
+  if ((listener != NULL) && listener->specific_remote && (listener->accept_count == 0) &&
+      (lwiperf_list_find(&listener->base) != NULL) && !lwiperf_udp_has_sessions(listener)) {
+    /* all tests sent back to a client are done */
+    lwiperf_close_silent(&listener->base);
+  }
+}
+
+/** Send one datagram of a udp client: header, settings and constant payload */
+static err_t
+lwiperf_udp_send_datagram(lwiperf_state_udp_t *conn, s32_t id)
+{
+  err_t err;
+  struct pbuf *p, *data;
+  lwiperf_udp_hdr_t *hdr;
+  u32_t now_us = LWIPERF_TIME_US();
+  u16_t data_len = (u16_t)(conn->datagram_len - LWIPERF_UDP_HDR_LEN);
+
+  p = pbuf_alloc(PBUF_TRANSPORT, LWIPERF_UDP_HDR_LEN, PBUF_RAM);
+  if (p == NULL) {
+    return ERR_MEM;
+  }
+  hdr = (lwiperf_udp_hdr_t *)p->payload;
+  hdr->id = (s32_t)lwip_htonl((u32_t)id);
+  hdr->tv_sec = lwip_htonl(now_us / 1000000U);
+  hdr->tv_usec = lwip_htonl(now_us % 1000000U);
+  memcpy(hdr + 1, &conn->settings, sizeof(lwiperf_settings_t));
+  if (data_len > 0) {
+    /* we want to measure sending, not copying! */
+    data = pbuf_alloc(PBUF_RAW, data_len, PBUF_ROM);
+    if (data == NULL) {
+      pbuf_free(p);
+      return ERR_MEM;
+    }
+    data->payload = LWIP_CONST_CAST(void *, lwiperf_txbuf_const);
+    pbuf_cat(p, data);
+  }
+  err = udp_send(conn->pcb, p);
+  pbuf_free(p);
+  return err;
+}
+
+/** Check if a udp client has sent everything it should */
+static u8_t
+lwiperf_udp_client_done(lwiperf_state_udp_t *conn, u32_t elapsed_ms)
+{
+  u32_t amount = lwip_ntohl(conn->settings.amount);
+  if (conn->header_only) {
+    return conn->next_id > 0;
+  }
+  if (amount & 0x80000000) {
+    return elapsed_ms >= (u32_t)(-(s32_t)amount) * 10U;
+  }
+  return conn->base.bytes_transferred >= amount;
+}
+
+/** Bytes a udp client should have sent after 'elapsed_ms' to keep its rate */
+static u32_t
+lwiperf_udp_bytes_due(lwiperf_state_udp_t *conn, u32_t elapsed_ms)
+{
+  u32_t bytes_per_sec = lwip_ntohl(conn->settings.win_band) / 8U;
+  return (elapsed_ms / 1000U) * bytes_per_sec + (elapsed_ms % 1000U) * (bytes_per_sec / 1000U);
+}
+
+/** A udp client is done: report unless this is a reverse test */
+static void
+lwiperf_udp_client_finish(lwiperf_state_udp_t *conn)
+{
+  if (conn->header_only) {
+    lwiperf_close_silent(&conn->base);
+  } else {
+    lwiperf_udp_close(conn, LWIPERF_UDP_DONE_CLIENT);
+  }
+}
+
+/** Udp client timer: send the datagrams that are due, then repeat the final
+ * datagram until the server report is received
  */
-void* lwiperf_start_tcp_client_default(const ip_addr_t* remote_addr,
-                               lwiperf_report_fn report_fn, void* report_arg)
+static void
+lwiperf_udp_client_tmr(void *arg)
 {
-  return lwiperf_start_tcp_client(remote_addr, LWIPERF_TCP_PORT_DEFAULT, LWIPERF_CLIENT,
-                                  report_fn, report_arg);
+  lwiperf_state_udp_t *conn = (lwiperf_state_udp_t *)arg;
+  u32_t elapsed = sys_now() - conn->base.time_started;
+
+  if (conn->fin_count == 0) {
+    if (!lwiperf_udp_client_done(conn, elapsed)) {
+      u32_t due = conn->header_only ? conn->datagram_len : lwiperf_udp_bytes_due(conn, elapsed);
+      while (conn->base.bytes_transferred + conn->datagram_len <= due) {
+        if (lwiperf_udp_send_datagram(conn, conn->next_id) != ERR_OK) {
+          /* out of memory: retry on the next tick */
+          break;
+        }
+        conn->next_id++;
+        conn->base.bytes_transferred += conn->datagram_len;
+      }
+      sys_timeout(LWIPERF_UDP_TX_INTERVAL_MS, lwiperf_udp_client_tmr, conn);
+      return;
+    }
+    conn->ms_duration = elapsed;
+  } else if (conn->fin_count >= LWIPERF_UDP_FIN_RETRIES) {
+    /* no server report received */
+    lwiperf_udp_client_finish(conn);
+    return;
+  }
+  /* like iperf2, the final id is negative even if no datagram was sent */
+  lwiperf_udp_send_datagram(conn, -LWIP_MAX(conn->next_id, 1));
+  conn->fin_count++;
+  sys_timeout(LWIPERF_UDP_FIN_INTERVAL_MS, lwiperf_udp_client_tmr, conn);
 }
 
-/**
- * @ingroup iperf
- * Start a TCP iperf client to a specific IP address and port.
- *
- * @returns a connection handle that can be used to abort the client
- *          by calling @ref lwiperf_abort()
+/** Receive the server report on a udp client */
+static void
+lwiperf_udp_client_recv(lwiperf_state_udp_t *conn, struct pbuf *p)
+{
+  lwiperf_udp_server_report_t report;
+
+  if (conn->fin_count == 0) {
+    /* no server report expected yet */
+    return;
+  }
+  if (pbuf_copy_partial(p, &report, sizeof(report), sizeof(lwiperf_udp_hdr_t)) != sizeof(report)) {
+    return;
+  }
+  conn->datagrams = lwip_ntohl(report.datagrams);
+  conn->lost = lwip_ntohl(report.error_cnt);
+  conn->out_of_order = lwip_ntohl(report.outorder_cnt);
+  conn->jitter = (lwip_ntohl(report.jitter1) * 1000000U + lwip_ntohl(report.jitter2)) << 4;
+  lwiperf_udp_client_finish(conn);
+}
+
+/** Start a udp client (either started locally or answering a test) */
+static err_t
+lwiperf_udp_tx_start_impl(const ip_addr_t *remote_ip, u16_t remote_port, const lwiperf_settings_t *settings,
+                          const lwiperf_state_base_t *report_from, lwiperf_state_base_t *related_master_state,
+                          lwiperf_state_udp_t **new_conn)
+{
+  err_t err;
+  u32_t len;
+  lwiperf_state_udp_t *conn;
+  struct udp_pcb *pcb;
+
+  LWIP_ASSERT("remote_ip != NULL", remote_ip != NULL);
+  LWIP_ASSERT("new_conn != NULL", new_conn != NULL);
+  *new_conn = NULL;
+
+  conn = (lwiperf_state_udp_t *)LWIPERF_ALLOC(lwiperf_state_udp_t);
+  if (conn == NULL) {
+    return ERR_MEM;
+  }
+  pcb = udp_new_ip_type(IP_GET_TYPE(remote_ip));
+  if (pcb == NULL) {
+    LWIPERF_FREE(lwiperf_state_udp_t, conn);
+    return ERR_MEM;
+  }
+  memset(conn, 0, sizeof(lwiperf_state_udp_t));
+  lwiperf_base_init(&conn->base, report_from);
+  conn->base.related_master_state = related_master_state;
+  conn->pcb = pcb;
+  ip_addr_copy(conn->remote_addr, *remote_ip);
+  conn->remote_port = remote_port;
+  memcpy(&conn->settings, settings, sizeof(lwiperf_settings_t));
+  if (conn->settings.win_band == 0) {
+    conn->settings.win_band = PP_HTONL(LWIPERF_UDP_DEFAULT_RATE);
+  }
+  len = lwip_ntohl(conn->settings.buffer_len);
+  if (len == 0) {
+    len = LWIPERF_UDP_DEFAULT_LEN;
+  }
+  len = LWIP_MAX(len, LWIPERF_UDP_HDR_LEN);
+  conn->datagram_len = (u16_t)LWIP_MIN(len, LWIPERF_UDP_HDR_LEN + sizeof(lwiperf_txbuf_const));
+
+  udp_recv(pcb, lwiperf_udp_recv, conn);
+  err = udp_connect(pcb, remote_ip, remote_port);
+  if (err != ERR_OK) {
+    udp_remove(pcb);
+    LWIPERF_FREE(lwiperf_state_udp_t, conn);
+    return err;
+  }
+  lwiperf_stats_start(&conn->base);
+  lwiperf_list_add(&conn->base);
+  sys_timeout(LWIPERF_UDP_TX_INTERVAL_MS, lwiperf_udp_client_tmr, conn);
+  *new_conn = conn;
+  return ERR_OK;
+}
+
+static err_t
+lwiperf_udp_tx_start_passive(lwiperf_state_udp_t *conn)
+{
+  lwiperf_state_udp_t *new_conn = NULL;
+  lwiperf_settings_t settings;
+  u16_t remote_port = (u16_t)lwip_ntohl(conn->settings.remote_port);
+
+  if (remote_port == 0) {
+    remote_port = LWIPERF_UDP_PORT_DEFAULT;
+  }
+  memcpy(&settings, &conn->settings, sizeof(settings));
+  settings.flags = 0; /* prevent the remote side starting back as client again */
+  return lwiperf_udp_tx_start_impl(&conn->remote_addr, remote_port, &settings, &conn->base,
+    conn->base.related_master_state, &new_conn);
+}
+
+/** Send the server report in answer to the final datagram of a test */
+static void
+lwiperf_udp_send_report(lwiperf_state_udp_t *conn, const lwiperf_udp_hdr_t *hdr)
+{
+  struct pbuf *p;
+  lwiperf_udp_server_report_t *report;
+  u32_t jitter_us = conn->jitter >> 4;
+
+  p = pbuf_alloc(PBUF_TRANSPORT, sizeof(lwiperf_udp_hdr_t) + sizeof(lwiperf_udp_server_report_t), PBUF_RAM);
+  if (p == NULL) {
+    /* the client repeats its final datagram */
+    return;
+  }
+  memcpy(p->payload, hdr, sizeof(lwiperf_udp_hdr_t));
+  report = (lwiperf_udp_server_report_t *)((u8_t *)p->payload + sizeof(lwiperf_udp_hdr_t));
+  report->flags = PP_HTONL(LWIPERF_UDP_REPORT_VERSION1);
+  report->total_len1 = 0;
+  report->total_len2 = lwip_htonl(conn->base.bytes_transferred);
+  report->stop_sec = lwip_htonl(conn->ms_duration / 1000U);
+  report->stop_usec = lwip_htonl((conn->ms_duration % 1000U) * 1000U);
+  report->error_cnt = lwip_htonl(conn->lost);
+  report->outorder_cnt = lwip_htonl(conn->out_of_order);
+  report->datagrams = lwip_htonl((u32_t)conn->next_id);
+  report->jitter1 = lwip_htonl(jitter_us / 1000000U);
+  report->jitter2 = lwip_htonl(jitter_us % 1000000U);
+  udp_sendto(conn->pcb, p, &conn->remote_addr, conn->remote_port);
+  pbuf_free(p);
+}
+
+/** Udp server session timer: ends idle sessions and, a while after the
+ * final datagram (to answer repeated ones), finished sessions
  */
-void* lwiperf_start_tcp_client(const ip_addr_t* remote_addr, u16_t remote_port,
-  enum lwiperf_client_type type, lwiperf_report_fn report_fn, void* report_arg)
+static void
+lwiperf_udp_session_tmr(void *arg)
+{
+  lwiperf_state_udp_t *conn = (lwiperf_state_udp_t *)arg;
+
+  if (conn->fin_count) {
+    /* already reported */
+    lwiperf_close_silent(&conn->base);
+  } else if ((u32_t)(sys_now() - conn->last_rx) >= LWIPERF_UDP_MAX_IDLE_SEC * 1000U) {
+    lwiperf_udp_close(conn, LWIPERF_TCP_ABORTED_REMOTE);
+  } else {
+    sys_timeout(1000U, lwiperf_udp_session_tmr, conn);
+  }
+}
+
+static lwiperf_state_udp_t *
+lwiperf_udp_find_session(lwiperf_state_udp_t *listener, const ip_addr_t *addr, u16_t port)
+{
+  lwiperf_state_base_t *iter;
+  for (iter = lwiperf_all_connections; iter != NULL; iter = iter->next) {
+    if (!iter->tcp) {
+      lwiperf_state_udp_t *conn = (lwiperf_state_udp_t *)iter;
+      if ((conn->listener == listener) && (conn->remote_port == port) &&
+          ip_addr_cmp(&conn->remote_addr, addr)) {
+        return conn;
+      }
+    }
+  }
+  return NULL;
+}
+
+/** The first datagram of a new test arrived at a udp listener */
+static lwiperf_state_udp_t *
+lwiperf_udp_session_new(lwiperf_state_udp_t *listener, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  lwiperf_state_udp_t *conn;
+
+  conn = (lwiperf_state_udp_t *)LWIPERF_ALLOC(lwiperf_state_udp_t);
+  if (conn == NULL) {
+    return NULL;
+  }
+  memset(conn, 0, sizeof(lwiperf_state_udp_t));
+  conn->base.server = 1;
+  lwiperf_base_init(&conn->base, &listener->base);
+  if (listener->specific_remote) {
+    /* this listener belongs to a client, so make the client the master of the new session */
+    conn->base.related_master_state = listener->base.related_master_state;
+  } else {
+    conn->base.related_master_state = &listener->base;
+  }
+  conn->base.stream = lwiperf_list_count_sessions(conn->base.related_master_state, 0);
+  conn->pcb = listener->pcb;
+  conn->listener = listener;
+  ip_addr_copy(conn->remote_addr, *addr);
+  conn->remote_port = port;
+  pbuf_copy_partial(p, &conn->settings, sizeof(lwiperf_settings_t), sizeof(lwiperf_udp_hdr_t));
+  conn->last_rx = sys_now();
+  lwiperf_stats_start(&conn->base);
+  lwiperf_list_add(&conn->base);
+  sys_timeout(1000U, lwiperf_udp_session_tmr, conn);
+
+  if ((conn->settings.flags & PP_HTONL(LWIPERF_FLAGS_ANSWER_TEST)) &&
+      (conn->settings.flags & PP_HTONL(LWIPERF_FLAGS_ANSWER_NOW))) {
+    /* client requested parallel transmission test */
+    lwiperf_udp_tx_start_passive(conn);
+  }
+  return conn;
+}
+
+/** Receive a datagram on a udp listener: account loss, reordering and jitter */
+static void
+lwiperf_udp_server_recv(lwiperf_state_udp_t *listener, struct pbuf *p, const lwiperf_udp_hdr_t *hdr,
+                        const ip_addr_t *addr, u16_t port)
+{
+  lwiperf_state_udp_t *conn;
+  s32_t id = (s32_t)lwip_ntohl((u32_t)hdr->id);
+  u32_t transit;
+
+  conn = lwiperf_udp_find_session(listener, addr, port);
+  if (conn == NULL) {
+    if (id < 0) {
+      /* final datagram of an unknown (or long finished) test */
+      return;
+    }
+    if (listener->specific_remote) {
+      if ((listener->accept_count == 0) || !ip_addr_cmp(addr, &listener->remote_addr)) {
+        /* this listener belongs to a client session, and this is not the correct remote */
+        return;
+      }
+      listener->accept_count--;
+    }
+    conn = lwiperf_udp_session_new(listener, p, addr, port);
+    if (conn == NULL) {
+      return;
+    }
+  } else if (conn->fin_count) {
+    if (id < 0) {
+      /* final datagram repeated: our report got lost */
+      lwiperf_udp_send_report(conn, hdr);
+    }
+    return;
+  }
+
+  conn->last_rx = sys_now();
+  conn->datagrams++;
+  conn->base.bytes_transferred += p->tot_len;
+  if (id < 0) {
+    conn->fin_count = 1;
+    id = -id;
+  }
+  if (id >= conn->next_id) {
+    if (id > conn->next_id) {
+      conn->lost += (u32_t)(id - conn->next_id);
+    }
+    conn->next_id = id + 1;
+  } else {
+    /* late datagram, counted as lost before */
+    conn->out_of_order++;
+    if (conn->lost > 0) {
+      conn->lost--;
+    }
+  }
+
+  /* interarrival jitter as in RFC 3550, scaled by 16 */
+  transit = LWIPERF_TIME_US() - (lwip_ntohl(hdr->tv_sec) * 1000000U + lwip_ntohl(hdr->tv_usec));
+  if (conn->datagrams > 1) {
+    s32_t d = (s32_t)(transit - conn->last_transit);
+    if (d < 0) {
+      d = -d;
+    }
+    conn->jitter += (u32_t)d - ((conn->jitter + 8) >> 4);
+  }
+  conn->last_transit = transit;
+
+  if (conn->fin_count) {
+    /* test done */
+    conn->ms_duration = conn->last_rx - conn->base.time_started;
+    sys_untimeout(lwiperf_interval_tmr, &conn->base);
+    lwiperf_udp_send_report(conn, hdr);
+    lwiperf_udp_report(conn, LWIPERF_UDP_DONE_SERVER);
+    if ((conn->settings.flags & PP_HTONL(LWIPERF_FLAGS_ANSWER_TEST)) &&
+        !(conn->settings.flags & PP_HTONL(LWIPERF_FLAGS_ANSWER_NOW))) {
+      /* client requested transmission after end of test */
+      lwiperf_udp_tx_start_passive(conn);
+    }
+    /* keep the session for a while to answer repeated final datagrams */
+    sys_untimeout(lwiperf_udp_session_tmr, conn);
+    sys_timeout(LWIPERF_UDP_FIN_INTERVAL_MS * 4U, lwiperf_udp_session_tmr, conn);
+  }
+}
+
+/** Udp recv callback for listeners and clients */
+static void
+lwiperf_udp_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port)
+{
+  lwiperf_state_udp_t *conn = (lwiperf_state_udp_t *)arg;
+  lwiperf_udp_hdr_t hdr;
+
+  LWIP_UNUSED_ARG(pcb);
+
+  if (pbuf_copy_partial(p, &hdr, sizeof(hdr), 0) == sizeof(hdr)) {
+    if (conn->base.server) {
+      lwiperf_udp_server_recv(conn, p, &hdr, addr, port);
+    } else {
+      lwiperf_udp_client_recv(conn, p);
+    }
+  }
+  pbuf_free(p);
+}
+
+static err_t
+lwiperf_start_udp_server_impl(const ip_addr_t *local_addr, u16_t local_port,
+                              const lwiperf_state_base_t *report_from,
+                              lwiperf_state_base_t *related_master_state, lwiperf_state_udp_t **state)
+{
+  err_t err;
+  struct udp_pcb *pcb;
+  lwiperf_state_udp_t *s;
+
+  LWIP_ASSERT_CORE_LOCKED();
+
+  LWIP_ASSERT("state != NULL", state != NULL);
+
+  if (local_addr == NULL) {
+    return ERR_ARG;
+  }
+
+  s = (lwiperf_state_udp_t *)LWIPERF_ALLOC(lwiperf_state_udp_t);
+  if (s == NULL) {
+    return ERR_MEM;
+  }
+  memset(s, 0, sizeof(lwiperf_state_udp_t));
+  s->base.server = 1;
+  s->base.listener = 1;
+  lwiperf_base_init(&s->base, report_from);
+  s->base.related_master_state = related_master_state;
+
+  pcb = udp_new_ip_type(LWIPERF_SERVER_IP_TYPE);
+  if (pcb == NULL) {
+    LWIPERF_FREE(lwiperf_state_udp_t, s);
+    return ERR_MEM;
+  }
+  err = udp_bind(pcb, local_addr, local_port);
+  if (err != ERR_OK) {
+    udp_remove(pcb);
+    LWIPERF_FREE(lwiperf_state_udp_t, s);
+    return err;
+  }
+  udp_recv(pcb, lwiperf_udp_recv, s);
+  s->pcb = pcb;
+
+  lwiperf_list_add(&s->base);
+  *state = s;
+  return ERR_OK;
+}
+#endif /* LWIP_UDP */
+
+/** Report the current state of a session (used for interval reports) */
+static void
+lwiperf_conn_report(lwiperf_state_base_t *s, enum lwiperf_report_type report_type)
+{
+  if (s->tcp) {
+    lwip_tcp_conn_report((lwiperf_state_tcp_t *)s, report_type);
+  }
+#if LWIP_UDP
+  else {
+    lwiperf_udp_report((lwiperf_state_udp_t *)s, report_type);
+  }
+#endif
+}
+
+/** Close a session without reporting (on abort or when the result is not
+ * of interest)
+ */
+static void
+lwiperf_close_silent(lwiperf_state_base_t *s)
+{
+  s->report_fn = NULL;
+  s->report_ext_fn = NULL;
+  if (s->tcp) {
+    lwiperf_tcp_close((lwiperf_state_tcp_t *)s, LWIPERF_TCP_ABORTED_LOCAL);
+  }
+#if LWIP_UDP
+  else {
+    lwiperf_udp_close((lwiperf_state_udp_t *)s, LWIPERF_TCP_ABORTED_LOCAL);
+  }
+#endif
+}
+
+/** Start the client streams of a test and, for bidirectional and reverse
+ * tests, a listener for the test(s) sent back by the remote host.
+ */
+static void *
+lwiperf_start_client_impl(const ip_addr_t *remote_addr, u16_t remote_port,
+                          const struct lwiperf_client_settings *client_settings,
+                          const lwiperf_state_base_t *report_from)
 {
   err_t ret;
+  u8_t i;
   lwiperf_settings_t settings;
-  lwiperf_state_tcp_t *state = NULL;
+  lwiperf_state_base_t report;
+  lwiperf_state_base_t *master = NULL;
+  lwiperf_state_tcp_t *tcp_master = NULL;
+  u8_t num_streams = client_settings->num_streams ? client_settings->num_streams : 1;
+  u32_t duration_ms = client_settings->duration_ms ? client_settings->duration_ms : 10000;
+
+  LWIP_ASSERT_CORE_LOCKED();
+
+  if (remote_addr == NULL) {
+    return NULL;
+  }
+#if !LWIP_UDP
+  if (client_settings->udp) {
+    return NULL;
+  }
+#endif
 
   memset(&settings, 0, sizeof(settings));
-  switch (type) {
+  switch (client_settings->type) {
   case LWIPERF_CLIENT:
     /* Unidirectional tx only test */
     settings.flags = 0;
@@ -773,40 +1536,127 @@ void* lwiperf_start_tcp_client(const ip_addr_t* remote_addr, u16_t remote_port,
     settings.flags = htonl(LWIPERF_FLAGS_ANSWER_TEST | LWIPERF_FLAGS_ANSWER_NOW);
     break;
   case LWIPERF_TRADEOFF:
-    /* Do a bidirectional test individually */
+  case LWIPERF_REVERSE:
+    /* Do a bidirectional test individually (reverse: without our part) */
     settings.flags = htonl(LWIPERF_FLAGS_ANSWER_TEST);
     break;
   default:
     /* invalid argument */
     return NULL;
   }
-  settings.num_threads = htonl(1);
-  settings.remote_port = htonl(LWIPERF_TCP_PORT_DEFAULT);
-  /* TODO: implement passing duration/amount of bytes to transfer */
-  settings.amount = htonl((u32_t)-1000);
+  settings.num_threads = htonl(num_streams);
+  settings.remote_port = htonl(client_settings->udp ? LWIPERF_UDP_PORT_DEFAULT : LWIPERF_TCP_PORT_DEFAULT);
+  settings.amount = htonl((u32_t) - (s32_t)LWIP_MAX(duration_ms / 10U, 1));
+  if (client_settings->udp) {
+    settings.buffer_len = htonl(client_settings->udp_datagram_len ?
+                                client_settings->udp_datagram_len : LWIPERF_UDP_DEFAULT_LEN);
+    settings.win_band = htonl(client_settings->udp_bandwidth_kbitpsec ?
+                              client_settings->udp_bandwidth_kbitpsec * 1000U : LWIPERF_UDP_DEFAULT_RATE);
+  }
 
-  ret = lwiperf_tx_start_impl(remote_addr, remote_port, &settings, report_fn, report_arg, NULL, &state);
-  if (ret == ERR_OK) {
-    LWIP_ASSERT("state != NULL", state != NULL);
-    if (type != LWIPERF_CLIENT) {
-      /* start corresponding server now */
-      lwiperf_state_tcp_t *server = NULL;
-      ret = lwiperf_start_tcp_server_impl(&state->conn_pcb->local_ip, LWIPERF_TCP_PORT_DEFAULT,
-        report_fn, report_arg, (lwiperf_state_base_t *)state, &server);
-      if (ret != ERR_OK) {
-        /* starting server failed, abort client */
-        lwiperf_abort(state);
-        return NULL;
+  memcpy(&report, report_from, sizeof(report));
+  for (i = 0; i < num_streams; i++) {
+    report.stream = i;
+#if LWIP_UDP
+    if (client_settings->udp) {
+      lwiperf_state_udp_t *state = NULL;
+      ret = lwiperf_udp_tx_start_impl(remote_addr, remote_port, &settings, &report, master, &state);
+      if (ret == ERR_OK) {
+        state->header_only = (client_settings->type == LWIPERF_REVERSE);
+        if (master == NULL) {
+          master = &state->base;
+        }
+      }
+    } else
+#endif
+    {
+      lwiperf_state_tcp_t *state = NULL;
+      ret = lwiperf_tx_start_impl(remote_addr, remote_port, &settings, &report, master, &state);
+      if (ret == ERR_OK) {
+        state->header_only = (client_settings->type == LWIPERF_REVERSE);
+        if (master == NULL) {
+          master = &state->base;
+          tcp_master = state;
+        }
+      }
+    }
+    if (ret != ERR_OK) {
+      if (master != NULL) {
+        lwiperf_abort(master);
       }
-      /* make this server accept one connection only */
-      server->specific_remote = 1;
-      server->remote_addr = state->conn_pcb->remote_ip;
-      if (type == LWIPERF_TRADEOFF) {
-        /* tradeoff means that the remote host connects only after the client is done,
-           so keep the listen pcb open until the client is done */
-        server->client_tradeoff_mode = 1;
+      return NULL;
+    }
+  }
+
+  if (client_settings->type != LWIPERF_CLIENT) {
+    /* start corresponding server now, accepting one test per stream from the remote host */
+    report.stream = 0;
+#if LWIP_UDP
+    if (client_settings->udp) {
+      lwiperf_state_udp_t *server = NULL;
+      ret = lwiperf_start_udp_server_impl(IP_ANY_TYPE, LWIPERF_UDP_PORT_DEFAULT, &report, master, &server);
+      if (ret == ERR_OK) {
+        server->specific_remote = 1;
+        server->accept_count = num_streams;
+        ip_addr_copy(server->remote_addr, *remote_addr);
+      }
+    } else
+#endif
+    {
+      lwiperf_state_tcp_t *server = NULL;
+      ret = lwiperf_start_tcp_server_impl(&tcp_master->conn_pcb->local_ip, LWIPERF_TCP_PORT_DEFAULT,
+        &report, master, &server);
+      if (ret == ERR_OK) {
+        server->specific_remote = 1;
+        server->accept_count = num_streams;
+        server->remote_addr = tcp_master->conn_pcb->remote_ip;
       }
     }
+    if (ret != ERR_OK) {
+      /* starting server failed, abort client */
+      lwiperf_abort(master);
+      return NULL;
+    }
+  }
+  return master;
+}
+
+/**
+ * @ingroup iperf
+ * Start a TCP iperf server on the default TCP port (5001) and listen for
+ * incoming connections from iperf clients.
+ *
+ * @returns a connection handle that can be used to abort the server
+ *          by calling @ref lwiperf_abort()
+ */
+void *
+lwiperf_start_tcp_server_default(lwiperf_report_fn report_fn, void *report_arg)
+{
+  return lwiperf_start_tcp_server(IP_ADDR_ANY, LWIPERF_TCP_PORT_DEFAULT,
+                                  report_fn, report_arg);
+}
+
+/**
+ * @ingroup iperf
+ * Start a TCP iperf server on a specific IP address and port and listen for
+ * incoming connections from iperf clients.
+ *
+ * @returns a connection handle that can be used to abort the server
+ *          by calling @ref lwiperf_abort()
+ */
+void *
+lwiperf_start_tcp_server(const ip_addr_t *local_addr, u16_t local_port,
+                         lwiperf_report_fn report_fn, void *report_arg)
+{
+  err_t err;
+  lwiperf_state_tcp_t *state = NULL;
+  lwiperf_state_base_t report;
+
+  memset(&report, 0, sizeof(report));
+  report.report_fn = report_fn;
+  report.report_arg = report_arg;
+  err = lwiperf_start_tcp_server_impl(local_addr, local_port, &report, NULL, &state);
+  if (err == ERR_OK) {
     return state;
   }
   return NULL;
@@ -814,28 +1664,137 @@ void* lwiperf_start_tcp_client(const ip_addr_t* remote_addr, u16_t remote_port,
 
 /**
  * @ingroup iperf
- * Abort an iperf session (handle returned by lwiperf_start_tcp_server*())
+ * Start a TCP or UDP iperf server on a specific IP address and port and
+ * listen for tests from iperf clients. Parallel streams and bidirectional
+ * tests are supported.
+ *
+ * @param interval_ms if != 0, report_fn gets LWIPERF_INTERVAL reports at this
+ *        interval while a test is running
+ * @returns a connection handle that can be used to abort the server
+ *          by calling @ref lwiperf_abort()
+ */
+void *
+lwiperf_start_server(const ip_addr_t *local_addr, u16_t local_port, u8_t udp,
+                     u32_t interval_ms, lwiperf_report_ext_fn report_fn, void *report_arg)
+{
+  err_t err;
+  lwiperf_state_base_t report;
+
+  memset(&report, 0, sizeof(report));
+  report.report_ext_fn = report_fn;
+  report.report_arg = report_arg;
+  report.interval_ms = interval_ms;
+  if (udp) {
+#if LWIP_UDP
+    lwiperf_state_udp_t *state = NULL;
+    err = lwiperf_start_udp_server_impl(local_addr, local_port, &report, NULL, &state);
+    if (err == ERR_OK) {
+      return state;
+    }
+#endif
+  } else {
+    lwiperf_state_tcp_t *state = NULL;
+    err = lwiperf_start_tcp_server_impl(local_addr, local_port, &report, NULL, &state);
+    if (err == ERR_OK) {
+      return state;
+    }
+  }
+  return NULL;
+}
+
+/**
+ * @ingroup iperf
+ * Start a TCP iperf client to the default TCP port (5001).
+ *
+ * @returns a connection handle that can be used to abort the client
+ *          by calling @ref lwiperf_abort()
+ */
+void* lwiperf_start_tcp_client_default(const ip_addr_t* remote_addr,
+                               lwiperf_report_fn report_fn, void* report_arg)
+{
+  return lwiperf_start_tcp_client(remote_addr, LWIPERF_TCP_PORT_DEFAULT, LWIPERF_CLIENT,
+                                  report_fn, report_arg);
+}
+
+/**
+ * @ingroup iperf
+ * Start a TCP iperf client to a specific IP address and port.
+ *
+ * @returns a connection handle that can be used to abort the client
+ *          by calling @ref lwiperf_abort()
+ */
+void* lwiperf_start_tcp_client(const ip_addr_t* remote_addr, u16_t remote_port,
+  enum lwiperf_client_type type, lwiperf_report_fn report_fn, void* report_arg)
+{
+  struct lwiperf_client_settings settings;
+  lwiperf_state_base_t report;
+
+  memset(&settings, 0, sizeof(settings));
+  settings.type = type;
+  memset(&report, 0, sizeof(report));
+  report.report_fn = report_fn;
+  report.report_arg = report_arg;
+  return lwiperf_start_client_impl(remote_addr, remote_port, &settings, &report);
+}
+
+/**
+ * @ingroup iperf
+ * Start a TCP or UDP iperf client to a specific IP address and port.
+ *
+ * Every one of settings->num_streams streams is reported on its own.
+ * For LWIPERF_DUAL, LWIPERF_TRADEOFF and LWIPERF_REVERSE, the tests sent back
+ * by the remote host are reported as server tests.
+ *
+ * @returns a connection handle that can be used to abort the client
+ *          (including all its streams) by calling @ref lwiperf_abort()
+ */
+void *
+lwiperf_start_client(const ip_addr_t *remote_addr, u16_t remote_port,
+                     const struct lwiperf_client_settings *settings,
+                     lwiperf_report_ext_fn report_fn, void *report_arg)
+{
+  lwiperf_state_base_t report;
+
+  LWIP_ASSERT("settings != NULL", settings != NULL);
+
+  memset(&report, 0, sizeof(report));
+  report.report_ext_fn = report_fn;
+  report.report_arg = report_arg;
+  report.interval_ms = settings->interval_ms;
+  return lwiperf_start_client_impl(remote_addr, remote_port, settings, &report);
+}
+
+/**
+ * @ingroup iperf
+ * Abort an iperf session (handle returned by lwiperf_start_*()) and all
+ * sessions related to it. Aborted sessions are not reported.
  */
 void
 lwiperf_abort(void *lwiperf_session)
 {
-  lwiperf_state_base_t *i, *dealloc, *last = NULL;
+  lwiperf_state_base_t *i, *next, *last = NULL, *aborted = NULL;
 
   LWIP_ASSERT_CORE_LOCKED();
 
-  for (i = lwiperf_all_connections; i != NULL; ) {
+  /* unlink all sessions first, so closing one does not touch the others */
+  for (i = lwiperf_all_connections; i != NULL; i = next) {
+    next = i->next;
     if ((i == lwiperf_session) || (i->related_master_state == lwiperf_session)) {
-      dealloc = i;
-      i = i->next;
       if (last != NULL) {
-        last->next = i;
+        last->next = next;
+      } else {
+        lwiperf_all_connections = next;
       }
-      LWIPERF_FREE(lwiperf_state_tcp_t, dealloc); /* @todo: type? */
+      i->next = aborted;
+      aborted = i;
     } else {
       last = i;
-      i = i->next;
     }
   }
+  for (i = aborted; i != NULL; i = next) {
+    next = i->next;
+    lwiperf_close_silent(i);
+  }
 }
 
 #endif /* LWIP_TCP && LWIP_CALLBACK_API */
@@ -5,7 +5,9 @@
  * @author   Logan Gunthorpe <logang@deltatee.com>
  *           Dirk Ziegelmeier <dziegel@gmx.de>
  *
- * @brief    Trivial File Transfer Protocol (RFC 1350)
+ * @brief    Trivial File Transfer Protocol (RFC 1350) with option
+ *           negotiation (RFC 2347), blksize (RFC 2348) and windowsize
+ *           (RFC 7440)
  *
  * Copyright (c) Deltatee Enterprises Ltd. 2013
  * All rights reserved.
@@ -45,6 +47,12 @@
  * @ingroup apps
  *
  * This is simple TFTP server for the lwIP raw API.
+ *
+ * The "blksize" and "windowsize" options are negotiated when a client
+ * requests them (see @ref TFTP_MAX_BLKSIZE and @ref TFTP_MAX_WINDOWSIZE),
+ * so a whole window of DATA packets is sent per round trip instead of one
+ * block. The retransmission timeout is adapted to the measured round trip
+ * time (between @ref TFTP_MIN_TIMEOUT_MSECS and @ref TFTP_TIMEOUT_MSECS).
  */
 
 #include "lwip/apps/tftp_server.h"
@@ -63,6 +71,14 @@
 #define TFTP_DATA  3
 #define TFTP_ACK   4
 #define TFTP_ERROR 5
+#define TFTP_OACK  6
+
+/* Option flags, set for each option that is acknowledged in the OACK */
+#define TFTP_OPT_BLKSIZE    0x01
+#define TFTP_OPT_WINDOWSIZE 0x02
+
+/* RFC 2348 limits of the "blksize" option */
+#define TFTP_MIN_BLKSIZE    8
 
 enum tftp_error {
   TFTP_ERROR_FILE_NOT_FOUND    = 1,
@@ -76,18 +92,43 @@ enum tftp_error {
 
 #include <string.h>
 
+#if (TFTP_MAX_BLKSIZE < TFTP_MAX_PAYLOAD_SIZE) || (TFTP_MAX_BLKSIZE > 65464)
+#error "TFTP_MAX_BLKSIZE must be in the range 512..65464"
+#endif
+#if (TFTP_MAX_WINDOWSIZE < 1) || (TFTP_MAX_WINDOWSIZE > 65535)
+#error "TFTP_MAX_WINDOWSIZE must be in the range 1..65535"
+#endif
+
 struct tftp_state {
   const struct tftp_context *ctx;
   void *handle;
-  struct pbuf *last_data;
+  /* read: DATA payloads of the current window, window[0] is block blknum + 1 */
+  struct pbuf *window[TFTP_MAX_WINDOWSIZE];
   struct udp_pcb *upcb;
   ip_addr_t addr;
   u16_t port;
-  int timer;
-  int last_pkt;
+  /* read: last acknowledged block; write: next expected block */
   u16_t blknum;
+  u16_t blksize;
+  u16_t windowsize;
+  /* read: blocks held in window[]; write: blocks received since the last ACK */
+  u16_t win_count;
+  /* time the last window (read) or ACK (write) was sent, for RTT measurement */
+  u32_t xmit_time;
+  /* retransmission timeout in ms, smoothed RTT (scaled by 8) and RTT variance (scaled by 4) */
+  u32_t rto;
+  u32_t srtt;
+  u32_t rttvar;
   u8_t retries;
   u8_t mode_write;
+  /* read: the last (short) block has been read into the window */
+  u8_t eof;
+  /* write: an out-of-order block has been answered with an ACK already */
+  u8_t gap_acked;
+  /* TFTP_OPT_* flags negotiated with the client */
+  u8_t options;
+  /* read: OACK sent, waiting for ACK of block 0 */
+  u8_t oack_pending;
 };
 
 static struct tftp_state tftp_state;
@@ -97,13 +138,18 @@ static void tftp_tmr(void *arg);
 static void
 close_handle(void)
 {
+  u16_t i;
+
   tftp_state.port = 0;
   ip_addr_set_any(0, &tftp_state.addr);
 
-  if (tftp_state.last_data != NULL) {
-    pbuf_free(tftp_state.last_data);
-    tftp_state.last_data = NULL;
+  for (i = 0; i < tftp_state.win_count; i++) {
+    if (tftp_state.window[i] != NULL) {
+      pbuf_free(tftp_state.window[i]);
+      tftp_state.window[i] = NULL;
+    }
   }
+  tftp_state.win_count = 0;
 
   sys_untimeout(tftp_tmr, NULL);
 
@@ -114,6 +160,37 @@ close_handle(void)
   }
 }
 
+/* (Re-)start the retransmission timer with the current timeout */
+static void
+restart_timer(void)
+{
+  sys_untimeout(tftp_tmr, NULL);
+  sys_timeout(tftp_state.rto, tftp_tmr, NULL);
+}
+
+/* Update the retransmission timeout from a new RTT sample (Jacobson/Karels,
+ * like TCP). Only called for packets that were not retransmitted. */
+static void
+update_rto(u32_t rtt)
+{
+  if (tftp_state.srtt == 0) {
+    tftp_state.srtt = rtt << 3;
+    tftp_state.rttvar = rtt << 1;
+  } else {
+    s32_t err = (s32_t)(rtt - (tftp_state.srtt >> 3));
+    tftp_state.srtt = (u32_t)((s32_t)tftp_state.srtt + err);
+    if (err < 0) {
+      err = -err;
+    }
+    tftp_state.rttvar = (u32_t)((s32_t)tftp_state.rttvar + err - (s32_t)(tftp_state.rttvar >> 2));
+  }
+
+  tftp_state.rto = (tftp_state.srtt >> 3) + tftp_state.rttvar;
+  tftp_state.rto = LWIP_MAX(tftp_state.rto, TFTP_MIN_TIMEOUT_MSECS);
+  tftp_state.rto = LWIP_MIN(tftp_state.rto, TFTP_TIMEOUT_MSECS);
+  LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_TRACE, ("tftp: rtt %"U32_F" ms, rto %"U32_F" ms\n", rtt, tftp_state.rto));
+}
+
 static void
 send_error(const ip_addr_t *addr, u16_t port, enum tftp_error code, const char *str)
 {
@@ -153,51 +230,200 @@ send_ack(u16_t blknum)
   pbuf_free(p);
 }
 
+static u16_t
+append_option(char *buf, u16_t offset, const char *name, u16_t value)
+{
+  size_t len = strlen(name) + 1;
+
+  MEMCPY(&buf[offset], name, len);
+  offset = (u16_t)(offset + len);
+  lwip_itoa(&buf[offset], 6, value);
+  return (u16_t)(offset + strlen(&buf[offset]) + 1);
+}
+
 static void
-resend_data(void)
+send_oack(void)
 {
-  struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, tftp_state.last_data->len, PBUF_RAM);
-  if (p == NULL) {
-    return;
+  /* "blksize\0" "65464\0" "windowsize\0" "65535\0" */
+  char options[8 + 6 + 11 + 6];
+  u16_t len = 0;
+  struct pbuf *p;
+  u16_t *payload;
+
+  if (tftp_state.options & TFTP_OPT_BLKSIZE) {
+    len = append_option(options, len, "blksize", tftp_state.blksize);
+  }
+  if (tftp_state.options & TFTP_OPT_WINDOWSIZE) {
+    len = append_option(options, len, "windowsize", tftp_state.windowsize);
   }
 
-  if (pbuf_copy(p, tftp_state.last_data) != ERR_OK) {
-    pbuf_free(p);
+  p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)(2 + len), PBUF_RAM);
+  if (p == NULL) {
     return;
   }
+  payload = (u16_t *) p->payload;
 
+  payload[0] = PP_HTONS(TFTP_OACK);
+  MEMCPY(&payload[1], options, len);
   udp_sendto(tftp_state.upcb, p, &tftp_state.addr, tftp_state.port);
   pbuf_free(p);
 }
 
+/* Send one DATA packet. Only the header is allocated per packet, the block
+ * payload is chained by reference so retransmissions do not copy data. */
 static void
-send_data(void)
+send_data(u16_t blknum, struct pbuf *data)
 {
+  struct pbuf *p;
   u16_t *payload;
+
+  p = pbuf_alloc(PBUF_TRANSPORT, TFTP_HEADER_LENGTH, PBUF_RAM);
+  if (p == NULL) {
+    return;
+  }
+
+  payload = (u16_t *) p->payload;
+  payload[0] = PP_HTONS(TFTP_DATA);
+  payload[1] = lwip_htons(blknum);
+
+  if (data->tot_len > 0) {
+    pbuf_chain(p, data);
+  }
+
+  udp_sendto(tftp_state.upcb, p, &tftp_state.addr, tftp_state.port);
+  pbuf_free(p);
+}
+
+/* Read the next block of the file into a new pbuf.
+ * Returns ERR_MEM if no pbuf is available (retried later), ERR_VAL on read errors. */
+static err_t
+read_block(struct pbuf **block)
+{
+  struct pbuf *p;
   int ret;
 
-  if (tftp_state.last_data != NULL) {
-    pbuf_free(tftp_state.last_data);
+  if (tftp_state.ctx->read_ref != NULL) {
+    const void *buf = NULL;
+
+    p = pbuf_alloc(PBUF_RAW, tftp_state.blksize, PBUF_ROM);
+    if (p == NULL) {
+      return ERR_MEM;
+    }
+    ret = tftp_state.ctx->read_ref(tftp_state.handle, &buf, tftp_state.blksize);
+    p->payload = LWIP_CONST_CAST(void *, buf);
+  } else {
+    p = pbuf_alloc(PBUF_RAW, tftp_state.blksize, PBUF_RAM);
+    if (p == NULL) {
+      return ERR_MEM;
+    }
+    ret = tftp_state.ctx->read(tftp_state.handle, p->payload, tftp_state.blksize);
   }
 
-  tftp_state.last_data = pbuf_alloc(PBUF_TRANSPORT, TFTP_HEADER_LENGTH + TFTP_MAX_PAYLOAD_SIZE, PBUF_RAM);
-  if (tftp_state.last_data == NULL) {
-    return;
+  if ((ret < 0) || (ret > tftp_state.blksize)) {
+    pbuf_free(p);
+    return ERR_VAL;
   }
 
-  payload = (u16_t *) tftp_state.last_data->payload;
-  payload[0] = PP_HTONS(TFTP_DATA);
-  payload[1] = lwip_htons(tftp_state.blknum);
+  pbuf_realloc(p, (u16_t)ret);
+  *block = p;
+  return ERR_OK;
+}
 
-  ret = tftp_state.ctx->read(tftp_state.handle, &payload[2], TFTP_MAX_PAYLOAD_SIZE);
-  if (ret < 0) {
-    send_error(&tftp_state.addr, tftp_state.port, TFTP_ERROR_ACCESS_VIOLATION, "Error occured while reading the file.");
-    close_handle();
-    return;
+/* Top up the window with new blocks and (re-)send all blocks in it */
+static void
+send_window(void)
+{
+  u16_t i;
+
+  while (!tftp_state.eof && (tftp_state.win_count < tftp_state.windowsize)) {
+    struct pbuf *block;
+    err_t err = read_block(&block);
+
+    if (err == ERR_MEM) {
+      /* send what we have, the timer retries filling the window */
+      break;
+    } else if (err != ERR_OK) {
+      send_error(&tftp_state.addr, tftp_state.port, TFTP_ERROR_ACCESS_VIOLATION, "Error occured while reading the file.");
+      close_handle();
+      return;
+    }
+
+    if (block->tot_len < tftp_state.blksize) {
+      tftp_state.eof = 1;
+    }
+    tftp_state.window[tftp_state.win_count++] = block;
+  }
+
+  for (i = 0; i < tftp_state.win_count; i++) {
+    send_data((u16_t)(tftp_state.blknum + 1 + i), tftp_state.window[i]);
+  }
+
+  tftp_state.xmit_time = sys_now();
+  restart_timer();
+}
+
+/* Parse a decimal option value, returns 0 if it is invalid or too large */
+static u32_t
+parse_option_value(const char *str)
+{
+  u32_t value = 0;
+
+  if (*str == 0) {
+    return 0;
+  }
+  while (*str != 0) {
+    if ((*str < '0') || (*str > '9') || (value > 65535)) {
+      return 0;
+    }
+    value = (value * 10) + (u32_t)(*str - '0');
+    str++;
   }
+  return value;
+}
 
-  pbuf_realloc(tftp_state.last_data, (u16_t)(TFTP_HEADER_LENGTH + ret));
-  resend_data();
+/* Parse the RFC 2347 options following the mode string of a request */
+static void
+parse_options(struct pbuf *p, u16_t offset)
+{
+  const char tftp_null = 0;
+  char name[11];
+  char value[6];
+
+  tftp_state.blksize = TFTP_MAX_PAYLOAD_SIZE;
+  tftp_state.windowsize = 1;
+  tftp_state.options = 0;
+
+  while (offset < p->tot_len) {
+    u16_t name_end_offset = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), offset);
+    u16_t value_end_offset;
+    u32_t val;
+
+    if (name_end_offset == 0xFFFF) {
+      break;
+    }
+    value_end_offset = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), (u16_t)(name_end_offset + 1));
+    if (value_end_offset == 0xFFFF) {
+      break;
+    }
+
+    if (((u16_t)(name_end_offset - offset) < sizeof(name)) &&
+        ((u16_t)(value_end_offset - name_end_offset - 1) < sizeof(value))) {
+      pbuf_copy_partial(p, name, (u16_t)(name_end_offset - offset + 1), offset);
+      pbuf_copy_partial(p, value, (u16_t)(value_end_offset - name_end_offset), (u16_t)(name_end_offset + 1));
+      val = parse_option_value(value);
+
+      if ((lwip_stricmp(name, "blksize") == 0) && (val >= TFTP_MIN_BLKSIZE)) {
+        tftp_state.blksize = (u16_t)LWIP_MIN(val, TFTP_MAX_BLKSIZE);
+        tftp_state.options |= TFTP_OPT_BLKSIZE;
+      } else if ((lwip_stricmp(name, "windowsize") == 0) && (val >= 1)) {
+        tftp_state.windowsize = (u16_t)LWIP_MIN(val, TFTP_MAX_WINDOWSIZE);
+        tftp_state.options |= TFTP_OPT_WINDOWSIZE;
+      }
+      /* unknown options are silently ignored (not acknowledged) */
+    }
+
+    offset = (u16_t)(value_end_offset + 1);
+  }
 }
 
 static void
@@ -218,9 +444,6 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
 
   opcode = sbuf[0];
 
-  tftp_state.last_pkt = tftp_state.timer;
-  tftp_state.retries = 0;
-
   switch (opcode) {
     case PP_HTONS(TFTP_RRQ): /* fall through */
     case PP_HTONS(TFTP_WRQ): {
@@ -235,8 +458,6 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
         break;
       }
 
-      sys_timeout(TFTP_TIMER_MSECS, tftp_tmr, NULL);
-
       /* find \0 in pbuf -> end of filename string */
       filename_end_offset = pbuf_memfind(p, &tftp_null, sizeof(tftp_null), 2);
       if ((u16_t)(filename_end_offset - 1) > sizeof(filename)) {
@@ -254,26 +475,54 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       pbuf_copy_partial(p, mode, mode_end_offset - filename_end_offset, filename_end_offset + 1);
 
       tftp_state.handle = tftp_state.ctx->open(filename, mode, opcode == PP_HTONS(TFTP_WRQ));
-      tftp_state.blknum = 1;
+      tftp_state.blknum = 0;
+      tftp_state.win_count = 0;
+      tftp_state.eof = 0;
+      tftp_state.gap_acked = 0;
+      tftp_state.retries = 0;
+      tftp_state.rto = TFTP_TIMEOUT_MSECS;
+      tftp_state.srtt = 0;
+      tftp_state.rttvar = 0;
 
       if (!tftp_state.handle) {
         send_error(addr, port, TFTP_ERROR_FILE_NOT_FOUND, "Unable to open requested file.");
         break;
       }
 
+      parse_options(p, (u16_t)(mode_end_offset + 1));
+
       LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: %s request from ", (opcode == PP_HTONS(TFTP_WRQ)) ? "write" : "read"));
       ip_addr_debug_print(TFTP_DEBUG | LWIP_DBG_STATE, addr);
-      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, (" for '%s' mode '%s'\n", filename, mode));
+      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, (" for '%s' mode '%s' blksize %"U16_F" windowsize %"U16_F"\n",
+                                                filename, mode, tftp_state.blksize, tftp_state.windowsize));
 
       ip_addr_copy(tftp_state.addr, *addr);
       tftp_state.port = port;
 
       if (opcode == PP_HTONS(TFTP_WRQ)) {
         tftp_state.mode_write = 1;
-        send_ack(0);
+        tftp_state.oack_pending = 0;
+        tftp_state.blknum = 1;
+        /* an OACK replaces the ACK of block 0 */
+        if (tftp_state.options != 0) {
+          send_oack();
+        } else {
+          send_ack(0);
+        }
+        tftp_state.xmit_time = sys_now();
+        restart_timer();
       } else {
         tftp_state.mode_write = 0;
-        send_data();
+        if (tftp_state.options != 0) {
+          /* wait for ACK of block 0 before sending data */
+          tftp_state.oack_pending = 1;
+          send_oack();
+          tftp_state.xmit_time = sys_now();
+          restart_timer();
+        } else {
+          tftp_state.oack_pending = 0;
+          send_window();
+        }
       }
 
       break;
@@ -295,33 +544,54 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
 
       blknum = lwip_ntohs(sbuf[1]);
       if (blknum == tftp_state.blknum) {
+        u8_t lastpkt;
+
+        if ((tftp_state.win_count == 0) && (tftp_state.retries == 0)) {
+          update_rto(sys_now() - tftp_state.xmit_time);
+        }
+        tftp_state.retries = 0;
+        tftp_state.gap_acked = 0;
+
         pbuf_remove_header(p, TFTP_HEADER_LENGTH);
+        lastpkt = p->tot_len < tftp_state.blksize;
 
         ret = tftp_state.ctx->write(tftp_state.handle, p);
         if (ret < 0) {
           send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "error writing file");
           close_handle();
-        } else {
+          break;
+        }
+
+        /* acknowledge once per window, and always the last block */
+        tftp_state.win_count++;
+        if (lastpkt || (tftp_state.win_count >= tftp_state.windowsize)) {
           send_ack(blknum);
+          tftp_state.win_count = 0;
+          tftp_state.xmit_time = sys_now();
         }
 
-        if (p->tot_len < TFTP_MAX_PAYLOAD_SIZE) {
+        if (lastpkt) {
           close_handle();
         } else {
           tftp_state.blknum++;
+          restart_timer();
         }
-      } else if ((u16_t)(blknum + 1) == tftp_state.blknum) {
-        /* retransmit of previous block, ack again (casting to u16_t to care for overflow) */
-        send_ack(blknum);
-      } else {
-        send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
+      } else if ((tftp_state.windowsize == 1) || !tftp_state.gap_acked) {
+        /* retransmit of a previous block or a block was lost: acknowledge the last
+           block received in order so the client restarts from there (casting to
+           u16_t to care for overflow) */
+        send_ack((u16_t)(tftp_state.blknum - 1));
+        tftp_state.win_count = 0;
+        tftp_state.gap_acked = 1;
+        tftp_state.xmit_time = sys_now();
       }
       break;
     }
 
     case PP_HTONS(TFTP_ACK): {
       u16_t blknum;
-      int lastpkt;
+      u16_t acked;
+      u16_t i;
 
       if (tftp_state.handle == NULL) {
         send_error(addr, port, TFTP_ERROR_ACCESS_VIOLATION, "No connection");
@@ -334,27 +604,62 @@ recv(void *arg, struct udp_pcb *upcb, struct pbuf *p, const ip_addr_t *addr, u16
       }
 
       blknum = lwip_ntohs(sbuf[1]);
-      if (blknum != tftp_state.blknum) {
-        send_error(addr, port, TFTP_ERROR_UNKNOWN_TRFR_ID, "Wrong block number");
+
+      if (tftp_state.oack_pending) {
+        if (blknum == 0) {
+          if (tftp_state.retries == 0) {
+            update_rto(sys_now() - tftp_state.xmit_time);
+          }
+          tftp_state.retries = 0;
+          tftp_state.oack_pending = 0;
+          send_window();
+        }
+        break;
+      }
+
+      /* casting to u16_t to care for overflow */
+      acked = (u16_t)(blknum - tftp_state.blknum);
+      if ((acked == 0) || (acked > tftp_state.win_count)) {
+        /* duplicate or stale ACK: ignore it, do not resend (Sorcerer's Apprentice) */
+        LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_TRACE, ("tftp: ignoring ACK %"U16_F"\n", blknum));
         break;
       }
 
-      lastpkt = 0;
+      if (tftp_state.retries == 0) {
+        update_rto(sys_now() - tftp_state.xmit_time);
+      }
+      tftp_state.retries = 0;
 
-      if (tftp_state.last_data != NULL) {
-        lastpkt = tftp_state.last_data->tot_len != (TFTP_MAX_PAYLOAD_SIZE + TFTP_HEADER_LENGTH);
+      /* release acknowledged blocks, the rest of the window is sent again */
+      for (i = 0; i < acked; i++) {
+        pbuf_free(tftp_state.window[i]);
+      }
+      for (i = acked; i < tftp_state.win_count; i++) {
+        tftp_state.window[i - acked] = tftp_state.window[i];
+      }
+      for (i = (u16_t)(tftp_state.win_count - acked); i < tftp_state.win_count; i++) {
+        tftp_state.window[i] = NULL;
       }
+      tftp_state.win_count = (u16_t)(tftp_state.win_count - acked);
+      tftp_state.blknum = blknum;
 
-      if (!lastpkt) {
-        tftp_state.blknum++;
-        send_data();
-      } else {
+      if (tftp_state.eof && (tftp_state.win_count == 0)) {
         close_handle();
+      } else {
+        send_window();
       }
 
       break;
     }
 
+    case PP_HTONS(TFTP_ERROR):
+      /* e.g. the client rejected our OACK; never answer an error with an error */
+      if (tftp_state.handle != NULL) {
+        LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: error %"U16_F" from client\n", lwip_ntohs(sbuf[1])));
+        close_handle();
+      }
+      break;
+
     default:
       send_error(addr, port, TFTP_ERROR_ILLEGAL_OPERATION, "Unknown operation");
       break;
@@ -368,23 +673,33 @@ tftp_tmr(void *arg)
 {
   LWIP_UNUSED_ARG(arg);
 
-  tftp_state.timer++;
-
   if (tftp_state.handle == NULL) {
     return;
   }
 
-  sys_timeout(TFTP_TIMER_MSECS, tftp_tmr, NULL);
+  if (tftp_state.retries < TFTP_MAX_RETRIES) {
+    LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout, retrying\n"));
+    tftp_state.retries++;
+    /* exponential backoff; no RTT samples are taken until the peer answers */
+    tftp_state.rto = LWIP_MIN(tftp_state.rto * 2, TFTP_TIMEOUT_MSECS);
 
-  if ((tftp_state.timer - tftp_state.last_pkt) > (TFTP_TIMEOUT_MSECS / TFTP_TIMER_MSECS)) {
-    if ((tftp_state.last_data != NULL) && (tftp_state.retries < TFTP_MAX_RETRIES)) {
-      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout, retrying\n"));
-      resend_data();
-      tftp_state.retries++;
+    if (tftp_state.mode_write) {
+      if ((tftp_state.blknum == 1) && (tftp_state.options != 0)) {
+        send_oack();
+      } else {
+        send_ack((u16_t)(tftp_state.blknum - 1));
+      }
+      tftp_state.win_count = 0;
+      restart_timer();
+    } else if (tftp_state.oack_pending) {
+      send_oack();
+      restart_timer();
     } else {
-      LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout\n"));
-      close_handle();
+      send_window();
     }
+  } else {
+    LWIP_DEBUGF(TFTP_DEBUG | LWIP_DBG_STATE, ("tftp: timeout\n"));
+    close_handle();
   }
 }
 
@@ -412,8 +727,7 @@ tftp_init(const struct tftp_context *ctx)
   tftp_state.handle    = NULL;
   tftp_state.port      = 0;
   tftp_state.ctx       = ctx;
-  tftp_state.timer     = 0;
-  tftp_state.last_data = NULL;
+  tftp_state.win_count = 0;
   tftp_state.upcb      = pcb;
 
   udp_recv(pcb, recv, NULL);
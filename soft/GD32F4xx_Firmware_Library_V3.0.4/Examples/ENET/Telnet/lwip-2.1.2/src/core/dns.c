@@ -119,8 +119,13 @@ static u16_t dns_txid;
 #error DNS_MAX_TTL must be a positive 32-bit value
 #endif
 
-#if DNS_TABLE_SIZE > 255
-#error DNS_TABLE_SIZE must fit into an u8_t
+#if DNS_TABLE_SIZE > 254
+#error DNS_TABLE_SIZE must fit into an u8_t (index + 1 is stored in hash chains)
+#endif
+
+/** Number of hash buckets used to look up names in the DNS table */
+#ifndef DNS_TABLE_HASH_SIZE
+#define DNS_TABLE_HASH_SIZE       DNS_TABLE_SIZE
 #endif
 #if DNS_MAX_SERVERS > 255
 #error DNS_MAX_SERVERS must fit into an u8_t
@@ -163,6 +168,11 @@ static u16_t dns_txid;
 #if LWIP_IPV4 && LWIP_IPV6
 #define LWIP_DNS_ADDRTYPE_IS_IPV6(t) (((t) == LWIP_DNS_ADDRTYPE_IPV6_IPV4) || ((t) == LWIP_DNS_ADDRTYPE_IPV6))
 #define LWIP_DNS_ADDRTYPE_MATCH_IP(t, ip) (IP_IS_V6_VAL(ip) ? LWIP_DNS_ADDRTYPE_IS_IPV6(t) : (!LWIP_DNS_ADDRTYPE_IS_IPV6(t)))
+#define LWIP_DNS_ADDRTYPE_IS_DUAL(t) (((t) == LWIP_DNS_ADDRTYPE_IPV4_IPV6) || ((t) == LWIP_DNS_ADDRTYPE_IPV6_IPV4))
+/* negative entries carry the address family in reqaddrtype only */
+#define LWIP_DNS_ENTRY_MATCH(e, t) ((e)->negative ? \
+  (LWIP_DNS_ADDRTYPE_IS_IPV6((e)->reqaddrtype) == LWIP_DNS_ADDRTYPE_IS_IPV6(t)) : \
+  LWIP_DNS_ADDRTYPE_MATCH_IP(t, (e)->ipaddr))
 #define LWIP_DNS_ADDRTYPE_ARG(x) , x
 #define LWIP_DNS_ADDRTYPE_ARG_OR_ZERO(x) x
 #define LWIP_DNS_SET_ADDRTYPE(x, y) do { x = y; } while(0)
@@ -173,6 +183,7 @@ static u16_t dns_txid;
 #define LWIP_DNS_ADDRTYPE_IS_IPV6(t) 0
 #endif
 #define LWIP_DNS_ADDRTYPE_MATCH_IP(t, ip) 1
+#define LWIP_DNS_ENTRY_MATCH(e, t) 1
 #define LWIP_DNS_ADDRTYPE_ARG(x)
 #define LWIP_DNS_ADDRTYPE_ARG_OR_ZERO(x) 0
 #define LWIP_DNS_SET_ADDRTYPE(x, y)
@@ -218,14 +229,26 @@ typedef enum {
 
 /** DNS table entry */
 struct dns_table_entry {
-  u32_t ttl;
+  /* DONE entries: value of dns_now at which the entry expires */
+  u32_t expires;
+  /* case insensitive hash of the name */
+  u32_t hash;
   ip_addr_t ipaddr;
   u16_t txid;
   u8_t  state;
   u8_t  server_idx;
   u8_t  tmr;
   u8_t  retries;
-  u8_t  seqno;
+  /* next entry (index + 1) in the same hash bucket, 0: end of chain */
+  u8_t  hash_next;
+  /* DONE entries: position in the expiry heap */
+  u8_t  heap_idx;
+  /* DONE entries: 1 if this caches a failed lookup */
+  u8_t  negative;
+#if LWIP_IPV4 && LWIP_IPV6
+  /* entry (index + 1) querying the other address type in parallel, 0: none */
+  u8_t  sibling;
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
 #if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_RAND_SRC_PORT) != 0)
   u8_t pcb_idx;
 #endif
@@ -285,6 +308,8 @@ static err_t dns_lookup_local(const char *hostname, ip_addr_t *addr LWIP_DNS_ADD
 static void dns_recv(void *s, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port);
 static void dns_check_entries(void);
 static void dns_call_found(u8_t idx, ip_addr_t *addr);
+static void dns_free_entry(u8_t idx);
+static void dns_query_failed(u8_t idx, u32_t ttl);
 
 /*-----------------------------------------------------------------------------
  * Globals
@@ -295,8 +320,14 @@ static struct udp_pcb        *dns_pcbs[DNS_MAX_SOURCE_PORTS];
 #if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_RAND_SRC_PORT) != 0)
 static u8_t                   dns_last_pcb_idx;
 #endif
-static u8_t                   dns_seqno;
 static struct dns_table_entry dns_table[DNS_TABLE_SIZE];
+/* hash buckets: index + 1 of the first entry, 0: empty */
+static u8_t                   dns_hash_buckets[DNS_TABLE_HASH_SIZE];
+/* DONE entries as a binary min-heap ordered by expiry time */
+static u8_t                   dns_heap[DNS_TABLE_SIZE];
+static u8_t                   dns_heap_len;
+/* seconds since startup, incremented by dns_tmr */
+static u32_t                  dns_now;
 static struct dns_req_entry   dns_requests[DNS_MAX_REQUESTS];
 static ip_addr_t              dns_servers[DNS_MAX_SERVERS];
 
@@ -387,6 +418,195 @@ dns_getserver(u8_t numdns)
   }
 }
 
+/* DNS table management: all used entries are kept in hash chains by name,
+ * completed (DONE) entries additionally in a min-heap ordered by expiry time */
+
+#define DNS_HASH_FIRST(hash)      ((u8_t)(dns_hash_buckets[(hash) % DNS_TABLE_HASH_SIZE] - 1))
+#define DNS_HASH_NEXT(i)          ((u8_t)(dns_table[i].hash_next - 1))
+#define DNS_TIME_REACHED(t)       ((s32_t)(dns_now - (t)) >= 0)
+#define DNS_EXPIRES_BEFORE(a, b)  ((s32_t)(dns_table[a].expires - dns_table[b].expires) < 0)
+
+/** Case insensitive FNV-1a hash of a host name */
+static u32_t
+dns_hash_name(const char *name)
+{
+  u32_t hash = 2166136261UL;
+
+  for (; *name != 0; name++) {
+    hash ^= (u8_t)lwip_tolower((unsigned char)*name);
+    hash *= 16777619UL;
+  }
+  return hash;
+}
+
+static void
+dns_hash_link(u8_t idx)
+{
+  u8_t *head = &dns_hash_buckets[dns_table[idx].hash % DNS_TABLE_HASH_SIZE];
+
+  dns_table[idx].hash_next = *head;
+  *head = (u8_t)(idx + 1);
+}
+
+static void
+dns_hash_unlink(u8_t idx)
+{
+  u8_t *link = &dns_hash_buckets[dns_table[idx].hash % DNS_TABLE_HASH_SIZE];
+
+  while (*link != 0) {
+    if (*link == idx + 1) {
+      *link = dns_table[idx].hash_next;
+      return;
+    }
+    link = &dns_table[*link - 1].hash_next;
+  }
+  LWIP_ASSERT("dns entry not in hash chain", 0);
+}
+
+static void
+dns_heap_set(u8_t pos, u8_t idx)
+{
+  dns_heap[pos] = idx;
+  dns_table[idx].heap_idx = pos;
+}
+
+static void
+dns_heap_up(u8_t pos)
+{
+  u8_t idx = dns_heap[pos];
+
+  while (pos > 0) {
+    u8_t parent = (u8_t)((pos - 1) / 2);
+    if (!DNS_EXPIRES_BEFORE(idx, dns_heap[parent])) {
+      break;
+    }
+    dns_heap_set(pos, dns_heap[parent]);
+    pos = parent;
+  }
+  dns_heap_set(pos, idx);
+}
+
+static void
+dns_heap_down(u8_t pos)
+{
+  u8_t idx = dns_heap[pos];
+
+  for (;;) {
+    u16_t child = (u16_t)(2 * pos + 1);
+    if (child >= dns_heap_len) {
+      break;
+    }
+    if ((child + 1 < dns_heap_len) && DNS_EXPIRES_BEFORE(dns_heap[child + 1], dns_heap[child])) {
+      child++;
+    }
+    if (!DNS_EXPIRES_BEFORE(dns_heap[child], idx)) {
+      break;
+    }
+    dns_heap_set(pos, dns_heap[child]);
+    pos = (u8_t)child;
+  }
+  dns_heap_set(pos, idx);
+}
+
+static void
+dns_heap_insert(u8_t idx)
+{
+  u8_t pos;
+
+  LWIP_ASSERT("dns heap overflow", dns_heap_len < DNS_TABLE_SIZE);
+  pos = dns_heap_len++;
+  dns_heap[pos] = idx;
+  dns_heap_up(pos);
+}
+
+static void
+dns_heap_remove(u8_t idx)
+{
+  u8_t pos = dns_table[idx].heap_idx;
+  u8_t last;
+
+  LWIP_ASSERT("dns entry not in heap", (pos < dns_heap_len) && (dns_heap[pos] == idx));
+  last = dns_heap[--dns_heap_len];
+  if (pos < dns_heap_len) {
+    dns_heap[pos] = last;
+    dns_heap_up(pos);
+    dns_heap_down(dns_table[last].heap_idx);
+  }
+}
+
+/**
+ * Mark a pending entry as completed and cache it for 'ttl' seconds.
+ *
+ * @param idx the DNS table entry index
+ * @param ttl time to live in seconds (limited to DNS_MAX_TTL)
+ * @param negative 1 if the entry caches a failed lookup
+ */
+static void
+dns_cache_entry(u8_t idx, u32_t ttl, u8_t negative)
+{
+  struct dns_table_entry *entry = &dns_table[idx];
+
+  LWIP_ASSERT("dns entry already cached", entry->state != DNS_STATE_DONE);
+  if (ttl > DNS_MAX_TTL) {
+    ttl = DNS_MAX_TTL;
+  }
+  entry->state = DNS_STATE_DONE;
+  entry->negative = negative;
+  entry->expires = dns_now + ttl;
+  dns_heap_insert(idx);
+}
+
+/**
+ * Remove an entry from the hash chains (and the expiry heap) and mark it unused.
+ * Pending requests and pcbs must have been released by the caller.
+ */
+static void
+dns_free_entry(u8_t idx)
+{
+  struct dns_table_entry *entry = &dns_table[idx];
+
+  if (entry->state == DNS_STATE_UNUSED) {
+    return;
+  }
+  if (entry->state == DNS_STATE_DONE) {
+    dns_heap_remove(idx);
+  }
+  dns_hash_unlink(idx);
+#if LWIP_IPV4 && LWIP_IPV6
+  if (entry->sibling != 0) {
+    dns_table[entry->sibling - 1].sibling = 0;
+    entry->sibling = 0;
+  }
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
+  entry->negative = 0;
+  entry->state = DNS_STATE_UNUSED;
+}
+
+/**
+ * Get an unused table entry. If the table is full, the completed entry that
+ * would expire first is reused.
+ *
+ * @return index of the entry or DNS_TABLE_SIZE if all entries are pending
+ */
+static u8_t
+dns_alloc_entry(void)
+{
+  u8_t i;
+
+  for (i = 0; i < DNS_TABLE_SIZE; ++i) {
+    if (dns_table[i].state == DNS_STATE_UNUSED) {
+      return i;
+    }
+  }
+  if (dns_heap_len > 0) {
+    i = dns_heap[0];
+    LWIP_DEBUGF(DNS_DEBUG, ("dns_alloc_entry: \"%s\": evicted\n", dns_table[i].name));
+    dns_free_entry(i);
+    return i;
+  }
+  return DNS_TABLE_SIZE;
+}
+
 /**
  * The DNS resolver client timer - handle retries and timeouts and should
  * be called every DNS_TMR_INTERVAL milliseconds (every second by default).
@@ -394,6 +614,12 @@ dns_getserver(u8_t numdns)
 void
 dns_tmr(void)
 {
+  dns_now++;
+  /* flush cached entries whose time to live has expired */
+  while ((dns_heap_len > 0) && DNS_TIME_REACHED(dns_table[dns_heap[0]].expires)) {
+    LWIP_DEBUGF(DNS_DEBUG, ("dns_tmr: \"%s\": flush\n", dns_table[dns_heap[0]].name));
+    dns_free_entry(dns_heap[0]);
+  }
   LWIP_DEBUGF(DNS_DEBUG, ("dns_tmr: dns_check_entries\n"));
   dns_check_entries();
 }
@@ -596,12 +822,13 @@ dns_local_addhost(const char *hostname, const ip_addr_t *addr)
  * @param addr the hostname's IP address, as u32_t (instead of ip_addr_t to
  *         better check for failure: != IPADDR_NONE) or IPADDR_NONE if the hostname
  *         was not found in the cached dns_table.
- * @return ERR_OK if found, ERR_ARG if not found
+ * @return ERR_OK if found, ERR_VAL if a failed lookup is cached, ERR_ARG if not found
  */
 static err_t
 dns_lookup(const char *name, ip_addr_t *addr LWIP_DNS_ADDRTYPE_ARG(u8_t dns_addrtype))
 {
   u8_t i;
+  u32_t hash;
 #if DNS_LOCAL_HOSTLIST
   if (dns_lookup_local(name, addr LWIP_DNS_ADDRTYPE_ARG(dns_addrtype)) == ERR_OK) {
     return ERR_OK;
@@ -613,11 +840,16 @@ dns_lookup(const char *name, ip_addr_t *addr LWIP_DNS_ADDRTYPE_ARG(u8_t dns_addr
   }
 #endif /* DNS_LOOKUP_LOCAL_EXTERN */
 
-  /* Walk through name list, return entry if found. If not, return NULL. */
-  for (i = 0; i < DNS_TABLE_SIZE; ++i) {
-    if ((dns_table[i].state == DNS_STATE_DONE) &&
-        (lwip_strnicmp(name, dns_table[i].name, sizeof(dns_table[i].name)) == 0) &&
-        LWIP_DNS_ADDRTYPE_MATCH_IP(dns_addrtype, dns_table[i].ipaddr)) {
+  /* Walk through the hash chain of this name, return entry if found. */
+  hash = dns_hash_name(name);
+  for (i = DNS_HASH_FIRST(hash); i < DNS_TABLE_SIZE; i = DNS_HASH_NEXT(i)) {
+    if ((dns_table[i].state == DNS_STATE_DONE) && (dns_table[i].hash == hash) &&
+        LWIP_DNS_ENTRY_MATCH(&dns_table[i], dns_addrtype) &&
+        (lwip_strnicmp(name, dns_table[i].name, sizeof(dns_table[i].name)) == 0)) {
+      if (dns_table[i].negative) {
+        LWIP_DEBUGF(DNS_DEBUG, ("dns_lookup: \"%s\": cached failure\n", name));
+        return ERR_VAL;
+      }
       LWIP_DEBUGF(DNS_DEBUG, ("dns_lookup: \"%s\": found = ", name));
       ip_addr_debug_print_val(DNS_DEBUG, dns_table[i].ipaddr);
       LWIP_DEBUGF(DNS_DEBUG, ("\n"));
@@ -719,6 +951,9 @@ dns_skip_name(struct pbuf *p, u16_t query_idx)
     if ((n & 0xc0) == 0xc0) {
       /* Compressed name: since we only want to skip it (not check it), stop here */
       break;
+    } else if (n == 0) {
+      /* root name (e.g. in SOA records) */
+      return offset;
     } else {
       /* Not compressed name */
       if (offset + n >= p->tot_len) {
@@ -766,10 +1001,8 @@ dns_send(u8_t idx)
 #endif
      ) {
     /* DNS server not valid anymore, e.g. PPP netif has been shut down */
-    /* call specified callback function if provided */
-    dns_call_found(idx, NULL);
-    /* flush this entry */
-    entry->state = DNS_STATE_UNUSED;
+    /* call specified callback function if provided and flush this entry */
+    dns_query_failed(idx, 0);
     return ERR_OK;
   }
 
@@ -945,19 +1178,6 @@ dns_call_found(u8_t idx, ip_addr_t *addr)
   u8_t i;
 #endif
 
-#if LWIP_IPV4 && LWIP_IPV6
-  if (addr != NULL) {
-    /* check that address type matches the request and adapt the table entry */
-    if (IP_IS_V6_VAL(*addr)) {
-      LWIP_ASSERT("invalid response", LWIP_DNS_ADDRTYPE_IS_IPV6(dns_table[idx].reqaddrtype));
-      dns_table[idx].reqaddrtype = LWIP_DNS_ADDRTYPE_IPV6;
-    } else {
-      LWIP_ASSERT("invalid response", !LWIP_DNS_ADDRTYPE_IS_IPV6(dns_table[idx].reqaddrtype));
-      dns_table[idx].reqaddrtype = LWIP_DNS_ADDRTYPE_IPV4;
-    }
-  }
-#endif /* LWIP_IPV4 && LWIP_IPV6 */
-
 #if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_NO_MULTIPLE_OUTSTANDING) != 0)
   for (i = 0; i < DNS_MAX_REQUESTS; i++) {
     if (dns_requests[i].found && (dns_requests[i].dns_table_idx == idx)) {
@@ -974,7 +1194,7 @@ dns_call_found(u8_t idx, ip_addr_t *addr)
 #endif
 #if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_RAND_SRC_PORT) != 0)
   /* close the pcb used unless other request are using it */
-  for (i = 0; i < DNS_MAX_REQUESTS; i++) {
+  for (i = 0; i < DNS_TABLE_SIZE; i++) {
     if (i == idx) {
       continue; /* only check other requests */
     }
@@ -995,6 +1215,88 @@ dns_call_found(u8_t idx, ip_addr_t *addr)
 #endif
 }
 
+#if LWIP_IPV4 && LWIP_IPV6
+/**
+ * Hand the requests of an entry that accept both address types over to the
+ * entry querying the other address type: they get its address if that has
+ * been resolved already, or wait for its answer if it is still pending.
+ * Requests for one address type only are left untouched.
+ *
+ * @param idx dns table index of the entry (must have a sibling)
+ */
+static void
+dns_pass_to_sibling(u8_t idx)
+{
+  u8_t s = (u8_t)(dns_table[idx].sibling - 1);
+  u8_t r;
+  ip_addr_t addr;
+
+  LWIP_ASSERT("no sibling", s < DNS_TABLE_SIZE);
+  if (dns_table[s].state == DNS_STATE_DONE) {
+    if (dns_table[s].negative) {
+      /* both address types failed */
+      return;
+    }
+    /* copy the address, the callbacks may reuse the sibling entry */
+    ip_addr_copy(addr, dns_table[s].ipaddr);
+  }
+#if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_NO_MULTIPLE_OUTSTANDING) != 0)
+  for (r = 0; r < DNS_MAX_REQUESTS; r++) {
+    if (dns_requests[r].found && (dns_requests[r].dns_table_idx == idx) &&
+        LWIP_DNS_ADDRTYPE_IS_DUAL(dns_requests[r].reqaddrtype)) {
+      if (dns_table[s].state == DNS_STATE_DONE) {
+        dns_found_callback found = dns_requests[r].found;
+        dns_requests[r].found = NULL;
+        found(dns_table[idx].name, &addr, dns_requests[r].arg);
+      } else {
+        dns_requests[r].dns_table_idx = s;
+      }
+    }
+  }
+#else
+  r = idx;
+  if (dns_requests[r].found && LWIP_DNS_ADDRTYPE_IS_DUAL(dns_requests[r].reqaddrtype)) {
+    dns_found_callback found = dns_requests[r].found;
+    dns_requests[r].found = NULL;
+    if (dns_table[s].state == DNS_STATE_DONE) {
+      found(dns_table[idx].name, &addr, dns_requests[r].arg);
+    } else {
+      /* in this configuration, the request index is the entry index */
+      LWIP_ASSERT("sibling request in use", dns_requests[s].found == NULL);
+      dns_requests[s].found = found;
+      dns_requests[s].arg = dns_requests[r].arg;
+      dns_requests[s].reqaddrtype = dns_requests[r].reqaddrtype;
+    }
+  }
+#endif
+}
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
+
+/**
+ * A query failed (timeout, error response or no address of the requested
+ * type): inform the requests and cache the failure.
+ *
+ * @param idx dns table index of the entry that failed
+ * @param ttl time in seconds the failure is cached (0: flush the entry)
+ */
+static void
+dns_query_failed(u8_t idx, u32_t ttl)
+{
+#if LWIP_IPV4 && LWIP_IPV6
+  if (dns_table[idx].sibling != 0) {
+    dns_pass_to_sibling(idx);
+  }
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
+  dns_call_found(idx, NULL);
+  /* a pending entry cannot be reused by the callbacks */
+  if (ttl > 0) {
+    LWIP_DEBUGF(DNS_DEBUG, ("dns_query_failed: \"%s\": cached for %"U32_F" s\n", dns_table[idx].name, ttl));
+    dns_cache_entry(idx, ttl, 1);
+  } else {
+    dns_free_entry(idx);
+  }
+}
+
 /* Create a query transmission ID that is unique for all outstanding queries */
 static u16_t
 dns_create_txid(void)
@@ -1039,7 +1341,8 @@ dns_backupserver_available(struct dns_table_entry *pentry)
  * Check an entry in the dns_table:
  * - send out query for new entries
  * - retry old pending entries on timeout (also with different servers)
- * - remove completed entries from the table if their TTL has expired
+ * - let requests for both address types use the other type's address if
+ *   that has been resolved while this one is still pending
  *
  * @param i index of the dns_table entry to check
  */
@@ -1068,6 +1371,11 @@ dns_check_entry(u8_t i)
       }
       break;
     case DNS_STATE_ASKING:
+#if LWIP_IPV4 && LWIP_IPV6
+      if ((entry->sibling != 0) && (dns_table[entry->sibling - 1].state == DNS_STATE_DONE)) {
+        dns_pass_to_sibling(i);
+      }
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
       if (--entry->tmr == 0) {
         if (++entry->retries == DNS_MAX_RETRIES) {
           if (dns_backupserver_available(entry)
@@ -1082,9 +1390,7 @@ dns_check_entry(u8_t i)
           } else {
             LWIP_DEBUGF(DNS_DEBUG, ("dns_check_entry: \"%s\": timeout\n", entry->name));
             /* call specified callback function if provided */
-            dns_call_found(i, NULL);
-            /* flush this entry */
-            entry->state = DNS_STATE_UNUSED;
+            dns_query_failed(i, DNS_FAIL_CACHE_TTL);
             break;
           }
         } else {
@@ -1101,12 +1407,7 @@ dns_check_entry(u8_t i)
       }
       break;
     case DNS_STATE_DONE:
-      /* if the time to live is nul */
-      if ((entry->ttl == 0) || (--entry->ttl == 0)) {
-        LWIP_DEBUGF(DNS_DEBUG, ("dns_check_entry: \"%s\": flush\n", entry->name));
-        /* flush this entry, there cannot be any related pending entries in this state */
-        entry->state = DNS_STATE_UNUSED;
-      }
+      /* expiry is handled by dns_tmr */
       break;
     case DNS_STATE_UNUSED:
       /* nothing to do */
@@ -1138,31 +1439,84 @@ dns_correct_response(u8_t idx, u32_t ttl)
 {
   struct dns_table_entry *entry = &dns_table[idx];
 
-  entry->state = DNS_STATE_DONE;
+#if LWIP_IPV4 && LWIP_IPV6
+  /* check that address type matches the request and adapt the table entry */
+  if (IP_IS_V6_VAL(entry->ipaddr)) {
+    LWIP_ASSERT("invalid response", LWIP_DNS_ADDRTYPE_IS_IPV6(entry->reqaddrtype));
+    entry->reqaddrtype = LWIP_DNS_ADDRTYPE_IPV6;
+  } else {
+    LWIP_ASSERT("invalid response", !LWIP_DNS_ADDRTYPE_IS_IPV6(entry->reqaddrtype));
+    entry->reqaddrtype = LWIP_DNS_ADDRTYPE_IPV4;
+  }
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
 
   LWIP_DEBUGF(DNS_DEBUG, ("dns_recv: \"%s\": response = ", entry->name));
   ip_addr_debug_print_val(DNS_DEBUG, entry->ipaddr);
   LWIP_DEBUGF(DNS_DEBUG, ("\n"));
 
-  /* read the answer resource record's TTL, and maximize it if needed */
-  entry->ttl = ttl;
-  if (entry->ttl > DNS_MAX_TTL) {
-    entry->ttl = DNS_MAX_TTL;
-  }
+  /* cache the answer for the resource record's TTL (maximized if needed) */
+  dns_cache_entry(idx, ttl, 0);
   dns_call_found(idx, &entry->ipaddr);
 
-  if (entry->ttl == 0) {
+  if (ttl == 0) {
     /* RFC 883, page 29: "Zero values are
        interpreted to mean that the RR can only be used for the
        transaction in progress, and should not be cached."
        -> flush this entry now */
     /* entry reused during callback? */
-    if (entry->state == DNS_STATE_DONE) {
-      entry->state = DNS_STATE_UNUSED;
+    if ((entry->state == DNS_STATE_DONE) && (entry->expires == dns_now)) {
+      dns_free_entry(idx);
     }
   }
 }
 
+/**
+ * Get the time a negative answer may be cached (RFC 2308 chapter 5): the
+ * minimum of the TTL of the SOA record in the authority section and its
+ * MINIMUM field, limited to DNS_NEG_CACHE_TTL.
+ *
+ * @param p pbuf containing the DNS response
+ * @param res_idx offset into p where the remaining answer records start
+ * @param nanswers number of answer records left before the authority section
+ * @param nauthrr number of authority records
+ * @return time in seconds the negative answer may be cached
+ */
+static u32_t
+dns_negative_ttl(struct pbuf *p, u16_t res_idx, u16_t nanswers, u16_t nauthrr)
+{
+  struct dns_answer ans;
+  u32_t rr, minimum;
+  u16_t idx;
+
+  for (rr = 0; rr < (u32_t)nanswers + nauthrr; rr++) {
+    res_idx = dns_skip_name(p, res_idx);
+    if ((res_idx == 0xFFFF) || (res_idx + SIZEOF_DNS_ANSWER > 0xFFFF) ||
+        (pbuf_copy_partial(p, &ans, SIZEOF_DNS_ANSWER, res_idx) != SIZEOF_DNS_ANSWER)) {
+      break;
+    }
+    res_idx = (u16_t)(res_idx + SIZEOF_DNS_ANSWER);
+    if ((rr >= nanswers) && (ans.type == PP_HTONS(DNS_RRTYPE_SOA)) &&
+        (ans.cls == PP_HTONS(DNS_RRCLASS_IN))) {
+      /* skip MNAME and RNAME: MINIMUM is the last of 5 32-bit fields */
+      idx = dns_skip_name(p, res_idx);
+      if (idx != 0xFFFF) {
+        idx = dns_skip_name(p, idx);
+      }
+      if ((idx == 0xFFFF) || (idx + 20 > 0xFFFF) ||
+          (pbuf_copy_partial(p, &minimum, sizeof(minimum), (u16_t)(idx + 16)) != sizeof(minimum))) {
+        break;
+      }
+      minimum = LWIP_MIN(lwip_ntohl(minimum), lwip_ntohl(ans.ttl));
+      return LWIP_MIN(minimum, DNS_NEG_CACHE_TTL);
+    }
+    if ((int)(res_idx + lwip_htons(ans.len)) > 0xFFFF) {
+      break;
+    }
+    res_idx = (u16_t)(res_idx + lwip_htons(ans.len));
+  }
+  return DNS_NEG_CACHE_TTL;
+}
+
 /**
  * Receive input function for DNS response packets arriving for the dns UDP pcb.
  */
@@ -1176,6 +1530,7 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr,
   struct dns_answer ans;
   struct dns_query qry;
   u16_t nquestions, nanswers;
+  u32_t neg_ttl;
 
   LWIP_UNUSED_ARG(arg);
   LWIP_UNUSED_ARG(pcb);
@@ -1264,6 +1619,13 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr,
 
             goto ignore_packet;
           }
+          if ((hdr.flags2 & DNS_FLAG2_ERR_MASK) == DNS_FLAG2_ERR_NAME) {
+            /* the name does not exist */
+            neg_ttl = dns_negative_ttl(p, res_idx, nanswers, lwip_htons(hdr.numauthrr));
+          } else {
+            /* server failure or refused */
+            neg_ttl = DNS_FAIL_CACHE_TTL;
+          }
         } else {
           while ((nanswers > 0) && (res_idx < p->tot_len)) {
             /* skip answer resource record's host name */
@@ -1346,11 +1708,12 @@ dns_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr,
           }
 #endif /* LWIP_IPV4 && LWIP_IPV6 */
           LWIP_DEBUGF(DNS_DEBUG, ("dns_recv: \"%s\": error in response\n", entry->name));
+          /* no address of the requested type */
+          neg_ttl = (res_idx < p->tot_len) ? dns_negative_ttl(p, res_idx, nanswers, lwip_htons(hdr.numauthrr)) : DNS_NEG_CACHE_TTL;
         }
         /* call callback to indicate error, clean up memory and return */
         pbuf_free(p);
-        dns_call_found(i, NULL);
-        dns_table[i].state = DNS_STATE_UNUSED;
+        dns_query_failed(i, neg_ttl);
         return;
       }
     }
@@ -1362,6 +1725,74 @@ ignore_packet:
   return;
 }
 
+#if LWIP_IPV4 && LWIP_IPV6
+#if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_NO_MULTIPLE_OUTSTANDING) != 0)
+/**
+ * Check whether a request for 'dns_addrtype' can wait for the query of an entry:
+ * requests for both address types can join the query of their preferred type
+ * if the other type is queried in parallel.
+ */
+static u8_t
+dns_entry_serves(u8_t idx, u8_t dns_addrtype)
+{
+  struct dns_table_entry *entry = &dns_table[idx];
+
+  if (entry->reqaddrtype == dns_addrtype) {
+    return 1;
+  }
+  return (u8_t)(LWIP_DNS_ADDRTYPE_IS_DUAL(dns_addrtype) && (entry->sibling != 0) &&
+                (LWIP_DNS_ADDRTYPE_IS_IPV6(entry->reqaddrtype) == LWIP_DNS_ADDRTYPE_IS_IPV6(dns_addrtype)));
+}
+#endif /* ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_NO_MULTIPLE_OUTSTANDING) != 0) */
+
+#if DNS_PARALLEL_QUERIES
+/**
+ * Split a query for both address types into two queries sent in parallel:
+ * the entry keeps asking for the preferred type, a sibling entry asks for the
+ * other type. If no entry is left for the sibling, both types are queried one
+ * after the other as before.
+ *
+ * @param idx dns table index of the new entry
+ */
+static void
+dns_add_sibling(u8_t idx)
+{
+  struct dns_table_entry *entry = &dns_table[idx];
+  struct dns_table_entry *sibling;
+  u8_t s;
+
+  s = dns_alloc_entry();
+  if (s >= DNS_TABLE_SIZE) {
+    LWIP_DEBUGF(DNS_DEBUG, ("dns_add_sibling: \"%s\": table full, querying sequentially\n", entry->name));
+    return;
+  }
+  sibling = &dns_table[s];
+#if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_RAND_SRC_PORT) != 0)
+  sibling->pcb_idx = dns_alloc_pcb();
+  if (sibling->pcb_idx >= DNS_MAX_SOURCE_PORTS) {
+    return;
+  }
+#endif
+  sibling->state = DNS_STATE_NEW;
+  sibling->hash = entry->hash;
+  MEMCPY(sibling->name, entry->name, strlen(entry->name) + 1);
+#if LWIP_DNS_SUPPORT_MDNS_QUERIES
+  sibling->is_mdns = entry->is_mdns;
+#endif
+  if (entry->reqaddrtype == LWIP_DNS_ADDRTYPE_IPV4_IPV6) {
+    entry->reqaddrtype = LWIP_DNS_ADDRTYPE_IPV4;
+    sibling->reqaddrtype = LWIP_DNS_ADDRTYPE_IPV6;
+  } else {
+    entry->reqaddrtype = LWIP_DNS_ADDRTYPE_IPV6;
+    sibling->reqaddrtype = LWIP_DNS_ADDRTYPE_IPV4;
+  }
+  entry->sibling = (u8_t)(s + 1);
+  sibling->sibling = (u8_t)(idx + 1);
+  dns_hash_link(s);
+}
+#endif /* DNS_PARALLEL_QUERIES */
+#endif /* LWIP_IPV4 && LWIP_IPV6 */
+
 /**
  * Queues a new hostname to resolve and sends out a DNS query for that hostname
  *
@@ -1376,19 +1807,23 @@ dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
             void *callback_arg LWIP_DNS_ADDRTYPE_ARG(u8_t dns_addrtype) LWIP_DNS_ISMDNS_ARG(u8_t is_mdns))
 {
   u8_t i;
-  u8_t lseq, lseqi;
+  u32_t hash;
   struct dns_table_entry *entry = NULL;
   size_t namelen;
   struct dns_req_entry *req;
-
 #if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_NO_MULTIPLE_OUTSTANDING) != 0)
   u8_t r;
+#endif
+
+  hash = dns_hash_name(name);
+
+#if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_NO_MULTIPLE_OUTSTANDING) != 0)
   /* check for duplicate entries */
-  for (i = 0; i < DNS_TABLE_SIZE; i++) {
-    if ((dns_table[i].state == DNS_STATE_ASKING) &&
+  for (i = DNS_HASH_FIRST(hash); i < DNS_TABLE_SIZE; i = DNS_HASH_NEXT(i)) {
+    if ((dns_table[i].state == DNS_STATE_ASKING) && (dns_table[i].hash == hash) &&
         (lwip_strnicmp(name, dns_table[i].name, sizeof(dns_table[i].name)) == 0)) {
 #if LWIP_IPV4 && LWIP_IPV6
-      if (dns_table[i].reqaddrtype != dns_addrtype) {
+      if (!dns_entry_serves(i, dns_addrtype)) {
         /* requested address types don't match
            this can lead to 2 concurrent requests, but mixing the address types
            for the same host should not be that common */
@@ -1409,41 +1844,7 @@ dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
     }
   }
   /* no duplicate entries found */
-#endif
 
-  /* search an unused entry, or the oldest one */
-  lseq = 0;
-  lseqi = DNS_TABLE_SIZE;
-  for (i = 0; i < DNS_TABLE_SIZE; ++i) {
-    entry = &dns_table[i];
-    /* is it an unused entry ? */
-    if (entry->state == DNS_STATE_UNUSED) {
-      break;
-    }
-    /* check if this is the oldest completed entry */
-    if (entry->state == DNS_STATE_DONE) {
-      u8_t age = (u8_t)(dns_seqno - entry->seqno);
-      if (age > lseq) {
-        lseq = age;
-        lseqi = i;
-      }
-    }
-  }
-
-  /* if we don't have found an unused entry, use the oldest completed one */
-  if (i == DNS_TABLE_SIZE) {
-    if ((lseqi >= DNS_TABLE_SIZE) || (dns_table[lseqi].state != DNS_STATE_DONE)) {
-      /* no entry can be used now, table is full */
-      LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: \"%s\": DNS entries table is full\n", name));
-      return ERR_MEM;
-    } else {
-      /* use the oldest completed one */
-      i = lseqi;
-      entry = &dns_table[i];
-    }
-  }
-
-#if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_NO_MULTIPLE_OUTSTANDING) != 0)
   /* find a free request entry */
   req = NULL;
   for (r = 0; r < DNS_MAX_REQUESTS; r++) {
@@ -1457,6 +1858,18 @@ dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
     LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: \"%s\": DNS request entries table is full\n", name));
     return ERR_MEM;
   }
+#endif
+
+  /* search an unused entry, or the completed one expiring first */
+  i = dns_alloc_entry();
+  if (i >= DNS_TABLE_SIZE) {
+    /* no entry can be used now, table is full */
+    LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: \"%s\": DNS entries table is full\n", name));
+    return ERR_MEM;
+  }
+  entry = &dns_table[i];
+
+#if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_NO_MULTIPLE_OUTSTANDING) != 0)
   req->dns_table_idx = i;
 #else
   /* in this configuration, the entry index is the same as the request index */
@@ -1468,7 +1881,7 @@ dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
 
   /* fill the entry */
   entry->state = DNS_STATE_NEW;
-  entry->seqno = dns_seqno;
+  entry->hash = hash;
   LWIP_DNS_SET_ADDRTYPE(entry->reqaddrtype, dns_addrtype);
   LWIP_DNS_SET_ADDRTYPE(req->reqaddrtype, dns_addrtype);
   req->found = found;
@@ -1476,13 +1889,14 @@ dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
   namelen = LWIP_MIN(hostnamelen, DNS_MAX_NAME_LENGTH - 1);
   MEMCPY(entry->name, name, namelen);
   entry->name[namelen] = 0;
+  dns_hash_link(i);
 
 #if ((LWIP_DNS_SECURE & LWIP_DNS_SECURE_RAND_SRC_PORT) != 0)
   entry->pcb_idx = dns_alloc_pcb();
   if (entry->pcb_idx >= DNS_MAX_SOURCE_PORTS) {
     /* failed to get a UDP pcb */
     LWIP_DEBUGF(DNS_DEBUG, ("dns_enqueue: \"%s\": failed to allocate a pcb\n", name));
-    entry->state = DNS_STATE_UNUSED;
+    dns_free_entry(i);
     req->found = NULL;
     return ERR_MEM;
   }
@@ -1493,7 +1907,19 @@ dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
   entry->is_mdns = is_mdns;
 #endif
 
-  dns_seqno++;
+#if LWIP_IPV4 && LWIP_IPV6 && DNS_PARALLEL_QUERIES
+  if (LWIP_DNS_ADDRTYPE_IS_DUAL(dns_addrtype)) {
+    u8_t s;
+    dns_add_sibling(i);
+    /* force to send both queries without waiting timer */
+    s = (u8_t)(entry->sibling - 1);
+    dns_check_entry(i);
+    if ((s < DNS_TABLE_SIZE) && (dns_table[s].state == DNS_STATE_NEW)) {
+      dns_check_entry(s);
+    }
+    return ERR_INPROGRESS;
+  }
+#endif /* LWIP_IPV4 && LWIP_IPV6 && DNS_PARALLEL_QUERIES */
 
   /* force to send query without waiting timer */
   dns_check_entry(i);
@@ -1513,6 +1939,8 @@ dns_enqueue(const char *name, size_t hostnamelen, dns_found_callback found,
  * - ERR_INPROGRESS enqueue a request to be sent to the DNS server
  *   for resolution if no errors are present.
  * - ERR_ARG: dns client not initialized or invalid hostname
+ * - ERR_VAL: no DNS server set or a failed lookup of this hostname is
+ *   still cached (see DNS_NEG_CACHE_TTL and DNS_FAIL_CACHE_TTL)
  *
  * @param hostname the hostname that is to be queried
  * @param addr pointer to a ip_addr_t where to store the address if it is already
@@ -1542,12 +1970,19 @@ dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback foun
  *                     - LWIP_DNS_ADDRTYPE_IPV6_IPV4: try to resolve IPv6 first, try IPv4 if IPv6 fails only
  *                     - LWIP_DNS_ADDRTYPE_IPV4: try to resolve IPv4 only
  *                     - LWIP_DNS_ADDRTYPE_IPV6: try to resolve IPv6 only
+ *
+ * With DNS_PARALLEL_QUERIES, both address types of the first two options are
+ * queried at the same time. The preferred type is returned if it resolves; the
+ * other type is returned if the preferred one fails or is still pending at
+ * the first DNS timer tick after the other type has been resolved.
+ * If a failed lookup of one type is cached, only the other type is queried.
  */
 err_t
 dns_gethostbyname_addrtype(const char *hostname, ip_addr_t *addr, dns_found_callback found,
                            void *callback_arg, u8_t dns_addrtype)
 {
   size_t hostnamelen;
+  err_t err;
 #if LWIP_DNS_SUPPORT_MDNS_QUERIES
   u8_t is_mdns;
 #endif
@@ -1587,25 +2022,46 @@ dns_gethostbyname_addrtype(const char *hostname, ip_addr_t *addr, dns_found_call
     }
   }
   /* already have this address cached? */
-  if (dns_lookup(hostname, addr LWIP_DNS_ADDRTYPE_ARG(dns_addrtype)) == ERR_OK) {
+  err = dns_lookup(hostname, addr LWIP_DNS_ADDRTYPE_ARG(dns_addrtype));
+  if (err == ERR_OK) {
     return ERR_OK;
   }
 #if LWIP_IPV4 && LWIP_IPV6
-  if ((dns_addrtype == LWIP_DNS_ADDRTYPE_IPV4_IPV6) || (dns_addrtype == LWIP_DNS_ADDRTYPE_IPV6_IPV4)) {
+  if (LWIP_DNS_ADDRTYPE_IS_DUAL(dns_addrtype)) {
     /* fallback to 2nd IP type and try again to lookup */
-    u8_t fallback;
+    u8_t preferred, fallback;
+    err_t fallback_err;
     if (dns_addrtype == LWIP_DNS_ADDRTYPE_IPV4_IPV6) {
+      preferred = LWIP_DNS_ADDRTYPE_IPV4;
       fallback = LWIP_DNS_ADDRTYPE_IPV6;
     } else {
+      preferred = LWIP_DNS_ADDRTYPE_IPV6;
       fallback = LWIP_DNS_ADDRTYPE_IPV4;
     }
-    if (dns_lookup(hostname, addr LWIP_DNS_ADDRTYPE_ARG(fallback)) == ERR_OK) {
+    fallback_err = dns_lookup(hostname, addr LWIP_DNS_ADDRTYPE_ARG(fallback));
+    if (fallback_err == ERR_OK) {
       return ERR_OK;
     }
+    if (err == ERR_VAL) {
+      if (fallback_err == ERR_VAL) {
+        /* both address types failed recently */
+        return ERR_VAL;
+      }
+      /* the preferred type failed recently, only query the other one */
+      dns_addrtype = fallback;
+      err = ERR_ARG;
+    } else if (fallback_err == ERR_VAL) {
+      /* the other type failed recently, only query the preferred one */
+      dns_addrtype = preferred;
+    }
   }
 #else /* LWIP_IPV4 && LWIP_IPV6 */
   LWIP_UNUSED_ARG(dns_addrtype);
 #endif /* LWIP_IPV4 && LWIP_IPV6 */
+  if (err == ERR_VAL) {
+    /* a failed lookup is cached */
+    return ERR_VAL;
+  }
 
 #if LWIP_DNS_SUPPORT_MDNS_QUERIES
   if (strstr(hostname, ".local") == &hostname[hostnamelen] - 6) {
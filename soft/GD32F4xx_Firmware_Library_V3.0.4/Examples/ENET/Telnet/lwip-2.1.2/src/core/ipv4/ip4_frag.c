@@ -56,19 +56,19 @@
  * The IP reassembly code currently has the following limitations:
  * - IP header options are not supported
  * - fragments must not overlap (e.g. due to different routes),
- *   currently, overlapping or duplicate fragments are thrown away
- *   if IP_REASS_CHECK_OVERLAP=1 (the default)!
+ *   overlapping or duplicate fragments are thrown away
+ * - datagrams longer than IP_REASS_MAX_DATAGRAM_LEN are not reassembled
+ *
+ * Every datagram keeps a bitmap of the 8-byte blocks received so far: this
+ * detects duplicate and overlapping fragments without walking the fragments
+ * received before. Since fragments never overlap, a datagram is complete as
+ * soon as the last fragment was received and the number of bytes received
+ * equals the datagram length. Fragments are enqueued unordered and are put
+ * into order only once, when the datagram is complete.
  *
  * @todo: work with IP header options
  */
 
-/** Setting this to 0, you can turn off checking the fragments for overlapping
- * regions. The code gets a little smaller. Only use this if you know that
- * overlapping won't occur on your network! */
-#ifndef IP_REASS_CHECK_OVERLAP
-#define IP_REASS_CHECK_OVERLAP 1
-#endif /* IP_REASS_CHECK_OVERLAP */
-
 /** Set to 0 to prevent freeing the oldest datagram when the reassembly buffer is
  * full (IP_REASS_MAX_PBUFS pbufs are enqueued). The code gets a little smaller.
  * Datagrams will be freed by timeout only. Especially useful when MEMP_NUM_REASSDATA
@@ -79,9 +79,10 @@
 
 #define IP_REASS_FLAG_LASTFRAG 0x01
 
-#define IP_REASS_VALIDATE_TELEGRAM_FINISHED  1
-#define IP_REASS_VALIDATE_PBUF_QUEUED        0
-#define IP_REASS_VALIDATE_PBUF_DROPPED       -1
+/* results of ip_reass_blocks_check() */
+#define IP_REASS_BLOCKS_NONE  0
+#define IP_REASS_BLOCKS_SOME  1
+#define IP_REASS_BLOCKS_ALL   2
 
 /** This is a helper struct which holds the starting
  * offset and the ending offset of this fragment to
@@ -142,6 +143,7 @@ ip_reass_tmr(void)
       /* reassembly timed out */
       struct ip_reassdata *tmp;
       LWIP_DEBUGF(IP_REASS_DEBUG, ("ip_reass_tmr: timer timed out\n"));
+      IP_REASS_STATS_INC(ip_reass.timeout);
       tmp = r;
       /* get the next pointer before freeing */
       r = r->next;
@@ -151,6 +153,87 @@ ip_reass_tmr(void)
   }
 }
 
+/**
+ * Get the bitmap mask of the blocks [first, end) that are stored in word 'w'.
+ */
+static u32_t
+ip_reass_block_mask(u16_t w, u16_t first, u16_t end)
+{
+  u32_t mask = 0xFFFFFFFFUL;
+
+  if (first > (u32_t)w * 32) {
+    /* range starts inside this word */
+    mask <<= (first & 31);
+  }
+  if (end < ((u32_t)w + 1) * 32) {
+    /* range ends inside this word */
+    mask &= ~(0xFFFFFFFFUL << (end & 31));
+  }
+  return mask;
+}
+
+/**
+ * Check which of the 8-byte blocks [first, end) of a datagram were received.
+ *
+ * @return IP_REASS_BLOCKS_NONE, IP_REASS_BLOCKS_SOME or IP_REASS_BLOCKS_ALL
+ */
+static int
+ip_reass_blocks_check(const struct ip_reassdata *ipr, u16_t first, u16_t end)
+{
+  u16_t w;
+  int any = 0, all = 1;
+
+  LWIP_ASSERT("block range inside bitmap", end <= IP_REASS_BITMAP_WORDS * 32);
+  if (first >= end) {
+    return IP_REASS_BLOCKS_NONE;
+  }
+  for (w = (u16_t)(first / 32); w <= (end - 1) / 32; w++) {
+    u32_t mask = ip_reass_block_mask(w, first, end);
+    u32_t bits = ipr->blocks[w] & mask;
+    if (bits != 0) {
+      any = 1;
+    }
+    if (bits != mask) {
+      all = 0;
+    }
+  }
+  if (!any) {
+    return IP_REASS_BLOCKS_NONE;
+  }
+  return all ? IP_REASS_BLOCKS_ALL : IP_REASS_BLOCKS_SOME;
+}
+
+/**
+ * Mark the 8-byte blocks [first, end) of a datagram as received.
+ */
+static void
+ip_reass_blocks_set(struct ip_reassdata *ipr, u16_t first, u16_t end)
+{
+  u16_t w;
+
+  LWIP_ASSERT("block range inside bitmap", (first < end) && (end <= IP_REASS_BITMAP_WORDS * 32));
+  for (w = (u16_t)(first / 32); w <= (end - 1) / 32; w++) {
+    ipr->blocks[w] |= ip_reass_block_mask(w, first, end);
+  }
+}
+
+/**
+ * Count the pbufs enqueued for datagrams from one source address.
+ */
+static u16_t
+ip_reass_source_pbufs(const ip4_addr_p_t *src)
+{
+  struct ip_reassdata *r;
+  u16_t pbufs = 0;
+
+  for (r = reassdatagrams; r != NULL; r = r->next) {
+    if (ip4_addr_cmp(&r->iphdr.src, src)) {
+      pbufs = (u16_t)(pbufs + r->pbufs);
+    }
+  }
+  return pbufs;
+}
+
 /**
  * Free a datagram (struct ip_reassdata) and all its pbufs.
  * Updates the total count of enqueued pbufs (ip_reass_pbufcount),
@@ -175,12 +258,23 @@ ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *p
 
   MIB2_STATS_INC(mib2.ipreasmfails);
 #if LWIP_ICMP
-  iprh = (struct ip_reass_helper *)ipr->p->payload;
-  if (iprh->start == 0) {
+  if ((ipr->blocks[0] & 1) != 0) {
     /* The first fragment was received, send ICMP time exceeded. */
-    /* First, de-queue the first pbuf from r->p. */
-    p = ipr->p;
-    ipr->p = iprh->next_pbuf;
+    /* First, de-queue the first pbuf from r->p (fragments are unordered). */
+    struct pbuf *p_prev = NULL;
+    for (p = ipr->p; p != NULL; p = iprh->next_pbuf) {
+      iprh = (struct ip_reass_helper *)p->payload;
+      if (iprh->start == 0) {
+        break;
+      }
+      p_prev = p;
+    }
+    LWIP_ASSERT("first fragment enqueued", p != NULL);
+    if (p_prev == NULL) {
+      ipr->p = iprh->next_pbuf;
+    } else {
+      ((struct ip_reass_helper *)p_prev->payload)->next_pbuf = iprh->next_pbuf;
+    }
     /* Then, copy the original header into it. */
     SMEMCPY(p->payload, &ipr->iphdr, IP_HLEN);
     icmp_time_exceeded(p, ICMP_TE_FRAG);
@@ -205,6 +299,7 @@ ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *p
     pbufs_freed = (u16_t)(pbufs_freed + clen);
     pbuf_free(pcur);
   }
+  LWIP_ASSERT("all pbufs of the datagram freed", pbufs_freed == ipr->pbufs);
   /* Then, unchain the struct ip_reassdata from the list and free it. */
   ip_reass_dequeue_datagram(ipr, prev);
   LWIP_ASSERT("ip_reass_pbufcount >= pbufs_freed", ip_reass_pbufcount >= pbufs_freed);
@@ -217,51 +312,63 @@ ip_reass_free_complete_datagram(struct ip_reassdata *ipr, struct ip_reassdata *p
 /**
  * Free the oldest datagram to make room for enqueueing new fragments.
  * The datagram 'fraghdr' belongs to is not freed!
+ * Datagrams of the source currently holding the most pbufs are freed first,
+ * so a source flooding the reassembly buffer displaces its own datagrams
+ * instead of those of other sources.
  *
  * @param fraghdr IP header of the current fragment
  * @param pbufs_needed number of pbufs needed to enqueue
  *        (used for freeing other datagrams if not enough space)
+ * @param src if not NULL, only free datagrams from this source address
  * @return the number of pbufs freed
  */
 static int
-ip_reass_remove_oldest_datagram(struct ip_hdr *fraghdr, int pbufs_needed)
+ip_reass_remove_oldest_datagram(struct ip_hdr *fraghdr, int pbufs_needed, const ip4_addr_p_t *src)
 {
-  /* @todo Can't we simply remove the last datagram in the
-   *       linked list behind reassdatagrams?
-   */
   struct ip_reassdata *r, *oldest, *prev, *oldest_prev;
-  int pbufs_freed = 0, pbufs_freed_current;
+  ip4_addr_p_t oldest_src;
+  int pbufs_freed = 0;
   int other_datagrams;
+  u16_t freed;
+
+  /* Weigh every datagram with the pbufs its source holds once; evictions
+   * below only update the datagrams of the evicted source. */
+  for (r = reassdatagrams; r != NULL; r = r->next) {
+    r->src_pbufs = ip_reass_source_pbufs(&r->iphdr.src);
+  }
 
   /* Free datagrams until being allowed to enqueue 'pbufs_needed' pbufs,
    * but don't free the datagram that 'fraghdr' belongs to! */
   do {
     oldest = NULL;
-    prev = NULL;
     oldest_prev = NULL;
     other_datagrams = 0;
-    r = reassdatagrams;
-    while (r != NULL) {
-      if (!IP_ADDRESSES_AND_ID_MATCH(&r->iphdr, fraghdr)) {
-        /* Not the same datagram as fraghdr */
-        other_datagrams++;
-        if (oldest == NULL) {
-          oldest = r;
-          oldest_prev = prev;
-        } else if (r->timer <= oldest->timer) {
-          /* older than the previous oldest */
-          oldest = r;
-          oldest_prev = prev;
-        }
+    for (prev = NULL, r = reassdatagrams; r != NULL; prev = r, r = r->next) {
+      if (IP_ADDRESSES_AND_ID_MATCH(&r->iphdr, fraghdr)) {
+        /* the datagram fraghdr belongs to */
+        continue;
       }
-      if (r->next != NULL) {
-        prev = r;
+      if ((src != NULL) && !ip4_addr_cmp(&r->iphdr.src, src)) {
+        continue;
+      }
+      other_datagrams++;
+      if ((oldest == NULL) || (r->src_pbufs > oldest->src_pbufs) ||
+          ((r->src_pbufs == oldest->src_pbufs) && (r->timer <= oldest->timer))) {
+        /* heavier source, or older than the previous oldest of the same weight */
+        oldest = r;
+        oldest_prev = prev;
       }
-      r = r->next;
     }
     if (oldest != NULL) {
-      pbufs_freed_current = ip_reass_free_complete_datagram(oldest, oldest_prev);
-      pbufs_freed += pbufs_freed_current;
+      IP_REASS_STATS_INC(ip_reass.evict);
+      ip4_addr_copy(oldest_src, oldest->iphdr.src);
+      freed = (u16_t)ip_reass_free_complete_datagram(oldest, oldest_prev);
+      pbufs_freed += freed;
+      for (r = reassdatagrams; r != NULL; r = r->next) {
+        if (ip4_addr_cmp(&r->iphdr.src, &oldest_src)) {
+          r->src_pbufs = (u16_t)(r->src_pbufs - freed);
+        }
+      }
     }
   } while ((pbufs_freed < pbufs_needed) && (other_datagrams > 1));
   return pbufs_freed;
@@ -286,7 +393,7 @@ ip_reass_enqueue_new_datagram(struct ip_hdr *fraghdr, int clen)
   ipr = (struct ip_reassdata *)memp_malloc(MEMP_REASSDATA);
   if (ipr == NULL) {
 #if IP_REASS_FREE_OLDEST
-    if (ip_reass_remove_oldest_datagram(fraghdr, clen) >= clen) {
+    if (ip_reass_remove_oldest_datagram(fraghdr, clen, NULL) >= clen) {
       ipr = (struct ip_reassdata *)memp_malloc(MEMP_REASSDATA);
     }
     if (ipr == NULL)
@@ -331,166 +438,44 @@ ip_reass_dequeue_datagram(struct ip_reassdata *ipr, struct ip_reassdata *prev)
 }
 
 /**
- * Chain a new pbuf into the pbuf list that composes the datagram.  The pbuf list
- * will grow over time as  new pbufs are rx.
- * Also checks that the datagram passes basic continuity checks (if the last
- * fragment was received at least once).
- * @param ipr points to the reassembly state
- * @param new_p points to the pbuf for the current fragment
- * @param is_last is 1 if this pbuf has MF==0 (ipr->flags not updated yet)
- * @return see IP_REASS_VALIDATE_* defines
+ * Put the fragments of a complete datagram into order.
+ * Since the fragments cover the datagram without overlapping, there always is
+ * exactly one fragment starting where the previous one ended.
+ * @param ipr points to the reassembly state of a complete datagram
  */
-static int
-ip_reass_chain_frag_into_datagram_and_validate(struct ip_reassdata *ipr, struct pbuf *new_p, int is_last)
+static void
+ip_reass_sort_fragments(struct ip_reassdata *ipr)
 {
-  struct ip_reass_helper *iprh, *iprh_tmp, *iprh_prev = NULL;
-  struct pbuf *q;
-  u16_t offset, len;
-  u8_t hlen;
-  struct ip_hdr *fraghdr;
-  int valid = 1;
-
-  /* Extract length and fragment offset from current fragment */
-  fraghdr = (struct ip_hdr *)new_p->payload;
-  len = lwip_ntohs(IPH_LEN(fraghdr));
-  hlen = IPH_HL_BYTES(fraghdr);
-  if (hlen > len) {
-    /* invalid datagram */
-    return IP_REASS_VALIDATE_PBUF_DROPPED;
-  }
-  len = (u16_t)(len - hlen);
-  offset = IPH_OFFSET_BYTES(fraghdr);
-
-  /* overwrite the fragment's ip header from the pbuf with our helper struct,
-   * and setup the embedded helper structure. */
-  /* make sure the struct ip_reass_helper fits into the IP header */
-  LWIP_ASSERT("sizeof(struct ip_reass_helper) <= IP_HLEN",
-              sizeof(struct ip_reass_helper) <= IP_HLEN);
-  iprh = (struct ip_reass_helper *)new_p->payload;
-  iprh->next_pbuf = NULL;
-  iprh->start = offset;
-  iprh->end = (u16_t)(offset + len);
-  if (iprh->end < offset) {
-    /* u16_t overflow, cannot handle this */
-    return IP_REASS_VALIDATE_PBUF_DROPPED;
-  }
-
-  /* Iterate through until we either get to the end of the list (append),
-   * or we find one with a larger offset (insert). */
-  for (q = ipr->p; q != NULL;) {
-    iprh_tmp = (struct ip_reass_helper *)q->payload;
-    if (iprh->start < iprh_tmp->start) {
-      /* the new pbuf should be inserted before this */
-      iprh->next_pbuf = q;
-      if (iprh_prev != NULL) {
-        /* not the fragment with the lowest offset */
-#if IP_REASS_CHECK_OVERLAP
-        if ((iprh->start < iprh_prev->end) || (iprh->end > iprh_tmp->start)) {
-          /* fragment overlaps with previous or following, throw away */
-          return IP_REASS_VALIDATE_PBUF_DROPPED;
-        }
-#endif /* IP_REASS_CHECK_OVERLAP */
-        iprh_prev->next_pbuf = new_p;
-        if (iprh_prev->end != iprh->start) {
-          /* There is a fragment missing between the current
-           * and the previous fragment */
-          valid = 0;
-        }
-      } else {
-#if IP_REASS_CHECK_OVERLAP
-        if (iprh->end > iprh_tmp->start) {
-          /* fragment overlaps with following, throw away */
-          return IP_REASS_VALIDATE_PBUF_DROPPED;
-        }
-#endif /* IP_REASS_CHECK_OVERLAP */
-        /* fragment with the lowest offset */
-        ipr->p = new_p;
-      }
-      break;
-    } else if (iprh->start == iprh_tmp->start) {
-      /* received the same datagram twice: no need to keep the datagram */
-      return IP_REASS_VALIDATE_PBUF_DROPPED;
-#if IP_REASS_CHECK_OVERLAP
-    } else if (iprh->start < iprh_tmp->end) {
-      /* overlap: no need to keep the new datagram */
-      return IP_REASS_VALIDATE_PBUF_DROPPED;
-#endif /* IP_REASS_CHECK_OVERLAP */
-    } else {
-      /* Check if the fragments received so far have no holes. */
-      if (iprh_prev != NULL) {
-        if (iprh_prev->end != iprh_tmp->start) {
-          /* There is a fragment missing between the current
-           * and the previous fragment */
-          valid = 0;
-        }
+  struct pbuf *sorted = NULL, *tail = NULL, *q, *q_prev;
+  struct ip_reass_helper *iprh = NULL;
+  u16_t offset = 0;
+
+  while (ipr->p != NULL) {
+    q_prev = NULL;
+    for (q = ipr->p; q != NULL; q = iprh->next_pbuf) {
+      iprh = (struct ip_reass_helper *)q->payload;
+      if (iprh->start == offset) {
+        break;
       }
+      q_prev = q;
     }
-    q = iprh_tmp->next_pbuf;
-    iprh_prev = iprh_tmp;
-  }
-
-  /* If q is NULL, then we made it to the end of the list. Determine what to do now */
-  if (q == NULL) {
-    if (iprh_prev != NULL) {
-      /* this is (for now), the fragment with the highest offset:
-       * chain it to the last fragment */
-#if IP_REASS_CHECK_OVERLAP
-      LWIP_ASSERT("check fragments don't overlap", iprh_prev->end <= iprh->start);
-#endif /* IP_REASS_CHECK_OVERLAP */
-      iprh_prev->next_pbuf = new_p;
-      if (iprh_prev->end != iprh->start) {
-        valid = 0;
-      }
+    LWIP_ASSERT("no fragment missing in a complete datagram", q != NULL);
+    /* move q from the unordered list to the end of the sorted list */
+    if (q_prev == NULL) {
+      ipr->p = iprh->next_pbuf;
     } else {
-#if IP_REASS_CHECK_OVERLAP
-      LWIP_ASSERT("no previous fragment, this must be the first fragment!",
-                  ipr->p == NULL);
-#endif /* IP_REASS_CHECK_OVERLAP */
-      /* this is the first fragment we ever received for this ip datagram */
-      ipr->p = new_p;
+      ((struct ip_reass_helper *)q_prev->payload)->next_pbuf = iprh->next_pbuf;
     }
-  }
-
-  /* At this point, the validation part begins: */
-  /* If we already received the last fragment */
-  if (is_last || ((ipr->flags & IP_REASS_FLAG_LASTFRAG) != 0)) {
-    /* and had no holes so far */
-    if (valid) {
-      /* then check if the rest of the fragments is here */
-      /* Check if the queue starts with the first datagram */
-      if ((ipr->p == NULL) || (((struct ip_reass_helper *)ipr->p->payload)->start != 0)) {
-        valid = 0;
-      } else {
-        /* and check that there are no holes after this datagram */
-        iprh_prev = iprh;
-        q = iprh->next_pbuf;
-        while (q != NULL) {
-          iprh = (struct ip_reass_helper *)q->payload;
-          if (iprh_prev->end != iprh->start) {
-            valid = 0;
-            break;
-          }
-          iprh_prev = iprh;
-          q = iprh->next_pbuf;
-        }
-        /* if still valid, all fragments are received
-         * (because to the MF==0 already arrived */
-        if (valid) {
-          LWIP_ASSERT("sanity check", ipr->p != NULL);
-          LWIP_ASSERT("sanity check",
-                      ((struct ip_reass_helper *)ipr->p->payload) != iprh);
-          LWIP_ASSERT("validate_datagram:next_pbuf!=NULL",
-                      iprh->next_pbuf == NULL);
-        }
-      }
+    iprh->next_pbuf = NULL;
+    if (tail == NULL) {
+      sorted = q;
+    } else {
+      ((struct ip_reass_helper *)tail->payload)->next_pbuf = q;
     }
-    /* If valid is 0 here, there are some fragments missing in the middle
-     * (since MF == 0 has already arrived). Such datagrams simply time out if
-     * no more fragments are received... */
-    return valid ? IP_REASS_VALIDATE_TELEGRAM_FINISHED : IP_REASS_VALIDATE_PBUF_QUEUED;
+    tail = q;
+    offset = iprh->end;
   }
-  /* If we come here, not all fragments were received, yet! */
-  return IP_REASS_VALIDATE_PBUF_QUEUED; /* not yet valid! */
+  ipr->p = sorted;
 }
 
 /**
@@ -506,9 +491,8 @@ ip4_reass(struct pbuf *p)
   struct ip_hdr *fraghdr;
   struct ip_reassdata *ipr;
   struct ip_reass_helper *iprh;
-  u16_t offset, len, clen;
+  u16_t offset, len, end, clen;
   u8_t hlen;
-  int valid;
   int is_last;
 
   IPFRAG_STATS_INC(ip_frag.recv);
@@ -530,12 +514,43 @@ ip4_reass(struct pbuf *p)
     goto nullreturn;
   }
   len = (u16_t)(len - hlen);
+  end = (u16_t)(offset + len);
+  /* check for 'no more fragments' */
+  is_last = (IPH_OFFSET(fraghdr) & PP_NTOHS(IP_MF)) == 0;
+  if ((len == 0) || (end < offset) || (end > (0xFFFF - IP_HLEN)) ||
+      (!is_last && ((len & 7) != 0))) {
+    /* empty fragment, u16_t overflow or a fragment other than the last one
+       not ending on an 8-byte boundary: cannot handle this */
+    LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: invalid fragment %"U16_F"..%"U16_F"\n", offset, end));
+    IPFRAG_STATS_INC(ip_frag.err);
+    goto nullreturn;
+  }
+  if (end > IP_REASS_MAX_DATAGRAM_LEN) {
+    LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: datagram exceeds IP_REASS_MAX_DATAGRAM_LEN\n"));
+    IP_REASS_STATS_INC(ip_reass.toobig);
+    goto nullreturn;
+  }
 
-  /* Check if we are allowed to enqueue more datagrams. */
+  /* Check if the source of the fragment may enqueue more pbufs: exceeding
+     this budget only displaces datagrams of the same source. */
   clen = pbuf_clen(p);
+  if ((ip_reass_source_pbufs(&fraghdr->src) + clen) > IP_REASS_MAX_PBUFS_PER_SOURCE) {
+#if IP_REASS_FREE_OLDEST
+    ip_reass_remove_oldest_datagram(fraghdr, clen, &fraghdr->src);
+    if ((ip_reass_source_pbufs(&fraghdr->src) + clen) > IP_REASS_MAX_PBUFS_PER_SOURCE)
+#endif /* IP_REASS_FREE_OLDEST */
+    {
+      LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: per-source budget exceeded: clen=%d, MAX=%d\n",
+                                   clen, IP_REASS_MAX_PBUFS_PER_SOURCE));
+      IP_REASS_STATS_INC(ip_reass.srcbudget);
+      goto nullreturn;
+    }
+  }
+
+  /* Check if we are allowed to enqueue more datagrams. */
   if ((ip_reass_pbufcount + clen) > IP_REASS_MAX_PBUFS) {
 #if IP_REASS_FREE_OLDEST
-    if (!ip_reass_remove_oldest_datagram(fraghdr, clen) ||
+    if (!ip_reass_remove_oldest_datagram(fraghdr, clen, NULL) ||
         ((ip_reass_pbufcount + clen) > IP_REASS_MAX_PBUFS))
 #endif /* IP_REASS_FREE_OLDEST */
     {
@@ -570,56 +585,79 @@ ip4_reass(struct pbuf *p)
     if (ipr == NULL) {
       goto nullreturn;
     }
-  } else {
-    if (((lwip_ntohs(IPH_OFFSET(fraghdr)) & IP_OFFMASK) == 0) &&
-        ((lwip_ntohs(IPH_OFFSET(&ipr->iphdr)) & IP_OFFMASK) != 0)) {
-      /* ipr->iphdr is not the header from the first fragment, but fraghdr is
-       * -> copy fraghdr into ipr->iphdr since we want to have the header
-       * of the first fragment (for ICMP time exceeded and later, for copying
-       * all options, if supported)*/
-      SMEMCPY(&ipr->iphdr, fraghdr, IP_HLEN);
-    }
   }
 
   /* At this point, we have either created a new entry or pointing
    * to an existing one */
 
-  /* check for 'no more fragments', and update queue entry*/
-  is_last = (IPH_OFFSET(fraghdr) & PP_NTOHS(IP_MF)) == 0;
-  if (is_last) {
-    u16_t datagram_len = (u16_t)(offset + len);
-    if ((datagram_len < offset) || (datagram_len > (0xFFFF - IP_HLEN))) {
-      /* u16_t overflow, cannot handle this */
+  /* drop duplicates and fragments overlapping what was received before */
+  switch (ip_reass_blocks_check(ipr, (u16_t)(offset / 8), (u16_t)((end + 7) / 8))) {
+    case IP_REASS_BLOCKS_ALL:
+      LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: duplicate fragment\n"));
+      IP_REASS_STATS_INC(ip_reass.dup);
+      goto nullreturn_ipr;
+    case IP_REASS_BLOCKS_SOME:
+      LWIP_DEBUGF(IP_REASS_DEBUG, ("ip4_reass: overlapping fragment\n"));
+      IP_REASS_STATS_INC(ip_reass.overlap);
+      goto nullreturn_ipr;
+    default:
+      break;
+  }
+  /* the fragment must not reach beyond the end of the datagram */
+  if ((ipr->flags & IP_REASS_FLAG_LASTFRAG) != 0) {
+    if (is_last || (end > ipr->datagram_len)) {
+      IPFRAG_STATS_INC(ip_frag.err);
+      goto nullreturn_ipr;
+    }
+  } else if (is_last) {
+    if (ip_reass_blocks_check(ipr, (u16_t)((end + 7) / 8), IP_REASS_BITMAP_WORDS * 32) != IP_REASS_BLOCKS_NONE) {
+      IPFRAG_STATS_INC(ip_frag.err);
       goto nullreturn_ipr;
     }
   }
-  /* find the right place to insert this pbuf */
-  /* @todo: trim pbufs if fragments are overlapping */
-  valid = ip_reass_chain_frag_into_datagram_and_validate(ipr, p, is_last);
-  if (valid == IP_REASS_VALIDATE_PBUF_DROPPED) {
-    goto nullreturn_ipr;
+
+  if ((offset == 0) && ((lwip_ntohs(IPH_OFFSET(&ipr->iphdr)) & IP_OFFMASK) != 0)) {
+    /* ipr->iphdr is not the header from the first fragment, but fraghdr is
+     * -> copy fraghdr into ipr->iphdr since we want to have the header
+     * of the first fragment (for ICMP time exceeded and later, for copying
+     * all options, if supported)*/
+    SMEMCPY(&ipr->iphdr, fraghdr, IP_HLEN);
   }
-  /* if we come here, the pbuf has been enqueued */
+
+  /* overwrite the fragment's ip header from the pbuf with our helper struct,
+   * and enqueue it (unordered) */
+  /* make sure the struct ip_reass_helper fits into the IP header */
+  LWIP_ASSERT("sizeof(struct ip_reass_helper) <= IP_HLEN",
+              sizeof(struct ip_reass_helper) <= IP_HLEN);
+  iprh = (struct ip_reass_helper *)p->payload;
+  iprh->next_pbuf = ipr->p;
+  iprh->start = offset;
+  iprh->end = end;
+  ipr->p = p;
+  ip_reass_blocks_set(ipr, (u16_t)(offset / 8), (u16_t)((end + 7) / 8));
+  ipr->received_len = (u16_t)(ipr->received_len + len);
+  ipr->pbufs = (u16_t)(ipr->pbufs + clen);
 
   /* Track the current number of pbufs current 'in-flight', in order to limit
      the number of fragments that may be enqueued at any one time
      (overflow checked by testing against IP_REASS_MAX_PBUFS) */
   ip_reass_pbufcount = (u16_t)(ip_reass_pbufcount + clen);
   if (is_last) {
-    u16_t datagram_len = (u16_t)(offset + len);
-    ipr->datagram_len = datagram_len;
+    ipr->datagram_len = end;
     ipr->flags |= IP_REASS_FLAG_LASTFRAG;
     LWIP_DEBUGF(IP_REASS_DEBUG,
                 ("ip4_reass: last fragment seen, total len %"S16_F"\n",
                  ipr->datagram_len));
   }
 
-  if (valid == IP_REASS_VALIDATE_TELEGRAM_FINISHED) {
+  if (((ipr->flags & IP_REASS_FLAG_LASTFRAG) != 0) && (ipr->received_len == ipr->datagram_len)) {
     struct ip_reassdata *ipr_prev;
     /* the totally last fragment (flag more fragments = 0) was received at least
      * once AND all fragments are received */
     u16_t datagram_len = (u16_t)(ipr->datagram_len + IP_HLEN);
 
+    ip_reass_sort_fragments(ipr);
+
     /* save the second pbuf before copying the header over the pointer */
     r = ((struct ip_reass_helper *)ipr->p->payload)->next_pbuf;
 
@@ -668,6 +706,7 @@ ip4_reass(struct pbuf *p)
     ip_reass_pbufcount = (u16_t)(ip_reass_pbufcount - clen);
 
     MIB2_STATS_INC(mib2.ipreasmoks);
+    IP_REASS_STATS_INC(ip_reass.ok);
 
     /* Return the pbuf chain */
     return p;
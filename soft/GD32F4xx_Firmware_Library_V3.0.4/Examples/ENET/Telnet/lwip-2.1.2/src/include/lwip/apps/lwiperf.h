@@ -39,12 +39,14 @@
 
 #include "lwip/opt.h"
 #include "lwip/ip_addr.h"
+#include "lwip/mem.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 #define LWIPERF_TCP_PORT_DEFAULT  5001
+#define LWIPERF_UDP_PORT_DEFAULT  5001
 
 /** lwIPerf test results */
 enum lwiperf_report_type
@@ -60,7 +62,13 @@ enum lwiperf_report_type
   /** Transmit error lead to test abort */
   LWIPERF_TCP_ABORTED_LOCAL_TXERROR,
   /** Remote side aborted the test */
-  LWIPERF_TCP_ABORTED_REMOTE
+  LWIPERF_TCP_ABORTED_REMOTE,
+  /** The UDP server side test is done */
+  LWIPERF_UDP_DONE_SERVER,
+  /** The UDP client side test is done */
+  LWIPERF_UDP_DONE_CLIENT,
+  /** Intermediate result of a running test (only passed to @ref lwiperf_report_ext_fn) */
+  LWIPERF_INTERVAL
 };
 
 /** Control */
@@ -71,9 +79,14 @@ enum lwiperf_client_type
   /** Do a bidirectional test simultaneously */
   LWIPERF_DUAL,
   /** Do a bidirectional test individually */
-  LWIPERF_TRADEOFF
+  LWIPERF_TRADEOFF,
+  /** Unidirectional rx only test: the remote side sends back to us */
+  LWIPERF_REVERSE
 };
 
+/** CPU load value reported if LWIPERF_IDLE_TIME_MS() is not provided by the port */
+#define LWIPERF_CPU_LOAD_UNKNOWN  0xFF
+
 /** Prototype of a report function that is called when a session is finished.
     This report function can show the test results.
     @param report_type contains the test result */
@@ -81,6 +94,62 @@ typedef void (*lwiperf_report_fn)(void *arg, enum lwiperf_report_type report_typ
   const ip_addr_t* local_addr, u16_t local_port, const ip_addr_t* remote_addr, u16_t remote_port,
   u32_t bytes_transferred, u32_t ms_duration, u32_t bandwidth_kbitpsec);
 
+/** Detailed test results passed to @ref lwiperf_report_ext_fn */
+struct lwiperf_report {
+  /** Test result or LWIPERF_INTERVAL */
+  enum lwiperf_report_type report_type;
+  /** 1 for UDP tests, 0 for TCP tests */
+  u8_t udp;
+  /** Stream index for parallel tests (0 for the first stream) */
+  u8_t stream;
+  const ip_addr_t* local_addr;
+  u16_t local_port;
+  const ip_addr_t* remote_addr;
+  u16_t remote_port;
+  /** Start of the reported period relative to the start of the test */
+  u32_t ms_start;
+  /** Length of the reported period (whole test unless LWIPERF_INTERVAL) */
+  u32_t ms_duration;
+  /** Bytes transferred during the reported period */
+  u32_t bytes_transferred;
+  u32_t bandwidth_kbitpsec;
+  /** UDP only: statistics of the receiving side (for UDP clients, these
+      are taken from the server report; all 0 if none was received) */
+  u32_t datagrams;
+  u32_t datagrams_lost;
+  u32_t datagrams_out_of_order;
+  u32_t jitter_us;
+  /** CPU load during the test in percent; always LWIPERF_CPU_LOAD_UNKNOWN
+      unless the port defines LWIPERF_IDLE_TIME_MS() */
+  u8_t cpu_load;
+  /** High-water marks since the test started (0 if stats are disabled) */
+  u16_t pbuf_pool_max;
+  u16_t pbuf_max;
+  mem_size_t mem_max;
+};
+
+/** Prototype of a report function that is called when a session is finished
+    or, if enabled, periodically while the test runs. */
+typedef void (*lwiperf_report_ext_fn)(void *arg, const struct lwiperf_report *report);
+
+/** Test settings for @ref lwiperf_start_client */
+struct lwiperf_client_settings {
+  /** Test direction */
+  enum lwiperf_client_type type;
+  /** 1: UDP test, 0: TCP test */
+  u8_t udp;
+  /** Number of parallel streams (0 is treated as 1) */
+  u8_t num_streams;
+  /** Test duration in milliseconds (10 ms resolution, 0: 10 seconds) */
+  u32_t duration_ms;
+  /** Interval between LWIPERF_INTERVAL reports in milliseconds, 0: off */
+  u32_t interval_ms;
+  /** UDP only: transmit rate per stream (0: 1 MBit/s) */
+  u32_t udp_bandwidth_kbitpsec;
+  /** UDP only: datagram payload length (0: 1470 bytes) */
+  u16_t udp_datagram_len;
+};
+
 void* lwiperf_start_tcp_server(const ip_addr_t* local_addr, u16_t local_port,
                                lwiperf_report_fn report_fn, void* report_arg);
 void* lwiperf_start_tcp_server_default(lwiperf_report_fn report_fn, void* report_arg);
@@ -90,6 +159,12 @@ void* lwiperf_start_tcp_client(const ip_addr_t* remote_addr, u16_t remote_port,
 void* lwiperf_start_tcp_client_default(const ip_addr_t* remote_addr,
                                lwiperf_report_fn report_fn, void* report_arg);
 
+void* lwiperf_start_server(const ip_addr_t* local_addr, u16_t local_port, u8_t udp,
+                           u32_t interval_ms, lwiperf_report_ext_fn report_fn, void* report_arg);
+void* lwiperf_start_client(const ip_addr_t* remote_addr, u16_t remote_port,
+                           const struct lwiperf_client_settings* settings,
+                           lwiperf_report_ext_fn report_fn, void* report_arg);
+
 void  lwiperf_abort(void* lwiperf_session);
 
 
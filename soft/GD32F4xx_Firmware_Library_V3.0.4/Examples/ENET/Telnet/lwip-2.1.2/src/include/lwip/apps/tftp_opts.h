@@ -65,24 +65,25 @@
 #endif
 
 /**
- * TFTP timeout
+ * TFTP timeout. This is the initial and maximum retransmission timeout,
+ * the timeout actually used is adapted to the measured round trip time.
  */
 #if !defined TFTP_TIMEOUT_MSECS || defined __DOXYGEN__
 #define TFTP_TIMEOUT_MSECS    10000
 #endif
 
 /**
- * Max. number of retries when a file is read from server
+ * Lower bound of the RTT-adapted retransmission timeout
  */
-#if !defined TFTP_MAX_RETRIES || defined __DOXYGEN__
-#define TFTP_MAX_RETRIES      5
+#if !defined TFTP_MIN_TIMEOUT_MSECS || defined __DOXYGEN__
+#define TFTP_MIN_TIMEOUT_MSECS 100
 #endif
 
 /**
- * TFTP timer cyclic interval
+ * Max. number of retries when a file is read from server
  */
-#if !defined TFTP_TIMER_MSECS || defined __DOXYGEN__
-#define TFTP_TIMER_MSECS      (TFTP_TIMEOUT_MSECS / 10)
+#if !defined TFTP_MAX_RETRIES || defined __DOXYGEN__
+#define TFTP_MAX_RETRIES      5
 #endif
 
 /**
@@ -99,6 +100,24 @@
 #define TFTP_MAX_MODE_LEN     7
 #endif
 
+/**
+ * Max. block size accepted in the "blksize" option (RFC 2348).
+ * Clients that do not negotiate a block size get the RFC 1350 default of
+ * 512 bytes. The default fits one DATA packet into an Ethernet frame.
+ */
+#if !defined TFTP_MAX_BLKSIZE || defined __DOXYGEN__
+#define TFTP_MAX_BLKSIZE      1468
+#endif
+
+/**
+ * Max. number of blocks accepted in the "windowsize" option (RFC 7440).
+ * For read requests, up to this many DATA pbufs of the negotiated block
+ * size are kept for retransmission.
+ */
+#if !defined TFTP_MAX_WINDOWSIZE || defined __DOXYGEN__
+#define TFTP_MAX_WINDOWSIZE   8
+#endif
+
 /**
  * @}
  */
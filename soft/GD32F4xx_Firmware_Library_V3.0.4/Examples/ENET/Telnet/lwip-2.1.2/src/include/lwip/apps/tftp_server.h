@@ -83,6 +83,18 @@ struct tftp_context {
    * @returns &gt;= 0: Success; &lt; 0: Error
    */
   int (*write)(void* handle, struct pbuf* p);
+  /**
+   * Read from file without copying (optional, may be NULL).
+   * For backends that keep the file in addressable memory (e.g. memory
+   * mapped flash): the data is sent straight from there. When this is
+   * NULL, read() is used to copy the data into the DATA packet.
+   * @param handle File handle returned by open()
+   * @param buf Set to the data of the next bytes of the file; this must
+   *            stay valid until close() is called
+   * @param bytes Max. number of bytes to return
+   * @returns &gt;= 0: Success (number of bytes at buf); &lt; 0: Error
+   */
+  int (*read_ref)(void* handle, const void** buf, int bytes);
 };
 
 err_t tftp_init(const struct tftp_context* ctx);
@@ -55,16 +55,28 @@ extern "C" {
 /* The IP reassembly timer interval in milliseconds. */
 #define IP_TMR_INTERVAL 1000
 
+/** Number of u32_t words needed to keep one bit per 8-byte fragment block */
+#define IP_REASS_BITMAP_WORDS ((IP_REASS_MAX_DATAGRAM_LEN + (8 * 32) - 1) / (8 * 32))
+
 /** IP reassembly helper struct.
  * This is exported because memp needs to know the size.
  */
 struct ip_reassdata {
   struct ip_reassdata *next;
+  /* fragments received so far, unordered */
   struct pbuf *p;
   struct ip_hdr iphdr;
   u16_t datagram_len;
+  /* payload bytes received so far (fragments never overlap) */
+  u16_t received_len;
+  /* number of pbufs enqueued for this datagram */
+  u16_t pbufs;
+  /* pbufs enqueued for the source of this datagram (eviction scratch) */
+  u16_t src_pbufs;
   u8_t flags;
   u8_t timer;
+  /* one bit per 8-byte block received */
+  u32_t blocks[IP_REASS_BITMAP_WORDS];
 };
 
 void ip_reass_init(void);
@@ -794,6 +794,31 @@
 #define IP_REASS_MAX_PBUFS              10
 #endif
 
+/**
+ * IP_REASS_MAX_PBUFS_PER_SOURCE: Maximum amount of pbufs waiting to be
+ * reassembled that may originate from a single source address. Fragments
+ * exceeding this budget only ever displace older datagrams of the same source,
+ * so one (misbehaving) host cannot starve the reassembly of other hosts.
+ * Set this below IP_REASS_MAX_PBUFS to reserve room for other sources.
+ */
+#if !defined IP_REASS_MAX_PBUFS_PER_SOURCE || defined __DOXYGEN__
+#define IP_REASS_MAX_PBUFS_PER_SOURCE   IP_REASS_MAX_PBUFS
+#endif
+
+/**
+ * IP_REASS_MAX_DATAGRAM_LEN: Maximum payload length of a reassembled IPv4
+ * datagram. Every datagram in reassembly keeps a bitmap of the 8-byte blocks
+ * received so far, which costs IP_REASS_MAX_DATAGRAM_LEN / 64 bytes per
+ * MEMP_NUM_REASSDATA. Fragments reaching beyond this length are dropped.
+ * The default accepts every valid datagram (1 KB of bitmap per datagram);
+ * lower it to save RAM, e.g. to (IP_REASS_MAX_PBUFS * 1480), which is what
+ * IP_REASS_MAX_PBUFS full-sized ethernet fragments carry: larger datagrams
+ * are then dropped and counted in ip_reass.toobig.
+ */
+#if !defined IP_REASS_MAX_DATAGRAM_LEN || defined __DOXYGEN__
+#define IP_REASS_MAX_DATAGRAM_LEN       0xFFFF
+#endif
+
 /**
  * IP_DEFAULT_TTL: Default value for Time-To-Live used by transport layers.
  */
@@ -1123,6 +1148,30 @@
 #define DNS_DOES_NAME_CHECK             1
 #endif
 
+/** DNS_NEG_CACHE_TTL: maximum number of seconds a negative answer (the name
+ * does not exist or has no address of the requested type) is cached. The
+ * SOA record of the answer can shorten this time (RFC 2308). While cached,
+ * dns_gethostbyname() fails immediately with ERR_VAL.
+ * 0 disables caching negative answers. */
+#if !defined DNS_NEG_CACHE_TTL || defined __DOXYGEN__
+#define DNS_NEG_CACHE_TTL               60
+#endif
+
+/** DNS_FAIL_CACHE_TTL: number of seconds a lookup that timed out or got a
+ * server failure is cached (RFC 2308 chapter 7: at most 5 minutes).
+ * 0 disables caching failed lookups. */
+#if !defined DNS_FAIL_CACHE_TTL || defined __DOXYGEN__
+#define DNS_FAIL_CACHE_TTL              5
+#endif
+
+/** DNS_PARALLEL_QUERIES==1: for LWIP_DNS_ADDRTYPE_IPV4_IPV6 and
+ * LWIP_DNS_ADDRTYPE_IPV6_IPV4, send the A and AAAA queries at the same time
+ * instead of one after the other. This needs a second DNS table entry per
+ * lookup and only applies if both LWIP_IPV4 and LWIP_IPV6 are enabled. */
+#if !defined DNS_PARALLEL_QUERIES || defined __DOXYGEN__
+#define DNS_PARALLEL_QUERIES            1
+#endif
+
 /** LWIP_DNS_SECURE: controls the security level of the DNS implementation
  * Use all DNS security features by default.
  * This is overridable but should only be needed by very small targets
@@ -2137,6 +2186,14 @@
 #define IPFRAG_STATS                    (IP_REASSEMBLY || IP_FRAG)
 #endif
 
+/**
+ * IP_REASS_STATS==1: Enable detailed IPv4 reassembly stats (completed,
+ * timed out, duplicate/overlapping fragments, budget evictions).
+ */
+#if !defined IP_REASS_STATS || defined __DOXYGEN__
+#define IP_REASS_STATS                  IP_REASSEMBLY
+#endif
+
 /**
  * ICMP_STATS==1: Enable ICMP stats.
  */
@@ -2236,6 +2293,7 @@
 #define ETHARP_STATS                    0
 #define IP_STATS                        0
 #define IPFRAG_STATS                    0
+#define IP_REASS_STATS                  0
 #define ICMP_STATS                      0
 #define IGMP_STATS                      0
 #define UDP_STATS                       0
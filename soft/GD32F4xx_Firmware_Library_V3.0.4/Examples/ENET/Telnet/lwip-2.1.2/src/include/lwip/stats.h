@@ -94,6 +94,17 @@ struct stats_igmp {
   STAT_COUNTER tx_report;        /* Sent reports. */
 };
 
+/** IPv4 reassembly stats */
+struct stats_ip_reass {
+  STAT_COUNTER ok;               /* Datagrams reassembled. */
+  STAT_COUNTER timeout;          /* Datagrams timed out. */
+  STAT_COUNTER dup;              /* Duplicate fragments dropped. */
+  STAT_COUNTER overlap;          /* Overlapping fragments dropped. */
+  STAT_COUNTER toobig;           /* Fragments beyond IP_REASS_MAX_DATAGRAM_LEN. */
+  STAT_COUNTER srcbudget;        /* Fragments dropped by the per-source budget. */
+  STAT_COUNTER evict;            /* Datagrams freed to make room. */
+};
+
 /** Memory stats */
 struct stats_mem {
 #if defined(LWIP_DEBUG) || LWIP_STATS_DISPLAY
@@ -242,6 +253,10 @@ struct stats_ {
   /** Fragmentation */
   struct stats_proto ip_frag;
 #endif
+#if IP_REASS_STATS
+  /** IPv4 reassembly */
+  struct stats_ip_reass ip_reass;
+#endif
 #if IP_STATS
   /** IP */
   struct stats_proto ip;
@@ -369,6 +384,14 @@ void stats_init(void);
 #define IPFRAG_STATS_DISPLAY()
 #endif
 
+#if IP_REASS_STATS
+#define IP_REASS_STATS_INC(x) STATS_INC(x)
+#define IP_REASS_STATS_DISPLAY() stats_display_ip_reass(&lwip_stats.ip_reass)
+#else
+#define IP_REASS_STATS_INC(x)
+#define IP_REASS_STATS_DISPLAY()
+#endif
+
 #if ETHARP_STATS
 #define ETHARP_STATS_INC(x) STATS_INC(x)
 #define ETHARP_STATS_DISPLAY() stats_display_proto(&lwip_stats.etharp, "ETHARP")
@@ -472,6 +495,7 @@ void stats_init(void);
 void stats_display(void);
 void stats_display_proto(struct stats_proto *proto, const char *name);
 void stats_display_igmp(struct stats_igmp *igmp, const char *name);
+void stats_display_ip_reass(struct stats_ip_reass *reass);
 void stats_display_mem(struct stats_mem *mem, const char *name);
 void stats_display_memp(struct stats_mem *mem, int index);
 void stats_display_sys(struct stats_sys *sys);
@@ -479,6 +503,7 @@ void stats_display_sys(struct stats_sys *sys);
 #define stats_display()
 #define stats_display_proto(proto, name)
 #define stats_display_igmp(igmp, name)
+#define stats_display_ip_reass(reass)
 #define stats_display_mem(mem, name)
 #define stats_display_memp(mem, index)
 #define stats_display_sys(sys)
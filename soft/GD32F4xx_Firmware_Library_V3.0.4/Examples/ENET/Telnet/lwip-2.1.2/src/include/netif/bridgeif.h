@@ -74,7 +74,8 @@ typedef struct bridgeif_initdata_s {
       influences memory allocated for netif->state of the bridge netif). */
   u8_t            max_ports;
   /** Maximum number of dynamic/learning entries in the bridge's forwarding database.
-      In the default implementation, this controls memory consumption only. */
+      In the default implementation, this controls memory consumption only
+      (a hash table with 2 to 4 slots per entry is allocated). */
   u16_t           max_fdb_dynamic_entries;
   /** Maximum number of static forwarding entries. Influences memory consumption! */
   u16_t           max_fdb_static_entries;
@@ -92,6 +93,7 @@ typedef struct bridgeif_initdata_s {
 #define BRIDGEIF_INITDATA2(max_ports, max_fdb_dynamic_entries, max_fdb_static_entries, e0, e1, e2, e3, e4, e5) {{e0, e1, e2, e3, e4, e5}, max_ports, max_fdb_dynamic_entries, max_fdb_static_entries}
 
 err_t bridgeif_init(struct netif *netif);
+void  bridgeif_remove(struct netif *bridgeif);
 err_t bridgeif_add_port(struct netif *bridgeif, struct netif *portif);
 err_t bridgeif_fdb_add(struct netif *bridgeif, const struct eth_addr *addr, bridgeif_portmask_t ports);
 err_t bridgeif_fdb_remove(struct netif *bridgeif, const struct eth_addr *addr);
@@ -100,6 +102,7 @@ err_t bridgeif_fdb_remove(struct netif *bridgeif, const struct eth_addr *addr);
 void                bridgeif_fdb_update_src(void *fdb_ptr, struct eth_addr *src_addr, u8_t port_idx);
 bridgeif_portmask_t bridgeif_fdb_get_dst_ports(void *fdb_ptr, struct eth_addr *dst_addr);
 void*               bridgeif_fdb_init(u16_t max_fdb_entries);
+void                bridgeif_fdb_deinit(void *fdb_ptr);
 
 #if BRIDGEIF_PORT_NETIFS_OUTPUT_DIRECT
 #ifndef BRIDGEIF_DECL_PROTECT
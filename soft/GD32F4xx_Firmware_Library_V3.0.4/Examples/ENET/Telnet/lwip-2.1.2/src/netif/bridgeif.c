@@ -516,6 +516,32 @@ bridgeif_init(struct netif *netif)
   return ERR_OK;
 }
 
+/**
+ * @ingroup bridgeif
+ * Remove a bridge added with @ref bridgeif_init: the bridge netif is removed
+ * and its private data and dynamic fdb (including the aging timer) are freed.
+ * The port netifs are detached; their input function still points to the
+ * bridge, so they must be removed or re-initialized by the caller.
+ */
+void
+bridgeif_remove(struct netif *bridgeif)
+{
+  bridgeif_private_t *br;
+  u8_t i;
+
+  LWIP_ASSERT("bridgeif != NULL", bridgeif != NULL);
+  LWIP_ASSERT("bridgeif->state != NULL", bridgeif->state != NULL);
+
+  br = (bridgeif_private_t *)bridgeif->state;
+  netif_remove(bridgeif);
+  for (i = 0; i < br->num_ports; i++) {
+    netif_set_client_data(br->ports[i].port_netif, bridgeif_netif_client_id, NULL);
+  }
+  bridgeif_fdb_deinit(br->fdbd);
+  bridgeif->state = NULL;
+  mem_free(br);
+}
+
 /**
  * @ingroup bridgeif
  * Add a port to the bridge
@@ -39,6 +39,13 @@
  * @defgroup bridgeif_fdb FDB example code
  * @ingroup bridgeif
  * This file implements an example for an FDB (Forwarding DataBase)
+ *
+ * The dynamic entries are kept in an open addressing hash table (linear
+ * probing) keyed on the MAC address, so learning and forwarding lookups don't
+ * depend on the number of entries. The table has at least twice as many slots
+ * as entries. Ageing is incremental: entries store the time they expire at,
+ * lookups ignore expired entries and the age timer frees only a slice of the
+ * table every second.
  */
 
 #include "netif/bridgeif.h"
@@ -51,127 +58,208 @@
 
 #define BR_FDB_TIMEOUT_SEC  (60*5) /* 5 minutes FDB timeout */
 
+/* The age timer frees expired entries of the whole table in this many seconds */
+#define BR_FDB_SWEEP_SEC    16
+
 typedef struct bridgeif_dfdb_entry_s {
+  struct eth_addr addr;
   u8_t used;
   u8_t port;
-  u32_t ts;
-  struct eth_addr addr;
+  /* value of bridgeif_dfdb_t::now at which this entry expires */
+  u32_t expires;
 } bridgeif_dfdb_entry_t;
 
 typedef struct bridgeif_dfdb_s {
   u16_t max_fdb_entries;
+  u16_t num_entries;
+  /* number of slots - 1 (the number of slots is a power of 2) */
+  u32_t slot_mask;
+  /* shift to get a slot index from the upper bits of the hash */
+  u8_t hash_shift;
+  /* seconds since init */
+  u32_t now;
+  /* next slot checked by the age timer */
+  u32_t age_idx;
+  /* 'now' of the last time all expired entries were freed */
+  u32_t reclaimed;
   bridgeif_dfdb_entry_t *fdb;
 } bridgeif_dfdb_t;
 
+/** Get the home slot of a MAC address (fibonacci hashing) */
+static u32_t
+bridgeif_fdb_hash(const bridgeif_dfdb_t *fdb, const struct eth_addr *addr)
+{
+  u32_t h = ((u32_t)addr->addr[2] << 24) | ((u32_t)addr->addr[3] << 16) |
+            ((u32_t)addr->addr[4] << 8) | addr->addr[5];
+  h ^= (((u32_t)addr->addr[0] << 8) | addr->addr[1]) * 0x85EBCA6BUL;
+  return (u32_t)(h * 0x9E3779B1UL) >> fdb->hash_shift;
+}
+
+static int
+bridgeif_fdb_expired(const bridgeif_dfdb_t *fdb, const bridgeif_dfdb_entry_t *e)
+{
+  return (s32_t)(e->expires - fdb->now) <= 0;
+}
+
+/** Get the slot holding 'addr' (expired or not) or else the free slot
+ * ending its probe sequence.
+ */
+static u32_t
+bridgeif_fdb_lookup(const bridgeif_dfdb_t *fdb, const struct eth_addr *addr)
+{
+  u32_t i = bridgeif_fdb_hash(fdb, addr);
+  /* this terminates as there always are free slots */
+  while (fdb->fdb[i].used && memcmp(&fdb->fdb[i].addr, addr, sizeof(struct eth_addr))) {
+    i = (i + 1) & fdb->slot_mask;
+  }
+  return i;
+}
+
+/** Free the entry at slot 'i': entries following it in the same probe
+ * sequence are shifted back so lookups never need tombstones.
+ */
+static void
+bridgeif_fdb_remove_slot(bridgeif_dfdb_t *fdb, u32_t i)
+{
+  u32_t j = i;
+
+  for (;;) {
+    u32_t home;
+    j = (j + 1) & fdb->slot_mask;
+    if (!fdb->fdb[j].used) {
+      break;
+    }
+    home = bridgeif_fdb_hash(fdb, &fdb->fdb[j].addr);
+    /* move the entry into the hole unless its home lies in (i, j] */
+    if (((j - home) & fdb->slot_mask) >= ((j - i) & fdb->slot_mask)) {
+      fdb->fdb[i] = fdb->fdb[j];
+      i = j;
+    }
+  }
+  fdb->fdb[i].used = 0;
+  fdb->num_entries--;
+}
+
+/** Free all expired entries (at most once per second) */
+static void
+bridgeif_fdb_reclaim(bridgeif_dfdb_t *fdb)
+{
+  u32_t i = 0;
+
+  if (fdb->reclaimed == fdb->now) {
+    return;
+  }
+  fdb->reclaimed = fdb->now;
+  while (i <= fdb->slot_mask) {
+    bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
+    if (e->used && bridgeif_fdb_expired(fdb, e)) {
+      /* check this slot again, an entry may have been moved here */
+      bridgeif_fdb_remove_slot(fdb, i);
+    } else {
+      i++;
+    }
+  }
+}
+
 /**
  * @ingroup bridgeif_fdb
- * A real simple and slow implementation of an auto-learning forwarding database that
- * remembers known src mac addresses to know which port to send frames destined for that
- * mac address.
- *
- * ATTENTION: This is meant as an example only, in real-world use, you should 
- * provide a better implementation :-)
+ * An auto-learning forwarding database that remembers known src mac addresses
+ * to know which port to send frames destined for that mac address.
  */
 void
 bridgeif_fdb_update_src(void *fdb_ptr, struct eth_addr *src_addr, u8_t port_idx)
 {
-  int i;
+  u32_t i;
+  bridgeif_dfdb_entry_t *e;
   bridgeif_dfdb_t *fdb = (bridgeif_dfdb_t *)fdb_ptr;
   BRIDGEIF_DECL_PROTECT(lev);
   BRIDGEIF_READ_PROTECT(lev);
-  for (i = 0; i < fdb->max_fdb_entries; i++) {
-    bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
-    if (e->used && e->ts) {
-      if (!memcmp(&e->addr, src_addr, sizeof(struct eth_addr))) {
-        LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: update src %02x:%02x:%02x:%02x:%02x:%02x (from %d) @ idx %d\n",
-                                         src_addr->addr[0], src_addr->addr[1], src_addr->addr[2], src_addr->addr[3], src_addr->addr[4], src_addr->addr[5],
-                                         port_idx, i));
-        BRIDGEIF_WRITE_PROTECT(lev);
-        e->ts = BR_FDB_TIMEOUT_SEC;
-        e->port = port_idx;
-        BRIDGEIF_WRITE_UNPROTECT(lev);
-        BRIDGEIF_READ_UNPROTECT(lev);
-        return;
-      }
-    }
+  i = bridgeif_fdb_lookup(fdb, src_addr);
+  e = &fdb->fdb[i];
+  if (e->used) {
+    LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: update src %02x:%02x:%02x:%02x:%02x:%02x (from %d) @ idx %d\n",
+                                     src_addr->addr[0], src_addr->addr[1], src_addr->addr[2], src_addr->addr[3], src_addr->addr[4], src_addr->addr[5],
+                                     port_idx, (int)i));
+    BRIDGEIF_WRITE_PROTECT(lev);
+    e->expires = fdb->now + BR_FDB_TIMEOUT_SEC;
+    e->port = port_idx;
+    BRIDGEIF_WRITE_UNPROTECT(lev);
+    BRIDGEIF_READ_UNPROTECT(lev);
+    return;
   }
-  /* not found, allocate new entry from free */
-  for (i = 0; i < fdb->max_fdb_entries; i++) {
-    bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
-    if (!e->used || !e->ts) {
-      BRIDGEIF_WRITE_PROTECT(lev);
-      /* check again when protected */
-      if (!e->used || !e->ts) {
-        LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: create src %02x:%02x:%02x:%02x:%02x:%02x (from %d) @ idx %d\n",
-                                         src_addr->addr[0], src_addr->addr[1], src_addr->addr[2], src_addr->addr[3], src_addr->addr[4], src_addr->addr[5],
-                                         port_idx, i));
-        memcpy(&e->addr, src_addr, sizeof(struct eth_addr));
-        e->ts = BR_FDB_TIMEOUT_SEC;
-        e->port = port_idx;
-        e->used = 1;
-        BRIDGEIF_WRITE_UNPROTECT(lev);
-        BRIDGEIF_READ_UNPROTECT(lev);
-        return;
-      }
+  /* not found, allocate new entry */
+  BRIDGEIF_WRITE_PROTECT(lev);
+  if (fdb->num_entries >= fdb->max_fdb_entries) {
+    /* free expired entries the age timer did not get to yet */
+    bridgeif_fdb_reclaim(fdb);
+    if (fdb->num_entries >= fdb->max_fdb_entries) {
       BRIDGEIF_WRITE_UNPROTECT(lev);
+      BRIDGEIF_READ_UNPROTECT(lev);
+      /* no free entry -> flood */
+      return;
     }
+    i = bridgeif_fdb_lookup(fdb, src_addr);
+    e = &fdb->fdb[i];
   }
+  LWIP_DEBUGF(BRIDGEIF_FDB_DEBUG, ("br: create src %02x:%02x:%02x:%02x:%02x:%02x (from %d) @ idx %d\n",
+                                   src_addr->addr[0], src_addr->addr[1], src_addr->addr[2], src_addr->addr[3], src_addr->addr[4], src_addr->addr[5],
+                                   port_idx, (int)i));
+  memcpy(&e->addr, src_addr, sizeof(struct eth_addr));
+  e->expires = fdb->now + BR_FDB_TIMEOUT_SEC;
+  e->port = port_idx;
+  e->used = 1;
+  fdb->num_entries++;
+  BRIDGEIF_WRITE_UNPROTECT(lev);
   BRIDGEIF_READ_UNPROTECT(lev);
-  /* not found, no free entry -> flood */
 }
 
-/** 
+/**
  * @ingroup bridgeif_fdb
- * Walk our list of auto-learnt fdb entries and return a port to forward or BR_FLOOD if unknown 
+ * Look up our auto-learnt fdb entries and return a port to forward or BR_FLOOD if unknown
  */
 bridgeif_portmask_t
 bridgeif_fdb_get_dst_ports(void *fdb_ptr, struct eth_addr *dst_addr)
 {
-  int i;
+  bridgeif_dfdb_entry_t *e;
+  bridgeif_portmask_t ret = BR_FLOOD;
   bridgeif_dfdb_t *fdb = (bridgeif_dfdb_t *)fdb_ptr;
   BRIDGEIF_DECL_PROTECT(lev);
   BRIDGEIF_READ_PROTECT(lev);
-  for (i = 0; i < fdb->max_fdb_entries; i++) {
-    bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
-    if (e->used && e->ts) {
-      if (!memcmp(&e->addr, dst_addr, sizeof(struct eth_addr))) {
-        bridgeif_portmask_t ret = (bridgeif_portmask_t)(1 << e->port);
-        BRIDGEIF_READ_UNPROTECT(lev);
-        return ret;
-      }
-    }
+  e = &fdb->fdb[bridgeif_fdb_lookup(fdb, dst_addr)];
+  if (e->used && !bridgeif_fdb_expired(fdb, e)) {
+    ret = (bridgeif_portmask_t)(1 << e->port);
   }
   BRIDGEIF_READ_UNPROTECT(lev);
-  return BR_FLOOD;
+  return ret;
 }
 
 /**
  * @ingroup bridgeif_fdb
- * Aging implementation of our simple fdb
+ * Aging implementation of our simple fdb: expired entries are not found any
+ * more, this frees their slots in a part of the table.
  */
 static void
 bridgeif_fdb_age_one_second(void *fdb_ptr)
 {
-  int i;
+  u32_t n;
   bridgeif_dfdb_t *fdb;
   BRIDGEIF_DECL_PROTECT(lev);
 
   fdb = (bridgeif_dfdb_t *)fdb_ptr;
+  n = (fdb->slot_mask + BR_FDB_SWEEP_SEC) / BR_FDB_SWEEP_SEC;
   BRIDGEIF_READ_PROTECT(lev);
-
-  for (i = 0; i < fdb->max_fdb_entries; i++) {
-    bridgeif_dfdb_entry_t *e = &fdb->fdb[i];
-    if (e->used && e->ts) {
-      BRIDGEIF_WRITE_PROTECT(lev);
-      /* check again when protected */
-      if (e->used && e->ts) {
-        if (--e->ts == 0) {
-          e->used = 0;
-        }
-      }
-      BRIDGEIF_WRITE_UNPROTECT(lev);
+  BRIDGEIF_WRITE_PROTECT(lev);
+  fdb->now++;
+  while (n-- > 0) {
+    bridgeif_dfdb_entry_t *e = &fdb->fdb[fdb->age_idx];
+    if (e->used && bridgeif_fdb_expired(fdb, e)) {
+      /* check this slot again, an entry may have been moved here */
+      bridgeif_fdb_remove_slot(fdb, fdb->age_idx);
+    } else {
+      fdb->age_idx = (fdb->age_idx + 1) & fdb->slot_mask;
     }
   }
+  BRIDGEIF_WRITE_UNPROTECT(lev);
   BRIDGEIF_READ_UNPROTECT(lev);
 }
 
@@ -189,14 +277,24 @@ bridgeif_age_tmr(void *arg)
 
 /**
  * @ingroup bridgeif_fdb
- * Init our simple fdb list
+ * Init our simple fdb hash table
  */
 void *
 bridgeif_fdb_init(u16_t max_fdb_entries)
 {
   bridgeif_dfdb_t *fdb;
-  size_t alloc_len_sizet = sizeof(bridgeif_dfdb_t) + (max_fdb_entries * sizeof(bridgeif_dfdb_entry_t));
-  mem_size_t alloc_len = (mem_size_t)alloc_len_sizet;
+  size_t alloc_len_sizet;
+  mem_size_t alloc_len;
+  u32_t num_slots = 2;
+  u8_t hash_shift = 31;
+
+  /* keep the load factor at 1/2 or below */
+  while (num_slots < 2 * (u32_t)max_fdb_entries) {
+    num_slots <<= 1;
+    hash_shift--;
+  }
+  alloc_len_sizet = sizeof(bridgeif_dfdb_t) + (num_slots * sizeof(bridgeif_dfdb_entry_t));
+  alloc_len = (mem_size_t)alloc_len_sizet;
   LWIP_ASSERT("alloc_len == alloc_len_sizet", alloc_len == alloc_len_sizet);
   LWIP_DEBUGF(BRIDGEIF_DEBUG, ("bridgeif_fdb_init: allocating %d bytes for private FDB data\n", (int)alloc_len));
   fdb = (bridgeif_dfdb_t *)mem_calloc(1, alloc_len);
@@ -204,9 +302,23 @@ bridgeif_fdb_init(u16_t max_fdb_entries)
     return NULL;
   }
   fdb->max_fdb_entries = max_fdb_entries;
+  fdb->slot_mask = num_slots - 1;
+  fdb->hash_shift = hash_shift;
+  fdb->reclaimed = fdb->now - 1;
   fdb->fdb = (bridgeif_dfdb_entry_t *)(fdb + 1);
 
   sys_timeout(BRIDGEIF_AGE_TIMER_MS, bridgeif_age_tmr, fdb);
 
   return fdb;
 }
+
+/**
+ * @ingroup bridgeif_fdb
+ * Stop aging and free an fdb returned by @ref bridgeif_fdb_init
+ */
+void
+bridgeif_fdb_deinit(void *fdb_ptr)
+{
+  sys_untimeout(bridgeif_age_tmr, fdb_ptr);
+  mem_free(fdb_ptr);
+}
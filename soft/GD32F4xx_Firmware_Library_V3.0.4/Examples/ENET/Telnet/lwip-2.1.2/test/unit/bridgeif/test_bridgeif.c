@@ -0,0 +1,291 @@
+#include "test_bridgeif.h"
+
+#include "netif/bridgeif.h"
+#include "lwip/timeouts.h"
+#include "lwip/tcpip.h"
+#include "netif/ethernet.h"
+#include "lwip/stats.h"
+
+#include <time.h>
+
+#define TEST_FDB_MACS   300
+#define TEST_FDB_PORTS  4
+
+static u32_t test_rand_state;
+
+static u16_t
+test_rand(void)
+{
+  test_rand_state = test_rand_state * 1103515245UL + 12345UL;
+  return (u16_t)((test_rand_state >> 16) & 0x7FFF);
+}
+
+/* MAC addresses sharing their OUI, like devices of the same vendor */
+static void
+test_mac(struct eth_addr *addr, u16_t n)
+{
+  addr->addr[0] = 0x02;
+  addr->addr[1] = 0x00;
+  addr->addr[2] = 0x5e;
+  addr->addr[3] = 0x10;
+  addr->addr[4] = (u8_t)(n >> 8);
+  addr->addr[5] = (u8_t)n;
+}
+
+static u8_t
+test_port_of(void *fdb, u16_t n)
+{
+  struct eth_addr addr;
+  bridgeif_portmask_t ports;
+  u8_t port;
+
+  test_mac(&addr, n);
+  ports = bridgeif_fdb_get_dst_ports(fdb, &addr);
+  if (ports == BR_FLOOD) {
+    return 0xFF;
+  }
+  for (port = 0; (ports & 1) == 0; port++) {
+    ports >>= 1;
+  }
+  fail_unless(ports == 1);
+  return port;
+}
+
+static void
+test_learn(void *fdb, u16_t n, u8_t port)
+{
+  struct eth_addr addr;
+  test_mac(&addr, n);
+  bridgeif_fdb_update_src(fdb, &addr, port);
+}
+
+/* let the fdb age timer run */
+static void
+test_seconds(u32_t seconds)
+{
+  while (seconds-- > 0) {
+    lwip_sys_now += 1000;
+    sys_check_timeouts();
+  }
+}
+
+/* Setups/teardown functions */
+
+static void
+bridgeif_setup(void)
+{
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+bridgeif_teardown(void)
+{
+  /* the stack timers run by test_seconds() queue packets (e.g. IGMP
+     reports) on the loopback netif: drain it */
+  while (tcpip_thread_poll_one());
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+START_TEST(test_bridgeif_fdb_learn)
+{
+  void *fdb;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  fdb = bridgeif_fdb_init(TEST_FDB_MACS);
+  fail_unless(fdb != NULL);
+
+  for (i = 0; i < TEST_FDB_MACS; i++) {
+    test_learn(fdb, i, (u8_t)(i % TEST_FDB_PORTS));
+  }
+  for (i = 0; i < TEST_FDB_MACS; i++) {
+    fail_unless(test_port_of(fdb, i) == i % TEST_FDB_PORTS);
+  }
+  /* unknown and not learnt when full */
+  fail_unless(test_port_of(fdb, TEST_FDB_MACS) == 0xFF);
+  test_learn(fdb, TEST_FDB_MACS, 1);
+  fail_unless(test_port_of(fdb, TEST_FDB_MACS) == 0xFF);
+
+  /* station moved to another port */
+  test_learn(fdb, 7, 0);
+  fail_unless(test_port_of(fdb, 7) == 0);
+
+  bridgeif_fdb_deinit(fdb);
+}
+END_TEST
+
+START_TEST(test_bridgeif_fdb_age)
+{
+  void *fdb;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  fdb = bridgeif_fdb_init(4);
+  fail_unless(fdb != NULL);
+
+  test_learn(fdb, 1, 1);
+  test_seconds(200);
+  test_learn(fdb, 2, 2);
+  test_seconds(99);
+  fail_unless(test_port_of(fdb, 1) == 1);
+  test_seconds(1);
+  fail_unless(test_port_of(fdb, 1) == 0xFF);
+  fail_unless(test_port_of(fdb, 2) == 2);
+  test_seconds(200);
+  fail_unless(test_port_of(fdb, 2) == 0xFF);
+
+  /* expired entries make room for new ones right away */
+  for (i = 10; i < 14; i++) {
+    test_learn(fdb, i, 3);
+  }
+  test_seconds(300);
+  for (i = 20; i < 24; i++) {
+    test_learn(fdb, i, 0);
+  }
+  for (i = 20; i < 24; i++) {
+    fail_unless(test_port_of(fdb, i) == 0);
+  }
+
+  bridgeif_fdb_deinit(fdb);
+}
+END_TEST
+
+/* compare learning and ageing against a simple model */
+START_TEST(test_bridgeif_fdb_random)
+{
+  static u32_t expires[2 * TEST_FDB_MACS];
+  static u8_t ports[2 * TEST_FDB_MACS];
+  const u16_t max_entries = TEST_FDB_MACS / 2;
+  u32_t now = 0;
+  void *fdb;
+  u16_t i, j, live, wrong = 0;
+  LWIP_UNUSED_ARG(_i);
+
+  test_rand_state = 0x1d;
+  memset(expires, 0, sizeof(expires));
+  fdb = bridgeif_fdb_init(max_entries);
+  fail_unless(fdb != NULL);
+
+  for (i = 0; i < 4000; i++) {
+    u16_t n = (u16_t)(test_rand() % (2 * TEST_FDB_MACS));
+    u8_t port = (u8_t)(test_rand() % TEST_FDB_PORTS);
+
+    for (j = 0, live = 0; j < 2 * TEST_FDB_MACS; j++) {
+      if (expires[j] > now) {
+        live++;
+      }
+    }
+    if ((expires[n] > now) || (live < max_entries)) {
+      expires[n] = now + 300;
+      ports[n] = port;
+    }
+    test_learn(fdb, n, port);
+
+    if ((test_rand() & 7) == 0) {
+      u32_t seconds = test_rand() % 60;
+      test_seconds(seconds);
+      now += seconds;
+    }
+    for (j = 0; j < 2 * TEST_FDB_MACS; j++) {
+      if (test_port_of(fdb, j) != ((expires[j] > now) ? ports[j] : 0xFF)) {
+        wrong++;
+      }
+    }
+  }
+  fail_unless(wrong == 0);
+
+  bridgeif_fdb_deinit(fdb);
+}
+END_TEST
+
+static err_t
+test_port_linkoutput(struct netif *netif, struct pbuf *p)
+{
+  LWIP_UNUSED_ARG(netif);
+  LWIP_UNUSED_ARG(p);
+  return ERR_OK;
+}
+
+static err_t
+test_port_init(struct netif *netif)
+{
+  netif->linkoutput = test_port_linkoutput;
+  netif->hwaddr_len = ETH_HWADDR_LEN;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET;
+  return ERR_OK;
+}
+
+/* removing a bridge frees its private data and stops the fdb aging */
+START_TEST(test_bridgeif_remove)
+{
+  bridgeif_initdata_t init_data = BRIDGEIF_INITDATA1(2, 16, 4, ETH_ADDR(0x02, 0x00, 0x5e, 0x00, 0x00, 0x01));
+  struct netif bridge, port;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(netif_add_noaddr(&port, NULL, test_port_init, ethernet_input) == &port);
+  fail_unless(netif_add_noaddr(&bridge, &init_data, bridgeif_init, ethernet_input) == &bridge);
+  fail_unless(bridgeif_add_port(&bridge, &port) == ERR_OK);
+  test_seconds(2);
+
+  bridgeif_remove(&bridge);
+  fail_unless(bridge.state == NULL);
+  while (tcpip_thread_poll_one());
+  fail_unless(lwip_stats.mem.used == 0);
+  test_seconds(2);
+  netif_remove(&port);
+}
+END_TEST
+
+/* report learning + forwarding decisions per second with a few hundred stations */
+START_TEST(test_bridgeif_fdb_throughput)
+{
+  const u32_t frames = 1000000;
+  struct eth_addr macs[TEST_FDB_MACS];
+  u32_t i, wrong = 0;
+  clock_t start, elapsed;
+  void *fdb;
+  LWIP_UNUSED_ARG(_i);
+
+  fdb = bridgeif_fdb_init(TEST_FDB_MACS);
+  fail_unless(fdb != NULL);
+  for (i = 0; i < TEST_FDB_MACS; i++) {
+    test_mac(&macs[i], (u16_t)i);
+    bridgeif_fdb_update_src(fdb, &macs[i], (u8_t)(i % TEST_FDB_PORTS));
+  }
+
+  start = clock();
+  for (i = 0; i < frames; i++) {
+    u32_t src = i % TEST_FDB_MACS;
+    u32_t dst = (i * 7 + 1) % TEST_FDB_MACS;
+    bridgeif_fdb_update_src(fdb, &macs[src], (u8_t)(src % TEST_FDB_PORTS));
+    if (bridgeif_fdb_get_dst_ports(fdb, &macs[dst]) != (1 << (dst % TEST_FDB_PORTS))) {
+      wrong++;
+    }
+  }
+  elapsed = clock() - start;
+  fail_unless(wrong == 0);
+
+  LWIP_PLATFORM_DIAG(("bridgeif fdb: %d stations, %"U32_F" frames/s\n", TEST_FDB_MACS,
+                      (u32_t)(frames / ((double)(elapsed + 1) / CLOCKS_PER_SEC))));
+
+  bridgeif_fdb_deinit(fdb);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+bridgeif_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_bridgeif_fdb_learn),
+    TESTFUNC(test_bridgeif_fdb_age),
+    TESTFUNC(test_bridgeif_fdb_random),
+    TESTFUNC(test_bridgeif_remove),
+    TESTFUNC(test_bridgeif_fdb_throughput)
+  };
+  return create_suite("BRIDGEIF", tests, sizeof(tests)/sizeof(testfunc), bridgeif_setup, bridgeif_teardown);
+}
@@ -0,0 +1,508 @@
+#include "test_dns.h"
+
+#include "lwip/dns.h"
+#include "lwip/udp.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+#include "lwip/prot/dns.h"
+
+#include <time.h>
+
+#if !LWIP_DNS || !LWIP_UDP || !LWIP_IPV4 || !LWIP_IPV6
+#error "This tests needs DNS, UDP, IPv4 and IPv6 enabled"
+#endif
+
+#define TEST_DNS_FLUSH_TICKS  400
+
+/* a query sent by the resolver to the DNS stand-in */
+struct test_dns_query {
+  u16_t port;
+  u16_t id;
+  u16_t type;
+  u16_t len;
+  u8_t data[128];
+};
+
+static struct netif test_netif;
+static ip4_addr_t test_gw, test_ipaddr, test_netmask, test_server;
+
+static struct test_dns_query queries[64];
+static int query_count;
+
+static int found_count;
+static int found_failed;
+static ip_addr_t found_addr;
+
+/* Helper functions */
+static void
+test_dns_found(const char *name, const ip_addr_t *ipaddr, void *arg)
+{
+  LWIP_UNUSED_ARG(name);
+  LWIP_UNUSED_ARG(arg);
+  found_count++;
+  if (ipaddr != NULL) {
+    ip_addr_copy(found_addr, *ipaddr);
+  } else {
+    found_failed++;
+  }
+}
+
+static err_t
+test_dns_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct udp_hdr udphdr;
+  struct test_dns_query *q;
+
+  fail_unless(netif == &test_netif);
+  fail_unless(ip4_addr_cmp(ipaddr, &test_server));
+  EXPECT_RETX(query_count < (int)LWIP_ARRAYSIZE(queries), ERR_OK);
+  pbuf_copy_partial(p, &udphdr, UDP_HLEN, IP_HLEN);
+  fail_unless(lwip_ntohs(udphdr.dest) == DNS_SERVER_PORT);
+
+  q = &queries[query_count++];
+  q->port = lwip_ntohs(udphdr.src);
+  q->len = (u16_t)(p->tot_len - IP_HLEN - UDP_HLEN);
+  EXPECT_RETX(q->len <= sizeof(q->data), ERR_OK);
+  pbuf_copy_partial(p, q->data, q->len, IP_HLEN + UDP_HLEN);
+  q->id = (u16_t)((q->data[0] << 8) | q->data[1]);
+  q->type = (u16_t)((q->data[q->len - 4] << 8) | q->data[q->len - 3]);
+  return ERR_OK;
+}
+
+static err_t
+test_dns_netif_init(struct netif *netif)
+{
+  netif->output = test_dns_netif_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/* inject a UDP datagram from the DNS server */
+static void
+test_dns_server_send(u16_t dest_port, const void *data, u16_t len)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  struct udp_hdr *udphdr;
+  err_t err;
+
+  p = pbuf_alloc(PBUF_RAW, (u16_t)(IP_HLEN + UDP_HLEN + len), PBUF_RAM);
+  EXPECT_RET(p != NULL);
+
+  iphdr = (struct ip_hdr *)p->payload;
+  memset(iphdr, 0, IP_HLEN);
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_LEN_SET(iphdr, lwip_htons(p->tot_len));
+  IPH_TTL_SET(iphdr, 32);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip4_addr_copy(iphdr->src, test_server);
+  ip4_addr_copy(iphdr->dest, test_ipaddr);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  udphdr = (struct udp_hdr *)((u8_t *)p->payload + IP_HLEN);
+  udphdr->src = lwip_htons(DNS_SERVER_PORT);
+  udphdr->dest = lwip_htons(dest_port);
+  udphdr->len = lwip_htons((u16_t)(UDP_HLEN + len));
+  udphdr->chksum = 0;
+  memcpy((u8_t *)p->payload + IP_HLEN + UDP_HLEN, data, len);
+
+  err = ip4_input(p, &test_netif);
+  fail_unless(err == ERR_OK);
+}
+
+static u8_t *
+test_dns_put16(u8_t *buf, u16_t val)
+{
+  buf[0] = (u8_t)(val >> 8);
+  buf[1] = (u8_t)val;
+  return buf + 2;
+}
+
+static u8_t *
+test_dns_put32(u8_t *buf, u32_t val)
+{
+  buf = test_dns_put16(buf, (u16_t)(val >> 16));
+  return test_dns_put16(buf, (u16_t)val);
+}
+
+/* Answer a query with 'rcode' and one address record (if addr != NULL).
+ * soa_minimum != 0 adds an SOA record to the authority section. */
+static void
+test_dns_respond_ext(const struct test_dns_query *q, u8_t rcode, const ip_addr_t *addr, u32_t ttl,
+                     u32_t soa_minimum)
+{
+  u8_t buf[256];
+  u8_t *rr;
+
+  memcpy(buf, q->data, q->len);
+  buf[2] = DNS_FLAG1_RESPONSE | DNS_FLAG1_RD;
+  buf[3] = (u8_t)(DNS_FLAG2_RA | rcode);
+  test_dns_put16(&buf[6], (u16_t)(addr != NULL ? 1 : 0));
+  test_dns_put16(&buf[8], (u16_t)(soa_minimum != 0 ? 1 : 0));
+  rr = &buf[q->len];
+  if (addr != NULL) {
+    /* name: pointer to the question */
+    rr = test_dns_put16(rr, 0xC00C);
+    if (IP_IS_V6(addr)) {
+      rr = test_dns_put16(rr, DNS_RRTYPE_AAAA);
+      rr = test_dns_put16(rr, DNS_RRCLASS_IN);
+      rr = test_dns_put32(rr, ttl);
+      rr = test_dns_put16(rr, 16);
+      memcpy(rr, ip_2_ip6(addr)->addr, 16);
+      rr += 16;
+    } else {
+      rr = test_dns_put16(rr, DNS_RRTYPE_A);
+      rr = test_dns_put16(rr, DNS_RRCLASS_IN);
+      rr = test_dns_put32(rr, ttl);
+      rr = test_dns_put16(rr, 4);
+      memcpy(rr, &ip_2_ip4(addr)->addr, 4);
+      rr += 4;
+    }
+  }
+  if (soa_minimum != 0) {
+    rr = test_dns_put16(rr, 0xC00C);
+    rr = test_dns_put16(rr, DNS_RRTYPE_SOA);
+    rr = test_dns_put16(rr, DNS_RRCLASS_IN);
+    rr = test_dns_put32(rr, 3600);
+    rr = test_dns_put16(rr, 22);
+    /* MNAME and RNAME (root), serial, refresh, retry, expire, minimum */
+    *rr++ = 0;
+    *rr++ = 0;
+    rr = test_dns_put32(rr, 1);
+    rr = test_dns_put32(rr, 7200);
+    rr = test_dns_put32(rr, 900);
+    rr = test_dns_put32(rr, 86400);
+    rr = test_dns_put32(rr, soa_minimum);
+  }
+  test_dns_server_send(q->port, buf, (u16_t)(rr - buf));
+}
+
+static void
+test_dns_respond(const struct test_dns_query *q, const ip_addr_t *addr, u32_t ttl)
+{
+  test_dns_respond_ext(q, DNS_FLAG2_ERR_NONE, addr, ttl, 0);
+}
+
+static void
+test_dns_name(char *buf, size_t len, int n)
+{
+  snprintf(buf, len, "host%d.example.com", n);
+}
+
+static void
+test_dns_ticks(int ticks)
+{
+  while (ticks-- > 0) {
+    dns_tmr();
+  }
+}
+
+/* Setups/teardown functions */
+
+static void
+dns_setup(void)
+{
+  ip_addr_t server;
+  u8_t i;
+
+  IP4_ADDR(&test_ipaddr, 192,168,0,1);
+  IP4_ADDR(&test_netmask, 255,255,255,0);
+  IP4_ADDR(&test_gw, 192,168,0,254);
+  IP4_ADDR(&test_server, 192,168,0,53);
+  netif_add(&test_netif, &test_ipaddr, &test_netmask, &test_gw, NULL, test_dns_netif_init, NULL);
+  netif_set_up(&test_netif);
+  netif_set_default(&test_netif);
+  /* only one server (others may be left over from DHCP tests) */
+  for (i = 1; i < DNS_MAX_SERVERS; i++) {
+    dns_setserver(i, NULL);
+  }
+  ip_addr_copy_from_ip4(server, test_server);
+  dns_setserver(0, &server);
+
+  query_count = 0;
+  found_count = 0;
+  found_failed = 0;
+  ip_addr_set_zero(&found_addr);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+dns_teardown(void)
+{
+  /* let pending queries time out and cached entries expire */
+  test_dns_ticks(TEST_DNS_FLUSH_TICKS);
+  dns_setserver(0, NULL);
+  netif_set_default(NULL);
+  netif_remove(&test_netif);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/* cached names are answered without queries; report the hit latency */
+START_TEST(test_dns_cache_hit)
+{
+  const int names = DNS_TABLE_SIZE - 8;
+  const u32_t lookups = 200000;
+  char name[32];
+  ip_addr_t addr, expected;
+  u32_t i, wrong = 0;
+  clock_t start, elapsed;
+  err_t err;
+  int n;
+  LWIP_UNUSED_ARG(_i);
+
+  for (n = 0; n < names; n++) {
+    test_dns_name(name, sizeof(name), n);
+    err = dns_gethostbyname_addrtype(name, &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+    fail_unless(err == ERR_INPROGRESS);
+    fail_unless(query_count == n + 1);
+    fail_unless(queries[n].type == DNS_RRTYPE_A);
+    IP_ADDR4(&expected, 10,0,0,n);
+    test_dns_respond(&queries[n], &expected, 60);
+    fail_unless(found_count == n + 1);
+    fail_unless(ip_addr_cmp(&found_addr, &expected));
+  }
+  fail_unless(found_failed == 0);
+
+  start = clock();
+  for (i = 0; i < lookups; i++) {
+    n = (int)(i % (u32_t)names);
+    test_dns_name(name, sizeof(name), n);
+    err = dns_gethostbyname_addrtype(name, &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+    if ((err != ERR_OK) || (ip4_addr_get_u32(ip_2_ip4(&addr)) != PP_HTONL(LWIP_MAKEU32(10, 0, 0, n)))) {
+      wrong++;
+    }
+  }
+  elapsed = clock() - start;
+  fail_unless(wrong == 0);
+  fail_unless(query_count == names);
+
+  LWIP_PLATFORM_DIAG(("dns: %d cached names, %"U32_F" ns per hit, %d queries\n", names,
+                      (u32_t)(((double)elapsed / CLOCKS_PER_SEC) * 1e9 / lookups), query_count));
+
+  /* names are case insensitive */
+  err = dns_gethostbyname_addrtype("HOST3.Example.COM", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_OK);
+  fail_unless(query_count == names);
+}
+END_TEST
+
+/* entries expire after their TTL; a full table evicts the entry expiring first */
+START_TEST(test_dns_expiry)
+{
+  char name[32];
+  ip_addr_t addr, expected;
+  err_t err;
+  int n;
+  LWIP_UNUSED_ARG(_i);
+
+  for (n = 0; n < DNS_TABLE_SIZE; n++) {
+    test_dns_name(name, sizeof(name), n);
+    err = dns_gethostbyname_addrtype(name, &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+    fail_unless(err == ERR_INPROGRESS);
+    IP_ADDR4(&expected, 10,0,0,n);
+    /* host7 expires first, then host0, host1, ... */
+    test_dns_respond(&queries[n], &expected, (n == 7) ? 5 : (u32_t)(100 + n));
+  }
+  fail_unless(query_count == DNS_TABLE_SIZE);
+  fail_unless(found_count == DNS_TABLE_SIZE);
+
+  /* the table is full: a new name replaces host7 */
+  err = dns_gethostbyname_addrtype("new.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_INPROGRESS);
+  for (n = 0; n < DNS_TABLE_SIZE; n++) {
+    test_dns_name(name, sizeof(name), n);
+    err = dns_gethostbyname_addrtype(name, &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+    fail_unless(err == ((n == 7) ? ERR_INPROGRESS : ERR_OK));
+    if (n == 7) {
+      break;
+    }
+  }
+  /* asking for host7 again has replaced host0 */
+  fail_unless(query_count == DNS_TABLE_SIZE + 2);
+  IP_ADDR4(&expected, 10,0,0,7);
+  test_dns_respond(&queries[DNS_TABLE_SIZE + 1], &expected, 2);
+  IP_ADDR4(&expected, 10,0,1,0);
+  test_dns_respond(&queries[DNS_TABLE_SIZE], &expected, 200);
+  fail_unless(found_count == DNS_TABLE_SIZE + 2);
+
+  /* TTL expiry */
+  test_dns_ticks(1);
+  err = dns_gethostbyname_addrtype("host7.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_OK);
+  test_dns_ticks(1);
+  n = query_count;
+  err = dns_gethostbyname_addrtype("host7.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_INPROGRESS);
+  fail_unless(query_count == n + 1);
+}
+END_TEST
+
+/* concurrent lookups of one name share a single query */
+START_TEST(test_dns_dedup)
+{
+  ip_addr_t addr, expected;
+  err_t err;
+  int n;
+  LWIP_UNUSED_ARG(_i);
+
+  for (n = 0; n < 5; n++) {
+    err = dns_gethostbyname_addrtype((n & 1) ? "WWW.example.com" : "www.example.com", &addr,
+                                     test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+    fail_unless(err == ERR_INPROGRESS);
+  }
+  fail_unless(query_count == 1);
+  fail_unless(found_count == 0);
+
+  IP_ADDR4(&expected, 10,1,2,3);
+  test_dns_respond(&queries[0], &expected, 60);
+  fail_unless(found_count == 5);
+  fail_unless(found_failed == 0);
+  fail_unless(ip_addr_cmp(&found_addr, &expected));
+
+  /* dual stack lookups share both queries */
+  for (n = 0; n < 3; n++) {
+    err = dns_gethostbyname_addrtype("dual.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV6_IPV4);
+    fail_unless(err == ERR_INPROGRESS);
+  }
+  fail_unless(query_count == 3);
+  fail_unless(queries[1].type == DNS_RRTYPE_AAAA);
+  fail_unless(queries[2].type == DNS_RRTYPE_A);
+  IP_ADDR6_HOST(&expected, 0x20010db8, 0, 0, 1);
+  test_dns_respond(&queries[1], &expected, 60);
+  fail_unless(found_count == 8);
+  fail_unless(ip_addr_cmp(&found_addr, &expected));
+}
+END_TEST
+
+/* failed lookups are cached and answered without queries */
+START_TEST(test_dns_negative)
+{
+  ip_addr_t addr;
+  err_t err;
+  int i;
+  LWIP_UNUSED_ARG(_i);
+
+  /* NXDOMAIN without SOA: cached for DNS_NEG_CACHE_TTL */
+  err = dns_gethostbyname_addrtype("nx.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_INPROGRESS);
+  test_dns_respond_ext(&queries[0], DNS_FLAG2_ERR_NAME, NULL, 0, 0);
+  fail_unless(found_count == 1);
+  fail_unless(found_failed == 1);
+  for (i = 0; i < DNS_NEG_CACHE_TTL; i++) {
+    err = dns_gethostbyname_addrtype("nx.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+    fail_unless(err == ERR_VAL);
+    test_dns_ticks(1);
+  }
+  fail_unless(query_count == 1);
+  err = dns_gethostbyname_addrtype("nx.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_INPROGRESS);
+  fail_unless(query_count == 2);
+
+  /* NXDOMAIN with SOA: cached for the SOA minimum */
+  test_dns_respond_ext(&queries[1], DNS_FLAG2_ERR_NAME, NULL, 0, 3);
+  fail_unless(found_failed == 2);
+  test_dns_ticks(2);
+  err = dns_gethostbyname_addrtype("nx.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_VAL);
+  test_dns_ticks(1);
+  err = dns_gethostbyname_addrtype("nx.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_INPROGRESS);
+  fail_unless(query_count == 3);
+
+  /* timeout: cached for DNS_FAIL_CACHE_TTL */
+  for (i = 0; (i < 20) && (found_count < 3); i++) {
+    test_dns_ticks(1);
+  }
+  fail_unless(found_failed == 3);
+  fail_unless(query_count == 2 + DNS_MAX_RETRIES);
+  err = dns_gethostbyname_addrtype("nx.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_VAL);
+  test_dns_ticks(DNS_FAIL_CACHE_TTL);
+  err = dns_gethostbyname_addrtype("nx.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_INPROGRESS);
+}
+END_TEST
+
+/* A and AAAA are queried in parallel for dual stack lookups */
+START_TEST(test_dns_parallel)
+{
+  ip_addr_t addr, addr4, addr6;
+  err_t err;
+  LWIP_UNUSED_ARG(_i);
+
+  IP_ADDR4(&addr4, 10,0,0,1);
+  IP_ADDR6_HOST(&addr6, 0x20010db8, 0, 0, 1);
+
+  /* the preferred type is returned even if it is answered last */
+  err = dns_gethostbyname_addrtype("a.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4_IPV6);
+  fail_unless(err == ERR_INPROGRESS);
+  fail_unless(query_count == 2);
+  fail_unless(queries[0].type == DNS_RRTYPE_A);
+  fail_unless(queries[1].type == DNS_RRTYPE_AAAA);
+  test_dns_respond(&queries[1], &addr6, 60);
+  fail_unless(found_count == 0);
+  test_dns_respond(&queries[0], &addr4, 60);
+  fail_unless(found_count == 1);
+  fail_unless(ip_addr_cmp(&found_addr, &addr4));
+  /* both types are cached */
+  err = dns_gethostbyname_addrtype("a.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV6);
+  fail_unless(err == ERR_OK);
+  fail_unless(ip_addr_cmp(&addr, &addr6));
+
+  /* the other type is returned if the preferred one has no address */
+  err = dns_gethostbyname_addrtype("b.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4_IPV6);
+  fail_unless(err == ERR_INPROGRESS);
+  fail_unless(query_count == 4);
+  test_dns_respond(&queries[2], NULL, 0);
+  fail_unless(found_count == 1);
+  test_dns_respond(&queries[3], &addr6, 60);
+  fail_unless(found_count == 2);
+  fail_unless(ip_addr_cmp(&found_addr, &addr6));
+  err = dns_gethostbyname_addrtype("b.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4_IPV6);
+  fail_unless(err == ERR_OK);
+  fail_unless(ip_addr_cmp(&addr, &addr6));
+  err = dns_gethostbyname_addrtype("b.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4);
+  fail_unless(err == ERR_VAL);
+  fail_unless(query_count == 4);
+
+  /* ...or if the preferred one is still pending one timer interval later */
+  err = dns_gethostbyname_addrtype("c.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4_IPV6);
+  fail_unless(err == ERR_INPROGRESS);
+  fail_unless(query_count == 6);
+  test_dns_respond(&queries[5], &addr6, 60);
+  fail_unless(found_count == 2);
+  test_dns_ticks(1);
+  fail_unless(found_count == 3);
+  fail_unless(ip_addr_cmp(&found_addr, &addr6));
+  /* the late answer is cached only */
+  test_dns_respond(&queries[4], &addr4, 60);
+  fail_unless(found_count == 3);
+  err = dns_gethostbyname_addrtype("c.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV4_IPV6);
+  fail_unless(err == ERR_OK);
+  fail_unless(ip_addr_cmp(&addr, &addr4));
+
+  /* if one type failed recently, only the other one is queried */
+  err = dns_gethostbyname_addrtype("b.example.com", &addr, test_dns_found, NULL, LWIP_DNS_ADDRTYPE_IPV6);
+  fail_unless(err == ERR_OK);
+  fail_unless(found_failed == 0);
+}
+END_TEST
+
+
+/** Create the suite including all tests for this module */
+Suite *
+dns_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_dns_cache_hit),
+    TESTFUNC(test_dns_expiry),
+    TESTFUNC(test_dns_dedup),
+    TESTFUNC(test_dns_negative),
+    TESTFUNC(test_dns_parallel)
+  };
+  return create_suite("DNS", tests, sizeof(tests)/sizeof(testfunc), dns_setup, dns_teardown);
+}
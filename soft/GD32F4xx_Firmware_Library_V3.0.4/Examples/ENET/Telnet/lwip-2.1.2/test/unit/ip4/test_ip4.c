@@ -1,6 +1,7 @@
 #include "test_ip4.h"
 
 #include "lwip/ip4.h"
+#include "lwip/ip4_frag.h"
 #include "lwip/inet_chksum.h"
 #include "lwip/stats.h"
 #include "lwip/prot/ip.h"
@@ -8,10 +9,12 @@
 
 #include "lwip/tcpip.h"
 
-#if !LWIP_IPV4 || !IP_REASSEMBLY || !MIB2_STATS || !IPFRAG_STATS
-#error "This tests needs LWIP_IPV4, IP_REASSEMBLY; MIB2- and IPFRAG-statistics enabled"
+#if !LWIP_IPV4 || !IP_REASSEMBLY || !MIB2_STATS || !IPFRAG_STATS || !IP_REASS_STATS
+#error "This tests needs LWIP_IPV4, IP_REASSEMBLY; MIB2-, IPFRAG- and IP_REASS-statistics enabled"
 #endif
 
+static u32_t reass_rand_state;
+
 /* Helper functions */
 static void
 create_ip4_input_fragment(u16_t ip_id, u16_t start, u16_t len, int last)
@@ -52,6 +55,68 @@ create_ip4_input_fragment(u16_t ip_id, u16_t start, u16_t len, int last)
   }
 }
 
+/* Create a fragment from 10.0.0.src_host with every payload byte set to its
+   offset in the datagram and pass it to ip4_reass() directly */
+static struct pbuf *
+reass_ip4_fragment(u8_t src_host, u16_t ip_id, u16_t start, u16_t len, int last)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  u16_t i;
+
+  p = pbuf_alloc(PBUF_RAW, (u16_t)(len + sizeof(struct ip_hdr)), PBUF_RAM);
+  fail_unless(p != NULL);
+  if (p == NULL) {
+    return NULL;
+  }
+  iphdr = (struct ip_hdr *)p->payload;
+  IPH_VHL_SET(iphdr, 4, sizeof(struct ip_hdr) / 4);
+  IPH_TOS_SET(iphdr, 0);
+  IPH_LEN_SET(iphdr, lwip_htons(p->tot_len));
+  IPH_ID_SET(iphdr, lwip_htons(ip_id));
+  if (last) {
+    IPH_OFFSET_SET(iphdr, lwip_htons(start / 8));
+  } else {
+    IPH_OFFSET_SET(iphdr, lwip_htons((start / 8) | IP_MF));
+  }
+  IPH_TTL_SET(iphdr, 5);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  IPH_CHKSUM_SET(iphdr, 0);
+  IP4_ADDR(&iphdr->src, 10, 0, 0, src_host);
+  IP4_ADDR(&iphdr->dest, 10, 0, 0, 1);
+  for (i = 0; i < len; i++) {
+    ((u8_t *)p->payload)[sizeof(struct ip_hdr) + i] = (u8_t)(start + i);
+  }
+  return ip4_reass(p);
+}
+
+/* Check the payload of a datagram reassembled from reass_ip4_fragment() */
+static void
+check_reassembled(struct pbuf *p, u16_t datagram_len)
+{
+  u16_t i, wrong = 0;
+
+  fail_unless(p != NULL);
+  if (p != NULL) {
+    fail_unless(p->tot_len == datagram_len + IP_HLEN);
+    fail_unless(IPH_OFFSET(((struct ip_hdr *)p->payload)) == 0);
+    for (i = 0; i < datagram_len; i++) {
+      if (pbuf_get_at(p, (u16_t)(IP_HLEN + i)) != (u8_t)i) {
+        wrong++;
+      }
+    }
+    fail_unless(wrong == 0);
+    pbuf_free(p);
+  }
+}
+
+static u16_t
+reass_rand(void)
+{
+  reass_rand_state = reass_rand_state * 1103515245UL + 12345UL;
+  return (u16_t)((reass_rand_state >> 16) & 0x7FFF);
+}
+
 /* Setups/teardown functions */
 
 static void
@@ -148,6 +213,136 @@ START_TEST(test_ip4_reass)
 }
 END_TEST
 
+START_TEST(test_ip4_reass_dup_overlap)
+{
+  struct pbuf *p;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&lwip_stats.ip_reass, 0, sizeof(lwip_stats.ip_reass));
+  memset(&lwip_stats.ip_frag, 0, sizeof(lwip_stats.ip_frag));
+
+  fail_unless(reass_ip4_fragment(2, 1, 0, 16, 0) == NULL);
+  fail_unless(reass_ip4_fragment(2, 1, 0, 16, 0) == NULL);
+  fail_unless(lwip_stats.ip_reass.dup == 1);
+  fail_unless(reass_ip4_fragment(2, 1, 8, 16, 0) == NULL);
+  fail_unless(lwip_stats.ip_reass.overlap == 1);
+
+  fail_unless(reass_ip4_fragment(2, 1, 32, 8, 0) == NULL);
+  /* last fragment ending before data received already */
+  fail_unless(reass_ip4_fragment(2, 1, 16, 4, 1) == NULL);
+  fail_unless(lwip_stats.ip_frag.err == 1);
+  /* fragment other than the last one not ending on an 8-byte boundary */
+  fail_unless(reass_ip4_fragment(2, 1, 16, 12, 0) == NULL);
+  fail_unless(lwip_stats.ip_frag.err == 2);
+
+  fail_unless(reass_ip4_fragment(2, 1, 40, 3, 1) == NULL);
+  /* a second last fragment and data beyond the end are invalid */
+  fail_unless(reass_ip4_fragment(2, 1, 48, 3, 1) == NULL);
+  fail_unless(reass_ip4_fragment(2, 1, 48, 8, 0) == NULL);
+  fail_unless(lwip_stats.ip_frag.err == 4);
+  fail_unless(lwip_stats.ip_reass.ok == 0);
+
+  p = reass_ip4_fragment(2, 1, 16, 16, 0);
+  check_reassembled(p, 43);
+  fail_unless(lwip_stats.ip_reass.ok == 1);
+
+  fail_unless(reass_ip4_fragment(2, 2, IP_REASS_MAX_DATAGRAM_LEN & ~7, 8, 1) == NULL);
+  fail_unless(lwip_stats.ip_reass.toobig == 1);
+  fail_unless(lwip_stats.ip_reass.dup == 1);
+  fail_unless(lwip_stats.ip_reass.overlap == 1);
+  fail_unless(lwip_stats.ip_reass.evict == 0);
+}
+END_TEST
+
+START_TEST(test_ip4_reass_source_budget)
+{
+  struct pbuf *p;
+  u16_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&lwip_stats.ip_reass, 0, sizeof(lwip_stats.ip_reass));
+
+  /* 10.0.0.3 starts a datagram */
+  fail_unless(reass_ip4_fragment(3, 100, 0, 8, 0) == NULL);
+
+  /* 10.0.0.2 starts more datagrams than MEMP_NUM_REASSDATA:
+     this only displaces its own datagrams */
+  for (i = 0; i < 3 * MEMP_NUM_REASSDATA; i++) {
+    fail_unless(reass_ip4_fragment(2, i, 8, 8, 0) == NULL);
+  }
+  fail_unless(lwip_stats.ip_reass.evict == 2 * MEMP_NUM_REASSDATA + 1);
+
+  /* then sends more fragments of one datagram than its budget allows */
+  for (i = 0; i < IP_REASS_MAX_PBUFS_PER_SOURCE + 2; i++) {
+    fail_unless(reass_ip4_fragment(2, 1000, (u16_t)(8 + 8 * i), 8, 0) == NULL);
+  }
+  fail_unless(lwip_stats.ip_reass.srcbudget == 2);
+
+  /* 10.0.0.3 can still finish its datagram */
+  p = reass_ip4_fragment(3, 100, 8, 8, 1);
+  check_reassembled(p, 16);
+  fail_unless(lwip_stats.ip_reass.ok == 1);
+
+  /* age out what is left of 10.0.0.2 (first fragment missing: no ICMP) */
+  for (i = 0; i <= IP_REASS_MAXAGE; i++) {
+    ip_reass_tmr();
+  }
+  fail_unless(lwip_stats.ip_reass.timeout == 1);
+}
+END_TEST
+
+START_TEST(test_ip4_reass_fuzz)
+{
+  u16_t round;
+  u32_t injected = 0;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&lwip_stats.ip_reass, 0, sizeof(lwip_stats.ip_reass));
+  reass_rand_state = 0x2a;
+
+  for (round = 0; round < 500; round++) {
+    u16_t starts[10], lens[10], order[10];
+    u16_t num = 0, offset = 0, i;
+    u16_t frag_len = (u16_t)(8 * (1 + reass_rand() % 100));
+    u16_t datagram_len = (u16_t)(frag_len + 1 + reass_rand() % (9 * frag_len));
+    struct pbuf *p = NULL;
+
+    while (offset < datagram_len) {
+      starts[num] = offset;
+      lens[num] = LWIP_MIN(frag_len, (u16_t)(datagram_len - offset));
+      offset = (u16_t)(offset + lens[num]);
+      order[num] = num;
+      num++;
+    }
+    for (i = (u16_t)(num - 1); i > 0; i--) {
+      u16_t j = (u16_t)(reass_rand() % (i + 1));
+      u16_t tmp = order[i];
+      order[i] = order[j];
+      order[j] = tmp;
+    }
+    for (i = 0; i < num; i++) {
+      u16_t f = order[i];
+      fail_unless(p == NULL);
+      p = reass_ip4_fragment(2, round, starts[f], lens[f], f == num - 1);
+      if ((i + 1 < num) && ((reass_rand() & 3) == 0)) {
+        /* resend a range overlapping a fragment received so far */
+        u16_t g = order[reass_rand() % (i + 1)];
+        u16_t start = (u16_t)(starts[g] + 8 * (reass_rand() % ((lens[g] + 7) / 8)));
+        u16_t len = (u16_t)(8 * (1 + reass_rand() % 4));
+        fail_unless(reass_ip4_fragment(2, round, start, len, 0) == NULL);
+        injected++;
+      }
+    }
+    check_reassembled(p, datagram_len);
+  }
+  fail_unless(injected > 0);
+  fail_unless(lwip_stats.ip_reass.ok == 500);
+  fail_unless(lwip_stats.ip_reass.dup + lwip_stats.ip_reass.overlap == injected);
+  fail_unless(lwip_stats.ip_reass.evict == 0);
+  fail_unless(lwip_stats.ip_reass.timeout == 0);
+}
+END_TEST
+
 
 /** Create the suite including all tests for this module */
 Suite *
@@ -155,6 +350,9 @@ ip4_suite(void)
 {
   testfunc tests[] = {
     TESTFUNC(test_ip4_reass),
+    TESTFUNC(test_ip4_reass_dup_overlap),
+    TESTFUNC(test_ip4_reass_source_budget),
+    TESTFUNC(test_ip4_reass_fuzz),
   };
   return create_suite("IPv4", tests, sizeof(tests)/sizeof(testfunc), ip4_setup, ip4_teardown);
 }
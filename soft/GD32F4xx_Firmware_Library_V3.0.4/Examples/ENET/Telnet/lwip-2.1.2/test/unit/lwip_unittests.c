@@ -14,6 +14,10 @@
 #include "dhcp/test_dhcp.h"
 #include "mdns/test_mdns.h"
 #include "mqtt/test_mqtt.h"
+#include "tftp/test_tftp.h"
+#include "lwiperf/test_lwiperf.h"
+#include "bridgeif/test_bridgeif.h"
+#include "dns/test_dns.h"
 #include "api/test_sockets.h"
 
 #include "lwip/init.h"
@@ -76,6 +80,10 @@ int main(void)
     dhcp_suite,
     mdns_suite,
     mqtt_suite,
+    tftp_suite,
+    lwiperf_suite,
+    bridgeif_suite,
+    dns_suite,
     sockets_suite
   };
   size_t num = sizeof(suites)/sizeof(void*);
@@ -0,0 +1,382 @@
+#include "test_lwiperf.h"
+
+#include "lwip/apps/lwiperf.h"
+#include "lwip/udp.h"
+#include "lwip/tcp.h"
+#include "lwip/priv/tcp_priv.h"
+#include "lwip/stats.h"
+#include "lwip/timeouts.h"
+#include "lwip/tcpip.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+
+#if !LWIP_UDP || !LWIP_TCP || !LWIP_IPV4
+#error "This tests needs UDP, TCP and IPv4 enabled"
+#endif
+
+#define TEST_LWIPERF_REMOTE_PORT  40000
+
+struct test_lwiperf_pkt {
+  u16_t src_port;
+  u16_t dest_port;
+  u16_t len;
+  u8_t data[64];
+};
+
+static struct netif test_netif;
+static ip4_addr_t test_gw, test_ipaddr, test_netmask, test_remote_addr;
+static ip_addr_t test_remote_ip;
+
+/* UDP datagrams sent by lwiperf (first 64 byte) */
+static struct test_lwiperf_pkt txq[32];
+static int txq_count;
+
+static struct lwiperf_report reports[8];
+static int report_count;
+
+/* Helper functions */
+static void
+test_lwiperf_report(void *arg, const struct lwiperf_report *report)
+{
+  LWIP_UNUSED_ARG(arg);
+  EXPECT_RET(report_count < (int)LWIP_ARRAYSIZE(reports));
+  reports[report_count++] = *report;
+}
+
+static err_t
+test_lwiperf_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  struct ip_hdr iphdr;
+  struct udp_hdr udphdr;
+  struct test_lwiperf_pkt *pkt;
+
+  fail_unless(netif == &test_netif);
+  fail_unless(ip4_addr_cmp(ipaddr, &test_remote_addr));
+  pbuf_copy_partial(p, &iphdr, IP_HLEN, 0);
+  if (IPH_PROTO(&iphdr) != IP_PROTO_UDP) {
+    /* TCP SYNs of the abort test */
+    return ERR_OK;
+  }
+  EXPECT_RETX(txq_count < (int)LWIP_ARRAYSIZE(txq), ERR_OK);
+  pbuf_copy_partial(p, &udphdr, UDP_HLEN, IP_HLEN);
+
+  pkt = &txq[txq_count++];
+  pkt->src_port = lwip_ntohs(udphdr.src);
+  pkt->dest_port = lwip_ntohs(udphdr.dest);
+  pkt->len = (u16_t)(p->tot_len - IP_HLEN - UDP_HLEN);
+  pbuf_copy_partial(p, pkt->data, LWIP_MIN(pkt->len, sizeof(pkt->data)), IP_HLEN + UDP_HLEN);
+  return ERR_OK;
+}
+
+static err_t
+test_lwiperf_netif_init(struct netif *netif)
+{
+  netif->output = test_lwiperf_netif_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/* inject a UDP datagram from the remote host */
+static void
+test_lwiperf_remote_send(u16_t src_port, u16_t dest_port, const void *data, u16_t len)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  struct udp_hdr *udphdr;
+  err_t err;
+
+  p = pbuf_alloc(PBUF_RAW, (u16_t)(IP_HLEN + UDP_HLEN + len), PBUF_RAM);
+  EXPECT_RET(p != NULL);
+
+  iphdr = (struct ip_hdr *)p->payload;
+  memset(iphdr, 0, IP_HLEN);
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_LEN_SET(iphdr, lwip_htons(p->tot_len));
+  IPH_TTL_SET(iphdr, 32);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip4_addr_copy(iphdr->src, test_remote_addr);
+  ip4_addr_copy(iphdr->dest, test_ipaddr);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  udphdr = (struct udp_hdr *)((u8_t *)p->payload + IP_HLEN);
+  udphdr->src = lwip_htons(src_port);
+  udphdr->dest = lwip_htons(dest_port);
+  udphdr->len = lwip_htons((u16_t)(UDP_HLEN + len));
+  udphdr->chksum = 0;
+  memcpy((u8_t *)p->payload + IP_HLEN + UDP_HLEN, data, len);
+
+  err = ip4_input(p, &test_netif);
+  fail_unless(err == ERR_OK);
+}
+
+static void
+test_lwiperf_put32(u8_t *buf, u32_t val)
+{
+  val = lwip_htonl(val);
+  memcpy(buf, &val, sizeof(val));
+}
+
+static u32_t
+test_lwiperf_get32(const u8_t *buf)
+{
+  u32_t val;
+  memcpy(&val, buf, sizeof(val));
+  return lwip_ntohl(val);
+}
+
+/* send an iperf2 UDP test datagram that spent 'transit_us' on the way */
+static void
+test_lwiperf_remote_datagram(s32_t id, u32_t transit_us)
+{
+  u8_t buf[100];
+  u32_t sent_us = lwip_sys_now * 1000 - transit_us;
+
+  memset(buf, 0, sizeof(buf));
+  test_lwiperf_put32(&buf[0], (u32_t)id);
+  test_lwiperf_put32(&buf[4], sent_us / 1000000);
+  test_lwiperf_put32(&buf[8], sent_us % 1000000);
+  test_lwiperf_remote_send(TEST_LWIPERF_REMOTE_PORT, LWIPERF_UDP_PORT_DEFAULT, buf, sizeof(buf));
+}
+
+static void
+test_lwiperf_sleep(u32_t ms)
+{
+  while (ms--) {
+    lwip_sys_now++;
+    sys_check_timeouts();
+  }
+}
+
+/* Setups/teardown functions */
+
+static void
+lwiperf_setup(void)
+{
+  IP4_ADDR(&test_ipaddr, 192,168,0,1);
+  IP4_ADDR(&test_netmask, 255,255,255,0);
+  IP4_ADDR(&test_gw, 192,168,0,254);
+  IP4_ADDR(&test_remote_addr, 192,168,0,2);
+  ip_addr_copy_from_ip4(test_remote_ip, test_remote_addr);
+  netif_add(&test_netif, &test_ipaddr, &test_netmask, &test_gw, NULL, test_lwiperf_netif_init, NULL);
+  netif_set_up(&test_netif);
+  netif_set_default(&test_netif);
+
+  txq_count = 0;
+  report_count = 0;
+  memset(reports, 0, sizeof(reports));
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+lwiperf_teardown(void)
+{
+  /* the stack timers run by test_lwiperf_sleep() queue packets (e.g. IGMP
+     reports) on the loopback netif: drain it */
+  while (tcpip_thread_poll_one());
+  netif_set_default(NULL);
+  netif_remove(&test_netif);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/* the UDP server counts lost and reordered datagrams and the jitter, reports
+   intervals while the test runs and answers the final datagram */
+START_TEST(test_lwiperf_udp_server)
+{
+  static const s32_t ids[] = { 0, 1, 3, 2, 5 };
+  static const u32_t transits[] = { 1000, 1000, 3000, 1000, 1000 };
+  struct test_lwiperf_pkt *pkt;
+  void *server;
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  server = lwiperf_start_server(IP_ADDR_ANY, LWIPERF_UDP_PORT_DEFAULT, 1, 50, test_lwiperf_report, NULL);
+  fail_unless(server != NULL);
+
+  for (i = 0; i < LWIP_ARRAYSIZE(ids); i++) {
+    test_lwiperf_remote_datagram(ids[i], transits[i]);
+    test_lwiperf_sleep(10);
+  }
+  test_lwiperf_sleep(5);
+  fail_unless(report_count == 1);
+  fail_unless(reports[0].report_type == LWIPERF_INTERVAL);
+  fail_unless(reports[0].udp == 1);
+  fail_unless(reports[0].ms_start == 0);
+  fail_unless(reports[0].ms_duration == 50);
+  fail_unless(reports[0].bytes_transferred == 500);
+  fail_unless(reports[0].cpu_load == LWIPERF_CPU_LOAD_UNKNOWN);
+  fail_unless(txq_count == 0);
+
+  /* final datagram */
+  test_lwiperf_remote_datagram(-6, 1000);
+  fail_unless(report_count == 2);
+  fail_unless(reports[1].report_type == LWIPERF_UDP_DONE_SERVER);
+  fail_unless(reports[1].ms_duration == 55);
+  fail_unless(reports[1].bytes_transferred == 600);
+  fail_unless(reports[1].datagrams == 6);
+  fail_unless(reports[1].datagrams_lost == 1);
+  fail_unless(reports[1].datagrams_out_of_order == 1);
+  /* RFC 3550: transit differences 0, 2000, 2000, 0, 0 us */
+  fail_unless(reports[1].jitter_us == 212);
+  fail_unless(reports[1].mem_max > 0);
+
+  /* the server report is sent back to the client */
+  fail_unless(txq_count == 1);
+  pkt = &txq[0];
+  fail_unless(pkt->dest_port == TEST_LWIPERF_REMOTE_PORT);
+  fail_unless(pkt->len == 12 + 40);
+  fail_unless((s32_t)test_lwiperf_get32(&pkt->data[0]) == -6);
+  fail_unless(test_lwiperf_get32(&pkt->data[12 + 8]) == 600);  /* total_len2 */
+  fail_unless(test_lwiperf_get32(&pkt->data[12 + 20]) == 1);   /* error_cnt */
+  fail_unless(test_lwiperf_get32(&pkt->data[12 + 24]) == 1);   /* outorder_cnt */
+  fail_unless(test_lwiperf_get32(&pkt->data[12 + 28]) == 7);   /* datagrams */
+  fail_unless(test_lwiperf_get32(&pkt->data[12 + 36]) == 212); /* jitter2 */
+
+  /* a repeated final datagram is answered again, without a new report */
+  test_lwiperf_remote_datagram(-6, 1000);
+  fail_unless(txq_count == 2);
+  fail_unless(report_count == 2);
+
+  /* the finished session goes away after a while, the listener stays */
+  test_lwiperf_sleep(2000);
+  fail_unless(report_count == 2);
+  lwiperf_abort(server);
+}
+END_TEST
+
+/* the UDP client keeps its rate, repeats the final datagram and reports
+   the statistics from the server report */
+START_TEST(test_lwiperf_udp_client)
+{
+  struct lwiperf_client_settings settings;
+  u8_t report[12 + 40];
+  void *client;
+  int i, data_count;
+  u16_t local_port;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&settings, 0, sizeof(settings));
+  settings.type = LWIPERF_CLIENT;
+  settings.udp = 1;
+  settings.duration_ms = 100;
+  settings.udp_bandwidth_kbitpsec = 1000;
+  client = lwiperf_start_client(&test_remote_ip, LWIPERF_UDP_PORT_DEFAULT, &settings, test_lwiperf_report, NULL);
+  fail_unless(client != NULL);
+
+  /* 1 MBit/s for 100 ms: 8 datagrams of 1470 byte, then the final one */
+  test_lwiperf_sleep(150);
+  fail_unless(txq_count == 9);
+  local_port = txq[0].src_port;
+  data_count = 0;
+  for (i = 0; i < txq_count; i++) {
+    fail_unless(txq[i].dest_port == LWIPERF_UDP_PORT_DEFAULT);
+    fail_unless(txq[i].src_port == local_port);
+    fail_unless(txq[i].len == 1470);
+    if ((s32_t)test_lwiperf_get32(&txq[i].data[0]) >= 0) {
+      fail_unless(test_lwiperf_get32(&txq[i].data[0]) == (u32_t)i);
+      data_count++;
+    }
+  }
+  fail_unless(data_count == 8);
+  fail_unless((s32_t)test_lwiperf_get32(&txq[8].data[0]) == -8);
+  /* settings: rate in bits per second, time in 10 ms */
+  fail_unless(test_lwiperf_get32(&txq[0].data[12 + 16]) == 1000000);
+  fail_unless((s32_t)test_lwiperf_get32(&txq[0].data[12 + 20]) == -10);
+
+  /* the final datagram is repeated until the server report arrives */
+  test_lwiperf_sleep(250);
+  fail_unless(txq_count == 10);
+  fail_unless(report_count == 0);
+
+  memset(report, 0, sizeof(report));
+  memcpy(report, txq[9].data, 12);
+  test_lwiperf_put32(&report[12 + 20], 2);
+  test_lwiperf_put32(&report[12 + 24], 1);
+  test_lwiperf_put32(&report[12 + 28], 8);
+  test_lwiperf_put32(&report[12 + 36], 1500);
+  test_lwiperf_remote_send(LWIPERF_UDP_PORT_DEFAULT, local_port, report, sizeof(report));
+
+  fail_unless(report_count == 1);
+  fail_unless(reports[0].report_type == LWIPERF_UDP_DONE_CLIENT);
+  fail_unless(reports[0].udp == 1);
+  fail_unless(reports[0].ms_duration == 100);
+  fail_unless(reports[0].bytes_transferred == 8 * 1470);
+  fail_unless(reports[0].datagrams == 8);
+  fail_unless(reports[0].datagrams_lost == 2);
+  fail_unless(reports[0].datagrams_out_of_order == 1);
+  fail_unless(reports[0].jitter_us == 1500);
+  /* the client is gone */
+  test_lwiperf_sleep(1000);
+  fail_unless(txq_count == 10);
+}
+END_TEST
+
+/* a UDP client that had nothing to send still ends with a negative id */
+START_TEST(test_lwiperf_udp_client_empty)
+{
+  struct lwiperf_client_settings settings;
+  void *client;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&settings, 0, sizeof(settings));
+  settings.type = LWIPERF_CLIENT;
+  settings.udp = 1;
+  settings.duration_ms = 10;
+  settings.udp_bandwidth_kbitpsec = 1;
+  client = lwiperf_start_client(&test_remote_ip, LWIPERF_UDP_PORT_DEFAULT, &settings, test_lwiperf_report, NULL);
+  fail_unless(client != NULL);
+
+  test_lwiperf_sleep(20);
+  fail_unless(txq_count == 1);
+  fail_unless((s32_t)test_lwiperf_get32(&txq[0].data[0]) == -1);
+  lwiperf_abort(client);
+}
+END_TEST
+
+/* aborting a client frees all its streams and the listener for the
+   test sent back */
+START_TEST(test_lwiperf_abort_parallel)
+{
+  struct lwiperf_client_settings settings;
+  void *client;
+  LWIP_UNUSED_ARG(_i);
+
+  memset(&settings, 0, sizeof(settings));
+  settings.type = LWIPERF_DUAL;
+  settings.num_streams = 3;
+  settings.interval_ms = 100;
+  client = lwiperf_start_client(&test_remote_ip, LWIPERF_TCP_PORT_DEFAULT,
+                                &settings, test_lwiperf_report, NULL);
+  fail_unless(client != NULL);
+  lwiperf_abort(client);
+
+  settings.udp = 1;
+  client = lwiperf_start_client(&test_remote_ip, LWIPERF_UDP_PORT_DEFAULT,
+                                &settings, test_lwiperf_report, NULL);
+  fail_unless(client != NULL);
+  test_lwiperf_sleep(10);
+  lwiperf_abort(client);
+  test_lwiperf_sleep(1000);
+
+  fail_unless(report_count == 0);
+  fail_unless(tcp_active_pcbs == NULL);
+  fail_unless(tcp_listen_pcbs.listen_pcbs == NULL);
+  fail_unless(udp_pcbs == NULL);
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+lwiperf_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_lwiperf_udp_server),
+    TESTFUNC(test_lwiperf_udp_client),
+    TESTFUNC(test_lwiperf_udp_client_empty),
+    TESTFUNC(test_lwiperf_abort_parallel)
+  };
+  return create_suite("LWIPERF", tests, sizeof(tests)/sizeof(testfunc), lwiperf_setup, lwiperf_teardown);
+}
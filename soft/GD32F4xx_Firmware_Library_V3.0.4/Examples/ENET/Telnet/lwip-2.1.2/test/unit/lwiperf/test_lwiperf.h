@@ -0,0 +1,8 @@
+#ifndef LWIP_HDR_TEST_LWIPERF_H
+#define LWIP_HDR_TEST_LWIPERF_H
+
+#include "../lwip_check.h"
+
+Suite* lwiperf_suite(void);
+
+#endif
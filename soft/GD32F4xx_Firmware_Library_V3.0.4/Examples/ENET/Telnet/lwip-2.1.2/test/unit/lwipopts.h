@@ -73,9 +73,22 @@
 
 #define MEMP_NUM_SYS_TIMEOUT            (LWIP_NUM_SYS_TIMEOUT_INTERNAL + 8)
 
+/* lwiperf tests run the cyclic timers: the IPv6 reassembly timer asserts
+   on 64-bit hosts unless the fragment header is copied */
+#define IPV6_FRAG_COPYHEADER            1
+
 /* MIB2 stats are required to check IPv4 reassembly results */
 #define MIB2_STATS                      1
 
+/* IPv4 reassembly tests check that one source cannot use up all pbufs */
+#define IP_REASS_MAX_PBUFS              16
+#define IP_REASS_MAX_PBUFS_PER_SOURCE   10
+#define IP_REASS_MAX_DATAGRAM_LEN       (IP_REASS_MAX_PBUFS * 1480)
+
+/* DNS tests need a table that holds more names than the default */
+#define LWIP_DNS                        1
+#define DNS_TABLE_SIZE                  32
+
 /* netif tests want to test this, so enable: */
 #define LWIP_NETIF_EXT_STATUS_CALLBACK  1
 
@@ -0,0 +1,570 @@
+#include "test_tftp.h"
+
+#include "lwip/apps/tftp_server.h"
+#include "lwip/udp.h"
+#include "lwip/stats.h"
+#include "lwip/timeouts.h"
+#include "lwip/inet_chksum.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/udp.h"
+
+#if !LWIP_UDP || !LWIP_IPV4
+#error "This tests needs UDP and IPv4 enabled"
+#endif
+
+#define TEST_TFTP_CLIENT_PORT    4321
+/* simulated network: 1 ms round trip time, 100 MBit/s */
+#define TEST_TFTP_RTT_US         1000
+#define TEST_TFTP_BITS_PER_US    100
+
+#define TEST_TFTP_OPCODE(pkt)    (((u16_t)(pkt)->data[0] << 8) | (pkt)->data[1])
+#define TEST_TFTP_BLKNUM(pkt)    (((u16_t)(pkt)->data[2] << 8) | (pkt)->data[3])
+
+struct test_tftp_pkt {
+  u16_t len;
+  u8_t zero_copy;
+  u8_t data[TFTP_MAX_BLKSIZE + 4];
+};
+
+static struct netif test_netif;
+static ip4_addr_t test_gw, test_ipaddr, test_netmask, test_client_addr;
+
+/* packets sent by the server, and a copy being processed by the client */
+static struct test_tftp_pkt txq[TFTP_MAX_WINDOWSIZE + 2];
+static struct test_tftp_pkt rxq[TFTP_MAX_WINDOWSIZE + 2];
+static int txq_count;
+/* simulated time since the test started */
+static u32_t sim_base_ms;
+static u32_t sim_us;
+
+/* in-memory file backend */
+static u8_t test_file[64 * 1024];
+static u32_t test_file_size;
+static u32_t test_file_pos;
+static u8_t test_wfile[16 * 1024];
+static u32_t test_wfile_size;
+static int test_file_opened;
+
+/* Helper functions */
+static void *
+test_tftp_open(const char *fname, const char *mode, u8_t write)
+{
+  LWIP_UNUSED_ARG(mode);
+
+  if (strcmp(fname, "test.bin") != 0) {
+    return NULL;
+  }
+  fail_unless(!test_file_opened);
+  test_file_opened = 1;
+  test_file_pos = 0;
+  if (write) {
+    test_wfile_size = 0;
+  }
+  return test_file;
+}
+
+static void
+test_tftp_close(void *handle)
+{
+  fail_unless(handle == test_file);
+  fail_unless(test_file_opened);
+  test_file_opened = 0;
+}
+
+static int
+test_tftp_read(void *handle, void *buf, int bytes)
+{
+  u32_t len = LWIP_MIN((u32_t)bytes, test_file_size - test_file_pos);
+
+  fail_unless(handle == test_file);
+  memcpy(buf, &test_file[test_file_pos], len);
+  test_file_pos += len;
+  return (int)len;
+}
+
+static int
+test_tftp_read_ref(void *handle, const void **buf, int bytes)
+{
+  u32_t len = LWIP_MIN((u32_t)bytes, test_file_size - test_file_pos);
+
+  fail_unless(handle == test_file);
+  *buf = &test_file[test_file_pos];
+  test_file_pos += len;
+  return (int)len;
+}
+
+static int
+test_tftp_write(void *handle, struct pbuf *p)
+{
+  fail_unless(handle == test_file);
+  EXPECT_RETX(test_wfile_size + p->tot_len <= sizeof(test_wfile), -1);
+  pbuf_copy_partial(p, &test_wfile[test_wfile_size], p->tot_len, 0);
+  test_wfile_size += p->tot_len;
+  return p->tot_len;
+}
+
+static const struct tftp_context test_tftp_ctx = {
+  test_tftp_open,
+  test_tftp_close,
+  test_tftp_read,
+  test_tftp_write,
+  NULL
+};
+
+static const struct tftp_context test_tftp_ctx_zero_copy = {
+  test_tftp_open,
+  test_tftp_close,
+  test_tftp_read,
+  test_tftp_write,
+  test_tftp_read_ref
+};
+
+static err_t
+test_tftp_netif_output(struct netif *netif, struct pbuf *p, const ip4_addr_t *ipaddr)
+{
+  const u16_t hlen = IP_HLEN + UDP_HLEN;
+  struct test_tftp_pkt *pkt;
+  struct pbuf *q;
+
+  fail_unless(netif == &test_netif);
+  fail_unless(ip4_addr_cmp(ipaddr, &test_client_addr));
+  EXPECT_RETX(txq_count < (int)LWIP_ARRAYSIZE(txq), ERR_OK);
+  EXPECT_RETX(p->tot_len - hlen <= (int)sizeof(pkt->data), ERR_OK);
+
+  pkt = &txq[txq_count++];
+  pkt->len = (u16_t)(p->tot_len - hlen);
+  pbuf_copy_partial(p, pkt->data, pkt->len, hlen);
+  pkt->zero_copy = 0;
+  for (q = p; q != NULL; q = q->next) {
+    if (((u8_t *)q->payload >= test_file) && ((u8_t *)q->payload < &test_file[sizeof(test_file)])) {
+      pkt->zero_copy = 1;
+    }
+  }
+
+  sim_us += (p->tot_len * 8) / TEST_TFTP_BITS_PER_US;
+  return ERR_OK;
+}
+
+static err_t
+test_tftp_netif_init(struct netif *netif)
+{
+  netif->output = test_tftp_netif_output;
+  netif->mtu = 1500;
+  netif->flags = NETIF_FLAG_LINK_UP;
+  return ERR_OK;
+}
+
+/* inject a UDP packet from the client to the server */
+static void
+test_tftp_client_send(const void *data, u16_t len)
+{
+  struct pbuf *p;
+  struct ip_hdr *iphdr;
+  struct udp_hdr *udphdr;
+  err_t err;
+
+  p = pbuf_alloc(PBUF_RAW, (u16_t)(IP_HLEN + UDP_HLEN + len), PBUF_RAM);
+  EXPECT_RET(p != NULL);
+
+  iphdr = (struct ip_hdr *)p->payload;
+  memset(iphdr, 0, IP_HLEN);
+  IPH_VHL_SET(iphdr, 4, IP_HLEN / 4);
+  IPH_LEN_SET(iphdr, lwip_htons(p->tot_len));
+  IPH_TTL_SET(iphdr, 32);
+  IPH_PROTO_SET(iphdr, IP_PROTO_UDP);
+  ip4_addr_copy(iphdr->src, test_client_addr);
+  ip4_addr_copy(iphdr->dest, test_ipaddr);
+  IPH_CHKSUM_SET(iphdr, inet_chksum(iphdr, IP_HLEN));
+
+  udphdr = (struct udp_hdr *)((u8_t *)p->payload + IP_HLEN);
+  udphdr->src = lwip_htons(TEST_TFTP_CLIENT_PORT);
+  udphdr->dest = lwip_htons(TFTP_PORT);
+  udphdr->len = lwip_htons((u16_t)(UDP_HLEN + len));
+  udphdr->chksum = 0;
+  memcpy((u8_t *)p->payload + IP_HLEN + UDP_HLEN, data, len);
+
+  err = ip4_input(p, &test_netif);
+  fail_unless(err == ERR_OK);
+}
+
+static u16_t
+test_tftp_append(u8_t *buf, u16_t offset, const char *str)
+{
+  u16_t len = (u16_t)(strlen(str) + 1);
+  memcpy(&buf[offset], str, len);
+  return (u16_t)(offset + len);
+}
+
+/* send RRQ/WRQ for "test.bin", options are only added if != 0 */
+static void
+test_tftp_client_request(u16_t opcode, u16_t blksize, u16_t windowsize)
+{
+  u8_t buf[64];
+  char val[6];
+  u16_t len;
+
+  buf[0] = 0;
+  buf[1] = (u8_t)opcode;
+  len = test_tftp_append(buf, 2, "test.bin");
+  len = test_tftp_append(buf, len, "octet");
+  if (blksize != 0) {
+    len = test_tftp_append(buf, len, "blksize");
+    lwip_itoa(val, sizeof(val), blksize);
+    len = test_tftp_append(buf, len, val);
+  }
+  if (windowsize != 0) {
+    len = test_tftp_append(buf, len, "windowsize");
+    lwip_itoa(val, sizeof(val), windowsize);
+    len = test_tftp_append(buf, len, val);
+  }
+  test_tftp_client_send(buf, len);
+}
+
+static void
+test_tftp_client_ack(u16_t blknum)
+{
+  u8_t buf[4];
+
+  buf[0] = 0;
+  buf[1] = 4;
+  buf[2] = (u8_t)(blknum >> 8);
+  buf[3] = (u8_t)blknum;
+  test_tftp_client_send(buf, sizeof(buf));
+}
+
+static void
+test_tftp_client_data(u16_t blknum, const u8_t *data, u16_t len)
+{
+  u8_t buf[TFTP_MAX_BLKSIZE + 4];
+
+  buf[0] = 0;
+  buf[1] = 3;
+  buf[2] = (u8_t)(blknum >> 8);
+  buf[3] = (u8_t)blknum;
+  memcpy(&buf[4], data, len);
+  test_tftp_client_send(buf, (u16_t)(len + 4));
+}
+
+static void
+test_tftp_sleep(u32_t us)
+{
+  sim_us += us;
+  lwip_sys_now = sim_base_ms + (sim_us / 1000);
+}
+
+/* take over what the server has sent so far; the client answers
+   after one round trip */
+static int
+test_tftp_client_receive(void)
+{
+  int count = txq_count;
+
+  memcpy(rxq, txq, sizeof(struct test_tftp_pkt) * (size_t)count);
+  txq_count = 0;
+  test_tftp_sleep(TEST_TFTP_RTT_US);
+  return count;
+}
+
+/* Read "test.bin" into 'buf' like a RFC 7440 client: all DATA packets the
+   server sent in one go are a window, the last in-order block is acked.
+   Returns the number of bytes read, the number of round trips is stored
+   in 'rounds'. DATA block 'drop_blknum' is dropped once (0: none). */
+static u32_t
+test_tftp_client_read(u16_t blksize, u16_t windowsize, u16_t drop_blknum, u8_t *buf, u32_t *rounds)
+{
+  u16_t expected = 1;
+  u32_t received = 0;
+  int done = 0;
+
+  *rounds = 0;
+  test_tftp_client_request(1, blksize, windowsize);
+
+  while (!done) {
+    int i, count = test_tftp_client_receive();
+    EXPECT_RETX(count > 0, received);
+    (*rounds)++;
+
+    for (i = 0; i < count; i++) {
+      struct test_tftp_pkt *pkt = &rxq[i];
+      if (TEST_TFTP_OPCODE(pkt) == 6) {
+        /* OACK */
+        fail_unless(expected == 1);
+      } else if (TEST_TFTP_OPCODE(pkt) == 3) {
+        u16_t len = (u16_t)(pkt->len - 4);
+        fail_unless(count <= (windowsize ? windowsize : 1));
+        if (TEST_TFTP_BLKNUM(pkt) == drop_blknum) {
+          drop_blknum = 0;
+          continue;
+        }
+        if ((TEST_TFTP_BLKNUM(pkt) == expected) && !done) {
+          memcpy(&buf[received], &pkt->data[4], len);
+          received += len;
+          expected++;
+          done = len < (blksize ? blksize : 512);
+        }
+      } else {
+        fail();
+      }
+    }
+    test_tftp_client_ack((u16_t)(expected - 1));
+  }
+
+  fail_unless(!test_file_opened);
+  fail_unless(txq_count == 0);
+  return received;
+}
+
+static void
+test_tftp_fill_file(u32_t size)
+{
+  u32_t i;
+
+  for (i = 0; i < size; i++) {
+    test_file[i] = (u8_t)(i * 7 + (i >> 8));
+  }
+  test_file_size = size;
+}
+
+/* Setups/teardown functions */
+
+static void
+tftp_setup(void)
+{
+  IP4_ADDR(&test_ipaddr, 192,168,0,1);
+  IP4_ADDR(&test_netmask, 255,255,255,0);
+  IP4_ADDR(&test_gw, 192,168,0,254);
+  IP4_ADDR(&test_client_addr, 192,168,0,2);
+  netif_add(&test_netif, &test_ipaddr, &test_netmask, &test_gw, NULL, test_tftp_netif_init, NULL);
+  netif_set_up(&test_netif);
+
+  txq_count = 0;
+  sim_base_ms = lwip_sys_now;
+  sim_us = 0;
+  test_file_opened = 0;
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+static void
+tftp_teardown(void)
+{
+  tftp_cleanup();
+  netif_remove(&test_netif);
+  fail_unless(!test_file_opened);
+  lwip_check_ensure_no_alloc(SKIP_POOL(MEMP_SYS_TIMEOUT));
+}
+
+/* Test functions */
+
+/* a client without options gets RFC 1350 lock-step 512 byte blocks */
+START_TEST(test_tftp_read_lockstep)
+{
+  static u8_t buf[2048];
+  u32_t rounds;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init(&test_tftp_ctx) == ERR_OK);
+  test_tftp_fill_file(1300);
+
+  fail_unless(test_tftp_client_read(0, 0, 0, buf, &rounds) == 1300);
+  fail_unless(memcmp(buf, test_file, 1300) == 0);
+  fail_unless(rounds == 3);
+}
+END_TEST
+
+/* a lost block makes the client ack the last in-order block, the server
+   restarts the window there */
+START_TEST(test_tftp_read_window_loss)
+{
+  static u8_t buf[8192];
+  u32_t rounds;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init(&test_tftp_ctx) == ERR_OK);
+  test_tftp_fill_file(5000);
+
+  fail_unless(test_tftp_client_read(1024, 4, 2, buf, &rounds) == 5000);
+  fail_unless(memcmp(buf, test_file, 5000) == 0);
+  /* OACK, blocks 1..4 (2 lost), blocks 2..5 */
+  fail_unless(rounds == 3);
+}
+END_TEST
+
+/* read_ref() backends are sent without copying the file data */
+START_TEST(test_tftp_read_zero_copy)
+{
+  static u8_t buf[8192];
+  u32_t rounds;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init(&test_tftp_ctx_zero_copy) == ERR_OK);
+  test_tftp_fill_file(4096);
+
+  test_tftp_client_request(1, 1024, 4);
+  fail_unless(test_tftp_client_receive() == 1);
+  test_tftp_client_ack(0);
+  fail_unless(txq_count == 4);
+  fail_unless(txq[0].zero_copy && txq[1].zero_copy && txq[2].zero_copy && txq[3].zero_copy);
+  fail_unless(memcmp(&txq[3].data[4], &test_file[3072], 1024) == 0);
+  txq_count = 0;
+  tftp_cleanup();
+
+  fail_unless(tftp_init(&test_tftp_ctx_zero_copy) == ERR_OK);
+  fail_unless(test_tftp_client_read(1024, 4, 0, buf, &rounds) == 4096);
+  fail_unless(memcmp(buf, test_file, 4096) == 0);
+}
+END_TEST
+
+/* the receiving server acks once per window */
+START_TEST(test_tftp_write_window)
+{
+  const u16_t blksize = 1024;
+  u16_t blknum;
+  int count;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init(&test_tftp_ctx) == ERR_OK);
+  test_tftp_fill_file(9 * blksize + 100);
+
+  test_tftp_client_request(2, blksize, 4);
+  count = test_tftp_client_receive();
+  fail_unless(count == 1);
+  fail_unless(TEST_TFTP_OPCODE(&rxq[0]) == 6);
+  fail_unless(rxq[0].len == 2 + 8 + 5 + 11 + 2);
+  fail_unless(memcmp(&rxq[0].data[2], "blksize\0" "1024\0" "windowsize\0" "4", 26) == 0);
+
+  for (blknum = 1; blknum <= 10; blknum++) {
+    u16_t len = (blknum == 10) ? 100 : blksize;
+    test_tftp_client_data(blknum, &test_file[(blknum - 1) * blksize], len);
+    if ((blknum % 4) && (blknum != 10)) {
+      fail_unless(txq_count == 0);
+    } else {
+      count = test_tftp_client_receive();
+      fail_unless(count == 1);
+      fail_unless(TEST_TFTP_OPCODE(&rxq[0]) == 4);
+      fail_unless(TEST_TFTP_BLKNUM(&rxq[0]) == blknum);
+    }
+  }
+
+  fail_unless(!test_file_opened);
+  fail_unless(test_wfile_size == test_file_size);
+  fail_unless(memcmp(test_wfile, test_file, test_file_size) == 0);
+}
+END_TEST
+
+/* a lost block is acked once, the client resends from there */
+START_TEST(test_tftp_write_window_loss)
+{
+  const u16_t blksize = 512;
+  u16_t blknum;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init(&test_tftp_ctx) == ERR_OK);
+  test_tftp_fill_file(6 * blksize + 1);
+
+  test_tftp_client_request(2, 0, 4);
+  fail_unless(test_tftp_client_receive() == 1);
+
+  test_tftp_client_data(1, &test_file[0], blksize);
+  test_tftp_client_data(2, &test_file[blksize], blksize);
+  test_tftp_client_data(4, &test_file[3 * blksize], blksize);
+  fail_unless(test_tftp_client_receive() == 1);
+  fail_unless(TEST_TFTP_OPCODE(&rxq[0]) == 4);
+  fail_unless(TEST_TFTP_BLKNUM(&rxq[0]) == 2);
+  /* the rest of the window is ignored */
+  test_tftp_client_data(5, &test_file[4 * blksize], blksize);
+  fail_unless(txq_count == 0);
+
+  for (blknum = 3; blknum <= 7; blknum++) {
+    u16_t len = (blknum == 7) ? 1 : blksize;
+    test_tftp_client_data(blknum, &test_file[(blknum - 1) * blksize], len);
+  }
+  fail_unless(test_tftp_client_receive() == 2);
+  fail_unless(TEST_TFTP_BLKNUM(&rxq[0]) == 6);
+  fail_unless(TEST_TFTP_BLKNUM(&rxq[1]) == 7);
+
+  fail_unless(!test_file_opened);
+  fail_unless(test_wfile_size == test_file_size);
+  fail_unless(memcmp(test_wfile, test_file, test_file_size) == 0);
+}
+END_TEST
+
+/* after a few round trips, the retransmission timeout follows the RTT
+   instead of TFTP_TIMEOUT_MSECS */
+START_TEST(test_tftp_rto_adapts)
+{
+  int count;
+  LWIP_UNUSED_ARG(_i);
+
+  fail_unless(tftp_init(&test_tftp_ctx) == ERR_OK);
+  test_tftp_fill_file(16 * 512);
+
+  test_tftp_client_request(1, 0, 4);
+  fail_unless(test_tftp_client_receive() == 1);
+  test_tftp_client_ack(0);
+  fail_unless(test_tftp_client_receive() == 4);
+  test_tftp_client_ack(4);
+  fail_unless(test_tftp_client_receive() == 4);
+  test_tftp_client_ack(8);
+  fail_unless(txq_count == 4);
+  txq_count = 0;
+
+  /* the window of blocks 9..12 is lost */
+  test_tftp_sleep(TFTP_MIN_TIMEOUT_MSECS * 1000 / 2);
+  sys_check_timeouts();
+  fail_unless(txq_count == 0);
+  test_tftp_sleep(TFTP_MIN_TIMEOUT_MSECS * 1000);
+  sys_check_timeouts();
+  count = test_tftp_client_receive();
+  fail_unless(count == 4);
+  fail_unless(TEST_TFTP_BLKNUM(&rxq[0]) == 9);
+  fail_unless(TEST_TFTP_BLKNUM(&rxq[3]) == 12);
+}
+END_TEST
+
+/* report simulated throughput over window size */
+START_TEST(test_tftp_read_throughput)
+{
+  static u8_t buf[sizeof(test_file)];
+  const u16_t windowsizes[] = {1, 2, 4, 8};
+  u32_t rounds_prev = 0xFFFFFFFF;
+  size_t i;
+  LWIP_UNUSED_ARG(_i);
+
+  test_tftp_fill_file(sizeof(test_file));
+
+  for (i = 0; i < LWIP_ARRAYSIZE(windowsizes); i++) {
+    u32_t rounds, start_us, elapsed_us;
+
+    fail_unless(tftp_init(&test_tftp_ctx) == ERR_OK);
+    start_us = sim_us;
+    fail_unless(test_tftp_client_read(TFTP_MAX_BLKSIZE, windowsizes[i], 0, buf, &rounds) == test_file_size);
+    elapsed_us = sim_us - start_us;
+    fail_unless(memcmp(buf, test_file, test_file_size) == 0);
+    fail_unless(rounds < rounds_prev);
+    rounds_prev = rounds;
+    tftp_cleanup();
+
+    LWIP_PLATFORM_DIAG(("tftp: blksize %d windowsize %d: %"U32_F" round trips, %"U32_F" KiB/s\n",
+                        TFTP_MAX_BLKSIZE, windowsizes[i], rounds,
+                        ((test_file_size * 1000) / elapsed_us) * 1000 / 1024));
+  }
+
+  fail_unless(tftp_init(&test_tftp_ctx) == ERR_OK);
+}
+END_TEST
+
+/** Create the suite including all tests for this module */
+Suite *
+tftp_suite(void)
+{
+  testfunc tests[] = {
+    TESTFUNC(test_tftp_read_lockstep),
+    TESTFUNC(test_tftp_read_window_loss),
+    TESTFUNC(test_tftp_read_zero_copy),
+    TESTFUNC(test_tftp_write_window),
+    TESTFUNC(test_tftp_write_window_loss),
+    TESTFUNC(test_tftp_rto_adapts),
+    TESTFUNC(test_tftp_read_throughput)
+  };
+  return create_suite("TFTP", tests, sizeof(tests)/sizeof(testfunc), tftp_setup, tftp_teardown);
+}
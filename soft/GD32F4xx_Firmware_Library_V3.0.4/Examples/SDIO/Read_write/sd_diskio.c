@@ -0,0 +1,430 @@
+/*!
+    \file    sd_diskio.c
+    \brief   FatFs disk driver of the SD card, DMA block transfers with a request queue
+
+    \version 2022-03-09, V3.0.0, firmware for GD32F4xx
+*/
+
+
+/*
+    Copyright (c) 2022, GigaDevice Semiconductor Inc.
+
+    Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+    3. Neither the name of the copyright holder nor the names of its contributors
+       may be used to endorse or promote products derived from this software without
+       specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#include "sd_diskio.h"
+#include <string.h>
+
+#define SD_SECTOR_SIZE                      ((uint32_t)0x00000200)    /* sector size of the disk */
+#define SD_REQUEST_MAX_BLOCKS               ((uint32_t)0x0000FFFF)    /* blocks of one DMA transfer at most */
+#define SD_CARD_LOCKED                      ((uint32_t)0x02000000)    /* card is locked, bit of the card status */
+
+static volatile DSTATUS sd_state = STA_NOINIT;                        /* disk status */
+static uint32_t sd_erase_blocks = 1;                                  /* erase block size in unit of sector */
+static sd_request_struct *req_head = NULL, *req_tail = NULL;          /* queue of the requests */
+static uint32_t req_blocks = 0;                                       /* blocks of the transfer in progress, 0 for none */
+static uint8_t req_bounce = 0;                                        /* the transfer in progress uses bounce_buf */
+static uint32_t bounce_buf[SD_SECTOR_SIZE / 4U];                      /* word aligned copy of an unaligned sector */
+static void (*sd_idle)(void) = NULL;                                  /* called while waiting for a request */
+
+/* initialize the SD card and switch it to the fastest bus mode */
+static DSTATUS sd_diskio_initialize(BYTE lun);
+/* get the disk status */
+static DSTATUS sd_diskio_status(BYTE lun);
+/* read sectors */
+static DRESULT sd_diskio_read(BYTE lun, BYTE *buff, DWORD sector, UINT count);
+#if _USE_WRITE == 1
+/* write sectors */
+static DRESULT sd_diskio_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count);
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+/* I/O control operation */
+static DRESULT sd_diskio_ioctl(BYTE lun, BYTE cmd, void *buff);
+#endif /* _USE_IOCTL == 1 */
+/* queue a request and wait for its end */
+static DRESULT sd_diskio_request(sd_request_struct *preq);
+/* remove the head request from the queue and complete it */
+static void sd_request_end(sd_request_struct *preq, sd_error_enum status);
+
+const Diskio_drvTypeDef sd_driver = {
+    sd_diskio_initialize,
+    sd_diskio_status,
+    sd_diskio_read,
+#if _USE_WRITE == 1
+    sd_diskio_write,
+#endif /* _USE_WRITE == 1 */
+#if _USE_IOCTL == 1
+    sd_diskio_ioctl,
+#endif /* _USE_IOCTL == 1 */
+};
+
+/*!
+    \brief      set the function called while the disk driver waits for a request
+    \param[in]  idle: function to run other work of the application, NULL for none
+    \param[out] none
+    \retval     none
+*/
+void sd_diskio_idle_set(void (*idle)(void))
+{
+    sd_idle = idle;
+}
+
+/*!
+    \brief      queue a block request of the SD card, the request is completed by sd_request_process()
+    \param[in]  preq: pointer to the request, it must stay valid until its state is SD_NO_TRANSFER
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_request_submit(sd_request_struct *preq)
+{
+    if(sd_state & STA_NOINIT) {
+        return SD_OPERATION_IMPROPER;
+    }
+
+    if((NULL == preq) || (NULL == preq->pbuf) || (0U == preq->count) || (preq->dir > SD_REQUEST_WRITE)) {
+        return SD_PARAMETER_INVALID;
+    }
+
+    preq->next = NULL;
+    preq->status = SD_OK;
+    preq->state = SD_TRANSFER_IN_PROGRESS;
+
+    if(NULL == req_tail) {
+        req_head = preq;
+    } else {
+        req_tail->next = preq;
+    }
+    req_tail = preq;
+
+    return SD_OK;
+}
+
+/*!
+    \brief      advance the queued SD card requests, call it from the main loop, the data
+                transfers run by DMA and end in the SDIO interrupt between the calls
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void sd_request_process(void)
+{
+    sd_request_struct *preq = req_head;
+    sd_error_enum status = SD_OK;
+    uint32_t blocks = 0, *pbuf = NULL;
+    uint8_t ready = 0;
+
+    if(NULL == preq) {
+        return;
+    }
+
+    if(0U != req_blocks) {
+        /* a transfer of the head request is in progress */
+        if(SD_TRANSFER_IN_PROGRESS == sd_dma_transfer_state_get(&status)) {
+            return;
+        }
+
+        if(SD_OK != status) {
+            /* bring the card back to transfer state */
+            req_blocks = 0;
+            (void)sd_transfer_stop();
+            sd_request_end(preq, status);
+            return;
+        }
+
+        if((0U != req_bounce) && (SD_REQUEST_READ == preq->dir)) {
+            memcpy(preq->pbuf, bounce_buf, SD_SECTOR_SIZE);
+        }
+
+        preq->pbuf += req_blocks * SD_SECTOR_SIZE;
+        preq->sector += req_blocks;
+        preq->count -= req_blocks;
+        req_blocks = 0;
+
+        if(0U == preq->count) {
+            sd_request_end(preq, SD_OK);
+            return;
+        }
+    }
+
+    /* the card is busy with programming after a write, start when it is ready */
+    status = sd_card_ready_check(&ready);
+    if(SD_OK != status) {
+        sd_request_end(preq, status);
+        return;
+    }
+    if(0U == ready) {
+        return;
+    }
+
+    if(0U != ((uint32_t)preq->pbuf & 0x3U)) {
+        /* the DMA needs a word aligned buffer, move one sector through bounce_buf */
+        req_bounce = 1;
+        blocks = 1;
+        pbuf = bounce_buf;
+        if(SD_REQUEST_WRITE == preq->dir) {
+            memcpy(bounce_buf, preq->pbuf, SD_SECTOR_SIZE);
+        }
+    } else {
+        req_bounce = 0;
+        blocks = (preq->count < SD_REQUEST_MAX_BLOCKS) ? preq->count : SD_REQUEST_MAX_BLOCKS;
+        pbuf = (uint32_t *)preq->pbuf;
+    }
+
+    if(SD_REQUEST_READ == preq->dir) {
+        status = sd_blocks_read_dma_start(pbuf, preq->sector, blocks);
+    } else {
+        status = sd_blocks_write_dma_start(pbuf, preq->sector, blocks);
+    }
+
+    if(SD_OK != status) {
+        sd_request_end(preq, status);
+        return;
+    }
+    req_blocks = blocks;
+}
+
+/*!
+    \brief      initialize the SD card and switch it to the fastest bus mode
+    \param[in]  lun: not used
+    \param[out] none
+    \retval     DSTATUS: operation status
+*/
+static DSTATUS sd_diskio_initialize(BYTE lun)
+{
+    sd_card_info_struct cardinfo;
+    sd_error_enum status = SD_OK;
+    uint32_t cardstate = 0;
+
+    sd_state = STA_NOINIT;
+
+    status = sd_init();
+    if(SD_OK == status) {
+        status = sd_card_information_get(&cardinfo);
+    }
+    if(SD_OK == status) {
+        status = sd_card_select_deselect(cardinfo.card_rca);
+    }
+    if(SD_OK == status) {
+        status = sd_cardstatus_get(&cardstate);
+    }
+    if((SD_OK == status) && (cardstate & SD_CARD_LOCKED)) {
+        status = SD_LOCK_UNLOCK_FAILED;
+    }
+    if(SD_OK == status) {
+        status = sd_bus_mode_config(SDIO_BUSMODE_4BIT);
+    }
+    if(SD_OK == status) {
+        /* a card without high speed mode keeps working at the default speed */
+        (void)sd_high_speed_config();
+
+        /* erase block size = (SECTOR_SIZE + 1) write blocks */
+        sd_erase_blocks = ((uint32_t)cardinfo.card_csd.sector_size + 1U) *
+                          ((uint32_t)1U << cardinfo.card_csd.write_bl_len) / SD_SECTOR_SIZE;
+        if(0U == sd_erase_blocks) {
+            sd_erase_blocks = 1U;
+        }
+
+        req_head = NULL;
+        req_tail = NULL;
+        req_blocks = 0;
+        sd_state &= ~STA_NOINIT;
+    }
+
+    return sd_state;
+}
+
+/*!
+    \brief      get the disk status
+    \param[in]  lun: not used
+    \param[out] none
+    \retval     DSTATUS: operation status
+*/
+static DSTATUS sd_diskio_status(BYTE lun)
+{
+    return sd_state;
+}
+
+/*!
+    \brief      read sectors
+    \param[in]  lun: not used
+    \param[in]  buff: data buffer to store read data
+    \param[in]  sector: sector address (LBA)
+    \param[in]  count: number of sectors to read
+    \param[out] none
+    \retval     DRESULT: operation result
+*/
+static DRESULT sd_diskio_read(BYTE lun, BYTE *buff, DWORD sector, UINT count)
+{
+    sd_request_struct req;
+
+    if(sd_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+
+    memset((void *)&req, 0U, sizeof(sd_request_struct));
+
+    req.pbuf = buff;
+    req.sector = sector;
+    req.count = count;
+    req.dir = SD_REQUEST_READ;
+
+    return sd_diskio_request(&req);
+}
+
+#if _USE_WRITE == 1
+/*!
+    \brief      write sectors
+    \param[in]  lun: not used
+    \param[in]  buff: data to be written
+    \param[in]  sector: sector address (LBA)
+    \param[in]  count: number of sectors to write
+    \param[out] none
+    \retval     DRESULT: operation result
+*/
+static DRESULT sd_diskio_write(BYTE lun, const BYTE *buff, DWORD sector, UINT count)
+{
+    sd_request_struct req;
+
+    if(sd_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+
+    memset((void *)&req, 0U, sizeof(sd_request_struct));
+
+    req.pbuf = (uint8_t *)buff;
+    req.sector = sector;
+    req.count = count;
+    req.dir = SD_REQUEST_WRITE;
+
+    return sd_diskio_request(&req);
+}
+#endif /* _USE_WRITE == 1 */
+
+#if _USE_IOCTL == 1
+/*!
+    \brief      I/O control operation
+    \param[in]  lun: not used
+    \param[in]  cmd: control code
+    \param[in]  buff: buffer to send/receive control data
+    \param[out] none
+    \retval     DRESULT: operation result
+*/
+static DRESULT sd_diskio_ioctl(BYTE lun, BYTE cmd, void *buff)
+{
+    DRESULT res = RES_ERROR;
+    uint8_t ready = 0;
+
+    if(sd_state & STA_NOINIT) {
+        return RES_NOTRDY;
+    }
+
+    switch(cmd) {
+    /* finish the queued requests and wait for the end of programming */
+    case CTRL_SYNC:
+        while(NULL != req_head) {
+            sd_request_process();
+        }
+        while((SD_OK == sd_card_ready_check(&ready)) && (0U == ready)) {
+        }
+        if(0U != ready) {
+            res = RES_OK;
+        }
+        break;
+
+    /* get number of sectors on the disk */
+    case GET_SECTOR_COUNT:
+        *(DWORD *)buff = (DWORD)sd_card_capacity_get() * (1024U / SD_SECTOR_SIZE);
+        res = RES_OK;
+        break;
+
+    /* get R/W sector size */
+    case GET_SECTOR_SIZE:
+        *(WORD *)buff = (WORD)SD_SECTOR_SIZE;
+        res = RES_OK;
+        break;
+
+    /* get erase block size in unit of sector */
+    case GET_BLOCK_SIZE:
+        *(DWORD *)buff = sd_erase_blocks;
+        res = RES_OK;
+        break;
+
+    default:
+        res = RES_PARERR;
+        break;
+    }
+
+    return res;
+}
+#endif /* _USE_IOCTL == 1 */
+
+/*!
+    \brief      queue a request and wait for its end, running the idle function meanwhile
+    \param[in]  preq: pointer to the request
+    \param[out] none
+    \retval     DRESULT: operation result
+*/
+static DRESULT sd_diskio_request(sd_request_struct *preq)
+{
+    if(SD_OK != sd_request_submit(preq)) {
+        return RES_PARERR;
+    }
+
+    while(SD_TRANSFER_IN_PROGRESS == preq->state) {
+        sd_request_process();
+
+        if((SD_TRANSFER_IN_PROGRESS == preq->state) && (NULL != sd_idle)) {
+            sd_idle();
+        }
+    }
+
+    if(SD_OK == preq->status) {
+        return RES_OK;
+    }
+
+    return RES_ERROR;
+}
+
+/*!
+    \brief      remove the head request from the queue and complete it
+    \param[in]  preq: pointer to the head request
+    \param[in]  status: result of the request
+    \param[out] none
+    \retval     none
+*/
+static void sd_request_end(sd_request_struct *preq, sd_error_enum status)
+{
+    req_head = preq->next;
+    if(NULL == req_head) {
+        req_tail = NULL;
+    }
+
+    preq->next = NULL;
+    preq->status = status;
+    preq->state = SD_NO_TRANSFER;
+
+    if(NULL != preq->complete) {
+        preq->complete(preq);
+    }
+}
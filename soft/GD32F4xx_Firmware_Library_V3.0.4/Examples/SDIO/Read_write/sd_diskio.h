@@ -0,0 +1,70 @@
+/*!
+    \file    sd_diskio.h
+    \brief   the header file of the FatFs disk driver of the SD card
+
+    \version 2022-03-09, V3.0.0, firmware for GD32F4xx
+*/
+
+
+/*
+    Copyright (c) 2022, GigaDevice Semiconductor Inc.
+
+    Redistribution and use in source and binary forms, with or without modification,
+are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+    3. Neither the name of the copyright holder nor the names of its contributors
+       may be used to endorse or promote products derived from this software without
+       specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT,
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY
+OF SUCH DAMAGE.
+*/
+
+#ifndef SD_DISKIO_H
+#define SD_DISKIO_H
+
+#include "sdcard.h"
+#include "ff_gen_drv.h"
+
+/* direction of a SD card request */
+#define SD_REQUEST_READ                       ((uint8_t)0x00)        /* read blocks from the card */
+#define SD_REQUEST_WRITE                      ((uint8_t)0x01)        /* write blocks to the card */
+
+/* SD card block request, owned by the caller until it is completed */
+typedef struct sd_request_struct {
+    struct sd_request_struct *next;                                  /* next request in the queue */
+    void (*complete)(struct sd_request_struct *preq);                /* called when the request ends, NULL for none */
+    void *context;                                                   /* user data of the complete function */
+    uint8_t *pbuf;                                                   /* data buffer, word aligned for direct DMA */
+    uint32_t sector;                                                 /* first block (sector) number */
+    uint32_t count;                                                  /* number of blocks */
+    uint8_t dir;                                                     /* SD_REQUEST_READ or SD_REQUEST_WRITE */
+    __IO sd_transfer_state_enum state;                               /* SD_TRANSFER_IN_PROGRESS until the request ends */
+    sd_error_enum status;                                            /* result of the request */
+} sd_request_struct;
+
+/* FatFs disk driver of the SD card, link it by FATFS_LinkDriver(&sd_driver, path) */
+extern const Diskio_drvTypeDef sd_driver;
+
+/* function declarations */
+/* queue a block request of the SD card */
+sd_error_enum sd_request_submit(sd_request_struct *preq);
+/* advance the queued SD card requests */
+void sd_request_process(void);
+/* set the function called while the disk driver waits for a request */
+void sd_diskio_idle_set(void (*idle)(void));
+
+#endif /* SD_DISKIO_H */
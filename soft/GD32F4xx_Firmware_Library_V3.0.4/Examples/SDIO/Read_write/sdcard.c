@@ -91,6 +91,16 @@ OF SUCH DAMAGE.
 #define SD_BUS_WIDTH_4BIT                   ((uint32_t)0x00040000)    /* 4-bit width bus mode */
 #define SD_BUS_WIDTH_1BIT                   ((uint32_t)0x00010000)    /* 1-bit width bus mode */
 
+/* SD specification version and command support, check SCR register */
+#define SD_SCR_SD_SPEC                      ((uint32_t)0x0F000000)    /* SD_SPEC bits of SCR */
+#define SD_SCR_CMD23_SUPPORT                ((uint32_t)0x00000002)    /* CMD23(SET_BLOCK_COUNT) supported */
+
+/* parameters for CMD6(SWITCH_FUNC) */
+#define SD_SWITCH_HIGH_SPEED                ((uint32_t)0x80FFFFF1)    /* switch function group 1 to high speed */
+#define SD_SWITCH_STATUS_BYTES              ((uint32_t)0x00000040)    /* length of the switch function status */
+#define SD_SWITCH_STATUS_WORDS              ((uint32_t)0x00000010)    /* words of the switch function status */
+#define SD_SWITCH_GROUP1_RESULT             ((uint32_t)0x0000000F)    /* function group 1 result in word 4 of the status */
+
 /* masks for SCR register */
 #define SD_MASK_0_7BITS                     ((uint32_t)0x000000FF)    /* mask [7:0] bits */
 #define SD_MASK_8_15BITS                    ((uint32_t)0x0000FF00)    /* mask [15:8] bits */
@@ -104,6 +114,7 @@ OF SUCH DAMAGE.
 #define SD_DATATIMEOUT                      ((uint32_t)0xFFFFFFFF)    /* DSM data timeout */
 #define SD_MAX_VOLT_VALIDATION              ((uint32_t)0x0000FFFF)    /* the maximum times of voltage validation */
 #define SD_MAX_DATA_LENGTH                  ((uint32_t)0x01FFFFFF)    /* the maximum length of data */
+#define SD_BLOCK_BYTES                      ((uint32_t)0x00000200)    /* block size of the DMA block transfers */
 #define SD_ALLZERO                          ((uint32_t)0x00000000)    /* all zero */
 #define SD_RCA_SHIFT                        ((uint8_t)0x10)           /* RCA shift bits */
 #define SD_CLK_DIV_INIT                     ((uint16_t)0x0076)        /* SD clock division in initialization phase */
@@ -145,6 +156,8 @@ static sd_error_enum sd_bus_width_config(uint32_t buswidth);
 static sd_error_enum sd_scr_get(uint16_t rca, uint32_t *pscr);
 /* get the data block size */
 static uint32_t sd_datablocksize_get(uint16_t bytesnumber);
+/* prepare the card and the SDIO for a DMA block transfer */
+static sd_error_enum sd_dma_transfer_prepare(uint32_t *paddr, uint32_t blocksnumber);
 
 /* configure the GPIO of SDIO interface */
 static void gpio_config(void);
@@ -428,6 +441,96 @@ sd_error_enum sd_transfer_mode_config(uint32_t txmode)
     return status;
 }
 
+/*!
+    \brief      switch the card to high speed mode and the SDIO_CLK to the SDIOCLK frequency
+    \note       call it after sd_bus_mode_config(), which reads the SCR of the card
+    \param[in]  none
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_high_speed_config(void)
+{
+    sd_error_enum status = SD_OK;
+    uint32_t switch_status[SD_SWITCH_STATUS_WORDS], idx_status = 0;
+
+    /* high speed needs a SD memory card of version 1.10 or later supporting the switch function class */
+    if(((SDIO_STD_CAPACITY_SD_CARD_V1_1 != cardtype) && (SDIO_STD_CAPACITY_SD_CARD_V2_0 != cardtype) &&
+            (SDIO_HIGH_CAPACITY_SD_CARD != cardtype)) || (SD_ALLZERO == (sd_scr[1] & SD_SCR_SD_SPEC)) ||
+            (SD_ALLZERO == ((sd_csd[1] >> 20) & SD_CCC_SWITCH))) {
+        status = SD_FUNCTION_UNSUPPORTED;
+        return status;
+    }
+
+    /* send CMD16(SET_BLOCKLEN) to set the block length to the length of the switch function status */
+    sdio_command_response_config(SD_CMD_SET_BLOCKLEN, SD_SWITCH_STATUS_BYTES, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_WAITTYPE_NO);
+    sdio_csm_enable();
+    /* check if some error occurs */
+    status = r1_error_check(SD_CMD_SET_BLOCKLEN);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    /* configure SDIO data */
+    sdio_data_config(SD_DATATIMEOUT, SD_SWITCH_STATUS_BYTES, SDIO_DATABLOCKSIZE_64BYTES);
+    sdio_data_transfer_config(SDIO_TRANSMODE_BLOCK, SDIO_TRANSDIRECTION_TOSDIO);
+    sdio_dsm_enable();
+
+    /* send CMD6(SWITCH_FUNC) to switch the access mode to high speed */
+    sdio_command_response_config(SD_CMD_SWITCH_FUNC, SD_SWITCH_HIGH_SPEED, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_WAITTYPE_NO);
+    sdio_csm_enable();
+    /* check if some error occurs */
+    status = r1_error_check(SD_CMD_SWITCH_FUNC);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    /* store the received switch function status */
+    while(!sdio_flag_get(SDIO_FLAG_DTCRCERR | SDIO_FLAG_DTTMOUT | SDIO_FLAG_RXORE | SDIO_FLAG_DTBLKEND | SDIO_FLAG_STBITE)) {
+        if((RESET != sdio_flag_get(SDIO_FLAG_RXDTVAL)) && (idx_status < SD_SWITCH_STATUS_WORDS)) {
+            *(switch_status + idx_status) = sdio_data_read();
+            ++idx_status;
+        }
+    }
+
+    /* check whether some error occurs */
+    if(RESET != sdio_flag_get(SDIO_FLAG_DTCRCERR)) {
+        status = SD_DATA_CRC_ERROR;
+        sdio_flag_clear(SDIO_FLAG_DTCRCERR);
+        return status;
+    } else if(RESET != sdio_flag_get(SDIO_FLAG_DTTMOUT)) {
+        status = SD_DATA_TIMEOUT;
+        sdio_flag_clear(SDIO_FLAG_DTTMOUT);
+        return status;
+    } else if(RESET != sdio_flag_get(SDIO_FLAG_RXORE)) {
+        status = SD_RX_OVERRUN_ERROR;
+        sdio_flag_clear(SDIO_FLAG_RXORE);
+        return status;
+    } else if(RESET != sdio_flag_get(SDIO_FLAG_STBITE)) {
+        status = SD_START_BIT_ERROR;
+        sdio_flag_clear(SDIO_FLAG_STBITE);
+        return status;
+    }
+    while((RESET != sdio_flag_get(SDIO_FLAG_RXDTVAL)) && (idx_status < SD_SWITCH_STATUS_WORDS)) {
+        *(switch_status + idx_status) = sdio_data_read();
+        ++idx_status;
+    }
+
+    /* clear all the SDIO_INTC flags */
+    sdio_flag_clear(SDIO_MASK_INTC_FLAGS);
+    /* bits 379:376 of the status are the function selected in group 1, 1 means high speed */
+    if((SD_SWITCH_STATUS_WORDS != idx_status) || (1U != (switch_status[4] & SD_SWITCH_GROUP1_RESULT))) {
+        status = SD_FUNCTION_UNSUPPORTED;
+        return status;
+    }
+
+    /* the card works in high speed mode, bypass the clock divider */
+    sdio_clock_config(SDIO_SDIOCLKEDGE_RISING, SDIO_CLOCKBYPASS_ENABLE,
+                      SDIO_CLOCKPWRSAVE_DISABLE, SD_CLK_DIV_TRANS);
+    return status;
+}
+
 /*!
     \brief      read a block data into a buffer from the specified address of a card
     \param[out] preadbuffer: a pointer that store a block read data
@@ -1115,6 +1218,129 @@ sd_error_enum sd_multiblocks_write(uint32_t *pwritebuffer, uint32_t writeaddr, u
     return status;
 }
 
+/*!
+    \brief      start reading multiple blocks into a buffer by DMA without waiting for the end,
+                sd_dma_transfer_state_get() reports the end of the transfer
+    \param[out] preadbuffer: a word aligned pointer that store the read data
+    \param[in]  blockaddr: the number of the first block, the block size is 512 bytes
+    \param[in]  blocksnumber: number of blocks that will be read
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_blocks_read_dma_start(uint32_t *preadbuffer, uint32_t blockaddr, uint32_t blocksnumber)
+{
+    sd_error_enum status = SD_OK;
+    uint8_t cmdindex = SD_CMD_READ_SINGLE_BLOCK;
+
+    if((NULL == preadbuffer) || (0U != ((uint32_t)preadbuffer & 0x3U)) || (0U == blocksnumber) ||
+            (blocksnumber > (SD_MAX_DATA_LENGTH / SD_BLOCK_BYTES))) {
+        status = SD_PARAMETER_INVALID;
+        return status;
+    }
+
+    /* set the block length and the block count */
+    status = sd_dma_transfer_prepare(&blockaddr, blocksnumber);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    /* configure the SDIO data transmission */
+    sdio_data_config(SD_DATATIMEOUT, totalnumber_bytes, SDIO_DATABLOCKSIZE_512BYTES);
+    sdio_data_transfer_config(SDIO_TRANSMODE_BLOCK, SDIO_TRANSDIRECTION_TOSDIO);
+    sdio_dsm_enable();
+
+    /* send CMD17(READ_SINGLE_BLOCK) or CMD18(READ_MULTIPLE_BLOCK) to read the blocks */
+    if(blocksnumber > 1U) {
+        cmdindex = SD_CMD_READ_MULTIPLE_BLOCK;
+    }
+    sdio_command_response_config(cmdindex, blockaddr, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_WAITTYPE_NO);
+    sdio_csm_enable();
+    /* check if some error occurs */
+    status = r1_error_check(cmdindex);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    /* enable the SDIO corresponding interrupts and DMA function, sd_interrupts_process() ends the transfer */
+    sdio_interrupt_enable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_RXORE | SDIO_INT_DTEND | SDIO_INT_STBITE);
+    sdio_dma_enable();
+    dma_receive_config(preadbuffer, totalnumber_bytes);
+    return status;
+}
+
+/*!
+    \brief      start writing multiple blocks to the card by DMA without waiting for the end,
+                sd_dma_transfer_state_get() reports the end of the transfer
+    \param[in]  pwritebuffer: a word aligned pointer that store the data to be transferred
+    \param[in]  blockaddr: the number of the first block, the block size is 512 bytes
+    \param[in]  blocksnumber: number of blocks that will be written
+    \param[out] none
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_blocks_write_dma_start(uint32_t *pwritebuffer, uint32_t blockaddr, uint32_t blocksnumber)
+{
+    sd_error_enum status = SD_OK;
+    uint8_t cmdindex = SD_CMD_WRITE_BLOCK;
+
+    if((NULL == pwritebuffer) || (0U != ((uint32_t)pwritebuffer & 0x3U)) || (0U == blocksnumber) ||
+            (blocksnumber > (SD_MAX_DATA_LENGTH / SD_BLOCK_BYTES))) {
+        status = SD_PARAMETER_INVALID;
+        return status;
+    }
+
+    /* set the block length and the block count */
+    status = sd_dma_transfer_prepare(&blockaddr, blocksnumber);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    if(blocksnumber > 1U) {
+        cmdindex = SD_CMD_WRITE_MULTIPLE_BLOCK;
+        if(1U == stopcondition) {
+            /* no CMD23, send CMD55(APP_CMD) to indicate next command is application specific command */
+            sdio_command_response_config(SD_CMD_APP_CMD, (uint32_t)sd_rca << SD_RCA_SHIFT, SDIO_RESPONSETYPE_SHORT);
+            sdio_wait_type_set(SDIO_WAITTYPE_NO);
+            sdio_csm_enable();
+            /* check if some error occurs */
+            status = r1_error_check(SD_CMD_APP_CMD);
+            if(SD_OK != status) {
+                return status;
+            }
+
+            /* send ACMD23(SET_WR_BLK_ERASE_COUNT) to set the number of write blocks to be preerased before writing */
+            sdio_command_response_config(SD_APPCMD_SET_WR_BLK_ERASE_COUNT, blocksnumber, SDIO_RESPONSETYPE_SHORT);
+            sdio_wait_type_set(SDIO_WAITTYPE_NO);
+            sdio_csm_enable();
+            /* check if some error occurs */
+            status = r1_error_check(SD_APPCMD_SET_WR_BLK_ERASE_COUNT);
+            if(SD_OK != status) {
+                return status;
+            }
+        }
+    }
+
+    /* send CMD24(WRITE_BLOCK) or CMD25(WRITE_MULTIPLE_BLOCK) to write the blocks */
+    sdio_command_response_config(cmdindex, blockaddr, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_WAITTYPE_NO);
+    sdio_csm_enable();
+    /* check if some error occurs */
+    status = r1_error_check(cmdindex);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    /* configure the SDIO data transmission */
+    sdio_data_config(SD_DATATIMEOUT, totalnumber_bytes, SDIO_DATABLOCKSIZE_512BYTES);
+    sdio_data_transfer_config(SDIO_TRANSMODE_BLOCK, SDIO_TRANSDIRECTION_TOCARD);
+    sdio_dsm_enable();
+
+    /* enable the SDIO corresponding interrupts and DMA function, sd_interrupts_process() ends the transfer */
+    sdio_interrupt_enable(SDIO_INT_DTCRCERR | SDIO_INT_DTTMOUT | SDIO_INT_TXURE | SDIO_INT_DTEND | SDIO_INT_STBITE);
+    sdio_dma_enable();
+    dma_transfer_config(pwritebuffer, totalnumber_bytes);
+    return status;
+}
+
 /*!
     \brief      erase a continuous area of a card
     \param[in]  startaddr: the start address
@@ -1578,6 +1804,52 @@ sd_transfer_state_enum sd_transfer_state_get(void)
     return transtate;
 }
 
+/*!
+    \brief      get the state and the result of the DMA transfer started last
+    \param[in]  none
+    \param[out] perror: a pointer that store the result when the transfer is not in progress
+    \retval     sd_transfer_state_enum
+*/
+sd_transfer_state_enum sd_dma_transfer_state_get(sd_error_enum *perror)
+{
+    sd_transfer_state_enum transtate = SD_TRANSFER_IN_PROGRESS;
+
+    if(SD_OK != transerror) {
+        /* an error interrupt ended the transfer, stop the DMA */
+        dma_channel_disable(DMA1, DMA_CH3);
+        sdio_dma_disable();
+        *perror = transerror;
+        transtate = SD_NO_TRANSFER;
+    } else if((0U != transend) && (RESET != dma_flag_get(DMA1, DMA_CH3, DMA_FLAG_FTF))) {
+        /* the data end interrupt occurred and the DMA has flushed its FIFO */
+        sdio_dma_disable();
+        sdio_flag_clear(SDIO_MASK_INTC_FLAGS);
+        *perror = SD_OK;
+        transtate = SD_NO_TRANSFER;
+    }
+    return transtate;
+}
+
+/*!
+    \brief      check whether the card is ready to start a data transfer, that is, the card is
+                in transfer state and not busy with programming the data written last
+    \param[in]  none
+    \param[out] pready: a pointer that store 1 if the card is ready, otherwise 0
+    \retval     sd_error_enum
+*/
+sd_error_enum sd_card_ready_check(uint8_t *pready)
+{
+    sd_error_enum status = SD_OK;
+    uint8_t cardstate = 0;
+
+    *pready = 0;
+    status = sd_card_state_get(&cardstate);
+    if((SD_OK == status) && (SD_CARDSTATE_TRANSFER == cardstate)) {
+        *pready = 1;
+    }
+    return status;
+}
+
 /*!
     \brief      get SD card capacity
     \param[in]  none
@@ -2344,6 +2616,67 @@ static uint32_t sd_datablocksize_get(uint16_t bytesnumber)
     return DATACTL_BLKSZ(exp_val);
 }
 
+/*!
+    \brief      prepare the card and the SDIO for a DMA block transfer
+    \param[in]  paddr: a pointer that store the number of the first block
+    \param[in]  blocksnumber: number of blocks that will be transferred
+    \param[out] paddr: a pointer that store the address argument of the read/write command
+    \retval     sd_error_enum
+*/
+static sd_error_enum sd_dma_transfer_prepare(uint32_t *paddr, uint32_t blocksnumber)
+{
+    sd_error_enum status = SD_OK;
+
+    transerror = SD_OK;
+    transend = 0;
+    totalnumber_bytes = 0;
+    /* clear all DSM configuration */
+    sdio_data_config(0, 0, SDIO_DATABLOCKSIZE_1BYTE);
+    sdio_data_transfer_config(SDIO_TRANSMODE_BLOCK, SDIO_TRANSDIRECTION_TOCARD);
+    sdio_dsm_disable();
+    sdio_dma_disable();
+
+    /* check whether the card is locked */
+    if(sdio_response_get(SDIO_RESPONSE0) & SD_CARDSTATE_LOCKED) {
+        status = SD_LOCK_UNLOCK_FAILED;
+        return status;
+    }
+
+    /* standard capacity card is addressed in bytes, high capacity card in blocks */
+    if(SDIO_HIGH_CAPACITY_SD_CARD != cardtype) {
+        *paddr *= SD_BLOCK_BYTES;
+    }
+
+    /* send CMD16(SET_BLOCKLEN) to set the block length */
+    sdio_command_response_config(SD_CMD_SET_BLOCKLEN, SD_BLOCK_BYTES, SDIO_RESPONSETYPE_SHORT);
+    sdio_wait_type_set(SDIO_WAITTYPE_NO);
+    sdio_csm_enable();
+    /* check if some error occurs */
+    status = r1_error_check(SD_CMD_SET_BLOCKLEN);
+    if(SD_OK != status) {
+        return status;
+    }
+
+    stopcondition = 0;
+    if(blocksnumber > 1U) {
+        if(SD_ALLZERO != (sd_scr[1] & SD_SCR_CMD23_SUPPORT)) {
+            /* send CMD23(SET_BLOCK_COUNT), the card ends the transfer by itself without CMD12 */
+            sdio_command_response_config(SD_CMD_SET_BLOCK_COUNT, blocksnumber, SDIO_RESPONSETYPE_SHORT);
+            sdio_wait_type_set(SDIO_WAITTYPE_NO);
+            sdio_csm_enable();
+            /* check if some error occurs */
+            status = r1_error_check(SD_CMD_SET_BLOCK_COUNT);
+            if(SD_OK != status) {
+                return status;
+            }
+        } else {
+            stopcondition = 1;
+        }
+    }
+    totalnumber_bytes = blocksnumber * SD_BLOCK_BYTES;
+    return status;
+}
+
 /*!
     \brief      configure the GPIO of SDIO interface
     \param[in]  none
@@ -2357,13 +2690,13 @@ static void gpio_config(void)
     gpio_af_set(GPIOD, GPIO_AF_12, GPIO_PIN_2);
 
     gpio_mode_set(GPIOC, GPIO_MODE_AF, GPIO_PUPD_PULLUP, GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10 | GPIO_PIN_11);
-    gpio_output_options_set(GPIOC, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ, GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10 | GPIO_PIN_11);
+    gpio_output_options_set(GPIOC, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_8 | GPIO_PIN_9 | GPIO_PIN_10 | GPIO_PIN_11);
 
     gpio_mode_set(GPIOC, GPIO_MODE_AF, GPIO_PUPD_NONE, GPIO_PIN_12);
-    gpio_output_options_set(GPIOC, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ, GPIO_PIN_12);
+    gpio_output_options_set(GPIOC, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_12);
 
     gpio_mode_set(GPIOD, GPIO_MODE_AF, GPIO_PUPD_PULLUP, GPIO_PIN_2);
-    gpio_output_options_set(GPIOD, GPIO_OTYPE_PP, GPIO_OSPEED_25MHZ, GPIO_PIN_2);
+    gpio_output_options_set(GPIOD, GPIO_OTYPE_PP, GPIO_OSPEED_50MHZ, GPIO_PIN_2);
 
 }
 
@@ -56,6 +56,7 @@ OF SUCH DAMAGE.
 #define SD_CMD_SET_BLOCKLEN                   ((uint8_t)16)  /* CMD16, SET_BLOCKLEN */
 #define SD_CMD_READ_SINGLE_BLOCK              ((uint8_t)17)  /* CMD17, READ_SINGLE_BLOCK */
 #define SD_CMD_READ_MULTIPLE_BLOCK            ((uint8_t)18)  /* CMD18, READ_MULTIPLE_BLOCK */
+#define SD_CMD_SET_BLOCK_COUNT                ((uint8_t)23)  /* CMD23, SET_BLOCK_COUNT */
 #define SD_CMD_WRITE_BLOCK                    ((uint8_t)24)  /* CMD24, WRITE_BLOCK */
 #define SD_CMD_WRITE_MULTIPLE_BLOCK           ((uint8_t)25)  /* CMD25, WRITE_MULTIPLE_BLOCK */
 #define SD_CMD_PROG_CSD                       ((uint8_t)27)  /* CMD27, PROG_CSD */
@@ -221,6 +222,8 @@ sd_error_enum sd_power_off(void);
 sd_error_enum sd_bus_mode_config(uint32_t busmode);
 /* configure the mode of transmission */
 sd_error_enum sd_transfer_mode_config(uint32_t txmode);
+/* switch the card to high speed mode and the SDIO_CLK to the SDIOCLK frequency */
+sd_error_enum sd_high_speed_config(void);
 
 /* read a block data into a buffer from the specified address of a card */
 sd_error_enum sd_block_read(uint32_t *preadbuffer, uint32_t readaddr, uint16_t blocksize);
@@ -230,6 +233,14 @@ sd_error_enum sd_multiblocks_read(uint32_t *preadbuffer, uint32_t readaddr, uint
 sd_error_enum sd_block_write(uint32_t *pwritebuffer, uint32_t writeaddr, uint16_t blocksize);
 /* write multiple blocks data to the specified address of a card */
 sd_error_enum sd_multiblocks_write(uint32_t *pwritebuffer, uint32_t writeaddr, uint16_t blocksize, uint32_t blocksnumber);
+/* start reading multiple blocks into a buffer by DMA without waiting for the end */
+sd_error_enum sd_blocks_read_dma_start(uint32_t *preadbuffer, uint32_t blockaddr, uint32_t blocksnumber);
+/* start writing multiple blocks to the card by DMA without waiting for the end */
+sd_error_enum sd_blocks_write_dma_start(uint32_t *pwritebuffer, uint32_t blockaddr, uint32_t blocksnumber);
+/* get the state and the result of the DMA transfer started last */
+sd_transfer_state_enum sd_dma_transfer_state_get(sd_error_enum *perror);
+/* check whether the card is ready to start a data transfer */
+sd_error_enum sd_card_ready_check(uint8_t *pready);
 /* erase a continuous area of a card */
 sd_error_enum sd_erase(uint32_t startaddr, uint32_t endaddr);
 /* process all the interrupts which the corresponding flags are set */
@@ -134,5 +134,7 @@ void audio_play(uint32_t addr, uint32_t size);
 void audio_pause_resume(uint32_t cmd, uint32_t addr, uint32_t size);
 /* stops audio stream playing on the used media */
 void audio_stop(void);
+/* get the number of data the DMA has still to send from the current chunk */
+uint32_t audio_dma_remain(void);
 
 #endif /* __GD32F450I_AUDIO_CODEC_H */
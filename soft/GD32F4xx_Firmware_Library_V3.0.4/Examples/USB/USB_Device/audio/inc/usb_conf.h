@@ -134,6 +134,8 @@ OF SUCH DAMAGE.
 
 //#define VBUS_SENSING_ENABLED
 
+//#define USB_TRACE_ENABLED
+
 //#define USE_HOST_MODE
 #define USE_DEVICE_MODE
 //#define USE_OTG_MODE
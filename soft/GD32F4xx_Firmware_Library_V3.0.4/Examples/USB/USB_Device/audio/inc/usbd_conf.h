@@ -70,11 +70,16 @@ OF SUCH DAMAGE.
                                                         (SPEAKER_OUT_BIT_RESOLUTION/8) *\
                                                          SPEAKER_OUT_CHANNEL_NBR) /1000)) 
 
-/* feedback parameter */
+/* feedback parameter: the feedback value stays within FEEDBACK_FREQ_OFFSET of the nominal rate,
+   it is 3 bytes (10.14) at full speed and 4 bytes (16.16) at high speed */
 #define FEEDBACK_FREQ_OFFSET                (USBD_SPEAKER_FREQ/100)
 #define FEEDBACK_IN_PACKET                  3
 #define FEEDBACK_IN_INTERVAL                5
 
+/* uncomment the define below to convert the stream to the I2S rate on the device, for hosts
+   which do not follow the feedback endpoint */
+//#define USE_USB_AD_RESAMPLER
+
 #define SPEAKER_OUT_MAX_PACKET              (SPEAKER_OUT_PACKET + 20)
 
 /* audio frequency in Hz */
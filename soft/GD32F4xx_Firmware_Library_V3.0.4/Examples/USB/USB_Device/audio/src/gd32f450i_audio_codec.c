@@ -199,7 +199,7 @@ void codec_i2s_dma_init(void)
     dma_initstructure.periph_inc = DMA_PERIPH_INCREASE_DISABLE;
     dma_initstructure.memory_inc = DMA_MEMORY_INCREASE_ENABLE;
     dma_initstructure.periph_memory_width = AD_DMA_PERIPH_DATA_SIZE;
-    dma_initstructure.circular_mode = DMA_CIRCULAR_MODE_DISABLE;
+    dma_initstructure.circular_mode = DMA_CIRCULAR_MODE_ENABLE;
     dma_initstructure.priority = DMA_PRIORITY_ULTRA_HIGH;
     dma_single_data_mode_init(AD_DMA, AD_DMA_CHANNEL, &dma_initstructure);
     dma_channel_subperipheral_select(AD_DMA, AD_DMA_CHANNEL, DMA_SUBPERI0);
@@ -241,10 +241,12 @@ void audio_mal_deinit(void)
 
 /*!
     \brief      starts playing audio stream from the audio media
-    \param[in]  addr: pointer to the audio stream buffer
-    \param[in]  size: number of data in the audio stream buffer
+    \param[in]  addr: pointer to the first chunk of the audio stream
+    \param[in]  size: number of data in each chunk of the audio stream
     \param[out] none
     \retval     none
+    \note       the DMA runs in switch-buffer mode, the following chunk is taken from the
+                audio class right away and each further one from the DMA interrupt
 */
 void audio_play(uint32_t addr, uint32_t size)
 {
@@ -265,6 +267,10 @@ void audio_play(uint32_t addr, uint32_t size)
     /* configure the DMA Stream with the new parameters */
     dma_single_data_mode_init(AD_DMA, AD_DMA_CHANNEL, &dma_initstructure);
 
+    /* queue the following chunk behind the first one */
+    dma_switch_buffer_mode_config(AD_DMA, AD_DMA_CHANNEL, (uint32_t)usbd_audio_spk_next_chunk(), DMA_MEMORY_0);
+    dma_switch_buffer_mode_enable(AD_DMA, AD_DMA_CHANNEL, ENABLE);
+
     /* enable the I2S DMA Stream*/
     dma_channel_enable(AD_DMA, AD_DMA_CHANNEL);
 
@@ -303,20 +309,8 @@ void audio_pause_resume(uint32_t cmd, uint32_t addr, uint32_t size)
         dma_flag_clear(AD_DMA, AD_DMA_CHANNEL, DMA_FLAG_HTF);
         dma_flag_clear(AD_DMA, AD_DMA_CHANNEL, DMA_FLAG_FTF);
     } else {
-        /* configure the buffer address and size */
-        dma_initstructure.memory0_addr = (uint32_t)addr;
-        dma_initstructure.number = (uint32_t)size;
-
-        /* configure the DMA Stream with the new parameters */
-        dma_single_data_mode_init(AD_DMA, AD_DMA_CHANNEL, &dma_initstructure);
-
-        /* enable the I2S DMA Stream*/
-        dma_channel_enable(AD_DMA, AD_DMA_CHANNEL);
-
-        /* if the I2S peripheral is still not enabled, enable it */
-        if (0U == (SPI_I2SCTL(AD_I2S) & I2S_ENABLE_MASK)) {
-            i2s_enable(AD_I2S);
-        }
+        /* restart the chunk queue from the given address */
+        audio_play(addr, size);
     }
 }
 
@@ -345,60 +339,39 @@ void audio_stop(void)
     codec_audio_interface_init(i2s_audiofreq);
 }
 
+/*!
+    \brief      get the number of data the DMA has still to send from the current chunk
+    \param[in]  none
+    \param[out] none
+    \retval     number of remaining data
+*/
+uint32_t audio_dma_remain(void)
+{
+    return dma_transfer_number_get(AD_DMA, AD_DMA_CHANNEL);
+}
+
 /*!
     \brief      this function handles main media layer interrupt
     \param[in]  none
     \param[out] none
-    \retval     0 if correct communication, else wrong communication
+    \retval     none
 */
 void AD_DMA_IRQHandler(void)
 {
-    uint16_t remain_size = 0;
+    uint8_t *chunk;
 
-    /* transfer complete interrupt */
+    /* transfer complete interrupt: the DMA has switched to the other memory */
     if(dma_flag_get(AD_DMA, AD_DMA_CHANNEL, AD_DMA_FLAG_TC) != RESET){
-        /* increment to the next sub-buffer */
-        audio_handler.isoc_out_rdptr += audio_handler.dam_tx_len;
-
-        if (audio_handler.isoc_out_rdptr >= (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE)) {
-            /* roll back to the start of buffer */
-            audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
-        }
-
-        if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr){
-            remain_size = audio_handler.isoc_out_wrptr - audio_handler.isoc_out_rdptr;
-        }else{
-            remain_size = TOTAL_OUT_BUF_SIZE + audio_handler.isoc_out_buff - audio_handler.isoc_out_rdptr;
-        }
-
-        /* check if the end of file has been reached */
-        if(remain_size > 0){
-            dma_channel_disable(AD_DMA, AD_DMA_CHANNEL);
-
-            /* clear the Interrupt flag */
-            dma_flag_clear(AD_DMA, AD_DMA_CHANNEL, AD_DMA_FLAG_TC);
-
-            /* clear the Interrupt flag */
-            dma_interrupt_flag_clear(AD_DMA, AD_DMA_CHANNEL, AD_DMA_INT_FLAG_TE);
-
-            DMA_CHM0ADDR(AD_DMA, AD_DMA_CHANNEL) = (uint32_t)audio_handler.isoc_out_rdptr;
-
-            DMA_CHCNT(AD_DMA, AD_DMA_CHANNEL) = (uint32_t)(remain_size / 2);
-
-            /* update the current DMA tx data length */
-            audio_handler.dam_tx_len = (remain_size / 2) * 2;
-
-            dma_channel_enable(AD_DMA, AD_DMA_CHANNEL);
-        }else{
-            /* disable the I2S DMA Stream*/
-            dma_channel_disable(AD_DMA, AD_DMA_CHANNEL);
+        /* clear the Interrupt flag */
+        dma_interrupt_flag_clear(AD_DMA, AD_DMA_CHANNEL, DMA_INT_FLAG_FTF);
 
-            /* clear the Interrupt flag */
-            dma_interrupt_flag_clear(AD_DMA, AD_DMA_CHANNEL, DMA_INT_FLAG_FTF);
+        /* refill the memory just played with the next chunk */
+        chunk = usbd_audio_spk_next_chunk();
 
-            /* clear flag */
-            audio_handler.dam_tx_len = 0;
-            audio_handler.play_flag = 0U;
+        if (DMA_MEMORY_0 == dma_using_memory_get(AD_DMA, AD_DMA_CHANNEL)) {
+            dma_memory_address_config(AD_DMA, AD_DMA_CHANNEL, DMA_MEMORY_1, (uint32_t)chunk);
+        } else {
+            dma_memory_address_config(AD_DMA, AD_DMA_CHANNEL, DMA_MEMORY_0, (uint32_t)chunk);
         }
     }
 }
@@ -41,6 +41,9 @@ static uint8_t inter_flash_if_erase (uint32_t addr);
 static uint8_t inter_flash_if_write (uint8_t *buf, uint32_t addr, uint32_t len);
 static uint8_t* inter_flash_if_read (uint8_t *buf, uint32_t addr, uint32_t len);
 static uint8_t inter_flash_if_checkaddr (uint32_t addr);
+static uint8_t inter_flash_if_erase_start (uint32_t addr);
+static uint8_t inter_flash_if_op_status (void);
+static uint32_t inter_flash_if_sector_get (uint32_t addr, uint32_t *base);
 static uint32_t fmc_sector_get (uint32_t address);
 static void fmc_erase_sector (uint32_t fmc_sector);
 
@@ -55,7 +58,24 @@ dfu_mem_prop dfu_inter_flash_cb =
     inter_flash_if_read,
     inter_flash_if_checkaddr,
     60, /* flash erase timeout in ms */
-    80  /* flash programming timeout in ms (80us * RAM Buffer size (1024 Bytes) */
+    80, /* flash programming timeout in ms (80us * RAM Buffer size (1024 Bytes) */
+
+    inter_flash_if_erase_start,
+    inter_flash_if_op_status,
+    inter_flash_if_sector_get
+};
+
+/* sector boundaries, the last entry is the end of the flash */
+static const uint32_t fmc_sector_addr[] =
+{
+    ADDR_FMC_SECTOR_0,  ADDR_FMC_SECTOR_1,  ADDR_FMC_SECTOR_2,  ADDR_FMC_SECTOR_3,
+    ADDR_FMC_SECTOR_4,  ADDR_FMC_SECTOR_5,  ADDR_FMC_SECTOR_6,  ADDR_FMC_SECTOR_7,
+    ADDR_FMC_SECTOR_8,  ADDR_FMC_SECTOR_9,  ADDR_FMC_SECTOR_10, ADDR_FMC_SECTOR_11,
+    ADDR_FMC_SECTOR_12, ADDR_FMC_SECTOR_13, ADDR_FMC_SECTOR_14, ADDR_FMC_SECTOR_15,
+    ADDR_FMC_SECTOR_16, ADDR_FMC_SECTOR_17, ADDR_FMC_SECTOR_18, ADDR_FMC_SECTOR_19,
+    ADDR_FMC_SECTOR_20, ADDR_FMC_SECTOR_21, ADDR_FMC_SECTOR_22, ADDR_FMC_SECTOR_23,
+    ADDR_FMC_SECTOR_24, ADDR_FMC_SECTOR_25, ADDR_FMC_SECTOR_26, ADDR_FMC_SECTOR_27,
+    FLASH_END_ADDR
 };
 
 /*!
@@ -226,6 +246,8 @@ static uint8_t inter_flash_if_erase (uint32_t addr)
 static uint8_t inter_flash_if_write (uint8_t *buf, uint32_t addr, uint32_t len)
 {
     uint32_t idx = 0U;
+    uint32_t data = 0U;
+    uint8_t status = MEM_OK;
 
     /* unlock the flash program erase controller */
     fmc_unlock();
@@ -242,13 +264,20 @@ static uint8_t inter_flash_if_write (uint8_t *buf, uint32_t addr, uint32_t len)
 
     /* data received are word multiple */
     for (idx = 0U; idx < len; idx += 4U) {
-        fmc_word_program(addr, *(uint32_t *)(buf + idx));
+        data = *(uint32_t *)(buf + idx);
+
+        /* programming can only clear bits, an all ones word leaves the flash as it is */
+        if ((0xFFFFFFFFU != data) && (FMC_READY != fmc_word_program(addr, data))) {
+            status = MEM_FAIL;
+            break;
+        }
+
         addr += 4U;
     }
 
     fmc_lock();
 
-    return MEM_OK;
+    return status;
 }
 
 /*!
@@ -379,3 +408,71 @@ static uint32_t fmc_sector_get(uint32_t addr)
     return sector;
 }
 
+/*!
+    \brief      start erasing a flash sector without waiting for the end
+    \param[in]  addr: flash address to be erased
+    \param[out] none
+    \retval     MEM_OK if the erase is started, MEM_FAIL else
+*/
+static uint8_t inter_flash_if_erase_start (uint32_t addr)
+{
+    if (FMC_BUSY == fmc_state_get()) {
+        return MEM_FAIL;
+    }
+
+    /* unlock the flash program erase controller */
+    fmc_unlock();
+
+    /* clear pending flags */
+    fmc_flag_clear(FMC_FLAG_END | FMC_FLAG_OPERR | FMC_FLAG_WPERR | FMC_FLAG_PGMERR | FMC_FLAG_PGSERR);
+
+    /* start sector erase, inter_flash_if_op_status() completes it */
+    FMC_CTL &= ~FMC_CTL_SN;
+    FMC_CTL |= (FMC_CTL_SER | fmc_sector_get(addr));
+    FMC_CTL |= FMC_CTL_START;
+
+    return MEM_OK;
+}
+
+/*!
+    \brief      check the sector erase started by inter_flash_if_erase_start()
+    \param[in]  none
+    \param[out] none
+    \retval     MEM_BUSY while erasing, MEM_OK when done, MEM_FAIL on error
+*/
+static uint8_t inter_flash_if_op_status (void)
+{
+    fmc_state_enum state = fmc_state_get();
+
+    if (FMC_BUSY == state) {
+        return MEM_BUSY;
+    }
+
+    /* reset the SER bit */
+    FMC_CTL &= ~FMC_CTL_SER;
+    FMC_CTL &= ~FMC_CTL_SN;
+
+    /* lock the flash program erase controller */
+    fmc_lock();
+
+    return (FMC_READY == state) ? MEM_OK : MEM_FAIL;
+}
+
+/*!
+    \brief      get the sector of a given address
+    \param[in]  addr: flash address
+    \param[out] base: start address of the sector
+    \retval     size of the sector in bytes
+*/
+static uint32_t inter_flash_if_sector_get (uint32_t addr, uint32_t *base)
+{
+    uint32_t idx = 0U;
+
+    while ((idx < (sizeof(fmc_sector_addr) / sizeof(fmc_sector_addr[0]) - 2U)) && (addr >= fmc_sector_addr[idx + 1U])) {
+        idx++;
+    }
+
+    *base = fmc_sector_addr[idx];
+
+    return fmc_sector_addr[idx + 1U] - fmc_sector_addr[idx];
+}
@@ -102,6 +102,8 @@ OF SUCH DAMAGE.
     #define USBHS_LOW_POWER                                0
 #endif
 
+//#define USB_TRACE_ENABLED
+
 /****************** USB OTG MODE CONFIGURATION ********************************/
 #define USE_HOST_MODE
 //#define USE_DEVICE_MODE
@@ -39,15 +39,40 @@ OF SUCH DAMAGE.
 
 #include "usbd_enum.h"
 
+#ifdef USE_USB_AD_RESAMPLER
+    #include "audio_resampler.h"
+#endif /* USE_USB_AD_RESAMPLER */
+
 #define FORMAT_24BIT(x)                           (uint8_t)(x);(uint8_t)((x) >> 8U);(uint8_t)((x) >> 16U)
 
-/* number of sub-packets in the audio transfer buffer. you can modify this value but always make sure
-   that it is an even number and higher than 3 */
-#define OUT_PACKET_NUM                            200U
+/* number of sub-packets in the audio transfer buffer. the output DMA plays the buffer one sub-packet
+   (1 ms of audio) at a time, you can modify this value but always make sure that it is higher than 3 */
+#ifndef OUT_PACKET_NUM
+#define OUT_PACKET_NUM                            32U
+#endif /* OUT_PACKET_NUM */
 
 /* total size of the audio transfer buffer */
-#define OUT_BUF_MARGIN                            0U
-#define TOTAL_OUT_BUF_SIZE                        ((uint32_t)((SPEAKER_OUT_PACKET + OUT_BUF_MARGIN) * OUT_PACKET_NUM))
+#define AD_OUT_CHUNK_SIZE                         ((uint32_t)SPEAKER_OUT_PACKET)
+#define TOTAL_OUT_BUF_SIZE                        ((uint32_t)(AD_OUT_CHUNK_SIZE * OUT_PACKET_NUM))
+
+/* size of one sample frame of the speaker stream */
+#define AD_OUT_FRAME_SIZE                         ((uint32_t)(SPEAKER_OUT_CHANNEL_NBR * SPEAKER_OUT_BIT_RESOLUTION / 8))
+
+/* buffer fill level in bytes the feedback loop holds the speaker stream at */
+#ifndef AD_OUT_TARGET_LEVEL
+#define AD_OUT_TARGET_LEVEL                       (TOTAL_OUT_BUF_SIZE / 2U)
+#endif /* AD_OUT_TARGET_LEVEL */
+
+/* gains of the feedback loop: the rate correction in Q16 samples per frame is
+   (level error << AD_FB_KP_SHIFT) + (integrated level error << AD_FB_KI_SHIFT),
+   with the level error counted in sample frames once per feedback period */
+#ifndef AD_FB_KP_SHIFT
+#define AD_FB_KP_SHIFT                            9U
+#endif /* AD_FB_KP_SHIFT */
+
+#ifndef AD_FB_KI_SHIFT
+#define AD_FB_KI_SHIFT                            5U
+#endif /* AD_FB_KI_SHIFT */
 
 #define AD_CONFIG_DESC_SET_LEN                    (sizeof(usb_desc_config_set))
 #define AD_INTERFACE_DESC_SIZE                    9U
@@ -294,19 +319,48 @@ typedef struct
 
 typedef struct
 {
-    /* main buffer for audio data out transfers and its relative pointers */
-    uint8_t  isoc_out_buff[TOTAL_OUT_BUF_SIZE];
+    /* main buffer for audio data out transfers and its relative pointers. packets are received
+       in place at isoc_out_wrptr, the tail of a packet running past TOTAL_OUT_BUF_SIZE lands in
+       the spare room behind the ring and is moved to its start */
+    uint8_t  isoc_out_buff[TOTAL_OUT_BUF_SIZE + SPEAKER_OUT_MAX_PACKET];
     uint8_t* isoc_out_wrptr;
     uint8_t* isoc_out_rdptr;
-    uint16_t buf_free_size;
-    uint16_t dam_tx_len;
+
+    /* running byte counts of the speaker stream, each one written by a single context */
+    __IO uint32_t rx_total;                   /*!< bytes received, USB interrupt */
+    __IO uint32_t rd_total;                   /*!< bytes handed to the output, DMA interrupt */
+    __IO uint32_t play_total;                 /*!< bytes played and released, DMA interrupt */
+    __IO uint32_t i2s_chunks;                 /*!< chunks played including silence, DMA interrupt */
+
+    /* chunks queued on the output DMA and the ring bytes each one releases once played */
+    uint32_t chunk_release[2];
+    uint8_t  chunk_head;
+    uint8_t  chunk_queued;
+    uint8_t  rx_discard;
 
     __IO uint32_t actual_freq;
     __IO uint8_t play_flag;
-    uint8_t feedback_freq[3];
+    uint8_t feedback_freq[4];
     uint32_t cur_sam_freq;
 
-    /* usb receive buffer */
+    /* feedback loop state, rates in Q16 sample frames per SOF period */
+    uint32_t fb_sof_count;
+    uint32_t fb_i2s_mark;
+    uint32_t fb_rate;
+    uint32_t fb_value;
+    int32_t  fb_integral;
+
+    /* stream statistics */
+    uint32_t underrun_count;
+    uint32_t overrun_count;
+
+#ifdef USE_USB_AD_RESAMPLER
+    audio_resampler_struct resampler;
+    uint8_t  rs_out_buff[2][AD_OUT_CHUNK_SIZE];
+    uint8_t  rs_out_idx;
+#endif /* USE_USB_AD_RESAMPLER */
+
+    /* usb receive buffer, only used to drop packets the ring has no room for */
     uint8_t usb_rx_buffer[SPEAKER_OUT_MAX_PACKET];
 
     /* main buffer for audio control requests transfers and its relative variables */
@@ -319,4 +373,8 @@ extern usb_desc audio_desc;
 extern usb_class_core usbd_audio_cb;
 extern usbd_audio_handler audio_handler;
 
+/* function declarations */
+/* hand the next chunk of speaker data to the output DMA */
+uint8_t *usbd_audio_spk_next_chunk (void);
+
 #endif /* __AUDIO_CORE_H */
@@ -44,6 +44,7 @@ typedef struct {
     uint8_t  (*audio_init)        (uint32_t audio_freq, uint32_t volume);
     uint8_t  (*audio_deinit)      (void);
     uint8_t  (*audio_cmd)         (uint8_t* pbuf, uint32_t size, uint8_t cmd);
+    uint32_t (*audio_remain)      (void);
 } audio_fops_struct;
 
 extern audio_fops_struct audio_out_fops;
@@ -0,0 +1,49 @@
+/*!
+    \file    audio_resampler.h
+    \brief   fractional sample rate converter for the audio speaker path
+
+    \note    extension module of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __AUDIO_RESAMPLER_H
+#define __AUDIO_RESAMPLER_H
+
+#include "usbd_conf.h"
+
+/* interleaved channels of the converted stream */
+#ifndef AD_RS_CHANNELS
+#define AD_RS_CHANNELS                            SPEAKER_OUT_CHANNEL_NBR
+#endif /* AD_RS_CHANNELS */
+
+/* FIR taps per output sample and log2 of the number of polyphase branches, the
+   coefficient table in audio_resampler.c is generated for these values */
+#define AD_RS_TAPS                                16U
+#define AD_RS_PHASE_BITS                          5U
+#define AD_RS_PHASES                              (1U << AD_RS_PHASE_BITS)
+
+/* unity conversion ratio, input frames per output frame in Q2.30 */
+#define AD_RS_STEP_ONE                            (1UL << 30U)
+
+typedef struct
+{
+    /* input history of each channel, written twice so that the last AD_RS_TAPS
+       frames always sit contiguous at hist[ch][hist_idx] */
+    int16_t  hist[AD_RS_CHANNELS][2U * AD_RS_TAPS];
+    uint32_t hist_idx;
+
+    uint32_t pos;                             /*!< position between the last two input frames, Q2.30 */
+    uint32_t step;                            /*!< input frames consumed per output frame, Q2.30 */
+} audio_resampler_struct;
+
+/* function declarations */
+/* reset the converter to silence and unity ratio */
+void audio_resampler_init (audio_resampler_struct *rs);
+/* set the conversion ratio */
+void audio_resampler_ratio_set (audio_resampler_struct *rs, uint32_t step);
+/* convert a run of 16-bit interleaved frames */
+uint32_t audio_resampler_run (audio_resampler_struct *rs, const int16_t *in, uint32_t *in_frames, \
+                              int16_t *out, uint32_t out_frames);
+
+#endif /* __AUDIO_RESAMPLER_H */
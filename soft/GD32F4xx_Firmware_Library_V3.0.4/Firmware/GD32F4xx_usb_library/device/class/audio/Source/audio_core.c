@@ -55,6 +55,14 @@ extern const char wavetestdata[];
 
 __ALIGN_BEGIN usbd_audio_handler audio_handler __ALIGN_END;
 
+#ifdef USE_USB_AD_SPEAKER
+/* number of SOF periods between two feedback updates */
+#define AD_FB_PERIOD                 (1UL << FEEDBACK_IN_INTERVAL)
+
+/* played in place of stream data the host has not delivered in time */
+static __ALIGN_BEGIN uint8_t audio_silence[AD_OUT_CHUNK_SIZE] __ALIGN_END;
+#endif /* USE_USB_AD_SPEAKER */
+
 /* local function prototypes ('static') */
 static uint8_t audio_init (usb_dev *udev, uint8_t config_index);
 static uint8_t audio_deinit (usb_dev *udev, uint8_t config_index);
@@ -66,8 +74,16 @@ static uint8_t audio_data_out (usb_dev *udev, uint8_t ep_num);
 static uint8_t audio_sof (usb_dev *udev);
 static uint8_t audio_iso_in_incomplete (usb_dev *udev);
 static uint8_t audio_iso_out_incomplete (usb_dev *udev);
-static uint32_t usbd_audio_spk_get_feedback(usb_dev *udev);
-static void get_feedback_fs_rate(uint32_t rate, uint8_t *buf);
+#ifdef USE_USB_AD_SPEAKER
+static void audio_spk_reset (usb_dev *udev);
+static void audio_spk_rx_prepare (usb_dev *udev);
+static uint32_t audio_spk_i2s_position (uint32_t *level);
+static void audio_spk_feedback_update (usb_dev *udev);
+static void audio_spk_feedback_pack (usb_dev *udev, uint32_t value);
+#ifdef USE_USB_AD_RESAMPLER
+static uint8_t *audio_spk_resample (uint32_t *release);
+#endif /* USE_USB_AD_RESAMPLER */
+#endif /* USE_USB_AD_SPEAKER */
 
 usb_class_core usbd_audio_cb = {
     .init      = audio_init,
@@ -551,8 +567,7 @@ static uint8_t audio_init (usb_dev *udev, uint8_t config_index)
 
 #ifdef USE_USB_AD_SPEAKER
 {
-    audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
-    audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
+    audio_spk_reset(udev);
 
     usb_desc_std_ep std_ep = audio_config_set.speak_std_endpoint;
 
@@ -568,7 +583,7 @@ static uint8_t audio_init (usb_dev *udev, uint8_t config_index)
     usbd_ep_setup (udev, &ep1);
 
     /* prepare out endpoint to receive next audio packet */
-    usbd_ep_recev (udev, AD_OUT_EP, audio_handler.usb_rx_buffer, SPEAKER_OUT_MAX_PACKET);
+    audio_spk_rx_prepare(udev);
 
     /* initialize the audio output hardware layer */
     if (USBD_OK != audio_out_fops.audio_init(USBD_SPEAKER_FREQ, DEFAULT_VOLUME)) {
@@ -700,26 +715,33 @@ static uint8_t audio_set_intf(usb_dev *udev, usb_req *req)
 
     if(0xFF != req->wValue){
         if (req->wValue != 0){
+            /* stop audio output left running by a previous alternate setting */
+            if (0U != audio_handler.play_flag) {
+                audio_out_fops.audio_cmd(audio_handler.isoc_out_rdptr, AD_OUT_CHUNK_SIZE/2, AD_CMD_STOP);
+            }
+
             /* deinit audio handler */
             memset((void *)&audio_handler, 0, sizeof(usbd_audio_handler));
 
-            audio_handler.play_flag = 0;
-            audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
-            audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
+#ifdef USE_USB_AD_SPEAKER
+            /* restart the stream with the nominal rate as feedback */
+            audio_spk_reset(udev);
 
-            /* feedback calculate sample freq */
-            audio_handler.actual_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ);
-            get_feedback_fs_rate(audio_handler.actual_freq, audio_handler.feedback_freq);
+            /* the pending reception still points into the old stream */
+            audio_spk_rx_prepare(udev);
 
             /* send feedback data of estimated frequence*/
             usbd_ep_send(udev, AD_FEEDBACK_IN_EP, audio_handler.feedback_freq, FEEDBACK_IN_PACKET);
+#endif /* USE_USB_AD_SPEAKER */
         } else {
             /* stop audio output */
-            audio_out_fops.audio_cmd(audio_handler.isoc_out_rdptr, SPEAKER_OUT_PACKET/2, AD_CMD_STOP);
+            if (0U != audio_handler.play_flag) {
+                audio_out_fops.audio_cmd(audio_handler.isoc_out_rdptr, AD_OUT_CHUNK_SIZE/2, AD_CMD_STOP);
+            }
 
-            audio_handler.play_flag = 0;
-            audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
-            audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
+#ifdef USE_USB_AD_SPEAKER
+            audio_spk_reset(udev);
+#endif /* USE_USB_AD_SPEAKER */
 
             usbd_fifo_flush (udev, AD_IN_EP);
             usbd_fifo_flush (udev, AD_FEEDBACK_IN_EP);
@@ -783,10 +805,7 @@ static uint8_t audio_data_in (usb_dev *udev, uint8_t ep_num)
 
 #ifdef USE_USB_AD_SPEAKER
     if(ep_num == EP_ID(AD_FEEDBACK_IN_EP)){
-        /* calculate feedback actual freq */
-        audio_handler.actual_freq = usbd_audio_spk_get_feedback(udev);
-        get_feedback_fs_rate(audio_handler.actual_freq, audio_handler.feedback_freq);
-
+        /* the feedback value is refreshed by the SOF handler once per feedback period */
         usbd_ep_send(udev, AD_FEEDBACK_IN_EP, audio_handler.feedback_freq, FEEDBACK_IN_PACKET);
     }
 #endif /* USE_USB_AD_SPEAKER */
@@ -803,73 +822,51 @@ static uint8_t audio_data_in (usb_dev *udev, uint8_t ep_num)
 */
 static uint8_t audio_data_out (usb_dev *udev, uint8_t ep_num)
 {
-    uint16_t usb_rx_length, tail_len;
+#ifdef USE_USB_AD_SPEAKER
+    uint32_t usb_rx_length, tail_len;
 
     /* get receive length */
     usb_rx_length = ((usb_core_driver *)udev)->dev.transc_out[ep_num].xfer_count;
 
-    if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr){
-        audio_handler.buf_free_size = TOTAL_OUT_BUF_SIZE + audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    }else{
-        audio_handler.buf_free_size = audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    }
+    if (0U != audio_handler.rx_discard) {
+        audio_handler.overrun_count++;
+    } else if (0U != usb_rx_length) {
+        /* the packet has been received in place, only its part beyond the end of the ring moves */
+        audio_handler.isoc_out_wrptr += usb_rx_length;
 
-    /* free buffer enough to save rx data */
-    if(audio_handler.buf_free_size > usb_rx_length){
-        if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr){
-            tail_len = audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE - audio_handler.isoc_out_wrptr;
-
-            if(tail_len >= usb_rx_length){
-                memcpy(audio_handler.isoc_out_wrptr, audio_handler.usb_rx_buffer, usb_rx_length);
-
-                /* increment the buffer pointer */
-                audio_handler.isoc_out_wrptr += usb_rx_length;
-
-                /* increment the Buffer pointer or roll it back when all buffers are full */
-                if(audio_handler.isoc_out_wrptr >= (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE)){
-                    /* all buffers are full: roll back */
-                    audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
-                }
-            }else{
-                memcpy(audio_handler.isoc_out_wrptr, audio_handler.usb_rx_buffer, tail_len);
-                /* adjust write pointer */
-                audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
-
-                memcpy(audio_handler.isoc_out_wrptr, &audio_handler.usb_rx_buffer[tail_len], usb_rx_length - tail_len);
-                /* adjust write pointer */
-                audio_handler.isoc_out_wrptr += usb_rx_length - tail_len;
-            }
-        }else{
-            memcpy(audio_handler.isoc_out_wrptr, audio_handler.usb_rx_buffer, usb_rx_length);
+        if (audio_handler.isoc_out_wrptr >= (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE)) {
+            tail_len = (uint32_t)(audio_handler.isoc_out_wrptr - (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE));
+
+            memcpy(audio_handler.isoc_out_buff, audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE, tail_len);
 
-            /* increment the buffer pointer */
-            audio_handler.isoc_out_wrptr += usb_rx_length;
+            /* roll back to the start of buffer */
+            audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff + tail_len;
         }
+
+        audio_handler.rx_total += usb_rx_length;
+    } else {
+        /* zero length packet, nothing to store */
     }
 
     /* Toggle the frame index */  
     udev->dev.transc_out[ep_num].frame_num = (udev->dev.transc_out[ep_num].frame_num)? 0U:1U;
 
     /* prepare out endpoint to receive next audio packet */
-    usbd_ep_recev (udev, AD_OUT_EP, audio_handler.usb_rx_buffer, SPEAKER_OUT_MAX_PACKET);
-
-    if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr){
-        audio_handler.buf_free_size = TOTAL_OUT_BUF_SIZE + audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    }else{
-        audio_handler.buf_free_size = audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    }
+    audio_spk_rx_prepare(udev);
 
-    if ((0U == audio_handler.play_flag) && (audio_handler.buf_free_size < TOTAL_OUT_BUF_SIZE/2)) {
-        /* enable start of streaming */
+    if ((0U == audio_handler.play_flag) && \
+        ((audio_handler.rx_total - audio_handler.play_total) >= AD_OUT_TARGET_LEVEL)) {
+        /* enable start of streaming, the feedback period starts with the first chunk */
         audio_handler.play_flag = 1U;
+        audio_handler.fb_sof_count = 0U;
+        audio_handler.fb_i2s_mark = 0U;
 
         /* initialize the audio output hardware layer */
-        if (USBD_OK != audio_out_fops.audio_cmd(audio_handler.isoc_out_rdptr, SPEAKER_OUT_MAX_PACKET/2, AD_CMD_PLAY)) {
+        if (USBD_OK != audio_out_fops.audio_cmd(usbd_audio_spk_next_chunk(), AD_OUT_CHUNK_SIZE/2, AD_CMD_PLAY)) {
             return USBD_FAIL;
         }
-
-        audio_handler.dam_tx_len = SPEAKER_OUT_MAX_PACKET;
     }
+#endif /* USE_USB_AD_SPEAKER */
 
     return USBD_OK;
 }
@@ -882,6 +879,17 @@ static uint8_t audio_data_out (usb_dev *udev, uint8_t ep_num)
 */
 static uint8_t audio_sof (usb_dev *udev)
 {
+#ifdef USE_USB_AD_SPEAKER
+    if (0U != audio_handler.play_flag) {
+        /* measure the I2S clock against the host clock once per feedback period */
+        if (++audio_handler.fb_sof_count >= AD_FB_PERIOD) {
+            audio_handler.fb_sof_count = 0U;
+
+            audio_spk_feedback_update(udev);
+        }
+    }
+#endif /* USE_USB_AD_SPEAKER */
+
     return USBD_OK;
 }
 
@@ -893,13 +901,12 @@ static uint8_t audio_sof (usb_dev *udev)
 */
 static uint8_t audio_iso_in_incomplete (usb_dev *udev)
 {
+#ifdef USE_USB_AD_SPEAKER
     (void)usb_txfifo_flush (&udev->regs, EP_ID(AD_FEEDBACK_IN_EP));
 
-    audio_handler.actual_freq = usbd_audio_spk_get_feedback(udev);
-    get_feedback_fs_rate(audio_handler.actual_freq, audio_handler.feedback_freq);
-
     /* send feedback data of estimated frequence*/
     usbd_ep_send(udev, AD_FEEDBACK_IN_EP, audio_handler.feedback_freq, FEEDBACK_IN_PACKET);
+#endif /* USE_USB_AD_SPEAKER */
 
     return USBD_OK;
 }
@@ -915,47 +922,287 @@ static uint8_t audio_iso_out_incomplete (usb_dev *udev)
     return USBD_OK;
 }
 
+#ifdef USE_USB_AD_SPEAKER
+
+/*!
+    \brief      hand the next chunk of speaker data to the output DMA
+    \param[in]  none
+    \param[out] none
+    \retval     pointer to the AD_OUT_CHUNK_SIZE bytes to be played next
+    \note       the output layer keeps two chunks queued on its DMA. it calls this function
+                twice when playing starts, then once from its DMA interrupt each time a chunk
+                has been played out. the DMA interrupt must be allowed to preempt the USB one
+*/
+uint8_t *usbd_audio_spk_next_chunk (void)
+{
+    uint8_t *chunk;
+    uint32_t release = 0U;
+
+    if (audio_handler.chunk_queued >= 2U) {
+        /* the older of the two queued chunks has just been played out */
+        audio_handler.play_total += audio_handler.chunk_release[audio_handler.chunk_head];
+        audio_handler.i2s_chunks++;
+
+        audio_handler.chunk_head ^= 1U;
+        audio_handler.chunk_queued--;
+    }
+
+#ifdef USE_USB_AD_RESAMPLER
+    chunk = audio_spk_resample(&release);
+#else
+    if ((audio_handler.rx_total - audio_handler.rd_total) >= AD_OUT_CHUNK_SIZE) {
+        /* play straight from the ring, the bytes stay reserved until the chunk is played */
+        chunk = audio_handler.isoc_out_rdptr;
+
+        audio_handler.isoc_out_rdptr += AD_OUT_CHUNK_SIZE;
+
+        if (audio_handler.isoc_out_rdptr >= (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE)) {
+            /* roll back to the start of buffer */
+            audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
+        }
+
+        audio_handler.rd_total += AD_OUT_CHUNK_SIZE;
+        release = AD_OUT_CHUNK_SIZE;
+    } else {
+        /* keep the I2S clock running on silence until the host catches up */
+        chunk = audio_silence;
+
+        audio_handler.underrun_count++;
+    }
+#endif /* USE_USB_AD_RESAMPLER */
+
+    audio_handler.chunk_release[(audio_handler.chunk_head + audio_handler.chunk_queued) & 1U] = release;
+    audio_handler.chunk_queued++;
+
+    return chunk;
+}
+
+/*!
+    \brief      reset the speaker stream to an empty buffer and the nominal rate
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     none
+*/
+static void audio_spk_reset (usb_dev *udev)
+{
+    uint32_t sof_rate = (USB_SPEED_HIGH == udev->bp.core_speed) ? 8000U : 1000U;
+
+    audio_handler.play_flag = 0U;
+    audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
+    audio_handler.isoc_out_wrptr = audio_handler.isoc_out_buff;
+
+    audio_handler.rx_total = 0U;
+    audio_handler.rd_total = 0U;
+    audio_handler.play_total = 0U;
+    audio_handler.i2s_chunks = 0U;
+    audio_handler.chunk_head = 0U;
+    audio_handler.chunk_queued = 0U;
+
+    audio_handler.fb_sof_count = 0U;
+    audio_handler.fb_i2s_mark = 0U;
+    audio_handler.fb_integral = 0;
+
+    /* feedback calculate sample freq */
+    audio_handler.actual_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ);
+    audio_handler.fb_rate = (uint32_t)(((uint64_t)audio_handler.actual_freq << 16U) / sof_rate);
+    audio_handler.fb_value = audio_handler.fb_rate;
+
+    audio_spk_feedback_pack(udev, audio_handler.fb_value);
+
+#ifdef USE_USB_AD_RESAMPLER
+    audio_resampler_init(&audio_handler.resampler);
+    audio_handler.rs_out_idx = 0U;
+#endif /* USE_USB_AD_RESAMPLER */
+}
+
+/*!
+    \brief      prepare the OUT endpoint to receive the next audio packet
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     none
+*/
+static void audio_spk_rx_prepare (usb_dev *udev)
+{
+    if ((audio_handler.rx_total - audio_handler.play_total + SPEAKER_OUT_MAX_PACKET) <= TOTAL_OUT_BUF_SIZE) {
+        audio_handler.rx_discard = 0U;
+
+        /* receive straight into the ring */
+        usbd_ep_recev (udev, AD_OUT_EP, audio_handler.isoc_out_wrptr, SPEAKER_OUT_MAX_PACKET);
+    } else {
+        audio_handler.rx_discard = 1U;
+
+        /* no room left for a whole packet, receive it aside and drop it */
+        usbd_ep_recev (udev, AD_OUT_EP, audio_handler.usb_rx_buffer, SPEAKER_OUT_MAX_PACKET);
+    }
+}
+
+/*!
+    \brief      get the number of bytes played by the I2S since playing started
+    \param[in]  none
+    \param[out] level: bytes received and not played yet
+    \retval     play position in bytes
+*/
+static uint32_t audio_spk_i2s_position (uint32_t *level)
+{
+    uint32_t chunks, remain, played, release;
+
+    /* read again if a chunk completed in between */
+    do {
+        chunks = audio_handler.i2s_chunks;
+        played = audio_handler.play_total;
+        release = audio_handler.chunk_release[audio_handler.chunk_head];
+        remain = audio_out_fops.audio_remain();
+    } while (chunks != audio_handler.i2s_chunks);
+
+    /* count the chunk being played by the part already sent, so that the level
+       does not step by a whole chunk as chunks complete */
+    *level = audio_handler.rx_total - played - ((release * (AD_OUT_CHUNK_SIZE - remain)) / AD_OUT_CHUNK_SIZE);
+
+    return ((chunks + 1U) * AD_OUT_CHUNK_SIZE) - remain;
+}
+
 /*!
-    \brief      calculate feedback sample frequency
+    \brief      update the feedback value at the end of a feedback period
     \param[in]  udev: pointer to USB device instance
     \param[out] none
-    \retval     feedback frequency value
+    \retval     none
 */
-static uint32_t usbd_audio_spk_get_feedback(usb_dev *udev)
+static void audio_spk_feedback_update (usb_dev *udev)
 {
-    static uint32_t fb_freq;
+    uint32_t sof_rate = (USB_SPEED_HIGH == udev->bp.core_speed) ? 8000U : 1000U;
+    int32_t nominal = (int32_t)(((uint64_t)I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ) << 16U) / sof_rate);
+    int32_t limit = (int32_t)(((uint64_t)FEEDBACK_FREQ_OFFSET << 16U) / sof_rate);
+    int32_t rate, error, correct;
+    uint32_t level, position = audio_spk_i2s_position(&level);
+
+    /* I2S rate over the period just ended, in Q16 sample frames per SOF period */
+    rate = (int32_t)(((uint64_t)(position - audio_handler.fb_i2s_mark) << (16U - FEEDBACK_IN_INTERVAL)) / AD_OUT_FRAME_SIZE);
+    audio_handler.fb_i2s_mark = position;
+
+    /* smooth the measure, a period disturbed by a stall of the output says nothing about the clock */
+    if ((rate > (nominal - limit)) && (rate < (nominal + limit))) {
+        audio_handler.fb_rate = (uint32_t)((int32_t)audio_handler.fb_rate + ((rate - (int32_t)audio_handler.fb_rate) / 4));
+    }
 
-    /* calculate buffer free size */
-    if(audio_handler.isoc_out_wrptr >= audio_handler.isoc_out_rdptr){
-        audio_handler.buf_free_size = TOTAL_OUT_BUF_SIZE + audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
-    }else{
-        audio_handler.buf_free_size = audio_handler.isoc_out_rdptr - audio_handler.isoc_out_wrptr;
+    /* fill level error in sample frames, positive while the buffer runs low */
+    error = ((int32_t)AD_OUT_TARGET_LEVEL - (int32_t)level) / (int32_t)AD_OUT_FRAME_SIZE;
+
+    /* integrate, but never beyond what the integral term alone may correct */
+    audio_handler.fb_integral += error;
+
+    if (audio_handler.fb_integral > (limit >> AD_FB_KI_SHIFT)) {
+        audio_handler.fb_integral = limit >> AD_FB_KI_SHIFT;
+    } else if (audio_handler.fb_integral < -(limit >> AD_FB_KI_SHIFT)) {
+        audio_handler.fb_integral = -(limit >> AD_FB_KI_SHIFT);
+    } else {
+        /* within bounds */
     }
 
-    /* calculate feedback frequency */
-    if(audio_handler.buf_free_size <= (TOTAL_OUT_BUF_SIZE/4)){
-        fb_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ) - FEEDBACK_FREQ_OFFSET;
-    }else if(audio_handler.buf_free_size >= (TOTAL_OUT_BUF_SIZE*3/4)){
-        fb_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ) + FEEDBACK_FREQ_OFFSET;
-    }else{
-        fb_freq = I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ);
+    correct = (error * (int32_t)(1UL << AD_FB_KP_SHIFT)) + (audio_handler.fb_integral * (int32_t)(1UL << AD_FB_KI_SHIFT));
+
+    if (correct > limit) {
+        correct = limit;
+    } else if (correct < -limit) {
+        correct = -limit;
+    } else {
+        /* within bounds */
     }
 
-    return fb_freq;
+#ifdef USE_USB_AD_RESAMPLER
+    /* report the plain I2S rate, the converter drains the buffer faster or slower
+       for hosts which do not follow the feedback */
+    audio_handler.fb_value = audio_handler.fb_rate;
+
+    audio_resampler_ratio_set(&audio_handler.resampler, \
+                              (uint32_t)((int64_t)AD_RS_STEP_ONE - (((int64_t)correct * (int64_t)AD_RS_STEP_ONE) / (int64_t)audio_handler.fb_rate)));
+#else
+    audio_handler.fb_value = (uint32_t)((int32_t)audio_handler.fb_rate + correct);
+#endif /* USE_USB_AD_RESAMPLER */
+
+    audio_handler.actual_freq = (uint32_t)(((uint64_t)audio_handler.fb_value * sof_rate) >> 16U);
+
+    audio_spk_feedback_pack(udev, audio_handler.fb_value);
 }
 
 /*!
-    \brief      get feedback value from rate in USB full speed
-    \param[in]  rate: sample frequence
-    \param[in]  buf: pointer to result buffer
+    \brief      convert a rate to the feedback endpoint format
+    \param[in]  udev: pointer to USB device instance
+    \param[in]  value: rate in Q16 sample frames per SOF period
     \param[out] none
-    \retval     USB device operation status
+    \retval     none
+    \note       full speed uses 10.14 in 3 bytes, high speed 16.16 in 4 bytes, which needs
+                FEEDBACK_IN_PACKET set to 4
 */
-static void get_feedback_fs_rate(uint32_t rate, uint8_t *buf)
+static void audio_spk_feedback_pack (usb_dev *udev, uint32_t value)
 {
-    rate = ((rate / 1000) << 14) | ((rate % 1000) << 4);
+    if (USB_SPEED_HIGH == udev->bp.core_speed) {
+        audio_handler.feedback_freq[3] = (uint8_t)(value >> 24U);
+    } else {
+        value >>= 2U;
+    }
 
-    buf[0] = rate;
-    buf[1] = rate >> 8;
-    buf[2] = rate >> 16;
+    audio_handler.feedback_freq[0] = (uint8_t)value;
+    audio_handler.feedback_freq[1] = (uint8_t)(value >> 8U);
+    audio_handler.feedback_freq[2] = (uint8_t)(value >> 16U);
 }
+
+#ifdef USE_USB_AD_RESAMPLER
+
+/*!
+    \brief      convert the next chunk of speaker data to the I2S rate
+    \param[in]  none
+    \param[out] release: ring bytes consumed, to be released once the chunk is played
+    \retval     pointer to the converted chunk
+*/
+static uint8_t *audio_spk_resample (uint32_t *release)
+{
+    int16_t *out = (int16_t *)audio_handler.rs_out_buff[audio_handler.rs_out_idx];
+    uint32_t want = AD_OUT_CHUNK_SIZE / AD_OUT_FRAME_SIZE;
+    uint32_t avail = (audio_handler.rx_total - audio_handler.rd_total) / AD_OUT_FRAME_SIZE;
+    uint32_t done = 0U, used, consumed = 0U;
+
+    /* the ratio stays within a few percent of unity, ask for some margin */
+    if (avail <= (want + (want >> 4U) + 1U)) {
+        audio_handler.underrun_count++;
+
+        return audio_silence;
+    }
+
+    while (done < want) {
+        /* frames up to the end of the ring */
+        used = (TOTAL_OUT_BUF_SIZE - (uint32_t)(audio_handler.isoc_out_rdptr - audio_handler.isoc_out_buff)) / AD_OUT_FRAME_SIZE;
+
+        if (used > avail) {
+            used = avail;
+        }
+
+        done += audio_resampler_run(&audio_handler.resampler, (const int16_t *)audio_handler.isoc_out_rdptr, &used, \
+                                    &out[done * AD_RS_CHANNELS], want - done);
+
+        avail -= used;
+        consumed += used * AD_OUT_FRAME_SIZE;
+        audio_handler.isoc_out_rdptr += used * AD_OUT_FRAME_SIZE;
+
+        if (audio_handler.isoc_out_rdptr >= (audio_handler.isoc_out_buff + TOTAL_OUT_BUF_SIZE)) {
+            /* roll back to the start of buffer */
+            audio_handler.isoc_out_rdptr = audio_handler.isoc_out_buff;
+        }
+
+        if ((0U == used) && (done < want)) {
+            /* out of input, cannot happen with the margin above */
+            memset((void *)&out[done * AD_RS_CHANNELS], 0, (want - done) * AD_OUT_FRAME_SIZE);
+            break;
+        }
+    }
+
+    audio_handler.rd_total += consumed;
+    *release = consumed;
+
+    audio_handler.rs_out_idx ^= 1U;
+
+    return (uint8_t *)out;
+}
+
+#endif /* USE_USB_AD_RESAMPLER */
+
+#endif /* USE_USB_AD_SPEAKER */
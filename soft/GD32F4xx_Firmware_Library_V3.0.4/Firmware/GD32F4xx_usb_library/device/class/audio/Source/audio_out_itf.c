@@ -41,6 +41,7 @@ OF SUCH DAMAGE.
 static uint8_t init (uint32_t audio_freq, uint32_t volume);
 static uint8_t deinit (void);
 static uint8_t audio_cmd (uint8_t* pbuf, uint32_t size, uint8_t cmd);
+static uint32_t audio_remain (void);
 
 /* local variable defines */
 static uint8_t audio_state = AD_STATE_INACTIVE;
@@ -50,6 +51,7 @@ audio_fops_struct audio_out_fops =
     .audio_init   = init,
     .audio_deinit = deinit,
     .audio_cmd    = audio_cmd,
+    .audio_remain = audio_remain,
 };
 
 /*!
@@ -168,3 +170,15 @@ static uint8_t audio_cmd (uint8_t* pbuf, uint32_t size, uint8_t cmd)
         return AD_FAIL;
     }
 }
+
+/*!
+    \brief      get the part of the current chunk still to be played
+    \param[in]  none
+    \param[out] none
+    \retval     number of bytes the output has not sent yet from the chunk it is playing
+*/
+static uint32_t audio_remain (void)
+{
+    /* the DMA counts 16-bit transfers */
+    return audio_dma_remain() * 2U;
+}
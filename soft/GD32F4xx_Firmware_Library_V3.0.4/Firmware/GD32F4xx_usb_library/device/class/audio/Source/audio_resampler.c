@@ -0,0 +1,201 @@
+/*!
+    \file    audio_resampler.c
+    \brief   fractional sample rate converter for the audio speaker path
+
+    \note    extension module of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#include "audio_resampler.h"
+#include <string.h>
+
+#if (AD_RS_TAPS != 16U) || (AD_RS_PHASES != 32U)
+    #error "the coefficient table is generated for 16 taps and 32 phases"
+#endif
+
+/* Kaiser windowed sinc (beta 7, cutoff 0.88 of the input Nyquist frequency) in Q15,
+   row p delays the input by p/32 frame, row 32 repeats row 0 one frame later so
+   that any position can be interpolated between two neighbouring rows. each row
+   sums to 32767, the taps of a row are contiguous for 16-bit dual MAC loads */
+static const int16_t rs_coef[AD_RS_PHASES + 1U][AD_RS_TAPS] = 
+{
+    {29, -156, 486, -1098, 1964, -2907, 3649, 28834, 3649, -2907, 1964, -1098, 486, -156, 29, -1},
+    {32, -161, 485, -1064, 1838, -2571, 2745, 28797, 4588, -3234, 2078, -1125, 483, -149, 25, 0},
+    {34, -164, 481, -1023, 1704, -2231, 1880, 28682, 5559, -3550, 2181, -1143, 476, -140, 21, 0},
+    {36, -166, 472, -976, 1562, -1888, 1055, 28497, 6558, -3853, 2271, -1153, 464, -129, 16, 1},
+    {37, -167, 460, -923, 1413, -1545, 273, 28240, 7582, -4139, 2346, -1154, 448, -117, 11, 2},
+    {38, -165, 445, -866, 1259, -1205, -463, 27911, 8626, -4405, 2405, -1146, 427, -103, 5, 4},
+    {38, -163, 427, -804, 1102, -870, -1152, 27511, 9688, -4648, 2447, -1128, 401, -86, -1, 5},
+    {38, -159, 407, -738, 943, -542, -1792, 27040, 10761, -4865, 2472, -1099, 371, -69, -8, 7},
+    {37, -154, 384, -670, 783, -224, -2381, 26508, 11843, -5055, 2478, -1061, 336, -49, -16, 8},
+    {37, -148, 360, -599, 624, 82, -2919, 25908, 12928, -5213, 2464, -1012, 296, -27, -24, 10},
+    {36, -142, 333, -527, 466, 376, -3406, 25252, 14012, -5337, 2429, -953, 252, -4, -32, 12},
+    {34, -134, 306, -453, 310, 654, -3840, 24536, 15090, -5424, 2374, -883, 204, 20, -41, 14},
+    {33, -126, 277, -380, 159, 915, -4222, 23768, 16158, -5473, 2298, -803, 151, 46, -50, 16},
+    {31, -117, 248, -307, 13, 1159, -4551, 22949, 17211, -5480, 2199, -713, 94, 73, -60, 18},
+    {29, -108, 219, -235, -127, 1384, -4829, 22084, 18243, -5444, 2079, -614, 34, 101, -69, 20},
+    {27, -99, 189, -164, -261, 1589, -5056, 21176, 19252, -5362, 1937, -505, -29, 130, -79, 22},
+    {25, -89, 159, -95, -387, 1774, -5234, 20230, 20231, -5234, 1774, -387, -95, 159, -89, 25},
+    {22, -79, 130, -29, -505, 1937, -5362, 19252, 21176, -5056, 1589, -261, -164, 189, -99, 27},
+    {20, -69, 101, 34, -614, 2079, -5444, 18243, 22084, -4829, 1384, -127, -235, 219, -108, 29},
+    {18, -60, 73, 94, -713, 2199, -5480, 17211, 22949, -4551, 1159, 13, -307, 248, -117, 31},
+    {16, -50, 46, 151, -803, 2298, -5473, 16158, 23768, -4222, 915, 159, -380, 277, -126, 33},
+    {14, -41, 20, 204, -883, 2374, -5424, 15090, 24536, -3840, 654, 310, -453, 306, -134, 34},
+    {12, -32, -4, 252, -953, 2429, -5337, 14012, 25252, -3406, 376, 466, -527, 333, -142, 36},
+    {10, -24, -27, 296, -1012, 2464, -5213, 12928, 25908, -2919, 82, 624, -599, 360, -148, 37},
+    {8, -16, -49, 336, -1061, 2478, -5055, 11843, 26508, -2381, -224, 783, -670, 384, -154, 37},
+    {7, -8, -69, 371, -1099, 2472, -4865, 10761, 27040, -1792, -542, 943, -738, 407, -159, 38},
+    {5, -1, -86, 401, -1128, 2447, -4648, 9688, 27511, -1152, -870, 1102, -804, 427, -163, 38},
+    {4, 5, -103, 427, -1146, 2405, -4405, 8626, 27911, -463, -1205, 1259, -866, 445, -165, 38},
+    {2, 11, -117, 448, -1154, 2346, -4139, 7582, 28240, 273, -1545, 1413, -923, 460, -167, 37},
+    {1, 16, -129, 464, -1153, 2271, -3853, 6558, 28497, 1055, -1888, 1562, -976, 472, -166, 36},
+    {0, 21, -140, 476, -1143, 2181, -3550, 5559, 28682, 1880, -2231, 1704, -1023, 481, -164, 34},
+    {0, 25, -149, 483, -1125, 2078, -3234, 4588, 28797, 2745, -2571, 1838, -1064, 485, -161, 32},
+    {-1, 29, -156, 486, -1098, 1964, -2907, 3649, 28834, 3649, -2907, 1964, -1098, 486, -156, 29}
+};
+
+/* local function prototypes ('static') */
+static void rs_push (audio_resampler_struct *rs, const int16_t *frame);
+static int32_t rs_dot (const int16_t *coef, const int16_t *x);
+static int16_t rs_sat16 (int32_t value);
+
+/*!
+    \brief      reset the converter to silence and unity ratio
+    \param[in]  rs: pointer to the converter instance
+    \param[out] none
+    \retval     none
+*/
+void audio_resampler_init (audio_resampler_struct *rs)
+{
+    memset((void *)rs, 0, sizeof(audio_resampler_struct));
+
+    rs->step = AD_RS_STEP_ONE;
+}
+
+/*!
+    \brief      set the conversion ratio
+    \param[in]  rs: pointer to the converter instance
+    \param[in]  step: input frames consumed per output frame in Q2.30, AD_RS_STEP_ONE
+                keeps the rate, larger values drain the input faster
+    \param[out] none
+    \retval     none
+*/
+void audio_resampler_ratio_set (audio_resampler_struct *rs, uint32_t step)
+{
+    rs->step = step;
+}
+
+/*!
+    \brief      convert a run of 16-bit interleaved frames
+    \param[in]  rs: pointer to the converter instance
+    \param[in]  in: input frames
+    \param[in]  in_frames: number of frames available at in
+    \param[out] in_frames: number of frames consumed from in
+    \param[out] out: output frames
+    \param[in]  out_frames: number of frames wanted at out
+    \retval     number of frames written to out, less than out_frames only when the
+                input ran out, the next call then carries on where this one stopped
+*/
+uint32_t audio_resampler_run (audio_resampler_struct *rs, const int16_t *in, uint32_t *in_frames, \
+                              int16_t *out, uint32_t out_frames)
+{
+    uint32_t used = 0U, done = 0U;
+
+    while (done < out_frames) {
+        /* move the history up to the input frame preceding the output position */
+        while ((rs->pos >= AD_RS_STEP_ONE) && (used < *in_frames)) {
+            rs_push(rs, &in[used * AD_RS_CHANNELS]);
+
+            rs->pos -= AD_RS_STEP_ONE;
+            used++;
+        }
+
+        if (rs->pos >= AD_RS_STEP_ONE) {
+            break;
+        }
+
+        {
+            /* the top bits of the position select the branch, the next 15 bits
+               interpolate linearly towards the following branch */
+            const int16_t *c0 = rs_coef[rs->pos >> (30U - AD_RS_PHASE_BITS)];
+            const int16_t *c1 = c0 + AD_RS_TAPS;
+            int32_t mu = (int32_t)((rs->pos >> (15U - AD_RS_PHASE_BITS)) & 0x7FFFU);
+            uint32_t ch;
+
+            for (ch = 0U; ch < AD_RS_CHANNELS; ch++) {
+                const int16_t *x = &rs->hist[ch][rs->hist_idx];
+                int32_t y0 = rs_dot(c0, x);
+                int32_t y1 = rs_dot(c1, x);
+
+                y0 += (int32_t)(((int64_t)(y1 - y0) * mu) >> 15);
+
+                *out++ = rs_sat16((y0 + (1 << 14)) >> 15);
+            }
+        }
+
+        rs->pos += rs->step;
+        done++;
+    }
+
+    *in_frames = used;
+
+    return done;
+}
+
+/*!
+    \brief      append one input frame to the history
+    \param[in]  rs: pointer to the converter instance
+    \param[in]  frame: interleaved samples of the frame
+    \param[out] none
+    \retval     none
+*/
+static void rs_push (audio_resampler_struct *rs, const int16_t *frame)
+{
+    uint32_t ch, idx = rs->hist_idx;
+
+    for (ch = 0U; ch < AD_RS_CHANNELS; ch++) {
+        rs->hist[ch][idx] = frame[ch];
+        rs->hist[ch][idx + AD_RS_TAPS] = frame[ch];
+    }
+
+    rs->hist_idx = (idx + 1U) % AD_RS_TAPS;
+}
+
+/*!
+    \brief      dot product of one branch with the history
+    \param[in]  coef: branch coefficients in Q15
+    \param[in]  x: oldest of AD_RS_TAPS contiguous history samples
+    \param[out] none
+    \retval     Q30 result
+    \note       taps are consumed in pairs of 16-bit products summed into one 32-bit
+                accumulator, which cores with the DSP extension issue as SMLAD
+*/
+static int32_t rs_dot (const int16_t *coef, const int16_t *x)
+{
+    int32_t acc = 0;
+    uint32_t i;
+
+    for (i = 0U; i < AD_RS_TAPS; i += 2U) {
+        acc += ((int32_t)coef[i] * x[i]) + ((int32_t)coef[i + 1U] * x[i + 1U]);
+    }
+
+    return acc;
+}
+
+/*!
+    \brief      saturate a value to 16 bits
+    \param[in]  value: value to saturate
+    \param[out] none
+    \retval     saturated value
+*/
+static int16_t rs_sat16 (int32_t value)
+{
+    if (value > 32767) {
+        value = 32767;
+    } else if (value < -32768) {
+        value = -32768;
+    }
+
+    return (int16_t)value;
+}
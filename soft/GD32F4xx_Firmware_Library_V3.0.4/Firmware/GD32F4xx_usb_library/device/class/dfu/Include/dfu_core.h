@@ -166,6 +166,9 @@ typedef struct
     uint16_t block_num;
     uint32_t base_addr;
 
+    uint8_t *data_buf;
+    uint8_t sof_count;
+
     uint8_t buf[TRANSFER_SIZE];
 } usbd_dfu_handler;
 
@@ -52,14 +52,44 @@ typedef struct _dfu_mem_prop
 
     const uint32_t erase_timeout;
     const uint32_t write_timeout;
+
+    /* optional background operations, left NULL by media which erase synchronously */
+    uint8_t  (*mem_erase_start) (uint32_t addr);
+    uint8_t  (*mem_op_status)   (void);
+    uint32_t (*mem_sector_get)  (uint32_t addr, uint32_t *base);
 } dfu_mem_prop;
 
 typedef enum
 {
     MEM_OK = 0,
-    MEM_FAIL
+    MEM_FAIL,
+    MEM_BUSY
 } mem_status;
 
+/* background operation errors */
+#define MEM_ERR_NONE              0x00U                               /*!< no error */
+#define MEM_ERR_ERASE             0x01U                               /*!< sector erase failed */
+#define MEM_ERR_PROG              0x02U                               /*!< programming failed */
+#define MEM_ERR_VERIFY            0x03U                               /*!< block CRC mismatch after programming */
+
+#ifndef DFU_BLOCK_QUEUE_NUM
+#define DFU_BLOCK_QUEUE_NUM       2U                                  /*!< download blocks buffered ahead of programming */
+#endif
+
+#ifndef DFU_ERASE_QUEUE_NUM
+#define DFU_ERASE_QUEUE_NUM       32U                                 /*!< sector erases deferred ahead of programming (at most 32) */
+#endif
+
+#ifndef DFU_PROG_STEP_SIZE
+#define DFU_PROG_STEP_SIZE        256U                                /*!< bytes programmed per 1 ms background step */
+#endif
+
+#ifndef DFU_ERASE_TIMEOUT_UNIT
+#define DFU_ERASE_TIMEOUT_UNIT    0x4000U                             /*!< sector size the erase_timeout of a media is given for */
+#endif
+
+#define DFU_MEM_DRAIN             0xFFU                               /*!< wait for all queued operations to complete */
+
 #define _1ST_BYTE(x)              (uint8_t)((x) & 0xFF)               /*!< addressing cycle 1st byte */
 #define _2ND_BYTE(x)              (uint8_t)(((x) & 0xFF00) >> 8)      /*!< addressing cycle 2nd byte */
 #define _3RD_BYTE(x)              (uint8_t)(((x) & 0xFF0000) >> 16)   /*!< addressing cycle 3rd byte */
@@ -81,5 +111,19 @@ uint8_t dfu_mem_write(uint8_t *buf, uint32_t addr, uint32_t len);
 uint8_t* dfu_mem_read(uint8_t *buf, uint32_t addr, uint32_t len);
 /* get the status of a given memory and store in buffer */
 uint8_t dfu_mem_getstatus(uint32_t addr, uint8_t cmd, uint8_t *buffer);
+/* get the buffer the next download block is received into */
+uint8_t* dfu_mem_block_get(void);
+/* queue a received download block for background programming */
+uint8_t dfu_mem_block_put(uint8_t *buf, uint32_t addr, uint32_t len);
+/* queue a sector erase to be run ahead of programming */
+uint8_t dfu_mem_erase_post(uint32_t addr);
+/* estimate the time until the given number of block buffers are free */
+uint32_t dfu_mem_busy_time(uint8_t slots);
+/* run the background erase and programming for one 1 ms step */
+void dfu_mem_process(void);
+/* complete all queued erase and programming operations */
+void dfu_mem_flush(void);
+/* get and clear the error of the background operations */
+uint8_t dfu_mem_error_get(void);
 
 #endif /* __DFU_MEM_H */
@@ -47,6 +47,7 @@ static uint8_t dfu_init(usb_dev *udev, uint8_t config_index);
 static uint8_t dfu_deinit(usb_dev *udev, uint8_t config_index);
 static uint8_t dfu_req_handler(usb_dev *udev, usb_req *req);
 static uint8_t dfu_ctlx_in(usb_dev *udev);
+static uint8_t dfu_sof(usb_dev *udev);
 
 static void dfu_mode_leave(usb_dev *udev);
 static uint8_t dfu_getstatus_complete (usb_dev *udev);
@@ -61,6 +62,7 @@ static void dfu_getstate(usb_dev *udev, usb_req *req);
 static void dfu_abort(usb_dev *udev, usb_req *req);
 
 static void string_to_unicode (uint8_t *str, uint16_t *pbuf);
+static void dfu_poll_timeout_set (usbd_dfu_handler *dfu, uint32_t timeout);
 
 static void (*dfu_request_process[])(usb_dev *udev, usb_req *req) = 
 {
@@ -282,7 +284,8 @@ usb_class_core dfu_class = {
     .init            = dfu_init,
     .deinit          = dfu_deinit,
     .req_proc        = dfu_req_handler,
-    .ctlx_in         = dfu_ctlx_in
+    .ctlx_in         = dfu_ctlx_in,
+    .SOF             = dfu_sof
 };
 
 /*!
@@ -369,6 +372,32 @@ static uint8_t dfu_ctlx_in (usb_dev *udev)
     return USBD_OK;
 }
 
+/*!
+    \brief      handle the SOF event, running the background flash work
+    \param[in]  udev: pointer to USB device instance
+    \param[out] none
+    \retval     USB device operation status
+*/
+static uint8_t dfu_sof (usb_dev *udev)
+{
+    usbd_dfu_handler *dfu = (usbd_dfu_handler *)udev->dev.class_data[USBD_DFU_INTERFACE];
+
+    if (NULL == dfu) {
+        return USBD_OK;
+    }
+
+    /* the flash work is stepped once per 1 ms frame, not per high speed microframe */
+    if (USB_SPEED_HIGH == udev->bp.core_speed) {
+        if (0U != ((dfu->sof_count++) & 0x07U)) {
+            return USBD_OK;
+        }
+    }
+
+    dfu_mem_process();
+
+    return USBD_OK;
+}
+
 /*!
     \brief      leave DFU mode and reset device to jump to user loaded code
     \param[in]  udev: pointer to USB device instance
@@ -379,6 +408,9 @@ static void dfu_mode_leave (usb_dev *udev)
 {
     usbd_dfu_handler *dfu = (usbd_dfu_handler *)udev->dev.class_data[USBD_DFU_INTERFACE];
 
+    /* program what is still queued before the new firmware is started */
+    dfu_mem_flush();
+
     dfu->manifest_state = MANIFEST_COMPLETE;
 
     if (dfu_config_desc.dfu_func.bmAttributes & 0x04U) {
@@ -420,7 +452,8 @@ static uint8_t dfu_getstatus_complete (usb_dev *udev)
                 } else if (ERASE == dfu->buf[0]) {
                     dfu->base_addr = *(uint32_t *)(dfu->buf + 1U);
 
-                    dfu_mem_erase(dfu->base_addr);
+                    /* the erase runs when its sector is reached or the flash is idle */
+                    dfu_mem_erase_post(dfu->base_addr);
                 } else {
                     /* no operation */
                 }
@@ -431,7 +464,8 @@ static uint8_t dfu_getstatus_complete (usb_dev *udev)
             /* decode the required address */
             addr = (dfu->block_num - 2U) * TRANSFER_SIZE + dfu->base_addr;
 
-            dfu_mem_write (dfu->buf, addr, dfu->data_len);
+            /* the block is programmed in background from SOF */
+            dfu_mem_block_put (dfu->data_buf, addr, dfu->data_len);
 
             dfu->block_num = 0U;
         } else {
@@ -483,6 +517,9 @@ static void dfu_detach(usb_dev *udev, usb_req *req)
         break;
     }
 
+    /* complete the queued blocks before the device goes away */
+    dfu_mem_flush();
+
     /* check the detach capability in the DFU functional descriptor */
     if (dfu_config_desc.dfu_func.wDetachTimeOut & DFU_DETACH_MASK) {
         usbd_disconnect (udev);
@@ -516,8 +553,19 @@ static void dfu_dnload(usb_dev *udev, usb_req *req)
 
             dfu->bState = STATE_DFU_DNLOAD_SYNC;
 
+            /* firmware blocks are received straight into the programming queue */
+            dfu->data_buf = dfu->buf;
+
+            if (dfu->block_num > 1U) {
+                dfu->data_buf = dfu_mem_block_get();
+
+                if (NULL == dfu->data_buf) {
+                    dfu->data_buf = dfu->buf;
+                }
+            }
+
             transc->remain_len = dfu->data_len;
-            transc->xfer_buf = dfu->buf;
+            transc->xfer_buf = dfu->data_buf;
         } else {
             dfu->manifest_state = MANIFEST_IN_PROGRESS;
             dfu->bState = STATE_DFU_MANIFEST_SYNC;
@@ -575,6 +623,9 @@ static void  dfu_upload (usb_dev *udev, usb_req *req)
             /* change is accelerated */
             addr = (dfu->block_num - 2U) * TRANSFER_SIZE + dfu->base_addr;
 
+            /* read back what the host downloaded, not what is still queued */
+            dfu_mem_flush();
+
             /* return the physical address where data are stored */
             phy_addr = dfu_mem_read (dfu->buf, addr, dfu->data_len);
 
@@ -602,9 +653,31 @@ static void  dfu_upload (usb_dev *udev, usb_req *req)
 */
 static void dfu_getstatus (usb_dev *udev, usb_req *req)
 {
+    uint32_t addr;
     usb_transc *transc = &udev->dev.transc_in[0];
     usbd_dfu_handler *dfu = (usbd_dfu_handler *)udev->dev.class_data[USBD_DFU_INTERFACE];
 
+    /* report a failure of the background erase or programming */
+    switch (dfu_mem_error_get()) {
+    case MEM_ERR_ERASE:
+        dfu->bStatus = STATUS_ERR_ERASE;
+        dfu->bState = STATE_DFU_ERROR;
+        break;
+
+    case MEM_ERR_PROG:
+        dfu->bStatus = STATUS_ERR_PROG;
+        dfu->bState = STATE_DFU_ERROR;
+        break;
+
+    case MEM_ERR_VERIFY:
+        dfu->bStatus = STATUS_ERR_VERIFY;
+        dfu->bState = STATE_DFU_ERROR;
+        break;
+
+    default:
+        break;
+    }
+
     switch (dfu->bState) {
     case STATE_DFU_DNLOAD_SYNC:
         if (0U != dfu->data_len) {
@@ -614,18 +687,30 @@ static void dfu_getstatus (usb_dev *udev, usb_req *req)
                 if (ERASE == dfu->buf[0]) {
                     dfu_mem_getstatus (dfu->base_addr, CMD_ERASE, (uint8_t *)&dfu->bwPollTimeout0);
                 } else {
-                    dfu_mem_getstatus (dfu->base_addr, CMD_WRITE, (uint8_t *)&dfu->bwPollTimeout0);
+                    dfu_poll_timeout_set (dfu, dfu_mem_busy_time(1U));
                 }
+            } else if (dfu->block_num > 1U) {
+                addr = (dfu->block_num - 2U) * TRANSFER_SIZE + dfu->base_addr;
+
+                dfu_mem_getstatus (addr, CMD_WRITE, (uint8_t *)&dfu->bwPollTimeout0);
+            } else {
+                dfu_poll_timeout_set (dfu, 0U);
             }
-        } else {
+        } else if (0U == dfu_mem_busy_time(1U)) {
             dfu->bState = STATE_DFU_DNLOAD_IDLE;
+        } else {
+            /* all block buffers are still being programmed */
+            dfu->bState = STATE_DFU_DNBUSY;
+
+            dfu_poll_timeout_set (dfu, dfu_mem_busy_time(1U));
         }
         break;
 
     case STATE_DFU_MANIFEST_SYNC:
         if (MANIFEST_IN_PROGRESS == dfu->manifest_state) {
             dfu->bState = STATE_DFU_MANIFEST;
-            dfu->bwPollTimeout0 = 1U;
+
+            dfu_poll_timeout_set (dfu, 1U + dfu_mem_busy_time(DFU_MEM_DRAIN));
         } else if ((MANIFEST_COMPLETE == dfu->manifest_state) && \
             (dfu_config_desc.dfu_func.bmAttributes & 0x04U)){
             dfu->bState = STATE_DFU_IDLE;
@@ -733,3 +818,21 @@ static void string_to_unicode (uint8_t *str, uint16_t *pbuf)
         }
     }
 }
+
+/*!
+    \brief      set the poll timeout reported to the host
+    \param[in]  dfu: pointer to DFU handler
+    \param[in]  timeout: time in ms the host waits before the next status request
+    \param[out] none
+    \retval     none
+*/
+static void dfu_poll_timeout_set (usbd_dfu_handler *dfu, uint32_t timeout)
+{
+    if (timeout > 0xFFFFFFU) {
+        timeout = 0xFFFFFFU;
+    }
+
+    dfu->bwPollTimeout0 = _BYTE1(timeout);
+    dfu->bwPollTimeout1 = _BYTE2(timeout);
+    dfu->bwPollTimeout2 = _BYTE3(timeout);
+}
@@ -37,6 +37,50 @@ OF SUCH DAMAGE.
 #include "dfu_mem.h"
 #include "drv_usb_hw.h"
 #include "usbd_transc.h"
+#include <string.h>
+
+/* media which erase in background are programmed in steps as well */
+#define MEM_IS_BACKGROUND(prop)   ((NULL != (prop)->mem_erase_start) && (NULL != (prop)->mem_op_status))
+
+#define ERASE_QUEUE_MASK          ((2U << (DFU_ERASE_QUEUE_NUM - 1U)) - 1U)
+
+/* download block waiting to be programmed */
+typedef struct
+{
+    uint32_t buf[(TRANSFER_SIZE + 3U) / 4U];
+    uint32_t addr;
+    uint32_t len;
+    uint32_t offset;                                    /*!< bytes already programmed */
+    uint32_t crc;                                       /*!< CRC of the received block */
+    uint32_t seq;
+    uint8_t  mem_index;
+} dfu_mem_block;
+
+/* sector erase deferred until its sector is programmed or the media is idle */
+typedef struct
+{
+    uint32_t base;
+    uint32_t size;                                      /*!< 0 if the media has no sector map */
+    uint32_t seq;
+    uint8_t  mem_index;
+} dfu_mem_sector;
+
+static struct
+{
+    dfu_mem_block  block[DFU_BLOCK_QUEUE_NUM];
+    dfu_mem_sector sector[DFU_ERASE_QUEUE_NUM];
+
+    uint32_t sector_valid;                              /*!< bitmap of the pending erases */
+    uint32_t seq;                                       /*!< order the host issued blocks and erases in */
+    uint32_t tick;                                      /*!< 1 ms steps run so far */
+    uint32_t busy_tick;                                 /*!< step the running erase was started at */
+    uint32_t busy_time;                                 /*!< estimated duration of the running erase */
+
+    uint8_t  busy;                                      /*!< index + 1 of the erase running in background */
+    uint8_t  block_head;
+    uint8_t  block_num;
+    uint8_t  error;
+} mem_queue;
 
 extern usb_core_driver usb_dfu_dev;
 
@@ -63,6 +107,13 @@ const uint8_t* USBD_DFU_StringDesc[MAX_USED_MEMORY_MEDIA] =
 };
 
 static uint8_t dfu_mem_checkaddr (uint32_t addr);
+static void dfu_mem_run (uint32_t budget);
+static uint8_t dfu_mem_erase_run (uint8_t idx);
+static uint8_t dfu_mem_erase_find (dfu_mem_block *block);
+static uint8_t dfu_mem_overlap (dfu_mem_sector *sector, dfu_mem_block *block);
+static uint32_t dfu_mem_erase_time (dfu_mem_sector *sector);
+static uint32_t dfu_mem_prog_time (dfu_mem_block *block);
+static void dfu_mem_discard (uint8_t error);
 
 /*!
     \brief      initialize the memory media on the GD32
@@ -74,6 +125,11 @@ uint8_t dfu_mem_init (void)
 {
     uint32_t mem_index = 0U;
 
+    memset((void *)&mem_queue, 0, sizeof(mem_queue));
+
+    /* the CRC unit verifies the programmed blocks */
+    rcu_periph_clock_enable(RCU_CRC);
+
     /* initialize all supported memory medias */
     for (mem_index = 0U; mem_index < MAX_USED_MEMORY_MEDIA; mem_index++) {
         /* check if the memory media exists */
@@ -95,6 +151,9 @@ uint8_t dfu_mem_deinit (void)
 {
     uint32_t mem_index = 0U;
 
+    /* complete the blocks already acknowledged to the host */
+    dfu_mem_flush();
+
     /* deinitialize all supported memory medias */
     for (mem_index = 0U; mem_index < MAX_USED_MEMORY_MEDIA; mem_index++) {
         /* check if the memory media exists */
@@ -208,20 +267,263 @@ uint8_t* dfu_mem_read (uint8_t *buf, uint32_t addr, uint32_t len)
 uint8_t dfu_mem_getstatus (uint32_t addr, uint8_t cmd, uint8_t *buffer)
 {
     uint32_t mem_index = dfu_mem_checkaddr(addr);
+    uint32_t timeout = 0U;
 
     if (mem_index < MAX_USED_MEMORY_MEDIA) {
         if (cmd & 0x01U) {
-            POLLING_TIMEOUT_SET(mem_tab[mem_index]->write_timeout);
+            /* the block being received takes a buffer, another one has to be free for the next block */
+            timeout = dfu_mem_busy_time(2U);
+        } else if (ERASE_QUEUE_MASK == mem_queue.sector_valid) {
+            /* no room to defer the erase, the queued work is completed first */
+            timeout = dfu_mem_busy_time(DFU_MEM_DRAIN);
         } else {
-            POLLING_TIMEOUT_SET(mem_tab[mem_index]->erase_timeout);
+            timeout = dfu_mem_busy_time(1U);
         }
 
+        if (timeout > 0xFFFFFFU) {
+            timeout = 0xFFFFFFU;
+        }
+
+        POLLING_TIMEOUT_SET(timeout);
+
         return MEM_OK;
     } else {
         return MEM_FAIL;
     }
 }
 
+/*!
+    \brief      get the buffer the next download block is received into
+    \param[in]  none
+    \param[out] none
+    \retval     pointer to the free block buffer, NULL if all are queued
+*/
+uint8_t* dfu_mem_block_get (void)
+{
+    if (mem_queue.block_num < DFU_BLOCK_QUEUE_NUM) {
+        return (uint8_t *)mem_queue.block[(mem_queue.block_head + mem_queue.block_num) % DFU_BLOCK_QUEUE_NUM].buf;
+    }
+
+    return NULL;
+}
+
+/*!
+    \brief      queue a received download block for background programming
+    \param[in]  buf: the data buffer, either from dfu_mem_block_get() or a copy is made
+    \param[in]  addr: memory address the block is written to
+    \param[in]  len: data length
+    \param[out] none
+    \retval     MEM_OK if the block is queued, MEM_FAIL else
+*/
+uint8_t dfu_mem_block_put (uint8_t *buf, uint32_t addr, uint32_t len)
+{
+    uint32_t idx = 0U;
+    dfu_mem_block *block = NULL;
+    uint32_t mem_index = dfu_mem_checkaddr(addr);
+
+    /* check if the address is in protected area */
+    if (IS_PROTECTED_AREA(addr)) {
+        return MEM_FAIL;
+    }
+
+    /* option bytes are written at once, after the firmware before them */
+    if ((addr & MAL_MASK_OB) == OB_RDPT0) {
+        dfu_mem_flush();
+
+        return dfu_mem_write(buf, addr, len);
+    }
+
+    if ((mem_index >= MAX_USED_MEMORY_MEDIA) || (NULL == mem_tab[mem_index]->mem_write) || (len > TRANSFER_SIZE)) {
+        return MEM_FAIL;
+    }
+
+    if (buf != dfu_mem_block_get()) {
+        /* not received into the queue, wait for a free buffer and copy */
+        if (mem_queue.block_num >= DFU_BLOCK_QUEUE_NUM) {
+            dfu_mem_flush();
+        }
+
+        memcpy(dfu_mem_block_get(), buf, len);
+    }
+
+    block = &mem_queue.block[(mem_queue.block_head + mem_queue.block_num) % DFU_BLOCK_QUEUE_NUM];
+
+    /* pad to a whole word as programmed, so the read back CRC matches */
+    for (idx = len; idx & 0x03U; idx++) {
+        ((uint8_t *)block->buf)[idx] = 0xFFU;
+    }
+
+    block->addr = addr;
+    block->len = len;
+    block->offset = 0U;
+    block->seq = mem_queue.seq++;
+    block->mem_index = (uint8_t)mem_index;
+
+    crc_data_register_reset();
+    block->crc = crc_block_data_calculate(block->buf, (len + 3U) / 4U);
+
+    mem_queue.block_num++;
+
+    return MEM_OK;
+}
+
+/*!
+    \brief      queue a sector erase to be run ahead of programming
+    \param[in]  addr: memory sector address/code
+    \param[out] none
+    \retval     MEM_OK if the erase is queued, MEM_FAIL else
+*/
+uint8_t dfu_mem_erase_post (uint32_t addr)
+{
+    uint8_t idx = 0U, num = 0U;
+    dfu_mem_sector *sector = NULL;
+    uint32_t mem_index = dfu_mem_checkaddr(addr);
+    uint32_t base = addr, size = 0U;
+
+    /* check if the address is in protected area */
+    if (IS_PROTECTED_AREA(addr)) {
+        return MEM_FAIL;
+    }
+
+    if ((mem_index >= MAX_USED_MEMORY_MEDIA) || (NULL == mem_tab[mem_index]->mem_erase)) {
+        return MEM_FAIL;
+    }
+
+    if (NULL != mem_tab[mem_index]->mem_sector_get) {
+        size = mem_tab[mem_index]->mem_sector_get(addr, &base);
+    }
+
+    /* the same sector is already pending and nothing was queued into it since */
+    for (idx = 0U; idx < DFU_ERASE_QUEUE_NUM; idx++) {
+        sector = &mem_queue.sector[idx];
+
+        if ((0U == (mem_queue.sector_valid & (1U << idx))) || (mem_queue.busy == idx + 1U)) {
+            continue;
+        }
+
+        if ((sector->mem_index == mem_index) && (sector->base == base) && (sector->size == size)) {
+            for (num = 0U; num < mem_queue.block_num; num++) {
+                if (dfu_mem_overlap(sector, &mem_queue.block[(mem_queue.block_head + num) % DFU_BLOCK_QUEUE_NUM])) {
+                    break;
+                }
+            }
+
+            if (num == mem_queue.block_num) {
+                return MEM_OK;
+            }
+        }
+    }
+
+    if (ERASE_QUEUE_MASK == mem_queue.sector_valid) {
+        dfu_mem_flush();
+    }
+
+    for (idx = 0U; mem_queue.sector_valid & (1U << idx); idx++) {
+    }
+
+    sector = &mem_queue.sector[idx];
+    sector->base = base;
+    sector->size = size;
+    sector->seq = mem_queue.seq++;
+    sector->mem_index = (uint8_t)mem_index;
+
+    mem_queue.sector_valid |= 1U << idx;
+
+    return MEM_OK;
+}
+
+/*!
+    \brief      estimate the time until the given number of block buffers are free
+    \param[in]  slots: number of free block buffers waited for, or DFU_MEM_DRAIN for all queued work
+    \param[out] none
+    \retval     estimated time in ms
+*/
+uint32_t dfu_mem_busy_time (uint8_t slots)
+{
+    uint8_t idx = 0U, num = 0U;
+    uint32_t time = 0U, elapsed = 0U, counted = 0U;
+    uint32_t free = DFU_BLOCK_QUEUE_NUM - mem_queue.block_num;
+    dfu_mem_block *block = NULL;
+
+    if ((DFU_MEM_DRAIN != slots) && (free >= slots)) {
+        return 0U;
+    }
+
+    if (0U != mem_queue.busy) {
+        elapsed = mem_queue.tick - mem_queue.busy_tick;
+        time = (mem_queue.busy_time > elapsed) ? (mem_queue.busy_time - elapsed) : 1U;
+        counted = 1U << (mem_queue.busy - 1U);
+    }
+
+    /* walk the blocks in the order they are programmed, erasing their sectors first */
+    for (num = 0U; (num < mem_queue.block_num) && ((DFU_MEM_DRAIN == slots) || (free < slots)); num++) {
+        block = &mem_queue.block[(mem_queue.block_head + num) % DFU_BLOCK_QUEUE_NUM];
+
+        for (idx = 0U; idx < DFU_ERASE_QUEUE_NUM; idx++) {
+            if ((mem_queue.sector_valid & ~counted & (1U << idx)) && \
+                ((int32_t)(mem_queue.sector[idx].seq - block->seq) < 0) && \
+                dfu_mem_overlap(&mem_queue.sector[idx], block)) {
+                time += dfu_mem_erase_time(&mem_queue.sector[idx]);
+                counted |= 1U << idx;
+            }
+        }
+
+        time += dfu_mem_prog_time(block);
+        free++;
+    }
+
+    if (DFU_MEM_DRAIN == slots) {
+        for (idx = 0U; idx < DFU_ERASE_QUEUE_NUM; idx++) {
+            if (mem_queue.sector_valid & ~counted & (1U << idx)) {
+                time += dfu_mem_erase_time(&mem_queue.sector[idx]);
+            }
+        }
+    }
+
+    return time;
+}
+
+/*!
+    \brief      run the background erase and programming for one 1 ms step
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void dfu_mem_process (void)
+{
+    mem_queue.tick++;
+
+    dfu_mem_run(DFU_PROG_STEP_SIZE);
+}
+
+/*!
+    \brief      complete all queued erase and programming operations
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void dfu_mem_flush (void)
+{
+    while ((0U != mem_queue.block_num) || (0U != mem_queue.sector_valid)) {
+        dfu_mem_run(0xFFFFFFFFU);
+    }
+}
+
+/*!
+    \brief      get and clear the error of the background operations
+    \param[in]  none
+    \param[out] none
+    \retval     MEM_ERR_NONE, MEM_ERR_ERASE, MEM_ERR_PROG or MEM_ERR_VERIFY
+*/
+uint8_t dfu_mem_error_get (void)
+{
+    uint8_t error = mem_queue.error;
+
+    mem_queue.error = MEM_ERR_NONE;
+
+    return error;
+}
+
 /*!
     \brief      check the address is supported
     \param[in]  addr: memory sector address/code
@@ -243,3 +545,224 @@ static uint8_t dfu_mem_checkaddr (uint32_t addr)
     /* if there is no memory found, return MAX_USED_MEMORY_MEDIA */
     return (MAX_USED_MEMORY_MEDIA);
 }
+
+/*!
+    \brief      advance the queued erases and programming
+    \param[in]  budget: maximum number of bytes programmed into background media
+    \param[out] none
+    \retval     none
+*/
+static void dfu_mem_run (uint32_t budget)
+{
+    uint8_t idx = 0U, status = MEM_OK;
+    uint32_t len = 0U;
+    uint8_t *data = NULL;
+    dfu_mem_block *block = NULL;
+
+    /* an erase is running in background */
+    if (0U != mem_queue.busy) {
+        idx = mem_queue.busy - 1U;
+        status = mem_tab[mem_queue.sector[idx].mem_index]->mem_op_status();
+
+        if (MEM_BUSY == status) {
+            return;
+        }
+
+        mem_queue.busy = 0U;
+        mem_queue.sector_valid &= ~(1U << idx);
+
+        if (MEM_OK != status) {
+            dfu_mem_discard(MEM_ERR_ERASE);
+            return;
+        }
+    }
+
+    while (0U != budget) {
+        if (0U != mem_queue.block_num) {
+            block = &mem_queue.block[mem_queue.block_head];
+
+            /* the sector of the block is erased first */
+            idx = dfu_mem_erase_find(block);
+
+            if (idx < DFU_ERASE_QUEUE_NUM) {
+                if (MEM_OK != dfu_mem_erase_run(idx)) {
+                    return;
+                }
+
+                continue;
+            }
+
+            len = block->len - block->offset;
+
+            if (MEM_IS_BACKGROUND(mem_tab[block->mem_index]) && (len > budget)) {
+                len = budget;
+            }
+
+            if (MEM_OK != mem_tab[block->mem_index]->mem_write((uint8_t *)block->buf + block->offset, block->addr + block->offset, len)) {
+                dfu_mem_discard(MEM_ERR_PROG);
+                return;
+            }
+
+            block->offset += len;
+            budget = (budget > len) ? (budget - len) : 0U;
+
+            if (block->offset == block->len) {
+                /* read back through the CRC unit and compare with the received data */
+                data = dfu_mem_read((uint8_t *)block->buf, block->addr, block->len);
+
+                crc_data_register_reset();
+
+                if (block->crc != crc_block_data_calculate((uint32_t *)data, (block->len + 3U) / 4U)) {
+                    dfu_mem_discard(MEM_ERR_VERIFY);
+                    return;
+                }
+
+                mem_queue.block_head = (mem_queue.block_head + 1U) % DFU_BLOCK_QUEUE_NUM;
+                mem_queue.block_num--;
+            }
+        } else if (0U != mem_queue.sector_valid) {
+            /* no data to program, erase ahead */
+            if (MEM_OK != dfu_mem_erase_run(dfu_mem_erase_find(NULL))) {
+                return;
+            }
+        } else {
+            return;
+        }
+    }
+}
+
+/*!
+    \brief      start or run a queued sector erase
+    \param[in]  idx: index of the pending erase
+    \param[out] none
+    \retval     MEM_OK if the erase is done, MEM_BUSY if it runs in background, MEM_FAIL else
+*/
+static uint8_t dfu_mem_erase_run (uint8_t idx)
+{
+    uint8_t status = MEM_OK;
+    dfu_mem_sector *sector = &mem_queue.sector[idx];
+    dfu_mem_prop *prop = mem_tab[sector->mem_index];
+
+    if (MEM_IS_BACKGROUND(prop)) {
+        if (MEM_OK != prop->mem_erase_start(sector->base)) {
+            mem_queue.sector_valid &= ~(1U << idx);
+            dfu_mem_discard(MEM_ERR_ERASE);
+
+            return MEM_FAIL;
+        }
+
+        mem_queue.busy = idx + 1U;
+        mem_queue.busy_tick = mem_queue.tick;
+        mem_queue.busy_time = dfu_mem_erase_time(sector);
+
+        return MEM_BUSY;
+    }
+
+    status = prop->mem_erase(sector->base);
+
+    mem_queue.sector_valid &= ~(1U << idx);
+
+    if (MEM_OK != status) {
+        dfu_mem_discard(MEM_ERR_ERASE);
+
+        return MEM_FAIL;
+    }
+
+    return MEM_OK;
+}
+
+/*!
+    \brief      find the oldest pending erase
+    \param[in]  block: only consider erases issued before this block and overlapping it, NULL for all
+    \param[out] none
+    \retval     index of the erase, DFU_ERASE_QUEUE_NUM if there is none
+*/
+static uint8_t dfu_mem_erase_find (dfu_mem_block *block)
+{
+    uint8_t idx = 0U, found = DFU_ERASE_QUEUE_NUM;
+    dfu_mem_sector *sector = NULL;
+
+    for (idx = 0U; idx < DFU_ERASE_QUEUE_NUM; idx++) {
+        sector = &mem_queue.sector[idx];
+
+        if (0U == (mem_queue.sector_valid & (1U << idx))) {
+            continue;
+        }
+
+        if ((NULL != block) && (((int32_t)(sector->seq - block->seq) > 0) || (0U == dfu_mem_overlap(sector, block)))) {
+            continue;
+        }
+
+        if ((DFU_ERASE_QUEUE_NUM == found) || ((int32_t)(sector->seq - mem_queue.sector[found].seq) < 0)) {
+            found = idx;
+        }
+    }
+
+    return found;
+}
+
+/*!
+    \brief      check if an erase covers a block
+    \param[in]  sector: pending erase
+    \param[in]  block: queued block
+    \param[out] none
+    \retval     1 if the block lies in the sector, 0 else
+*/
+static uint8_t dfu_mem_overlap (dfu_mem_sector *sector, dfu_mem_block *block)
+{
+    /* without a sector map every block is taken as overlapping, keeping the host order */
+    if (0U == sector->size) {
+        return 1U;
+    }
+
+    if (sector->mem_index != block->mem_index) {
+        return 0U;
+    }
+
+    return (uint8_t)(((block->addr - sector->base) < sector->size) || ((sector->base - block->addr) < block->len));
+}
+
+/*!
+    \brief      estimate the duration of a sector erase
+    \param[in]  sector: pending erase
+    \param[out] none
+    \retval     time in ms
+*/
+static uint32_t dfu_mem_erase_time (dfu_mem_sector *sector)
+{
+    uint32_t units = sector->size / DFU_ERASE_TIMEOUT_UNIT;
+
+    return mem_tab[sector->mem_index]->erase_timeout * ((0U == units) ? 1U : units);
+}
+
+/*!
+    \brief      estimate the time left to program a block
+    \param[in]  block: queued block
+    \param[out] none
+    \retval     time in ms
+*/
+static uint32_t dfu_mem_prog_time (dfu_mem_block *block)
+{
+    uint32_t len = block->len - block->offset;
+
+    /* background media are programmed a step per millisecond */
+    if (MEM_IS_BACKGROUND(mem_tab[block->mem_index])) {
+        return (len + DFU_PROG_STEP_SIZE - 1U) / DFU_PROG_STEP_SIZE;
+    }
+
+    return (len * mem_tab[block->mem_index]->write_timeout + TRANSFER_SIZE - 1U) / TRANSFER_SIZE;
+}
+
+/*!
+    \brief      drop all queued operations after a failure
+    \param[in]  error: MEM_ERR_ERASE, MEM_ERR_PROG or MEM_ERR_VERIFY
+    \param[out] none
+    \retval     none
+*/
+static void dfu_mem_discard (uint8_t error)
+{
+    mem_queue.block_num = 0U;
+    mem_queue.sector_valid = 0U;
+    mem_queue.busy = 0U;
+    mem_queue.error = error;
+}
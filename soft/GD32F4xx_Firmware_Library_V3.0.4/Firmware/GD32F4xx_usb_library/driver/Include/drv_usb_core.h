@@ -256,6 +256,12 @@ typedef struct _usb_pipe
     __IO uint32_t        err_count;
     __IO usb_pipe_staus  pp_status;
     __IO usb_urb_state   urb_state;
+
+    /* periodic schedule of an interrupt pipe, see usbh_pipe_sched_add() */
+    uint16_t             interval;                  /* period in (micro)frames, 0 when not scheduled */
+    uint16_t             phase;                     /* slot in the period */
+    uint16_t             sched_frame;               /* frame number of the last start */
+    uint16_t             bus_time;                  /* reserved bus time, 100 ns units */
 } usb_pipe;
 
 typedef struct _usb_host_drv
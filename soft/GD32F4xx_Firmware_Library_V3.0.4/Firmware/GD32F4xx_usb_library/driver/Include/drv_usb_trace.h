@@ -0,0 +1,126 @@
+/*!
+    \file    drv_usb_trace.h
+    \brief   USB driver event trace and transfer statistics header file
+
+    \version 2020-08-01, V3.0.0, firmware for GD32F4xx
+    \version 2022-03-09, V3.1.0, firmware for GD32F4xx
+    \version 2022-06-30, V3.2.0, firmware for GD32F4xx
+*/
+
+
+/*
+    Copyright (c) 2022, GigaDevice Semiconductor Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this 
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice, 
+       this list of conditions and the following disclaimer in the documentation 
+       and/or other materials provided with the distribution.
+    3. Neither the name of the copyright holder nor the names of its contributors 
+       may be used to endorse or promote products derived from this software without 
+       specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+OF SUCH DAMAGE.
+*/
+
+#ifndef __DRV_USB_TRACE_H
+#define __DRV_USB_TRACE_H
+
+#include "drv_usb_regs.h"
+
+/* trace event codes, the value is also the bit of the event in the trace mask */
+enum _usb_trace_event {
+    USB_TRACE_SOF = 0U,                                                         /*!< start of frame, info: frame number */
+    USB_TRACE_SETUP,                                                            /*!< setup packet, info: bRequest << 8 | bmRequestType, len: wLength << 16 | wValue */
+    USB_TRACE_XFER_START,                                                       /*!< transfer programmed, info: endpoint type (device) or USB_TRACE_PIPE_INFO (host), len: transfer length */
+    USB_TRACE_XFER_DONE,                                                        /*!< transfer finished, info: as transfer start, len: transferred bytes */
+    USB_TRACE_NAK,                                                              /*!< NAK received (host) or global OUT NAK effective (device) */
+    USB_TRACE_TXFIFO_EMPTY,                                                     /*!< Tx FIFO empty, len: bytes left to write */
+    USB_TRACE_STALL,                                                            /*!< STALL sent (device) or received (host) */
+    USB_TRACE_ERROR,                                                            /*!< host channel error, info: channel interrupt flags */
+    USB_TRACE_BUS,                                                              /*!< bus state change, info: USB_TRACE_BUS_xxx */
+    USB_TRACE_EVENT_NUM
+};
+
+/* bus state change codes */
+#define USB_TRACE_BUS_RESET                 0U                                  /*!< device: USB reset */
+#define USB_TRACE_BUS_SUSPEND               1U                                  /*!< device: suspend */
+#define USB_TRACE_BUS_WAKEUP                2U                                  /*!< device: wakeup */
+#define USB_TRACE_BUS_CONNECT               3U                                  /*!< host: device connected */
+#define USB_TRACE_BUS_DISCONNECT            4U                                  /*!< host: device disconnected */
+
+#define USB_TRACE_MASK(event)               (1UL << (event))                    /*!< trace mask bit of an event */
+#define USB_TRACE_MASK_ALL                  ((1UL << USB_TRACE_EVENT_NUM) - 1U) /*!< trace mask of all the events */
+
+#define USB_TRACE_LEN_XFER                  0xFFFFFFFFU                         /*!< transfer done with the length given at its start */
+
+/* host transfer information: device address and endpoint address of a pipe */
+#define USB_TRACE_PIPE_INFO(pp)             (((uint32_t)(pp)->dev_addr << 8U) | (pp)->ep.num | ((uint32_t)(pp)->ep.dir << 7U))
+
+#ifndef USB_TRACE_DEPTH
+    #define USB_TRACE_DEPTH                 512U                                /*!< trace records kept, must be a power of 2 */
+#endif /* USB_TRACE_DEPTH */
+
+#ifndef USB_TRACE_EVENTS
+    #define USB_TRACE_EVENTS                USB_TRACE_MASK_ALL                  /*!< events traced from initialization */
+#endif /* USB_TRACE_EVENTS */
+
+#define USB_TRACE_SLOT_NUM                  16U                                 /*!< statistics slots, one per endpoint address or host pipe */
+#define USB_TRACE_HIST_NUM                  16U                                 /*!< log2 histogram buckets */
+
+/* trace record, dumped as is (little endian, 12 bytes) as the payload of one capture packet */
+typedef struct
+{
+    uint32_t time;                                                              /*!< DWT cycle counter */
+    uint8_t  event;                                                             /*!< event code */
+    uint8_t  ep;                                                                /*!< endpoint address (device) or pipe number (host) */
+    uint16_t info;                                                              /*!< event specific information */
+    uint32_t len;                                                               /*!< event specific length */
+} usb_trace_rec;
+
+#ifdef USB_TRACE_ENABLED
+
+/* the trace is shared by the USB cores, trace one core at a time */
+#define USB_TRACE(event, ep, info, len)     usb_trace_put ((uint8_t)(event), (uint8_t)(ep), (uint16_t)(info), (uint32_t)(len))
+#define USB_TRACE_ISR_ENTER()               usb_trace_isr_enter()
+#define USB_TRACE_ISR_EXIT()                usb_trace_isr_exit()
+
+/* function declarations */
+/* initialize the trace, start the cycle counter and calibrate the trace cost */
+void usb_trace_init (void);
+/* clear the trace and the statistics and start tracing the given events */
+void usb_trace_start (uint32_t mask);
+/* stop tracing */
+void usb_trace_stop (void);
+/* record a trace event */
+void usb_trace_put (uint8_t event, uint8_t ep, uint16_t info, uint32_t len);
+/* mark the entry of the USB interrupt handler */
+void usb_trace_isr_enter (void);
+/* mark the exit of the USB interrupt handler */
+void usb_trace_isr_exit (void);
+/* get the CPU time spent in tracing since the trace start */
+uint32_t usb_trace_overhead_get (void);
+/* stop tracing and dump the trace records and the statistics as text lines */
+void usb_trace_dump (void (*line_put)(const char *line));
+
+#else
+
+#define USB_TRACE(event, ep, info, len)
+#define USB_TRACE_ISR_ENTER()
+#define USB_TRACE_ISR_EXIT()
+
+#endif /* USB_TRACE_ENABLED */
+
+#endif /* __DRV_USB_TRACE_H */
@@ -36,6 +36,7 @@ OF SUCH DAMAGE.
 
 #include "drv_usb_core.h"
 #include "drv_usb_hw.h"
+#include "drv_usb_trace.h"
 
 /* local function prototypes ('static') */
 static void usb_core_reset (usb_core_regs *usb_regs);
@@ -138,6 +139,10 @@ usb_status usb_basic_init (usb_core_basic *usb_basic,
             (usb_basic->base_reg + USB_DATA_FIFO_OFFSET + (i * USB_DATA_FIFO_SIZE));
     }
 
+#ifdef USB_TRACE_ENABLED
+    usb_trace_init ();
+#endif /* USB_TRACE_ENABLED */
+
     return USB_OK;
 }
 
@@ -37,6 +37,7 @@ OF SUCH DAMAGE.
 #include "drv_usb_hw.h"
 #include "drv_usb_core.h"
 #include "drv_usb_dev.h"
+#include "drv_usb_trace.h"
 
 /* endpoint 0 max packet length */
 static const uint8_t EP0_MAXLEN[4] = {
@@ -380,6 +381,8 @@ usb_status usb_transc_inxfer (usb_core_driver *udev, usb_transc *transc)
 
     udev->regs.er_in[ep_num]->DIEPLEN = eplen;
 
+    USB_TRACE(USB_TRACE_XFER_START, ep_num | 0x80U, transc->ep_type, transc->xfer_len);
+
     if (transc->ep_type == (uint8_t)USB_EPTYPE_ISOC) {
         if (((udev->regs.dr->DSTAT & DSTAT_FNRSOF) >> 8U) & 0x01U) {
             epctl |= DEPCTL_SEVNFRM;
@@ -455,6 +458,8 @@ usb_status usb_transc_outxfer (usb_core_driver *udev, usb_transc *transc)
 
     udev->regs.er_out[ep_num]->DOEPLEN = eplen;
 
+    USB_TRACE(USB_TRACE_XFER_START, ep_num, transc->ep_type, transc->xfer_len);
+
     if ((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) {
         udev->regs.er_out[ep_num]->DOEPDMAADDR = transc->dma_addr;
     }
@@ -503,6 +508,8 @@ usb_status usb_transc_stall (usb_core_driver *udev, usb_transc *transc)
     /* set the endpoint stall bit */
     *reg_addr |= DEPCTL_STALL;
 
+    USB_TRACE(USB_TRACE_STALL, ep_num | ((uint32_t)transc->ep_addr.dir << 7U), transc->ep_type, 0U);
+
     return USB_OK;
 }
 
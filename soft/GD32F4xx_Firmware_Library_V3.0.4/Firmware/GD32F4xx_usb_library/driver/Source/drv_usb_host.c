@@ -37,6 +37,7 @@ OF SUCH DAMAGE.
 #include "drv_usb_hw.h"
 #include "drv_usb_core.h"
 #include "drv_usb_host.h"
+#include "drv_usb_trace.h"
 
 const uint32_t PIPE_DPID[2] = {
     PIPE_DPID_DATA0,
@@ -328,6 +329,8 @@ usb_status usb_pipe_xfer (usb_core_driver *udev, uint8_t pipe_num)
     /* initialize the host channel transfer information */
     udev->regs.pr[pipe_num]->HCHLEN = pp->xfer_len | pp->DPID | PIPE_XFER_PCNT(packet_count);
 
+    USB_TRACE(USB_TRACE_XFER_START, pipe_num, USB_TRACE_PIPE_INFO(pp), pp->xfer_len);
+
     if (USB_USE_DMA == udev->bp.transfer_mode) {
         udev->regs.pr[pipe_num]->HCHDMAADDR = (unsigned int)pp->xfer_buf;
     }
@@ -435,7 +438,8 @@ usb_status usb_pipe_ping (usb_core_driver *udev, uint8_t pipe_num)
 {
     uint32_t pp_ctl = 0U;
 
-    udev->regs.pr[pipe_num]->HCHLEN = HCHLEN_PING | (HCHLEN_PCNT & (1U << 19U));
+    /* keep the data PID, the halt handler reads the OUT toggle back from HCHLEN */
+    udev->regs.pr[pipe_num]->HCHLEN = HCHLEN_PING | (HCHLEN_PCNT & (1U << 19U)) | udev->host.pipe[pipe_num].DPID;
 
     pp_ctl = udev->regs.pr[pipe_num]->HCHCTL;
 
@@ -0,0 +1,506 @@
+/*!
+    \file    drv_usb_trace.c
+    \brief   USB driver event trace and transfer statistics
+
+    \version 2020-08-01, V3.0.0, firmware for GD32F4xx
+    \version 2022-03-09, V3.1.0, firmware for GD32F4xx
+    \version 2022-06-30, V3.2.0, firmware for GD32F4xx
+*/
+
+
+/*
+    Copyright (c) 2022, GigaDevice Semiconductor Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this 
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice, 
+       this list of conditions and the following disclaimer in the documentation 
+       and/or other materials provided with the distribution.
+    3. Neither the name of the copyright holder nor the names of its contributors 
+       may be used to endorse or promote products derived from this software without 
+       specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+OF SUCH DAMAGE.
+*/
+
+#include "drv_usb_trace.h"
+
+#ifdef USB_TRACE_ENABLED
+
+#if (0U != (USB_TRACE_DEPTH & (USB_TRACE_DEPTH - 1U)))
+    #error "USB_TRACE_DEPTH should be a power of 2!"
+#endif
+
+#define USB_TRACE_CAL_NUM                   16U                                 /*!< rounds used to calibrate the trace cost */
+#define USB_TRACE_LINE_SIZE                 200U                                /*!< dump line buffer size */
+
+/* per endpoint transfer statistics */
+typedef struct
+{
+    uint32_t start;                                                             /*!< cycle counter at the transfer start */
+    uint32_t len;                                                               /*!< transfer length given at the start */
+    uint32_t xfer;                                                              /*!< finished transfers */
+    uint32_t bytes;                                                             /*!< transferred bytes */
+    uint32_t lat_hist[USB_TRACE_HIST_NUM];                                      /*!< transfer latency, bucket n counts [2^n, 2^(n+1)) us */
+    uint32_t rate_hist[USB_TRACE_HIST_NUM];                                     /*!< transfer rate, bucket n counts [2^n, 2^(n+1)) kB/s */
+    uint8_t  ep;                                                                /*!< endpoint address or pipe number */
+} usb_trace_slot;
+
+typedef struct
+{
+    __IO uint32_t  mask;                                                        /*!< traced events */
+    uint32_t       head;                                                        /*!< records written since the start */
+    uint32_t       last;                                                        /*!< cycle counter at the last record */
+    uint32_t       tail;                                                        /*!< cycles from the last record to the stop */
+    uint64_t       elapsed;                                                     /*!< cycles from the start to the last record */
+    uint64_t       isr_cycles;                                                  /*!< cycles spent in the USB interrupt handler */
+    uint32_t       isr_start;                                                   /*!< cycle counter at the handler entry */
+    uint32_t       isr_num;                                                     /*!< handler calls */
+    uint32_t       pending;                                                     /*!< slots with a transfer in progress */
+    uint32_t       cycles_per_us;                                               /*!< CPU cycles per microsecond */
+    uint32_t       rec_cost;                                                    /*!< cycles to record one event */
+    uint32_t       isr_cost;                                                    /*!< cycles to account one handler call */
+    usb_trace_rec  ring[USB_TRACE_DEPTH];                                       /*!< last records */
+    usb_trace_slot slot[USB_TRACE_SLOT_NUM];                                    /*!< endpoint statistics */
+} usb_trace_info;
+
+static usb_trace_info usb_trace;
+
+/* local function prototypes ('static') */
+static uint64_t trace_elapsed    (void);
+static char    *trace_str_put    (char *p, const char *str);
+static char    *trace_dec_put    (char *p, uint32_t value, uint32_t width);
+static char    *trace_hex_put    (char *p, uint32_t value, uint32_t width);
+
+/*!
+    \brief      get the histogram bucket of a value
+    \param[in]  value: value to classify
+    \param[out] none
+    \retval     floor(log2(value)), limited to the last bucket
+*/
+static inline uint32_t trace_bucket (uint32_t value)
+{
+    uint32_t bucket = (value > 1U) ? (31U - __CLZ(value)) : 0U;
+
+    return (bucket < USB_TRACE_HIST_NUM) ? bucket : (USB_TRACE_HIST_NUM - 1U);
+}
+
+/*!
+    \brief      initialize the trace, start the cycle counter and calibrate the trace cost
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void usb_trace_init (void)
+{
+    uint32_t i, start;
+
+    /* enable the DWT cycle counter */
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0U;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    usb_trace.cycles_per_us = SystemCoreClock / 1000000U;
+
+    /* time full transfer records and handler accounting, so the overhead can be reported */
+    usb_trace_start (USB_TRACE_MASK_ALL);
+
+    start = DWT->CYCCNT;
+
+    for (i = 0U; i < USB_TRACE_CAL_NUM; i++) {
+        usb_trace_put (USB_TRACE_XFER_START, 0U, 0U, 64U);
+        usb_trace_put (USB_TRACE_XFER_DONE, 0U, 0U, 64U);
+    }
+
+    usb_trace.rec_cost = (DWT->CYCCNT - start) / (2U * USB_TRACE_CAL_NUM);
+
+    start = DWT->CYCCNT;
+
+    for (i = 0U; i < USB_TRACE_CAL_NUM; i++) {
+        usb_trace_isr_enter ();
+        usb_trace_isr_exit ();
+    }
+
+    usb_trace.isr_cost = (DWT->CYCCNT - start) / USB_TRACE_CAL_NUM;
+
+    usb_trace_start (USB_TRACE_EVENTS);
+}
+
+/*!
+    \brief      clear the trace and the statistics and start tracing the given events
+    \param[in]  mask: traced events, combination of USB_TRACE_MASK(event)
+    \param[out] none
+    \retval     none
+*/
+void usb_trace_start (uint32_t mask)
+{
+    uint32_t i;
+
+    usb_trace.mask = 0U;
+
+    usb_trace.head = 0U;
+    usb_trace.tail = 0U;
+    usb_trace.elapsed = 0U;
+    usb_trace.isr_cycles = 0U;
+    usb_trace.isr_num = 0U;
+    usb_trace.pending = 0U;
+
+    for (i = 0U; i < USB_TRACE_SLOT_NUM; i++) {
+        usb_trace.slot[i] = (usb_trace_slot) {0};
+    }
+
+    usb_trace.last = DWT->CYCCNT;
+    usb_trace.mask = mask;
+}
+
+/*!
+    \brief      stop tracing
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void usb_trace_stop (void)
+{
+    if (0U != usb_trace.mask) {
+        usb_trace.mask = 0U;
+        usb_trace.tail = DWT->CYCCNT - usb_trace.last;
+    }
+}
+
+/*!
+    \brief      record a trace event
+    \param[in]  event: event code
+    \param[in]  ep: endpoint address (device) or pipe number (host)
+    \param[in]  info: event specific information
+    \param[in]  len: event specific length, USB_TRACE_LEN_XFER ends a transfer with its start length
+    \param[out] none
+    \retval     none
+*/
+void usb_trace_put (uint8_t event, uint8_t ep, uint16_t info, uint32_t len)
+{
+    if (0U == (usb_trace.mask & USB_TRACE_MASK(event))) {
+        return;
+    }
+
+    /* endpoint 0x8n and pipe n + 8 share a slot, only one role is traced at a time */
+    uint32_t slot_id = (ep & 0x0FU) | ((ep >> 4U) & 0x08U);
+    usb_trace_slot *slot = &usb_trace.slot[slot_id];
+
+    /* transfers are started from thread context too */
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    uint32_t now = DWT->CYCCNT;
+
+    usb_trace.elapsed += now - usb_trace.last;
+    usb_trace.last = now;
+
+    if (USB_TRACE_XFER_START == event) {
+        slot->start = now;
+        slot->len = len;
+        slot->ep = ep;
+
+        usb_trace.pending |= 1UL << slot_id;
+    } else if (USB_TRACE_XFER_DONE == event) {
+        if (USB_TRACE_LEN_XFER == len) {
+            len = slot->len;
+        }
+
+        if (usb_trace.pending & (1UL << slot_id)) {
+            uint32_t us = (now - slot->start) / usb_trace.cycles_per_us;
+            uint32_t rate;
+
+            usb_trace.pending &= ~(1UL << slot_id);
+
+            if (0U == us) {
+                us = 1U;
+            }
+
+            /* kB/s is bytes per millisecond */
+            rate = (len < 0x400000U) ? ((len * 1000U) / us) : ((len / us) * 1000U);
+
+            slot->lat_hist[trace_bucket(us)]++;
+            slot->rate_hist[trace_bucket(rate)]++;
+            slot->xfer++;
+            slot->bytes += len;
+        }
+    } else {
+        /* no operation */
+    }
+
+    usb_trace_rec *rec = &usb_trace.ring[usb_trace.head & (USB_TRACE_DEPTH - 1U)];
+
+    usb_trace.head++;
+
+    *rec = (usb_trace_rec) {
+        .time  = now,
+        .event = event,
+        .ep    = ep,
+        .info  = info,
+        .len   = len
+    };
+
+    __set_PRIMASK(primask);
+}
+
+/*!
+    \brief      mark the entry of the USB interrupt handler
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void usb_trace_isr_enter (void)
+{
+    usb_trace.isr_start = DWT->CYCCNT;
+}
+
+/*!
+    \brief      mark the exit of the USB interrupt handler
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void usb_trace_isr_exit (void)
+{
+    if (0U != usb_trace.mask) {
+        usb_trace.isr_cycles += DWT->CYCCNT - usb_trace.isr_start;
+        usb_trace.isr_num++;
+    }
+}
+
+/*!
+    \brief      get the CPU time spent in tracing since the trace start
+    \param[in]  none
+    \param[out] none
+    \retval     tracing time in 1/10000 of the elapsed time
+*/
+uint32_t usb_trace_overhead_get (void)
+{
+    uint64_t elapsed = trace_elapsed();
+    uint64_t cost = ((uint64_t)usb_trace.head * usb_trace.rec_cost) + \
+                    ((uint64_t)usb_trace.isr_num * usb_trace.isr_cost);
+
+    return (0U == elapsed) ? 0U : (uint32_t)((cost * 10000U) / elapsed);
+}
+
+/*!
+    \brief      stop tracing and dump the trace records and the statistics as text lines
+    \param[in]  line_put: function writing one line, without the line end
+    \param[out] none
+    \retval     none
+
+    The records are written as a text2pcap input, one 12 bytes usb_trace_rec per packet
+    preceded by its time since the trace start, the other lines start with '#'. Convert
+    with: text2pcap -l 147 -t "%H:%M:%S." trace.txt trace.pcap
+*/
+void usb_trace_dump (void (*line_put)(const char *line))
+{
+    char line[USB_TRACE_LINE_SIZE];
+    char *p;
+    uint32_t i, k, first, overhead;
+    uint64_t time;
+
+    usb_trace_stop ();
+
+    overhead = usb_trace_overhead_get ();
+    first = (usb_trace.head > USB_TRACE_DEPTH) ? (usb_trace.head - USB_TRACE_DEPTH) : 0U;
+
+    p = trace_str_put (line, "# usb trace: ");
+    p = trace_dec_put (p, usb_trace.head - first, 0U);
+    p = trace_str_put (p, " records, ");
+    p = trace_dec_put (p, first, 0U);
+    p = trace_str_put (p, " lost, cpu ");
+    p = trace_dec_put (p, usb_trace.cycles_per_us, 0U);
+    (void)trace_str_put (p, " MHz");
+    line_put (line);
+
+    p = trace_str_put (line, "# elapsed ");
+    p = trace_dec_put (p, (uint32_t)(trace_elapsed() / usb_trace.cycles_per_us), 0U);
+    p = trace_str_put (p, " us, usb isr ");
+    p = trace_dec_put (p, (uint32_t)(usb_trace.isr_cycles / usb_trace.cycles_per_us), 0U);
+    p = trace_str_put (p, " us, trace ");
+    p = trace_dec_put (p, overhead / 100U, 0U);
+    p = trace_str_put (p, ".");
+    p = trace_dec_put (p, overhead % 100U, 2U);
+    p = trace_str_put (p, "% (");
+    p = trace_dec_put (p, usb_trace.rec_cost, 0U);
+    (void)trace_str_put (p, " cycles per record)");
+    line_put (line);
+
+    /* the first kept record is dated back from the last one, each step is below a counter wrap */
+    time = usb_trace.elapsed;
+
+    for (i = first + 1U; i < usb_trace.head; i++) {
+        time -= usb_trace.ring[i & (USB_TRACE_DEPTH - 1U)].time - usb_trace.ring[(i - 1U) & (USB_TRACE_DEPTH - 1U)].time;
+    }
+
+    for (i = first; i < usb_trace.head; i++) {
+        usb_trace_rec *rec = &usb_trace.ring[i & (USB_TRACE_DEPTH - 1U)];
+        const uint8_t *byte = (const uint8_t *)rec;
+
+        if (i > first) {
+            time += rec->time - usb_trace.ring[(i - 1U) & (USB_TRACE_DEPTH - 1U)].time;
+        }
+
+        uint64_t us = time / usb_trace.cycles_per_us;
+        uint32_t sec = (uint32_t)(us / 1000000U);
+
+        p = trace_dec_put (line, (sec / 3600U) % 24U, 2U);
+        p = trace_str_put (p, ":");
+        p = trace_dec_put (p, (sec / 60U) % 60U, 2U);
+        p = trace_str_put (p, ":");
+        p = trace_dec_put (p, sec % 60U, 2U);
+        p = trace_str_put (p, ".");
+        (void)trace_dec_put (p, (uint32_t)(us % 1000000U), 6U);
+        line_put (line);
+
+        p = trace_str_put (line, "000000");
+
+        for (k = 0U; k < sizeof(usb_trace_rec); k++) {
+            p = trace_str_put (p, " ");
+            p = trace_hex_put (p, byte[k], 2U);
+        }
+
+        line_put (line);
+    }
+
+    for (i = 0U; i < USB_TRACE_SLOT_NUM; i++) {
+        usb_trace_slot *slot = &usb_trace.slot[i];
+
+        if (0U == slot->xfer) {
+            continue;
+        }
+
+        p = trace_str_put (line, "# ep ");
+        p = trace_hex_put (p, slot->ep, 2U);
+        p = trace_str_put (p, ": ");
+        p = trace_dec_put (p, slot->xfer, 0U);
+        p = trace_str_put (p, " transfers, ");
+        p = trace_dec_put (p, slot->bytes, 0U);
+        (void)trace_str_put (p, " bytes");
+        line_put (line);
+
+        p = trace_str_put (line, "# ep ");
+        p = trace_hex_put (p, slot->ep, 2U);
+        p = trace_str_put (p, " latency log2(us):");
+
+        for (k = 0U; k < USB_TRACE_HIST_NUM; k++) {
+            p = trace_str_put (p, " ");
+            p = trace_dec_put (p, slot->lat_hist[k], 0U);
+        }
+
+        line_put (line);
+
+        p = trace_str_put (line, "# ep ");
+        p = trace_hex_put (p, slot->ep, 2U);
+        p = trace_str_put (p, " rate log2(kB/s):");
+
+        for (k = 0U; k < USB_TRACE_HIST_NUM; k++) {
+            p = trace_str_put (p, " ");
+            p = trace_dec_put (p, slot->rate_hist[k], 0U);
+        }
+
+        line_put (line);
+    }
+}
+
+/*!
+    \brief      get the cycles elapsed since the trace start
+    \param[in]  none
+    \param[out] none
+    \retval     elapsed cycles, up to the stop when tracing is stopped
+*/
+static uint64_t trace_elapsed (void)
+{
+    if (0U != usb_trace.mask) {
+        return usb_trace.elapsed + (uint32_t)(DWT->CYCCNT - usb_trace.last);
+    }
+
+    return usb_trace.elapsed + usb_trace.tail;
+}
+
+/*!
+    \brief      append a string to a dump line
+    \param[in]  p: line end
+    \param[in]  str: string to append
+    \param[out] none
+    \retval     new line end
+*/
+static char *trace_str_put (char *p, const char *str)
+{
+    while ('\0' != *str) {
+        *p++ = *str++;
+    }
+
+    *p = '\0';
+
+    return p;
+}
+
+/*!
+    \brief      append a decimal number to a dump line
+    \param[in]  p: line end
+    \param[in]  value: number to append
+    \param[in]  width: minimum digits, zero padded
+    \param[out] none
+    \retval     new line end
+*/
+static char *trace_dec_put (char *p, uint32_t value, uint32_t width)
+{
+    char digit[10];
+    uint32_t n = 0U;
+
+    do {
+        digit[n++] = (char)('0' + (value % 10U));
+        value /= 10U;
+    } while ((0U != value) && (n < sizeof(digit)));
+
+    while (width > n) {
+        *p++ = '0';
+        width--;
+    }
+
+    while (n > 0U) {
+        *p++ = digit[--n];
+    }
+
+    *p = '\0';
+
+    return p;
+}
+
+/*!
+    \brief      append a hexadecimal number to a dump line
+    \param[in]  p: line end
+    \param[in]  value: number to append
+    \param[in]  width: digits
+    \param[out] none
+    \retval     new line end
+*/
+static char *trace_hex_put (char *p, uint32_t value, uint32_t width)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    while (width > 0U) {
+        width--;
+        *p++ = hex[(value >> (width * 4U)) & 0x0FU];
+    }
+
+    *p = '\0';
+
+    return p;
+}
+
+#endif /* USB_TRACE_ENABLED */
@@ -37,6 +37,7 @@ OF SUCH DAMAGE.
 #include "usbd_conf.h"
 #include "drv_usbd_int.h"
 #include "usbd_transc.h"
+#include "drv_usb_trace.h"
 
 /* local function prototypes ('static') */
 static uint32_t usbd_int_epout                 (usb_core_driver *udev);
@@ -71,6 +72,8 @@ void usbd_isr (usb_core_driver *udev)
             return;
         }
 
+        USB_TRACE_ISR_ENTER();
+
         /* OUT endpoints interrupts */
         if (intr & GINTF_OEPIF) {
             (void)usbd_int_epout (udev);
@@ -83,11 +86,15 @@ void usbd_isr (usb_core_driver *udev)
 
         /* suspend interrupt */
         if (intr & GINTF_SP) {
+            USB_TRACE(USB_TRACE_BUS, 0U, USB_TRACE_BUS_SUSPEND, 0U);
+
             (void)usbd_int_suspend (udev);
         }
 
         /* wakeup interrupt */
         if (intr & GINTF_WKUPIF) {
+            USB_TRACE(USB_TRACE_BUS, 0U, USB_TRACE_BUS_WAKEUP, 0U);
+
             /* inform upper layer by the resume event */
             udev->dev.cur_status = USBD_CONFIGURED;
 
@@ -97,6 +104,8 @@ void usbd_isr (usb_core_driver *udev)
 
         /* start of frame interrupt */
         if (intr & GINTF_SOF) {
+            USB_TRACE(USB_TRACE_SOF, 0U, (udev->regs.dr->DSTAT & DSTAT_FNRSOF) >> 8U, 0U);
+
             if (udev->dev.class_core->SOF) {
                 (void)udev->dev.class_core->SOF(udev);
             }
@@ -112,6 +121,8 @@ void usbd_isr (usb_core_driver *udev)
 
         /* USB reset interrupt */
         if (intr & GINTF_RST) {
+            USB_TRACE(USB_TRACE_BUS, 0U, USB_TRACE_BUS_RESET, 0U);
+
             (void)usbd_int_reset (udev);
         }
 
@@ -157,6 +168,8 @@ void usbd_isr (usb_core_driver *udev)
             udev->regs.gr->GINTF = GINTF_OTGIF;
         }
 #endif /* VBUS_SENSING_ENABLED */
+
+        USB_TRACE_ISR_EXIT();
     }
 }
 
@@ -189,6 +202,8 @@ uint32_t usbd_int_dedicated_ep1out (usb_core_driver *udev)
                                     (oeplen & DEPLEN_TLEN);
         }
 
+        USB_TRACE(USB_TRACE_XFER_DONE, 1U, udev->dev.transc_out[1].ep_type, udev->dev.transc_out[1].xfer_count);
+
         /* rx complete */
         usbd_out_transc (udev, 1U);
     }
@@ -218,11 +233,15 @@ uint32_t usbd_int_dedicated_ep1in (usb_core_driver *udev)
 
         udev->regs.er_in[1]->DIEPINTF = DIEPINTF_TF;
 
+        USB_TRACE(USB_TRACE_XFER_DONE, 0x81U, udev->dev.transc_in[1].ep_type, udev->dev.transc_in[1].xfer_len);
+
         /* TX complete */
         usbd_in_transc (udev, 1);
     }
 
     if(intr & DIEPINTF_TXFE){
+        USB_TRACE(USB_TRACE_TXFIFO_EMPTY, 0x81U, 0U, udev->dev.transc_in[1].xfer_len - udev->dev.transc_in[1].xfer_count);
+
         usbd_emptytxfifo_write(udev, 1);
 
         udev->regs.er_in[1]->DIEPINTF = DIEPINTF_TXFE;
@@ -260,6 +279,9 @@ static uint32_t usbd_int_epout (usb_core_driver *udev)
                                                                 (eplen & DEPLEN_TLEN);
                 }
 
+                USB_TRACE(USB_TRACE_XFER_DONE, ep_num, udev->dev.transc_out[ep_num].ep_type, \
+                          udev->dev.transc_out[ep_num].xfer_count);
+
                 /* inform upper layer: data ready */
                 (void)usbd_out_transc (udev, ep_num);
 
@@ -272,6 +294,10 @@ static uint32_t usbd_int_epout (usb_core_driver *udev)
 
             /* setup phase finished interrupt (control endpoints) */
             if (oepintr & DOEPINTF_STPF) {
+                USB_TRACE(USB_TRACE_SETUP, ep_num, \
+                          ((uint32_t)udev->dev.control.req.bRequest << 8U) | udev->dev.control.req.bmRequestType, \
+                          ((uint32_t)udev->dev.control.req.wLength << 16U) | udev->dev.control.req.wValue);
+
                 /* inform the upper layer that a setup packet is available */
                 (void)usbd_setup_transc (udev);
 
@@ -301,6 +327,9 @@ static uint32_t usbd_int_epin (usb_core_driver *udev)
             if (iepintr & DIEPINTF_TF) {
                 udev->regs.er_in[ep_num]->DIEPINTF = DIEPINTF_TF;
 
+                USB_TRACE(USB_TRACE_XFER_DONE, ep_num | 0x80U, udev->dev.transc_in[ep_num].ep_type, \
+                          udev->dev.transc_in[ep_num].xfer_len);
+
                 /* data transmission is completed */
                 (void)usbd_in_transc (udev, ep_num);
 
@@ -312,6 +341,9 @@ static uint32_t usbd_int_epin (usb_core_driver *udev)
             }
 
             if (iepintr & DIEPINTF_TXFE) {
+                USB_TRACE(USB_TRACE_TXFIFO_EMPTY, ep_num | 0x80U, 0U, \
+                          udev->dev.transc_in[ep_num].xfer_len - udev->dev.transc_in[ep_num].xfer_count);
+
                 usbd_emptytxfifo_write (udev, (uint32_t)ep_num);
 
                 udev->regs.er_in[ep_num]->DIEPINTF = DIEPINTF_TXFE;
@@ -367,6 +399,7 @@ static uint32_t usbd_int_rxfifo (usb_core_driver *udev)
 
     switch ((devrxstat & GRSTATRP_RPCKST) >> 17U) {
     case RSTAT_GOUT_NAK:
+        USB_TRACE(USB_TRACE_NAK, ep_num, 0U, 0U);
         break;
 
     case RSTAT_DATA_UPDT:
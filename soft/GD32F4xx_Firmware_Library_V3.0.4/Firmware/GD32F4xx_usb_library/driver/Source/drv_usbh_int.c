@@ -35,6 +35,7 @@ OF SUCH DAMAGE.
 */
 
 #include "drv_usbh_int.h"
+#include "drv_usb_trace.h"
 
 #if defined   (__CC_ARM)        /*!< ARM compiler */
     #pragma O0
@@ -72,7 +73,11 @@ uint32_t usbh_isr (usb_core_driver *udev)
             return 0U;
         }
 
+        USB_TRACE_ISR_ENTER();
+
         if (intr & GINTF_SOF) {
+            USB_TRACE(USB_TRACE_SOF, 0U, udev->regs.hr->HFINFR & HFINFR_FRNUM, 0U);
+
             usbh_int_fop->SOF(udev->host.data);
 
             /* clear interrupt */
@@ -100,6 +105,8 @@ uint32_t usbh_isr (usb_core_driver *udev)
         }
 
         if (intr & GINTF_DISCIF) {
+            USB_TRACE(USB_TRACE_BUS, 0U, USB_TRACE_BUS_DISCONNECT, 0U);
+
             usbh_int_fop->disconnect(udev->host.data);
 
             /* clear interrupt */
@@ -123,6 +130,8 @@ uint32_t usbh_isr (usb_core_driver *udev)
             /* clear interrupt */
             udev->regs.gr->GINTF = GINTF_WKUPIF;
         }
+
+        USB_TRACE_ISR_EXIT();
     }
 
     return retval;
@@ -151,6 +160,17 @@ static inline void usb_pp_halt (usb_core_driver *udev,
     udev->host.pipe[pp_num].pp_status = pp_status;
 }
 
+/*!
+    \brief      get the data toggle the core holds for the next packet of a bulk pipe
+    \param[in]  pp_reg: pointer to the host channel registers
+    \param[out] none
+    \retval     1 for DATA1, 0 for DATA0
+*/
+static inline uint8_t usb_pp_toggle_get (usb_pr *pp_reg)
+{
+    return (PIPE_DPID_DATA1 == (pp_reg->HCHLEN & HCHLEN_DPID)) ? 1U : 0U;
+}
+
 /*!
     \brief      handle the host port interrupt
     \param[in]  udev: pointer to USB device instance
@@ -176,6 +196,8 @@ static uint32_t usbh_int_port (usb_core_driver *udev)
     if (*udev->regs.HPCS & HPCS_PCD) {
         port_state |= HPCS_PCD;
 
+        USB_TRACE(USB_TRACE_BUS, 0U, USB_TRACE_BUS_CONNECT, 0U);
+
         usbh_int_fop->connect(udev->host.data);
 
         retval |= 1U;
@@ -282,6 +304,8 @@ static uint32_t usbh_int_pipe_in (usb_core_driver *udev, uint32_t pp_num)
     if (intr_pp & HCHINTF_ACK) {
         pp_reg->HCHINTF = HCHINTF_ACK;
     } else if (intr_pp & HCHINTF_STALL) {
+        USB_TRACE(USB_TRACE_STALL, pp_num, USB_TRACE_PIPE_INFO(pp), 0U);
+
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_STALL, PIPE_STALL);
         pp_reg->HCHINTF = HCHINTF_NAK;
 
@@ -290,19 +314,29 @@ static uint32_t usbh_int_pipe_in (usb_core_driver *udev, uint32_t pp_num)
            will be overwritten by 'NAK' in code below */
         intr_pp &= ~HCHINTF_NAK;
     } else if (intr_pp & HCHINTF_DTER) {
+        USB_TRACE(USB_TRACE_ERROR, pp_num, HCHINTF_DTER, 0U);
+
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_DTER, PIPE_DTGERR);
         pp_reg->HCHINTF = HCHINTF_NAK;
     } else {
         /* no operation */
     }
 
-    if (intr_pp & HCHINTF_REQOVR) {
+    if (intr_pp & HCHINTF_BBER) {
+        USB_TRACE(USB_TRACE_ERROR, pp_num, HCHINTF_BBER, 0U);
+
+        usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_BBER, PIPE_BBERR);
+    } else if (intr_pp & HCHINTF_REQOVR) {
+        USB_TRACE(USB_TRACE_ERROR, pp_num, HCHINTF_REQOVR, 0U);
+
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_REQOVR, PIPE_REQOVR);
     } else if (intr_pp & HCHINTF_TF) {
         if ((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) {
             udev->host.backup_xfercount[pp_num] = pp->xfer_len - (pp_reg->HCHLEN & HCHLEN_TLEN);
         }
 
+        USB_TRACE(USB_TRACE_XFER_DONE, pp_num, USB_TRACE_PIPE_INFO(pp), udev->host.backup_xfercount[pp_num]);
+
         pp->pp_status = PIPE_XF;
         pp->err_count = 0U;
 
@@ -331,6 +365,11 @@ static uint32_t usbh_int_pipe_in (usb_core_driver *udev, uint32_t pp_num)
         switch (pp->pp_status) {
         case PIPE_XF:
             pp->urb_state = URB_DONE;
+
+            if ((uint8_t)USB_EPTYPE_BULK == ep_type) {
+                /* a multi-packet transfer toggles once per packet, the core keeps count */
+                pp->data_toggle_in = usb_pp_toggle_get (pp_reg);
+            }
             break;
 
         case PIPE_STALL:
@@ -345,11 +384,20 @@ static uint32_t usbh_int_pipe_in (usb_core_driver *udev, uint32_t pp_num)
             pp->data_toggle_in ^= 1U;
             break;
 
+        case PIPE_BBERR:
+            pp->err_count = 0U;
+            pp->urb_state = URB_ERROR;
+
+            if ((uint8_t)USB_EPTYPE_BULK == ep_type) {
+                /* the packet was not acknowledged, the device sends it again with the toggle the core holds */
+                pp->data_toggle_in = usb_pp_toggle_get (pp_reg);
+            }
+            break;
+
         case PIPE_IDLE:
         case PIPE_HALTED:
         case PIPE_NAK:
         case PIPE_NYET:
-        case PIPE_BBERR:
         case PIPE_REQOVR:
         default:
             if((uint8_t)USB_EPTYPE_INTR == ep_type) {
@@ -360,9 +408,13 @@ static uint32_t usbh_int_pipe_in (usb_core_driver *udev, uint32_t pp_num)
 
         pp_reg->HCHINTF = HCHINTF_CH;
     } else if (intr_pp & HCHINTF_USBER) {
+        USB_TRACE(USB_TRACE_ERROR, pp_num, HCHINTF_USBER, 0U);
+
         pp->err_count++;
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_USBER, PIPE_TRACERR);
     } else if (intr_pp & HCHINTF_NAK) {
+        USB_TRACE(USB_TRACE_NAK, pp_num, 0U, 0U);
+
         switch (ep_type) {
         case USB_EPTYPE_CTRL:
         case USB_EPTYPE_BULK:
@@ -417,16 +469,26 @@ static uint32_t usbh_int_pipe_out (usb_core_driver *udev, uint32_t pp_num)
 
         pp_reg->HCHINTF = HCHINTF_ACK;
     } else if (intr_pp & HCHINTF_STALL) {
+        USB_TRACE(USB_TRACE_STALL, pp_num, USB_TRACE_PIPE_INFO(pp), 0U);
+
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_STALL, PIPE_STALL);
     } else if (intr_pp & HCHINTF_DTER) {
+        USB_TRACE(USB_TRACE_ERROR, pp_num, HCHINTF_DTER, 0U);
+
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_DTER, PIPE_DTGERR);
         pp_reg->HCHINTF = HCHINTF_NAK;
     } else if (intr_pp & HCHINTF_REQOVR) {
+        USB_TRACE(USB_TRACE_ERROR, pp_num, HCHINTF_REQOVR, 0U);
+
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_REQOVR, PIPE_REQOVR);
     } else if (intr_pp & HCHINTF_TF) {
+        USB_TRACE(USB_TRACE_XFER_DONE, pp_num, USB_TRACE_PIPE_INFO(pp), USB_TRACE_LEN_XFER);
+
         pp->err_count = 0U;
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_TF, PIPE_XF);
     } else if (intr_pp & HCHINTF_NAK) {
+        USB_TRACE(USB_TRACE_NAK, pp_num, 0U, 0U);
+
         if (0U == udev->host.pipe[pp_num].do_ping) {
             if (1U == udev->host.pipe[pp_num].supp_ping) {
                 udev->host.pipe[pp_num].do_ping = 1;
@@ -436,6 +498,8 @@ static uint32_t usbh_int_pipe_out (usb_core_driver *udev, uint32_t pp_num)
         pp->err_count = 0U;
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_NAK, PIPE_NAK);
     } else if (intr_pp & HCHINTF_USBER) {
+        USB_TRACE(USB_TRACE_ERROR, pp_num, HCHINTF_USBER, 0U);
+
         pp->err_count++;
         usb_pp_halt (udev, (uint8_t)pp_num, HCHINTF_USBER, PIPE_TRACERR);
     } else if (intr_pp & HCHINTF_NYET) {
@@ -460,13 +524,30 @@ static uint32_t usbh_int_pipe_out (usb_core_driver *udev, uint32_t pp_num)
             pp->urb_state = URB_DONE;
 
             if ((uint8_t)USB_EPTYPE_BULK == ((pp_reg->HCHCTL & HCHCTL_EPTYPE) >> 18U)) {
-                pp->data_toggle_out ^= 1U; 
+                pp->data_toggle_out = usb_pp_toggle_get (pp_reg);
             }
             break;
 
         case PIPE_NAK:
         case PIPE_NYET:
             pp->urb_state = URB_NOTREADY;
+
+            udev->host.backup_xfercount[pp_num] = 0U;
+
+            /* a multi-packet transfer may stop part way, keep what the device has acknowledged */
+            if (((uint8_t)USB_EPTYPE_BULK == ((pp_reg->HCHCTL & HCHCTL_EPTYPE) >> 18U)) && 
+                (0U == (pp_reg->HCHLEN & HCHLEN_PING))) {
+                pp->data_toggle_out = usb_pp_toggle_get (pp_reg);
+
+                if ((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) {
+                    uint32_t packet_count = (pp->xfer_len + pp->ep.mps - 1U) / pp->ep.mps;
+                    uint32_t packet_left = (pp_reg->HCHLEN & HCHLEN_PCNT) >> 19U;
+
+                    if (packet_count > packet_left) {
+                        udev->host.backup_xfercount[pp_num] = (packet_count - packet_left) * pp->ep.mps;
+                    }
+                }
+            }
             break;
 
         case PIPE_STALL:
@@ -535,8 +616,8 @@ static uint32_t usbh_int_rxfifonoempty (usb_core_driver *udev)
 
             udev->host.backup_xfercount[pp_num] = xfer_count;
 
-            if (udev->regs.pr[pp_num]->HCHLEN & HCHLEN_PCNT) {
-                /* re-activate the channel when more packets are expected */
+            if ((count == udev->host.pipe[pp_num].ep.mps) && (udev->regs.pr[pp_num]->HCHLEN & HCHLEN_PCNT)) {
+                /* re-activate the channel when more packets are expected, a short packet ends the transfer */
                 uint32_t pp_ctl = udev->regs.pr[pp_num]->HCHCTL;
 
                 pp_ctl |= HCHCTL_CEN;
@@ -600,6 +681,8 @@ static uint32_t usbh_int_txfifoempty (usb_core_driver *udev, usb_pipe_mode pp_mo
 
     pp_num = (uint8_t)((txfifostate & TFQSTAT_CNUM) >> 27U);
 
+    USB_TRACE(USB_TRACE_TXFIFO_EMPTY, pp_num, pp_mode, udev->host.pipe[pp_num].xfer_len);
+
     word_count = (uint16_t)(udev->host.pipe[pp_num].xfer_len + 3U) / 4U;
 
     while (((txfifostate & TFQSTAT_TXFS) >= word_count) && (0U != udev->host.pipe[pp_num].xfer_len)) {
@@ -40,11 +40,19 @@ OF SUCH DAMAGE.
 #include "usb_hid.h"
 #include "usbh_enum.h"
 #include "usbh_transc.h"
+#include "usbh_hid_parser.h"
 
+#ifndef HID_MIN_POLL
 #define HID_MIN_POLL                                    10U
+#endif /* HID_MIN_POLL */
 #define HID_REPORT_SIZE                                 16U
 #define HID_QUEUE_SIZE                                  10U
 
+/* longest input report read from the interrupt endpoint */
+#ifndef HID_MAX_REPORT_SIZE
+#define HID_MAX_REPORT_SIZE                             64U
+#endif /* HID_MAX_REPORT_SIZE */
+
 #define USB_HID_DESC_SIZE                               9U
 
 /* states for HID state machine */
@@ -100,6 +108,7 @@ typedef struct _hid_process
 
     __IO uint32_t        timer;
     usb_desc_hid         hid_desc;
+    hid_report_map       report_map;                    /* compiled report descriptor */
 
     hid_state            state;
     hid_ctlstate         ctl_state;
@@ -111,6 +120,8 @@ typedef struct _hid_process
 extern usbh_class usbh_hid;
 
 /* function declarations */
+/* set the function receiving the reports of devices other than boot keyboards and mice */
+void usbh_hid_report_cb_set (void (*report_cb)(const hid_report_map *map, uint8_t report, const uint8_t *data));
 /* set HID report */
 usbh_status usbh_set_report (usb_core_driver *udev,
                              usbh_host *uhost,
@@ -0,0 +1,192 @@
+/*!
+    \file    usbh_hid_parser.h
+    \brief   USB host HID report descriptor parser header file
+
+    \version 2020-08-01, V3.0.0, firmware for GD32F4xx
+    \version 2022-03-09, V3.1.0, firmware for GD32F4xx
+    \version 2022-06-30, V3.2.0, firmware for GD32F4xx
+*/
+
+/*
+    Copyright (c) 2022, GigaDevice Semiconductor Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this 
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice, 
+       this list of conditions and the following disclaimer in the documentation 
+       and/or other materials provided with the distribution.
+    3. Neither the name of the copyright holder nor the names of its contributors 
+       may be used to endorse or promote products derived from this software without 
+       specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+OF SUCH DAMAGE.
+*/
+#ifndef __USBH_HID_PARSER_H
+#define __USBH_HID_PARSER_H
+
+#include "usbh_core.h"
+#include <string.h>
+
+/* sizes of the compiled report table */
+#ifndef HID_MAX_FIELDS
+#define HID_MAX_FIELDS                                  32U
+#endif /* HID_MAX_FIELDS */
+
+#ifndef HID_MAX_REPORTS
+#define HID_MAX_REPORTS                                 8U
+#endif /* HID_MAX_REPORTS */
+
+#define HID_MAX_LOCAL_USAGES                            16U
+#define HID_GLOBAL_STACK_DEPTH                          2U
+
+/* report buffers are read a word at a time, keep this many spare bytes after the report */
+#define HID_REPORT_PAD                                  4U
+
+#define HID_REPORT_NONE                                 0xFFU
+
+/* field flags, bit 0..2 as in the main item data */
+#define HID_FIELD_CONSTANT                              0x01U
+#define HID_FIELD_VARIABLE                              0x02U
+#define HID_FIELD_RELATIVE                              0x04U
+#define HID_FIELD_SIGNED                                0x80U
+
+/* usage pages */
+#define HID_PAGE_GENERIC_DESKTOP                        0x01U
+#define HID_PAGE_KEYBOARD                               0x07U
+#define HID_PAGE_BUTTON                                 0x09U
+#define HID_PAGE_DIGITIZER                              0x0DU
+
+/* generic desktop usages */
+#define HID_USAGE_X                                     0x30U
+#define HID_USAGE_Y                                     0x31U
+#define HID_USAGE_WHEEL                                 0x38U
+
+/* one input item: count elements of bit_size bits from bit_offset */
+typedef struct
+{
+    uint16_t  bit_offset;       /*!< offset from the start of the report, report ID byte included */
+    uint8_t   bit_size;         /*!< element size (1..32) */
+    uint8_t   count;            /*!< element count */
+    uint8_t   flags;            /*!< HID_FIELD_x */
+    uint8_t   report;           /*!< index in the report table */
+    uint16_t  usage_page;
+    uint16_t  usage_min;        /*!< usage of element 0 (variable) or of logical_min (array) */
+    uint16_t  usage_max;
+    uint32_t  mask;             /*!< element mask, precomputed from bit_size */
+    int32_t   logical_min;
+    int32_t   logical_max;
+    uint32_t  app_usage;        /*!< page << 16 | usage of the application collection */
+} hid_field;
+
+/* one input report */
+typedef struct
+{
+    uint8_t   id;               /*!< report ID, 0 when the device uses none */
+    uint8_t   field_first;      /*!< first field of the report */
+    uint8_t   field_num;        /*!< fields of the report */
+    uint16_t  size;             /*!< length in bytes, report ID byte included */
+} hid_report;
+
+/* compiled report descriptor */
+typedef struct
+{
+    hid_field   field[HID_MAX_FIELDS];
+    hid_report  report[HID_MAX_REPORTS];
+    uint8_t     field_num;
+    uint8_t     report_num;
+    uint8_t     id_used;        /*!< reports start with a report ID byte */
+    uint8_t     id_map[256];    /*!< report ID to report index, HID_REPORT_NONE when unknown */
+} hid_report_map;
+
+/* reference to one element of a field */
+typedef struct
+{
+    const hid_field *field;
+    uint8_t          index;
+} hid_usage_ref;
+
+/*!
+    \brief      get the report an input report belongs to
+    \param[in]  map: pointer to compiled report descriptor
+    \param[in]  data: report data
+    \param[out] none
+    \retval     report index, HID_REPORT_NONE when unknown
+*/
+static inline uint8_t usbh_hid_report_find (const hid_report_map *map, const uint8_t *data)
+{
+    if (0U == map->id_used) {
+        return (0U != map->report_num) ? 0U : HID_REPORT_NONE;
+    }
+
+    return map->id_map[data[0]];
+}
+
+/*!
+    \brief      get the raw bits of a field element
+    \param[in]  data: report data, followed by HID_REPORT_PAD readable bytes
+    \param[in]  field: pointer to field
+    \param[in]  index: element index
+    \param[out] none
+    \retval     element bits
+*/
+static inline uint32_t usbh_hid_field_raw (const uint8_t *data, const hid_field *field, uint8_t index)
+{
+    uint32_t bit = field->bit_offset + (uint32_t)index * field->bit_size;
+    const uint8_t *p = data + (bit >> 3U);
+    uint32_t shift = bit & 7U;
+    uint32_t value;
+
+    /* one unaligned word load covers any element up to 25 bits */
+    memcpy(&value, p, sizeof(value));
+
+    value >>= shift;
+
+    if ((shift + field->bit_size) > 32U) {
+        value |= (uint32_t)p[4] << (32U - shift);
+    }
+
+    return value & field->mask;
+}
+
+/*!
+    \brief      get the value of a field element, sign extended when the logical range is signed
+    \param[in]  data: report data, followed by HID_REPORT_PAD readable bytes
+    \param[in]  field: pointer to field
+    \param[in]  index: element index
+    \param[out] none
+    \retval     element value
+*/
+static inline int32_t usbh_hid_field_get (const uint8_t *data, const hid_field *field, uint8_t index)
+{
+    uint32_t value = usbh_hid_field_raw (data, field, index);
+
+    if ((field->flags & HID_FIELD_SIGNED) && (field->bit_size < 32U)) {
+        uint32_t sign = 1U << (field->bit_size - 1U);
+
+        value = (value ^ sign) - sign;
+    }
+
+    return (int32_t)value;
+}
+
+/* function declarations */
+/* compile a report descriptor into field and report tables */
+usbh_status usbh_hid_parse (hid_report_map *map, const uint8_t *desc, uint16_t len);
+/* find the variable field element carrying a usage */
+usbh_status usbh_hid_usage_find (const hid_report_map *map, uint16_t page, uint16_t usage, hid_usage_ref *ref);
+/* find the first array field of a usage page */
+usbh_status usbh_hid_array_find (const hid_report_map *map, uint16_t page, hid_usage_ref *ref);
+
+#endif /* __USBH_HID_PARSER_H */
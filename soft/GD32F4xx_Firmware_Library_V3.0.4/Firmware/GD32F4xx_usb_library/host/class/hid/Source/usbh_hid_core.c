@@ -51,6 +51,16 @@ static usbh_status usbh_hid_sof(usbh_host *uhost);
 static usbh_status usbh_hid_desc_get (usbh_host *uhost, uint16_t len);
 static usbh_status usbh_set_idle (usbh_host *uhost, uint8_t duration, uint8_t report_ID);
 static usbh_status usbh_set_protocol (usbh_host *uhost, uint8_t protocol);
+static usbh_status usbh_hid_generic_init (usb_core_driver *udev, usbh_host *uhost);
+static usbh_status usbh_hid_generic_decode (uint8_t *data);
+
+static const hid_report_map *generic_map = NULL;
+static void (*generic_report_cb)(const hid_report_map *map, uint8_t report, const uint8_t *data) = NULL;
+
+/* the report decoders keep their state in this file, so one HID device is served at a time */
+static usbh_hid_handler hid_handler;
+
+__ALIGN_BEGIN static uint32_t generic_report_data[(HID_MAX_REPORT_SIZE + HID_REPORT_PAD) / 4U] __ALIGN_END;
 
 usbh_class usbh_hid = 
 {
@@ -62,6 +72,17 @@ usbh_class usbh_hid =
     usbh_hid_sof
 };
 
+/*!
+    \brief      set the function receiving the reports of devices other than boot keyboards and mice
+    \param[in]  report_cb: function called with the compiled report descriptor, the report index and the report data
+    \param[out] none
+    \retval     none
+*/
+void usbh_hid_report_cb_set (void (*report_cb)(const hid_report_map *map, uint8_t report, const uint8_t *data))
+{
+    generic_report_cb = report_cb;
+}
+
 /*!
     \brief      get report
     \param[in]  uhost: pointer to USB host
@@ -142,9 +163,15 @@ usbh_status usbh_set_report (usb_core_driver *udev,
 */
 void usbh_hid_itf_deinit (usbh_host *uhost)
 {
-    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->active_class->class_data;
+    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->class_data;
+
+    if (NULL == hid) {
+        return;
+    }
 
     if (0x00U != hid->pipe_in) {
+        usbh_pipe_sched_del (uhost, hid->pipe_in);
+
         usb_pipe_halt (uhost->data, hid->pipe_in);
 
         usbh_pipe_free (uhost->data, hid->pipe_in);
@@ -197,7 +224,7 @@ hid_type usbh_hid_device_type_get(usb_core_driver *udev, usbh_host *uhost)
 */
 uint8_t usbh_hid_poll_interval_get (usb_core_driver *udev, usbh_host *uhost)
 {
-    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->active_class->class_data;
+    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->class_data;
 
     if ((HOST_CLASS_ENUM == uhost->cur_state) ||
          (HOST_USER_INPUT == uhost->cur_state) ||
@@ -220,30 +247,33 @@ static usbh_status usbh_hid_itf_init (usbh_host *uhost)
     uint8_t num = 0U, ep_num = 0U, interface = 0U;
     usbh_status status = USBH_BUSY;
 
-    interface = usbh_interface_find(&uhost->dev_prop, USB_HID_CLASS, USB_HID_SUBCLASS_BOOT_ITF, 0xFFU);
+    interface = usbh_interface_find(&uhost->dev_prop, USB_HID_CLASS, 0xFFU, 0xFFU);
 
-    if (0xFFU == interface) {
+    if ((0xFFU == interface) || (NULL != usbh_class_dev_get (uhost, &usbh_hid, 0U))) {
+        /* no HID interface, or another HID device is served already */
         uhost->usr_cb->dev_not_supported();
 
         status = USBH_FAIL;
     } else {
         usbh_interface_select(&uhost->dev_prop, interface);
 
-        static usbh_hid_handler hid_handler;
-
         memset((void*)&hid_handler, 0, sizeof(usbh_hid_handler));
 
         hid_handler.state = HID_ERROR;
 
         uint8_t itf_protocol = uhost->dev_prop.cfg_desc_set.itf_desc_set[uhost->dev_prop.cur_itf][0].itf_desc.bInterfaceProtocol;
-        if (USB_HID_PROTOCOL_KEYBOARD == itf_protocol) {
+        uint8_t itf_subclass = uhost->dev_prop.cfg_desc_set.itf_desc_set[uhost->dev_prop.cur_itf][0].itf_desc.bInterfaceSubClass;
+
+        if ((USB_HID_SUBCLASS_BOOT_ITF == itf_subclass) && (USB_HID_PROTOCOL_KEYBOARD == itf_protocol)) {
             hid_handler.init = usbh_hid_keybrd_init;
             hid_handler.decode = usbh_hid_keybrd_decode;
-        } else if (USB_HID_PROTOCOL_MOUSE == itf_protocol) {
+        } else if ((USB_HID_SUBCLASS_BOOT_ITF == itf_subclass) && (USB_HID_PROTOCOL_MOUSE == itf_protocol)) {
             hid_handler.init = usbh_hid_mouse_init;
             hid_handler.decode = usbh_hid_mouse_decode;
         } else {
-            status = USBH_FAIL;
+            /* any other device hands its reports to the application */
+            hid_handler.init = usbh_hid_generic_init;
+            hid_handler.decode = usbh_hid_generic_decode;
         }
 
         hid_handler.state = HID_INIT;
@@ -294,9 +324,19 @@ static usbh_status usbh_hid_itf_init (usbh_host *uhost)
             }
         }
 
-        uhost->active_class->class_data = (void *)&hid_handler;
+        uhost->class_data = (void *)&hid_handler;
 
         status = USBH_OK;
+
+        /* reserve the bus time of the polls */
+        if ((0U != hid_handler.pipe_in) && (USBH_OK != usbh_pipe_sched_add (uhost, hid_handler.pipe_in, hid_handler.poll))) {
+            usbh_hid_itf_deinit (uhost);
+
+            uhost->class_data = NULL;
+            uhost->usr_cb->dev_not_supported();
+
+            status = USBH_FAIL;
+        }
     }
 
     return status;
@@ -313,7 +353,7 @@ static usbh_status usbh_hid_class_req (usbh_host *uhost)
     usbh_status status = USBH_BUSY;
     usbh_status class_req_status = USBH_BUSY;
 
-    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->active_class->class_data;
+    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->class_data;
 
     /* handle HID control state machine */
     switch (hid->ctl_state) {
@@ -329,8 +369,20 @@ static usbh_status usbh_hid_class_req (usbh_host *uhost)
 
     case HID_REQ_GET_REPORT_DESC:
         /* get report descriptor */ 
-        if (USBH_OK == usbh_hid_reportdesc_get(uhost, hid->hid_desc.wDescriptorLength)) {
-            hid->ctl_state = HID_REQ_SET_IDLE;
+        if (USBH_OK == usbh_hid_reportdesc_get(uhost, USB_MIN(hid->hid_desc.wDescriptorLength, USBH_DATA_BUF_MAX_LEN))) {
+            /* compile the report layout once, reports are decoded from the table */
+            (void)usbh_hid_parse (&hid->report_map,
+                                  uhost->dev_prop.data,
+                                  USB_MIN(hid->hid_desc.wDescriptorLength, USBH_DATA_BUF_MAX_LEN));
+
+            if (usbh_hid_generic_decode == hid->decode) {
+                /* set idle and set protocol are boot device requests */
+                hid->ctl_state = HID_REQ_IDLE;
+
+                status = USBH_OK;
+            } else {
+                hid->ctl_state = HID_REQ_SET_IDLE;
+            }
         }
         break;
 
@@ -348,8 +400,8 @@ static usbh_status usbh_hid_class_req (usbh_host *uhost)
         break; 
 
     case HID_REQ_SET_PROTOCOL:
-        /* set protocol */
-        if (USBH_OK == usbh_set_protocol (uhost, 0U)) {
+        /* set protocol: report protocol when the descriptor could be compiled, boot protocol otherwise */
+        if (USBH_OK == usbh_set_protocol (uhost, (0U == hid->report_map.report_num) ? 1U : 0U)) {
             hid->ctl_state = HID_REQ_IDLE;
 
             /* all requests performed */
@@ -374,7 +426,7 @@ static usbh_status usbh_hid_class_req (usbh_host *uhost)
 static usbh_status usbh_hid_handle (usbh_host *uhost)
 {
     usbh_status status = USBH_OK;
-    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->active_class->class_data;
+    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->class_data;
 
     switch (hid->state) {
     case HID_INIT:
@@ -388,8 +440,8 @@ static usbh_status usbh_hid_handle (usbh_host *uhost)
         break;
 
     case HID_SYNC:
-        /* sync with start of even frame */
-        if (true == usb_frame_even(uhost->data)) {
+        /* start in the slot of the pipe */
+        if (0U != usbh_pipe_sched_due (uhost, hid->pipe_in)) {
             hid->state = HID_GET_DATA;
         }
         break;
@@ -427,6 +479,47 @@ static usbh_status usbh_hid_handle (usbh_host *uhost)
     return status;
 }
 
+/*!
+    \brief      initialize the report delivery of a device other than a boot keyboard or mouse
+    \param[in]  udev: pointer to USB core instance
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hid_generic_init (usb_core_driver *udev, usbh_host *uhost)
+{
+    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->class_data;
+
+    if (hid->len > HID_MAX_REPORT_SIZE) {
+        hid->len = HID_MAX_REPORT_SIZE;
+    }
+
+    memset((void *)generic_report_data, 0, sizeof(generic_report_data));
+
+    hid->pdata = (uint8_t *)(void *)generic_report_data;
+
+    generic_map = &hid->report_map;
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      hand a report of a device other than a boot keyboard or mouse to the application
+    \param[in]  data: report data
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hid_generic_decode (uint8_t *data)
+{
+    uint8_t report = usbh_hid_report_find (generic_map, data);
+
+    if ((HID_REPORT_NONE != report) && (NULL != generic_report_cb)) {
+        generic_report_cb (generic_map, report, data);
+    }
+
+    return USBH_OK;
+}
+
 /*!
     \brief      send get report descriptor command to the device
     \param[in]  uhost: pointer to USB host
@@ -463,18 +556,10 @@ static usbh_status usbh_hid_reportdesc_get (usbh_host *uhost, uint16_t len)
 */
 static usbh_status usbh_hid_sof(usbh_host *uhost)
 {
-    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->active_class->class_data;
+    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->class_data;
 
-    if (HID_POLL == hid->state) {
-        uint32_t frame_count = usb_curframe_get (uhost->data);
-
-        if ((frame_count > hid->timer) && ((frame_count - hid->timer) >= hid->poll)) {
-            hid->state = HID_GET_DATA;
-        } else if ((frame_count < hid->timer) && ((frame_count + 0x3FFFU - hid->timer) >= hid->poll)) {
-            hid->state = HID_GET_DATA;
-        } else {
-            /* no operation */
-        }
+    if ((HID_POLL == hid->state) && (0U != usbh_pipe_sched_due (uhost, hid->pipe_in))) {
+        hid->state = HID_GET_DATA;
     }
 
     return USBH_OK;
@@ -0,0 +1,447 @@
+/*!
+    \file    usbh_hid_parser.c
+    \brief   USB host HID report descriptor parser
+
+    \version 2020-08-01, V3.0.0, firmware for GD32F4xx
+    \version 2022-03-09, V3.1.0, firmware for GD32F4xx
+    \version 2022-06-30, V3.2.0, firmware for GD32F4xx
+*/
+
+/*
+    Copyright (c) 2022, GigaDevice Semiconductor Inc.
+
+    Redistribution and use in source and binary forms, with or without modification, 
+are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this 
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice, 
+       this list of conditions and the following disclaimer in the documentation 
+       and/or other materials provided with the distribution.
+    3. Neither the name of the copyright holder nor the names of its contributors 
+       may be used to endorse or promote products derived from this software without 
+       specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" 
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED 
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. 
+IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, 
+INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT 
+NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR 
+PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY 
+OF SUCH DAMAGE.
+*/
+
+#include "usbh_hid_parser.h"
+
+/* item types */
+#define HID_ITEM_MAIN                   0U
+#define HID_ITEM_GLOBAL                 1U
+#define HID_ITEM_LOCAL                  2U
+#define HID_ITEM_LONG                   0xFEU
+
+/* main item tags */
+#define HID_MAIN_INPUT                  0x8U
+#define HID_MAIN_COLLECTION             0xAU
+
+/* global item tags */
+#define HID_GLOBAL_USAGE_PAGE           0x0U
+#define HID_GLOBAL_LOGICAL_MIN          0x1U
+#define HID_GLOBAL_LOGICAL_MAX          0x2U
+#define HID_GLOBAL_REPORT_SIZE          0x7U
+#define HID_GLOBAL_REPORT_ID            0x8U
+#define HID_GLOBAL_REPORT_COUNT         0x9U
+#define HID_GLOBAL_PUSH                 0xAU
+#define HID_GLOBAL_POP                  0xBU
+
+/* local item tags */
+#define HID_LOCAL_USAGE                 0x0U
+#define HID_LOCAL_USAGE_MIN             0x1U
+#define HID_LOCAL_USAGE_MAX             0x2U
+
+#define HID_COLLECTION_APPLICATION      0x01U
+
+/* global item state */
+typedef struct
+{
+    uint16_t  usage_page;
+    uint16_t  report_size;
+    uint16_t  report_count;
+    uint8_t   report_id;
+    int32_t   logical_min;
+    int32_t   logical_max;
+} hid_global_state;
+
+/* local item state, usages as page << 16 | usage */
+typedef struct
+{
+    uint32_t  usage[HID_MAX_LOCAL_USAGES];
+    uint8_t   usage_num;
+    uint32_t  usage_min;
+    uint32_t  usage_max;
+} hid_local_state;
+
+/* parser state */
+typedef struct
+{
+    hid_global_state  global;
+    hid_global_state  stack[HID_GLOBAL_STACK_DEPTH];
+    hid_local_state   local;
+    uint8_t           sp;
+    uint8_t           depth;
+    uint32_t          app_usage;
+    uint32_t          bits[HID_MAX_REPORTS];
+} hid_parser;
+
+/* local function prototypes ('static') */
+static uint8_t hid_report_get   (hid_report_map *map, hid_parser *parser);
+static void hid_field_add       (hid_report_map *map, hid_parser *parser, uint8_t report, uint32_t bit,
+                                 uint32_t count, uint8_t flags, uint32_t usage_min, uint32_t usage_max);
+static void hid_input_add       (hid_report_map *map, hid_parser *parser, uint32_t flags);
+
+/*!
+    \brief      compile a report descriptor into field and report tables
+    \param[in]  map: pointer to compiled report descriptor
+    \param[in]  desc: report descriptor
+    \param[in]  len: report descriptor length
+    \param[out] none
+    \retval     operation status
+*/
+usbh_status usbh_hid_parse (hid_report_map *map, const uint8_t *desc, uint16_t len)
+{
+    hid_parser parser;
+    uint16_t pos = 0U;
+
+    memset((void *)map, 0, sizeof(hid_report_map));
+    memset((void *)map->id_map, HID_REPORT_NONE, sizeof(map->id_map));
+    memset((void *)&parser, 0, sizeof(hid_parser));
+
+    while (pos < len) {
+        uint8_t prefix = desc[pos++];
+
+        if (HID_ITEM_LONG == prefix) {
+            /* long items carry no data the parser uses */
+            if (pos >= len) {
+                return USBH_FAIL;
+            }
+
+            pos += 2U + desc[pos];
+            continue;
+        }
+
+        uint8_t size = prefix & 0x03U;
+        uint8_t type = (prefix >> 2U) & 0x03U;
+        uint8_t tag = prefix >> 4U;
+        uint32_t udata = 0U;
+        int32_t sdata = 0;
+
+        if (3U == size) {
+            size = 4U;
+        }
+
+        if ((pos + size) > len) {
+            return USBH_FAIL;
+        }
+
+        for (uint8_t i = 0U; i < size; i++) {
+            udata |= (uint32_t)desc[pos + i] << (8U * i);
+        }
+
+        pos += size;
+
+        /* signed view of the item data */
+        if ((0U != size) && (size < 4U)) {
+            uint32_t sign = 1U << (8U * size - 1U);
+
+            sdata = (int32_t)((udata ^ sign) - sign);
+        } else {
+            sdata = (int32_t)udata;
+        }
+
+        switch (type) {
+        case HID_ITEM_MAIN:
+            if (HID_MAIN_INPUT == tag) {
+                hid_input_add (map, &parser, udata);
+            } else if (HID_MAIN_COLLECTION == tag) {
+                if ((HID_COLLECTION_APPLICATION == udata) && (0U == parser.depth)) {
+                    parser.app_usage = (0U != parser.local.usage_num) ? parser.local.usage[0] : parser.local.usage_min;
+                }
+
+                parser.depth++;
+            } else if (0xCU == tag) {
+                if (parser.depth) {
+                    parser.depth--;
+                }
+            } else {
+                /* output and feature reports are not decoded */
+            }
+
+            /* local items only last until the next main item */
+            memset((void *)&parser.local, 0, sizeof(hid_local_state));
+            break;
+
+        case HID_ITEM_GLOBAL:
+            switch (tag) {
+            case HID_GLOBAL_USAGE_PAGE:
+                parser.global.usage_page = (uint16_t)udata;
+                break;
+
+            case HID_GLOBAL_LOGICAL_MIN:
+                parser.global.logical_min = sdata;
+                break;
+
+            case HID_GLOBAL_LOGICAL_MAX:
+                /* the maximum is only signed when the minimum is */
+                parser.global.logical_max = (parser.global.logical_min < 0) ? sdata : (int32_t)udata;
+                break;
+
+            case HID_GLOBAL_REPORT_SIZE:
+                parser.global.report_size = (uint16_t)udata;
+                break;
+
+            case HID_GLOBAL_REPORT_ID:
+                if ((0U == udata) || (udata > 0xFFU)) {
+                    return USBH_FAIL;
+                }
+
+                parser.global.report_id = (uint8_t)udata;
+                map->id_used = 1U;
+                break;
+
+            case HID_GLOBAL_REPORT_COUNT:
+                parser.global.report_count = (uint16_t)udata;
+                break;
+
+            case HID_GLOBAL_PUSH:
+                if (parser.sp >= HID_GLOBAL_STACK_DEPTH) {
+                    return USBH_FAIL;
+                }
+
+                parser.stack[parser.sp++] = parser.global;
+                break;
+
+            case HID_GLOBAL_POP:
+                if (0U == parser.sp) {
+                    return USBH_FAIL;
+                }
+
+                parser.global = parser.stack[--parser.sp];
+                break;
+
+            default:
+                break;
+            }
+            break;
+
+        case HID_ITEM_LOCAL:
+            /* 4 byte usages carry their own page */
+            if (size < 4U) {
+                udata |= (uint32_t)parser.global.usage_page << 16U;
+            }
+
+            if (HID_LOCAL_USAGE == tag) {
+                if (parser.local.usage_num < HID_MAX_LOCAL_USAGES) {
+                    parser.local.usage[parser.local.usage_num++] = udata;
+                }
+            } else if (HID_LOCAL_USAGE_MIN == tag) {
+                parser.local.usage_min = udata;
+            } else if (HID_LOCAL_USAGE_MAX == tag) {
+                parser.local.usage_max = udata;
+            } else {
+                /* designators and strings are not used */
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    /* the table holds byte lengths once the descriptor is through */
+    for (uint8_t i = 0U; i < map->report_num; i++) {
+        map->report[i].size = (uint16_t)((parser.bits[i] + 7U) >> 3U);
+    }
+
+    return (0U != map->report_num) ? USBH_OK : USBH_FAIL;
+}
+
+/*!
+    \brief      find the variable field element carrying a usage
+    \param[in]  map: pointer to compiled report descriptor
+    \param[in]  page: usage page
+    \param[in]  usage: usage ID
+    \param[out] ref: field and element index
+    \retval     operation status
+*/
+usbh_status usbh_hid_usage_find (const hid_report_map *map, uint16_t page, uint16_t usage, hid_usage_ref *ref)
+{
+    for (uint8_t i = 0U; i < map->field_num; i++) {
+        const hid_field *field = &map->field[i];
+
+        if ((field->flags & HID_FIELD_VARIABLE) && (page == field->usage_page) && 
+            (usage >= field->usage_min) && (usage <= field->usage_max)) {
+            ref->field = field;
+            ref->index = (uint8_t)USB_MIN((uint32_t)usage - field->usage_min, field->count - 1U);
+
+            return USBH_OK;
+        }
+    }
+
+    return USBH_FAIL;
+}
+
+/*!
+    \brief      find the first array field of a usage page
+    \param[in]  map: pointer to compiled report descriptor
+    \param[in]  page: usage page
+    \param[out] ref: field, element index 0
+    \retval     operation status
+*/
+usbh_status usbh_hid_array_find (const hid_report_map *map, uint16_t page, hid_usage_ref *ref)
+{
+    for (uint8_t i = 0U; i < map->field_num; i++) {
+        const hid_field *field = &map->field[i];
+
+        if ((0U == (field->flags & HID_FIELD_VARIABLE)) && (page == field->usage_page)) {
+            ref->field = field;
+            ref->index = 0U;
+
+            return USBH_OK;
+        }
+    }
+
+    return USBH_FAIL;
+}
+
+/*!
+    \brief      get the report of the current report ID, adding it on first use
+    \param[in]  map: pointer to compiled report descriptor
+    \param[in]  parser: pointer to parser state
+    \param[out] none
+    \retval     report index, HID_REPORT_NONE when the table is full
+*/
+static uint8_t hid_report_get (hid_report_map *map, hid_parser *parser)
+{
+    uint8_t id = parser->global.report_id;
+    uint8_t report = map->id_map[id];
+
+    if ((HID_REPORT_NONE == report) && (map->report_num < HID_MAX_REPORTS)) {
+        report = map->report_num++;
+
+        map->report[report].id = id;
+        map->report[report].field_first = map->field_num;
+        map->report[report].field_num = 0U;
+        map->id_map[id] = report;
+
+        /* the report ID byte comes first */
+        parser->bits[report] = (0U != id) ? 8U : 0U;
+    }
+
+    return report;
+}
+
+/*!
+    \brief      add a field, keeping the fields of a report together
+    \param[in]  map: pointer to compiled report descriptor
+    \param[in]  parser: pointer to parser state
+    \param[in]  report: report index
+    \param[in]  bit: bit offset of the first element
+    \param[in]  count: element count
+    \param[in]  flags: HID_FIELD_x
+    \param[in]  usage_min: first usage, page << 16 | usage
+    \param[in]  usage_max: last usage, page << 16 | usage
+    \param[out] none
+    \retval     none
+*/
+static void hid_field_add (hid_report_map *map, hid_parser *parser, uint8_t report, uint32_t bit,
+                           uint32_t count, uint8_t flags, uint32_t usage_min, uint32_t usage_max)
+{
+    hid_report *rep = &map->report[report];
+    uint8_t pos = rep->field_first + rep->field_num;
+    hid_field *field = &map->field[pos];
+
+    if ((map->field_num >= HID_MAX_FIELDS) || (bit > 0xFFFFU)) {
+        return;
+    }
+
+    /* open a slot at the end of the report's fields */
+    memmove((void *)(field + 1), (void *)field, (map->field_num - pos) * sizeof(hid_field));
+
+    for (uint8_t i = 0U; i < map->report_num; i++) {
+        if ((i != report) && (map->report[i].field_first >= pos)) {
+            map->report[i].field_first++;
+        }
+    }
+
+    map->field_num++;
+    rep->field_num++;
+
+    field->bit_offset = (uint16_t)bit;
+    field->bit_size = (uint8_t)parser->global.report_size;
+    field->count = (uint8_t)USB_MIN(count, 0xFFU);
+    field->flags = flags;
+    field->report = report;
+    field->usage_page = (uint16_t)(usage_min >> 16U);
+    field->usage_min = (uint16_t)usage_min;
+    field->usage_max = (uint16_t)usage_max;
+
+    /* a lone usage minimum stands for itself */
+    if (field->usage_max < field->usage_min) {
+        field->usage_max = field->usage_min;
+    }
+    field->mask = (32U == field->bit_size) ? 0xFFFFFFFFU : ((1U << field->bit_size) - 1U);
+    field->logical_min = parser->global.logical_min;
+    field->logical_max = parser->global.logical_max;
+    field->app_usage = parser->app_usage;
+
+    if (field->logical_min < 0) {
+        field->flags |= HID_FIELD_SIGNED;
+    }
+}
+
+/*!
+    \brief      add the fields of an input item
+    \param[in]  map: pointer to compiled report descriptor
+    \param[in]  parser: pointer to parser state
+    \param[in]  flags: input item data
+    \param[out] none
+    \retval     none
+*/
+static void hid_input_add (hid_report_map *map, hid_parser *parser, uint32_t flags)
+{
+    hid_local_state *local = &parser->local;
+    uint32_t size = parser->global.report_size;
+    uint32_t count = parser->global.report_count;
+    uint8_t report = hid_report_get (map, parser);
+    uint32_t bit = 0U;
+
+    if (HID_REPORT_NONE == report) {
+        return;
+    }
+
+    bit = parser->bits[report];
+    parser->bits[report] += size * count;
+
+    /* padding and elements wider than a word take no field */
+    if ((flags & HID_FIELD_CONSTANT) || (0U == size) || (size > 32U) || (0U == count)) {
+        return;
+    }
+
+    flags &= HID_FIELD_CONSTANT | HID_FIELD_VARIABLE | HID_FIELD_RELATIVE;
+
+    if ((flags & HID_FIELD_VARIABLE) && (0U != local->usage_num)) {
+        /* one field per listed usage, the last usage repeats for the remaining elements */
+        for (uint32_t i = 0U; (i < local->usage_num) && (i < count); i++) {
+            uint32_t num = ((i + 1U) == local->usage_num) ? (count - i) : 1U;
+
+            hid_field_add (map, parser, report, bit + i * size, num, (uint8_t)flags, local->usage[i], local->usage[i]);
+        }
+    } else if (0U != local->usage_num) {
+        /* array with listed usages: values index the list, kept as a range */
+        hid_field_add (map, parser, report, bit, count, (uint8_t)flags, local->usage[0], local->usage[local->usage_num - 1U]);
+    } else {
+        hid_field_add (map, parser, report, bit, count, (uint8_t)flags, local->usage_min, local->usage_max);
+    }
+}
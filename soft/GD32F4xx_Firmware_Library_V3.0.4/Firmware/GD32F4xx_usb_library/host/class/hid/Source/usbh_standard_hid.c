@@ -40,8 +40,18 @@ OF SUCH DAMAGE.
 hid_mouse_info mouse_info;
 hid_keybd_info keybd_info;
 
-__ALIGN_BEGIN uint8_t mouse_report_data[4] __ALIGN_END = {0U};
-__ALIGN_BEGIN uint32_t keybd_report_data[2] __ALIGN_END;
+__ALIGN_BEGIN uint32_t mouse_report_data[(HID_MAX_REPORT_SIZE + HID_REPORT_PAD) / 4U] __ALIGN_END = {0U};
+__ALIGN_BEGIN uint32_t keybd_report_data[(HID_MAX_REPORT_SIZE + HID_REPORT_PAD) / 4U] __ALIGN_END;
+
+/* report protocol layout, NULL when the boot layout is used */
+static const hid_report_map *mouse_map = NULL;
+static const hid_report_map *keybd_map = NULL;
+
+static hid_usage_ref mouse_x, mouse_y, mouse_button;
+static hid_usage_ref keybd_lshift, keybd_rshift, keybd_keys;
+
+/* local function prototypes ('static') */
+static uint8_t usbh_hid_mouse_axis (const uint8_t *data, const hid_usage_ref *ref);
 
 /* local constants */
 static const uint8_t kbd_codes[] = 
@@ -146,6 +156,28 @@ static const int8_t kbd_key_shift[] = {
 
 #endif /* QWERTY_KEYBOARD */
 
+/*!
+    \brief      get a mouse axis from a report, limited to the boot report range
+    \param[in]  data: report data
+    \param[in]  ref: axis field
+    \param[out] none
+    \retval     axis value as in the boot report
+*/
+static uint8_t usbh_hid_mouse_axis (const uint8_t *data, const hid_usage_ref *ref)
+{
+    int32_t value = usbh_hid_field_get (data, ref->field, ref->index);
+
+    if (value > 127) {
+        value = 127;
+    } else if (value < -127) {
+        value = -127;
+    } else {
+        /* no operation */
+    }
+
+    return (uint8_t)(int8_t)value;
+}
+
 /*!
     \brief      initialize the mouse function
     \param[in]  udev: pointer to USB core instance
@@ -155,7 +187,7 @@ static const int8_t kbd_key_shift[] = {
 */
 usbh_status usbh_hid_mouse_init (usb_core_driver *udev, usbh_host *uhost)
 {
-    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->active_class->class_data;
+    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->class_data;
 
     mouse_info.x = 0U;
     mouse_info.y = 0U;
@@ -163,12 +195,21 @@ usbh_status usbh_hid_mouse_init (usb_core_driver *udev, usbh_host *uhost)
     mouse_info.buttons[1] = 0U;
     mouse_info.buttons[2] = 0U;
 
-    if(hid->len > sizeof(mouse_report_data)) {
-        hid->len = sizeof(mouse_report_data);
+    if (hid->len > HID_MAX_REPORT_SIZE) {
+        hid->len = HID_MAX_REPORT_SIZE;
     }
 
     hid->pdata = (uint8_t *)(void *)mouse_report_data;
 
+    /* find the boot fields in the report protocol layout */
+    mouse_map = NULL;
+
+    if ((USBH_OK == usbh_hid_usage_find (&hid->report_map, HID_PAGE_GENERIC_DESKTOP, HID_USAGE_X, &mouse_x)) &&
+        (USBH_OK == usbh_hid_usage_find (&hid->report_map, HID_PAGE_GENERIC_DESKTOP, HID_USAGE_Y, &mouse_y)) &&
+        (USBH_OK == usbh_hid_usage_find (&hid->report_map, HID_PAGE_BUTTON, 1U, &mouse_button))) {
+        mouse_map = &hid->report_map;
+    }
+
     usr_mouse_init();
 
     return USBH_OK;
@@ -183,12 +224,30 @@ usbh_status usbh_hid_mouse_init (usb_core_driver *udev, usbh_host *uhost)
 */
 usbh_status usbh_hid_mouse_decode(uint8_t *data)
 {
-    mouse_info.buttons[0] = data[0] & MOUSE_BUTTON_1;
-    mouse_info.buttons[1] = data[0] & MOUSE_BUTTON_2;
-    mouse_info.buttons[2] = data[0] & MOUSE_BUTTON_3;
+    if (NULL != mouse_map) {
+        /* other report IDs of a composite device are not for the mouse */
+        if (mouse_x.field->report != usbh_hid_report_find (mouse_map, data)) {
+            return USBH_FAIL;
+        }
+
+        for (uint8_t i = 0U; i < 3U; i++) {
+            if ((mouse_button.index + i) < mouse_button.field->count) {
+                mouse_info.buttons[i] = usbh_hid_field_raw (data, mouse_button.field, mouse_button.index + i) ? (uint8_t)(1U << i) : 0U;
+            } else {
+                mouse_info.buttons[i] = 0U;
+            }
+        }
+
+        mouse_info.x = usbh_hid_mouse_axis (data, &mouse_x);
+        mouse_info.y = usbh_hid_mouse_axis (data, &mouse_y);
+    } else {
+        mouse_info.buttons[0] = data[0] & MOUSE_BUTTON_1;
+        mouse_info.buttons[1] = data[0] & MOUSE_BUTTON_2;
+        mouse_info.buttons[2] = data[0] & MOUSE_BUTTON_3;
 
-    mouse_info.x = data[1];
-    mouse_info.y = data[2];
+        mouse_info.x = data[1];
+        mouse_info.y = data[2];
+    }
 
     /* handle mouse data position */
     usr_mouse_process_data(&mouse_info);
@@ -205,7 +264,7 @@ usbh_status usbh_hid_mouse_decode(uint8_t *data)
 */
 usbh_status usbh_hid_keybrd_init (usb_core_driver *udev, usbh_host *uhost)
 {
-    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->active_class->class_data;
+    usbh_hid_handler *hid = (usbh_hid_handler *)uhost->class_data;
 
     keybd_info.lctrl = keybd_info.lshift = 0U;
     keybd_info.lalt  = keybd_info.lgui   = 0U;
@@ -216,12 +275,21 @@ usbh_status usbh_hid_keybrd_init (usb_core_driver *udev, usbh_host *uhost)
         keybd_report_data[x] = 0U;
     }
 
-    if (hid->len > (sizeof(keybd_report_data) / sizeof(uint32_t))) {
-        hid->len = (sizeof(keybd_report_data) / sizeof(uint32_t));
+    if (hid->len > HID_MAX_REPORT_SIZE) {
+        hid->len = HID_MAX_REPORT_SIZE;
     }
 
     hid->pdata = (uint8_t*)(void *)keybd_report_data;
 
+    /* find the boot fields in the report protocol layout */
+    keybd_map = NULL;
+
+    if ((USBH_OK == usbh_hid_usage_find (&hid->report_map, HID_PAGE_KEYBOARD, 0xE1U, &keybd_lshift)) &&
+        (USBH_OK == usbh_hid_usage_find (&hid->report_map, HID_PAGE_KEYBOARD, 0xE5U, &keybd_rshift)) &&
+        (USBH_OK == usbh_hid_array_find (&hid->report_map, HID_PAGE_KEYBOARD, &keybd_keys))) {
+        keybd_map = &hid->report_map;
+    }
+
     /* call user initialization*/
     usr_keybrd_init();
 
@@ -257,10 +325,21 @@ usbh_status usbh_hid_keybrd_decode (uint8_t *data)
 {
     uint8_t output;
 
-    keybd_info.lshift = data[0] & KBD_LEFT_SHIFT;
-    keybd_info.rshift = data[0] & KBD_RIGHT_SHIFT;
+    if (NULL != keybd_map) {
+        if (keybd_keys.field->report != usbh_hid_report_find (keybd_map, data)) {
+            return USBH_OK;
+        }
+
+        keybd_info.lshift = usbh_hid_field_raw (data, keybd_lshift.field, keybd_lshift.index) ? KBD_LEFT_SHIFT : 0U;
+        keybd_info.rshift = usbh_hid_field_raw (data, keybd_rshift.field, keybd_rshift.index) ? KBD_RIGHT_SHIFT : 0U;
 
-    keybd_info.keys[0] = data[2];
+        keybd_info.keys[0] = (uint8_t)usbh_hid_field_raw (data, keybd_keys.field, 0U);
+    } else {
+        keybd_info.lshift = data[0] & KBD_LEFT_SHIFT;
+        keybd_info.rshift = data[0] & KBD_RIGHT_SHIFT;
+
+        keybd_info.keys[0] = data[2];
+    }
 
     if (keybd_info.lshift || keybd_info.rshift) {
         output = kbd_key_shift[kbd_codes[keybd_info.keys[0]]];
@@ -0,0 +1,121 @@
+/*!
+    \file    usbh_hub.h
+    \brief   header file for the usbh_hub.c
+
+    \note    extension module of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __USBH_HUB_H
+#define __USBH_HUB_H
+
+#include "usbh_enum.h"
+#include "usbh_transc.h"
+
+/* downstream ports served, ports above this number are left unpowered */
+#ifndef USBH_MAX_HUB_PORTS
+#define USBH_MAX_HUB_PORTS                              4U
+#endif /* USBH_MAX_HUB_PORTS */
+
+#define USB_DESCTYPE_HUB                                0x29U
+#define USB_RECPTYPE_PORT                               0x03U
+#define USB_HUB_DESC_SIZE                               9U
+#define HUB_MIN_POLL                                    8U
+
+/* port features (USB 2.0 table 11-17) */
+#define HUB_PORT_CONNECTION                             0U
+#define HUB_PORT_ENABLE                                 1U
+#define HUB_PORT_RESET                                  4U
+#define HUB_PORT_POWER                                  8U
+#define HUB_C_PORT_CONNECTION                           16U
+
+/* wPortStatus bits */
+#define HUB_PS_CONNECTION                               0x0001U
+#define HUB_PS_ENABLE                                   0x0002U
+#define HUB_PS_OVER_CURRENT                             0x0008U
+#define HUB_PS_RESET                                    0x0010U
+#define HUB_PS_LOW_SPEED                                0x0200U
+#define HUB_PS_HIGH_SPEED                               0x0400U
+
+/* wPortChange bits, wHubChange uses bit 0 and 1 */
+#define HUB_PC_CONNECTION                               0x0001U
+#define HUB_PC_OVER_CURRENT                             0x0008U
+#define HUB_PC_RESET                                    0x0010U
+#define HUB_PC_MASK                                     0x001FU
+
+/* port timings (ms) */
+#define HUB_DEBOUNCE_TIME                               100U
+#define HUB_RESET_RECOVERY_TIME                         10U
+#define HUB_RESET_TIMEOUT                               500U
+#define HUB_ENUM_TIMEOUT                                2000U
+
+/* states for hub state machine */
+typedef enum {
+    HUB_IDLE = 0U,
+    HUB_SYNC,
+    HUB_GET_DATA,
+    HUB_POLL,
+    HUB_PORT_STATUS,
+    HUB_PORT_CHANGE,
+    HUB_PORT_DEBOUNCE,
+    HUB_PORT_RESET_SET,
+    HUB_PORT_RESET_WAIT,
+    HUB_PORT_RECOVERY,
+    HUB_PORT_ENUM,
+    HUB_PORT_DISABLE,
+} hub_state;
+
+typedef enum {
+    HUB_REQ_GET_HUB_DESC = 0U,
+    HUB_REQ_SET_PORT_POWER,
+    HUB_REQ_POWER_WAIT,
+    HUB_REQ_IDLE,
+} hub_ctlstate;
+
+/* state of a downstream port, as seen by the application */
+typedef enum {
+    HUB_PORT_NO_DEVICE = 0U,                            /* nothing attached, or the device left */
+    HUB_PORT_DEVICE,                                    /* device handed to the host core */
+    HUB_PORT_SPEED_NOT_SUPPORTED,                       /* full or low speed device behind a high speed hub:
+                                                           split transactions are not implemented */
+    HUB_PORT_DEV_FAILED,                                /* reset or enumeration failed, or no class serves the device */
+} hub_port_state;
+
+/* structure for hub process */
+typedef struct _hub_process
+{
+    uint32_t             data[16];                      /* hub and port status, word aligned for DMA */
+    uint32_t             change_buf[16];                /* status change bitmap from the interrupt endpoint */
+
+    uint8_t              pipe_in;
+    uint8_t              ep_in;
+    uint16_t             len;
+    uint16_t             poll;
+
+    uint8_t              port_num;                      /* downstream ports in use */
+    uint8_t              port;                          /* port in process, 0 for the hub itself */
+    uint16_t             pwr_good;                      /* power on to power good time (ms) */
+    uint16_t             port_status;
+    uint16_t             port_change;                   /* change bits reported for the port */
+    uint16_t             change_left;                   /* change bits still to be acknowledged */
+    uint32_t             change_map;                    /* ports with changes to process, bit 0 is the hub */
+    uint32_t             dev_map;                       /* ports with an attached device */
+
+    __IO uint32_t        timer;
+    uint32_t             wait_time;
+
+    hub_state            state;
+    hub_ctlstate         ctl_state;
+
+    usbh_host            dev[USBH_MAX_HUB_PORTS];       /* devices on the downstream ports */
+    hub_port_state       port_state[USBH_MAX_HUB_PORTS];
+} usbh_hub_handler;
+
+extern usbh_class usbh_hub;
+
+/* function declarations */
+/* get the state of a downstream port of the hub */
+hub_port_state usbh_hub_port_state_get (usbh_host *uhost, uint8_t port);
+
+#endif /* __USBH_HUB_H */
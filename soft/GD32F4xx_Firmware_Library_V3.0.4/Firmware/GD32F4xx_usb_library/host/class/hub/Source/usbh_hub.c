@@ -0,0 +1,640 @@
+/*!
+    \file    usbh_hub.c
+    \brief   USB host hub class driver
+
+    \note    extension module of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#include <string.h>
+#include "usbh_pipe.h"
+#include "usbh_hub.h"
+
+/* local function prototypes ('static') */
+static usbh_status usbh_hub_itf_init    (usbh_host *uhost);
+static void usbh_hub_itf_deinit         (usbh_host *uhost);
+static usbh_status usbh_hub_class_req   (usbh_host *uhost);
+static usbh_status usbh_hub_handle      (usbh_host *uhost);
+static usbh_status usbh_hub_desc_get    (usbh_host *uhost, uint16_t len);
+static usbh_status usbh_hub_status_get  (usbh_host *uhost, uint8_t port);
+static usbh_status usbh_hub_feature_set (usbh_host *uhost, uint8_t port, uint16_t feature);
+static usbh_status usbh_hub_feature_clr (usbh_host *uhost, uint8_t port, uint16_t feature);
+static void usbh_hub_port_event         (usbh_host *uhost, usbh_hub_handler *hub);
+static void usbh_hub_port_attach        (usbh_host *uhost, usbh_hub_handler *hub);
+static void usbh_hub_timer_start        (usbh_host *uhost, usbh_hub_handler *hub, uint32_t time);
+static uint8_t usbh_hub_timer_expired   (usbh_host *uhost, usbh_hub_handler *hub);
+
+usbh_class usbh_hub = 
+{
+    HUB_CLASS,
+    usbh_hub_itf_init,
+    usbh_hub_itf_deinit,
+    usbh_hub_class_req,
+    usbh_hub_handle,
+    NULL
+};
+
+/*!
+    \brief      initialize the hub class
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hub_itf_init (usbh_host *uhost)
+{
+    uint8_t interface = 0U;
+    usbh_status status = USBH_BUSY;
+
+    interface = usbh_interface_find(&uhost->dev_prop, HUB_CLASS, 0U, 0xFFU);
+
+    /* one hub on the root port, hubs behind it are not served */
+    if ((0xFFU == interface) || (NULL != uhost->parent)) {
+        uhost->usr_cb->dev_not_supported();
+
+        status = USBH_FAIL;
+    } else {
+        usbh_interface_select(&uhost->dev_prop, interface);
+
+        static usbh_hub_handler hub_handler;
+
+        memset((void*)&hub_handler, 0, sizeof(usbh_hub_handler));
+
+        usb_desc_ep *ep_desc = &uhost->dev_prop.cfg_desc_set.itf_desc_set[uhost->dev_prop.cur_itf][0].ep_desc[0];
+
+        hub_handler.state = HUB_SYNC;
+        hub_handler.ctl_state = HUB_REQ_GET_HUB_DESC;
+        hub_handler.ep_in = ep_desc->bEndpointAddress;
+        hub_handler.len = USB_MIN(ep_desc->wMaxPacketSize, sizeof(hub_handler.change_buf));
+
+        /* the poll interval is kept in frame counter units: microframes at high speed */
+        if (PORT_SPEED_HIGH == uhost->dev_prop.speed) {
+            uint8_t interval = USB_MIN(ep_desc->bInterval, 12U);
+
+            hub_handler.poll = (uint16_t)((0U != interval) ? (1U << (interval - 1U)) : 1U);
+        } else {
+            hub_handler.poll = ep_desc->bInterval;
+        }
+
+        if (hub_handler.poll < HUB_MIN_POLL) {
+            hub_handler.poll = HUB_MIN_POLL;
+        }
+
+        hub_handler.pipe_in = usbh_pipe_allocate (uhost->data, hub_handler.ep_in);
+
+        /* open channel for the status change endpoint */
+        usbh_pipe_create (uhost->data,
+                          &uhost->dev_prop,
+                          hub_handler.pipe_in,
+                          USB_EPTYPE_INTR,
+                          hub_handler.len);
+
+        usbh_pipe_toggle_set(uhost->data, hub_handler.pipe_in, 0U);
+
+        uhost->class_data = (void *)&hub_handler;
+
+        status = USBH_OK;
+
+        /* reserve the bus time of the status change polls */
+        if (USBH_OK != usbh_pipe_sched_add (uhost, hub_handler.pipe_in, hub_handler.poll)) {
+            usbh_hub_itf_deinit (uhost);
+
+            uhost->class_data = NULL;
+            uhost->usr_cb->dev_not_supported();
+
+            status = USBH_FAIL;
+        }
+    }
+
+    return status;
+}
+
+/*!
+    \brief      deinitialize the hub and remove the devices behind it
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     none
+*/
+static void usbh_hub_itf_deinit (usbh_host *uhost)
+{
+    usbh_hub_handler *hub = (usbh_hub_handler *)uhost->class_data;
+
+    if (NULL == hub) {
+        return;
+    }
+
+    for (uint8_t port = 1U; port <= USBH_MAX_HUB_PORTS; port++) {
+        if (hub->dev_map & (1U << port)) {
+            usbh_dev_remove (&hub->dev[port - 1U]);
+        }
+
+        hub->port_state[port - 1U] = HUB_PORT_NO_DEVICE;
+    }
+
+    hub->dev_map = 0U;
+
+    if (0x00U != hub->pipe_in) {
+        usbh_pipe_sched_del (uhost, hub->pipe_in);
+
+        usb_pipe_halt (uhost->data, hub->pipe_in);
+
+        usbh_pipe_free (uhost->data, hub->pipe_in);
+
+        hub->pipe_in = 0U;     /* reset the pipe as free */
+    }
+}
+
+/*!
+    \brief      handle hub class requests: read the hub descriptor and power the ports
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hub_class_req (usbh_host *uhost)
+{
+    usbh_status status = USBH_BUSY;
+    usbh_hub_handler *hub = (usbh_hub_handler *)uhost->class_data;
+    uint8_t *desc = (uint8_t *)hub->data;
+
+    switch (hub->ctl_state) {
+    case HUB_REQ_GET_HUB_DESC:
+        if (USBH_OK == usbh_hub_desc_get (uhost, USB_HUB_DESC_SIZE)) {
+            /* bNbrPorts and bPwrOn2PwrGood (2 ms units) */
+            hub->port_num = USB_MIN(desc[2], USBH_MAX_HUB_PORTS);
+            hub->pwr_good = (uint16_t)desc[5] * 2U;
+            hub->port = 1U;
+
+            hub->ctl_state = HUB_REQ_SET_PORT_POWER;
+        }
+        break;
+
+    case HUB_REQ_SET_PORT_POWER:
+        if (hub->port > hub->port_num) {
+            usbh_hub_timer_start (uhost, hub, hub->pwr_good);
+
+            hub->ctl_state = HUB_REQ_POWER_WAIT;
+        } else if (USBH_OK == usbh_hub_feature_set (uhost, hub->port, HUB_PORT_POWER)) {
+            hub->port++;
+        } else {
+            /* no operation */
+        }
+        break;
+
+    case HUB_REQ_POWER_WAIT:
+        /* connection changes are reported once the ports have power */
+        if (usbh_hub_timer_expired (uhost, hub)) {
+            hub->ctl_state = HUB_REQ_IDLE;
+
+            status = USBH_OK;
+        }
+        break;
+
+    case HUB_REQ_IDLE:
+    default:
+        break;
+    }
+
+    return status;
+}
+
+/*!
+    \brief      manage state machine for hub status changes
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hub_handle (usbh_host *uhost)
+{
+    usbh_hub_handler *hub = (usbh_hub_handler *)uhost->class_data;
+    usb_core_driver *udev = (usb_core_driver *)uhost->data;
+    uint8_t *status = (uint8_t *)hub->data;
+
+    switch (hub->state) {
+    case HUB_IDLE:
+        if (0U != hub->change_map) {
+            /* ports are handled one at a time, lowest number first */
+            for (hub->port = 0U; 0U == (hub->change_map & (1U << hub->port)); hub->port++) {
+            }
+
+            hub->change_map &= ~(1U << hub->port);
+            hub->state = HUB_PORT_STATUS;
+        } else {
+            hub->state = HUB_SYNC;
+        }
+        break;
+
+    case HUB_SYNC:
+        /* start in the slot of the pipe */
+        if (0U != usbh_pipe_sched_due (uhost, hub->pipe_in)) {
+            hub->state = HUB_GET_DATA;
+        }
+        break;
+
+    case HUB_GET_DATA:
+        usbh_data_recev (udev, (uint8_t *)hub->change_buf, hub->pipe_in, hub->len);
+
+        hub->state = HUB_POLL;
+        break;
+
+    case HUB_POLL:
+        if (URB_DONE == usbh_urbstate_get (udev, hub->pipe_in)) {
+            uint8_t *map = (uint8_t *)hub->change_buf;
+            uint32_t count = USB_MIN(usbh_xfercount_get (udev, hub->pipe_in), sizeof(uint32_t));
+
+            for (uint32_t i = 0U; i < count; i++) {
+                hub->change_map |= (uint32_t)map[i] << (8U * i);
+            }
+
+            hub->change_map &= (2U << hub->port_num) - 1U;
+
+            if (0U != hub->change_map) {
+                hub->state = HUB_IDLE;
+            }
+        } else if (URB_STALL == usbh_urbstate_get (udev, hub->pipe_in)) {
+            /* issue clear feature on interrupt in endpoint */
+            if (USBH_OK == usbh_clrfeature (uhost, hub->ep_in, hub->pipe_in)) {
+                hub->state = HUB_GET_DATA;
+            }
+        } else {
+            /* no operation */
+        }
+
+        /* the hub NAKs the endpoint until a change shows up, poll it again in the next slot */
+        if ((HUB_POLL == hub->state) && (0U != usbh_pipe_sched_due (uhost, hub->pipe_in))) {
+            hub->state = HUB_GET_DATA;
+        }
+        break;
+
+    case HUB_PORT_STATUS:
+        if (USBH_OK == usbh_hub_status_get (uhost, hub->port)) {
+            hub->port_status = BYTE_SWAP(&status[0]);
+            hub->port_change = BYTE_SWAP(&status[2]);
+            hub->change_left = hub->port_change & HUB_PC_MASK;
+
+            hub->state = HUB_PORT_CHANGE;
+        }
+        break;
+
+    case HUB_PORT_CHANGE:
+        if (0U != hub->change_left) {
+            /* acknowledge the change bits one by one, C_PORT_x = 16 + x, C_HUB_x = x */
+            uint16_t bit = 0U;
+
+            while (0U == (hub->change_left & (1U << bit))) {
+                bit++;
+            }
+
+            if (USBH_OK == usbh_hub_feature_clr (uhost, hub->port, (0U != hub->port) ? (HUB_C_PORT_CONNECTION + bit) : bit)) {
+                hub->change_left &= ~(1U << bit);
+            }
+        } else {
+            usbh_hub_port_event (uhost, hub);
+        }
+        break;
+
+    case HUB_PORT_DEBOUNCE:
+        if (usbh_hub_timer_expired (uhost, hub)) {
+            hub->state = HUB_PORT_RESET_SET;
+        }
+        break;
+
+    case HUB_PORT_RESET_SET:
+        if (USBH_OK == usbh_hub_feature_set (uhost, hub->port, HUB_PORT_RESET)) {
+            usbh_hub_timer_start (uhost, hub, HUB_RESET_TIMEOUT);
+
+            hub->state = HUB_PORT_RESET_WAIT;
+        }
+        break;
+
+    case HUB_PORT_RESET_WAIT:
+        if (USBH_OK == usbh_hub_status_get (uhost, hub->port)) {
+            hub->port_status = BYTE_SWAP(&status[0]);
+            hub->port_change = BYTE_SWAP(&status[2]);
+
+            if ((hub->port_change & HUB_PC_RESET) && (0U == (hub->port_status & HUB_PS_RESET))) {
+                hub->change_left = HUB_PC_RESET;
+
+                usbh_hub_timer_start (uhost, hub, HUB_RESET_RECOVERY_TIME);
+
+                hub->state = HUB_PORT_RECOVERY;
+            } else if (usbh_hub_timer_expired (uhost, hub)) {
+                hub->port_state[hub->port - 1U] = HUB_PORT_DEV_FAILED;
+                hub->state = HUB_PORT_DISABLE;
+            } else {
+                /* no operation */
+            }
+        }
+        break;
+
+    case HUB_PORT_RECOVERY:
+        if (0U != hub->change_left) {
+            if (USBH_OK == usbh_hub_feature_clr (uhost, hub->port, HUB_C_PORT_CONNECTION + 4U)) {
+                hub->change_left = 0U;
+            }
+        } else if (usbh_hub_timer_expired (uhost, hub)) {
+            usbh_hub_port_attach (uhost, hub);
+        } else {
+            /* no operation */
+        }
+        break;
+
+    case HUB_PORT_ENUM:
+        {
+            usbh_host *dev = &hub->dev[hub->port - 1U];
+
+            /* keep the other ports waiting while this device answers on address 0 */
+            if ((HOST_DEV_CONNECT == dev->cur_state) || (HOST_DEV_ENUM == dev->cur_state)) {
+                if (usbh_hub_timer_expired (uhost, hub)) {
+                    usbh_dev_remove (dev);
+
+                    hub->dev_map &= ~(1U << hub->port);
+                    hub->port_state[hub->port - 1U] = HUB_PORT_DEV_FAILED;
+                    hub->state = HUB_PORT_DISABLE;
+                }
+            } else if ((HOST_DEFAULT == dev->cur_state) || (HOST_ERROR == dev->cur_state)) {
+                usbh_dev_remove (dev);
+
+                hub->dev_map &= ~(1U << hub->port);
+                hub->port_state[hub->port - 1U] = HUB_PORT_DEV_FAILED;
+                hub->state = HUB_PORT_DISABLE;
+            } else {
+                hub->state = HUB_IDLE;
+            }
+        }
+        break;
+
+    case HUB_PORT_DISABLE:
+        if (USBH_OK == usbh_hub_feature_clr (uhost, hub->port, HUB_PORT_ENABLE)) {
+            hub->state = HUB_IDLE;
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      get the state of a downstream port of the hub
+    \param[in]  uhost: pointer to any USB host of the device tree
+    \param[in]  port: port number, from 1
+    \param[out] none
+    \retval     port state, HUB_PORT_NO_DEVICE when no hub is served or the port is not in use
+*/
+hub_port_state usbh_hub_port_state_get (usbh_host *uhost, uint8_t port)
+{
+    usbh_host *hub_host = usbh_class_dev_get (uhost, &usbh_hub, 0U);
+    usbh_hub_handler *hub;
+
+    if ((NULL == hub_host) || (0U == port)) {
+        return HUB_PORT_NO_DEVICE;
+    }
+
+    hub = (usbh_hub_handler *)hub_host->class_data;
+
+    if (port > hub->port_num) {
+        return HUB_PORT_NO_DEVICE;
+    }
+
+    return hub->port_state[port - 1U];
+}
+
+/*!
+    \brief      act on the port status once its change bits are acknowledged
+    \param[in]  uhost: pointer to USB host
+    \param[in]  hub: pointer to hub handler
+    \param[out] none
+    \retval     none
+*/
+static void usbh_hub_port_event (usbh_host *uhost, usbh_hub_handler *hub)
+{
+    uint32_t port_bit = 1U << hub->port;
+
+    hub->state = HUB_IDLE;
+
+    if (0U == hub->port) {
+        /* hub change: local power or over-current */
+        if (hub->port_change & 0x0002U) {
+            uhost->usr_cb->dev_over_currented();
+        }
+
+        return;
+    }
+
+    if ((hub->port_change & HUB_PC_OVER_CURRENT) && (hub->port_status & HUB_PS_OVER_CURRENT)) {
+        uhost->usr_cb->dev_over_currented();
+    }
+
+    /* a connection change on an occupied port means the device went away, maybe to come back */
+    if ((hub->dev_map & port_bit) && 
+        ((0U == (hub->port_status & HUB_PS_CONNECTION)) || (hub->port_change & HUB_PC_CONNECTION))) {
+        usbh_dev_remove (&hub->dev[hub->port - 1U]);
+
+        hub->dev_map &= ~port_bit;
+    }
+
+    if ((hub->port_change & HUB_PC_CONNECTION) || (0U == (hub->port_status & HUB_PS_CONNECTION))) {
+        hub->port_state[hub->port - 1U] = HUB_PORT_NO_DEVICE;
+    }
+
+    if ((hub->port_change & HUB_PC_CONNECTION) && (hub->port_status & HUB_PS_CONNECTION)) {
+        usbh_hub_timer_start (uhost, hub, HUB_DEBOUNCE_TIME);
+
+        hub->state = HUB_PORT_DEBOUNCE;
+    }
+}
+
+/*!
+    \brief      hand a freshly reset port over to the host core
+    \param[in]  uhost: pointer to USB host
+    \param[in]  hub: pointer to hub handler
+    \param[out] none
+    \retval     none
+*/
+static void usbh_hub_port_attach (usbh_host *uhost, usbh_hub_handler *hub)
+{
+    uint32_t speed = PORT_SPEED_FULL;
+
+    if ((0U == (hub->port_status & HUB_PS_CONNECTION)) || (0U == (hub->port_status & HUB_PS_ENABLE))) {
+        /* the device left during reset, its connection change is pending */
+        hub->state = HUB_IDLE;
+        return;
+    }
+
+    if (hub->port_status & HUB_PS_LOW_SPEED) {
+        speed = PORT_SPEED_LOW;
+    } else if (hub->port_status & HUB_PS_HIGH_SPEED) {
+        speed = PORT_SPEED_HIGH;
+    } else {
+        /* no operation */
+    }
+
+    if ((PORT_SPEED_HIGH == uhost->dev_prop.speed) && (PORT_SPEED_HIGH != speed)) {
+        /* full and low speed devices behind a high speed hub need split transactions, which are not implemented */
+        uhost->usr_cb->dev_not_supported();
+
+        hub->port_state[hub->port - 1U] = HUB_PORT_SPEED_NOT_SUPPORTED;
+        hub->state = HUB_PORT_DISABLE;
+    } else {
+        usbh_dev_attach (uhost, &hub->dev[hub->port - 1U], hub->port, USBH_DEV_ADDR + hub->port, speed);
+
+        hub->dev_map |= 1U << hub->port;
+        hub->port_state[hub->port - 1U] = HUB_PORT_DEVICE;
+
+        usbh_hub_timer_start (uhost, hub, HUB_ENUM_TIMEOUT);
+
+        hub->state = HUB_PORT_ENUM;
+    }
+}
+
+/*!
+    \brief      start the hub timer
+    \param[in]  uhost: pointer to USB host
+    \param[in]  hub: pointer to hub handler
+    \param[in]  time: time in ms
+    \param[out] none
+    \retval     none
+*/
+static void usbh_hub_timer_start (usbh_host *uhost, usbh_hub_handler *hub, uint32_t time)
+{
+    hub->timer = usb_curframe_get (uhost->data);
+
+    /* the frame counter runs in microframes at high speed */
+    hub->wait_time = (PORT_SPEED_HIGH == uhost->dev_prop.speed) ? (time * 8U) : time;
+}
+
+/*!
+    \brief      check the hub timer
+    \param[in]  uhost: pointer to USB host
+    \param[in]  hub: pointer to hub handler
+    \param[out] none
+    \retval     1 when the time is up
+*/
+static uint8_t usbh_hub_timer_expired (usbh_host *uhost, usbh_hub_handler *hub)
+{
+    uint32_t frame_count = usb_curframe_get (uhost->data);
+
+    if (frame_count >= hub->timer) {
+        return (uint8_t)((frame_count - hub->timer) >= hub->wait_time);
+    } else {
+        return (uint8_t)((frame_count + 0x3FFFU - hub->timer) >= hub->wait_time);
+    }
+}
+
+/*!
+    \brief      send get hub descriptor command to the device
+    \param[in]  uhost: pointer to USB host
+    \param[in]  len: hub descriptor length
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hub_desc_get (usbh_host *uhost, uint16_t len)
+{
+    usbh_status status = USBH_BUSY;
+    usbh_hub_handler *hub = (usbh_hub_handler *)uhost->class_data;
+
+    if (CTL_IDLE == uhost->control.ctl_state) {
+        uhost->control.setup.req = (usb_req) {
+            .bmRequestType = USB_TRX_IN | USB_RECPTYPE_DEV | USB_REQTYPE_CLASS,
+            .bRequest      = USB_GET_DESCRIPTOR,
+            .wValue        = USBH_DESC(USB_DESCTYPE_HUB),
+            .wIndex        = 0U,
+            .wLength       = len
+        };
+
+        usbh_ctlstate_config (uhost, (uint8_t *)hub->data, len);
+    }
+
+    status = usbh_ctl_handler (uhost);
+
+    return status;
+}
+
+/*!
+    \brief      send get status command for the hub or one of its ports
+    \param[in]  uhost: pointer to USB host
+    \param[in]  port: port number, 0 for the hub itself
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hub_status_get (usbh_host *uhost, uint8_t port)
+{
+    usbh_status status = USBH_BUSY;
+    usbh_hub_handler *hub = (usbh_hub_handler *)uhost->class_data;
+
+    if (CTL_IDLE == uhost->control.ctl_state) {
+        uhost->control.setup.req = (usb_req) {
+            .bmRequestType = USB_TRX_IN | USB_REQTYPE_CLASS | ((0U != port) ? USB_RECPTYPE_PORT : USB_RECPTYPE_DEV),
+            .bRequest      = USB_GET_STATUS,
+            .wValue        = 0U,
+            .wIndex        = port,
+            .wLength       = 4U
+        };
+
+        usbh_ctlstate_config (uhost, (uint8_t *)hub->data, 4U);
+    }
+
+    status = usbh_ctl_handler (uhost);
+
+    return status;
+}
+
+/*!
+    \brief      send set feature command for the hub or one of its ports
+    \param[in]  uhost: pointer to USB host
+    \param[in]  port: port number, 0 for the hub itself
+    \param[in]  feature: feature selector
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hub_feature_set (usbh_host *uhost, uint8_t port, uint16_t feature)
+{
+    usbh_status status = USBH_BUSY;
+
+    if (CTL_IDLE == uhost->control.ctl_state) {
+        uhost->control.setup.req = (usb_req) {
+            .bmRequestType = USB_TRX_OUT | USB_REQTYPE_CLASS | ((0U != port) ? USB_RECPTYPE_PORT : USB_RECPTYPE_DEV),
+            .bRequest      = USB_SET_FEATURE,
+            .wValue        = feature,
+            .wIndex        = port,
+            .wLength       = 0U
+        };
+
+        usbh_ctlstate_config (uhost, NULL, 0U);
+    }
+
+    status = usbh_ctl_handler (uhost);
+
+    return status;
+}
+
+/*!
+    \brief      send clear feature command for the hub or one of its ports
+    \param[in]  uhost: pointer to USB host
+    \param[in]  port: port number, 0 for the hub itself
+    \param[in]  feature: feature selector
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_hub_feature_clr (usbh_host *uhost, uint8_t port, uint16_t feature)
+{
+    usbh_status status = USBH_BUSY;
+
+    if (CTL_IDLE == uhost->control.ctl_state) {
+        uhost->control.setup.req = (usb_req) {
+            .bmRequestType = USB_TRX_OUT | USB_REQTYPE_CLASS | ((0U != port) ? USB_RECPTYPE_PORT : USB_RECPTYPE_DEV),
+            .bRequest      = USB_CLEAR_FEATURE,
+            .wValue        = feature,
+            .wIndex        = port,
+            .wLength       = 0U
+        };
+
+        usbh_ctlstate_config (uhost, NULL, 0U);
+    }
+
+    status = usbh_ctl_handler (uhost);
+
+    return status;
+}
@@ -107,6 +107,8 @@ typedef enum
 typedef struct
 {
     uint8_t                *pbuf;
+    uint32_t                urb_len;                /* length of the data stage transfer on the bus */
+    uint8_t                 err_count;              /* IN transfers lost in a row */
     uint32_t                data[16];
     bbb_state               state;
     bbb_state               prev_state;
@@ -119,6 +121,8 @@ typedef struct
 
 #define USBH_MSC_CSW_MAX_LENGTH             63U
 
+#define USBH_MSC_BBB_MAX_ERR                3U      /* lost IN transfers before the reset recovery */
+
 #define USBH_MSC_SEND_CSW_DISABLE           0U
 #define USBH_MSC_SEND_CSW_ENABLE            1U
 
@@ -43,6 +43,21 @@ OF SUCH DAMAGE.
 
 #define MSC_MAX_SUPPORTED_LUN                   2U
 
+/* blocks carried by one READ10/WRITE10 command, longer transfers are split */
+#ifndef USBH_MSC_MAX_XFER_BLOCKS
+    #define USBH_MSC_MAX_XFER_BLOCKS            128U
+#endif
+
+/* devices served at the same time behind a hub, each takes a handler of its own */
+#ifndef USBH_MSC_MAX_DEV
+    #define USBH_MSC_MAX_DEV                    1U
+#endif
+
+/* size in bytes of the read-ahead buffer for sequential reads, 0 to disable */
+#ifndef USBH_MSC_READ_AHEAD_SIZE
+    #define USBH_MSC_READ_AHEAD_SIZE            0U
+#endif
+
 typedef enum
 {
     MSC_INIT = 0U,
@@ -84,6 +99,21 @@ typedef struct
     uint8_t                 state_changed;
 } msc_lun;
 
+/* structure for asynchronous read/write transfer */
+typedef struct _msc_xfer
+{
+    struct _msc_xfer       *next;                       /* next transfer in the queue */
+    void                  (*complete)(struct _msc_xfer *xfer); /* completion callback, NULL to poll status */
+    void                   *context;                    /* user context of the completion callback */
+    uint8_t                *pbuf;                       /* data buffer */
+    uint32_t                address;                    /* logical block address */
+    uint32_t                length;                     /* number of blocks */
+    uint32_t                timer;                      /* start time of the transfer */
+    uint8_t                 lun;                        /* logic unit number */
+    msc_state               dir;                        /* MSC_READ or MSC_WRITE */
+    volatile usbh_status    status;                     /* USBH_BUSY until the transfer ends */
+} msc_xfer;
+
 /* structure for msc process */
 typedef struct _msc_process
 {
@@ -103,6 +133,19 @@ typedef struct _msc_process
     bbb_handle      bbb;
     msc_lun         unit[MSC_MAX_SUPPORTED_LUN];
     uint32_t        timer;
+    msc_xfer       *xfer_head;
+    msc_xfer       *xfer_tail;
+    uint32_t        xfer_done;                          /* blocks of the head transfer done */
+    uint32_t        cmd_address;                        /* logical block address of the command in progress */
+    uint32_t        cmd_length;                         /* number of blocks of the command in progress */
+#if USBH_MSC_READ_AHEAD_SIZE > 0U
+    uint32_t        ra_buf[USBH_MSC_READ_AHEAD_SIZE / 4U];  /* read-ahead buffer */
+    uint32_t        ra_address;                         /* first block held in the read-ahead buffer */
+    uint32_t        ra_length;                          /* number of blocks held, 0 when empty */
+    uint32_t        ra_next;                            /* block after the last read, to detect sequential reads */
+    uint8_t         ra_lun;                             /* logic unit of the read-ahead data */
+    uint8_t         ra_fill;                            /* the command in progress fills the read-ahead buffer */
+#endif /* USBH_MSC_READ_AHEAD_SIZE > 0U */
 } usbh_msc_handler;
 
 extern usbh_class usbh_msc;
@@ -122,5 +165,11 @@ usbh_status usbh_msc_write (usbh_host *uhost,
                             uint32_t address,
                             uint8_t *pbuf,
                             uint32_t length);
+/* queue an asynchronous msc read/write transfer */
+usbh_status usbh_msc_submit (usbh_host *uhost, msc_xfer *xfer);
+/* advance the queued msc transfers */
+usbh_status usbh_msc_xfer_process (usbh_host *uhost);
+/* set the function called while the msc diskio waits for a transfer */
+void usbh_msc_fatfs_idle_set (void (*idle)(void));
 
 #endif /* __USBH_MSC_CORE_H */
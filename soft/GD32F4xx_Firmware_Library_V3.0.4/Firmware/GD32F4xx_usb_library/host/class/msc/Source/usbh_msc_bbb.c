@@ -41,6 +41,12 @@ OF SUCH DAMAGE.
 #include "usbh_transc.h"
 #include "drv_usbh_int.h"
 
+/* local function prototypes ('static') */
+static uint32_t usbh_msc_bbb_urb_len    (uint32_t len, uint16_t mps);
+static void usbh_msc_bbb_data_in        (usbh_host *uhost);
+static void usbh_msc_bbb_data_out       (usbh_host *uhost);
+static void usbh_msc_bbb_csw_recev      (usbh_host *uhost);
+
 /*!
     \brief      initialize the mass storage parameters
     \param[in]  uhost: pointer to USB host handler
@@ -49,12 +55,13 @@ OF SUCH DAMAGE.
 */
 void usbh_msc_bbb_init (usbh_host *uhost)
 {
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     msc->bbb.cbw.field.dCBWSignature = BBB_CBW_SIGNATURE;
     msc->bbb.cbw.field.dCBWTag = USBH_MSC_BBB_CBW_TAG;
     msc->bbb.state = BBB_SEND_CBW;
     msc->bbb.cmd_state = BBB_CMD_SEND;
+    msc->bbb.err_count = 0U;
 }
 
 /*!
@@ -70,7 +77,7 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
     usbh_status status = USBH_BUSY;
     usbh_status error = USBH_BUSY;
     usb_urb_state urb_status = URB_IDLE;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     switch (msc->bbb.state) {
     case BBB_SEND_CBW:
@@ -87,14 +94,15 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
         urb_status = usbh_urbstate_get(uhost->data, msc->pipe_out);
 
         if (URB_DONE == urb_status) {
+            /* start the next stage right away */
             if (0U != msc->bbb.cbw.field.dCBWDataTransferLength) {
                 if (USB_TRX_IN == (msc->bbb.cbw.field.bmCBWFlags & USB_TRX_MASK)) {
-                    msc->bbb.state = BBB_DATA_IN;
+                    usbh_msc_bbb_data_in (uhost);
                 } else {
-                    msc->bbb.state = BBB_DATA_OUT;
+                    usbh_msc_bbb_data_out (uhost);
                 }
             } else {
-                msc->bbb.state = BBB_RECEIVE_CSW;
+                usbh_msc_bbb_csw_recev (uhost);
             }
 
         } else if (URB_NOTREADY == urb_status) {
@@ -107,12 +115,7 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
         break;
 
     case BBB_DATA_IN:
-        usbh_data_recev (uhost->data, 
-                         msc->bbb.pbuf, 
-                         msc->pipe_in, 
-                         msc->ep_size_in);
-
-        msc->bbb.state = BBB_DATA_IN_WAIT;
+        usbh_msc_bbb_data_in (uhost);
         break;
 
     case BBB_DATA_IN_WAIT:
@@ -120,58 +123,79 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
 
         /* BBB DATA IN stage */
         if (URB_DONE == urb_status) {
-            if (msc->bbb.cbw.field.dCBWDataTransferLength > msc->ep_size_in) {
-                msc->bbb.pbuf += msc->ep_size_in;
-                msc->bbb.cbw.field.dCBWDataTransferLength -= msc->ep_size_in;
-            } else {
-                msc->bbb.cbw.field.dCBWDataTransferLength = 0U;
+            uint32_t count = usbh_xfercount_get (uhost->data, msc->pipe_in);
+
+            if (count > msc->bbb.cbw.field.dCBWDataTransferLength) {
+                count = msc->bbb.cbw.field.dCBWDataTransferLength;
             }
 
-            if (msc->bbb.cbw.field.dCBWDataTransferLength > 0U) {
-                usbh_data_recev (uhost->data, 
-                                 msc->bbb.pbuf, 
-                                 msc->pipe_in, 
-                                 msc->ep_size_in);
+            msc->bbb.pbuf += count;
+            msc->bbb.cbw.field.dCBWDataTransferLength -= count;
+            msc->bbb.err_count = 0U;
+
+            /* a short packet ends the data stage early */
+            if ((msc->bbb.cbw.field.dCBWDataTransferLength > 0U) && (count == msc->bbb.urb_len)) {
+                usbh_msc_bbb_data_in (uhost);
             } else {
-                msc->bbb.state = BBB_RECEIVE_CSW;
+                usbh_msc_bbb_csw_recev (uhost);
             }
         } else if(URB_STALL == urb_status) {
             /* this is data stage stall condition */
             msc->bbb.state = BBB_ERROR_IN;
+        } else if (URB_ERROR == urb_status) {
+            /* a packet was lost (babble), resume after the packets received */
+            uint32_t count = usbh_xfercount_get (uhost->data, msc->pipe_in);
+
+            if (count > msc->bbb.urb_len) {
+                count = msc->bbb.urb_len;
+            }
+
+            msc->bbb.pbuf += count;
+            msc->bbb.cbw.field.dCBWDataTransferLength -= count;
+
+            /* count the losses without progress only */
+            if (count > 0U) {
+                msc->bbb.err_count = 0U;
+            }
+
+            if (++msc->bbb.err_count < USBH_MSC_BBB_MAX_ERR) {
+                msc->bbb.state = BBB_DATA_IN;
+            } else {
+                msc->bbb.err_count = 0U;
+                msc->bbb.state = BBB_UNRECOVERED_ERROR;
+            }
         } else {
             /* no operation */
         }
         break;
 
     case BBB_DATA_OUT:
-        usbh_data_send (uhost->data,
-                        msc->bbb.pbuf, 
-                        msc->pipe_out, 
-                        msc->ep_size_out);
-
-        msc->bbb.state = BBB_DATA_OUT_WAIT;
+        usbh_msc_bbb_data_out (uhost);
         break;
 
     case BBB_DATA_OUT_WAIT:
         /* BBB DATA OUT stage */
         urb_status = usbh_urbstate_get(uhost->data, msc->pipe_out);
         if (URB_DONE == urb_status) {
-            if (msc->bbb.cbw.field.dCBWDataTransferLength > msc->ep_size_out) {
-                msc->bbb.pbuf += msc->ep_size_out;
-                msc->bbb.cbw.field.dCBWDataTransferLength -= msc->ep_size_out;
-            }  else {
-                msc->bbb.cbw.field.dCBWDataTransferLength = 0; /* reset this value and keep in same state */
-            }
+            msc->bbb.pbuf += msc->bbb.urb_len;
+            msc->bbb.cbw.field.dCBWDataTransferLength -= msc->bbb.urb_len;
 
-            if (msc->bbb.cbw.field.dCBWDataTransferLength > 0) {
-                usbh_data_send (uhost->data,
-                                msc->bbb.pbuf, 
-                                msc->pipe_out, 
-                                msc->ep_size_out);
+            if (msc->bbb.cbw.field.dCBWDataTransferLength > 0U) {
+                usbh_msc_bbb_data_out (uhost);
             } else {
-                msc->bbb.state = BBB_RECEIVE_CSW;
+                usbh_msc_bbb_csw_recev (uhost);
             }
         } else if (URB_NOTREADY == urb_status) {
+            /* resume after the packets the device has already acknowledged */
+            uint32_t count = usbh_xfercount_get (uhost->data, msc->pipe_out);
+
+            if (count > msc->bbb.urb_len) {
+                count = msc->bbb.urb_len;
+            }
+
+            msc->bbb.pbuf += count;
+            msc->bbb.cbw.field.dCBWDataTransferLength -= count;
+
             msc->bbb.state = BBB_DATA_OUT;
         } else if (URB_STALL == urb_status) {
             msc->bbb.state = BBB_ERROR_OUT;
@@ -181,13 +205,7 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
         break;
 
     case BBB_RECEIVE_CSW:
-        /* BBB CSW stage */
-        usbh_data_recev (uhost->data,
-                         msc->bbb.csw.CSWArray, 
-                         msc->pipe_in, 
-                         BBB_CSW_LENGTH);
-
-        msc->bbb.state = BBB_RECEIVE_CSW_WAIT;
+        usbh_msc_bbb_csw_recev (uhost);
         break;
 
     case BBB_RECEIVE_CSW_WAIT:
@@ -197,6 +215,7 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
         if (URB_DONE == urb_status) {
             msc->bbb.state = BBB_SEND_CBW;
             msc->bbb.cmd_state = BBB_CMD_SEND;
+            msc->bbb.err_count = 0U;
 
             csw_status = usbh_msc_csw_decode(uhost);
             if (BBB_CSW_CMD_PASSED == csw_status) {
@@ -206,6 +225,14 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
             }
         } else if (URB_STALL == urb_status) {
             msc->bbb.state = BBB_ERROR_IN;
+        } else if (URB_ERROR == urb_status) {
+            /* the CSW was lost (babble), receive it again */
+            if (++msc->bbb.err_count < USBH_MSC_BBB_MAX_ERR) {
+                msc->bbb.state = BBB_RECEIVE_CSW;
+            } else {
+                msc->bbb.err_count = 0U;
+                msc->bbb.state = BBB_UNRECOVERED_ERROR;
+            }
         } else {
             /* no operation */
         }
@@ -242,7 +269,10 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
     case BBB_UNRECOVERED_ERROR:
         status = usbh_msc_bbb_reset(uhost);
         if (USBH_OK == status) {
+            /* the command did not complete, do not report its data as valid */
             msc->bbb.state = BBB_SEND_CBW;
+            msc->bbb.cmd_state = BBB_CMD_SEND;
+            status = USBH_FAIL;
         }
         break;
 
@@ -263,7 +293,7 @@ usbh_status usbh_msc_bbb_process (usbh_host *uhost, uint8_t lun)
 usbh_status usbh_msc_bbb_abort (usbh_host *uhost, uint8_t direction)
 {
     usbh_status status = USBH_BUSY;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     switch (direction) {
     case USBH_MSC_DIR_IN :
@@ -330,7 +360,7 @@ usbh_status usbh_msc_bbb_reset (usbh_host *uhost)
 bbb_csw_status usbh_msc_csw_decode (usbh_host *uhost)
 {
     bbb_csw_status status = BBB_CSW_CMD_FAILED;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     /* checking if the transfer length is different than 13 */
     if (BBB_CSW_LENGTH != usbh_xfercount_get (uhost->data, msc->pipe_in)) {
@@ -362,3 +392,92 @@ bbb_csw_status usbh_msc_csw_decode (usbh_host *uhost)
 
     return status;
 }
+
+/*!
+    \brief      get the length of the next data stage transfer, as many packets as a pipe transfer can carry
+    \param[in]  len: remaining length of the data stage
+    \param[in]  mps: max packet size of the endpoint
+    \param[out] none
+    \retval     length of the transfer
+*/
+static uint32_t usbh_msc_bbb_urb_len (uint32_t len, uint16_t mps)
+{
+    uint32_t max_len = HC_MAX_PACKET_COUNT;
+
+    /* the pipe transfer length is 16 bits wide */
+    if (max_len > (0xFFFFU / mps)) {
+        max_len = 0xFFFFU / mps;
+    }
+
+    max_len *= mps;
+
+    return (len > max_len) ? max_len : len;
+}
+
+/*!
+    \brief      start a data IN stage transfer
+    \param[in]  uhost: pointer to USB host handler
+    \param[out] none
+    \retval     none
+*/
+static void usbh_msc_bbb_data_in (usbh_host *uhost)
+{
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+
+    msc->bbb.urb_len = usbh_msc_bbb_urb_len (msc->bbb.cbw.field.dCBWDataTransferLength, msc->ep_size_in);
+
+    usbh_data_recev (uhost->data, 
+                     msc->bbb.pbuf, 
+                     msc->pipe_in, 
+                     (uint16_t)msc->bbb.urb_len);
+
+    msc->bbb.state = BBB_DATA_IN_WAIT;
+}
+
+/*!
+    \brief      start a data OUT stage transfer
+    \param[in]  uhost: pointer to USB host handler
+    \param[out] none
+    \retval     none
+*/
+static void usbh_msc_bbb_data_out (usbh_host *uhost)
+{
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+    usb_core_driver *udev = (usb_core_driver *)uhost->data;
+
+    if ((uint8_t)USB_USE_DMA == udev->bp.transfer_mode) {
+        msc->bbb.urb_len = usbh_msc_bbb_urb_len (msc->bbb.cbw.field.dCBWDataTransferLength, msc->ep_size_out);
+    } else {
+        /* the Tx FIFO is loaded with the whole transfer at once, keep it to a packet */
+        msc->bbb.urb_len = msc->bbb.cbw.field.dCBWDataTransferLength;
+
+        if (msc->bbb.urb_len > msc->ep_size_out) {
+            msc->bbb.urb_len = msc->ep_size_out;
+        }
+    }
+
+    usbh_data_send (uhost->data,
+                    msc->bbb.pbuf, 
+                    msc->pipe_out, 
+                    (uint16_t)msc->bbb.urb_len);
+
+    msc->bbb.state = BBB_DATA_OUT_WAIT;
+}
+
+/*!
+    \brief      start the CSW stage transfer
+    \param[in]  uhost: pointer to USB host handler
+    \param[out] none
+    \retval     none
+*/
+static void usbh_msc_bbb_csw_recev (usbh_host *uhost)
+{
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+
+    usbh_data_recev (uhost->data,
+                     msc->bbb.csw.CSWArray, 
+                     msc->pipe_in, 
+                     BBB_CSW_LENGTH);
+
+    msc->bbb.state = BBB_RECEIVE_CSW_WAIT;
+}
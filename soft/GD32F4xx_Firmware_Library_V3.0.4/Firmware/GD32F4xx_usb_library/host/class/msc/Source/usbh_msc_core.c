@@ -49,6 +49,10 @@ static usbh_status usbh_msc_req         (usbh_host *uhost);
 static usbh_status usbh_msc_handle      (usbh_host *uhost);
 static usbh_status usbh_msc_maxlun_get  (usbh_host *uhost, uint8_t *maxlun);
 static usbh_status usbh_msc_rdwr_process(usbh_host *uhost, uint8_t lun);
+static usbh_status usbh_msc_xfer_start (usbh_host *uhost);
+static usbh_status usbh_msc_cmd_start   (usbh_host *uhost);
+static usbh_status usbh_msc_cmd_end     (usbh_host *uhost);
+static void usbh_msc_xfer_end           (usbh_host *uhost, usbh_status status);
 
 usbh_class usbh_msc = 
 {
@@ -59,6 +63,10 @@ usbh_class usbh_msc =
     usbh_msc_handle,
 };
 
+/* handlers of the devices served, a device behind a hub takes a free one */
+static usbh_msc_handler msc_handler[USBH_MSC_MAX_DEV];
+static usbh_host *msc_owner[USBH_MSC_MAX_DEV];
+
 /*!
     \brief      interface initialization for MSC class
     \param[in]  uhost: pointer to USB host
@@ -68,65 +76,78 @@ usbh_class usbh_msc =
 static usbh_status usbh_msc_itf_init (usbh_host *uhost)
 {
     usbh_status status = USBH_OK;
+    usbh_msc_handler *msc = NULL;
 
     uint8_t interface = usbh_interface_find(&uhost->dev_prop, MSC_CLASS, USB_MSC_SUBCLASS_SCSI, MSC_PROTOCOL);
 
-    if (0xFFU == interface) {
+    /* each device takes a handler of its own and keeps it when initialized again */
+    for (uint8_t i = 0U; (0xFFU != interface) && (i < USBH_MSC_MAX_DEV); i++) {
+        if (uhost == msc_owner[i]) {
+            msc = &msc_handler[i];
+        }
+    }
+
+    for (uint8_t i = 0U; (0xFFU != interface) && (NULL == msc) && (i < USBH_MSC_MAX_DEV); i++) {
+        if (NULL == msc_owner[i]) {
+            msc_owner[i] = uhost;
+            msc = &msc_handler[i];
+        }
+    }
+
+    if (NULL == msc) {
         uhost->usr_cb->dev_not_supported();
 
         status = USBH_FAIL;
     } else {
-        static usbh_msc_handler msc_handler;
+        memset((void*)msc, 0U, sizeof(usbh_msc_handler));
 
-        memset((void*)&msc_handler, 0U, sizeof(usbh_msc_handler));
-    
-        uhost->active_class->class_data = (void *)&msc_handler;
+        uhost->class_data = (void *)msc;
 
         usbh_interface_select(&uhost->dev_prop, interface);
 
         usb_desc_ep *ep_desc = &uhost->dev_prop.cfg_desc_set.itf_desc_set[interface][0].ep_desc[0];
 
         if (ep_desc->bEndpointAddress & 0x80U) {
-            msc_handler.ep_in = ep_desc->bEndpointAddress;
-            msc_handler.ep_size_in = ep_desc->wMaxPacketSize;
+            msc->ep_in = ep_desc->bEndpointAddress;
+            msc->ep_size_in = ep_desc->wMaxPacketSize;
         } else {
-            msc_handler.ep_out = ep_desc->bEndpointAddress;
-            msc_handler.ep_size_out = ep_desc->wMaxPacketSize;
+            msc->ep_out = ep_desc->bEndpointAddress;
+            msc->ep_size_out = ep_desc->wMaxPacketSize;
         }
 
         ep_desc = &uhost->dev_prop.cfg_desc_set.itf_desc_set[interface][0].ep_desc[1];
 
         if (ep_desc->bEndpointAddress & 0x80U) {
-            msc_handler.ep_in = ep_desc->bEndpointAddress;
-            msc_handler.ep_size_in = ep_desc->wMaxPacketSize;
+            msc->ep_in = ep_desc->bEndpointAddress;
+            msc->ep_size_in = ep_desc->wMaxPacketSize;
         } else {
-            msc_handler.ep_out = ep_desc->bEndpointAddress;
-            msc_handler.ep_size_out = ep_desc->wMaxPacketSize;
+            msc->ep_out = ep_desc->bEndpointAddress;
+            msc->ep_size_out = ep_desc->wMaxPacketSize;
         }
 
-        msc_handler.state = MSC_INIT;
-        msc_handler.error = MSC_OK;
-        msc_handler.req_state = MSC_REQ_IDLE;
-        msc_handler.pipe_out = usbh_pipe_allocate(uhost->data, msc_handler.ep_out);
-        msc_handler.pipe_in = usbh_pipe_allocate(uhost->data, msc_handler.ep_in);
+        msc->state = MSC_INIT;
+        msc->error = MSC_OK;
+        msc->req_state = MSC_REQ_IDLE;
+        msc->pipe_out = usbh_pipe_allocate(uhost->data, msc->ep_out);
+        msc->pipe_in = usbh_pipe_allocate(uhost->data, msc->ep_in);
 
         usbh_msc_bbb_init(uhost);
 
         /* open the new channels */
         usbh_pipe_create (uhost->data,
                           &uhost->dev_prop,
-                          msc_handler.pipe_out,
+                          msc->pipe_out,
                           USB_EPTYPE_BULK,
-                          msc_handler.ep_size_out);
+                          msc->ep_size_out);
 
         usbh_pipe_create (uhost->data,
                           &uhost->dev_prop,
-                          msc_handler.pipe_in,
+                          msc->pipe_in,
                           USB_EPTYPE_BULK,
-                          msc_handler.ep_size_in);
+                          msc->ep_size_in);
 
-        usbh_pipe_toggle_set (uhost->data, msc_handler.pipe_out, 0U);
-        usbh_pipe_toggle_set (uhost->data, msc_handler.pipe_in, 0U);
+        usbh_pipe_toggle_set (uhost->data, msc->pipe_out, 0U);
+        usbh_pipe_toggle_set (uhost->data, msc->pipe_in, 0U);
     }
 
     return status;
@@ -140,7 +161,16 @@ static usbh_status usbh_msc_itf_init (usbh_host *uhost)
 */
 void usbh_msc_itf_deinit (usbh_host *uhost)
 {
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+
+    if (NULL == msc) {
+        return;
+    }
+
+    /* fail the queued transfers of the removed device */
+    while (NULL != msc->xfer_head) {
+        usbh_msc_xfer_end (uhost, USBH_FAIL);
+    }
 
     if (msc->pipe_out) {
         usb_pipe_halt (uhost->data, msc->pipe_out);
@@ -155,6 +185,12 @@ void usbh_msc_itf_deinit (usbh_host *uhost)
 
         msc->pipe_in = 0U;
     }
+
+    for (uint8_t i = 0U; i < USBH_MSC_MAX_DEV; i++) {
+        if (uhost == msc_owner[i]) {
+            msc_owner[i] = NULL;
+        }
+    }
 }
 
 /*!
@@ -166,7 +202,7 @@ void usbh_msc_itf_deinit (usbh_host *uhost)
 static usbh_status usbh_msc_req (usbh_host *uhost)
 {
     usbh_status status = USBH_BUSY;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     switch (msc->req_state) {
     case MSC_REQ_IDLE:
@@ -214,7 +250,7 @@ static usbh_status usbh_msc_handle (usbh_host *uhost)
     usbh_status status = USBH_BUSY;
     uint8_t scsi_status = USBH_BUSY;
     uint8_t ready_status = USBH_BUSY;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
 
     switch (msc->state) {
@@ -333,6 +369,11 @@ static usbh_status usbh_msc_handle (usbh_host *uhost)
         break;
 
     case MSC_IDLE:
+    case MSC_READ:
+    case MSC_WRITE:
+        /* advance the queued transfers a step, then give the application a turn */
+        usbh_msc_xfer_process (uhost);
+
         uhost->usr_cb->dev_user_app();
         status = USBH_OK;
         break;
@@ -383,7 +424,7 @@ static usbh_status usbh_msc_rdwr_process(usbh_host *uhost, uint8_t lun)
 {
     usbh_status error = USBH_BUSY;
     usbh_status scsi_status = USBH_BUSY;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     /* switch msc req state machine */
     switch (msc->unit[lun].state) {
@@ -455,7 +496,7 @@ static usbh_status usbh_msc_rdwr_process(usbh_host *uhost, uint8_t lun)
 */
 usbh_status usbh_msc_lun_info_get (usbh_host *uhost, uint8_t lun, msc_lun *info)
 {
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     if (HOST_CLASS_HANDLER == uhost->cur_state) {
         memcpy(info, &msc->unit[lun], sizeof(msc_lun));
@@ -482,36 +523,25 @@ usbh_status usbh_msc_read (usbh_host *uhost,
                            uint8_t *pbuf,
                            uint32_t length)
 {
-    uint32_t timeout = 0U;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
-    usb_core_driver *udev = (usb_core_driver *)uhost->data;
+    msc_xfer xfer;
 
-    if ((0U == udev->host.connect_status) || 
-        (HOST_CLASS_HANDLER != uhost->cur_state) || 
-        (MSC_IDLE != msc->unit[lun].state)) {
-        return USBH_FAIL;
-    }
-
-    msc->state = MSC_READ;
-    msc->unit[lun].state = MSC_READ;
-    msc->rw_lun = lun;
+    memset((void*)&xfer, 0U, sizeof(msc_xfer));
 
-    usbh_msc_read10(uhost, lun, pbuf, address, length);
+    xfer.lun = lun;
+    xfer.dir = MSC_READ;
+    xfer.address = address;
+    xfer.pbuf = pbuf;
+    xfer.length = length;
 
-    timeout = uhost->control.timer;
-
-    while (USBH_BUSY == usbh_msc_rdwr_process(uhost, lun)) {
-        if (((uhost->control.timer > timeout) && ((uhost->control.timer - timeout) > (10000U * length))) \
-              || ((uhost->control.timer < timeout) && ((uhost->control.timer + 0x3FFFU - timeout) > (10000U * length))) \
-              || (0U == udev->host.connect_status)){
-            msc->state = MSC_IDLE;
-            return USBH_FAIL;
-        }
+    if (USBH_OK != usbh_msc_submit (uhost, &xfer)) {
+        return USBH_FAIL;
     }
 
-    msc->state = MSC_IDLE;
+    while (USBH_BUSY == xfer.status) {
+        usbh_msc_xfer_process (uhost);
+    }
 
-    return USBH_OK;
+    return xfer.status;
 }
 
 /*!
@@ -530,34 +560,313 @@ usbh_status usbh_msc_write (usbh_host *uhost,
                             uint8_t *pbuf,
                             uint32_t length)
 {
-    uint32_t timeout = 0U;
+    msc_xfer xfer;
+
+    memset((void*)&xfer, 0U, sizeof(msc_xfer));
+
+    xfer.lun = lun;
+    xfer.dir = MSC_WRITE;
+    xfer.address = address;
+    xfer.pbuf = pbuf;
+    xfer.length = length;
+
+    if (USBH_OK != usbh_msc_submit (uhost, &xfer)) {
+        return USBH_FAIL;
+    }
+
+    while (USBH_BUSY == xfer.status) {
+        usbh_msc_xfer_process (uhost);
+    }
+
+    return xfer.status;
+}
+
+/*!
+    \brief      queue an asynchronous msc read/write transfer
+    \param[in]  uhost: pointer to USB host
+    \param[in]  xfer: pointer to the transfer, which must stay valid until it ends
+                  lun, dir (MSC_READ or MSC_WRITE), address, pbuf, length and
+                  complete (NULL to poll status) are set by the caller
+    \param[out] none
+    \retval     USBH_OK if queued, USBH_FAIL otherwise
+*/
+usbh_status usbh_msc_submit (usbh_host *uhost, msc_xfer *xfer)
+{
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
     usb_core_driver *udev = (usb_core_driver *)uhost->data;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
 
     if ((0U == udev->host.connect_status) || 
         (HOST_CLASS_HANDLER != uhost->cur_state) || 
-        (MSC_IDLE != msc->unit[lun].state)) {
+        (xfer->lun >= MSC_MAX_SUPPORTED_LUN) || 
+        ((MSC_READ != xfer->dir) && (MSC_WRITE != xfer->dir))) {
         return USBH_FAIL;
     }
 
-    msc->state = MSC_WRITE;
-    msc->unit[lun].state = MSC_WRITE;
-    msc->rw_lun = lun;
+    xfer->next = NULL;
+    xfer->status = USBH_BUSY;
 
-    usbh_msc_write10(uhost, lun, pbuf, address, length);
+    if (NULL == msc->xfer_head) {
+        msc->xfer_head = xfer;
+    } else {
+        msc->xfer_tail->next = xfer;
+    }
 
-    timeout = uhost->control.timer;
+    msc->xfer_tail = xfer;
 
-    while (USBH_BUSY == usbh_msc_rdwr_process(uhost, lun)) {
-        if (((uhost->control.timer > timeout) && ((uhost->control.timer - timeout) > (10000U * length))) \
-              || ((uhost->control.timer < timeout) && ((uhost->control.timer + 0x3FFFU - timeout) > (10000U * length))) \
-              || (0U == udev->host.connect_status)){
-            msc->state = MSC_IDLE;
-            return USBH_FAIL;
+    return USBH_OK;
+}
+
+/*!
+    \brief      advance the queued msc transfers, called from the msc state machine
+                and by the callers waiting for a transfer
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     USBH_BUSY while a transfer is in progress, status of the ended transfer otherwise
+*/
+usbh_status usbh_msc_xfer_process (usbh_host *uhost)
+{
+    usbh_status status = USBH_OK;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+    usb_core_driver *udev = (usb_core_driver *)uhost->data;
+    msc_xfer *xfer = msc->xfer_head;
+
+    if (NULL == xfer) {
+        return USBH_OK;
+    }
+
+    if ((0U == udev->host.connect_status) || (HOST_CLASS_HANDLER != uhost->cur_state)) {
+        msc->state = MSC_IDLE;
+        usbh_msc_xfer_end (uhost, USBH_FAIL);
+
+        return USBH_FAIL;
+    }
+
+    if ((MSC_READ != msc->state) && (MSC_WRITE != msc->state)) {
+        return usbh_msc_xfer_start (uhost);
+    }
+
+    status = usbh_msc_rdwr_process(uhost, xfer->lun);
+
+    if (USBH_BUSY == status) {
+        if (((uhost->control.timer > xfer->timer) && ((uhost->control.timer - xfer->timer) > (10000U * msc->cmd_length))) \
+              || ((uhost->control.timer < xfer->timer) && ((uhost->control.timer + 0x3FFFU - xfer->timer) > (10000U * msc->cmd_length)))) {
+            status = USBH_FAIL;
+        } else {
+            return USBH_BUSY;
+        }
+    } else if (USBH_OK == status) {
+        /* the CBW of the next command goes out in the same step as this CSW */
+        status = usbh_msc_cmd_end (uhost);
+
+        if (USBH_BUSY == status) {
+            return USBH_BUSY;
         }
+    } else {
+        /* no operation */
     }
 
     msc->state = MSC_IDLE;
+    usbh_msc_xfer_end (uhost, status);
+
+    /* and so does the first command of the next queued transfer */
+    if (NULL != msc->xfer_head) {
+        (void)usbh_msc_xfer_start (uhost);
+    }
+
+    return status;
+}
+
+/*!
+    \brief      start the transfer at the head of the queue
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     USBH_BUSY while a command is in progress, status of the ended transfer otherwise
+*/
+static usbh_status usbh_msc_xfer_start (usbh_host *uhost)
+{
+    usbh_status status = USBH_BUSY;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+    msc_xfer *xfer = msc->xfer_head;
+
+    if ((MSC_IDLE != msc->state) || (MSC_IDLE != msc->unit[xfer->lun].state)) {
+        usbh_msc_xfer_end (uhost, USBH_FAIL);
+
+        return USBH_FAIL;
+    }
+
+    msc->xfer_done = 0U;
+
+#if USBH_MSC_READ_AHEAD_SIZE > 0U
+    /* drop read-ahead data the write makes stale */
+    if ((MSC_WRITE == xfer->dir) && (xfer->lun == msc->ra_lun) && 
+        (xfer->address < (msc->ra_address + msc->ra_length)) && 
+        (msc->ra_address < (xfer->address + xfer->length))) {
+        msc->ra_length = 0U;
+    }
+#endif /* USBH_MSC_READ_AHEAD_SIZE > 0U */
+
+    status = usbh_msc_cmd_start (uhost);
+
+    if (USBH_OK == status) {
+        /* all blocks came from the read-ahead buffer */
+        usbh_msc_xfer_end (uhost, USBH_OK);
+    }
+
+    return status;
+}
+
+/*!
+    \brief      start the next READ10/WRITE10 command of the transfer at the head of the queue,
+                carrying up to USBH_MSC_MAX_XFER_BLOCKS blocks straight to or from the caller's buffer
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     USBH_BUSY while the command is in progress, USBH_OK if no command was needed
+*/
+static usbh_status usbh_msc_cmd_start (usbh_host *uhost)
+{
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+    msc_xfer *xfer = msc->xfer_head;
+    uint16_t block_size = msc->unit[xfer->lun].capacity.block_size;
+    uint32_t length = xfer->length - msc->xfer_done;
+    uint8_t *pbuf = xfer->pbuf + msc->xfer_done * block_size;
+
+    msc->cmd_address = xfer->address + msc->xfer_done;
+    msc->cmd_length = (length > USBH_MSC_MAX_XFER_BLOCKS) ? USBH_MSC_MAX_XFER_BLOCKS : length;
+
+#if USBH_MSC_READ_AHEAD_SIZE > 0U
+    msc->ra_fill = 0U;
+
+    if ((MSC_READ == xfer->dir) && (0U != block_size) && (xfer->lun == msc->ra_lun)) {
+        uint32_t count = 0U;
+
+        /* copy the leading blocks held in the read-ahead buffer */
+        if ((msc->cmd_address >= msc->ra_address) && ((msc->cmd_address - msc->ra_address) < msc->ra_length)) {
+            uint32_t offset = msc->cmd_address - msc->ra_address;
+
+            count = msc->ra_length - offset;
+
+            if (count > length) {
+                count = length;
+            }
+
+            memcpy(pbuf, (uint8_t *)msc->ra_buf + offset * block_size, count * block_size);
+
+            msc->xfer_done += count;
+            msc->cmd_address += count;
+            msc->ra_next = msc->cmd_address;
+            pbuf += count * block_size;
+            length -= count;
+
+            if (0U == length) {
+                return USBH_OK;
+            }
+
+            msc->cmd_length = (length > USBH_MSC_MAX_XFER_BLOCKS) ? USBH_MSC_MAX_XFER_BLOCKS : length;
+        }
+
+        /* a short read following the previous one fills the read-ahead buffer instead */
+        if ((msc->cmd_address == msc->ra_next) && (msc->cmd_address < msc->unit[xfer->lun].capacity.block_nbr)) {
+            count = USBH_MSC_READ_AHEAD_SIZE / block_size;
+
+            if (count > USBH_MSC_MAX_XFER_BLOCKS) {
+                count = USBH_MSC_MAX_XFER_BLOCKS;
+            }
+
+            if (count > (msc->unit[xfer->lun].capacity.block_nbr - msc->cmd_address)) {
+                count = msc->unit[xfer->lun].capacity.block_nbr - msc->cmd_address;
+            }
+
+            if (count > length) {
+                msc->ra_fill = 1U;
+                msc->ra_address = msc->cmd_address;
+                msc->ra_length = 0U;
+                msc->cmd_length = count;
+                pbuf = (uint8_t *)msc->ra_buf;
+            }
+        }
+    }
+#endif /* USBH_MSC_READ_AHEAD_SIZE > 0U */
+
+    msc->state = xfer->dir;
+    msc->unit[xfer->lun].state = xfer->dir;
+    msc->rw_lun = xfer->lun;
+
+    if (MSC_READ == xfer->dir) {
+        usbh_msc_read10(uhost, xfer->lun, pbuf, msc->cmd_address, msc->cmd_length);
+    } else {
+        usbh_msc_write10(uhost, xfer->lun, pbuf, msc->cmd_address, msc->cmd_length);
+    }
+
+    xfer->timer = uhost->control.timer;
+
+    /* send the CBW now rather than on the next step */
+    (void)usbh_msc_rdwr_process(uhost, xfer->lun);
+
+    return USBH_BUSY;
+}
+
+/*!
+    \brief      account the finished command and start the next one of the transfer
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     USBH_BUSY while the transfer has more blocks, USBH_OK when it is done
+*/
+static usbh_status usbh_msc_cmd_end (usbh_host *uhost)
+{
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+    msc_xfer *xfer = msc->xfer_head;
+
+#if USBH_MSC_READ_AHEAD_SIZE > 0U
+    if (1U == msc->ra_fill) {
+        uint16_t block_size = msc->unit[xfer->lun].capacity.block_size;
+        uint32_t count = xfer->length - msc->xfer_done;
+
+        msc->ra_length = msc->cmd_length;
+
+        memcpy(xfer->pbuf + msc->xfer_done * block_size, msc->ra_buf, count * block_size);
+
+        msc->xfer_done += count;
+    } else {
+        msc->xfer_done += msc->cmd_length;
+    }
+
+    if (MSC_READ == xfer->dir) {
+        msc->ra_lun = xfer->lun;
+        msc->ra_next = xfer->address + msc->xfer_done;
+    }
+#else
+    msc->xfer_done += msc->cmd_length;
+#endif /* USBH_MSC_READ_AHEAD_SIZE > 0U */
+
+    if (msc->xfer_done < xfer->length) {
+        return usbh_msc_cmd_start (uhost);
+    }
 
     return USBH_OK;
 }
+
+/*!
+    \brief      remove the transfer at the head of the queue and notify its end
+    \param[in]  uhost: pointer to USB host
+    \param[in]  status: result of the transfer
+    \param[out] none
+    \retval     none
+*/
+static void usbh_msc_xfer_end (usbh_host *uhost, usbh_status status)
+{
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
+    msc_xfer *xfer = msc->xfer_head;
+
+    msc->xfer_head = xfer->next;
+
+    if (NULL == msc->xfer_head) {
+        msc->xfer_tail = NULL;
+    }
+
+    xfer->next = NULL;
+    xfer->status = status;
+
+    if (NULL != xfer->complete) {
+        xfer->complete(xfer);
+    }
+}
@@ -37,11 +37,27 @@ OF SUCH DAMAGE.
 #include "usb_conf.h"
 #include "diskio.h"
 #include "usbh_msc_core.h"
+#include <string.h>
 
 static volatile DSTATUS state = STA_NOINIT; /* disk status */
+static void (*disk_idle)(void) = NULL;      /* called while waiting for a transfer */
 
 extern usbh_host usb_host_msc;
 
+static DRESULT disk_xfer (msc_xfer *xfer);
+static usbh_host *disk_host (void);
+
+/*!
+    \brief      set the function called while the disk I/O waits for a transfer
+    \param[in]  idle: function to run other work of the application (lwIP polling etc.), NULL for none
+    \param[out] none
+    \retval     none
+*/
+void usbh_msc_fatfs_idle_set (void (*idle)(void))
+{
+    disk_idle = idle;
+}
+
 /*!
     \brief      initialize the disk drive
     \param[in]  drv: physical drive number (0)
@@ -85,8 +101,7 @@ DSTATUS disk_status (BYTE drv)
 */
 DRESULT disk_read (BYTE drv, BYTE *buff, DWORD sector, UINT count)
 {
-    BYTE status = USBH_OK;
-    usb_core_driver *udev = (usb_core_driver *)usb_host_msc.data;
+    msc_xfer xfer;
 
     if (drv || (!count)) {
         return RES_PARERR;
@@ -96,21 +111,15 @@ DRESULT disk_read (BYTE drv, BYTE *buff, DWORD sector, UINT count)
         return RES_NOTRDY;
     }
 
-    if (udev->host.connect_status) {
-        do {
-            status = usbh_msc_read (&usb_host_msc, drv, sector, buff, count);
-
-            if (!udev->host.connect_status) {
-                return RES_ERROR;
-            }
-        } while(status == USBH_BUSY);
-    }
+    memset((void*)&xfer, 0U, sizeof(msc_xfer));
 
-    if (status == USBH_OK) {
-        return RES_OK;
-    }
+    xfer.lun = drv;
+    xfer.dir = MSC_READ;
+    xfer.address = sector;
+    xfer.pbuf = buff;
+    xfer.length = count;
 
-    return RES_ERROR;
+    return disk_xfer (&xfer);
 }
 
 #if _READONLY == 0U
@@ -126,8 +135,7 @@ DRESULT disk_read (BYTE drv, BYTE *buff, DWORD sector, UINT count)
 */
 DRESULT disk_write (BYTE drv, const BYTE *buff, DWORD sector, UINT count)
 {
-    BYTE status = USBH_OK;
-    usb_core_driver *udev = (usb_core_driver *)usb_host_msc.data;
+    msc_xfer xfer;
 
     if ((!count) || drv) {
         return RES_PARERR;
@@ -141,25 +149,61 @@ DRESULT disk_write (BYTE drv, const BYTE *buff, DWORD sector, UINT count)
         return RES_WRPRT;
     }
 
-    if (udev->host.connect_status) {
-        do {
-            status = usbh_msc_write (&usb_host_msc, drv, sector, (BYTE*)buff, count);
+    memset((void*)&xfer, 0U, sizeof(msc_xfer));
+
+    xfer.lun = drv;
+    xfer.dir = MSC_WRITE;
+    xfer.address = sector;
+    xfer.pbuf = (BYTE*)buff;
+    xfer.length = count;
 
-            if (!udev->host.connect_status) {
-                return RES_ERROR;
-            }
-        } while(status == USBH_BUSY);
+    return disk_xfer (&xfer);
+}
+
+#endif /* _READONLY == 0 */
+
+/*!
+    \brief      get the host of the drive: the first MSC device, which may sit behind a hub
+    \param[in]  none
+    \param[out] none
+    \retval     pointer to USB host
+*/
+static usbh_host *disk_host (void)
+{
+    usbh_host *uhost = usbh_class_dev_get (&usb_host_msc, &usbh_msc, 0U);
+
+    return (NULL != uhost) ? uhost : &usb_host_msc;
+}
+
+/*!
+    \brief      queue a transfer and wait for its end, running the idle function meanwhile
+    \param[in]  xfer: pointer to the transfer
+    \param[out] none
+    \retval     operation status
+*/
+static DRESULT disk_xfer (msc_xfer *xfer)
+{
+    usbh_host *uhost = disk_host();
+
+    if (USBH_OK != usbh_msc_submit (uhost, xfer)) {
+        return RES_ERROR;
+    }
+
+    while (USBH_BUSY == xfer->status) {
+        usbh_msc_xfer_process (uhost);
+
+        if ((USBH_BUSY == xfer->status) && (NULL != disk_idle)) {
+            disk_idle();
+        }
     }
 
-    if (status == USBH_OK) {
+    if (USBH_OK == xfer->status) {
         return RES_OK;
     }
 
     return RES_ERROR;
 }
 
-#endif /* _READONLY == 0 */
-
 /*!
     \brief      I/O control function
     \param[in]  drv: physical drive number (0)
@@ -172,6 +216,7 @@ DRESULT disk_ioctl (BYTE drv, BYTE ctrl, void *buff)
 {
     DRESULT res = RES_OK;
     msc_lun info;
+    usbh_host *uhost = disk_host();
 
     if (drv) {
         return RES_PARERR;
@@ -186,12 +231,16 @@ DRESULT disk_ioctl (BYTE drv, BYTE ctrl, void *buff)
     switch (ctrl) {
     /* make sure that no pending write process */
     case CTRL_SYNC:
+        while (NULL != ((usbh_msc_handler *)uhost->class_data)->xfer_head) {
+            usbh_msc_xfer_process (uhost);
+        }
+
         res = RES_OK;
         break;
 
     /* get number of sectors on the disk (dword) */
     case GET_SECTOR_COUNT:
-        if (USBH_OK == usbh_msc_lun_info_get(&usb_host_msc, drv, &info)) {
+        if (USBH_OK == usbh_msc_lun_info_get(uhost, drv, &info)) {
             *(DWORD*)buff = (DWORD)info.capacity.block_nbr;
             res = RES_OK;
         }
@@ -199,7 +248,7 @@ DRESULT disk_ioctl (BYTE drv, BYTE ctrl, void *buff)
 
     /* get r/w sector size (word) */
     case GET_SECTOR_SIZE:
-        if (USBH_OK == usbh_msc_lun_info_get(&usb_host_msc, drv, &info)) {
+        if (USBH_OK == usbh_msc_lun_info_get(uhost, drv, &info)) {
             *(WORD*)buff = (DWORD)info.capacity.block_size;
             res = RES_OK;
         }
@@ -51,7 +51,7 @@ OF SUCH DAMAGE.
 usbh_status usbh_msc_scsi_inquiry (usbh_host *uhost, uint8_t lun, scsi_std_inquiry_data *inquiry)
 {
     usbh_status error = USBH_FAIL;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     switch (msc->bbb.cmd_state) {
     case BBB_CMD_SEND:
@@ -76,6 +76,9 @@ usbh_status usbh_msc_scsi_inquiry (usbh_host *uhost, uint8_t lun, scsi_std_inqui
         error = usbh_msc_bbb_process(uhost, lun);
 
         if (USBH_OK == error) {
+            /* the data stage has moved pbuf past the response */
+            msc->bbb.pbuf = (uint8_t *)(void *)msc->bbb.data;
+
             memset(inquiry, 0U, sizeof(scsi_std_inquiry_data));
 
             /* assign inquiry data */
@@ -111,7 +114,7 @@ usbh_status usbh_msc_scsi_inquiry (usbh_host *uhost, uint8_t lun, scsi_std_inqui
 usbh_status usbh_msc_test_unitready (usbh_host *uhost, uint8_t lun)
 {
     usbh_status status = USBH_FAIL;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
 
     switch (msc->bbb.cmd_state) {
@@ -152,7 +155,7 @@ usbh_status usbh_msc_test_unitready (usbh_host *uhost, uint8_t lun)
 usbh_status usbh_msc_read_capacity10 (usbh_host *uhost, uint8_t lun, scsi_capacity *capacity)
 {
     usbh_status status = USBH_FAIL;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     switch (msc->bbb.cmd_state) {
     case BBB_CMD_SEND:
@@ -175,6 +178,9 @@ usbh_status usbh_msc_read_capacity10 (usbh_host *uhost, uint8_t lun, scsi_capaci
         status = usbh_msc_bbb_process(uhost, lun);
 
         if (USBH_OK == status) {
+            /* the data stage has moved pbuf past the response */
+            msc->bbb.pbuf = (uint8_t *)(void *)msc->bbb.data;
+
             capacity->block_nbr = msc->bbb.pbuf[3] | \
                                   ((uint32_t)msc->bbb.pbuf[2] << 8U) | \
                                   ((uint32_t)msc->bbb.pbuf[1] << 16U) | \
@@ -201,7 +207,7 @@ usbh_status usbh_msc_read_capacity10 (usbh_host *uhost, uint8_t lun, scsi_capaci
 usbh_status usbh_msc_mode_sense6 (usbh_host *uhost, uint8_t lun)
 {
     usbh_status status = USBH_FAIL;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
 
     switch (msc->bbb.cmd_state) {
@@ -254,7 +260,7 @@ usbh_status usbh_msc_mode_sense6 (usbh_host *uhost, uint8_t lun)
 usbh_status usbh_msc_request_sense (usbh_host *uhost, uint8_t lun, msc_scsi_sense *sense_data)
 {
     usbh_status status = USBH_FAIL;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     switch (msc->bbb.cmd_state) {
     case BBB_CMD_SEND:
@@ -280,6 +286,9 @@ usbh_status usbh_msc_request_sense (usbh_host *uhost, uint8_t lun, msc_scsi_sens
         status = usbh_msc_bbb_process(uhost, lun);
 
         if (status == USBH_OK) {
+            /* the data stage has moved pbuf past the response */
+            msc->bbb.pbuf = (uint8_t *)(void *)msc->bbb.data;
+
             /* get sense data */
             sense_data->SenseKey = msc->bbb.pbuf[2] & 0x0FU;
             sense_data->ASC = msc->bbb.pbuf[12];
@@ -307,7 +316,7 @@ usbh_status usbh_msc_request_sense (usbh_host *uhost, uint8_t lun, msc_scsi_sens
 usbh_status usbh_msc_write10 (usbh_host *uhost, uint8_t lun, uint8_t *data_buf, uint32_t addr, uint32_t sector_num)
 {
     usbh_status status = USBH_FAIL;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     switch (msc->bbb.cmd_state) {
     case BBB_CMD_SEND:
@@ -360,7 +369,7 @@ usbh_status usbh_msc_write10 (usbh_host *uhost, uint8_t lun, uint8_t *data_buf,
 usbh_status usbh_msc_read10 (usbh_host *uhost, uint8_t lun, uint8_t *data_buf, uint32_t addr, uint32_t sector_num)
 {
     usbh_status status = USBH_FAIL;
-    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->active_class->class_data;
+    usbh_msc_handler *msc = (usbh_msc_handler *)uhost->class_data;
 
     switch (msc->bbb.cmd_state) {
     case BBB_CMD_SEND:
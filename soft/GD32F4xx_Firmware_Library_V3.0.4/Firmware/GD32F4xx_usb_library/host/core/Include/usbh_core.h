@@ -42,6 +42,7 @@ OF SUCH DAMAGE.
 
 #define MSC_CLASS                                       0x08U
 #define HID_CLASS                                       0x03U
+#define HUB_CLASS                                       0x09U
 #define MSC_PROTOCOL                                    0x50U
 #define CBI_PROTOCOL                                    0x01U
 
@@ -50,6 +51,16 @@ OF SUCH DAMAGE.
 #define USBH_DEV_ADDR_DEFAULT                           0U
 #define USBH_DEV_ADDR                                   1U
 
+/* periodic schedule: slots of (micro)frames the interrupt pipes are spread over */
+#ifndef USBH_SCHED_SLOTS
+#define USBH_SCHED_SLOTS                                32U
+#endif /* USBH_SCHED_SLOTS */
+
+/* bus time the interrupt pipes may take in a slot, in 100 ns units: 90% of a
+   frame at full and low speed, 80% of a microframe at high speed (USB 2.0 5.7.4) */
+#define USBH_SCHED_FS_BUDGET                            9000U
+#define USBH_SCHED_HS_BUDGET                            1000U
+
 typedef enum
 {
     USBH_OK = 0U,
@@ -187,8 +198,6 @@ typedef struct
     usbh_status (*class_requests)  (struct _usbh_host *phost);
     usbh_status (*class_machine)   (struct _usbh_host *phost);
     usbh_status (*class_sof)       (struct _usbh_host *uhost);
-
-    void         *class_data;
 } usbh_class;
 
 /* user callbacks */
@@ -234,10 +243,18 @@ typedef struct _usbh_host
     uint8_t                             class_num;                          /*!< USB class number */
 
     void                                *data;                              /*!< used for... */
+    void                                *class_data;                        /*!< data of the active class for this device */
 
     uint8_t                             suspend_flag;                       /*!< host suspend flag */
     uint8_t                             dev_supp_remote_wkup;               /*!< record device remote wakeup function */
     usbh_wakeup_mode                    wakeup_mode;                        /*!< record wakeup mode */
+
+    uint8_t                             dev_addr;                           /*!< address assigned to the device at enumeration */
+    uint8_t                             hub_port;                           /*!< hub port of the device, 0 on the root port */
+    struct _usbh_host                   *parent;                            /*!< host of the hub the device is behind, NULL on the root port */
+    struct _usbh_host                   *next;                              /*!< next device attached through a hub */
+    struct _usbh_host                   *ctl_owner;                         /*!< device using the shared control pipes (root port host only) */
+    uint16_t                            sched_load[USBH_SCHED_SLOTS];       /*!< periodic bus time reserved per slot, 100 ns units (root port host only) */
 } usbh_host;
 
 /*!
@@ -264,6 +281,21 @@ static inline uint32_t usbh_xfercount_get (usb_core_driver *udev, uint8_t pp_num
     return udev->host.backup_xfercount[pp_num];
 }
 
+/*!
+    \brief      get the host of the root port device
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     pointer to the root port USB host
+*/
+static inline usbh_host *usbh_root_get (usbh_host *uhost)
+{
+    while (NULL != uhost->parent) {
+        uhost = uhost->parent;
+    }
+
+    return uhost;
+}
+
 /* function declarations */
 /* USB host stack initializations */
 void usbh_init (usbh_host *uhost, usb_core_driver *udev, usb_core_enum usb_core, usbh_user_cb *user_cb);
@@ -275,5 +307,11 @@ usbh_status usbh_deinit (usbh_host *uhost);
 void usbh_core_task (usbh_host *uhost);
 /* handle the error on USB host side */
 void usbh_error_handler (usbh_host *uhost, usbh_status err_type);
+/* attach a device found on a hub port */
+void usbh_dev_attach (usbh_host *hub, usbh_host *uhost, uint8_t port, uint8_t addr, uint32_t speed);
+/* remove a device attached through a hub */
+void usbh_dev_remove (usbh_host *uhost);
+/* get a device served by a class */
+usbh_host *usbh_class_dev_get (usbh_host *uhost, usbh_class *puclass, uint8_t index);
 
 #endif /* __USBH_CORE_H */
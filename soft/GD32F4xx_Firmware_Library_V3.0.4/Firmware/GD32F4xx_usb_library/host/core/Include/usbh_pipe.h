@@ -48,6 +48,9 @@ OF SUCH DAMAGE.
 #define HP_ERROR                0xFFFFU
 #define HP_USED_MASK            0x7FFFU
 
+/* the frame number counts (micro)frames modulo 0x4000 */
+#define USBH_FRAME_MASK         0x3FFFU
+
 /*!
     \brief      set toggle for a pipe
     \param[in]  udev: pointer to USB core instance
@@ -100,5 +103,13 @@ uint8_t usbh_pipe_allocate (usb_core_driver *udev, uint8_t ep_addr);
 uint8_t usbh_pipe_free (usb_core_driver *udev, uint8_t pp_num);
 /* delete all USB host pipe */
 uint8_t usbh_pipe_delete (usb_core_driver *udev);
+/* free the pipes of a device */
+uint8_t usbh_pipe_dev_delete (usb_core_driver *udev, uint8_t dev_addr);
+/* reserve bus time for an interrupt pipe in the periodic schedule */
+usbh_status usbh_pipe_sched_add (usbh_host *uhost, uint8_t pp_num, uint16_t interval);
+/* release the bus time of an interrupt pipe */
+void usbh_pipe_sched_del (usbh_host *uhost, uint8_t pp_num);
+/* check whether an interrupt pipe may start a transfer in this (micro)frame */
+uint8_t usbh_pipe_sched_due (usbh_host *uhost, uint8_t pp_num);
 
 #endif /* __USBH_PIPE_H */
@@ -75,6 +75,17 @@ void usbh_init (usbh_host *uhost, usb_core_driver *udev, usb_core_enum usb_core,
     udev->host.data = (void *)uhost;
     uhost->data = (void *)udev;
 
+    uhost->parent = NULL;
+    uhost->next = NULL;
+    uhost->ctl_owner = NULL;
+    uhost->hub_port = 0U;
+    uhost->dev_addr = USBH_DEV_ADDR;
+    uhost->class_data = NULL;
+
+    for (uint8_t i = 0U; i < USBH_SCHED_SLOTS; i++) {
+        uhost->sched_load[i] = 0U;
+    }
+
     /* host deinitialization */
     usbh_deinit(uhost);
 
@@ -156,8 +167,15 @@ usbh_status usbh_deinit(usbh_host *uhost)
     uhost->dev_prop.speed = PORT_SPEED_FULL;
     uhost->dev_prop.cur_itf = 0xFFU;
 
-    usbh_pipe_free(udev, uhost->control.pipe_in_num);
-    usbh_pipe_free(udev, uhost->control.pipe_out_num);
+    /* devices behind hubs borrow the control pipes of the root port */
+    if (NULL == uhost->parent) {
+        usbh_pipe_free(udev, uhost->control.pipe_in_num);
+        usbh_pipe_free(udev, uhost->control.pipe_out_num);
+    }
+
+    if (uhost == usbh_root_get(uhost)->ctl_owner) {
+        usbh_root_get(uhost)->ctl_owner = NULL;
+    }
 
     return USBH_OK;
 }
@@ -174,7 +192,7 @@ void usbh_core_task (usbh_host *uhost)
     usb_core_driver *udev = (usb_core_driver *)uhost->data;
 
     /* check for host port events */
-    if (((0U == udev->host.connect_status) || (0U == udev->host.port_enabled)) && (HOST_DEFAULT != uhost->cur_state)) {
+    if ((NULL == uhost->parent) && ((0U == udev->host.connect_status) || (0U == udev->host.port_enabled)) && (HOST_DEFAULT != uhost->cur_state)) {
         if (uhost->cur_state != HOST_DEV_DETACHED) {
             uhost->cur_state = HOST_DEV_DETACHED;
         }
@@ -182,7 +200,7 @@ void usbh_core_task (usbh_host *uhost)
 
     switch (uhost->cur_state) {
     case HOST_DEFAULT:
-        if (udev->host.connect_status) {
+        if ((NULL == uhost->parent) && (udev->host.connect_status)) {
             uhost->cur_state = HOST_DETECT_DEV_SPEED;
 
             usb_mdelay (100U);
@@ -207,22 +225,29 @@ void usbh_core_task (usbh_host *uhost)
 
     case HOST_DEV_CONNECT:
         uhost->usr_cb->dev_attach();
-        uhost->control.pipe_out_num = usbh_pipe_allocate(udev, 0x00U);
-        uhost->control.pipe_in_num = usbh_pipe_allocate(udev, 0x80U);
-
-        /* open IN control pipe */
-        usbh_pipe_create (udev,
-                          &uhost->dev_prop,
-                          uhost->control.pipe_in_num,
-                          USB_EPTYPE_CTRL,
-                          (uint16_t)uhost->control.max_len);
-
-        /* open OUT control pipe */
-        usbh_pipe_create (udev,
-                          &uhost->dev_prop,
-                          uhost->control.pipe_out_num,
-                          USB_EPTYPE_CTRL,
-                          (uint16_t)uhost->control.max_len);
+
+        if (NULL == uhost->parent) {
+            uhost->control.pipe_out_num = usbh_pipe_allocate(udev, 0x00U);
+            uhost->control.pipe_in_num = usbh_pipe_allocate(udev, 0x80U);
+
+            /* open IN control pipe */
+            usbh_pipe_create (udev,
+                              &uhost->dev_prop,
+                              uhost->control.pipe_in_num,
+                              USB_EPTYPE_CTRL,
+                              (uint16_t)uhost->control.max_len);
+
+            /* open OUT control pipe */
+            usbh_pipe_create (udev,
+                              &uhost->dev_prop,
+                              uhost->control.pipe_out_num,
+                              USB_EPTYPE_CTRL,
+                              (uint16_t)uhost->control.max_len);
+        } else {
+            /* the pipes are pointed to the device when a control transfer starts */
+            uhost->control.pipe_out_num = usbh_root_get(uhost)->control.pipe_out_num;
+            uhost->control.pipe_in_num = usbh_root_get(uhost)->control.pipe_in_num;
+        }
 
         uhost->cur_state = HOST_DEV_ENUM;
         break;
@@ -285,8 +310,15 @@ void usbh_core_task (usbh_host *uhost)
     case HOST_USER_INPUT:
         /* the function should return user response true to move to class state */
         if (USR_IN_RESP_OK == uhost->usr_cb->dev_user_input()) {
-            if ((USBH_OK == uhost->active_class->class_init(uhost))) {
+            status = uhost->active_class->class_init(uhost);
+
+            if (USBH_OK == status) {
                 uhost->cur_state = HOST_CLASS_ENUM;
+            } else if ((USBH_FAIL == status) && (NULL != uhost->parent)) {
+                /* the hub disables the port of a device its class cannot serve */
+                uhost->cur_state = HOST_ERROR;
+            } else {
+                /* no operation */
             }
         }
         break;
@@ -362,7 +394,12 @@ void usbh_core_task (usbh_host *uhost)
         /* deinitialize host for new enumeration */
         usbh_deinit (uhost);
         uhost->usr_cb->dev_deinit();
-        uhost->active_class->class_deinit(uhost);
+
+        if (NULL != uhost->active_class) {
+            uhost->active_class->class_deinit(uhost);
+            uhost->active_class = NULL;
+            uhost->class_data = NULL;
+        }
         break;
 
     case HOST_DEV_DETACHED:
@@ -372,7 +409,12 @@ void usbh_core_task (usbh_host *uhost)
         /* re-initialize host for new enumeration */
         usbh_deinit (uhost);
         uhost->usr_cb->dev_deinit();
-        uhost->active_class->class_deinit(uhost);
+
+        if (NULL != uhost->active_class) {
+            uhost->active_class->class_deinit(uhost);
+            uhost->active_class = NULL;
+            uhost->class_data = NULL;
+        }
         usbh_pipe_delete(udev);
         uhost->cur_state = HOST_DEFAULT;
         break;
@@ -380,6 +422,13 @@ void usbh_core_task (usbh_host *uhost)
     default:
         break;
     }
+
+    /* devices behind hubs get one step each per pass of the root port */
+    if (NULL == uhost->parent) {
+        for (usbh_host *dev = uhost->next; NULL != dev; dev = dev->next) {
+            usbh_core_task (dev);
+        }
+    }
 }
 
 /*!
@@ -406,6 +455,118 @@ void usbh_error_handler (usbh_host *uhost, usbh_status err_type)
     }
 }
 
+/*!
+    \brief      attach a device found on a hub port
+    \param[in]  hub: pointer to USB host of the hub
+    \param[in]  uhost: pointer to USB host for the new device
+    \param[in]  port: hub port number
+    \param[in]  addr: address to assign to the device
+    \param[in]  speed: device speed
+    \param[out] none
+    \retval     none
+*/
+void usbh_dev_attach (usbh_host *hub, usbh_host *uhost, uint8_t port, uint8_t addr, uint32_t speed)
+{
+    usbh_host *root = usbh_root_get (hub);
+    usbh_host *dev = root;
+
+    uhost->data = root->data;
+    uhost->usr_cb = root->usr_cb;
+    uhost->parent = hub;
+    uhost->next = NULL;
+    uhost->ctl_owner = NULL;
+    uhost->hub_port = port;
+    uhost->dev_addr = addr;
+    uhost->active_class = NULL;
+    uhost->class_data = NULL;
+
+    for (uhost->class_num = 0U; uhost->class_num < root->class_num; uhost->class_num++) {
+        uhost->uclass[uhost->class_num] = root->uclass[uhost->class_num];
+    }
+
+    usbh_deinit (uhost);
+
+    /* the hub has already reset the port, enumeration starts right away */
+    uhost->dev_prop.speed = speed;
+    uhost->cur_state = HOST_DEV_CONNECT;
+
+    while (NULL != dev->next) {
+        dev = dev->next;
+    }
+
+    dev->next = uhost;
+}
+
+/*!
+    \brief      remove a device attached through a hub
+    \param[in]  uhost: pointer to USB host of the device
+    \param[out] none
+    \retval     none
+*/
+void usbh_dev_remove (usbh_host *uhost)
+{
+    usbh_host *root = usbh_root_get (uhost);
+    usbh_host *dev = root;
+    usb_core_driver *udev = (usb_core_driver *)uhost->data;
+
+    while ((NULL != dev->next) && (uhost != dev->next)) {
+        dev = dev->next;
+    }
+
+    if (uhost != dev->next) {
+        return;
+    }
+
+    dev->next = uhost->next;
+
+    /* stop a control transfer left in flight to the device */
+    if (uhost == root->ctl_owner) {
+        (void)usb_pipe_halt (udev, uhost->control.pipe_in_num);
+        (void)usb_pipe_halt (udev, uhost->control.pipe_out_num);
+    }
+
+    uhost->usr_cb->dev_detach();
+
+    usbh_deinit (uhost);
+    uhost->usr_cb->dev_deinit();
+
+    if (NULL != uhost->active_class) {
+        uhost->active_class->class_deinit(uhost);
+        uhost->active_class = NULL;
+        uhost->class_data = NULL;
+    }
+
+    usbh_pipe_dev_delete (udev, uhost->dev_addr);
+
+    uhost->next = NULL;
+    uhost->parent = NULL;
+}
+
+/*!
+    \brief      get a device served by a class
+    \param[in]  uhost: pointer to any USB host of the device tree
+    \param[in]  puclass: pointer to USB device class
+    \param[in]  index: 0 for the first device of the class, the root port device first, then in order of attachment
+    \param[out] none
+    \retval     pointer to USB host of the device, NULL when the class serves fewer devices
+*/
+usbh_host *usbh_class_dev_get (usbh_host *uhost, usbh_class *puclass, uint8_t index)
+{
+    usbh_host *dev = usbh_root_get (uhost);
+
+    for (; NULL != dev; dev = dev->next) {
+        if ((puclass == dev->active_class) && (NULL != dev->class_data)) {
+            if (0U == index) {
+                break;
+            }
+
+            index--;
+        }
+    }
+
+    return dev;
+}
+
 /*!
     \brief      USB SOF event function from the interrupt
     \param[in]  uhost: pointer to USB host
@@ -416,12 +577,15 @@ static uint8_t usb_ev_sof (usbh_host *uhost)
 {
     usb_core_driver *udev = (usb_core_driver *)uhost->data;
 
-    /* this callback could be used to implement a scheduler process */
-    uhost->control.timer = (uint16_t)usb_curframe_get(udev);
+    /* the interrupt pipes are started in their slots by the classes, see usbh_pipe_sched_due() */
+    for (usbh_host *dev = uhost; NULL != dev; dev = dev->next) {
+        dev->control.timer = (uint16_t)usb_curframe_get(udev);
 
-    if (uhost->active_class != NULL) {
-        if (uhost->active_class->class_sof != NULL) {
-            uhost->active_class->class_sof(uhost);
+        /* the class data is set once the class init has run */
+        if ((dev->active_class != NULL) && (NULL != dev->class_data)) {
+            if (dev->active_class->class_sof != NULL) {
+                dev->active_class->class_sof(dev);
+            }
         }
     }
 
@@ -506,10 +670,10 @@ static usbh_status usbh_enum_task (usbh_host *uhost)
 
     case ENUM_SET_ADDR: 
         /* set address */
-        if (USBH_OK == usbh_setaddress (uhost, USBH_DEV_ADDR)) {
+        if (USBH_OK == usbh_setaddress (uhost, uhost->dev_addr)) {
             usb_mdelay (2U);
 
-            uhost->dev_prop.addr = USBH_DEV_ADDR;
+            uhost->dev_prop.addr = uhost->dev_addr;
 
             /* user callback for device address assigned */
             uhost->usr_cb->dev_address_set();
@@ -38,6 +38,7 @@ OF SUCH DAMAGE.
 
 /* local function prototypes ('static') */
 static uint16_t usbh_freepipe_get (usb_core_driver *udev);
+static uint16_t usbh_pipe_bus_time (uint32_t speed, uint16_t mps);
 
 /*!
     \brief      create a pipe
@@ -123,6 +124,7 @@ uint8_t usbh_pipe_allocate (usb_core_driver *udev, uint8_t ep_addr)
 
     if (HP_ERROR != pp_num) {
         udev->host.pipe[pp_num].in_used = 1U;
+        udev->host.pipe[pp_num].interval = 0U;
         udev->host.pipe[pp_num].ep.dir = EP_DIR(ep_addr);
         udev->host.pipe[pp_num].ep.num = EP_ID(ep_addr);
     }
@@ -163,6 +165,170 @@ uint8_t usbh_pipe_delete (usb_core_driver *udev)
     return USBH_OK;
 }
 
+/*!
+    \brief      free the data pipes bound to a device address
+    \param[in]  udev: pointer to USB core instance
+    \param[in]  dev_addr: device address
+    \param[out] none
+    \retval     operation status
+*/
+uint8_t usbh_pipe_dev_delete (usb_core_driver *udev, uint8_t dev_addr)
+{
+    uint8_t pp_num = 0U;
+
+    for (pp_num = 0U; pp_num < HP_MAX; pp_num++) {
+        usb_pipe *pp = &udev->host.pipe[pp_num];
+
+        /* control pipes are shared by all devices and owned by the root port */
+        if ((pp->in_used) && (dev_addr == pp->dev_addr) && (USB_EPTYPE_CTRL != pp->ep.type)) {
+            (void)usb_pipe_halt (udev, pp_num);
+
+            pp->in_used = 0U;
+        }
+    }
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      reserve bus time for an interrupt pipe in the periodic schedule
+    \param[in]  uhost: pointer to USB host of the device
+    \param[in]  pp_num: pipe number, created with its maximum packet length
+    \param[in]  interval: polling period in frames, in microframes at high speed
+    \param[out] none
+    \retval     operation status: USBH_FAIL when no slot has room for the pipe
+*/
+usbh_status usbh_pipe_sched_add (usbh_host *uhost, uint8_t pp_num, uint16_t interval)
+{
+    usbh_host *root = usbh_root_get (uhost);
+    usb_core_driver *udev = (usb_core_driver *)uhost->data;
+    usb_pipe *pp = &udev->host.pipe[pp_num];
+    uint16_t budget, period = 1U, phase, slot, best = 0xFFFFU, best_load = 0xFFFFU;
+    uint16_t time = usbh_pipe_bus_time (pp->dev_speed, pp->ep.mps);
+
+    /* the (micro)frames of the root port are the slots, high speed hubs do not change them */
+    budget = (PORT_SPEED_HIGH == root->dev_prop.speed) ? USBH_SCHED_HS_BUDGET : USBH_SCHED_FS_BUDGET;
+
+    /* the period is rounded down to a power of two, so each pipe keeps to the same slots */
+    while ((((uint32_t)period << 1U) <= interval) && (((uint32_t)period << 1U) <= USBH_SCHED_SLOTS)) {
+        period <<= 1U;
+    }
+
+    /* take the phase whose busiest slot is the least loaded */
+    for (phase = 0U; phase < period; phase++) {
+        uint16_t load = 0U;
+
+        for (slot = phase; slot < USBH_SCHED_SLOTS; slot += period) {
+            if (root->sched_load[slot] > load) {
+                load = root->sched_load[slot];
+            }
+        }
+
+        if (((load + time) <= budget) && (load < best_load)) {
+            best = phase;
+            best_load = load;
+        }
+    }
+
+    if (0xFFFFU == best) {
+        return USBH_FAIL;
+    }
+
+    for (slot = best; slot < USBH_SCHED_SLOTS; slot += period) {
+        root->sched_load[slot] += time;
+    }
+
+    pp->interval = period;
+    pp->phase = best;
+    pp->bus_time = time;
+    pp->sched_frame = (uint16_t)(usb_curframe_get (udev) & USBH_FRAME_MASK);
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      release the bus time of an interrupt pipe
+    \param[in]  uhost: pointer to USB host of the device
+    \param[in]  pp_num: pipe number
+    \param[out] none
+    \retval     none
+*/
+void usbh_pipe_sched_del (usbh_host *uhost, uint8_t pp_num)
+{
+    usbh_host *root = usbh_root_get (uhost);
+    usb_pipe *pp = &((usb_core_driver *)uhost->data)->host.pipe[pp_num];
+
+    if (0U != pp->interval) {
+        for (uint16_t slot = pp->phase; slot < USBH_SCHED_SLOTS; slot += pp->interval) {
+            root->sched_load[slot] -= pp->bus_time;
+        }
+
+        pp->interval = 0U;
+    }
+}
+
+/*!
+    \brief      check whether an interrupt pipe may start a transfer in this (micro)frame,
+                and take the slot when it may
+    \param[in]  uhost: pointer to USB host of the device
+    \param[in]  pp_num: pipe number
+    \param[out] none
+    \retval     1 once per period: in the slot of the pipe, or at once when the slot was missed
+*/
+uint8_t usbh_pipe_sched_due (usbh_host *uhost, uint8_t pp_num)
+{
+    usb_core_driver *udev = (usb_core_driver *)uhost->data;
+    usb_pipe *pp = &udev->host.pipe[pp_num];
+    uint16_t frame = (uint16_t)(usb_curframe_get (udev) & USBH_FRAME_MASK);
+    uint16_t elapsed = (uint16_t)((frame - pp->sched_frame) & USBH_FRAME_MASK);
+
+    if (0U == pp->interval) {
+        /* not scheduled */
+        return 1U;
+    }
+
+    if ((0U == elapsed) || ((elapsed < pp->interval) && ((frame & (pp->interval - 1U)) != pp->phase))) {
+        return 0U;
+    }
+
+    pp->sched_frame = frame;
+
+    return 1U;
+}
+
+/*!
+    \brief      bus time of an interrupt transaction with the worst case bit stuffing (USB 2.0 5.11.3)
+    \param[in]  speed: device speed
+    \param[in]  mps: maximum packet length
+    \param[out] none
+    \retval     bus time in 100 ns units
+*/
+static uint16_t usbh_pipe_bus_time (uint32_t speed, uint16_t mps)
+{
+    /* data bits with stuffing and the 3.167 bit times of the sync and EOP, in 1/6 bit */
+    uint32_t bits6 = 19U + (uint32_t)mps * 8U * 7U;
+    uint32_t ns;
+
+    switch (speed) {
+    case PORT_SPEED_HIGH:
+        /* 2.083 ns per bit */
+        ns = 916U + (bits6 * 2083U) / 6000U;
+        break;
+
+    case PORT_SPEED_LOW:
+        /* 676.67 ns per bit */
+        ns = 64060U + (bits6 * 67667U) / 600U;
+        break;
+
+    default:
+        /* 83.54 ns per bit */
+        ns = 9107U + (bits6 * 8354U) / 600U;
+        break;
+    }
+
+    return (uint16_t)((ns + 99U) / 100U);
+}
+
 /*!
     \brief      get a free pipe number for allocation
     \param[in]  udev: pointer to USB core instance
@@ -46,6 +46,8 @@ static void usbh_data_out_transc    (usbh_host *uhost);
 static void usbh_status_in_transc   (usbh_host *uhost);
 static void usbh_status_out_transc  (usbh_host *uhost);
 static uint32_t usbh_request_submit (usb_core_driver *udev, uint8_t pp_num);
+static usbh_status usbh_ctlpipe_acquire (usbh_host *uhost);
+static void usbh_ctlpipe_release    (usbh_host *uhost);
 
 /*!
     \brief      send the setup packet to the USB device
@@ -171,7 +173,9 @@ usbh_status usbh_ctl_handler (usbh_host *uhost)
 
     switch (uhost->control.ctl_state) {
     case CTL_SETUP:
-        usbh_setup_transc (uhost);
+        if (USBH_OK == usbh_ctlpipe_acquire (uhost)) {
+            usbh_setup_transc (uhost);
+        }
         break;
 
     case CTL_DATA_IN:
@@ -191,6 +195,8 @@ usbh_status usbh_ctl_handler (usbh_host *uhost)
         break;
 
     case CTL_FINISH:
+        usbh_ctlpipe_release (uhost);
+
         uhost->control.ctl_state = CTL_IDLE;
 
         status = USBH_OK;
@@ -201,6 +207,8 @@ usbh_status usbh_ctl_handler (usbh_host *uhost)
             /* do the transmission again, starting from SETUP packet */
             uhost->control.ctl_state = CTL_SETUP;
         } else {
+            usbh_ctlpipe_release (uhost);
+
             status = USBH_FAIL;
         }
         break;
@@ -212,6 +220,60 @@ usbh_status usbh_ctl_handler (usbh_host *uhost)
     return status;
 }
 
+/*!
+    \brief      take the control pipes for a control transfer
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status usbh_ctlpipe_acquire (usbh_host *uhost)
+{
+    usbh_host *root = usbh_root_get (uhost);
+    usb_core_driver *udev = (usb_core_driver *)uhost->data;
+    usb_pipe *pp = &udev->host.pipe[uhost->control.pipe_out_num];
+
+    /* the control pipes are shared by all devices behind hubs, one transfer at a time */
+    if ((NULL != root->ctl_owner) && (uhost != root->ctl_owner)) {
+        return USBH_BUSY;
+    }
+
+    root->ctl_owner = uhost;
+
+    /* point the pipes to the device if another device used them last */
+    if ((pp->dev_addr != uhost->dev_prop.addr) || 
+        (pp->dev_speed != uhost->dev_prop.speed) || 
+        (pp->ep.mps != uhost->control.max_len)) {
+        usbh_pipe_create (udev,
+                          &uhost->dev_prop,
+                          uhost->control.pipe_in_num,
+                          USB_EPTYPE_CTRL,
+                          (uint16_t)uhost->control.max_len);
+
+        usbh_pipe_create (udev,
+                          &uhost->dev_prop,
+                          uhost->control.pipe_out_num,
+                          USB_EPTYPE_CTRL,
+                          (uint16_t)uhost->control.max_len);
+    }
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      give the control pipes back after a control transfer
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     none
+*/
+static void usbh_ctlpipe_release (usbh_host *uhost)
+{
+    usbh_host *root = usbh_root_get (uhost);
+
+    if (uhost == root->ctl_owner) {
+        root->ctl_owner = NULL;
+    }
+}
+
 /*!
     \brief      wait for USB URB(USB request block) state
     \param[in]  uhost: pointer to USB host
@@ -367,6 +429,7 @@ static uint32_t usbh_request_submit (usb_core_driver *udev, uint8_t pp_num)
 {
     udev->host.pipe[pp_num].urb_state = URB_IDLE;
     udev->host.pipe[pp_num].xfer_count = 0U;
+    udev->host.backup_xfercount[pp_num] = 0U;
 
     if (1U == udev->host.pipe[pp_num].do_ping) {
         (void)usb_pipe_ping (udev, (uint8_t)pp_num);
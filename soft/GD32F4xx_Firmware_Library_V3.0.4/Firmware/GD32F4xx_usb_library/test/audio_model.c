@@ -0,0 +1,410 @@
+/*!
+    \file    audio_model.c
+    \brief   clock drift model of the audio speaker path: the host clock
+             against an I2S clock off by a few hundred ppm
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+/*
+    audio_core.c, audio_out_itf.c and audio_resampler.c are built with the
+    configuration of the audio example; this file replaces the endpoint
+    functions of the device core and the codec layer of the example.
+
+    Time advances one USB frame (1 ms) at a time. In each frame the I2S
+    consumes its share of samples at its own rate, from the chunk the DMA
+    plays in switch-buffer mode, and asks the class for the next chunk at
+    the end of each one as the DMA interrupt does; then comes the SOF, the
+    OUT packet of the host and the feedback IN transfer. A host following
+    the feedback sends the samples of the last 10.14 value it read (every
+    2^FEEDBACK_IN_INTERVAL frames); a host ignoring it sends 48 samples per
+    frame. Each sample frame of the host carries a sequence number and its
+    complement, so the played stream can be checked for lost, repeated or
+    corrupted frames.
+
+    Each case runs AD_RUN_FRAMES frames (10 minutes); the level and the
+    feedback ranges are taken after AD_SETTLE_FRAMES.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "audio_core.h"
+#include "audio_out_itf.h"
+
+#define AD_RUN_FRAMES               600000L                             /* 10 minutes of 1 ms frames */
+#define AD_SETTLE_FRAMES            20000L
+#define AD_HOST_RATE                48.0                                /* samples per frame of a host ignoring the feedback */
+#define AD_FB_TOLERANCE_HZ          10.0                                /* feedback against the true I2S rate */
+#define AD_LEVEL_SPREAD             16                                  /* bytes, after the settle time */
+
+typedef struct
+{
+    double      ppm;                                                    /* I2S clock error */
+    int         host_fb;                                                /* the host follows the feedback */
+    int         expect_drift;                                           /* no rate control: overruns or underruns expected */
+} ad_case;
+
+/* endpoint transfers prepared by the class */
+static uint8_t *rx_ptr;
+static uint32_t rx_len;
+static uint8_t fb_bytes[4];
+
+/* I2S DMA in switch-buffer mode */
+static struct
+{
+    uint8_t    *mem[2];                                                 /* chunk played, next chunk */
+    uint8_t     cur;
+    uint8_t     running;
+    double      pos;                                                    /* halfwords of the current chunk played */
+} dma;
+
+/* played stream */
+static struct
+{
+    int16_t     prev;
+    int         have;
+    int         counting;                                               /* after the settle time */
+    uint64_t    frames;
+    uint64_t    breaks;
+    uint64_t    silent;
+} play;
+
+static int failures;
+
+/* device core: endpoint functions used by the audio class */
+uint32_t usbd_ep_setup (usb_core_driver *udev, const usb_desc_ep *ep_desc)
+{
+    return 0U;
+}
+
+uint32_t usbd_ep_clear (usb_core_driver *udev, uint8_t ep_addr)
+{
+    return 0U;
+}
+
+uint32_t usbd_ep_recev (usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uint32_t len)
+{
+    rx_ptr = pbuf;
+    rx_len = len;
+
+    return 0U;
+}
+
+uint32_t usbd_ep_send (usb_core_driver *udev, uint8_t ep_addr, uint8_t *pbuf, uint32_t len)
+{
+    memcpy(fb_bytes, pbuf, (len < sizeof(fb_bytes)) ? len : sizeof(fb_bytes));
+
+    return 0U;
+}
+
+uint32_t usbd_fifo_flush (usb_core_driver *udev, uint8_t ep_addr)
+{
+    return 0U;
+}
+
+usb_status usb_txfifo_flush (usb_core_regs *usb_regs, uint8_t fifo_num)
+{
+    return USB_OK;
+}
+
+/* codec layer of the audio example */
+void codec_gpio_init (void)
+{
+}
+
+void codec_audio_interface_init (uint32_t audio_freq)
+{
+}
+
+void codec_audio_interface_deinit (void)
+{
+}
+
+void codec_i2s_dma_init (void)
+{
+}
+
+/*!
+    \brief      start the DMA on the first chunk, the next one is queued at once
+    \param[in]  addr: first chunk
+    \param[in]  size: size of the chunk
+    \param[out] none
+    \retval     none
+*/
+void audio_play (uint32_t addr, uint32_t size)
+{
+    /* the model is linked without PIE: the address of the ring fits in 32 bits */
+    dma.mem[0] = (uint8_t *)(uintptr_t)addr;
+    dma.mem[1] = usbd_audio_spk_next_chunk();
+    dma.cur = 0U;
+    dma.pos = 0.0;
+    dma.running = 1U;
+}
+
+void audio_pause_resume (uint32_t cmd, uint32_t addr, uint32_t size)
+{
+}
+
+void audio_stop (void)
+{
+    dma.running = 0U;
+}
+
+/*!
+    \brief      halfwords the DMA has still to send from the current chunk
+    \param[in]  none
+    \param[out] none
+    \retval     halfwords
+*/
+uint32_t audio_dma_remain (void)
+{
+    return dma.running ? (AD_OUT_CHUNK_SIZE / 2U) - (uint32_t)dma.pos : (AD_OUT_CHUNK_SIZE / 2U);
+}
+
+/*!
+    \brief      check one played sample frame against the sequence of the host
+    \param[in]  left: left sample
+    \param[in]  right: right sample
+    \param[out] none
+    \retval     none
+*/
+static void play_frame (int16_t left, int16_t right)
+{
+    if (!play.counting) {
+        play.prev = left;
+        play.have = !((0 == left) && (0 == right));
+        return;
+    }
+
+    play.frames++;
+
+    if ((0 == left) && (0 == right)) {
+        play.silent++;
+        return;
+    }
+
+    if ((right != (int16_t)~left) || (play.have && (left != (int16_t)(play.prev + 1)))) {
+        play.breaks++;
+    }
+
+    play.prev = left;
+    play.have = 1;
+}
+
+/*!
+    \brief      let the I2S consume samples, switching chunks as the DMA does
+    \param[in]  halfwords: halfwords consumed
+    \param[out] none
+    \retval     none
+*/
+static void dma_advance (double halfwords)
+{
+    const double chunk = (double)(AD_OUT_CHUNK_SIZE / 2U);
+
+    while (dma.running && (halfwords > 0.0)) {
+        double step = (halfwords < (chunk - dma.pos)) ? halfwords : (chunk - dma.pos);
+        uint32_t from = (uint32_t)dma.pos;
+        uint32_t to = (uint32_t)(dma.pos + step);
+        const int16_t *s = (const int16_t *)dma.mem[dma.cur];
+
+        for (uint32_t k = from & ~1U; k + 1U < to; k += 2U) {
+            play_frame(s[k], s[k + 1U]);
+        }
+
+        dma.pos += step;
+        halfwords -= step;
+
+        if (dma.pos >= chunk) {
+            uint8_t done = dma.cur;
+
+            /* transfer complete interrupt: the finished buffer gets the chunk after next */
+            dma.pos = 0.0;
+            dma.cur ^= 1U;
+            dma.mem[done] = usbd_audio_spk_next_chunk();
+        }
+    }
+}
+
+/*!
+    \brief      run one case and check it
+    \param[in]  c: case
+    \param[out] none
+    \retval     none
+*/
+static void ad_run (const ad_case *c)
+{
+    static usb_core_driver udev;
+    usb_req req;
+    double i2s_hz = (double)I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ) * (1.0 + (c->ppm * 1e-6));
+    double host_rate = AD_HOST_RATE;
+    double acc = 0.0;
+    double fb_min = 1e9, fb_max = 0.0;
+    long lvl_min = 0x7FFFFFFFL, lvl_max = -0x7FFFFFFFL;
+    int16_t seq = 0;
+    int fail = 0;
+
+    memset(&udev, 0, sizeof(udev));
+    memset(&dma, 0, sizeof(dma));
+    memset(&play, 0, sizeof(play));
+    memset(fb_bytes, 0, sizeof(fb_bytes));
+
+    udev.bp.core_speed = USB_SPEED_FULL;
+    udev.dev.class_core = &usbd_audio_cb;
+
+    usbd_audio_cb.init(&udev, 0U);
+
+    memset(&req, 0, sizeof(req));
+    req.wValue = 1U;
+    usbd_audio_cb.set_intf(&udev, &req);
+
+    for (long k = 0; k < AD_RUN_FRAMES; k++) {
+        uint32_t n, bytes;
+        long lvl;
+
+        play.counting = (k >= AD_SETTLE_FRAMES);
+
+        dma_advance(i2s_hz * 1e-3 * SPEAKER_OUT_CHANNEL_NBR);
+
+        usbd_audio_cb.SOF(&udev);
+
+        /* OUT packet of the host */
+        if (c->host_fb && (0 == (k & ((1L << FEEDBACK_IN_INTERVAL) - 1L))) && (0U != fb_bytes[2])) {
+            host_rate = (double)(fb_bytes[0] | ((uint32_t)fb_bytes[1] << 8) | ((uint32_t)fb_bytes[2] << 16)) / 16384.0;
+        }
+
+        acc += host_rate;
+        n = (uint32_t)acc;
+        acc -= n;
+
+        bytes = n * AD_OUT_FRAME_SIZE;
+        if (bytes > rx_len) {
+            bytes = rx_len;
+        }
+
+        for (uint32_t i = 0U; i + 1U < bytes / 2U; i += 2U) {
+            ((int16_t *)rx_ptr)[i] = seq;
+            ((int16_t *)rx_ptr)[i + 1U] = (int16_t)~seq;
+            seq++;
+        }
+
+        udev.dev.transc_out[EP_ID(AD_OUT_EP)].xfer_count = bytes;
+        usbd_audio_cb.data_out(&udev, EP_ID(AD_OUT_EP));
+        usbd_audio_cb.data_in(&udev, EP_ID(AD_FEEDBACK_IN_EP));
+
+        if (k >= AD_SETTLE_FRAMES) {
+            /* bytes in the ring, less the part of the playing chunk already sent */
+            lvl = (long)(audio_handler.rx_total - audio_handler.play_total)
+                - (long)(audio_handler.chunk_release[audio_handler.chunk_head]
+                         * (AD_OUT_CHUNK_SIZE - audio_dma_remain() * 2U) / AD_OUT_CHUNK_SIZE);
+
+            if (lvl < lvl_min) {
+                lvl_min = lvl;
+            }
+
+            if (lvl > lvl_max) {
+                lvl_max = lvl;
+            }
+
+            if ((double)audio_handler.actual_freq < fb_min) {
+                fb_min = audio_handler.actual_freq;
+            }
+
+            if ((double)audio_handler.actual_freq > fb_max) {
+                fb_max = audio_handler.actual_freq;
+            }
+        }
+    }
+
+    printf("  I2S %+5.0f ppm  host %-7s  underruns %5u  overruns %5u  level %5ld..%-5ld  fb %5.0f..%-5.0f Hz"
+           "  played %9llu  breaks %6llu  silent %llu\n",
+           c->ppm, c->host_fb ? "follows" : "ignores", audio_handler.underrun_count, audio_handler.overrun_count,
+           lvl_min, lvl_max, fb_min, fb_max, (unsigned long long)play.frames,
+           (unsigned long long)play.breaks, (unsigned long long)play.silent);
+
+    if (c->expect_drift) {
+        /* without rate control the model has to show the drift it is meant to catch */
+        if ((0U == audio_handler.overrun_count) && (0U == audio_handler.underrun_count)) {
+            printf("FAIL: no overrun nor underrun without rate control\n");
+            fail = 1;
+        }
+    } else {
+        if ((0U != audio_handler.underrun_count) || (0U != audio_handler.overrun_count)) {
+            printf("FAIL: underruns or overruns\n");
+            fail = 1;
+        }
+
+        if ((lvl_max - lvl_min) > AD_LEVEL_SPREAD) {
+            printf("FAIL: level spread %ld bytes\n", lvl_max - lvl_min);
+            fail = 1;
+        }
+
+        if (0U != play.silent) {
+            printf("FAIL: silence played after the settle time\n");
+            fail = 1;
+        }
+
+#ifndef USE_USB_AD_RESAMPLER
+        /* the resampler interpolates the samples: the sequence only holds without it */
+        if (0U != play.breaks) {
+            printf("FAIL: breaks in the played sequence\n");
+            fail = 1;
+        }
+
+        if ((fb_min < i2s_hz - AD_FB_TOLERANCE_HZ) || (fb_max > i2s_hz + AD_FB_TOLERANCE_HZ)) {
+            printf("FAIL: feedback off the I2S rate of %.0f Hz\n", i2s_hz);
+            fail = 1;
+        }
+#endif /* USE_USB_AD_RESAMPLER */
+    }
+
+    usbd_audio_cb.deinit(&udev, 0U);
+
+    failures += fail;
+}
+
+int main (void)
+{
+#ifdef USE_USB_AD_RESAMPLER
+    /* the resampler takes the stream of a host ignoring the feedback */
+    static const ad_case cases[] = {
+        {    0.0, 0, 0 },
+        { +100.0, 0, 0 },
+        { -100.0, 0, 0 },
+        { +300.0, 0, 0 },
+        { -300.0, 0, 0 },
+    };
+#else
+    static const ad_case cases[] = {
+        {    0.0, 1, 0 },
+        { +100.0, 1, 0 },
+        { -100.0, 1, 0 },
+        { +300.0, 1, 0 },
+        { -300.0, 1, 0 },
+        { +100.0, 0, 1 },
+    };
+#endif /* USE_USB_AD_RESAMPLER */
+
+    printf("audio speaker model%s: %u byte ring, target level %u, I2S nominal %u Hz, %ld s per case\n",
+#ifdef USE_USB_AD_RESAMPLER
+           " with the resampler",
+#else
+           "",
+#endif /* USE_USB_AD_RESAMPLER */
+           (unsigned)TOTAL_OUT_BUF_SIZE, (unsigned)AD_OUT_TARGET_LEVEL,
+           (unsigned)I2S_ACTUAL_SAM_FREQ(USBD_SPEAKER_FREQ), AD_RUN_FRAMES / 1000L);
+
+    for (uint32_t i = 0U; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        ad_run(&cases[i]);
+    }
+
+    if (0 != failures) {
+        printf("%d cases failed\n", failures);
+        return 1;
+    }
+
+    printf("all cases passed\n");
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*!
+    \file    audio_rs.c
+    \brief   signal to noise ratio of the audio resampler
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+/*
+    A 1 kHz plus 15 kHz tone at 48 kHz goes through audio_resampler_run()
+    in packets of 49 frames at the ratios of a clock drift (0, +-500 ppm)
+    and of a 1% error. Each output frame k is compared with the tones at the
+    input position k * ratio, shifted by the delay of the filter: the delay
+    is searched around the filter length and the best ratio of signal to
+    error power is kept. The first frames, where the history fills, are left
+    out.
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include "audio_core.h"
+#include "audio_resampler.h"
+
+#define RS_IN_FRAMES                200000U
+#define RS_OUT_FRAMES               190000U
+#define RS_SKIP_FRAMES              1000U
+#define RS_MIN_SNR_DB               70.0
+
+#define RS_F1                       (1000.0 / 48000.0)
+#define RS_F2                       (15000.0 / 48000.0)
+
+static int16_t in[RS_IN_FRAMES * AD_RS_CHANNELS];
+static int16_t out[(RS_OUT_FRAMES + 2U * 48U) * AD_RS_CHANNELS];
+
+/*!
+    \brief      the test signal at a position in input frames
+    \param[in]  t: position
+    \param[out] none
+    \retval     sample, full scale 1.0
+*/
+static double rs_tone (double t)
+{
+    return 0.45 * sin(2.0 * M_PI * RS_F1 * t) + 0.45 * sin(2.0 * M_PI * RS_F2 * t);
+}
+
+/*!
+    \brief      resample the test signal and measure it
+    \param[in]  ratio: input frames per output frame
+    \param[out] none
+    \retval     signal to noise ratio in dB
+*/
+static double rs_snr (double ratio)
+{
+    static audio_resampler_struct rs;
+    uint32_t step = (uint32_t)llround(ratio * (double)AD_RS_STEP_ONE);
+    uint32_t used = 0U, made = 0U;
+    double best = 0.0;
+
+    audio_resampler_init(&rs);
+    audio_resampler_ratio_set(&rs, step);
+
+    while (made < RS_OUT_FRAMES) {
+        uint32_t n = (RS_IN_FRAMES - used < 49U) ? (RS_IN_FRAMES - used) : 49U;
+        uint32_t o = audio_resampler_run(&rs, &in[used * AD_RS_CHANNELS], &n, &out[made * AD_RS_CHANNELS], 48U);
+
+        used += n;
+        made += o;
+
+        if ((0U == o) && (0U == n)) {
+            break;
+        }
+    }
+
+    for (double dl = -12.0; dl <= 12.0; dl += 0.5) {
+        double signal = 0.0, noise = 0.0;
+
+        for (uint32_t k = RS_SKIP_FRAMES; k + 100U < made; k++) {
+            double v = rs_tone((double)k * step / (double)AD_RS_STEP_ONE + dl);
+
+            for (uint32_t c = 0U; c < AD_RS_CHANNELS; c++) {
+                double e = out[k * AD_RS_CHANNELS + c] / 32767.0 - v;
+
+                noise += e * e;
+                signal += v * v;
+            }
+        }
+
+        if (10.0 * log10(signal / noise) > best) {
+            best = 10.0 * log10(signal / noise);
+        }
+    }
+
+    return best;
+}
+
+int main (void)
+{
+    static const double ratios[] = { 1.0, 1.0005, 0.9995, 1.01 };
+    int failures = 0;
+
+    for (uint32_t i = 0U; i < RS_IN_FRAMES; i++) {
+        for (uint32_t c = 0U; c < AD_RS_CHANNELS; c++) {
+            in[i * AD_RS_CHANNELS + c] = (int16_t)lrint(rs_tone(i) * 32767.0);
+        }
+    }
+
+    printf("audio resampler: %u taps, %u phases, 1 kHz + 15 kHz at 48 kHz\n",
+           (unsigned)AD_RS_TAPS, (unsigned)AD_RS_PHASES);
+
+    for (uint32_t r = 0U; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+        double snr = rs_snr(ratios[r]);
+
+        printf("  ratio %.4f  SNR %5.1f dB\n", ratios[r], snr);
+
+        if (snr < RS_MIN_SNR_DB) {
+            printf("FAIL: below %.0f dB\n", RS_MIN_SNR_DB);
+            failures++;
+        }
+    }
+
+    if (0 != failures) {
+        printf("%d ratios failed\n", failures);
+        return 1;
+    }
+
+    printf("all ratios passed\n");
+    return 0;
+}
@@ -0,0 +1,248 @@
+/*!
+    \file    bench_cdc.c
+    \brief   CDC ACM bench: bulk echo throughput and round trip time of the
+             device class against a minimal host class of the data interface
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#include <string.h>
+#include "usbbench.h"
+#include "cdc_acm_core.h"
+#include "usbh_pipe.h"
+#include "usbh_transc.h"
+#include "usbh_enum.h"
+
+#define CDC_CLASS                   0x02U
+#define CDC_DATA_CLASS              0x0AU
+
+#ifdef USE_USB_HS
+    #define ECHO_BYTES              (512U * 1024U)
+#else
+    #define ECHO_BYTES              (128U * 1024U)
+#endif /* USE_USB_HS */
+
+#define RTT_OPS                     200U
+#define CDC_TIMEOUT_NS              20000000000ULL
+
+/* state of the host class */
+typedef enum
+{
+    CDC_H_IDLE = 0U,
+    CDC_H_SEND,
+    CDC_H_SEND_WAIT,
+    CDC_H_RECEIVE,
+    CDC_H_RECEIVE_WAIT,
+} cdc_h_state;
+
+typedef struct
+{
+    cdc_h_state state;
+    uint8_t     pipe_in;
+    uint8_t     pipe_out;
+    uint8_t     ep_in;
+    uint8_t     ep_out;
+    uint16_t    mps;
+    uint8_t     ready;
+
+    uint8_t     tx[USB_CDC_DATA_PACKET_SIZE];
+    uint8_t     rx[2U * USB_CDC_DATA_PACKET_SIZE];
+    uint16_t    len;                                                    /* bytes of the echo under way */
+    uint32_t    echoed;                                                 /* echoes completed */
+} cdc_host_handler;
+
+static cdc_host_handler cdc_h;
+
+/*!
+    \brief      open the bulk pipes of the data interface
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status cdc_h_init (usbh_host *uhost)
+{
+    uint8_t itf = usbh_interface_find(&uhost->dev_prop, CDC_DATA_CLASS, 0xFFU, 0xFFU);
+
+    if (0xFFU == itf) {
+        uhost->usr_cb->dev_not_supported();
+
+        return USBH_FAIL;
+    }
+
+    memset(&cdc_h, 0, sizeof(cdc_h));
+    uhost->class_data = &cdc_h;
+
+    for (uint8_t i = 0U; i < 2U; i++) {
+        usb_desc_ep *ep = &uhost->dev_prop.cfg_desc_set.itf_desc_set[itf][0].ep_desc[i];
+
+        if (ep->bEndpointAddress & 0x80U) {
+            cdc_h.ep_in = ep->bEndpointAddress;
+        } else {
+            cdc_h.ep_out = ep->bEndpointAddress;
+        }
+
+        cdc_h.mps = ep->wMaxPacketSize;
+    }
+
+    cdc_h.pipe_out = usbh_pipe_allocate(uhost->data, cdc_h.ep_out);
+    cdc_h.pipe_in = usbh_pipe_allocate(uhost->data, cdc_h.ep_in);
+
+    usbh_pipe_create(uhost->data, &uhost->dev_prop, cdc_h.pipe_out, USB_EPTYPE_BULK, cdc_h.mps);
+    usbh_pipe_create(uhost->data, &uhost->dev_prop, cdc_h.pipe_in, USB_EPTYPE_BULK, cdc_h.mps);
+
+    usbh_pipe_toggle_set(uhost->data, cdc_h.pipe_out, 0U);
+    usbh_pipe_toggle_set(uhost->data, cdc_h.pipe_in, 0U);
+
+    return USBH_OK;
+}
+
+static void cdc_h_deinit (usbh_host *uhost)
+{
+    usbh_pipe_free(uhost->data, cdc_h.pipe_out);
+    usbh_pipe_free(uhost->data, cdc_h.pipe_in);
+}
+
+static usbh_status cdc_h_requests (usbh_host *uhost)
+{
+    cdc_h.ready = 1U;
+
+    return USBH_OK;
+}
+
+/*!
+    \brief      send cdc_h.tx and receive the echo into cdc_h.rx
+    \param[in]  uhost: pointer to USB host
+    \param[out] none
+    \retval     operation status
+*/
+static usbh_status cdc_h_machine (usbh_host *uhost)
+{
+    usb_urb_state urb;
+
+    switch (cdc_h.state) {
+    case CDC_H_SEND:
+        usbh_data_send(uhost->data, cdc_h.tx, cdc_h.pipe_out, cdc_h.len);
+        cdc_h.state = CDC_H_SEND_WAIT;
+        break;
+
+    case CDC_H_SEND_WAIT:
+        urb = usbh_urbstate_get(uhost->data, cdc_h.pipe_out);
+
+        if (URB_DONE == urb) {
+            cdc_h.state = CDC_H_RECEIVE;
+        } else if (URB_NOTREADY == urb) {
+            cdc_h.state = CDC_H_SEND;
+        } else if ((URB_STALL == urb) || (URB_ERROR == urb)) {
+            bench_fail("cdc: bulk OUT failed, URB state %u", (unsigned)urb);
+        }
+        break;
+
+    case CDC_H_RECEIVE:
+        /* the device ends a full packet with a zero length one (cdc_acm_in()) */
+        usbh_data_recev(uhost->data, cdc_h.rx, cdc_h.pipe_in, 2U * cdc_h.mps);
+        cdc_h.state = CDC_H_RECEIVE_WAIT;
+        break;
+
+    case CDC_H_RECEIVE_WAIT:
+        urb = usbh_urbstate_get(uhost->data, cdc_h.pipe_in);
+
+        if (URB_DONE == urb) {
+            if ((usbh_xfercount_get(uhost->data, cdc_h.pipe_in) != cdc_h.len) || memcmp(cdc_h.rx, cdc_h.tx, cdc_h.len)) {
+                bench_fail("cdc: echo %u differs, %u bytes back of %u", cdc_h.echoed,
+                           usbh_xfercount_get(uhost->data, cdc_h.pipe_in), cdc_h.len);
+            }
+
+            cdc_h.echoed++;
+            cdc_h.state = CDC_H_IDLE;
+        } else if ((URB_STALL == urb) || (URB_ERROR == urb)) {
+            bench_fail("cdc: bulk IN failed, URB state %u", (unsigned)urb);
+        }
+        break;
+
+    default:
+        break;
+    }
+
+    return USBH_OK;
+}
+
+static usbh_class usbh_cdc_bench =
+{
+    CDC_CLASS,
+    cdc_h_init,
+    cdc_h_deinit,
+    cdc_h_requests,
+    cdc_h_machine,
+};
+
+/* echo loop of the cdc_acm example */
+static void cdc_dev_app (void)
+{
+    if (USBD_CONFIGURED == bench_udev.dev.cur_status) {
+        if (0U == cdc_acm_check_ready(&bench_udev)) {
+            cdc_acm_data_receive(&bench_udev);
+        } else {
+            cdc_acm_data_send(&bench_udev);
+        }
+    }
+}
+
+static int cdc_ready (void)
+{
+    return (HOST_CLASS_HANDLER == bench_uhost.cur_state) && cdc_h.ready;
+}
+
+static int echo_idle (void)
+{
+    return CDC_H_IDLE == cdc_h.state;
+}
+
+/*!
+    \brief      echo one packet
+    \param[in]  len: bytes
+    \param[out] none
+    \retval     none
+*/
+static void cdc_echo (uint16_t len)
+{
+    for (uint16_t i = 0U; i < len; i++) {
+        cdc_h.tx[i] = (uint8_t)bench_rand();
+    }
+
+    cdc_h.len = len;
+    cdc_h.state = CDC_H_SEND;
+
+    bench_run(echo_idle, CDC_TIMEOUT_NS, "cdc echo");
+}
+
+/*!
+    \brief      CDC ACM bench: echo of full packets, then round trips of one byte
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_cdc (void)
+{
+    uint64_t t, lat, sum = 0U, max = 0U;
+
+    bench_dev_app = cdc_dev_app;
+    bench_attach(&cdc_desc, &cdc_class, &usbh_cdc_bench, cdc_ready);
+
+    bench_begin();
+    for (uint32_t n = 0U; n < ECHO_BYTES / cdc_h.mps; n++) {
+        cdc_echo(cdc_h.mps);
+    }
+    bench_end("cdc_echo", ECHO_BYTES, 0U, 0U, 0U);
+
+    bench_begin();
+    for (uint32_t n = 0U; n < RTT_OPS; n++) {
+        t = vbus_now();
+        cdc_echo(1U);
+        lat = (vbus_now() - t) / 1000U;
+        sum += lat;
+        max = (lat > max) ? lat : max;
+    }
+    bench_end("cdc_rtt", RTT_OPS, RTT_OPS, sum, max);
+}
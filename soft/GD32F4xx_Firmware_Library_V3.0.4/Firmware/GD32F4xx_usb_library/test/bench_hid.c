@@ -0,0 +1,141 @@
+/*!
+    \file    bench_hid.c
+    \brief   HID bench: latency of a key press from the report queued by the
+             keyboard device to the key decoded by the host class
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#include <string.h>
+#include "usbbench.h"
+#include "standard_hid_core.h"
+#include "usbh_hid_core.h"
+#include "usbh_standard_hid.h"
+
+#define KEY_OPS                     200U
+#define KEY_USAGE_A                 0x04U
+#define KEY_GAP_MIN_NS              2000000ULL                          /* 2 ms to 12 ms between the keys */
+#define KEY_GAP_RANGE_NS            10000000ULL
+#define HID_TIMEOUT_NS              10000000000ULL
+
+static struct
+{
+    uint32_t    pressed;                                                /* keys sent by the device */
+    uint32_t    decoded;                                                /* keys seen by the host */
+    uint64_t    press_at;                                               /* time of the report queued */
+    uint64_t    next_at;                                                /* time of the next key */
+    uint64_t    sum;
+    uint64_t    max;
+} key;
+
+/* host application callbacks of usbh_standard_hid.c */
+void usr_keybrd_init (void)
+{
+}
+
+void usr_keybrd_process_data (uint8_t data)
+{
+    uint64_t lat;
+
+    if ('a' != data) {
+        bench_fail("hid: key 0x%02x decoded, 'a' sent", data);
+    }
+
+    if (key.decoded >= key.pressed) {
+        bench_fail("hid: key decoded twice");
+    }
+
+    lat = (vbus_now() - key.press_at) / 1000U;
+    key.sum += lat;
+    key.max = (lat > key.max) ? lat : key.max;
+    key.decoded++;
+    key.next_at = vbus_now() + KEY_GAP_MIN_NS + (bench_rand() % KEY_GAP_RANGE_NS);
+}
+
+void usr_mouse_init (void)
+{
+}
+
+void usr_mouse_process_data (hid_mouse_info *data)
+{
+    bench_fail("hid: mouse report from a keyboard");
+}
+
+/* keyboard device: press 'a' at pseudo-random times, hid_data_in() sends the release */
+static void hid_dev_app (void)
+{
+    standard_hid_handler *hid;
+
+    if ((USBD_CONFIGURED != bench_udev.dev.cur_status) || (key.pressed > key.decoded) || (vbus_now() < key.next_at)) {
+        return;
+    }
+
+    hid = (standard_hid_handler *)bench_udev.dev.class_data[USBD_HID_INTERFACE];
+
+    if (hid->prev_transfer_complete) {
+        memset(hid->data, 0, sizeof(hid->data));
+        hid->data[2] = KEY_USAGE_A;
+
+        key.press_at = vbus_now();
+        key.pressed++;
+
+        hid_report_send(&bench_udev, hid->data, HID_IN_PACKET);
+    }
+}
+
+/*!
+    \brief      the host polls the keyboard, on the root port or behind a hub
+    \param[in]  none
+    \param[out] none
+    \retval     non-zero when it does
+*/
+int bench_hid_ready (void)
+{
+    usbh_host *uhost = usbh_class_dev_get(&bench_uhost, &usbh_hid, 0U);
+
+    if ((NULL == uhost) || (HOST_CLASS_HANDLER != uhost->cur_state)) {
+        return 0;
+    }
+
+    return HID_POLL == ((usbh_hid_handler *)uhost->class_data)->state;
+}
+
+static int keys_done (void)
+{
+    return key.decoded >= KEY_OPS;
+}
+
+/*!
+    \brief      HID bench: key presses at random times, polled by the host at the interval of the endpoint
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_hid (void)
+{
+    bench_attach(&hid_desc, &usbd_hid_cb, &usbh_hid, bench_hid_ready);
+
+    bench_hid_keys("hid_lat");
+}
+
+/*!
+    \brief      press KEY_OPS keys at random times and report their latency as a workload
+    \param[in]  name: name of the workload
+    \param[out] none
+    \retval     none
+*/
+void bench_hid_keys (const char *name)
+{
+    memset(&key, 0, sizeof(key));
+
+    key.next_at = vbus_now();
+    bench_dev_app = hid_dev_app;
+
+    bench_begin();
+    bench_run(keys_done, HID_TIMEOUT_NS, "hid keys");
+    bench_end(name, 0U, KEY_OPS, key.sum, key.max);
+
+    bench_dev_app = NULL;
+}
@@ -0,0 +1,327 @@
+/*!
+    \file    bench_hub.c
+    \brief   hub benches: two mass storage sticks sharing the bus, a keyboard
+             next to a stick that streams, and the speeds the hub class
+             serves
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#include <string.h>
+#include "usbbench.h"
+#include "standard_hid_core.h"
+#include "usbh_hub.h"
+#include "usbh_hid_core.h"
+#include "usbh_msc_core.h"
+
+#define STICKS                      2U
+#define DISK_BLOCK_SIZE             512U
+#define DISK_BLOCK_NUM              2048U                               /* 1 MB */
+#define XFER_BLOCKS                 32U                                 /* 16 KB per transfer */
+#define XFER_QUEUED                 2U
+#define XFER_TIMEOUT_NS             20000000000ULL
+#define FAIR_MIN_PCT                80U                                 /* least share of the slower stick */
+
+#ifdef USE_USB_HS
+    #define STICK_BYTES             (512U * 1024U)
+    #define STICK_HS                1
+#else
+    #define STICK_BYTES             (128U * 1024U)
+    #define STICK_HS                0
+#endif /* USE_USB_HS */
+
+static uint8_t disk[STICKS][DISK_BLOCK_NUM * DISK_BLOCK_SIZE];
+
+/* transfers of the host application to one stick */
+typedef struct
+{
+    msc_xfer    xfer[XFER_QUEUED];
+    uint8_t     buf[XFER_QUEUED][XFER_BLOCKS * DISK_BLOCK_SIZE];
+    uint8_t     busy[XFER_QUEUED];
+    msc_state   dir;
+    uint32_t    next;                                                   /* next block to submit */
+    uint32_t    end;                                                    /* block after the last one */
+    uint32_t    done;                                                   /* blocks completed */
+    uint32_t    seed;
+    int         loop;                                                   /* start again at block 0, as a background load */
+} stream;
+
+static stream app[STICKS];
+static uint32_t refused;
+
+static uint8_t pattern (uint32_t seed, uint32_t ofs)
+{
+    return (uint8_t)((ofs * 13U) + (ofs >> 9) + seed);
+}
+
+static void count_refused (void)
+{
+    refused++;
+}
+
+/*!
+    \brief      host of a stick served by the mass storage class
+    \param[in]  index: stick in order of attachment
+    \param[out] none
+    \retval     host, NULL when the stick is not ready
+*/
+static usbh_host *stick_host (uint8_t index)
+{
+    usbh_host *uhost = usbh_class_dev_get(&bench_uhost, &usbh_msc, index);
+
+    if ((NULL == uhost) || (HOST_CLASS_HANDLER != uhost->cur_state) ||
+        (MSC_IDLE != ((usbh_msc_handler *)uhost->class_data)->state)) {
+        return NULL;
+    }
+
+    return uhost;
+}
+
+/*!
+    \brief      keep XFER_QUEUED transfers submitted to a stick, verify the data read
+    \param[in]  index: stick
+    \param[out] none
+    \retval     none
+*/
+static void stream_run (uint8_t index)
+{
+    stream *s = &app[index];
+    usbh_host *uhost = usbh_class_dev_get(&bench_uhost, &usbh_msc, index);
+
+    for (uint32_t i = 0U; i < XFER_QUEUED; i++) {
+        msc_xfer *x = &s->xfer[i];
+
+        if (s->busy[i]) {
+            if (USBH_BUSY == x->status) {
+                continue;
+            }
+
+            if (USBH_OK != x->status) {
+                bench_fail("hub: stick %u %s of blocks %u-%u failed with status %u", index,
+                           (MSC_READ == x->dir) ? "read" : "write", x->address, x->address + x->length - 1U,
+                           (unsigned)x->status);
+            }
+
+            if (MSC_READ == x->dir) {
+                for (uint32_t k = 0U; k < x->length * DISK_BLOCK_SIZE; k++) {
+                    if (s->buf[i][k] != pattern(s->seed, x->address * DISK_BLOCK_SIZE + k)) {
+                        bench_fail("hub: stick %u data read differs at byte %u", index,
+                                   x->address * DISK_BLOCK_SIZE + k);
+                    }
+                }
+            }
+
+            s->done += x->length;
+            s->busy[i] = 0U;
+        }
+
+        if (s->loop && (s->next >= s->end)) {
+            s->next = 0U;
+        }
+
+        if (s->next < s->end) {
+            memset(x, 0, sizeof(*x));
+            x->dir = s->dir;
+            x->lun = 0U;
+            x->address = s->next;
+            x->length = ((s->end - s->next) < XFER_BLOCKS) ? (s->end - s->next) : XFER_BLOCKS;
+            x->pbuf = s->buf[i];
+
+            if (MSC_WRITE == s->dir) {
+                for (uint32_t k = 0U; k < x->length * DISK_BLOCK_SIZE; k++) {
+                    s->buf[i][k] = pattern(s->seed, x->address * DISK_BLOCK_SIZE + k);
+                }
+            }
+
+            if (USBH_OK != usbh_msc_submit(uhost, x)) {
+                bench_fail("hub: stick %u submit refused", index);
+            }
+
+            s->next += x->length;
+            s->busy[i] = 1U;
+        }
+    }
+}
+
+static void stream_start (uint8_t index, msc_state dir, uint32_t bytes, uint32_t seed, int loop)
+{
+    memset(&app[index], 0, sizeof(app[index]));
+    app[index].dir = dir;
+    app[index].end = bytes / DISK_BLOCK_SIZE;
+    app[index].seed = seed;
+    app[index].loop = loop;
+}
+
+static void sticks_app (void)
+{
+    for (uint8_t i = 0U; i < STICKS; i++) {
+        stream_run(i);
+    }
+}
+
+static void stick0_app (void)
+{
+    stream_run(0U);
+}
+
+static int sticks_ready (void)
+{
+    return (NULL != stick_host(0U)) && (NULL != stick_host(1U));
+}
+
+static int any_done (void)
+{
+    return (app[0].done >= app[0].end) || (app[1].done >= app[1].end);
+}
+
+static int all_done (void)
+{
+    return (app[0].done >= app[0].end) && (app[1].done >= app[1].end);
+}
+
+/*!
+    \brief      run the same transfer on both sticks at once, fail when one gets a lesser share of the bus
+    \param[in]  dir: MSC_READ or MSC_WRITE
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     none
+*/
+static void sticks_transfer (msc_state dir, uint32_t seed)
+{
+    uint32_t slow, fast;
+
+    for (uint8_t i = 0U; i < STICKS; i++) {
+        stream_start(i, dir, STICK_BYTES, seed + i, 0);
+    }
+
+    bench_host_app = sticks_app;
+
+    /* the share of each stick when the first one is through */
+    bench_run(any_done, XFER_TIMEOUT_NS, "hub transfer");
+
+    slow = (app[0].done < app[1].done) ? app[0].done : app[1].done;
+    fast = (app[0].done < app[1].done) ? app[1].done : app[0].done;
+
+    if ((slow * 100U) < (fast * FAIR_MIN_PCT)) {
+        bench_fail("hub: unfair %s, %u blocks on one stick and %u on the other", (MSC_READ == dir) ? "read" : "write",
+                   slow, fast);
+    }
+
+    bench_run(all_done, XFER_TIMEOUT_NS, "hub transfer");
+    bench_host_app = NULL;
+
+    if (MSC_WRITE == dir) {
+        for (uint8_t i = 0U; i < STICKS; i++) {
+            for (uint32_t k = 0U; k < STICK_BYTES; k++) {
+                if (disk[i][k] != pattern(seed + i, k)) {
+                    bench_fail("hub: stick %u data written differs at byte %u", i, k);
+                }
+            }
+        }
+    }
+}
+
+/*!
+    \brief      two sticks behind the hub, written and read at the same time
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_hub_msc (void)
+{
+    static usbh_class *const classes[] = {&usbh_hub, &usbh_msc};
+    vbus_func *ports[STICKS];
+
+    for (uint8_t i = 0U; i < STICKS; i++) {
+        ports[i] = vmodel_msc(i, disk[i], DISK_BLOCK_NUM, STICK_HS);
+    }
+
+    bench_attach_tree(NULL, NULL, vmodel_hub(ports, STICKS, STICK_HS), classes, 2U, sticks_ready);
+
+    bench_begin();
+    sticks_transfer(MSC_WRITE, 5U);
+    sticks_transfer(MSC_READ, 5U);
+    bench_end("hub_msc", 2U * STICKS * STICK_BYTES, 0U, 0U, 0U);
+}
+
+static int hid_stick_ready (void)
+{
+    return bench_hid_ready() && (NULL != stick_host(0U));
+}
+
+/*!
+    \brief      keyboard (the device core) and a stick behind the hub, key latency while the stick is written
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_hub_hid (void)
+{
+    static usbh_class *const classes[] = {&usbh_hub, &usbh_msc, &usbh_hid};
+    vbus_func *ports[2];
+
+    ports[0] = vcore_func();
+    ports[1] = vmodel_msc(0U, disk[0], DISK_BLOCK_NUM, STICK_HS);
+
+    bench_attach_tree(&hid_desc, &usbd_hid_cb, vmodel_hub(ports, 2U, STICK_HS), classes, 3U, hid_stick_ready);
+
+    stream_start(0U, MSC_WRITE, STICK_BYTES, 6U, 1);
+    bench_host_app = stick0_app;
+
+    bench_hid_keys("hub_hid");
+
+    bench_host_app = NULL;
+
+    if (0U == app[0].done) {
+        bench_fail("hub: no blocks written during the key presses");
+    }
+}
+
+static int speed_settled (void)
+{
+#ifdef USE_USB_HS
+    return (NULL != stick_host(0U)) && (HUB_PORT_SPEED_NOT_SUPPORTED == usbh_hub_port_state_get(&bench_uhost, 1U));
+#else
+    return sticks_ready();
+#endif /* USE_USB_HS */
+}
+
+/*!
+    \brief      a full-speed stick and a high-speed capable one behind the hub: behind a high-speed hub
+                the first needs split transactions and is refused with its port state, behind a
+                full-speed hub both are served
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_hub_speed (void)
+{
+    static usbh_class *const classes[] = {&usbh_hub, &usbh_msc};
+    vbus_func *ports[STICKS];
+    uint32_t expect = STICK_HS ? 1U : 0U;
+
+    ports[0] = vmodel_msc(0U, disk[0], DISK_BLOCK_NUM, 0);
+    ports[1] = vmodel_msc(1U, disk[1], DISK_BLOCK_NUM, 1);
+
+    refused = 0U;
+    bench_not_supported = count_refused;
+
+    bench_begin();
+    bench_attach_tree(NULL, NULL, vmodel_hub(ports, STICKS, STICK_HS), classes, 2U, speed_settled);
+
+    bench_not_supported = NULL;
+
+    if (refused != expect) {
+        bench_fail("hub: %u devices refused, %u expected", refused, expect);
+    }
+
+    if ((HUB_PORT_DEVICE != usbh_hub_port_state_get(&bench_uhost, 2U)) ||
+        ((STICK_HS ? HUB_PORT_SPEED_NOT_SUPPORTED : HUB_PORT_DEVICE) != usbh_hub_port_state_get(&bench_uhost, 1U))) {
+        bench_fail("hub: port states %u and %u", usbh_hub_port_state_get(&bench_uhost, 1U),
+                   usbh_hub_port_state_get(&bench_uhost, 2U));
+    }
+
+    bench_end("hub_enum", 0U, 0U, 0U, 0U);
+}
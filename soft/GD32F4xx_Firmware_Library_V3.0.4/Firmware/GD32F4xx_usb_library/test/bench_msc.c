@@ -0,0 +1,283 @@
+/*!
+    \file    bench_msc.c
+    \brief   mass storage bench: enumeration, WRITE10 and READ10 throughput
+             between the device class on a RAM disk and the host class
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#include <string.h>
+#include "usbbench.h"
+#include "usbd_msc_core.h"
+#include "usbd_msc_mem.h"
+#include "usbh_msc_core.h"
+
+#define DISK_BLOCK_SIZE             512U
+#define DISK_BLOCK_NUM              8192U                               /* 4 MB */
+#define XFER_BLOCKS                 128U                                /* 64 KB per transfer */
+#define XFER_QUEUED                 2U
+
+#ifdef USE_USB_HS
+    #define BENCH_BYTES             (1024U * 1024U)
+#else
+    #define BENCH_BYTES             (256U * 1024U)
+#endif /* USE_USB_HS */
+
+#define NAK_BYTES                   (64U * 1024U)
+#define BABBLE_EVERY                7U
+#define XFER_TIMEOUT_NS             20000000000ULL
+
+static uint8_t disk[DISK_BLOCK_NUM * DISK_BLOCK_SIZE];
+
+static const uint8_t inquiry_data[USBD_STD_INQUIRY_LENGTH] =
+{
+    0x00U, 0x80U, 0x00U, 0x01U, (USBD_STD_INQUIRY_LENGTH - 5U), 0x00U, 0x00U, 0x00U,
+    'G', 'D', '3', '2', ' ', ' ', ' ', ' ',
+    'V', 'B', 'U', 'S', ' ', 'R', 'A', 'M',
+    ' ', 'd', 'i', 's', 'k', ' ', ' ', ' ',
+    '1', '.', '0', '0'
+};
+
+static int8_t disk_init (uint8_t lun) { return 0; }
+static int8_t disk_ready (uint8_t lun) { return 0; }
+static int8_t disk_protected (uint8_t lun) { return 0; }
+static int8_t disk_maxlun (void) { return (int8_t)(MEM_LUN_NUM - 1U); }
+
+/* usbd_msc_scsi.c passes the byte address of the first block, as to the SRAM disk of msc_udisk */
+static int8_t disk_read (uint8_t lun, uint8_t *buf, uint32_t addr, uint16_t block_len)
+{
+    if ((addr + (uint32_t)block_len * DISK_BLOCK_SIZE) > sizeof(disk)) {
+        return -1;
+    }
+
+    memcpy(buf, &disk[addr], (size_t)block_len * DISK_BLOCK_SIZE);
+
+    return 0;
+}
+
+static int8_t disk_write (uint8_t lun, uint8_t *buf, uint32_t addr, uint16_t block_len)
+{
+    if ((addr + (uint32_t)block_len * DISK_BLOCK_SIZE) > sizeof(disk)) {
+        return -1;
+    }
+
+    memcpy(&disk[addr], buf, (size_t)block_len * DISK_BLOCK_SIZE);
+
+    return 0;
+}
+
+static usbd_mem_cb ram_disk_fops =
+{
+    .mem_init         = disk_init,
+    .mem_ready        = disk_ready,
+    .mem_protected    = disk_protected,
+    .mem_read         = disk_read,
+    .mem_write        = disk_write,
+    .mem_maxlun       = disk_maxlun,
+
+    .mem_inquiry_data = {(uint8_t *)inquiry_data},
+    .mem_block_size   = {DISK_BLOCK_SIZE},
+    .mem_block_len    = {DISK_BLOCK_NUM}
+};
+
+usbd_mem_cb *usbd_mem_fops = &ram_disk_fops;
+
+/* transfers of the host application */
+static struct
+{
+    msc_xfer    xfer[XFER_QUEUED];
+    uint8_t     buf[XFER_QUEUED][XFER_BLOCKS * DISK_BLOCK_SIZE];
+    uint8_t     busy[XFER_QUEUED];
+    msc_state   dir;
+    uint32_t    next;                                                   /* next block to submit */
+    uint32_t    end;                                                    /* block after the last one */
+    uint32_t    done;                                                   /* blocks completed */
+    uint32_t    seed;
+} app;
+
+/*!
+    \brief      contents of the disk
+    \param[in]  seed: seed of the pattern
+    \param[in]  ofs: byte offset
+    \param[out] none
+    \retval     byte
+*/
+static uint8_t pattern (uint32_t seed, uint32_t ofs)
+{
+    return (uint8_t)((ofs * 7U) + (ofs >> 9) + seed);
+}
+
+/*!
+    \brief      the host class is idle after the attach of the mass storage device
+    \param[in]  none
+    \param[out] none
+    \retval     non-zero when it is
+*/
+int bench_msc_ready (void)
+{
+    usbh_msc_handler *msc;
+
+    if ((HOST_CLASS_HANDLER != bench_uhost.cur_state) || (NULL == bench_uhost.active_class)) {
+        return 0;
+    }
+
+    msc = (usbh_msc_handler *)bench_uhost.class_data;
+
+    return MSC_IDLE == msc->state;
+}
+
+static int app_done (void)
+{
+    return app.done >= app.end;
+}
+
+/*!
+    \brief      host application: keep XFER_QUEUED transfers submitted, verify the data read
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void msc_host_app (void)
+{
+    for (uint32_t i = 0U; i < XFER_QUEUED; i++) {
+        msc_xfer *x = &app.xfer[i];
+
+        if (app.busy[i]) {
+            if (USBH_BUSY == x->status) {
+                continue;
+            }
+
+            if (USBH_OK != x->status) {
+                bench_fail("msc: %s of blocks %u-%u failed with status %u", (MSC_READ == x->dir) ? "read" : "write",
+                           x->address, x->address + x->length - 1U, (unsigned)x->status);
+            }
+
+            if (MSC_READ == x->dir) {
+                for (uint32_t k = 0U; k < x->length * DISK_BLOCK_SIZE; k++) {
+                    if (app.buf[i][k] != pattern(app.seed, x->address * DISK_BLOCK_SIZE + k)) {
+                        bench_fail("msc: data read differs at byte %u", x->address * DISK_BLOCK_SIZE + k);
+                    }
+                }
+            }
+
+            app.done += x->length;
+            app.busy[i] = 0U;
+        }
+
+        if (app.next < app.end) {
+            memset(x, 0, sizeof(*x));
+            x->dir = app.dir;
+            x->lun = 0U;
+            x->address = app.next;
+            x->length = ((app.end - app.next) < XFER_BLOCKS) ? (app.end - app.next) : XFER_BLOCKS;
+            x->pbuf = app.buf[i];
+
+            if (MSC_WRITE == app.dir) {
+                for (uint32_t k = 0U; k < x->length * DISK_BLOCK_SIZE; k++) {
+                    app.buf[i][k] = pattern(app.seed, x->address * DISK_BLOCK_SIZE + k);
+                }
+            }
+
+            if (USBH_OK != usbh_msc_submit(&bench_uhost, x)) {
+                bench_fail("msc: submit refused");
+            }
+
+            app.next += x->length;
+            app.busy[i] = 1U;
+        }
+    }
+}
+
+/*!
+    \brief      transfer blocks with the host application
+    \param[in]  dir: MSC_READ or MSC_WRITE
+    \param[in]  bytes: bytes from block 0
+    \param[in]  seed: seed of the pattern
+    \param[out] none
+    \retval     none
+*/
+static void msc_transfer (msc_state dir, uint32_t bytes, uint32_t seed)
+{
+    memset(&app, 0, sizeof(app));
+    app.dir = dir;
+    app.end = bytes / DISK_BLOCK_SIZE;
+    app.seed = seed;
+
+    bench_host_app = msc_host_app;
+    bench_run(app_done, XFER_TIMEOUT_NS, (MSC_READ == dir) ? "msc read" : "msc write");
+    bench_host_app = NULL;
+
+    if (MSC_WRITE == dir) {
+        for (uint32_t k = 0U; k < bytes; k++) {
+            if (disk[k] != pattern(seed, k)) {
+                bench_fail("msc: data written differs at byte %u", k);
+            }
+        }
+    }
+}
+
+/*!
+    \brief      mass storage bench: enumeration, sequential writes and reads
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_msc (void)
+{
+    bench_attach(&msc_desc, &msc_class, &usbh_msc, bench_msc_ready);
+    bench_end("msc_enum", 0U, 0U, 0U, 0U);
+
+    bench_begin();
+    msc_transfer(MSC_WRITE, BENCH_BYTES, 1U);
+    bench_end("msc_write", BENCH_BYTES, 0U, 0U, 0U);
+
+    bench_begin();
+    msc_transfer(MSC_READ, BENCH_BYTES, 1U);
+    bench_end("msc_read", BENCH_BYTES, 0U, 0U, 0U);
+}
+
+/*!
+    \brief      mass storage with 20% of the data tokens NAKed by the bus
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_msc_nak (void)
+{
+    vbus_options.nak_pct = 20U;
+
+    bench_attach(&msc_desc, &msc_class, &usbh_msc, bench_msc_ready);
+
+    bench_begin();
+    msc_transfer(MSC_WRITE, NAK_BYTES, 2U);
+    msc_transfer(MSC_READ, NAK_BYTES, 2U);
+    bench_end("msc_nak", 2U * NAK_BYTES, 0U, 0U, 0U);
+}
+
+/*!
+    \brief      mass storage with every BABBLE_EVERY-th IN data packet lost to babble
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_msc_babble (void)
+{
+    vbus_stat st;
+
+    bench_attach(&msc_desc, &msc_class, &usbh_msc, bench_msc_ready);
+
+    vbus_options.babble_every = BABBLE_EVERY;
+
+    bench_begin();
+    msc_transfer(MSC_WRITE, NAK_BYTES, 3U);
+    msc_transfer(MSC_READ, NAK_BYTES, 3U);
+
+    vbus_stat_get(&st, 0);
+    if (0U == st.babble) {
+        bench_fail("msc: no babble injected");
+    }
+
+    bench_end("msc_babble", 2U * NAK_BYTES, 0U, 0U, 0U);
+}
@@ -0,0 +1,268 @@
+/*!
+    \file    bench_msc_ff.c
+    \brief   mass storage through FatFs and usbh_msc_fatfs.c: time left to the
+             application while a file is copied to and from the stick
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+/*
+    The host application copies a file to the RAM disk of bench_msc.c and
+    reads it back, FF_CHUNK bytes per pass of its main loop, as an
+    application that also polls lwIP would. The disk I/O of
+    usbh_msc_fatfs.c waits for each transfer inside that pass. app_run()
+    stands for the rest of the application: it is called once per main loop
+    pass and, with usbh_msc_fatfs_idle_set(), from the wait of the disk I/O.
+    The workloads report how often it got to run while the file moved (ops)
+    and the average and longest time it did not (lat_us, max_us).
+
+    Only time is simulated: the application code costs nothing and runs
+    each time the waiting loop gets control back after an interrupt, so ops
+    counts the distinct points in time it ran at. Both idle functions read
+    the frame number, as usbh_urb_wait() does, so that the simulator blocks
+    the waiting loop on its register reads instead of its CPU time
+    watchdog; the simulated time is the same, the bench only runs faster.
+*/
+
+#include <string.h>
+#include "usbbench.h"
+#include "usbd_msc_core.h"
+#include "usbh_msc_core.h"
+#include "drv_usb_host.h"
+#include "ff.h"
+
+#define FF_CHUNK                    4096U                               /* bytes per main loop pass */
+
+#ifdef USE_USB_HS
+    #define FF_BYTES                (1024U * 1024U)
+#else
+    #define FF_BYTES                (256U * 1024U)
+#endif /* USE_USB_HS */
+
+#define FF_TIMEOUT_NS               60000000000ULL
+
+typedef enum
+{
+    FF_IDLE = 0U,
+    FF_FORMAT,                                                          /* create the volume and the file */
+    FF_WRITE,
+    FF_READ,
+    FF_DONE,
+} ff_step;
+
+static FATFS fs;
+static FIL fil;
+static uint8_t work[FF_MAX_SS];
+static uint8_t chunk[FF_CHUNK];
+
+/* the file copy and the rest of the application */
+static struct
+{
+    ff_step     step;
+    uint32_t    pos;                                                    /* bytes of the file done */
+    uint64_t    last_ns;                                                /* last run of the application */
+    uint64_t    runs;
+    uint64_t    gap_sum_us;
+    uint64_t    gap_max_us;
+} ff;
+
+/*!
+    \brief      the rest of the application: note when it got to run
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void app_run (void)
+{
+    uint64_t t = vbus_now();
+    uint64_t gap_us;
+
+    if (t == ff.last_ns) {
+        return;
+    }
+
+    gap_us = (t - ff.last_ns) / 1000U;
+    ff.gap_sum_us += gap_us;
+
+    if (gap_us > ff.gap_max_us) {
+        ff.gap_max_us = gap_us;
+    }
+
+    ff.runs++;
+    ff.last_ns = t;
+}
+
+/*!
+    \brief      idle function of the blocking disk I/O: only wait for the transfer
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void ff_wait (void)
+{
+    (void)usb_curframe_get(&bench_hdev);
+}
+
+/*!
+    \brief      idle function of the disk I/O that runs the application meanwhile
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void ff_wait_app (void)
+{
+    app_run();
+    (void)usb_curframe_get(&bench_hdev);
+}
+
+/*!
+    \brief      contents of the file
+    \param[in]  ofs: byte offset
+    \param[out] none
+    \retval     byte
+*/
+static uint8_t ff_pattern (uint32_t ofs)
+{
+    return (uint8_t)((ofs * 13U) + (ofs >> 11));
+}
+
+/*!
+    \brief      host application: one step of the copy per main loop pass
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void ff_host_app (void)
+{
+    FRESULT res;
+    UINT n;
+
+    app_run();
+
+    switch (ff.step) {
+    case FF_FORMAT:
+        if (FR_OK != (res = f_mkfs("0:", FM_FAT | FM_SFD, 0U, work, sizeof(work)))) {
+            bench_fail("msc_ff: f_mkfs failed with %u", (unsigned)res);
+        }
+
+        if (FR_OK != (res = f_mount(&fs, "0:", 1U))) {
+            bench_fail("msc_ff: f_mount failed with %u", (unsigned)res);
+        }
+
+        ff.step = FF_DONE;
+        break;
+
+    case FF_WRITE:
+        if (0U == ff.pos) {
+            if (FR_OK != (res = f_open(&fil, "0:copy.bin", FA_CREATE_ALWAYS | FA_WRITE))) {
+                bench_fail("msc_ff: f_open for writing failed with %u", (unsigned)res);
+            }
+        }
+
+        for (uint32_t k = 0U; k < FF_CHUNK; k++) {
+            chunk[k] = ff_pattern(ff.pos + k);
+        }
+
+        if ((FR_OK != (res = f_write(&fil, chunk, FF_CHUNK, &n))) || (FF_CHUNK != n)) {
+            bench_fail("msc_ff: f_write at %u failed with %u", ff.pos, (unsigned)res);
+        }
+
+        ff.pos += FF_CHUNK;
+
+        if (ff.pos >= FF_BYTES) {
+            if (FR_OK != (res = f_close(&fil))) {
+                bench_fail("msc_ff: f_close failed with %u", (unsigned)res);
+            }
+
+            ff.pos = 0U;
+            ff.step = FF_READ;
+        }
+        break;
+
+    case FF_READ:
+        if (0U == ff.pos) {
+            if (FR_OK != (res = f_open(&fil, "0:copy.bin", FA_READ))) {
+                bench_fail("msc_ff: f_open for reading failed with %u", (unsigned)res);
+            }
+        }
+
+        if ((FR_OK != (res = f_read(&fil, chunk, FF_CHUNK, &n))) || (FF_CHUNK != n)) {
+            bench_fail("msc_ff: f_read at %u failed with %u", ff.pos, (unsigned)res);
+        }
+
+        for (uint32_t k = 0U; k < FF_CHUNK; k++) {
+            if (chunk[k] != ff_pattern(ff.pos + k)) {
+                bench_fail("msc_ff: data read differs at byte %u", ff.pos + k);
+            }
+        }
+
+        ff.pos += FF_CHUNK;
+
+        if (ff.pos >= FF_BYTES) {
+            (void)f_close(&fil);
+            ff.step = FF_DONE;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+static int ff_done (void)
+{
+    return FF_DONE == ff.step;
+}
+
+/*!
+    \brief      copy the file to the stick and back and report the time left to the application
+    \param[in]  name: name of the workload
+    \param[in]  idle: function run by the disk I/O while it waits
+    \param[out] none
+    \retval     none
+*/
+static void ff_copy (const char *name, void (*idle)(void))
+{
+    usbh_msc_fatfs_idle_set(idle);
+
+    bench_begin();
+
+    ff.step = FF_WRITE;
+    ff.pos = 0U;
+    ff.last_ns = vbus_now();
+    ff.runs = 0U;
+    ff.gap_sum_us = 0U;
+    ff.gap_max_us = 0U;
+
+    bench_run(ff_done, FF_TIMEOUT_NS, name);
+
+    bench_end(name, 2U * FF_BYTES, ff.runs, ff.gap_sum_us, ff.gap_max_us);
+
+    usbh_msc_fatfs_idle_set(ff_wait);
+}
+
+/*!
+    \brief      FatFs file copy with the disk I/O waiting in the main loop pass, then with the idle function
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_msc_ff (void)
+{
+    bench_attach(&msc_desc, &msc_class, &usbh_msc, bench_msc_ready);
+
+    memset(&ff, 0, sizeof(ff));
+    usbh_msc_fatfs_idle_set(ff_wait);
+    bench_host_app = ff_host_app;
+
+    ff.step = FF_FORMAT;
+    bench_run(ff_done, FF_TIMEOUT_NS, "msc_ff format");
+
+    ff_copy("msc_ff_blk", ff_wait);
+    ff_copy("msc_ff_idle", ff_wait_app);
+
+    bench_host_app = NULL;
+    usbh_msc_fatfs_idle_set(NULL);
+}
@@ -0,0 +1,40 @@
+/*!
+    \file    usb_conf.h
+    \brief   USB core configuration of the audio speaker model
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __USB_CONF_H
+#define __USB_CONF_H
+
+#include "stdlib.h"
+#include "gd32f4xx.h"
+#include "gd32f450i_audio_codec.h"
+
+/* the audio class is built as in the audio example (its usbd_conf.h and
+   gd32f450i_audio_codec.h), for the USBFS core in device mode; the core
+   itself is not run, audio_model.c stands in for its endpoint functions */
+#define USB_FS_CORE
+
+#define RX_FIFO_FS_SIZE                         128
+#define TX0_FIFO_FS_SIZE                        32
+#define TX1_FIFO_FS_SIZE                        96
+#define TX2_FIFO_FS_SIZE                        64
+#define TX3_FIFO_FS_SIZE                        0
+
+#define USBFS_SOF_OUTPUT                        0
+#define USBFS_LOW_POWER                         0
+
+#define USE_DEVICE_MODE
+
+#define __ALIGN_BEGIN
+#define __ALIGN_END
+
+#ifndef __packed
+    #define __packed __attribute__ ((__packed__))
+#endif
+
+#endif /* __USB_CONF_H */
@@ -0,0 +1,19 @@
+/*!
+    \file    usbd_conf.h
+    \brief   USB device configuration of the audio speaker model
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __USBD_CONF_AUDIO_MODEL_H
+#define __USBD_CONF_AUDIO_MODEL_H
+
+/* the model uses the configuration of the audio example as it is; the core
+   configuration of the model comes first, so that the one of the example,
+   which needs the board headers, is skipped by its include guard */
+#include "usb_conf.h"
+#include "../../../../../Examples/USB/USB_Device/audio/inc/usbd_conf.h"
+
+#endif /* __USBD_CONF_AUDIO_MODEL_H */
@@ -0,0 +1,110 @@
+/*!
+    \file    usb_conf.h
+    \brief   USB core configuration of the virtual bus benches
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __USB_CONF_H
+#define __USB_CONF_H
+
+#include "stdlib.h"
+#include "gd32f4xx.h"
+
+/* the device and the host stack run in one process, each on its own emulated
+   core of the type selected with USE_USB_FS or USE_USB_HS (and USE_ULPI_PHY) */
+#ifdef USE_USB_FS
+    #define USB_FS_CORE
+#endif /* USE_USB_FS */
+
+#ifdef USE_USB_HS
+    #define USB_HS_CORE
+#endif /* USE_USB_HS */
+
+/* the FIFO sizes can be given on the command line to evaluate other layouts */
+#ifdef USB_FS_CORE
+    #ifndef RX_FIFO_FS_SIZE
+        #define RX_FIFO_FS_SIZE                     128
+    #endif
+    #ifndef TX0_FIFO_FS_SIZE
+        #define TX0_FIFO_FS_SIZE                    64
+    #endif
+    #ifndef TX1_FIFO_FS_SIZE
+        #define TX1_FIFO_FS_SIZE                    96
+    #endif
+    #ifndef TX2_FIFO_FS_SIZE
+        #define TX2_FIFO_FS_SIZE                    32
+    #endif
+    #ifndef TX3_FIFO_FS_SIZE
+        #define TX3_FIFO_FS_SIZE                    0
+    #endif
+
+    #ifndef USB_RX_FIFO_FS_SIZE
+        #define USB_RX_FIFO_FS_SIZE                 128
+    #endif
+    #ifndef USB_HTX_NPFIFO_FS_SIZE
+        #define USB_HTX_NPFIFO_FS_SIZE              96
+    #endif
+    #ifndef USB_HTX_PFIFO_FS_SIZE
+        #define USB_HTX_PFIFO_FS_SIZE               96
+    #endif
+
+    #define USBFS_SOF_OUTPUT                        0
+    #define USBFS_LOW_POWER                         0
+#endif /* USB_FS_CORE */
+
+#ifdef USB_HS_CORE
+    #ifndef RX_FIFO_HS_SIZE
+        #define RX_FIFO_HS_SIZE                     512
+    #endif
+    #ifndef TX0_FIFO_HS_SIZE
+        #define TX0_FIFO_HS_SIZE                    128
+    #endif
+    #ifndef TX1_FIFO_HS_SIZE
+        #define TX1_FIFO_HS_SIZE                    384
+    #endif
+    #ifndef TX2_FIFO_HS_SIZE
+        #define TX2_FIFO_HS_SIZE                    64
+    #endif
+    #define TX3_FIFO_HS_SIZE                        0
+    #define TX4_FIFO_HS_SIZE                        0
+    #define TX5_FIFO_HS_SIZE                        0
+
+    #ifndef USB_RX_FIFO_HS_SIZE
+        #define USB_RX_FIFO_HS_SIZE                 512
+    #endif
+    #ifndef USB_HTX_NPFIFO_HS_SIZE
+        #define USB_HTX_NPFIFO_HS_SIZE              256
+    #endif
+    #ifndef USB_HTX_PFIFO_HS_SIZE
+        #define USB_HTX_PFIFO_HS_SIZE               256
+    #endif
+
+    #ifdef USE_ULPI_PHY
+        #define USB_ULPI_PHY_ENABLED
+    #endif
+
+    #define USBHS_SOF_OUTPUT                        0
+    #define USBHS_LOW_POWER                         0
+#endif /* USB_HS_CORE */
+
+#define USE_DEVICE_MODE
+#define USE_HOST_MODE
+
+#ifndef USB_FS_CORE
+    #ifndef USB_HS_CORE
+        #error  "USB_HS_CORE or USB_FS_CORE should be defined!"
+    #endif
+#endif
+
+#define __ALIGN_BEGIN
+#define __ALIGN_END
+
+/* __packed keyword used to decrease the data type alignment to 1-byte */
+#ifndef __packed
+    #define __packed __attribute__ ((__packed__))
+#endif
+
+#endif /* __USB_CONF_H */
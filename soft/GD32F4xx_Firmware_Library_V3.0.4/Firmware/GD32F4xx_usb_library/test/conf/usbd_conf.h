@@ -0,0 +1,47 @@
+/*!
+    \file    usbd_conf.h
+    \brief   USB device configuration of the virtual bus benches
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __USBD_CONF_H
+#define __USBD_CONF_H
+
+#include "usb_conf.h"
+
+#define USBD_CFG_MAX_NUM                    1U
+#define USBD_ITF_MAX_NUM                    2U
+#define USB_STR_DESC_MAX_SIZE               64U
+#define USB_STRING_COUNT                    4U
+
+#ifdef USE_USB_HS
+    #define USB_BENCH_PACKET_SIZE           512U
+#else
+    #define USB_BENCH_PACKET_SIZE           64U
+#endif /* USE_USB_HS */
+
+/* mass storage, msc_udisk example */
+#define USBD_MSC_INTERFACE                  0U
+#define MSC_IN_EP                           EP1_IN
+#define MSC_OUT_EP                          EP1_OUT
+#define MSC_DATA_PACKET_SIZE                USB_BENCH_PACKET_SIZE
+#define MSC_MEDIA_PACKET_SIZE               4096U
+#define MEM_LUN_NUM                         1U
+
+/* CDC ACM, cdc_acm example */
+#define CDC_COM_INTERFACE                   0
+#define CDC_DATA_IN_EP                      EP1_IN
+#define CDC_DATA_OUT_EP                     EP3_OUT
+#define CDC_CMD_EP                          EP2_IN
+#define USB_CDC_CMD_PACKET_SIZE             8
+#define USB_CDC_DATA_PACKET_SIZE            USB_BENCH_PACKET_SIZE
+
+/* HID keyboard, standard_hid_keyboard example */
+#define USBD_HID_INTERFACE                  0U
+#define HID_IN_EP                           EP1_IN
+#define HID_IN_PACKET                       8U
+
+#endif /* __USBD_CONF_H */
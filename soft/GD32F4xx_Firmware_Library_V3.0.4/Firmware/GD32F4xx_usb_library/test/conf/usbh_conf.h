@@ -0,0 +1,24 @@
+/*!
+    \file    usbh_conf.h
+    \brief   USB host configuration of the virtual bus benches
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __USBH_CONF_H
+#define __USBH_CONF_H
+
+#define USBH_MAX_EP_NUM                         2
+#define USBH_MAX_INTERFACES_NUM                 2
+#define USBH_MAX_ALT_SETTING                    2
+#define USBH_MAX_SUPPORTED_CLASS                4
+
+#define USBH_DATA_BUF_MAX_LEN                   0x200
+#define USBH_CFGSET_MAX_LEN                     0x200
+
+/* the two sticks of the hub benches */
+#define USBH_MSC_MAX_DEV                        2U
+
+#endif /* __USBH_CONF_H */
@@ -0,0 +1,43 @@
+/*!
+    \file    gd32f4xx.h
+    \brief   host stand-in of the device header for the virtual USB bus
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef GD32F4XX_HOST_STUB
+#define GD32F4XX_HOST_STUB
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define __IO                        volatile
+#define __I                         volatile const
+#define __O                         volatile
+#define __STATIC_INLINE             static inline
+
+#define BIT(x)                      ((uint32_t)((uint32_t)0x01U<<(x)))
+#define BITS(start, end)            ((0xFFFFFFFFUL << (start)) & (0xFFFFFFFFUL >> (31U - (uint32_t)(end))))
+#define GET_BITS(regval, start, end) (((regval) & BITS((start),(end))) >> (start))
+
+#define REG32(addr)                 (*(volatile uint32_t *)(uintptr_t)(addr))
+
+typedef enum {DISABLE = 0, ENABLE = !DISABLE} EventStatus, ControlStatus;
+typedef enum {RESET = 0, SET = !RESET} FlagStatus;
+typedef enum {ERROR = 0, SUCCESS = !ERROR} ErrStatus;
+
+/* PMU arguments of the suspend path, see usb_hw_sim.c */
+#define PMU_LDO_LOWPOWER            1U
+#define PMU_LOWDRIVER_DISABLE       0U
+#define WFI_CMD                     0x01U
+
+void pmu_to_deepsleepmode (uint32_t ldo, uint32_t lowdrive, uint8_t deepsleepmodecmd);
+
+/* the interrupts of the emulated cores are never preempted by the main loop */
+#define __disable_irq()
+#define __enable_irq()
+#define __NOP()
+
+#endif /* GD32F4XX_HOST_STUB */
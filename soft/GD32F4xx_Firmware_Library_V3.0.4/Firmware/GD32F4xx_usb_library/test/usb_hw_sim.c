@@ -0,0 +1,121 @@
+/*!
+    \file    usb_hw_sim.c
+    \brief   board layer of the drivers on the virtual bus: the delays, the
+             VBUS drive and the register windows of the cores
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#include <stdio.h>
+#include "drv_usb_hw.h"
+#include "drv_usb_core.h"
+#include "vbus.h"
+
+/* drv_usb_core.c is built with usb_basic_init renamed to this */
+usb_status usb_basic_init_hw (usb_core_basic *usb_basic, usb_core_regs *usb_regs, usb_core_enum usb_core);
+
+/*!
+    \brief      configure core capabilities, the registers are mapped to the window of the side
+                the core is bound to with vbus_bind()
+    \param[in]  usb_basic: pointer to USB capabilities
+    \param[in]  usb_regs: USB core registers
+    \param[in]  usb_core: USB core
+    \param[out] none
+    \retval     operation status
+*/
+usb_status usb_basic_init (usb_core_basic *usb_basic, usb_core_regs *usb_regs, usb_core_enum usb_core)
+{
+    usb_status status = usb_basic_init_hw(usb_basic, usb_regs, usb_core);
+    int side = vbus_side(usb_basic);
+
+    if (USB_OK != status) {
+        return status;
+    }
+
+    if (side < 0) {
+        vbus_fail("usb_basic_init: the core is not bound to a side of the bus");
+    }
+
+    usb_basic->base_reg = (uint32_t)(VBUS_WINDOW_BASE + (uint32_t)side * VBUS_WINDOW_STRIDE);
+
+    usb_regs->gr = (usb_gr *)(uintptr_t)(usb_basic->base_reg + USB_REG_OFFSET_CORE);
+    usb_regs->hr = (usb_hr *)(uintptr_t)(usb_basic->base_reg + USB_REG_OFFSET_HOST);
+    usb_regs->dr = (usb_dr *)(uintptr_t)(usb_basic->base_reg + USB_REG_OFFSET_DEV);
+    usb_regs->HPCS = (uint32_t *)(uintptr_t)(usb_basic->base_reg + USB_REG_OFFSET_PORT);
+    usb_regs->PWRCLKCTL = (uint32_t *)(uintptr_t)(usb_basic->base_reg + USB_REG_OFFSET_PWRCLKCTL);
+
+    for (uint8_t i = 0U; i < usb_basic->num_ep; i++) {
+        usb_regs->er_in[i] = (usb_erin *)(uintptr_t)
+            (usb_basic->base_reg + USB_REG_OFFSET_EP_IN + (i * USB_REG_OFFSET_EP));
+
+        usb_regs->er_out[i] = (usb_erout *)(uintptr_t)
+            (usb_basic->base_reg + USB_REG_OFFSET_EP_OUT + (i * USB_REG_OFFSET_EP));
+    }
+
+    for (uint8_t i = 0U; i < usb_basic->num_pipe; i++) {
+        usb_regs->pr[i] = (usb_pr *)(uintptr_t)
+            (usb_basic->base_reg + USB_REG_OFFSET_CH_INOUT + (i * USB_REG_OFFSET_CH));
+
+        usb_regs->DFIFO[i] = (uint32_t *)(uintptr_t)
+            (usb_basic->base_reg + USB_DATA_FIFO_OFFSET + (i * USB_DATA_FIFO_SIZE));
+    }
+
+    return USB_OK;
+}
+
+/*!
+    \brief      delay in micro seconds
+    \param[in]  usec: value of delay required in micro seconds
+    \param[out] none
+    \retval     none
+*/
+void usb_udelay (const uint32_t usec)
+{
+    vbus_delay((uint64_t)usec * 1000U);
+}
+
+/*!
+    \brief      delay in milliseconds
+    \param[in]  msec: value of delay required in milliseconds
+    \param[out] none
+    \retval     none
+*/
+void usb_mdelay (const uint32_t msec)
+{
+    vbus_delay((uint64_t)msec * 1000000U);
+}
+
+/*!
+    \brief      drive USB VBUS, the port power of HPCS stands for it on the bus
+    \param[in]  state: ENABLE or DISABLE
+    \param[out] none
+    \retval     none
+*/
+void usb_vbus_drive (uint8_t state)
+{
+}
+
+/*!
+    \brief      configure USB VBUS
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void usb_vbus_config (void)
+{
+}
+
+/*!
+    \brief      enter deep-sleep mode, reached only through the suspend paths
+    \param[in]  ldo: LDO mode
+    \param[in]  lowdrive: low-driver mode
+    \param[in]  deepsleepmodecmd: WFI or WFE
+    \param[out] none
+    \retval     none
+*/
+void pmu_to_deepsleepmode (uint32_t ldo, uint32_t lowdrive, uint8_t deepsleepmodecmd)
+{
+    vbus_fail("deep-sleep entered, suspend is not modelled");
+}
@@ -0,0 +1,560 @@
+/*!
+    \file    usbbench.c
+    \brief   benches of the device and host stacks on the virtual bus
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+/*
+    Each bench runs in a child process on a fresh bus: the device stack of
+    the class under test on one emulated core, the host stack on the other.
+    The results are sent to the parent, which lists them and compares them
+    with a baseline. All times are simulated, so the results only change
+    with the code or the model.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "usbbench.h"
+#include "drv_usbd_int.h"
+#include "drv_usbh_int.h"
+
+#ifdef USE_USB_HS
+    #define BENCH_SPEED             "hs"
+    #define BENCH_CORE              USB_CORE_ENUM_HS
+#else
+    #define BENCH_SPEED             "fs"
+    #define BENCH_CORE              USB_CORE_ENUM_FS
+#endif /* USE_USB_HS */
+
+#define MAX_RESULTS                 32U
+#define ENUM_TIMEOUT_NS             5000000000ULL
+#define CASE_WALL_S                 120U                                /* wall time of a bench */
+
+usb_core_driver bench_udev;
+usb_core_driver bench_hdev;
+usbh_host bench_uhost;
+
+void (*bench_dev_app) (void) = NULL;
+void (*bench_host_app) (void) = NULL;
+void (*bench_not_supported) (void) = NULL;
+
+static int bench_fd = -1;
+static int dev_started, host_started;
+static uint64_t begin_ns;
+static uint32_t rnd_state = 1U;
+
+static bench_result results[MAX_RESULTS];
+static uint32_t result_num;
+
+typedef struct
+{
+    const char *name;
+    void      (*run) (void);
+} bench_case;
+
+static const bench_case cases[] =
+{
+    {"msc",        bench_msc},
+    {"msc_nak",    bench_msc_nak},
+    {"msc_babble", bench_msc_babble},
+    {"msc_ff",     bench_msc_ff},
+    {"cdc",        bench_cdc},
+    {"hid",        bench_hid},
+    {"hub_msc",    bench_hub_msc},
+    {"hub_hid",    bench_hub_hid},
+    {"hub_speed",  bench_hub_speed},
+    {NULL,         NULL}
+};
+
+/* host user callbacks, nothing to show */
+static void usr_none (void) {}
+static void usr_speed (uint32_t speed) {}
+static void usr_desc (void *desc) {}
+static void usr_cfg (usb_desc_config *cfg, usb_desc_itf *itf, usb_desc_ep *ep) {}
+static usbh_user_status usr_input (void) { return USR_IN_RESP_OK; }
+static int usr_app (void) { return 0; }
+
+static void usr_not_supported (void)
+{
+    if (NULL == bench_not_supported) {
+        bench_fail("host: device not supported");
+    }
+
+    bench_not_supported();
+}
+
+static void usr_error (void)
+{
+    bench_fail("host: unrecovered error");
+}
+
+static usbh_user_cb bench_usr_cb =
+{
+    .dev_init             = usr_none,
+    .dev_deinit           = usr_none,
+    .dev_attach           = usr_none,
+    .dev_reset            = usr_none,
+    .dev_detach           = usr_none,
+    .dev_over_currented   = usr_none,
+    .dev_speed_detected   = usr_speed,
+    .dev_devdesc_assigned = usr_desc,
+    .dev_address_set      = usr_none,
+    .dev_cfgdesc_assigned = usr_cfg,
+    .dev_mfc_str          = usr_desc,
+    .dev_prod_str         = usr_desc,
+    .dev_seral_str        = usr_desc,
+    .dev_enumerated       = usr_none,
+    .dev_user_input       = usr_input,
+    .dev_user_app         = usr_app,
+    .dev_not_supported    = usr_not_supported,
+    .dev_error            = usr_error,
+};
+
+static void dev_isr (void)
+{
+    usbd_isr(&bench_udev);
+}
+
+static void dev_task (void)
+{
+    if (dev_started && (NULL != bench_dev_app)) {
+        bench_dev_app();
+    }
+}
+
+static void host_isr (void)
+{
+    (void)usbh_isr(&bench_hdev);
+}
+
+static void host_task (void)
+{
+    if (host_started) {
+        usbh_core_task(&bench_uhost);
+
+        if (NULL != bench_host_app) {
+            bench_host_app();
+        }
+    }
+}
+
+/*!
+    \brief      pseudo random numbers of the workloads
+    \param[in]  none
+    \param[out] none
+    \retval     number
+*/
+uint32_t bench_rand (void)
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+
+    return rnd_state;
+}
+
+/*!
+    \brief      report a failed check and exit
+    \param[in]  fmt: format of the message
+    \param[out] none
+    \retval     none
+*/
+void bench_fail (const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "usbbench: at %llu us: ", (unsigned long long)(vbus_now() / 1000U));
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+
+    fputc('\n', stderr);
+
+    vcore_dump(VBUS_DEVICE);
+    vcore_dump(VBUS_HOST);
+
+    exit(1);
+}
+
+/*!
+    \brief      set up the bus, start both stacks and run until the class of the host is ready
+    \param[in]  desc: descriptors of the device
+    \param[in]  dclass: class of the device
+    \param[in]  hclass: class of the host
+    \param[in]  ready: the class of the host is ready
+    \param[out] none
+    \retval     time from the start of the host to the class ready, in ns
+*/
+uint64_t bench_attach (usb_desc *desc, usb_class_core *dclass, usbh_class *hclass, int (*ready)(void))
+{
+    return bench_attach_tree(desc, dclass, NULL, &hclass, 1U, ready);
+}
+
+/*!
+    \brief      set up the bus with a function on the root port, start the stacks and run until the host is ready
+    \param[in]  desc: descriptors of the device, NULL when the device core is not used
+    \param[in]  dclass: class of the device
+    \param[in]  root_func: function on the root port, NULL for the device core
+    \param[in]  hclass: classes of the host
+    \param[in]  hclass_num: number of classes
+    \param[in]  ready: the host is ready
+    \param[out] none
+    \retval     time from the start of the host to ready, in ns
+*/
+uint64_t bench_attach_tree (usb_desc *desc, usb_class_core *dclass, vbus_func *root_func,
+                            usbh_class *const *hclass, uint32_t hclass_num, int (*ready)(void))
+{
+    uint64_t t0;
+
+    vbus_init();
+
+    if (NULL != root_func) {
+        vbus_root_set(root_func);
+    }
+
+    memset(&bench_udev, 0, sizeof(bench_udev));
+    memset(&bench_hdev, 0, sizeof(bench_hdev));
+    memset(&bench_uhost, 0, sizeof(bench_uhost));
+
+    vbus_bind(VBUS_DEVICE, &bench_udev.bp);
+    vbus_bind(VBUS_HOST, &bench_hdev.bp);
+    vbus_cpu_set(VBUS_DEVICE, dev_isr, dev_task);
+    vbus_cpu_set(VBUS_HOST, host_isr, host_task);
+
+    if (NULL != desc) {
+        usbd_init(&bench_udev, BENCH_CORE, desc, dclass);
+        dev_started = 1;
+    }
+
+    for (uint32_t i = 0U; i < hclass_num; i++) {
+        usbh_class_register(&bench_uhost, hclass[i]);
+    }
+
+    t0 = vbus_now();
+    usbh_init(&bench_uhost, &bench_hdev, BENCH_CORE, &bench_usr_cb);
+    host_started = 1;
+
+    bench_run(ready, ENUM_TIMEOUT_NS, "enumeration");
+
+    return vbus_now() - t0;
+}
+
+/*!
+    \brief      run the bus until done() returns non-zero, fail after the timeout
+    \param[in]  done: end condition
+    \param[in]  timeout_ns: timeout
+    \param[in]  what: name of the step for the failure report
+    \param[out] none
+    \retval     none
+*/
+void bench_run (int (*done)(void), uint64_t timeout_ns, const char *what)
+{
+    if (vbus_run(done, timeout_ns)) {
+        bench_fail("%s timed out, host state %u, enumeration state %u", what,
+                   (unsigned)bench_uhost.cur_state, (unsigned)bench_uhost.enum_state);
+    }
+}
+
+/*!
+    \brief      start a workload, the counters are cleared
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void bench_begin (void)
+{
+    vbus_stat st;
+
+    vbus_stat_get(&st, 1);
+    begin_ns = vbus_now();
+}
+
+/*!
+    \brief      end a workload and report its result
+    \param[in]  name: name of the workload
+    \param[in]  bytes: payload bytes moved
+    \param[in]  ops: operations of a latency workload, 0 for none
+    \param[in]  lat_sum_us: sum of the latencies
+    \param[in]  max_us: longest latency
+    \param[out] none
+    \retval     none
+*/
+void bench_end (const char *name, uint64_t bytes, uint64_t ops, uint64_t lat_sum_us, uint64_t max_us)
+{
+    bench_result r;
+
+    memset(&r, 0, sizeof(r));
+    strncpy(r.name, name, sizeof(r.name) - 1U);
+    r.bytes = bytes;
+    r.time_us = (vbus_now() - begin_ns) / 1000U;
+    r.ops = ops;
+    r.lat_us = ops ? lat_sum_us / ops : 0U;
+    r.max_us = max_us;
+    vbus_stat_get(&r.st, 0);
+
+    if (write(bench_fd, &r, sizeof(r)) != (ssize_t)sizeof(r)) {
+        perror("usbbench: result");
+        exit(2);
+    }
+}
+
+/*!
+    \brief      run a bench in a child process and collect its results
+    \param[in]  c: bench
+    \param[out] none
+    \retval     0 on success, 1 when the bench failed
+*/
+static int run_case (const bench_case *c)
+{
+    int fd[2], status;
+    bench_result r;
+    pid_t pid;
+
+    fflush(stdout);
+
+    if (pipe(fd) < 0) {
+        perror("usbbench: pipe");
+        exit(2);
+    }
+
+    pid = fork();
+
+    if (pid < 0) {
+        perror("usbbench: fork");
+        exit(2);
+    }
+
+    if (0 == pid) {
+        close(fd[0]);
+        bench_fd = fd[1];
+
+        /* a bench stuck outside the simulated time is killed */
+        alarm(CASE_WALL_S);
+
+        c->run();
+        exit(0);
+    }
+
+    close(fd[1]);
+
+    while (read(fd[0], &r, sizeof(r)) == (ssize_t)sizeof(r)) {
+        if (result_num < MAX_RESULTS) {
+            results[result_num++] = r;
+        }
+    }
+
+    close(fd[0]);
+    waitpid(pid, &status, 0);
+
+    if (WIFSIGNALED(status) && (SIGALRM == WTERMSIG(status))) {
+        fprintf(stderr, "usbbench: %s %s ran for more than %u s\n", BENCH_SPEED, c->name, CASE_WALL_S);
+    }
+
+    if (!WIFEXITED(status) || (0 != WEXITSTATUS(status))) {
+        fprintf(stderr, "usbbench: %s %s FAILED\n", BENCH_SPEED, c->name);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*!
+    \brief      ISR cycles per KB of a result, per operation for latency workloads
+    \param[in]  r: result
+    \param[in]  side: side of the bus
+    \param[out] none
+    \retval     cycles
+*/
+static double cycles_per_unit (const bench_result *r, uint8_t side)
+{
+    if (r->ops) {
+        return (double)r->st.cpu[side].isr_cycles / r->ops;
+    }
+
+    return r->bytes ? (double)r->st.cpu[side].isr_cycles * 1024.0 / r->bytes : 0.0;
+}
+
+static void print_results (void)
+{
+    const bench_result *r;
+
+    printf("\n%-5s %-10s %9s %10s %9s %8s %8s %8s %8s %10s %10s %8s %7s\n", "speed", "workload", "bytes",
+           "time_ms", "KB/s", "lat_us", "max_us", "isr_d", "isr_h", "cyc/u_d", "cyc/u_h", "xact", "nak");
+
+    for (r = results; r < results + result_num; r++) {
+        double s = r->time_us / 1e6;
+
+        printf("%-5s %-10s %9llu %10.3f %9.1f %8llu %8llu %8llu %8llu %10.1f %10.1f %8llu %7llu\n", BENCH_SPEED,
+               r->name, (unsigned long long)r->bytes, r->time_us / 1e3, (s > 0) ? r->bytes / s / 1024.0 : 0.0,
+               (unsigned long long)r->lat_us, (unsigned long long)r->max_us,
+               (unsigned long long)r->st.cpu[VBUS_DEVICE].isr, (unsigned long long)r->st.cpu[VBUS_HOST].isr,
+               cycles_per_unit(r, VBUS_DEVICE), cycles_per_unit(r, VBUS_HOST),
+               (unsigned long long)r->st.xact, (unsigned long long)r->st.nak);
+    }
+}
+
+static int save_results (const char *path)
+{
+    FILE *fp = fopen(path, "w");
+    const bench_result *r;
+
+    if (NULL == fp) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(fp, "# speed workload bytes time_us ops lat_us max_us isr_d isr_h cyc_d cyc_h xact nak\n");
+
+    for (r = results; r < results + result_num; r++) {
+        fprintf(fp, "%s %s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu\n", BENCH_SPEED, r->name,
+                (unsigned long long)r->bytes, (unsigned long long)r->time_us, (unsigned long long)r->ops,
+                (unsigned long long)r->lat_us, (unsigned long long)r->max_us,
+                (unsigned long long)r->st.cpu[VBUS_DEVICE].isr, (unsigned long long)r->st.cpu[VBUS_HOST].isr,
+                (unsigned long long)r->st.cpu[VBUS_DEVICE].isr_cycles,
+                (unsigned long long)r->st.cpu[VBUS_HOST].isr_cycles,
+                (unsigned long long)r->st.xact, (unsigned long long)r->st.nak);
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+static double change (unsigned long long now, unsigned long long ref)
+{
+    return ref ? ((double)now / ref - 1.0) * 100.0 : 0.0;
+}
+
+/* compare with a results file: 0 no regression, 1 regression, -1 error */
+static int compare_results (const char *path, double tol)
+{
+    FILE *fp = fopen(path, "r");
+    char line[256], speed[8], name[16];
+    unsigned long long v[11];
+    const bench_result *r;
+    double d_time, d_lat, d_max, d_cd, d_ch;
+    int bad = 0;
+
+    if (NULL == fp) {
+        perror(path);
+        return -1;
+    }
+
+    printf("\n%-5s %-10s %9s %9s %9s %9s %9s  (vs %s)\n", "speed", "workload", "time_us", "lat_us", "max_us",
+           "cyc_d", "cyc_h", path);
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (('#' == line[0]) || (sscanf(line, "%7s %15s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                                        speed, name, &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &v[6], &v[7], &v[8],
+                                        &v[9], &v[10]) < 13)) {
+            continue;
+        }
+
+        if (strcmp(speed, BENCH_SPEED)) {
+            continue;
+        }
+
+        for (r = results; (r < results + result_num) && strcmp(r->name, name); r++) {
+        }
+
+        if (r == results + result_num) {
+            continue;
+        }
+
+        d_time = change(r->time_us, v[1]);
+        d_lat = change(r->lat_us, v[3]);
+        d_max = change(r->max_us, v[4]);
+        d_cd = change(r->st.cpu[VBUS_DEVICE].isr_cycles, v[7]);
+        d_ch = change(r->st.cpu[VBUS_HOST].isr_cycles, v[8]);
+
+        printf("%-5s %-10s %+8.1f%% %+8.1f%% %+8.1f%% %+8.1f%% %+8.1f%%", speed, name, d_time, d_lat, d_max,
+               d_cd, d_ch);
+
+        if ((d_time > tol) || (d_lat > tol) || (d_max > tol) || (d_cd > tol) || (d_ch > tol)) {
+            printf("  REGRESSION");
+            bad = 1;
+        }
+
+        printf("\n");
+    }
+
+    fclose(fp);
+
+    return bad;
+}
+
+int main (int argc, char *argv[])
+{
+    const char *run = NULL, *out = NULL, *base = NULL;
+    const bench_case *c;
+    double tol = 2.0;
+    int i, rc = 0, found = 0;
+
+    for (i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-r") && (i + 1 < argc)) {
+            run = argv[++i];
+        } else if (!strcmp(argv[i], "-o") && (i + 1 < argc)) {
+            out = argv[++i];
+        } else if (!strcmp(argv[i], "-b") && (i + 1 < argc)) {
+            base = argv[++i];
+        } else if (!strcmp(argv[i], "-t") && (i + 1 < argc)) {
+            tol = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "-n") && (i + 1 < argc)) {
+            vbus_options.nak_pct = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-B") && (i + 1 < argc)) {
+            vbus_options.babble_every = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-s") && (i + 1 < argc)) {
+            vbus_options.seed = (uint32_t)atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-c") && (i + 1 < argc)) {
+            vbus_options.cpu_hz = (uint32_t)atoi(argv[++i]) * 1000000U;
+        } else if (!strcmp(argv[i], "-v")) {
+            vbus_options.trace = 1U;
+        } else {
+            fprintf(stderr, "usage: usbbench [-r bench] [-o results] [-b baseline] [-t tol%%] "
+                            "[-n nak%%] [-B babble] [-s seed] [-c cpu_mhz] [-v]\n");
+            return 2;
+        }
+    }
+
+    for (c = cases; NULL != c->name; c++) {
+        if (run && strcmp(run, c->name)) {
+            continue;
+        }
+
+        found = 1;
+
+        if (run_case(c)) {
+            rc = 1;
+        }
+    }
+
+    if (!found) {
+        fprintf(stderr, "usbbench: unknown bench %s\n", run);
+        return 2;
+    }
+
+    print_results();
+
+    if (out && save_results(out)) {
+        rc = 2;
+    }
+
+    if (base) {
+        i = compare_results(base, tol);
+
+        if (i) {
+            rc = (i < 0) ? 2 : ((rc > 1) ? rc : 1);
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,78 @@
+/*!
+    \file    usbbench.h
+    \brief   common part of the virtual bus benches
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __USBBENCH_H
+#define __USBBENCH_H
+
+#include "usbd_core.h"
+#include "usbh_core.h"
+#include "vbus.h"
+
+/* one workload result */
+typedef struct
+{
+    char        name[16];
+    uint64_t    bytes;                              /*!< payload bytes moved */
+    uint64_t    time_us;                            /*!< simulated time of the workload */
+    uint64_t    ops;                                /*!< operations of a latency workload */
+    uint64_t    lat_us;                             /*!< average latency, 0 for throughput workloads */
+    uint64_t    max_us;                             /*!< longest latency */
+    vbus_stat   st;                                 /*!< bus and CPU counters of the workload */
+} bench_result;
+
+/* the two stacks, each on its side of the bus */
+extern usb_core_driver bench_udev;
+extern usb_core_driver bench_hdev;
+extern usbh_host bench_uhost;
+
+/* hooks called in the main loops after the stacks */
+extern void (*bench_dev_app) (void);
+extern void (*bench_host_app) (void);
+/* called instead of failing when the host refuses a device, NULL to fail */
+extern void (*bench_not_supported) (void);
+
+/* function declarations */
+/* set up the bus, start both stacks and run until the class of the host is ready */
+uint64_t bench_attach (usb_desc *desc, usb_class_core *dclass, usbh_class *hclass, int (*ready)(void));
+/* the same with a function other than the device core on the root port and several host classes */
+uint64_t bench_attach_tree (usb_desc *desc, usb_class_core *dclass, vbus_func *root_func,
+                            usbh_class *const *hclass, uint32_t hclass_num, int (*ready)(void));
+/* run the bus until done() returns non-zero, fail after the timeout */
+void bench_run (int (*done)(void), uint64_t timeout_ns, const char *what);
+/* start a workload: reset the counters */
+void bench_begin (void);
+/* end a workload and report its result */
+void bench_end (const char *name, uint64_t bytes, uint64_t ops, uint64_t lat_sum_us, uint64_t max_us);
+/* report a failed check and exit */
+void bench_fail (const char *fmt, ...) __attribute__ ((noreturn, format (printf, 1, 2)));
+/* pseudo random numbers, reproducible */
+uint32_t bench_rand (void);
+
+/* bench_msc.c */
+/* the host class is idle after the attach of the mass storage device */
+int bench_msc_ready (void);
+void bench_msc (void);
+void bench_msc_nak (void);
+void bench_msc_babble (void);
+/* bench_msc_ff.c */
+void bench_msc_ff (void);
+/* bench_cdc.c */
+void bench_cdc (void);
+/* bench_hid.c */
+void bench_hid (void);
+/* the host polls the keyboard */
+int bench_hid_ready (void);
+/* press keys at random times and report their latency as a workload */
+void bench_hid_keys (const char *name);
+/* bench_hub.c */
+void bench_hub_msc (void);
+void bench_hub_hid (void);
+void bench_hub_speed (void);
+
+#endif /* __USBBENCH_H */
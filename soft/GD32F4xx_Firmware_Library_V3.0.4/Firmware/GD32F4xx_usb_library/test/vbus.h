@@ -0,0 +1,198 @@
+/*!
+    \file    vbus.h
+    \brief   virtual USB bus connecting the device and the host stack in one
+             process
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+#ifndef __VBUS_H
+#define __VBUS_H
+
+#include <stdint.h>
+
+/* the two emulated cores */
+#define VBUS_DEVICE                 0U
+#define VBUS_HOST                   1U
+#define VBUS_SIDES                  2U
+
+/* the register windows replace USBFS_REG_BASE/USBHS_REG_BASE, below 4 GB as
+   usb_core_basic keeps the base address in 32 bits */
+#define VBUS_WINDOW_BASE            0x60000000UL
+#define VBUS_WINDOW_STRIDE          0x00100000UL
+#define VBUS_WINDOW_SIZE            0x00011000UL
+
+/* cost model of the CPU time of the drivers, in core clock cycles */
+#ifndef VBUS_CPU_HZ
+    #define VBUS_CPU_HZ             200000000UL     /*!< core clock of both CPUs */
+#endif
+#ifndef VBUS_ISR_CYCLES
+    #define VBUS_ISR_CYCLES         60U             /*!< exception entry, exit and dispatch */
+#endif
+#ifndef VBUS_REG_CYCLES
+    #define VBUS_REG_CYCLES         4U              /*!< one access to a core register or FIFO word */
+#endif
+#ifndef VBUS_LOOP_CYCLES
+    #define VBUS_LOOP_CYCLES        200U            /*!< one pass of a main loop */
+#endif
+
+/* speeds of the port */
+typedef enum
+{
+    VBUS_SPEED_HIGH = 0U,
+    VBUS_SPEED_FULL,
+    VBUS_SPEED_LOW,
+} vbus_speed;
+
+/* response of a function to a token */
+typedef enum
+{
+    VBUS_ACK = 0U,
+    VBUS_NAK,
+    VBUS_NYET,
+    VBUS_STALL,
+    VBUS_DATA,                                  /*!< IN token answered with a data packet */
+    VBUS_NORESP,                                /*!< no handshake, the host times out */
+    VBUS_BABBLE,                                /*!< the data packet ran past the end of the frame */
+} vbus_resp;
+
+/* a function on the bus, the device core or a hub with functions behind it */
+typedef struct _vbus_func
+{
+    int       (*connected)   (struct _vbus_func *f);
+    int       (*hs_capable)  (struct _vbus_func *f);
+    void      (*reset)       (struct _vbus_func *f, int assert, vbus_speed speed);
+    void      (*sof)         (struct _vbus_func *f, uint32_t frame);
+    vbus_resp (*setup)       (struct _vbus_func *f, uint8_t addr, const uint8_t *data);
+    vbus_resp (*out)         (struct _vbus_func *f, uint8_t addr, uint8_t ep, const uint8_t *data, uint32_t len, uint8_t pid);
+    vbus_resp (*ping)        (struct _vbus_func *f, uint8_t addr, uint8_t ep);
+    vbus_resp (*in)          (struct _vbus_func *f, uint8_t addr, uint8_t ep, uint8_t *data, uint32_t *len, uint8_t *pid);
+    void      (*in_ack)      (struct _vbus_func *f, uint8_t addr, uint8_t ep);
+    void       *priv;
+} vbus_func;
+
+/* transaction kinds of the timing model */
+typedef enum
+{
+    VBUS_XACT_SETUP = 0U,
+    VBUS_XACT_OUT,
+    VBUS_XACT_IN,
+    VBUS_XACT_IN_NAK,                           /*!< IN token answered with a handshake */
+    VBUS_XACT_PING,
+} vbus_xact;
+
+/* counters of one CPU */
+typedef struct
+{
+    uint64_t isr;                               /*!< interrupt service routine runs */
+    uint64_t isr_cycles;                        /*!< modelled cycles spent in them */
+    uint64_t loop;                              /*!< main loop passes */
+    uint64_t reg_rd;                            /*!< core register reads */
+    uint64_t reg_wr;                            /*!< core register writes */
+    uint64_t fifo_rd;                           /*!< FIFO words read */
+    uint64_t fifo_wr;                           /*!< FIFO words written */
+} vbus_cpu_stat;
+
+/* counters of the bus */
+typedef struct
+{
+    uint64_t xact;                              /*!< transactions */
+    uint64_t nak;                               /*!< NAK answers, injected ones included */
+    uint64_t nak_inj;                           /*!< injected NAK answers */
+    uint64_t babble;                            /*!< injected babble */
+    uint64_t bytes;                             /*!< data bytes accepted */
+    uint64_t busy_ns;                           /*!< time the bus carried transactions */
+    vbus_cpu_stat cpu[VBUS_SIDES];
+} vbus_stat;
+
+/* bus options, set before vbus_init() */
+typedef struct
+{
+    uint32_t cpu_hz;                            /*!< core clock of both CPUs */
+    uint32_t nak_pct;                           /*!< percentage of data tokens answered with an injected NAK */
+    uint32_t babble_every;                      /*!< every n-th IN data packet of a non-control endpoint babbles, 0 never */
+    uint32_t seed;                              /*!< seed of the injection */
+    uint32_t trace;                             /*!< list the transactions on stderr */
+} vbus_opt;
+
+extern vbus_opt vbus_options;
+
+/* function declarations */
+/* vbus_trap.c */
+/* map the register windows and install the access traps */
+void vbus_trap_init (void);
+/* count of the accesses of a side, for the cycle accounting */
+void vbus_trap_count (uint8_t side, vbus_cpu_stat *st);
+/* an access is being single-stepped */
+int vbus_trap_busy (void);
+
+/* vbus_core.c */
+/* reset an emulated core */
+void vcore_reset (uint8_t side, int hs_core);
+/* register read with side effects */
+uint32_t vcore_read (uint8_t side, uint32_t off);
+/* register read without side effects */
+uint32_t vcore_peek (uint8_t side, uint32_t off);
+/* register write */
+void vcore_write (uint8_t side, uint32_t off, uint32_t val);
+/* interrupt line of a core */
+int vcore_irq (uint8_t side);
+/* the device core as a function on the bus */
+vbus_func *vcore_func (void);
+/* connection change seen by the host port */
+void vcore_port_connect (int connected);
+/* start of a (micro)frame on the host side, returns 0 when no SOF is sent */
+int vcore_host_sof (void);
+/* run the next transaction of the host channels that fits the time left */
+uint32_t vcore_host_xact (uint64_t left_ns);
+/* speed of the enabled host port */
+vbus_speed vcore_port_speed (void);
+/* dump the state of a core to stderr */
+void vcore_dump (uint8_t side);
+
+/* vbus_model.c */
+/* the hub model with the functions on its downstream ports */
+vbus_func *vmodel_hub (vbus_func *const *port_func, uint8_t ports, int hs);
+/* a mass storage stick model on a RAM disk */
+vbus_func *vmodel_msc (uint8_t index, uint8_t *disk, uint32_t blocks, int hs);
+
+/* vbus_bus.c */
+/* set up the bus, the cores and the traps */
+void vbus_init (void);
+/* put a function other than the device core on the root port, after vbus_init() */
+void vbus_root_set (vbus_func *f);
+/* tie a usb_core_basic to a side of the bus, see usb_basic_init() in usb_hw_sim.c */
+void vbus_bind (uint8_t side, const void *usb_basic);
+/* side a usb_core_basic is tied to, -1 for none */
+int vbus_side (const void *usb_basic);
+/* set the interrupt service routine and the main loop of a side */
+void vbus_cpu_set (uint8_t side, void (*isr)(void), void (*task)(void));
+/* run until done() returns non-zero or the timeout, returns 0 on done */
+int vbus_run (int (*done)(void), uint64_t timeout_ns);
+/* busy wait of the CPU running, usb_udelay() and usb_mdelay() */
+void vbus_delay (uint64_t ns);
+/* register access of a CPU, called by the traps to catch the polling loops */
+void vbus_access (uint8_t side, int write);
+/* simulated time in ns */
+uint64_t vbus_now (void);
+/* root port power, connection and reset, called by the host core */
+void vbus_port_update (void);
+vbus_speed vbus_port_reset (int assert);
+/* a transaction on the bus, with the injected errors */
+vbus_resp vbus_xact_setup (uint8_t addr, const uint8_t *data);
+vbus_resp vbus_xact_out (uint8_t addr, uint8_t ep, const uint8_t *data, uint32_t len, uint8_t pid);
+vbus_resp vbus_xact_ping (uint8_t addr, uint8_t ep);
+vbus_resp vbus_xact_in (uint8_t addr, uint8_t ep, uint8_t *data, uint32_t *len, uint8_t *pid);
+void vbus_xact_in_ack (uint8_t addr, uint8_t ep);
+/* duration of a transaction */
+uint32_t vbus_xact_ns (vbus_speed speed, vbus_xact kind, uint32_t len);
+/* get and clear the counters */
+void vbus_stat_get (vbus_stat *st, int reset);
+/* side whose CPU is running, for the delays */
+int vbus_cpu_running (void);
+/* report a fault of the emulation or the drivers and exit */
+void vbus_fail (const char *fmt, ...) __attribute__ ((noreturn, format (printf, 1, 2)));
+
+#endif /* __VBUS_H */
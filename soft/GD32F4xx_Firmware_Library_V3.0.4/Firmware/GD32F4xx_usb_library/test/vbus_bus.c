@@ -0,0 +1,922 @@
+/*!
+    \file    vbus_bus.c
+    \brief   virtual USB bus: time, the two CPUs, the root port and the
+             transactions with the injected errors
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+/*
+    Time is simulated in ns and advances only here, so each run is
+    deterministic. Each side has a CPU that runs its interrupt service
+    routine when the core raises its interrupt and its main loop
+    otherwise. A run costs the cycles of the cost model in vbus.h: the
+    interrupt entry or the loop pass plus each register and FIFO access,
+    counted by the traps; the code between the accesses is not costed.
+
+    The bus carries one transaction at a time. The effects of a
+    transaction are visible to both cores when it starts and the bus is
+    busy for its duration. The duration follows the packet sizes of the
+    specification (tokens, data packets, handshakes and a fixed inter
+    packet gap) without bit stuffing, which gives 19 bulk packets of 64
+    bytes per full-speed frame and 13 of 512 bytes per high-speed
+    microframe. A transaction that does not fit the time left before the
+    next SOF waits for it.
+
+    A pass of a main loop runs to its end before time advances, but the
+    host stack waits in loops until the interrupt service routine sets the
+    URB state (usbh_urb_wait()), either polling the frame number or only
+    the memory. A main loop pass that read POLL_READS registers without a
+    write is blocked as in a delay until the interrupt service routine of
+    its side has run; the reads are counted, so this does not depend on
+    the host. A loop without any access is caught by a watchdog on the
+    CPU time of the process when it made no access for SPIN_TICKS ticks;
+    it costs nothing then and has no effect until the interrupt, so the
+    simulated time does not depend on when the watchdog fires either.
+
+    The runs of a delay nest on the stack of the CPU that waits, so a main
+    loop pass started within a delay would keep it until the pass ends,
+    and a pass that polls for the other side would hold that side within
+    its delay. While a CPU is in a delay, only the interrupt service
+    routines and the bus run.
+*/
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include "usb_conf.h"
+#include "drv_usb_regs.h"
+#include "vbus.h"
+
+#define FS_FRAME_NS                 1000000U
+#define HS_FRAME_NS                 125000U
+#define ISR_STORM                   1000U
+#define SPIN_TICK_NS                1000000L        /*!< CPU time between two checks of the watchdog */
+#define SPIN_TICKS                  2U
+#define POLL_READS                  256U
+#define SPIN_TIMEOUT_NS             1000000000ULL
+
+#define OFF_GINTF                   0x014U
+#define OFF_GINTEN                  0x018U
+#define OFF_HCTL                    0x400U
+#define OFF_HPCS                    0x440U
+
+typedef struct
+{
+    void      (*isr)  (void);
+    void      (*task) (void);
+    uint64_t    busy_until;                         /*!< the CPU runs code until then */
+    int         in_isr;
+    int         in_task;
+    int         blocked;                            /*!< the main loop waits in a delay */
+    uint64_t    isr_runs;
+    uint64_t    wait_runs;                          /*!< isr_runs when the main loop started to wait */
+    uint32_t    polls;                              /*!< register reads of the main loop pass since its last write */
+    uint64_t    excluded;                           /*!< accesses of nested runs, not part of the current one */
+    uint32_t    storm;                              /*!< interrupts in a row that wrote no register */
+    uint32_t    storm_flags;
+} vcpu;
+
+vbus_opt vbus_options = {VBUS_CPU_HZ, 0U, 0U, 1U, 0U};
+
+static uint64_t now;
+static uint64_t bus_free_at;
+static uint64_t next_sof;
+static uint32_t frame;
+static vcpu cpu[VBUS_SIDES];
+static const void *bound[VBUS_SIDES];
+static int running = -1;
+static int connected;
+static vbus_func *root;
+static int hs_core;
+static uint32_t rng;
+static uint32_t in_data;
+static uint32_t last_in_len;
+static vbus_stat stat;
+static vbus_cpu_stat trap_base[VBUS_SIDES];
+static int spin_side = -1;
+static uint64_t spin_accesses;
+static uint32_t spin_ticks;
+static int wait_side = -1;
+static uint32_t delays;                             /* delays under way, the main loops do not run */
+
+static int schedule (int (*done)(void), uint64_t end);
+static uint64_t accesses (uint8_t side);
+
+/*!
+    \brief      pseudo random number of the injection
+    \param[in]  none
+    \param[out] none
+    \retval     number from 0 to 32767
+*/
+static uint32_t vbus_rand (void)
+{
+    rng = rng * 1103515245U + 12345U;
+
+    return (rng >> 16) & 0x7FFFU;
+}
+
+/*!
+    \brief      the interrupt service routine of the waiting side has run
+    \param[in]  none
+    \param[out] none
+    \retval     non-zero when it has
+*/
+static int isr_ran (void)
+{
+    return cpu[wait_side].isr_runs != cpu[wait_side].wait_runs;
+}
+
+/*!
+    \brief      block the main loop pass running until the interrupt service routine of its side has run
+    \param[in]  side: side of the bus
+    \param[out] none
+    \retval     none
+*/
+static void isr_wait (int side)
+{
+    int outer = wait_side;
+    sigset_t set, old;
+
+    /* called from the trap and the watchdog handlers, which must nest in the run */
+    sigemptyset(&set);
+    sigaddset(&set, SIGSEGV);
+    sigaddset(&set, SIGTRAP);
+    sigaddset(&set, SIGPROF);
+    sigprocmask(SIG_UNBLOCK, &set, &old);
+
+    wait_side = side;
+    cpu[side].wait_runs = cpu[side].isr_runs;
+    cpu[side].blocked++;
+    cpu[side].busy_until = now;
+
+    (void)schedule(isr_ran, now + SPIN_TIMEOUT_NS);
+
+    cpu[side].blocked--;
+    cpu[side].polls = 0U;
+    wait_side = outer;
+    running = side;
+
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
+
+/*!
+    \brief      watchdog of the main loops waiting for an interrupt without an access, SIGPROF handler
+    \param[in]  sig: signal number
+    \param[out] none
+    \retval     none
+*/
+static void spin_check (int sig)
+{
+    int side = running;
+    uint64_t a;
+
+    if ((side < 0) || !cpu[side].in_task || cpu[side].in_isr || cpu[side].blocked || vbus_trap_busy()) {
+        spin_side = -1;
+        return;
+    }
+
+    a = accesses((uint8_t)side);
+
+    if ((side != spin_side) || (a != spin_accesses)) {
+        spin_side = side;
+        spin_accesses = a;
+        spin_ticks = 0U;
+        return;
+    }
+
+    if (++spin_ticks < SPIN_TICKS) {
+        return;
+    }
+
+    spin_side = -1;
+    isr_wait(side);
+}
+
+/*!
+    \brief      register access of a CPU, called by the traps once the access is complete
+    \param[in]  side: side of the bus
+    \param[in]  write: non-zero for a write
+    \param[out] none
+    \retval     none
+*/
+void vbus_access (uint8_t side, int write)
+{
+    vcpu *c = &cpu[side];
+
+    if (write || ((int)side != running) || !c->in_task || c->in_isr || c->blocked) {
+        c->polls = 0U;
+        return;
+    }
+
+    if (++c->polls >= POLL_READS) {
+        isr_wait(side);
+    }
+}
+
+/*!
+    \brief      start the watchdog of the main loops on the CPU time of the process
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void spin_watchdog_init (void)
+{
+    struct sigaction sa;
+    struct sigevent sev;
+    struct itimerspec its;
+    timer_t timer;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = spin_check;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+
+    memset(&sev, 0, sizeof(sev));
+    sev.sigev_notify = SIGEV_SIGNAL;
+    sev.sigev_signo = SIGPROF;
+
+    if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &sev, &timer)) {
+        vbus_fail("cannot create the watchdog timer");
+    }
+
+    its.it_interval.tv_sec = 0;
+    its.it_interval.tv_nsec = SPIN_TICK_NS;
+    its.it_value = its.it_interval;
+    timer_settime(timer, 0, &its, NULL);
+}
+
+/*!
+    \brief      set up the bus, the cores and the traps
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void vbus_init (void)
+{
+    static int trapped = 0;
+
+#ifdef USE_USB_HS
+    hs_core = 1;
+#else
+    hs_core = 0;
+#endif /* USE_USB_HS */
+
+    if (!trapped) {
+        vbus_trap_init();
+        spin_watchdog_init();
+        trapped = 1;
+    }
+
+    vcore_reset(VBUS_DEVICE, hs_core);
+    vcore_reset(VBUS_HOST, hs_core);
+
+    memset(cpu, 0, sizeof(cpu));
+    memset(bound, 0, sizeof(bound));
+    memset(&stat, 0, sizeof(stat));
+
+    for (uint8_t side = 0U; side < VBUS_SIDES; side++) {
+        vbus_trap_count(side, &trap_base[side]);
+    }
+
+    now = 0U;
+    bus_free_at = 0U;
+    next_sof = 0U;
+    frame = 0U;
+    delays = 0U;
+    running = -1;
+    connected = 0;
+    root = vcore_func();
+    rng = vbus_options.seed;
+    in_data = 0U;
+}
+
+/*!
+    \brief      put a function other than the device core on the root port
+    \param[in]  f: function, a model of vbus_model.c
+    \param[out] none
+    \retval     none
+*/
+void vbus_root_set (vbus_func *f)
+{
+    root = f;
+}
+
+/*!
+    \brief      tie a usb_core_basic to a side of the bus
+    \param[in]  side: side of the bus
+    \param[in]  usb_basic: usb_core_basic of the driver
+    \param[out] none
+    \retval     none
+*/
+void vbus_bind (uint8_t side, const void *usb_basic)
+{
+    bound[side] = usb_basic;
+}
+
+/*!
+    \brief      side a usb_core_basic is tied to
+    \param[in]  usb_basic: usb_core_basic of the driver
+    \param[out] none
+    \retval     side, -1 for none
+*/
+int vbus_side (const void *usb_basic)
+{
+    for (int side = 0; side < (int)VBUS_SIDES; side++) {
+        if (bound[side] == usb_basic) {
+            return side;
+        }
+    }
+
+    return -1;
+}
+
+/*!
+    \brief      set the interrupt service routine and the main loop of a side
+    \param[in]  side: side of the bus
+    \param[in]  isr: interrupt service routine
+    \param[in]  task: main loop pass, NULL for none
+    \param[out] none
+    \retval     none
+*/
+void vbus_cpu_set (uint8_t side, void (*isr)(void), void (*task)(void))
+{
+    cpu[side].isr = isr;
+    cpu[side].task = task;
+}
+
+/*!
+    \brief      register and FIFO accesses of a side so far
+    \param[in]  side: side of the bus
+    \param[out] none
+    \retval     accesses
+*/
+static uint64_t accesses (uint8_t side)
+{
+    vbus_cpu_stat st;
+
+    vbus_trap_count(side, &st);
+
+    return st.reg_rd + st.reg_wr + st.fifo_rd + st.fifo_wr;
+}
+
+/*!
+    \brief      register and FIFO writes of a side so far
+    \param[in]  side: side of the bus
+    \param[out] none
+    \retval     writes
+*/
+static uint64_t writes (uint8_t side)
+{
+    vbus_cpu_stat st;
+
+    vbus_trap_count(side, &st);
+
+    return st.reg_wr + st.fifo_wr;
+}
+
+/*!
+    \brief      time of a number of CPU cycles
+    \param[in]  cycles: cycles
+    \param[out] none
+    \retval     ns
+*/
+static uint64_t cycles_ns (uint64_t cycles)
+{
+    return (cycles * 1000000000ULL + vbus_options.cpu_hz - 1U) / vbus_options.cpu_hz;
+}
+
+/*!
+    \brief      let a CPU run its interrupt service routine or a pass of its main loop
+    \param[in]  side: side of the bus
+    \param[out] none
+    \retval     none
+*/
+static void cpu_step (uint8_t side)
+{
+    vcpu *c = &cpu[side];
+    int prev = running;
+    uint64_t a0, wr, total, acc, cycles, excluded = c->excluded;
+
+    if (c->in_isr) {
+        /* the interrupt service routine of this CPU waits in a delay */
+        return;
+    }
+
+    a0 = accesses(side);
+    wr = writes(side);
+    c->excluded = 0U;
+    c->polls = 0U;
+    running = side;
+
+    if (c->isr && vcore_irq(side)) {
+        uint32_t flags = vcore_peek(side, OFF_GINTF) & vcore_peek(side, OFF_GINTEN);
+
+        c->in_isr = 1;
+        c->isr();
+        c->in_isr = 0;
+        c->isr_runs++;
+
+        total = accesses(side) - a0;
+        acc = total - c->excluded;
+        cycles = VBUS_ISR_CYCLES + acc * VBUS_REG_CYCLES;
+        stat.cpu[side].isr++;
+        stat.cpu[side].isr_cycles += cycles;
+
+        /* the service routine must clear the cause of the interrupt */
+        if ((writes(side) == wr) && (flags == c->storm_flags)) {
+            if (++c->storm >= ISR_STORM) {
+                vbus_fail("%s: interrupt storm, %u interrupts in a row left flags %08x pending",
+                          side ? "host" : "device", c->storm, flags);
+            }
+        } else {
+            c->storm = 0U;
+        }
+
+        c->storm_flags = flags;
+    } else if (c->task && !c->blocked && (0U == delays)) {
+        c->in_task = 1;
+        c->task();
+        c->in_task = 0;
+
+        total = accesses(side) - a0;
+        acc = total - c->excluded;
+        cycles = VBUS_LOOP_CYCLES + acc * VBUS_REG_CYCLES;
+        stat.cpu[side].loop++;
+    } else {
+        total = 0U;
+        cycles = VBUS_LOOP_CYCLES;
+    }
+
+    /* a run nested in a delay of the main loop is not part of the cost of the loop pass */
+    c->excluded = excluded + total;
+
+    running = prev;
+    c->busy_until = now + cycles_ns(cycles);
+}
+
+/*!
+    \brief      frame period of the port
+    \param[in]  none
+    \param[out] none
+    \retval     ns
+*/
+static uint64_t frame_ns (void)
+{
+    return (VBUS_SPEED_HIGH == vcore_port_speed()) ? HS_FRAME_NS : FS_FRAME_NS;
+}
+
+/*!
+    \brief      let the bus carry a SOF or a transaction if it is free
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+static void bus_step (void)
+{
+    uint32_t t;
+
+    if (now < bus_free_at) {
+        return;
+    }
+
+    if (now >= next_sof) {
+        if (vcore_host_sof()) {
+            frame++;
+
+            if (root->sof) {
+                root->sof(root, frame);
+            }
+
+            bus_free_at = now + vbus_xact_ns(vcore_port_speed(), VBUS_XACT_PING, 0U) / 2U;
+            next_sof = now + frame_ns();
+        } else {
+            next_sof = now + FS_FRAME_NS;
+        }
+
+        return;
+    }
+
+    t = vcore_host_xact(next_sof - now);
+
+    if (t) {
+        stat.xact++;
+        stat.busy_ns += t;
+        bus_free_at = now + t;
+    }
+}
+
+/*!
+    \brief      run the bus and the CPUs
+    \param[in]  done: end condition, NULL for none
+    \param[in]  end: end time
+    \param[out] none
+    \retval     0 when done() returned non-zero, 1 at the end time
+*/
+static int schedule (int (*done)(void), uint64_t end)
+{
+    uint64_t next;
+
+    for (;;) {
+        if (done && done()) {
+            return 0;
+        }
+
+        if (now >= end) {
+            return 1;
+        }
+
+        bus_step();
+
+        for (uint8_t side = 0U; side < VBUS_SIDES; side++) {
+            if (cpu[side].busy_until <= now) {
+                cpu_step(side);
+            }
+        }
+
+        next = end;
+
+        for (uint8_t side = 0U; side < VBUS_SIDES; side++) {
+            if (!cpu[side].in_isr && (cpu[side].busy_until > now) && (cpu[side].busy_until < next)) {
+                next = cpu[side].busy_until;
+            }
+        }
+
+        if ((bus_free_at > now) && (bus_free_at < next)) {
+            next = bus_free_at;
+        }
+
+        if ((next_sof > now) && (next_sof < next)) {
+            next = next_sof;
+        }
+
+        if (next > now) {
+            now = next;
+        }
+    }
+}
+
+/*!
+    \brief      run until done() returns non-zero or the timeout
+    \param[in]  done: end condition
+    \param[in]  timeout_ns: timeout from now
+    \param[out] none
+    \retval     0 on done, 1 on timeout
+*/
+int vbus_run (int (*done)(void), uint64_t timeout_ns)
+{
+    return schedule(done, now + timeout_ns);
+}
+
+/*!
+    \brief      busy wait of the CPU running, its interrupts are served meanwhile
+    \param[in]  ns: time to wait
+    \param[out] none
+    \retval     none
+*/
+void vbus_delay (uint64_t ns)
+{
+    int side = running;
+    uint64_t end = now + ns;
+
+    if (side >= 0) {
+        cpu[side].blocked++;
+        cpu[side].busy_until = now;
+    }
+
+    delays++;
+    (void)schedule(NULL, end);
+    delays--;
+
+    if (side >= 0) {
+        cpu[side].blocked--;
+    }
+
+    running = side;
+}
+
+/*!
+    \brief      simulated time
+    \param[in]  none
+    \param[out] none
+    \retval     ns
+*/
+uint64_t vbus_now (void)
+{
+    return now;
+}
+
+/*!
+    \brief      side whose CPU is running
+    \param[in]  none
+    \param[out] none
+    \retval     side, -1 for none
+*/
+int vbus_cpu_running (void)
+{
+    return running;
+}
+
+/*!
+    \brief      root port power and connection, called on the register writes that change them
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void vbus_port_update (void)
+{
+    int conn = (0U != (vcore_peek(VBUS_HOST, OFF_HPCS) & HPCS_PP)) && root->connected(root);
+
+    if (conn != connected) {
+        connected = conn;
+        vcore_port_connect(conn);
+    }
+}
+
+/*!
+    \brief      reset signalling of the root port
+    \param[in]  assert: 1 at the start of the reset, 0 at the end
+    \param[out] none
+    \retval     speed negotiated
+*/
+vbus_speed vbus_port_reset (int assert)
+{
+    vbus_speed speed = VBUS_SPEED_FULL;
+
+    if (hs_core && !(vcore_peek(VBUS_HOST, OFF_HCTL) & HCTL_SPDFSLS) && root->hs_capable(root)) {
+        speed = VBUS_SPEED_HIGH;
+    }
+
+    if (connected) {
+        root->reset(root, assert, speed);
+    }
+
+    return speed;
+}
+
+static const char *const resp_name[] = {"ACK", "NAK", "NYET", "STALL", "DATA", "NORESP", "BABBLE"};
+
+/*!
+    \brief      list a transaction
+    \param[in]  kind: name of the token
+    \param[in]  addr: device address
+    \param[in]  ep: endpoint
+    \param[in]  len: data bytes
+    \param[in]  pid: data PID
+    \param[in]  resp: response
+    \param[out] none
+    \retval     none
+*/
+static void trace (const char *kind, uint8_t addr, uint8_t ep, uint32_t len, uint8_t pid, vbus_resp resp)
+{
+    if (vbus_options.trace) {
+        fprintf(stderr, "%12llu %-5s %3u.%u %4u DATA%u %s\n", (unsigned long long)now, kind, addr, ep, len, pid,
+                resp_name[resp]);
+    }
+}
+
+/*!
+    \brief      SETUP transaction
+    \param[in]  addr: device address
+    \param[in]  data: 8 bytes of the request
+    \param[out] none
+    \retval     response
+*/
+vbus_resp vbus_xact_setup (uint8_t addr, const uint8_t *data)
+{
+    if (!connected) {
+        return VBUS_NORESP;
+    }
+
+    vbus_resp resp;
+
+    resp = root->setup(root, addr, data);
+    trace("SETUP", addr, 0U, 8U, 0U, resp);
+
+    return resp;
+}
+
+/*!
+    \brief      OUT transaction
+    \param[in]  addr: device address
+    \param[in]  ep: endpoint
+    \param[in]  data: packet
+    \param[in]  len: length of the packet
+    \param[in]  pid: data PID, 0: DATA0 1: DATA1
+    \param[out] none
+    \retval     response
+*/
+vbus_resp vbus_xact_out (uint8_t addr, uint8_t ep, const uint8_t *data, uint32_t len, uint8_t pid)
+{
+    vbus_resp resp;
+
+    if (!connected) {
+        return VBUS_NORESP;
+    }
+
+    if (vbus_options.nak_pct && ((vbus_rand() % 100U) < vbus_options.nak_pct)) {
+        stat.nak++;
+        stat.nak_inj++;
+        trace("OUT", addr, ep, len, pid, VBUS_NAK);
+
+        return VBUS_NAK;
+    }
+
+    resp = root->out(root, addr, ep, data, len, pid);
+    trace("OUT", addr, ep, len, pid, resp);
+
+    if ((VBUS_ACK == resp) || (VBUS_NYET == resp)) {
+        stat.bytes += len;
+    } else if (VBUS_NAK == resp) {
+        stat.nak++;
+    } else {
+        /* no operation */
+    }
+
+    return resp;
+}
+
+/*!
+    \brief      PING transaction
+    \param[in]  addr: device address
+    \param[in]  ep: endpoint
+    \param[out] none
+    \retval     response
+*/
+vbus_resp vbus_xact_ping (uint8_t addr, uint8_t ep)
+{
+    if (!connected) {
+        return VBUS_NORESP;
+    }
+
+    vbus_resp resp = root->ping(root, addr, ep);
+
+    trace("PING", addr, ep, 0U, 0U, resp);
+
+    return resp;
+}
+
+/*!
+    \brief      IN transaction, the data is acknowledged by vbus_xact_in_ack()
+    \param[in]  addr: device address
+    \param[in]  ep: endpoint
+    \param[out] data: packet
+    \param[out] len: length of the packet
+    \param[out] pid: data PID, 0: DATA0 1: DATA1
+    \retval     response
+*/
+vbus_resp vbus_xact_in (uint8_t addr, uint8_t ep, uint8_t *data, uint32_t *len, uint8_t *pid)
+{
+    vbus_resp resp;
+
+    if (!connected) {
+        return VBUS_NORESP;
+    }
+
+    if (vbus_options.nak_pct && ((vbus_rand() % 100U) < vbus_options.nak_pct)) {
+        stat.nak++;
+        stat.nak_inj++;
+        trace("IN", addr, ep, 0U, 0U, VBUS_NAK);
+
+        return VBUS_NAK;
+    }
+
+    resp = root->in(root, addr, ep, data, len, pid);
+
+    if (VBUS_DATA == resp) {
+        last_in_len = *len;
+
+        /* the packet is not acknowledged, the function sends it again */
+        if (ep && vbus_options.babble_every && (0U == (++in_data % vbus_options.babble_every))) {
+            stat.babble++;
+            trace("IN", addr, ep, *len, *pid, VBUS_BABBLE);
+
+            return VBUS_BABBLE;
+        }
+    }
+
+    trace("IN", addr, ep, (VBUS_DATA == resp) ? *len : 0U, (VBUS_DATA == resp) ? *pid : 0U, resp);
+
+    if (VBUS_NAK == resp) {
+        stat.nak++;
+    }
+
+    return resp;
+}
+
+/*!
+    \brief      handshake of an IN transaction that delivered data
+    \param[in]  addr: device address
+    \param[in]  ep: endpoint
+    \param[out] none
+    \retval     none
+*/
+void vbus_xact_in_ack (uint8_t addr, uint8_t ep)
+{
+    stat.bytes += last_in_len;
+    root->in_ack(root, addr, ep);
+}
+
+/*!
+    \brief      duration of a transaction
+    \param[in]  speed: speed of the transaction
+    \param[in]  kind: kind of the transaction
+    \param[in]  len: data bytes
+    \param[out] none
+    \retval     ns
+*/
+uint32_t vbus_xact_ns (vbus_speed speed, vbus_xact kind, uint32_t len)
+{
+    uint32_t token, data, handshake, gap, bits;
+
+    if (VBUS_SPEED_HIGH == speed) {
+        token = 64U;
+        data = 64U + 8U * len;
+        handshake = 48U;
+        gap = 100U;
+    } else {
+        token = 35U;
+        data = 35U + 8U * len;
+        handshake = 19U;
+        gap = 8U;
+    }
+
+    switch (kind) {
+    case VBUS_XACT_IN_NAK:
+    case VBUS_XACT_PING:
+        bits = token + gap + handshake + gap;
+        break;
+
+    default:
+        bits = token + gap + data + gap + handshake + gap;
+        break;
+    }
+
+    if (VBUS_SPEED_HIGH == speed) {
+        return (bits * 1000U + 479U) / 480U;
+    } else if (VBUS_SPEED_FULL == speed) {
+        return (bits * 1000U + 11U) / 12U;
+    } else {
+        return (bits * 2000U + 2U) / 3U;
+    }
+}
+
+/*!
+    \brief      get and optionally clear the counters
+    \param[in]  reset: non-zero to clear them
+    \param[out] st: counters
+    \retval     none
+*/
+void vbus_stat_get (vbus_stat *st, int reset)
+{
+    vbus_cpu_stat tc;
+
+    *st = stat;
+
+    for (uint8_t side = 0U; side < VBUS_SIDES; side++) {
+        vbus_trap_count(side, &tc);
+
+        st->cpu[side].reg_rd = tc.reg_rd - trap_base[side].reg_rd;
+        st->cpu[side].reg_wr = tc.reg_wr - trap_base[side].reg_wr;
+        st->cpu[side].fifo_rd = tc.fifo_rd - trap_base[side].fifo_rd;
+        st->cpu[side].fifo_wr = tc.fifo_wr - trap_base[side].fifo_wr;
+
+        if (reset) {
+            trap_base[side] = tc;
+        }
+    }
+
+    if (reset) {
+        memset(&stat, 0, sizeof(stat));
+    }
+}
+
+/*!
+    \brief      report a fault of the emulation or the drivers and exit
+    \param[in]  fmt: format of the message
+    \param[out] none
+    \retval     none
+*/
+void vbus_fail (const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "vbus: at %llu ns: ", (unsigned long long)now);
+
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+
+    fputc('\n', stderr);
+
+    vcore_dump(VBUS_DEVICE);
+    vcore_dump(VBUS_HOST);
+
+    exit(2);
+}
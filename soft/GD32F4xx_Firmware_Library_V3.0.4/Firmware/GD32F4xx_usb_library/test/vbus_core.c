@@ -0,0 +1,1651 @@
+/*!
+    \file    vbus_core.c
+    \brief   register model of the USBFS/USBHS cores on the virtual bus, in
+             slave (FIFO) mode
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+/*
+    One model serves both sides: the device side answers the tokens of the
+    bus as a function (vcore_func()), the host side runs the transactions of
+    its channels (vcore_host_xact()). The model follows the register
+    description of the user manual where the drivers depend on it:
+
+    - the receive FIFO is one word queue with the status entries tagged, a
+      GRSTATP read that does not find a status entry at the head (data left
+      unread by the driver) and any FIFO overflow are reported as faults
+    - completion entries set their interrupt flag when they are popped:
+      XFER_COMP sets DOEPINTF.TF and disables the OUT endpoint, SETUP_COMP
+      sets DOEPINTF.STPF, IN_XFER_COMP sets HCHINTF.TF
+    - an IN channel stops after each data packet and each NAK until the
+      driver writes CEN again, an OUT channel stops at a NAK; a channel
+      that transferred all packets stays enabled until it is halted or
+      enabled again for the next transfer (the interrupt pipes), a write
+      of CEN without a new packet count does not restart it, the halt
+      sets HCHINTF.CH and drops its data in the transmit FIFO
+    - the transmit FIFO empty flags are level flags (half empty, TXFTH = 0)
+    - DMA, isochronous transfers, suspend and the OTG protocols are not
+      modelled
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include "usb_conf.h"
+#include "drv_usb_regs.h"
+#include "vbus.h"
+
+#define MAX_EP                      6U
+#define MAX_CH                      16U
+#define MAX_FIFO                    16U
+#define RXQ_WORDS                   2048U
+#define TXQ_WORDS                   2048U
+
+#define RXW_DATA                    0U
+#define RXW_STAT                    1U
+
+/* register offsets */
+#define O_GAHBCS                    0x008U
+#define O_GUSBCS                    0x00CU
+#define O_GRSTCTL                   0x010U
+#define O_GINTF                     0x014U
+#define O_GINTEN                    0x018U
+#define O_GRSTATR                   0x01CU
+#define O_GRSTATP                   0x020U
+#define O_GRFLEN                    0x024U
+#define O_HNPTFLEN                  0x028U
+#define O_HNPTFQSTAT                0x02CU
+#define O_CID                       0x03CU
+#define O_HPTFLEN                   0x100U
+#define O_DIEPTFLEN                 0x104U
+#define O_HCTL                      0x400U
+#define O_HFINFR                    0x408U
+#define O_HPTFQSTAT                 0x410U
+#define O_HACHINT                   0x414U
+#define O_HACHINTEN                 0x418U
+#define O_HPCS                      0x440U
+#define O_HCH                       0x500U
+#define O_DCFG                      0x800U
+#define O_DCTL                      0x804U
+#define O_DSTAT                     0x808U
+#define O_DIEPINTEN                 0x810U
+#define O_DOEPINTEN                 0x814U
+#define O_DAEPINT                   0x818U
+#define O_DAEPINTEN                 0x81CU
+#define O_DIEPFEINTEN               0x834U
+#define O_DIEP                      0x900U
+#define O_DOEP                      0xB00U
+
+/* registers of a channel or an endpoint */
+#define O_CTL                       0x00U
+#define O_INTF                      0x08U
+#define O_INTEN                     0x0CU
+#define O_LEN                       0x10U
+#define O_TFSTAT                    0x18U
+
+#define R(c, off)                   ((c)->r[(off) >> 2])
+#define HCH(ch, reg)                (O_HCH + (ch) * 0x20U + (reg))
+#define DIEP(ep, reg)               (O_DIEP + (ep) * 0x20U + (reg))
+#define DOEP(ep, reg)               (O_DOEP + (ep) * 0x20U + (reg))
+
+#define EPTYPE_CTRL                 0U
+#define EPTYPE_ISOC                 1U
+#define EPTYPE_BULK                 2U
+#define EPTYPE_INTR                 3U
+
+typedef struct
+{
+    uint32_t    w[RXQ_WORDS];
+    uint8_t     tag[RXQ_WORDS];
+    uint32_t    head;
+    uint32_t    count;
+} rx_fifo;
+
+typedef struct
+{
+    uint32_t    w[TXQ_WORDS];
+    uint32_t    head;
+    uint32_t    count;
+} tx_fifo;
+
+typedef struct
+{
+    uint8_t     active;                             /*!< enabled and not halted */
+    uint8_t     paused;                             /*!< waits for CEN to be written again */
+    uint8_t     done;                               /*!< all packets transferred, waits for the halt or a new transfer */
+    uint8_t     due;                                /*!< periodic transaction allowed in this frame */
+    tx_fifo     tx;                                 /*!< OUT data of the channel in the shared FIFO */
+} vchan;
+
+typedef struct
+{
+    uint8_t     pid;                                /*!< next data PID, 0: DATA0 1: DATA1 */
+    uint8_t     ending;                             /*!< OUT: completion queued, further packets are NAKed */
+} vep;
+
+typedef struct
+{
+    uint32_t    r[0x1000U / 4U];                    /*!< registers below the FIFO windows */
+    int         hs;                                 /*!< USBHS core */
+    uint8_t     num_ep;
+    uint8_t     num_ch;
+    uint32_t    gintf;                              /*!< latched interrupt flags */
+    rx_fifo     rx;
+    tx_fifo     txf[MAX_FIFO];                      /*!< device IN FIFOs */
+    vep         in[MAX_EP];
+    vep         out[MAX_EP];
+    vchan       ch[MAX_CH];
+    uint8_t     old_dar;                            /*!< address before the last SET_ADDRESS */
+    uint8_t     old_dar_valid;
+    uint32_t    frame;
+    vbus_speed  speed;
+    uint8_t     rr;                                 /*!< round robin of the non-periodic channels */
+} vcore;
+
+static vcore cores[VBUS_SIDES];
+
+static const char *side_name[VBUS_SIDES] = {"device", "host"};
+
+/* latched flags of GINTF, the others are derived from the core state */
+#define GINTF_LATCHED               (GINTF_WKUPIF | GINTF_SESIF | GINTF_DISCIF | GINTF_IDPSC | GINTF_ISOONCIF | \
+                                     GINTF_ISOINCIF | GINTF_EOPFIF | GINTF_ISOOPDIF | GINTF_ENUMFIF | GINTF_RST | \
+                                     GINTF_SP | GINTF_ESP | GINTF_SOF | GINTF_MFIF)
+
+/*!
+    \brief      push a word to the receive FIFO
+    \param[in]  c: core
+    \param[in]  w: word
+    \param[in]  tag: RXW_DATA or RXW_STAT
+    \param[out] none
+    \retval     none
+*/
+static void rx_push (vcore *c, uint32_t w, uint8_t tag)
+{
+    uint32_t i;
+
+    if (c->rx.count >= RXQ_WORDS) {
+        vbus_fail("%s: receive FIFO model overflow", side_name[c - cores]);
+    }
+
+    i = (c->rx.head + c->rx.count) % RXQ_WORDS;
+    c->rx.w[i] = w;
+    c->rx.tag[i] = tag;
+    c->rx.count++;
+}
+
+/*!
+    \brief      push a status entry and its data to the receive FIFO
+    \param[in]  c: core
+    \param[in]  stat: status word
+    \param[in]  data: packet data
+    \param[in]  len: packet length
+    \param[out] none
+    \retval     none
+*/
+static void rx_push_packet (vcore *c, uint32_t stat, const uint8_t *data, uint32_t len)
+{
+    uint32_t w;
+
+    rx_push(c, stat, RXW_STAT);
+
+    for (uint32_t i = 0U; i < len; i += 4U) {
+        w = 0U;
+        memcpy(&w, data + i, (len - i) < 4U ? (len - i) : 4U);
+        rx_push(c, w, RXW_DATA);
+    }
+}
+
+/*!
+    \brief      free words of the receive FIFO
+    \param[in]  c: core
+    \param[out] none
+    \retval     free words
+*/
+static uint32_t rx_free (vcore *c)
+{
+    uint32_t depth = R(c, O_GRFLEN) & 0xFFFFU;
+
+    return (c->rx.count < depth) ? (depth - c->rx.count) : 0U;
+}
+
+/*!
+    \brief      pop a word of the transmit FIFO
+    \param[in]  f: FIFO
+    \param[out] none
+    \retval     word
+*/
+static uint32_t tx_pop (tx_fifo *f)
+{
+    uint32_t w = f->w[f->head];
+
+    f->head = (f->head + 1U) % TXQ_WORDS;
+    f->count--;
+
+    return w;
+}
+
+/*!
+    \brief      copy the first bytes of a transmit FIFO without popping them
+    \param[in]  f: FIFO
+    \param[in]  len: number of bytes
+    \param[out] data: bytes
+    \retval     none
+*/
+static void tx_peek (const tx_fifo *f, uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0U; i < len; i += 4U) {
+        uint32_t w = f->w[(f->head + i / 4U) % TXQ_WORDS];
+
+        memcpy(data + i, &w, (len - i) < 4U ? (len - i) : 4U);
+    }
+}
+
+/*!
+    \brief      push a word to a transmit FIFO
+    \param[in]  c: core
+    \param[in]  f: FIFO
+    \param[in]  used: words used in the configured FIFO the queue is part of
+    \param[in]  depth: depth of the configured FIFO
+    \param[in]  w: word
+    \param[in]  what: name of the FIFO for the fault report
+    \param[in]  num: number of the FIFO for the fault report
+    \param[out] none
+    \retval     none
+*/
+static void tx_push (vcore *c, tx_fifo *f, uint32_t used, uint32_t depth, uint32_t w, const char *what, uint32_t num)
+{
+    if ((used >= depth) || (f->count >= TXQ_WORDS)) {
+        vbus_fail("%s: %s %u overflow, %u words written to a FIFO of %u words",
+                  side_name[c - cores], what, num, used + 1U, depth);
+    }
+
+    f->w[(f->head + f->count) % TXQ_WORDS] = w;
+    f->count++;
+}
+
+/*!
+    \brief      depth of a device IN FIFO
+    \param[in]  c: core
+    \param[in]  n: FIFO number
+    \param[out] none
+    \retval     depth in words
+*/
+static uint32_t dev_txf_depth (vcore *c, uint32_t n)
+{
+    if (0U == n) {
+        return R(c, O_HNPTFLEN) >> 16;
+    }
+
+    return R(c, O_DIEPTFLEN + (n - 1U) * 4U) >> 16;
+}
+
+/*!
+    \brief      check whether a channel uses the periodic transmit FIFO
+    \param[in]  c: core
+    \param[in]  ch: channel
+    \param[out] none
+    \retval     1 for a periodic channel
+*/
+static int ch_periodic (vcore *c, uint32_t ch)
+{
+    uint32_t type = (R(c, HCH(ch, O_CTL)) & HCHCTL_EPTYPE) >> 18;
+
+    return (EPTYPE_INTR == type) || (EPTYPE_ISOC == type);
+}
+
+/*!
+    \brief      words used in a host transmit FIFO
+    \param[in]  c: core
+    \param[in]  periodic: 1 for the periodic FIFO
+    \param[out] none
+    \retval     words
+*/
+static uint32_t host_txf_used (vcore *c, int periodic)
+{
+    uint32_t used = 0U;
+
+    for (uint32_t ch = 0U; ch < c->num_ch; ch++) {
+        if (ch_periodic(c, ch) == periodic) {
+            used += c->ch[ch].tx.count;
+        }
+    }
+
+    return used;
+}
+
+/*!
+    \brief      depth of a host transmit FIFO
+    \param[in]  c: core
+    \param[in]  periodic: 1 for the periodic FIFO
+    \param[out] none
+    \retval     words
+*/
+static uint32_t host_txf_depth (vcore *c, int periodic)
+{
+    return (periodic ? R(c, O_HPTFLEN) : R(c, O_HNPTFLEN)) >> 16;
+}
+
+/*!
+    \brief      transmit FIFO and queue status of the host
+    \param[in]  c: core
+    \param[in]  periodic: 1 for HPTFQSTAT
+    \param[out] none
+    \retval     register value
+*/
+static uint32_t host_txq_stat (vcore *c, int periodic)
+{
+    uint32_t depth = host_txf_depth(c, periodic), used = host_txf_used(c, periodic);
+    uint32_t cnum = 0U;
+
+    /* the top of the request queue is the first channel still waiting for data */
+    for (uint32_t ch = 0U; ch < c->num_ch; ch++) {
+        vchan *h = &c->ch[ch];
+        uint32_t ctl = R(c, HCH(ch, O_CTL));
+        uint32_t tlen = R(c, HCH(ch, O_LEN)) & HCHLEN_TLEN;
+
+        if (h->active && !h->done && !(ctl & HCHCTL_EPDIR) && (ch_periodic(c, ch) == periodic) &&
+            (((tlen + 3U) / 4U) > h->tx.count)) {
+            cnum = ch;
+            break;
+        }
+    }
+
+    return ((used < depth) ? (depth - used) : 0U) | (8U << 16) | (cnum << 27);
+}
+
+/*!
+    \brief      check the level of a transmit FIFO empty flag
+    \param[in]  c: core
+    \param[in]  used: words used
+    \param[in]  depth: depth
+    \param[out] none
+    \retval     1 when the flag is set
+*/
+static int txfe_level (vcore *c, uint32_t used, uint32_t depth)
+{
+    if (R(c, O_GAHBCS) & GAHBCS_TXFTH) {
+        return 0U == used;
+    }
+
+    return used <= depth / 2U;
+}
+
+/*!
+    \brief      interrupt flags of a device IN endpoint
+    \param[in]  c: core
+    \param[in]  ep: endpoint
+    \param[out] none
+    \retval     DIEPINTF value
+*/
+static uint32_t diepintf (vcore *c, uint32_t ep)
+{
+    uint32_t v = R(c, DIEP(ep, O_INTF)) & ~DIEPINTF_TXFE;
+
+    if (txfe_level(c, c->txf[ep].count, dev_txf_depth(c, ep))) {
+        v |= DIEPINTF_TXFE;
+    }
+
+    return v;
+}
+
+/*!
+    \brief      all endpoints interrupt register of the device
+    \param[in]  c: core
+    \param[out] none
+    \retval     DAEPINT value
+*/
+static uint32_t daepint (vcore *c)
+{
+    uint32_t v = 0U;
+
+    for (uint32_t ep = 0U; ep < c->num_ep; ep++) {
+        uint32_t mask = R(c, O_DIEPINTEN);
+
+        if (R(c, O_DIEPFEINTEN) & (1U << ep)) {
+            mask |= DIEPINTF_TXFE;
+        }
+
+        if (diepintf(c, ep) & mask) {
+            v |= 1U << ep;
+        }
+
+        if (R(c, DOEP(ep, O_INTF)) & R(c, O_DOEPINTEN)) {
+            v |= 1U << (16U + ep);
+        }
+    }
+
+    return v;
+}
+
+/*!
+    \brief      all channels interrupt register of the host
+    \param[in]  c: core
+    \param[out] none
+    \retval     HACHINT value
+*/
+static uint32_t hachint (vcore *c)
+{
+    uint32_t v = 0U;
+
+    for (uint32_t ch = 0U; ch < c->num_ch; ch++) {
+        if (R(c, HCH(ch, O_INTF)) & R(c, HCH(ch, O_INTEN))) {
+            v |= 1U << ch;
+        }
+    }
+
+    return v;
+}
+
+/*!
+    \brief      global interrupt flags
+    \param[in]  c: core
+    \param[out] none
+    \retval     GINTF value
+*/
+static uint32_t gintf_read (vcore *c)
+{
+    uint32_t v = c->gintf;
+
+    if (c->rx.count && (RXW_STAT == c->rx.tag[c->rx.head])) {
+        v |= GINTF_RXFNEIF;
+    }
+
+    if (R(c, O_GUSBCS) & GUSBCS_FHM) {
+        v |= GINTF_COPM;
+
+        if (txfe_level(c, host_txf_used(c, 0), host_txf_depth(c, 0))) {
+            v |= GINTF_NPTXFEIF;
+        }
+
+        if (txfe_level(c, host_txf_used(c, 1), host_txf_depth(c, 1))) {
+            v |= GINTF_PTXFEIF;
+        }
+
+        if (hachint(c) & R(c, O_HACHINTEN)) {
+            v |= GINTF_HCIF;
+        }
+
+        if (R(c, O_HPCS) & (HPCS_PCD | HPCS_PEDC)) {
+            v |= GINTF_HPIF;
+        }
+    } else {
+        uint32_t d = daepint(c) & R(c, O_DAEPINTEN);
+
+        if (d & 0xFFFFU) {
+            v |= GINTF_IEPIF;
+        }
+
+        if (d >> 16) {
+            v |= GINTF_OEPIF;
+        }
+    }
+
+    return v;
+}
+
+/*!
+    \brief      pop a status entry, with the side effects of completion entries
+    \param[in]  c: core
+    \param[out] none
+    \retval     status word
+*/
+static uint32_t rx_pop_status (vcore *c)
+{
+    uint32_t stat, num, sts;
+
+    if (0U == c->rx.count) {
+        return 0U;
+    }
+
+    if (RXW_STAT != c->rx.tag[c->rx.head]) {
+        vbus_fail("%s: GRSTATP read with %s data words of the last packet unread",
+                  side_name[c - cores], "the");
+    }
+
+    stat = c->rx.w[c->rx.head];
+    c->rx.head = (c->rx.head + 1U) % RXQ_WORDS;
+    c->rx.count--;
+
+    num = stat & GRSTATRP_EPNUM;
+    sts = (stat & GRSTATRP_RPCKST) >> 17;
+
+    if (R(c, O_GUSBCS) & GUSBCS_FHM) {
+        if (GRXSTS_PKTSTS_IN_XFER_COMP == sts) {
+            R(c, HCH(num, O_INTF)) |= HCHINTF_TF;
+        }
+    } else {
+        if (RSTAT_XFER_COMP == sts) {
+            R(c, DOEP(num, O_INTF)) |= DOEPINTF_TF;
+            R(c, DOEP(num, O_CTL)) = (R(c, DOEP(num, O_CTL)) & ~DEPCTL_EPEN) | DEPCTL_NAKS;
+            c->out[num].ending = 0U;
+        } else if (RSTAT_SETUP_COMP == sts) {
+            R(c, DOEP(num, O_INTF)) |= DOEPINTF_STPF;
+            R(c, DOEP(num, O_CTL)) &= ~DEPCTL_EPEN;
+        } else {
+            /* no operation */
+        }
+    }
+
+    return stat;
+}
+
+/*!
+    \brief      pop a data word of the receive FIFO
+    \param[in]  c: core
+    \param[out] none
+    \retval     data word
+*/
+static uint32_t rx_pop_data (vcore *c)
+{
+    uint32_t w;
+
+    if ((0U == c->rx.count) || (RXW_DATA != c->rx.tag[c->rx.head])) {
+        vbus_fail("%s: receive FIFO read beyond the data of the packet", side_name[c - cores]);
+    }
+
+    w = c->rx.w[c->rx.head];
+    c->rx.head = (c->rx.head + 1U) % RXQ_WORDS;
+    c->rx.count--;
+
+    return w;
+}
+
+/*!
+    \brief      flush transmit FIFOs
+    \param[in]  c: core
+    \param[in]  num: FIFO number, 0x10 for all
+    \param[out] none
+    \retval     none
+*/
+static void txfifo_flush (vcore *c, uint32_t num)
+{
+    if (R(c, O_GUSBCS) & GUSBCS_FHM) {
+        for (uint32_t ch = 0U; ch < c->num_ch; ch++) {
+            if ((0x10U == num) || ((uint32_t)ch_periodic(c, ch) == num)) {
+                c->ch[ch].tx.count = 0U;
+            }
+        }
+    } else {
+        for (uint32_t i = 0U; i < MAX_FIFO; i++) {
+            if ((0x10U == num) || (i == num)) {
+                c->txf[i].count = 0U;
+            }
+        }
+    }
+}
+
+/*!
+    \brief      write to a data FIFO window
+    \param[in]  c: core
+    \param[in]  n: FIFO window
+    \param[in]  w: word
+    \param[out] none
+    \retval     none
+*/
+static void fifo_write (vcore *c, uint32_t n, uint32_t w)
+{
+    if (R(c, O_GUSBCS) & GUSBCS_FHM) {
+        int periodic;
+
+        if (n >= c->num_ch) {
+            vbus_fail("host: write to the FIFO of channel %u", n);
+        }
+
+        periodic = ch_periodic(c, n);
+        tx_push(c, &c->ch[n].tx, host_txf_used(c, periodic), host_txf_depth(c, periodic), w,
+                periodic ? "periodic Tx FIFO, channel" : "non-periodic Tx FIFO, channel", n);
+    } else {
+        if (n >= c->num_ep) {
+            vbus_fail("device: write to the FIFO of endpoint %u", n);
+        }
+
+        tx_push(c, &c->txf[n], c->txf[n].count, dev_txf_depth(c, n), w, "Tx FIFO", n);
+    }
+}
+
+/*!
+    \brief      write of a device endpoint control register
+    \param[in]  c: core
+    \param[in]  off: register offset
+    \param[in]  ep: endpoint
+    \param[in]  in: 1 for an IN endpoint
+    \param[in]  v: value written
+    \param[out] none
+    \retval     none
+*/
+static void depctl_write (vcore *c, uint32_t off, uint32_t ep, int in, uint32_t v)
+{
+    uint32_t old = R(c, off);
+    uint32_t nv = v & ~(DEPCTL_EPEN | DEPCTL_EPD | DEPCTL_SNAK | DEPCTL_CNAK | DEPCTL_SD0PID | DEPCTL_SD1PID |
+                        DEPCTL_NAKS | DEPCTL_DPID);
+    vep *e = in ? &c->in[ep] : &c->out[ep];
+
+    /* hardware bits */
+    nv |= old & (DEPCTL_EPEN | DEPCTL_NAKS | DEPCTL_DPID);
+
+    if (v & DEPCTL_EPEN) {
+        nv |= DEPCTL_EPEN;
+    }
+
+    if (v & DEPCTL_SNAK) {
+        nv |= DEPCTL_NAKS;
+    } else if (v & DEPCTL_CNAK) {
+        nv &= ~DEPCTL_NAKS;
+    } else {
+        /* no operation */
+    }
+
+    if ((v & DEPCTL_EPD) && (nv & DEPCTL_EPEN)) {
+        nv &= ~DEPCTL_EPEN;
+        R(c, off + O_INTF) |= DIEPINTF_EPDIS;
+    }
+
+    if (ep > 0U) {
+        if (v & DEPCTL_SD0PID) {
+            e->pid = 0U;
+        } else if (v & DEPCTL_SD1PID) {
+            e->pid = 1U;
+        } else {
+            /* no operation */
+        }
+    }
+
+    nv = (nv & ~DEPCTL_DPID) | (e->pid ? DEPCTL_DPID : 0U);
+
+    /* endpoint 0 is always active */
+    if (0U == ep) {
+        nv |= DEPCTL_EPACT;
+    }
+
+    R(c, off) = nv;
+}
+
+/*!
+    \brief      write of a host channel control register
+    \param[in]  c: core
+    \param[in]  ch: channel
+    \param[in]  v: value written
+    \param[out] none
+    \retval     none
+*/
+static void hchctl_write (vcore *c, uint32_t ch, uint32_t v)
+{
+    vchan *h = &c->ch[ch];
+
+    R(c, HCH(ch, O_CTL)) = v & ~(HCHCTL_CEN | HCHCTL_CDIS);
+
+    if (v & HCHCTL_CDIS) {
+        /* halt */
+        if (h->active) {
+            h->active = 0U;
+            h->paused = 0U;
+            h->done = 0U;
+            h->tx.count = 0U;
+            R(c, HCH(ch, O_INTF)) |= HCHINTF_CH;
+        }
+
+        return;
+    }
+
+    if (v & HCHCTL_CEN) {
+        /* a channel left enabled after its last packet takes the new transfer (interrupt pipes),
+           a write that keeps CEN set without a new packet count (ODDFRM) does not restart it */
+        if (h->done && (0U == (R(c, HCH(ch, O_LEN)) & HCHLEN_PCNT))) {
+            /* no operation */
+        } else if (!h->active || h->done) {
+            h->active = 1U;
+            h->paused = 0U;
+            h->done = 0U;
+            h->due = ((c->frame & 1U) == ((v & HCHCTL_ODDFRM) ? 1U : 0U));
+        } else {
+            h->paused = 0U;
+        }
+    }
+
+    if (h->active) {
+        R(c, HCH(ch, O_CTL)) |= HCHCTL_CEN;
+    }
+}
+
+/*!
+    \brief      write of the host port register
+    \param[in]  c: core
+    \param[in]  v: value written
+    \param[out] none
+    \retval     none
+*/
+static void hpcs_write (vcore *c, uint32_t v)
+{
+    uint32_t old = R(c, O_HPCS);
+    uint32_t nv = old;
+
+    /* write 1 to clear */
+    nv &= ~(v & (HPCS_PCD | HPCS_PEDC | BIT(5)));
+
+    /* write 1 to disable */
+    if ((v & HPCS_PE) && (old & HPCS_PE)) {
+        nv &= ~HPCS_PE;
+        nv |= HPCS_PEDC;
+    }
+
+    nv = (nv & ~(HPCS_PP | HPCS_PSP | HPCS_PREM)) | (v & (HPCS_PP | HPCS_PSP | HPCS_PREM));
+    R(c, O_HPCS) = nv;
+
+    if ((v ^ old) & HPCS_PP) {
+        vbus_port_update();
+    }
+
+    if ((v ^ old) & HPCS_PRST) {
+        if (v & HPCS_PRST) {
+            R(c, O_HPCS) |= HPCS_PRST;
+            (void)vbus_port_reset(1);
+        } else {
+            vbus_speed speed = vbus_port_reset(0);
+
+            nv = R(c, O_HPCS) & ~HPCS_PRST;
+
+            if (nv & HPCS_PCST) {
+                if (!(nv & HPCS_PE)) {
+                    nv |= HPCS_PE | HPCS_PEDC;
+                }
+
+                nv = (nv & ~HPCS_PS) | ((uint32_t)speed << 17);
+                c->speed = speed;
+            }
+
+            R(c, O_HPCS) = nv;
+        }
+    }
+}
+
+/*!
+    \brief      reset an emulated core
+    \param[in]  side: side of the core
+    \param[in]  hs_core: 1 for a USBHS core
+    \param[out] none
+    \retval     none
+*/
+void vcore_reset (uint8_t side, int hs_core)
+{
+    vcore *c = &cores[side];
+
+    memset(c, 0, sizeof(*c));
+    c->hs = hs_core;
+    c->num_ep = hs_core ? USBHS_MAX_EP_COUNT : USBFS_MAX_EP_COUNT;
+    c->num_ch = hs_core ? USBHS_MAX_CHANNEL_COUNT : USBFS_MAX_CHANNEL_COUNT;
+    c->speed = VBUS_SPEED_FULL;
+
+    R(c, O_CID) = hs_core ? 0x00001100U : 0x00001000U;
+    R(c, O_GRFLEN) = hs_core ? 0x200U : 0x80U;
+
+    for (uint32_t ep = 0U; ep < MAX_EP; ep++) {
+        R(c, DIEP(ep, O_CTL)) = (0U == ep) ? DEPCTL_EPACT : 0U;
+        R(c, DOEP(ep, O_CTL)) = (0U == ep) ? DEPCTL_EPACT : 0U;
+    }
+}
+
+/*!
+    \brief      register read
+    \param[in]  c: core
+    \param[in]  off: register offset
+    \param[in]  pop: 1 for the side effects of the read
+    \param[out] none
+    \retval     register value
+*/
+static uint32_t core_read (vcore *c, uint32_t off, int pop)
+{
+    uint32_t ep, reg;
+
+    if (off >= 0x1000U) {
+        if (!pop) {
+            return (c->rx.count && (RXW_DATA == c->rx.tag[c->rx.head])) ? c->rx.w[c->rx.head] : 0U;
+        }
+
+        return rx_pop_data(c);
+    }
+
+    switch (off) {
+    case O_GINTF:
+        return gintf_read(c);
+
+    case O_GRSTCTL:
+        return GRSTCTL_DMAIDL;
+
+    case O_GRSTATR:
+        return (c->rx.count && (RXW_STAT == c->rx.tag[c->rx.head])) ? c->rx.w[c->rx.head] : 0U;
+
+    case O_GRSTATP:
+        if (!pop) {
+            return (c->rx.count && (RXW_STAT == c->rx.tag[c->rx.head])) ? c->rx.w[c->rx.head] : 0U;
+        }
+
+        return rx_pop_status(c);
+
+    case O_HNPTFQSTAT:
+        return (R(c, O_GUSBCS) & GUSBCS_FHM) ? host_txq_stat(c, 0) : 0U;
+
+    case O_HPTFQSTAT:
+        return host_txq_stat(c, 1);
+
+    case O_HFINFR:
+        return c->frame & 0x3FFFU;
+
+    case O_HACHINT:
+        return hachint(c);
+
+    case O_DAEPINT:
+        return daepint(c);
+
+    default:
+        break;
+    }
+
+    if ((off >= O_DIEP) && (off < O_DIEP + MAX_EP * 0x20U)) {
+        ep = (off - O_DIEP) / 0x20U;
+        reg = (off - O_DIEP) % 0x20U;
+
+        if (O_INTF == reg) {
+            return diepintf(c, ep);
+        }
+
+        if (O_TFSTAT == reg) {
+            uint32_t depth = dev_txf_depth(c, ep);
+
+            return (c->txf[ep].count < depth) ? (depth - c->txf[ep].count) : 0U;
+        }
+    }
+
+    return R(c, off);
+}
+
+/*!
+    \brief      register read with side effects
+    \param[in]  side: side of the core
+    \param[in]  off: register offset
+    \param[out] none
+    \retval     register value
+*/
+uint32_t vcore_read (uint8_t side, uint32_t off)
+{
+    return core_read(&cores[side], off, 1);
+}
+
+/*!
+    \brief      register read without side effects
+    \param[in]  side: side of the core
+    \param[in]  off: register offset
+    \param[out] none
+    \retval     register value
+*/
+uint32_t vcore_peek (uint8_t side, uint32_t off)
+{
+    return core_read(&cores[side], off, 0);
+}
+
+/*!
+    \brief      register write
+    \param[in]  side: side of the core
+    \param[in]  off: register offset
+    \param[in]  val: value
+    \param[out] none
+    \retval     none
+*/
+void vcore_write (uint8_t side, uint32_t off, uint32_t val)
+{
+    vcore *c = &cores[side];
+    uint32_t old, n, reg;
+
+    if (off >= 0x1000U) {
+        fifo_write(c, (off - 0x1000U) / 0x1000U, val);
+        return;
+    }
+
+    switch (off) {
+    case O_GINTF:
+        c->gintf &= ~(val & GINTF_LATCHED);
+        return;
+
+    case O_GRSTCTL:
+        if (val & GRSTCTL_CSRST) {
+            c->gintf = 0U;
+            c->rx.count = 0U;
+            txfifo_flush(c, 0x10U);
+        }
+
+        if (val & GRSTCTL_TXFF) {
+            txfifo_flush(c, (val & GRSTCTL_TXFNUM) >> 6);
+        }
+
+        if (val & GRSTCTL_RXFF) {
+            c->rx.count = 0U;
+        }
+        return;
+
+    case O_GUSBCS:
+        R(c, off) = val;
+        vbus_port_update();
+        return;
+
+    case O_GRSTATR:
+    case O_GRSTATP:
+    case O_HNPTFQSTAT:
+    case O_HPTFQSTAT:
+    case O_HACHINT:
+    case O_DAEPINT:
+    case O_DSTAT:
+    case O_HFINFR:
+        return;
+
+    case O_HPCS:
+        hpcs_write(c, val);
+        return;
+
+    case O_DCTL:
+        old = R(c, off);
+        R(c, off) = val & ~(DCTL_SGINAK | DCTL_CGINAK | DCTL_SGONAK | DCTL_CGONAK | DCTL_GINS | DCTL_GONS);
+
+        if ((old ^ val) & DCTL_SD) {
+            vbus_port_update();
+        }
+        return;
+
+    case O_DCFG:
+        old = R(c, off);
+
+        if ((old ^ val) & DCFG_DAR) {
+            c->old_dar = (uint8_t)((old & DCFG_DAR) >> 4);
+            c->old_dar_valid = 1U;
+        }
+
+        R(c, off) = val;
+        return;
+
+    default:
+        break;
+    }
+
+    if ((off >= O_DIEP) && (off < O_DOEP + MAX_EP * 0x20U) && ((off < O_DIEP + MAX_EP * 0x20U) || (off >= O_DOEP))) {
+        int in = (off < O_DOEP);
+
+        n = (off - (in ? O_DIEP : O_DOEP)) / 0x20U;
+        reg = (off - (in ? O_DIEP : O_DOEP)) % 0x20U;
+
+        if (O_CTL == reg) {
+            depctl_write(c, off, n, in, val);
+            return;
+        }
+
+        if (O_INTF == reg) {
+            R(c, off) &= ~val;
+            return;
+        }
+
+        if (O_TFSTAT == reg) {
+            return;
+        }
+    }
+
+    if ((off >= O_HCH) && (off < O_HCH + MAX_CH * 0x20U)) {
+        n = (off - O_HCH) / 0x20U;
+        reg = (off - O_HCH) % 0x20U;
+
+        if (O_CTL == reg) {
+            hchctl_write(c, n, val);
+            return;
+        }
+
+        if (O_INTF == reg) {
+            R(c, off) &= ~val;
+            return;
+        }
+    }
+
+    R(c, off) = val;
+}
+
+/*!
+    \brief      interrupt line of a core
+    \param[in]  side: side of the core
+    \param[out] none
+    \retval     1 when an enabled interrupt is pending
+*/
+int vcore_irq (uint8_t side)
+{
+    vcore *c = &cores[side];
+
+    if (!(R(c, O_GAHBCS) & GAHBCS_GINTEN)) {
+        return 0;
+    }
+
+    return 0U != (gintf_read(c) & R(c, O_GINTEN));
+}
+
+/* ----- device side ----- */
+
+/*!
+    \brief      check the address of a token
+    \param[in]  c: core
+    \param[in]  addr: address of the token
+    \param[out] none
+    \retval     1 when the device answers
+*/
+static int dev_addr_match (vcore *c, uint8_t addr)
+{
+    uint8_t dar = (uint8_t)((R(c, O_DCFG) & DCFG_DAR) >> 4);
+
+    if (addr == dar) {
+        c->old_dar_valid = 0U;
+        return 1;
+    }
+
+    /* the address is set before the status stage of SET_ADDRESS completes */
+    return c->old_dar_valid && (addr == c->old_dar);
+}
+
+/*!
+    \brief      maximum packet length of a device endpoint
+    \param[in]  c: core
+    \param[in]  ep: endpoint
+    \param[in]  in: 1 for IN
+    \param[out] none
+    \retval     bytes
+*/
+static uint32_t dev_mps (vcore *c, uint32_t ep, int in)
+{
+    static const uint32_t ep0_mps[4] = {64U, 32U, 16U, 8U};
+
+    if (0U == ep) {
+        return ep0_mps[R(c, DIEP(0U, O_CTL)) & DEP0CTL_MPL];
+    }
+
+    return R(c, in ? DIEP(ep, O_CTL) : DOEP(ep, O_CTL)) & DEPCTL_MPL;
+}
+
+static int dev_connected (vbus_func *f)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+
+    return (0U != (R(c, O_GUSBCS) & GUSBCS_FDM)) && (0U == (R(c, O_DCTL) & DCTL_SD));
+}
+
+static int dev_hs_capable (vbus_func *f)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+
+    return c->hs && (0U == (R(c, O_DCFG) & DCFG_DS));
+}
+
+static void dev_reset (vbus_func *f, int assert, vbus_speed speed)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+
+    if (assert) {
+        c->gintf |= GINTF_RST;
+        c->old_dar_valid = 0U;
+
+        for (uint32_t ep = 0U; ep < c->num_ep; ep++) {
+            R(c, DOEP(ep, O_CTL)) |= DEPCTL_NAKS;
+            c->in[ep].pid = 0U;
+            c->out[ep].pid = 0U;
+            c->out[ep].ending = 0U;
+        }
+    } else {
+        uint32_t es;
+
+        if (VBUS_SPEED_HIGH == speed) {
+            es = DSTAT_EM_HS_PHY_30MHZ_60MHZ;
+        } else if (VBUS_SPEED_LOW == speed) {
+            es = DSTAT_EM_LS_PHY_6MHZ;
+        } else {
+            es = c->hs ? DSTAT_EM_FS_PHY_30MHZ_60MHZ : DSTAT_EM_FS_PHY_48MHZ;
+        }
+
+        c->speed = speed;
+        R(c, O_DSTAT) = (R(c, O_DSTAT) & ~DSTAT_ES) | (es << 1);
+        c->gintf |= GINTF_ENUMFIF;
+    }
+}
+
+static void dev_sof (vbus_func *f, uint32_t frame)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+
+    c->frame = frame;
+    R(c, O_DSTAT) = (R(c, O_DSTAT) & ~DSTAT_FNRSOF) | ((frame & 0x3FFFU) << 8);
+    c->gintf |= GINTF_SOF;
+}
+
+static vbus_resp dev_setup (vbus_func *f, uint8_t addr, const uint8_t *data)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+    uint32_t len;
+
+    if (!dev_addr_match(c, addr)) {
+        return VBUS_NORESP;
+    }
+
+    if (rx_free(c) < 4U) {
+        return VBUS_NORESP;
+    }
+
+    rx_push_packet(c, 0U | (8U << 4) | ((uint32_t)RSTAT_SETUP_UPDT << 17), data, 8U);
+    rx_push(c, 0U | ((uint32_t)RSTAT_SETUP_COMP << 17), RXW_STAT);
+
+    len = R(c, DOEP(0U, O_LEN));
+    if (len & DOEP0LEN_STPCNT) {
+        len -= 1U << 29;
+    }
+    R(c, DOEP(0U, O_LEN)) = len;
+
+    R(c, DIEP(0U, O_CTL)) = (R(c, DIEP(0U, O_CTL)) & ~DEPCTL_STALL) | DEPCTL_NAKS;
+    R(c, DOEP(0U, O_CTL)) = (R(c, DOEP(0U, O_CTL)) & ~DEPCTL_STALL) | DEPCTL_NAKS;
+    c->in[0].pid = 1U;
+    c->out[0].pid = 1U;
+    c->out[0].ending = 0U;
+
+    return VBUS_ACK;
+}
+
+static vbus_resp dev_out (vbus_func *f, uint8_t addr, uint8_t ep, const uint8_t *data, uint32_t len, uint8_t pid)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+    uint32_t ctl, eplen, pcnt, tlen, mps;
+    vep *e;
+
+    if (!dev_addr_match(c, addr) || (ep >= c->num_ep)) {
+        return VBUS_NORESP;
+    }
+
+    e = &c->out[ep];
+    ctl = R(c, DOEP(ep, O_CTL));
+    mps = dev_mps(c, ep, 0);
+
+    if (ctl & DEPCTL_STALL) {
+        return VBUS_STALL;
+    }
+
+    if (len > mps) {
+        return VBUS_NORESP;
+    }
+
+    eplen = R(c, DOEP(ep, O_LEN));
+    pcnt = (eplen & DEPLEN_PCNT) >> 19;
+    tlen = eplen & DEPLEN_TLEN;
+
+    if (!(ctl & DEPCTL_EPEN) || (ctl & DEPCTL_NAKS) || e->ending || (0U == pcnt)) {
+        return VBUS_NAK;
+    }
+
+    /* status, data and the completion entry */
+    if (rx_free(c) < 2U + (len + 3U) / 4U) {
+        return VBUS_NAK;
+    }
+
+    if (pid != e->pid) {
+        /* retransmission of a packet already received */
+        return VBUS_ACK;
+    }
+
+    rx_push_packet(c, ep | (len << 4) | ((pid ? (uint32_t)DPID_DATA1 : (uint32_t)DPID_DATA0) << 15) |
+                   ((uint32_t)RSTAT_DATA_UPDT << 17), data, len);
+    e->pid ^= 1U;
+
+    pcnt--;
+    tlen = (tlen > len) ? (tlen - len) : 0U;
+    R(c, DOEP(ep, O_LEN)) = (eplen & ~(DEPLEN_PCNT | DEPLEN_TLEN)) | (pcnt << 19) | tlen;
+
+    if ((0U == pcnt) || (len < mps)) {
+        rx_push(c, ep | ((uint32_t)RSTAT_XFER_COMP << 17), RXW_STAT);
+        e->ending = 1U;
+    }
+
+    if ((VBUS_SPEED_HIGH == c->speed) && (rx_free(c) < 2U + (mps + 3U) / 4U)) {
+        return VBUS_NYET;
+    }
+
+    return VBUS_ACK;
+}
+
+static vbus_resp dev_ping (vbus_func *f, uint8_t addr, uint8_t ep)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+    uint32_t ctl;
+
+    if (!dev_addr_match(c, addr) || (ep >= c->num_ep)) {
+        return VBUS_NORESP;
+    }
+
+    ctl = R(c, DOEP(ep, O_CTL));
+
+    if (ctl & DEPCTL_STALL) {
+        return VBUS_STALL;
+    }
+
+    if (!(ctl & DEPCTL_EPEN) || (ctl & DEPCTL_NAKS) || c->out[ep].ending ||
+        (rx_free(c) < 2U + (dev_mps(c, ep, 0) + 3U) / 4U)) {
+        return VBUS_NAK;
+    }
+
+    return VBUS_ACK;
+}
+
+static vbus_resp dev_in (vbus_func *f, uint8_t addr, uint8_t ep, uint8_t *data, uint32_t *len, uint8_t *pid)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+    uint32_t ctl, eplen, pcnt, tlen, pkt;
+
+    if (!dev_addr_match(c, addr) || (ep >= c->num_ep)) {
+        return VBUS_NORESP;
+    }
+
+    ctl = R(c, DIEP(ep, O_CTL));
+
+    if (ctl & DEPCTL_STALL) {
+        return VBUS_STALL;
+    }
+
+    eplen = R(c, DIEP(ep, O_LEN));
+    pcnt = (eplen & DEPLEN_PCNT) >> 19;
+    tlen = eplen & DEPLEN_TLEN;
+
+    if (!(ctl & DEPCTL_EPEN) || (ctl & DEPCTL_NAKS) || (0U == pcnt)) {
+        return VBUS_NAK;
+    }
+
+    pkt = dev_mps(c, ep, 1);
+    if (tlen < pkt) {
+        pkt = tlen;
+    }
+
+    /* FIFO underrun, the packet is not complete yet */
+    if (c->txf[ep].count < (pkt + 3U) / 4U) {
+        return VBUS_NAK;
+    }
+
+    tx_peek(&c->txf[ep], data, pkt);
+    *len = pkt;
+    *pid = c->in[ep].pid;
+
+    return VBUS_DATA;
+}
+
+static void dev_in_ack (vbus_func *f, uint8_t addr, uint8_t ep)
+{
+    vcore *c = &cores[VBUS_DEVICE];
+    uint32_t eplen = R(c, DIEP(ep, O_LEN));
+    uint32_t pcnt = (eplen & DEPLEN_PCNT) >> 19, tlen = eplen & DEPLEN_TLEN;
+    uint32_t pkt = dev_mps(c, ep, 1);
+
+    if (tlen < pkt) {
+        pkt = tlen;
+    }
+
+    for (uint32_t i = 0U; i < (pkt + 3U) / 4U; i++) {
+        (void)tx_pop(&c->txf[ep]);
+    }
+
+    c->in[ep].pid ^= 1U;
+    R(c, DIEP(ep, O_CTL)) = (R(c, DIEP(ep, O_CTL)) & ~DEPCTL_DPID) | (c->in[ep].pid ? DEPCTL_DPID : 0U);
+
+    pcnt--;
+    tlen -= pkt;
+    R(c, DIEP(ep, O_LEN)) = (eplen & ~(DEPLEN_PCNT | DEPLEN_TLEN)) | (pcnt << 19) | tlen;
+
+    if (0U == pcnt) {
+        R(c, DIEP(ep, O_CTL)) &= ~DEPCTL_EPEN;
+        R(c, DIEP(ep, O_INTF)) |= DIEPINTF_TF;
+    }
+}
+
+static vbus_func dev_func =
+{
+    dev_connected,
+    dev_hs_capable,
+    dev_reset,
+    dev_sof,
+    dev_setup,
+    dev_out,
+    dev_ping,
+    dev_in,
+    dev_in_ack,
+    NULL
+};
+
+/*!
+    \brief      the device core as a function on the bus
+    \param[in]  none
+    \param[out] none
+    \retval     function
+*/
+vbus_func *vcore_func (void)
+{
+    return &dev_func;
+}
+
+/* ----- host side ----- */
+
+/*!
+    \brief      connection change seen by the host port
+    \param[in]  connected: 1 when a function is attached and the port powered
+    \param[out] none
+    \retval     none
+*/
+void vcore_port_connect (int connected)
+{
+    vcore *c = &cores[VBUS_HOST];
+    uint32_t v = R(c, O_HPCS);
+
+    if (connected) {
+        v |= HPCS_PCST | HPCS_PCD;
+    } else {
+        if (v & HPCS_PE) {
+            v |= HPCS_PEDC;
+        }
+
+        v &= ~(HPCS_PCST | HPCS_PE);
+        c->gintf |= GINTF_DISCIF;
+    }
+
+    R(c, O_HPCS) = v;
+}
+
+/*!
+    \brief      speed of the enabled host port
+    \param[in]  none
+    \param[out] none
+    \retval     speed
+*/
+vbus_speed vcore_port_speed (void)
+{
+    return cores[VBUS_HOST].speed;
+}
+
+/*!
+    \brief      start of a (micro)frame on the host side
+    \param[in]  none
+    \param[out] none
+    \retval     1 when the port is enabled and a SOF is sent
+*/
+int vcore_host_sof (void)
+{
+    vcore *c = &cores[VBUS_HOST];
+
+    if (!(R(c, O_HPCS) & HPCS_PE) || (R(c, O_HPCS) & HPCS_PSP)) {
+        return 0;
+    }
+
+    c->frame = (c->frame + 1U) & 0x3FFFU;
+    c->gintf |= GINTF_SOF;
+
+    for (uint32_t ch = 0U; ch < c->num_ch; ch++) {
+        uint32_t odd = (R(c, HCH(ch, O_CTL)) & HCHCTL_ODDFRM) ? 1U : 0U;
+
+        c->ch[ch].due = ((c->frame & 1U) == odd);
+    }
+
+    return 1;
+}
+
+/*!
+    \brief      pause or finish a host channel after a transaction
+    \param[in]  c: core
+    \param[in]  ch: channel
+    \param[in]  flags: HCHINTF flags to set
+    \param[out] none
+    \retval     none
+*/
+static void ch_pause (vcore *c, uint32_t ch, uint32_t flags)
+{
+    c->ch[ch].paused = 1U;
+    R(c, HCH(ch, O_INTF)) |= flags;
+}
+
+/*!
+    \brief      run a transaction of a host channel
+    \param[in]  c: core
+    \param[in]  ch: channel
+    \param[in]  left: time left in the frame
+    \param[out] none
+    \retval     duration in ns, 0 when the channel cannot run now
+*/
+static uint32_t ch_xact (vcore *c, uint32_t ch, uint64_t left)
+{
+    vchan *h = &c->ch[ch];
+    uint32_t ctl = R(c, HCH(ch, O_CTL)), len = R(c, HCH(ch, O_LEN));
+    uint8_t addr = (uint8_t)((ctl & HCHCTL_DAR) >> 22), ep = (uint8_t)((ctl & HCHCTL_EPNUM) >> 11);
+    uint32_t mps = ctl & HCHCTL_MPL;
+    uint32_t pcnt = (len & HCHLEN_PCNT) >> 19, tlen = len & HCHLEN_TLEN, dpid = (len & HCHLEN_DPID) >> 29;
+    vbus_speed sp = (ctl & HCHCTL_LSD) ? VBUS_SPEED_LOW : c->speed;
+    uint8_t buf[1024];
+    uint32_t t, n = 0U;
+    uint8_t pid = 0U;
+    vbus_resp resp;
+
+    if (mps > sizeof(buf)) {
+        vbus_fail("host: channel %u maximum packet length %u", ch, mps);
+    }
+
+    if (ctl & HCHCTL_EPDIR) {
+        if (rx_free(c) < 2U + (mps + 3U) / 4U) {
+            return 0U;
+        }
+
+        if (vbus_xact_ns(sp, VBUS_XACT_IN, mps) > left) {
+            return 0U;
+        }
+
+        resp = vbus_xact_in(addr, ep, buf, &n, &pid);
+
+        switch (resp) {
+        case VBUS_DATA:
+            t = vbus_xact_ns(sp, VBUS_XACT_IN, n);
+            vbus_xact_in_ack(addr, ep);
+
+            if (pid != ((DPID_DATA1 == dpid) ? 1U : 0U)) {
+                ch_pause(c, ch, HCHINTF_DTER | HCHINTF_ACK);
+                break;
+            }
+
+            rx_push_packet(c, ch | (n << 4) | (dpid << 15) | ((uint32_t)GRXSTS_PKTSTS_IN << 17), buf, n);
+
+            pcnt = pcnt ? pcnt - 1U : 0U;
+            tlen = (tlen > n) ? (tlen - n) : 0U;
+            dpid = (DPID_DATA1 == dpid) ? DPID_DATA0 : DPID_DATA1;
+            R(c, HCH(ch, O_LEN)) = (len & HCHLEN_PING) | (dpid << 29) | (pcnt << 19) | tlen;
+            R(c, HCH(ch, O_INTF)) |= HCHINTF_ACK;
+
+            if ((0U == pcnt) || (n < mps)) {
+                rx_push(c, ch | ((uint32_t)GRXSTS_PKTSTS_IN_XFER_COMP << 17), RXW_STAT);
+                h->done = 1U;
+            } else {
+                h->paused = 1U;
+            }
+            break;
+
+        case VBUS_BABBLE:
+            t = vbus_xact_ns(sp, VBUS_XACT_IN, mps);
+            ch_pause(c, ch, HCHINTF_BBER);
+            break;
+
+        case VBUS_NAK:
+            t = vbus_xact_ns(sp, VBUS_XACT_IN_NAK, 0U);
+            ch_pause(c, ch, HCHINTF_NAK);
+            break;
+
+        case VBUS_STALL:
+            t = vbus_xact_ns(sp, VBUS_XACT_IN_NAK, 0U);
+            ch_pause(c, ch, HCHINTF_STALL);
+            break;
+
+        default:
+            t = vbus_xact_ns(sp, VBUS_XACT_IN_NAK, 0U);
+            ch_pause(c, ch, HCHINTF_USBER);
+            break;
+        }
+    } else if ((len & HCHLEN_PING) && (VBUS_SPEED_HIGH == sp)) {
+        t = vbus_xact_ns(sp, VBUS_XACT_PING, 0U);
+
+        if (t > left) {
+            return 0U;
+        }
+
+        resp = vbus_xact_ping(addr, ep);
+
+        if (VBUS_ACK == resp) {
+            R(c, HCH(ch, O_LEN)) = len & ~HCHLEN_PING;
+            ch_pause(c, ch, HCHINTF_ACK);
+        } else if (VBUS_NAK == resp) {
+            ch_pause(c, ch, HCHINTF_NAK);
+        } else if (VBUS_STALL == resp) {
+            ch_pause(c, ch, HCHINTF_STALL);
+        } else {
+            ch_pause(c, ch, HCHINTF_USBER);
+        }
+    } else {
+        uint32_t pkt = (tlen < mps) ? tlen : mps;
+        int setup = (3U == dpid);
+
+        if (h->tx.count < (pkt + 3U) / 4U) {
+            return 0U;
+        }
+
+        t = vbus_xact_ns(sp, setup ? VBUS_XACT_SETUP : VBUS_XACT_OUT, pkt);
+
+        if (t > left) {
+            return 0U;
+        }
+
+        tx_peek(&h->tx, buf, pkt);
+
+        if (setup) {
+            resp = (8U == pkt) ? vbus_xact_setup(addr, buf) : VBUS_NORESP;
+        } else {
+            resp = vbus_xact_out(addr, ep, buf, pkt, (DPID_DATA1 == dpid) ? 1U : 0U);
+        }
+
+        switch (resp) {
+        case VBUS_ACK:
+        case VBUS_NYET:
+            for (uint32_t i = 0U; i < (pkt + 3U) / 4U; i++) {
+                (void)tx_pop(&h->tx);
+            }
+
+            pcnt = pcnt ? pcnt - 1U : 0U;
+            tlen -= pkt;
+
+            if (!setup) {
+                dpid = (DPID_DATA1 == dpid) ? DPID_DATA0 : DPID_DATA1;
+            }
+
+            R(c, HCH(ch, O_LEN)) = (len & HCHLEN_PING) | (dpid << 29) | (pcnt << 19) | tlen;
+            R(c, HCH(ch, O_INTF)) |= HCHINTF_ACK | ((VBUS_NYET == resp) ? HCHINTF_NYET : 0U);
+
+            if (0U == pcnt) {
+                R(c, HCH(ch, O_INTF)) |= HCHINTF_TF;
+                h->done = 1U;
+            }
+            break;
+
+        case VBUS_NAK:
+            ch_pause(c, ch, HCHINTF_NAK);
+            break;
+
+        case VBUS_STALL:
+            ch_pause(c, ch, HCHINTF_STALL);
+            break;
+
+        default:
+            ch_pause(c, ch, HCHINTF_USBER);
+            break;
+        }
+    }
+
+    if (ch_periodic(c, ch)) {
+        h->due = 0U;
+    }
+
+    return t;
+}
+
+/*!
+    \brief      run the next transaction of the host channels that fits the time left
+    \param[in]  left_ns: time left in the (micro)frame
+    \param[out] none
+    \retval     duration in ns, 0 when no channel can run
+*/
+uint32_t vcore_host_xact (uint64_t left_ns)
+{
+    vcore *c = &cores[VBUS_HOST];
+    uint32_t t;
+
+    if (!(R(c, O_HPCS) & HPCS_PE)) {
+        return 0U;
+    }
+
+    /* periodic channels first, then the others in turn */
+    for (int periodic = 1; periodic >= 0; periodic--) {
+        for (uint32_t k = 0U; k < c->num_ch; k++) {
+            uint32_t ch = periodic ? k : (c->rr + k) % c->num_ch;
+            vchan *h = &c->ch[ch];
+
+            if (!h->active || h->paused || h->done || (ch_periodic(c, ch) != periodic)) {
+                continue;
+            }
+
+            if (periodic && !h->due) {
+                continue;
+            }
+
+            t = ch_xact(c, ch, left_ns);
+
+            if (t) {
+                if (!periodic) {
+                    c->rr = (uint8_t)((ch + 1U) % c->num_ch);
+                }
+
+                return t;
+            }
+        }
+    }
+
+    return 0U;
+}
+
+/*!
+    \brief      dump the state of a core to stderr
+    \param[in]  side: side of the core
+    \param[out] none
+    \retval     none
+*/
+void vcore_dump (uint8_t side)
+{
+    vcore *c = &cores[side];
+
+    fprintf(stderr, "%s core: GINTF %08x GINTEN %08x GAHBCS %08x rx words %u\n", side_name[side],
+            gintf_read(c), R(c, O_GINTEN), R(c, O_GAHBCS), c->rx.count);
+
+    if (R(c, O_GUSBCS) & GUSBCS_FHM) {
+        fprintf(stderr, "  HPCS %08x HACHINT %08x HACHINTEN %08x\n", R(c, O_HPCS), hachint(c), R(c, O_HACHINTEN));
+
+        for (uint32_t ch = 0U; ch < c->num_ch; ch++) {
+            vchan *h = &c->ch[ch];
+
+            if (h->active || R(c, HCH(ch, O_INTF))) {
+                fprintf(stderr, "  ch%u CTL %08x INTF %08x INTEN %08x LEN %08x%s%s%s tx %u\n", ch,
+                        R(c, HCH(ch, O_CTL)), R(c, HCH(ch, O_INTF)), R(c, HCH(ch, O_INTEN)), R(c, HCH(ch, O_LEN)),
+                        h->active ? " active" : "", h->paused ? " paused" : "", h->done ? " done" : "", h->tx.count);
+            }
+        }
+    } else {
+        fprintf(stderr, "  DCFG %08x DCTL %08x DAEPINT %08x DAEPINTEN %08x DIEPFEINTEN %08x\n",
+                R(c, O_DCFG), R(c, O_DCTL), daepint(c), R(c, O_DAEPINTEN), R(c, O_DIEPFEINTEN));
+
+        for (uint32_t ep = 0U; ep < c->num_ep; ep++) {
+            fprintf(stderr, "  ep%u IN CTL %08x INTF %08x LEN %08x tx %u  OUT CTL %08x INTF %08x LEN %08x\n", ep,
+                    R(c, DIEP(ep, O_CTL)), diepintf(c, ep), R(c, DIEP(ep, O_LEN)), c->txf[ep].count,
+                    R(c, DOEP(ep, O_CTL)), R(c, DOEP(ep, O_INTF)), R(c, DOEP(ep, O_LEN)));
+        }
+    }
+}
@@ -0,0 +1,1068 @@
+/*!
+    \file    vbus_model.c
+    \brief   functions on the virtual bus without a device core: a hub and
+             mass storage sticks
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+/*
+    The models answer the tokens of the bus at once, without a CPU: they
+    stand for devices whose firmware is not under test. Each has the
+    default control pipe (standard requests, its class requests) and the
+    data toggles of its endpoints; a packet sent again after a lost
+    handshake is acknowledged and dropped as a device core does.
+
+    The hub has one status change endpoint and up to VMODEL_HUB_PORTS
+    downstream ports, each with a function on it: a model or the device
+    core. It follows chapter 11 of the USB 2.0 specification where the hub
+    class driver depends on it: port power, connection and its change,
+    reset (10 ms counted in SOFs) and enable, and the change bitmap on the
+    interrupt endpoint. The tokens for other addresses are repeated on the
+    enabled ports, which forward the SOFs as well. A high-speed hub does
+    not translate: a full-speed function behind it is reset to full speed
+    and reported so, but it gets no tokens (no split transactions).
+
+    The stick serves the bulk-only transport on a RAM disk of 512 byte
+    blocks with the SCSI commands of the host class; any other command is
+    a fault of the bench.
+*/
+
+#include <string.h>
+#include "vbus.h"
+
+#define VMODEL_HUB_PORTS            4U
+#define VMODEL_MSC_NUM              4U
+#define VMODEL_EPS                  4U
+#define VMODEL_EP0_MPS              64U
+
+#define BLOCK_SIZE                  512U
+#define CBW_LEN                     31U
+#define CSW_LEN                     13U
+#define CBW_SIGNATURE               0x43425355U
+#define CSW_SIGNATURE               0x53425355U
+
+/* control transfer stages */
+#define CTL_IDLE                    0U
+#define CTL_DATA_IN                 1U
+#define CTL_DATA_OUT                2U
+#define CTL_STATUS_IN               3U
+#define CTL_STATUS_OUT              4U
+#define CTL_STALL                   5U
+
+/* port status and change bits */
+#define PS_CONNECTION               0x0001U
+#define PS_ENABLE                   0x0002U
+#define PS_RESET                    0x0010U
+#define PS_POWER                    0x0100U
+#define PS_HIGH_SPEED               0x0400U
+#define PC_CONNECTION               0x0001U
+#define PC_RESET                    0x0010U
+
+/* a function with its default control pipe */
+typedef struct _vfunc
+{
+    vbus_func   func;
+    int         hs;                                 /*!< high-speed capable */
+    vbus_speed  speed;
+    uint8_t     addr;
+    uint8_t     new_addr;
+    uint8_t     set_addr;                           /*!< SET_ADDRESS waits for its status stage */
+    uint8_t     config;
+    uint8_t     dev_desc[18];
+    uint8_t     cfg_desc[64];
+    uint32_t    cfg_len;
+
+    uint8_t     req[8];
+    uint8_t     ctl_buf[64];
+    uint32_t    ctl_len;
+    uint32_t    ctl_pos;
+    uint32_t    ctl_stage;
+
+    uint8_t     in_pid[VMODEL_EPS];
+    uint8_t     out_pid[VMODEL_EPS];
+    uint8_t     halt[2][VMODEL_EPS];                /*!< OUT and IN endpoints halted */
+    uint32_t    in_len;                             /*!< length of the IN packet waiting for its handshake */
+
+    int       (*class_req) (struct _vfunc *v, const uint8_t *req, uint8_t *buf, uint32_t *len);
+    void      (*bus_reset) (struct _vfunc *v);
+    vbus_resp (*ep_out)    (struct _vfunc *v, uint8_t ep, const uint8_t *data, uint32_t len);
+    vbus_resp (*ep_in)     (struct _vfunc *v, uint8_t ep, uint8_t *data, uint32_t *len);
+    void      (*ep_in_ack) (struct _vfunc *v, uint8_t ep, uint32_t len);
+} vfunc;
+
+/* the hub */
+typedef struct
+{
+    vfunc       v;
+    uint8_t     ports;
+    vbus_func  *port_func[VMODEL_HUB_PORTS];
+    uint16_t    status[VMODEL_HUB_PORTS];
+    uint16_t    change[VMODEL_HUB_PORTS];
+    uint32_t    reset_left[VMODEL_HUB_PORTS];       /*!< SOFs until the end of the port reset */
+    int         in_port;                            /*!< port that answered the last IN token */
+} vhub;
+
+/* a mass storage stick */
+typedef struct
+{
+    vfunc       v;
+    uint8_t    *disk;
+    uint32_t    blocks;
+    uint32_t    state;
+    uint32_t    tag;
+    uint32_t    residue;
+    uint8_t     status;
+    uint8_t    *data;                               /*!< data of the data stage */
+    uint32_t    data_len;
+    uint32_t    data_pos;
+    uint8_t     reply[36];
+    uint8_t     csw[CSW_LEN];
+} vmsc;
+
+#define MSC_CBW                     0U
+#define MSC_DATA_IN                 1U
+#define MSC_DATA_OUT                2U
+#define MSC_CSW                     3U
+
+static vhub hub;
+static vmsc msc[VMODEL_MSC_NUM];
+
+static void put16 (uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put32 (uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+static void put32_be (uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)(v >> 24);
+    p[1] = (uint8_t)(v >> 16);
+    p[2] = (uint8_t)(v >> 8);
+    p[3] = (uint8_t)v;
+}
+
+static uint32_t get32 (const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t get32_be (const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+/* ----- function with a default control pipe ----- */
+
+/*!
+    \brief      set up the descriptors of a function
+    \param[in]  v: function
+    \param[in]  dev_class: class of the device, 0 for the interface
+    \param[in]  dev_protocol: protocol of the device
+    \param[in]  pid: product ID
+    \param[in]  itf: class, subclass and protocol of the interface
+    \param[in]  ep: endpoint descriptors, 7 bytes each
+    \param[in]  ep_num: number of endpoints
+    \param[out] none
+    \retval     none
+*/
+static void vf_desc (vfunc *v, uint8_t dev_class, uint8_t dev_protocol, uint16_t pid, const uint8_t *itf,
+                     const uint8_t *ep, uint8_t ep_num)
+{
+    static const uint8_t dev[18] = {18U, 1U, 0x00U, 0x02U, 0U, 0U, 0U, VMODEL_EP0_MPS, 0xE9U, 0x28U, 0U, 0U,
+                                    0x00U, 0x01U, 0U, 0U, 0U, 1U};
+    uint8_t *c = v->cfg_desc;
+
+    memcpy(v->dev_desc, dev, sizeof(dev));
+    v->dev_desc[4] = dev_class;
+    v->dev_desc[6] = dev_protocol;
+    put16(&v->dev_desc[10], pid);
+
+    v->cfg_len = 9U + 9U + 7U * ep_num;
+
+    c[0] = 9U;
+    c[1] = 2U;
+    put16(&c[2], v->cfg_len);
+    c[4] = 1U;
+    c[5] = 1U;
+    c[6] = 0U;
+    c[7] = 0xC0U;
+    c[8] = 50U;
+
+    c += 9;
+    c[0] = 9U;
+    c[1] = 4U;
+    c[2] = 0U;
+    c[3] = 0U;
+    c[4] = ep_num;
+    c[5] = itf[0];
+    c[6] = itf[1];
+    c[7] = itf[2];
+    c[8] = 0U;
+
+    c += 9;
+    memcpy(c, ep, 7U * ep_num);
+}
+
+static void vf_reset (vbus_func *f, int assert, vbus_speed speed)
+{
+    vfunc *v = (vfunc *)f->priv;
+
+    v->addr = 0U;
+    v->set_addr = 0U;
+    v->config = 0U;
+    v->ctl_stage = CTL_IDLE;
+    v->speed = speed;
+
+    memset(v->in_pid, 0, sizeof(v->in_pid));
+    memset(v->out_pid, 0, sizeof(v->out_pid));
+    memset(v->halt, 0, sizeof(v->halt));
+
+    if (!assert && v->bus_reset) {
+        v->bus_reset(v);
+    }
+}
+
+static int vf_connected (vbus_func *f)
+{
+    return 1;
+}
+
+static int vf_hs_capable (vbus_func *f)
+{
+    return ((vfunc *)f->priv)->hs;
+}
+
+/*!
+    \brief      standard requests of the default control pipe
+    \param[in]  v: function
+    \param[in]  req: request
+    \param[out] buf: data of an IN request
+    \param[out] len: length of the data
+    \retval     0 when served, -1 to stall
+*/
+static int vf_std_req (vfunc *v, const uint8_t *req, uint8_t *buf, uint32_t *len)
+{
+    uint16_t value = (uint16_t)(req[2] | (req[3] << 8)), index = (uint16_t)(req[4] | (req[5] << 8));
+
+    switch (req[1]) {
+    case 0x00U:                                     /* GET_STATUS */
+        memset(buf, 0, 2U);
+        *len = 2U;
+        return 0;
+
+    case 0x01U:                                     /* CLEAR_FEATURE(ENDPOINT_HALT) */
+        if ((0x02U == (req[0] & 0x1FU)) && ((index & 0x0FU) < VMODEL_EPS)) {
+            v->halt[(index & 0x80U) ? 1 : 0][index & 0x0FU] = 0U;
+
+            if (index & 0x80U) {
+                v->in_pid[index & 0x0FU] = 0U;
+            } else {
+                v->out_pid[index & 0x0FU] = 0U;
+            }
+        }
+        return 0;
+
+    case 0x05U:                                     /* SET_ADDRESS */
+        v->new_addr = (uint8_t)(value & 0x7FU);
+        v->set_addr = 1U;
+        return 0;
+
+    case 0x06U:                                     /* GET_DESCRIPTOR */
+        if (1U == (value >> 8)) {
+            memcpy(buf, v->dev_desc, sizeof(v->dev_desc));
+            *len = sizeof(v->dev_desc);
+            return 0;
+        }
+
+        if (2U == (value >> 8)) {
+            memcpy(buf, v->cfg_desc, v->cfg_len);
+            *len = v->cfg_len;
+
+            /* bulk endpoints take 64 byte packets at full speed */
+            for (uint32_t k = 18U; k < v->cfg_len; k += 7U) {
+                if ((0x02U == buf[k + 3U]) && (VBUS_SPEED_HIGH != v->speed)) {
+                    put16(&buf[k + 4U], 64U);
+                }
+            }
+            return 0;
+        }
+
+        /* no strings, no device qualifier */
+        return -1;
+
+    case 0x08U:                                     /* GET_CONFIGURATION */
+        buf[0] = v->config;
+        *len = 1U;
+        return 0;
+
+    case 0x09U:                                     /* SET_CONFIGURATION */
+        v->config = (uint8_t)value;
+        memset(&v->in_pid[1], 0, VMODEL_EPS - 1U);
+        memset(&v->out_pid[1], 0, VMODEL_EPS - 1U);
+        return 0;
+
+    case 0x0BU:                                     /* SET_INTERFACE */
+        return 0;
+
+    default:
+        return -1;
+    }
+}
+
+static vbus_resp vf_setup (vbus_func *f, uint8_t addr, const uint8_t *data)
+{
+    vfunc *v = (vfunc *)f->priv;
+    uint32_t wlength = (uint32_t)data[6] | ((uint32_t)data[7] << 8);
+    int rc;
+
+    if (addr != v->addr) {
+        return VBUS_NORESP;
+    }
+
+    memcpy(v->req, data, sizeof(v->req));
+    v->in_pid[0] = 1U;
+    v->out_pid[0] = 1U;
+    v->ctl_len = 0U;
+    v->ctl_pos = 0U;
+
+    if (0x00U == (data[0] & 0x60U)) {
+        rc = vf_std_req(v, data, v->ctl_buf, &v->ctl_len);
+    } else {
+        rc = v->class_req ? v->class_req(v, data, v->ctl_buf, &v->ctl_len) : -1;
+    }
+
+    if (rc) {
+        v->ctl_stage = CTL_STALL;
+    } else if (data[0] & 0x80U) {
+        v->ctl_len = (v->ctl_len < wlength) ? v->ctl_len : wlength;
+        v->ctl_stage = CTL_DATA_IN;
+    } else if (wlength) {
+        v->ctl_stage = CTL_DATA_OUT;
+    } else {
+        v->ctl_stage = CTL_STATUS_IN;
+    }
+
+    return VBUS_ACK;
+}
+
+static vbus_resp vf_out (vbus_func *f, uint8_t addr, uint8_t ep, const uint8_t *data, uint32_t len, uint8_t pid)
+{
+    vfunc *v = (vfunc *)f->priv;
+    uint32_t wlength = (uint32_t)v->req[6] | ((uint32_t)v->req[7] << 8);
+    vbus_resp resp;
+
+    if ((addr != v->addr) || (ep >= VMODEL_EPS)) {
+        return VBUS_NORESP;
+    }
+
+    if (0U == ep) {
+        switch (v->ctl_stage) {
+        case CTL_DATA_OUT:
+            if (pid == v->out_pid[0]) {
+                v->out_pid[0] ^= 1U;
+                v->ctl_pos += len;
+
+                if ((len < VMODEL_EP0_MPS) || (v->ctl_pos >= wlength)) {
+                    v->ctl_stage = CTL_STATUS_IN;
+                }
+            }
+            return VBUS_ACK;
+
+        case CTL_DATA_IN:
+        case CTL_STATUS_OUT:
+            /* the status stage, also when the host ends the data stage early */
+            v->ctl_stage = CTL_IDLE;
+            return VBUS_ACK;
+
+        case CTL_STALL:
+            return VBUS_STALL;
+
+        default:
+            /* a status packet sent again */
+            return (0U == len) ? VBUS_ACK : VBUS_NAK;
+        }
+    }
+
+    if (0U == v->config) {
+        return VBUS_NORESP;
+    }
+
+    if (v->halt[0][ep]) {
+        return VBUS_STALL;
+    }
+
+    if (pid != v->out_pid[ep]) {
+        /* retransmission of a packet already received */
+        return VBUS_ACK;
+    }
+
+    resp = v->ep_out ? v->ep_out(v, ep, data, len) : VBUS_STALL;
+
+    if (VBUS_ACK == resp) {
+        v->out_pid[ep] ^= 1U;
+    }
+
+    return resp;
+}
+
+static vbus_resp vf_ping (vbus_func *f, uint8_t addr, uint8_t ep)
+{
+    vfunc *v = (vfunc *)f->priv;
+
+    if ((addr != v->addr) || (ep >= VMODEL_EPS)) {
+        return VBUS_NORESP;
+    }
+
+    if ((0U == ep) ? (CTL_STALL == v->ctl_stage) : v->halt[0][ep]) {
+        return VBUS_STALL;
+    }
+
+    return VBUS_ACK;
+}
+
+static vbus_resp vf_in (vbus_func *f, uint8_t addr, uint8_t ep, uint8_t *data, uint32_t *len, uint8_t *pid)
+{
+    vfunc *v = (vfunc *)f->priv;
+    vbus_resp resp;
+
+    if ((addr != v->addr) || (ep >= VMODEL_EPS)) {
+        return VBUS_NORESP;
+    }
+
+    if (0U == ep) {
+        switch (v->ctl_stage) {
+        case CTL_DATA_IN:
+            *len = v->ctl_len - v->ctl_pos;
+            *len = (*len < VMODEL_EP0_MPS) ? *len : VMODEL_EP0_MPS;
+            memcpy(data, &v->ctl_buf[v->ctl_pos], *len);
+            break;
+
+        case CTL_STATUS_IN:
+            *len = 0U;
+            break;
+
+        case CTL_STALL:
+            return VBUS_STALL;
+
+        default:
+            return VBUS_NAK;
+        }
+
+        *pid = v->in_pid[0];
+        v->in_len = *len;
+
+        return VBUS_DATA;
+    }
+
+    if (0U == v->config) {
+        return VBUS_NORESP;
+    }
+
+    if (v->halt[1][ep]) {
+        return VBUS_STALL;
+    }
+
+    resp = v->ep_in ? v->ep_in(v, ep, data, len) : VBUS_STALL;
+
+    if (VBUS_DATA == resp) {
+        *pid = v->in_pid[ep];
+        v->in_len = *len;
+    }
+
+    return resp;
+}
+
+static void vf_in_ack (vbus_func *f, uint8_t addr, uint8_t ep)
+{
+    vfunc *v = (vfunc *)f->priv;
+    uint32_t wlength = (uint32_t)v->req[6] | ((uint32_t)v->req[7] << 8);
+
+    v->in_pid[ep] ^= 1U;
+
+    if (ep) {
+        if (v->ep_in_ack) {
+            v->ep_in_ack(v, ep, v->in_len);
+        }
+
+        return;
+    }
+
+    if (CTL_DATA_IN == v->ctl_stage) {
+        v->ctl_pos += v->in_len;
+
+        if ((v->in_len < VMODEL_EP0_MPS) || (v->ctl_pos >= wlength)) {
+            v->ctl_stage = CTL_STATUS_OUT;
+        }
+    } else if (CTL_STATUS_IN == v->ctl_stage) {
+        v->ctl_stage = CTL_IDLE;
+
+        if (v->set_addr) {
+            v->addr = v->new_addr;
+            v->set_addr = 0U;
+        }
+    } else {
+        /* no operation */
+    }
+}
+
+/*!
+    \brief      set up the bus callbacks of a function
+    \param[in]  v: function
+    \param[in]  hs: high-speed capable
+    \param[out] none
+    \retval     none
+*/
+static void vf_init (vfunc *v, int hs)
+{
+    v->func = (vbus_func) {
+        vf_connected,
+        vf_hs_capable,
+        vf_reset,
+        NULL,
+        vf_setup,
+        vf_out,
+        vf_ping,
+        vf_in,
+        vf_in_ack,
+        v
+    };
+
+    v->hs = hs;
+    vf_reset(&v->func, 1, VBUS_SPEED_FULL);
+}
+
+/* ----- hub ----- */
+
+static int hub_port_enabled (vhub *h, uint8_t i)
+{
+    /* a high-speed hub does not translate for the full-speed functions */
+    return (h->status[i] & PS_ENABLE) &&
+           ((VBUS_SPEED_HIGH != h->v.speed) || (h->status[i] & PS_HIGH_SPEED));
+}
+
+/*!
+    \brief      follow the connection of the function on a port
+    \param[in]  h: hub
+    \param[in]  i: port index
+    \param[out] none
+    \retval     none
+*/
+static void hub_port_check (vhub *h, uint8_t i)
+{
+    vbus_func *f = h->port_func[i];
+    int conn = (h->status[i] & PS_POWER) && (NULL != f) && f->connected(f);
+
+    if (conn != !!(h->status[i] & PS_CONNECTION)) {
+        h->status[i] ^= PS_CONNECTION;
+        h->change[i] |= PC_CONNECTION;
+
+        if (!conn) {
+            h->status[i] &= (uint16_t)~(PS_ENABLE | PS_RESET | PS_HIGH_SPEED);
+            h->reset_left[i] = 0U;
+        }
+    }
+}
+
+static void hub_bus_reset (vfunc *v)
+{
+    vhub *h = (vhub *)v;
+
+    memset(h->status, 0, sizeof(h->status));
+    memset(h->change, 0, sizeof(h->change));
+    memset(h->reset_left, 0, sizeof(h->reset_left));
+}
+
+static void hub_sof (vbus_func *f, uint32_t frame)
+{
+    vhub *h = (vhub *)f->priv;
+
+    for (uint8_t i = 0U; i < h->ports; i++) {
+        vbus_func *pf = h->port_func[i];
+
+        hub_port_check(h, i);
+
+        if (h->reset_left[i] && (0U == --h->reset_left[i])) {
+            vbus_speed speed = ((VBUS_SPEED_HIGH == h->v.speed) && pf->hs_capable(pf)) ? VBUS_SPEED_HIGH
+                                                                                      : VBUS_SPEED_FULL;
+
+            pf->reset(pf, 0, speed);
+
+            h->status[i] &= (uint16_t)~PS_RESET;
+            h->status[i] |= PS_ENABLE | ((VBUS_SPEED_HIGH == speed) ? PS_HIGH_SPEED : 0U);
+            h->change[i] |= PC_RESET;
+        }
+
+        if (hub_port_enabled(h, i) && pf->sof) {
+            pf->sof(pf, frame);
+        }
+    }
+}
+
+static int hub_class_req (vfunc *v, const uint8_t *req, uint8_t *buf, uint32_t *len)
+{
+    vhub *h = (vhub *)v;
+    uint16_t value = (uint16_t)(req[2] | (req[3] << 8)), index = (uint16_t)(req[4] | (req[5] << 8));
+    uint8_t i = (uint8_t)(index - 1U);
+
+    if (0xA0U == req[0]) {
+        if (0x06U == req[1]) {
+            /* hub descriptor: individual power switching, 10 ms to power good, all ports removable */
+            const uint8_t desc[9] = {9U, 0x29U, h->ports, 0x09U, 0x00U, 5U, 0U, 0x00U, 0xFFU};
+
+            memcpy(buf, desc, sizeof(desc));
+            *len = sizeof(desc);
+            return 0;
+        }
+
+        if (0x00U == req[1]) {
+            memset(buf, 0, 4U);
+            *len = 4U;
+            return 0;
+        }
+
+        return -1;
+    }
+
+    if (0x20U == req[0]) {
+        /* C_HUB_LOCAL_POWER, C_HUB_OVER_CURRENT: never set */
+        return (0x01U == req[1]) ? 0 : -1;
+    }
+
+    if ((0U == index) || (index > h->ports)) {
+        return -1;
+    }
+
+    if ((0xA3U == req[0]) && (0x00U == req[1])) {
+        put16(&buf[0], h->status[i]);
+        put16(&buf[2], h->change[i]);
+        *len = 4U;
+        return 0;
+    }
+
+    if ((0x23U == req[0]) && (0x03U == req[1])) {
+        switch (value) {
+        case 4U:                                    /* PORT_RESET */
+            if (h->status[i] & PS_CONNECTION) {
+                vbus_func *pf = h->port_func[i];
+
+                pf->reset(pf, 1, VBUS_SPEED_FULL);
+
+                h->status[i] = (uint16_t)((h->status[i] | PS_RESET) & ~(PS_ENABLE | PS_HIGH_SPEED));
+                h->reset_left[i] = (VBUS_SPEED_HIGH == h->v.speed) ? 80U : 10U;
+            }
+            return 0;
+
+        case 8U:                                    /* PORT_POWER */
+            h->status[i] |= PS_POWER;
+            hub_port_check(h, i);
+            return 0;
+
+        default:
+            return 0;
+        }
+    }
+
+    if ((0x23U == req[0]) && (0x01U == req[1])) {
+        if (1U == value) {                          /* PORT_ENABLE */
+            h->status[i] &= (uint16_t)~(PS_ENABLE | PS_HIGH_SPEED);
+        } else if (8U == value) {                   /* PORT_POWER */
+            h->status[i] = 0U;
+            h->reset_left[i] = 0U;
+        } else if ((value >= 16U) && (value <= 20U)) {
+            h->change[i] &= (uint16_t)~(1U << (value - 16U));
+        } else {
+            /* no operation */
+        }
+        return 0;
+    }
+
+    return -1;
+}
+
+static vbus_resp hub_ep_in (vfunc *v, uint8_t ep, uint8_t *data, uint32_t *len)
+{
+    vhub *h = (vhub *)v;
+    uint8_t map = 0U;
+
+    for (uint8_t i = 0U; i < h->ports; i++) {
+        if (h->change[i]) {
+            map |= (uint8_t)(1U << (i + 1U));
+        }
+    }
+
+    if ((1U != ep) || (0U == map)) {
+        return VBUS_NAK;
+    }
+
+    data[0] = map;
+    *len = 1U;
+
+    return VBUS_DATA;
+}
+
+static vbus_resp hub_setup (vbus_func *f, uint8_t addr, const uint8_t *data)
+{
+    vhub *h = (vhub *)f->priv;
+    vbus_resp resp = VBUS_NORESP;
+
+    if (addr == h->v.addr) {
+        return vf_setup(f, addr, data);
+    }
+
+    for (uint8_t i = 0U; (i < h->ports) && (VBUS_NORESP == resp); i++) {
+        if (hub_port_enabled(h, i)) {
+            resp = h->port_func[i]->setup(h->port_func[i], addr, data);
+        }
+    }
+
+    return resp;
+}
+
+static vbus_resp hub_out (vbus_func *f, uint8_t addr, uint8_t ep, const uint8_t *data, uint32_t len, uint8_t pid)
+{
+    vhub *h = (vhub *)f->priv;
+    vbus_resp resp = VBUS_NORESP;
+
+    if (addr == h->v.addr) {
+        return vf_out(f, addr, ep, data, len, pid);
+    }
+
+    for (uint8_t i = 0U; (i < h->ports) && (VBUS_NORESP == resp); i++) {
+        if (hub_port_enabled(h, i)) {
+            resp = h->port_func[i]->out(h->port_func[i], addr, ep, data, len, pid);
+        }
+    }
+
+    return resp;
+}
+
+static vbus_resp hub_ping (vbus_func *f, uint8_t addr, uint8_t ep)
+{
+    vhub *h = (vhub *)f->priv;
+    vbus_resp resp = VBUS_NORESP;
+
+    if (addr == h->v.addr) {
+        return vf_ping(f, addr, ep);
+    }
+
+    for (uint8_t i = 0U; (i < h->ports) && (VBUS_NORESP == resp); i++) {
+        if (hub_port_enabled(h, i)) {
+            resp = h->port_func[i]->ping(h->port_func[i], addr, ep);
+        }
+    }
+
+    return resp;
+}
+
+static vbus_resp hub_in (vbus_func *f, uint8_t addr, uint8_t ep, uint8_t *data, uint32_t *len, uint8_t *pid)
+{
+    vhub *h = (vhub *)f->priv;
+    vbus_resp resp = VBUS_NORESP;
+
+    h->in_port = -1;
+
+    if (addr == h->v.addr) {
+        return vf_in(f, addr, ep, data, len, pid);
+    }
+
+    for (uint8_t i = 0U; (i < h->ports) && (VBUS_NORESP == resp); i++) {
+        if (hub_port_enabled(h, i)) {
+            resp = h->port_func[i]->in(h->port_func[i], addr, ep, data, len, pid);
+            h->in_port = i;
+        }
+    }
+
+    return resp;
+}
+
+static void hub_in_ack (vbus_func *f, uint8_t addr, uint8_t ep)
+{
+    vhub *h = (vhub *)f->priv;
+
+    if (h->in_port < 0) {
+        vf_in_ack(f, addr, ep);
+    } else {
+        h->port_func[h->in_port]->in_ack(h->port_func[h->in_port], addr, ep);
+    }
+}
+
+/*!
+    \brief      the hub model with the functions on its downstream ports
+    \param[in]  port_func: function of each port, NULL for an empty port
+    \param[in]  ports: number of downstream ports
+    \param[in]  hs: high-speed capable
+    \param[out] none
+    \retval     function of the hub
+*/
+vbus_func *vmodel_hub (vbus_func *const *port_func, uint8_t ports, int hs)
+{
+    static const uint8_t itf[3] = {0x09U, 0x00U, 0x00U};
+    /* status change endpoint, polled every 8 ms at full speed and every 8 microframes at high speed */
+    uint8_t ep[7] = {7U, 5U, 0x81U, 0x03U, 1U, 0U, hs ? 4U : 8U};
+
+    if (ports > VMODEL_HUB_PORTS) {
+        vbus_fail("hub model: %u ports", ports);
+    }
+
+    memset(&hub, 0, sizeof(hub));
+
+    hub.v.class_req = hub_class_req;
+    hub.v.bus_reset = hub_bus_reset;
+    hub.v.ep_in = hub_ep_in;
+    vf_init(&hub.v, hs);
+    vf_desc(&hub.v, 0x09U, hs ? 0x01U : 0x00U, 0x0100U, itf, ep, 1U);
+
+    hub.v.func.sof = hub_sof;
+    hub.v.func.setup = hub_setup;
+    hub.v.func.out = hub_out;
+    hub.v.func.ping = hub_ping;
+    hub.v.func.in = hub_in;
+    hub.v.func.in_ack = hub_in_ack;
+
+    hub.ports = ports;
+    memcpy(hub.port_func, port_func, ports * sizeof(port_func[0]));
+
+    return &hub.v.func;
+}
+
+/* ----- mass storage stick ----- */
+
+static void msc_bus_reset (vfunc *v)
+{
+    ((vmsc *)v)->state = MSC_CBW;
+}
+
+static int msc_class_req (vfunc *v, const uint8_t *req, uint8_t *buf, uint32_t *len)
+{
+    if ((0xA1U == req[0]) && (0xFEU == req[1])) {
+        /* GET_MAX_LUN */
+        buf[0] = 0U;
+        *len = 1U;
+        return 0;
+    }
+
+    if ((0x21U == req[0]) && (0xFFU == req[1])) {
+        /* bulk-only mass storage reset */
+        msc_bus_reset(v);
+        return 0;
+    }
+
+    return -1;
+}
+
+/*!
+    \brief      run the command of a command block wrapper
+    \param[in]  m: stick
+    \param[in]  cbw: command block wrapper
+    \param[out] none
+    \retval     none
+*/
+static void msc_command (vmsc *m, const uint8_t *cbw)
+{
+    uint32_t dlen = get32(&cbw[8]);
+    const uint8_t *cdb = &cbw[15];
+    uint32_t lba, n;
+
+    m->tag = get32(&cbw[4]);
+    m->status = 0U;
+    m->data = m->reply;
+    m->data_len = 0U;
+    m->data_pos = 0U;
+    m->state = (cbw[12] & 0x80U) ? MSC_DATA_IN : MSC_DATA_OUT;
+
+    memset(m->reply, 0, sizeof(m->reply));
+
+    switch (cdb[0]) {
+    case 0x00U:                                     /* TEST UNIT READY */
+        break;
+
+    case 0x03U:                                     /* REQUEST SENSE, no sense */
+        m->reply[0] = 0x70U;
+        m->reply[7] = 10U;
+        m->data_len = 18U;
+        break;
+
+    case 0x12U:                                     /* INQUIRY */
+        memcpy(m->reply, "\x00\x80\x00\x01\x1F\x00\x00\x00" "VBUS    " "model stick     " "1.00", 36U);
+        m->data_len = 36U;
+        break;
+
+    case 0x1AU:                                     /* MODE SENSE(6), not write protected */
+        m->reply[0] = 3U;
+        m->data_len = 4U;
+        break;
+
+    case 0x25U:                                     /* READ CAPACITY(10) */
+        put32_be(&m->reply[0], m->blocks - 1U);
+        put32_be(&m->reply[4], BLOCK_SIZE);
+        m->data_len = 8U;
+        break;
+
+    case 0x28U:                                     /* READ(10) */
+    case 0x2AU:                                     /* WRITE(10) */
+        lba = get32_be(&cdb[2]);
+        n = ((uint32_t)cdb[7] << 8) | cdb[8];
+
+        if ((lba + n) > m->blocks) {
+            vbus_fail("msc model: blocks %u-%u beyond the disk", lba, lba + n - 1U);
+        }
+
+        m->data = &m->disk[lba * BLOCK_SIZE];
+        m->data_len = n * BLOCK_SIZE;
+        break;
+
+    default:
+        vbus_fail("msc model: SCSI command 0x%02x", cdb[0]);
+    }
+
+    if (m->data_len > dlen) {
+        m->data_len = dlen;
+    }
+
+    m->residue = dlen - m->data_len;
+
+    if (0U == dlen) {
+        m->state = MSC_CSW;
+    }
+}
+
+static void msc_csw (vmsc *m)
+{
+    put32(&m->csw[0], CSW_SIGNATURE);
+    put32(&m->csw[4], m->tag);
+    put32(&m->csw[8], m->residue);
+    m->csw[12] = m->status;
+
+    m->state = MSC_CSW;
+}
+
+static vbus_resp msc_ep_out (vfunc *v, uint8_t ep, const uint8_t *data, uint32_t len)
+{
+    vmsc *m = (vmsc *)v;
+
+    if (2U != ep) {
+        return VBUS_STALL;
+    }
+
+    switch (m->state) {
+    case MSC_CBW:
+        if ((CBW_LEN != len) || (CBW_SIGNATURE != get32(data))) {
+            vbus_fail("msc model: command block wrapper of %u bytes", len);
+        }
+
+        msc_command(m, data);
+
+        if (MSC_CSW == m->state) {
+            msc_csw(m);
+        }
+        return VBUS_ACK;
+
+    case MSC_DATA_OUT:
+        if ((m->data_pos + len) > m->data_len) {
+            vbus_fail("msc model: %u bytes past the data stage", m->data_pos + len - m->data_len);
+        }
+
+        memcpy(&m->data[m->data_pos], data, len);
+        m->data_pos += len;
+
+        if (m->data_pos >= m->data_len) {
+            msc_csw(m);
+        }
+        return VBUS_ACK;
+
+    default:
+        return VBUS_NAK;
+    }
+}
+
+static vbus_resp msc_ep_in (vfunc *v, uint8_t ep, uint8_t *data, uint32_t *len)
+{
+    vmsc *m = (vmsc *)v;
+    uint32_t mps = (VBUS_SPEED_HIGH == v->speed) ? 512U : 64U;
+
+    if (1U != ep) {
+        return VBUS_STALL;
+    }
+
+    if (MSC_DATA_IN == m->state) {
+        *len = m->data_len - m->data_pos;
+        *len = (*len < mps) ? *len : mps;
+        memcpy(data, &m->data[m->data_pos], *len);
+
+        return VBUS_DATA;
+    }
+
+    if (MSC_CSW == m->state) {
+        memcpy(data, m->csw, CSW_LEN);
+        *len = CSW_LEN;
+
+        return VBUS_DATA;
+    }
+
+    return VBUS_NAK;
+}
+
+static void msc_ep_in_ack (vfunc *v, uint8_t ep, uint32_t len)
+{
+    vmsc *m = (vmsc *)v;
+
+    if (MSC_DATA_IN == m->state) {
+        m->data_pos += len;
+
+        if (m->data_pos >= m->data_len) {
+            msc_csw(m);
+        }
+    } else if (MSC_CSW == m->state) {
+        m->state = MSC_CBW;
+    } else {
+        /* no operation */
+    }
+}
+
+/*!
+    \brief      a mass storage stick model on a RAM disk
+    \param[in]  index: stick, from 0 to VMODEL_MSC_NUM - 1
+    \param[in]  disk: RAM disk
+    \param[in]  blocks: blocks of 512 bytes of the disk
+    \param[in]  hs: high-speed capable
+    \param[out] none
+    \retval     function of the stick
+*/
+vbus_func *vmodel_msc (uint8_t index, uint8_t *disk, uint32_t blocks, int hs)
+{
+    static const uint8_t itf[3] = {0x08U, 0x06U, 0x50U};
+    uint16_t mps = hs ? 512U : 64U;
+    uint8_t ep[14] = {7U, 5U, 0x81U, 0x02U, (uint8_t)mps, (uint8_t)(mps >> 8), 0U,
+                      7U, 5U, 0x02U, 0x02U, (uint8_t)mps, (uint8_t)(mps >> 8), 0U};
+    vmsc *m;
+
+    if (index >= VMODEL_MSC_NUM) {
+        vbus_fail("msc model: stick %u", index);
+    }
+
+    m = &msc[index];
+
+    memset(m, 0, sizeof(*m));
+
+    m->v.class_req = msc_class_req;
+    m->v.bus_reset = msc_bus_reset;
+    m->v.ep_out = msc_ep_out;
+    m->v.ep_in = msc_ep_in;
+    m->v.ep_in_ack = msc_ep_in_ack;
+    vf_init(&m->v, hs);
+    vf_desc(&m->v, 0x00U, 0x00U, (uint16_t)(0x0200U + index), itf, ep, 2U);
+
+    m->disk = disk;
+    m->blocks = blocks;
+
+    return &m->v.func;
+}
@@ -0,0 +1,334 @@
+/*!
+    \file    vbus_trap.c
+    \brief   register windows of the emulated cores, the driver accesses are
+             trapped and handed to vbus_core.c
+
+    \note    test harness of this USB library tree, not part of the
+             GigaDevice firmware release; it is provided under the same
+             terms as the library (see drv_usb_core.c)
+*/
+
+/*
+    The drivers access the cores through plain volatile pointers, so the
+    windows are mapped without any access right and each access faults.
+    The common 32-bit moves (8B, 89 and C7 /0 with an optional REX prefix)
+    are emulated in the SIGSEGV handler. Any other instruction (the
+    read-modify-write forms of |= and &= among them) is single-stepped on
+    the opened page: the page gets the register value before the step and
+    the value written is handed over in the SIGTRAP handler. This needs an
+    x86-64 Linux host.
+*/
+
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include "vbus.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "the register traps need an x86-64 Linux host"
+#endif
+
+#define PAGE_SIZE_HOST              0x1000UL
+#define EFLAGS_TF                   0x100UL
+#define PF_WRITE                    0x2UL
+
+/* chip pages read by the device stack: unique ID (serial string) and DEVICE_ID */
+#define UID_PAGE                    0x1FFF7000UL
+#define DEVID_PAGE                  0x40023000UL
+
+static struct
+{
+    int         active;
+    int         write;
+    uint8_t     side;
+    uint32_t    off;
+    uint32_t    value;
+    uint32_t   *addr;
+} pending;
+
+static vbus_cpu_stat counts[VBUS_SIDES];
+
+/* ucontext register of the ModRM reg field */
+static const int gpr_map[16] =
+{
+    REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+    REG_R8,  REG_R9,  REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15
+};
+
+/*!
+    \brief      count an access for the cycle accounting
+    \param[in]  side: side of the core
+    \param[in]  off: register offset
+    \param[in]  write: non-zero for a write
+    \param[out] none
+    \retval     none
+*/
+static void access_count (uint8_t side, uint32_t off, int write)
+{
+    if (off >= 0x1000U) {
+        if (write) {
+            counts[side].fifo_wr++;
+        } else {
+            counts[side].fifo_rd++;
+        }
+    } else {
+        if (write) {
+            counts[side].reg_wr++;
+        } else {
+            counts[side].reg_rd++;
+        }
+    }
+}
+
+/*!
+    \brief      emulate a 32-bit move from or to a window
+    \param[in]  uc: context of the faulting instruction
+    \param[in]  side: side of the core
+    \param[in]  off: register offset
+    \param[out] none
+    \retval     1 when emulated, 0 to single-step the instruction
+*/
+static int move_emulate (ucontext_t *uc, uint8_t side, uint32_t off)
+{
+    const uint8_t *p = (const uint8_t *)uc->uc_mcontext.gregs[REG_RIP];
+    uint8_t rex = 0U, op, modrm, mod, rm;
+    uint32_t imm = 0U;
+    int reg;
+
+    if (0x40U == (p[0] & 0xF0U)) {
+        rex = *p++;
+    }
+
+    /* 64-bit operand size */
+    if (rex & 0x08U) {
+        return 0;
+    }
+
+    op = *p++;
+    if ((0x8BU != op) && (0x89U != op) && (0xC7U != op)) {
+        return 0;
+    }
+
+    modrm = *p++;
+    mod = modrm >> 6;
+    rm = modrm & 7U;
+    reg = ((modrm >> 3) & 7) | ((rex & 0x04U) ? 8 : 0);
+
+    if ((3U == mod) || ((0xC7U == op) && (0 != (reg & 7)))) {
+        return 0;
+    }
+
+    if (4U == rm) {
+        uint8_t sib = *p++;
+
+        if ((0U == mod) && (5U == (sib & 7U))) {
+            p += 4;
+        }
+    } else if ((0U == mod) && (5U == rm)) {
+        /* RIP relative, not a window */
+        return 0;
+    } else {
+        /* no operation */
+    }
+
+    if (1U == mod) {
+        p += 1;
+    } else if (2U == mod) {
+        p += 4;
+    } else {
+        /* no operation */
+    }
+
+    if (0xC7U == op) {
+        memcpy(&imm, p, 4U);
+        p += 4;
+    }
+
+    if (0x8BU == op) {
+        uc->uc_mcontext.gregs[gpr_map[reg]] = (greg_t)vcore_read(side, off);
+        access_count(side, off, 0);
+    } else {
+        uint32_t val = (0x89U == op) ? (uint32_t)uc->uc_mcontext.gregs[gpr_map[reg]] : imm;
+
+        access_count(side, off, 1);
+        vcore_write(side, off, val);
+    }
+
+    uc->uc_mcontext.gregs[REG_RIP] = (greg_t)p;
+
+    vbus_access(side, 0x8BU != op);
+
+    return 1;
+}
+
+/*!
+    \brief      SIGSEGV handler, an access to a window
+    \param[in]  sig: signal number
+    \param[in]  si: fault information
+    \param[in]  ctx: context of the faulting instruction
+    \param[out] none
+    \retval     none
+*/
+static void trap_fault (int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = (ucontext_t *)ctx;
+    uintptr_t a = (uintptr_t)si->si_addr;
+    uintptr_t page;
+    uint32_t off;
+    uint8_t side;
+
+    if ((a < VBUS_WINDOW_BASE) || (a >= VBUS_WINDOW_BASE + VBUS_SIDES * VBUS_WINDOW_STRIDE) || pending.active) {
+        /* a real fault, crash on return */
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    side = (uint8_t)((a - VBUS_WINDOW_BASE) / VBUS_WINDOW_STRIDE);
+    off = (uint32_t)((a - VBUS_WINDOW_BASE) % VBUS_WINDOW_STRIDE) & ~3U;
+
+    if (off >= VBUS_WINDOW_SIZE) {
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+
+    if (move_emulate(uc, side, off)) {
+        return;
+    }
+
+    pending.active = 1;
+    pending.write = (0U != (uc->uc_mcontext.gregs[REG_ERR] & PF_WRITE));
+    pending.side = side;
+    pending.off = off;
+    pending.addr = (uint32_t *)(a & ~(uintptr_t)3U);
+
+    page = a & ~(PAGE_SIZE_HOST - 1U);
+    mprotect((void *)page, PAGE_SIZE_HOST, PROT_READ | PROT_WRITE);
+
+    if (pending.write) {
+        pending.value = vcore_peek(side, off);
+    } else {
+        pending.value = vcore_read(side, off);
+        access_count(side, off, 0);
+    }
+
+    *pending.addr = pending.value;
+
+    uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+}
+
+/*!
+    \brief      SIGTRAP handler, the single-stepped instruction is done
+    \param[in]  sig: signal number
+    \param[in]  si: trap information
+    \param[in]  ctx: context after the instruction
+    \param[out] none
+    \retval     none
+*/
+static void trap_step (int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = (ucontext_t *)ctx;
+    uintptr_t page;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~(greg_t)EFLAGS_TF;
+
+    if (!pending.active) {
+        return;
+    }
+
+    uint32_t val = *pending.addr;
+
+    page = (uintptr_t)pending.addr & ~(PAGE_SIZE_HOST - 1U);
+    mprotect((void *)page, PAGE_SIZE_HOST, PROT_NONE);
+    pending.active = 0;
+
+    /* a read faults as such even when the instruction writes back */
+    if (pending.write || (val != pending.value)) {
+        access_count(pending.side, pending.off, 1);
+        vcore_write(pending.side, pending.off, val);
+        vbus_access(pending.side, 1);
+    } else {
+        vbus_access(pending.side, 0);
+    }
+}
+
+/*!
+    \brief      map the register windows and install the access traps
+    \param[in]  none
+    \param[out] none
+    \retval     none
+*/
+void vbus_trap_init (void)
+{
+    struct sigaction sa;
+    void *p;
+
+    for (uint8_t side = 0U; side < VBUS_SIDES; side++) {
+        p = mmap((void *)(VBUS_WINDOW_BASE + side * VBUS_WINDOW_STRIDE), VBUS_WINDOW_SIZE, PROT_NONE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+        if (MAP_FAILED == p) {
+            vbus_fail("cannot map the register window of side %u", side);
+        }
+    }
+
+    p = mmap((void *)UID_PAGE, PAGE_SIZE_HOST, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (MAP_FAILED == p) {
+        vbus_fail("cannot map the unique ID page");
+    }
+
+    /* 96-bit unique ID of the serial string */
+    ((uint32_t *)p)[0xA10U / 4U] = 0x20221230U;
+    ((uint32_t *)p)[0xA14U / 4U] = 0x5642555AU;
+    ((uint32_t *)p)[0xA18U / 4U] = 0x00000042U;
+
+    p = mmap((void *)DEVID_PAGE, PAGE_SIZE_HOST, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (MAP_FAILED == p) {
+        vbus_fail("cannot map the DEVICE_ID page");
+    }
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+
+    /* the spin watchdog of vbus_bus.c must not run the CPUs within an access */
+    sigaddset(&sa.sa_mask, SIGPROF);
+
+    sa.sa_sigaction = trap_fault;
+    sigaction(SIGSEGV, &sa, NULL);
+
+    sa.sa_sigaction = trap_step;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    memset(counts, 0, sizeof(counts));
+}
+
+/*!
+    \brief      an access is being single-stepped
+    \param[in]  none
+    \param[out] none
+    \retval     non-zero between the fault and the trap of the step
+*/
+int vbus_trap_busy (void)
+{
+    return pending.active;
+}
+
+/*!
+    \brief      count of the accesses of a side, for the cycle accounting
+    \param[in]  side: side of the core
+    \param[out] st: the register and FIFO counters are filled in
+    \retval     none
+*/
+void vbus_trap_count (uint8_t side, vbus_cpu_stat *st)
+{
+    st->reg_rd = counts[side].reg_rd;
+    st->reg_wr = counts[side].reg_wr;
+    st->fifo_rd = counts[side].fifo_rd;
+    st->fifo_wr = counts[side].fifo_wr;
+}
@@ -138,12 +138,22 @@ typedef struct {
 #if FF_FS_EXFAT
 	BYTE*	dirbuf;			/* Directory entry block scratchpad buffer for exFAT */
 #endif
+#if FF_USE_LFN == 1 && FF_FS_REENTRANT
+	WCHAR	lfnwork[FF_MAX_LFN + 1];	/* LFN working buffer of this volume */
+#if FF_FS_EXFAT
+	BYTE	dirwork[(FF_MAX_LFN + 44U) / 15 * 32];	/* Directory entry block scratchpad buffer of this volume */
+#endif
+#endif
 #if FF_FS_REENTRANT
 	FF_SYNC_t	sobj;		/* Identifier of sync object */
 #endif
 #if !FF_FS_READONLY
 	DWORD	last_clst;		/* Last allocated cluster */
 	DWORD	free_clst;		/* Number of free clusters */
+#if FF_USE_FREEMAP
+	BYTE	fm_shift;		/* Free cluster map group size (log2 of clusters per bit) */
+	BYTE	freemap[FF_FREEMAP_SIZE];	/* Free cluster map (b=0:Group fully allocated, 1:Group may have free cluster) */
+#endif
 #endif
 #if FF_FS_RPATH
 	DWORD	cdir;			/* Current directory start cluster (0:root) */
@@ -161,6 +171,29 @@ typedef struct {
 	DWORD	database;		/* Data base sector */
 #if FF_FS_EXFAT
 	DWORD	bitbase;		/* Allocation bitmap base sector */
+#endif
+#if FF_USE_DIRCACHE
+	DWORD	dc_dsc[FF_DIRCACHE_SIZE];	/* Directory entry cache: start cluster of the directory */
+	DWORD	dc_hash[FF_DIRCACHE_SIZE];	/* Directory entry cache: hash value of the name */
+	DWORD	dc_ofs[FF_DIRCACHE_SIZE];	/* Directory entry cache: offset of the entry block */
+	DWORD	dc_ptr[FF_DIRCACHE_SIZE];	/* Directory entry cache: offset of the SFN entry (0xFFFFFFFF:blank) */
+#endif
+#if FF_USE_FASTSEEK && FF_CLMT_SLOTS
+	DWORD	clmt_seq;		/* CLMT LRU sequence counter */
+	DWORD	clmt_scl[FF_CLMT_SLOTS];	/* Start cluster of the file mapped in each CLMT slot (0:blank) */
+	FSIZE_t	clmt_size[FF_CLMT_SLOTS];	/* Size of the file when the CLMT was created */
+	DWORD	clmt_lru[FF_CLMT_SLOTS];	/* Last use of each CLMT slot */
+	BYTE	clmt_ref[FF_CLMT_SLOTS];	/* Number of file objects using each CLMT slot */
+	DWORD	clmt[FF_CLMT_SLOTS][FF_CLMT_ITEMS];	/* CLMT slots (item 0:size of the table, 0:file is too fragmented) */
+#endif
+#if FF_USE_CACHE
+	DWORD	c_hit;			/* Number of window moves served by the sector cache */
+	DWORD	c_miss;			/* Number of window moves read from the disk */
+	DWORD	c_seq;			/* LRU sequence counter */
+	DWORD	c_sect[FF_CACHE_FATSECT + FF_CACHE_DIRSECT];	/* Sector held in each cache slot (0xFFFFFFFF:empty) */
+	DWORD	c_lru[FF_CACHE_FATSECT + FF_CACHE_DIRSECT];		/* Last use of each cache slot */
+	BYTE	c_flag[FF_CACHE_FATSECT + FF_CACHE_DIRSECT];	/* Cache slot flags (b0:dirty) */
+	BYTE	c_buf[FF_CACHE_FATSECT + FF_CACHE_DIRSECT][FF_MAX_SS];	/* Cache slot data */
 #endif
 	DWORD	winsect;		/* Current sector appearing in the win[] */
 	BYTE	win[FF_MAX_SS];	/* Disk access window for Directory, FAT (and file data at tiny cfg) */
@@ -374,6 +407,10 @@ int ff_del_syncobj (FF_SYNC_t sobj);	/* Delete a sync object */
 #define	FA_OPEN_ALWAYS		0x10
 #define	FA_OPEN_APPEND		0x30
 
+/* File status flag (FIL.flag), set by the modules that change the file size
+/  without f_write(), such as ff_stream.c, to have f_sync() update the entry */
+#define	FA_MODIFIED			0x40
+
 /* Fast seek controls (2nd argument of f_lseek) */
 #define CREATE_LINKMAP	((FSIZE_t)0 - 1)
 
@@ -0,0 +1,47 @@
+/*!
+    \file    ff_stream.h
+    \brief   header for ff_stream.c module
+
+    \note    extension module of this FatFs tree, not part of the FatFs
+             release by ChaN or of the GigaDevice firmware library; it is
+             provided under the same terms as FatFs (see ff.h)
+*/
+
+
+#ifndef __FF_STREAM_H
+#define __FF_STREAM_H
+
+#ifdef __cplusplus
+ extern "C" {
+#endif
+
+#include "diskio.h"
+#include "ff.h"
+
+/* streaming writer object */
+typedef struct
+{
+    FIL      file;              /*!< file object of the stream */
+    BYTE     *buf;              /*!< staging buffer */
+    UINT     buf_sect;          /*!< size of the staging buffer in sectors */
+    UINT     fill;              /*!< number of bytes held in the staging buffer */
+    UINT     chunk;             /*!< number of sectors of the next media write */
+    DWORD    blk;               /*!< erase block size of the media in sectors */
+    DWORD    sect;              /*!< next sector to be written */
+    DWORD    sect_end;          /*!< end of the pre-allocated extent */
+    FSIZE_t  alloc;             /*!< size of the pre-allocated extent in bytes */
+    FSIZE_t  written;           /*!< number of bytes written to the media */
+    FSIZE_t  ckpt_intv;         /*!< checkpoint interval in bytes (0: checkpoint only by f_stream_sync) */
+    FSIZE_t  ckpt_next;         /*!< position of the next checkpoint */
+}FSTREAM;
+
+FRESULT f_stream_open(FSTREAM *st, const TCHAR *path, FSIZE_t size, BYTE *buf, UINT bufsize, FSIZE_t ckpt);
+FRESULT f_stream_write(FSTREAM *st, const void *data, UINT len, UINT *bw);
+FRESULT f_stream_sync(FSTREAM *st);
+FRESULT f_stream_close(FSTREAM *st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __FF_STREAM_H */
@@ -42,11 +42,47 @@
 /* This option switches f_mkfs() function. (0:Disable or 1:Enable) */
 
 
-#define	_USE_FASTSEEK	1
+#define FF_USE_FASTSEEK	1
 /* This option switches fast seek function. (0:Disable or 1:Enable) */
 
 
-#define FF_USE_EXPAND	0
+#ifndef FF_CLMT_SLOTS
+#define FF_CLMT_SLOTS	0
+#endif
+#ifndef FF_CLMT_ITEMS
+#define FF_CLMT_ITEMS	64
+#endif
+#ifndef FF_CLMT_MINSIZE
+#define FF_CLMT_MINSIZE	0x10000
+#endif
+/* This set of options configures the cluster link map tables managed by FatFs.
+/  When FF_USE_FASTSEEK is enabled and FF_CLMT_SLOTS is not 0, f_lseek() on a file
+/  opened in read-only mode and of FF_CLMT_MINSIZE bytes or larger builds a CLMT in
+/  a slot of the filesystem object and switches the file to fast seek mode. The
+/  table is kept after f_close() and shared by the files opened later, and the
+/  least recently used one not in use is replaced when all slots are taken.
+/  FF_CLMT_ITEMS defines the size of a slot in DWORDs, which covers a file of
+/  (FF_CLMT_ITEMS - 2) / 2 fragments. Each slot takes FF_CLMT_ITEMS * 4 bytes.
+/  A table set by the application to cltbl is used as is. The slots are disabled
+/  here to save their RAM and can be enabled by the project. */
+
+
+#ifndef FF_USE_DIRCACHE
+#define FF_USE_DIRCACHE	0
+#endif
+#ifndef FF_DIRCACHE_SIZE
+#define FF_DIRCACHE_SIZE	64
+#endif
+/* This option switches the directory entry cache. (0:Disable or 1:Enable)
+/  When enabled, the location of the entry found on the FAT/FAT32 volume is kept
+/  in one of the FF_DIRCACHE_SIZE (even number) slots of the filesystem object, keyed by the
+/  directory and the hash of the name, and the next lookup of the name checks
+/  the entry at the location before scanning the directory. Each slot takes 16
+/  bytes of the filesystem object. exFAT volumes are searched as before.
+/  The cache is disabled here to save its RAM and can be enabled by the project. */
+
+
+#define FF_USE_EXPAND	1
 /* This option switches f_expand function. (0:Disable or 1:Enable) */
 
 
@@ -97,6 +133,19 @@
 */
 
 
+#ifndef FF_USE_FASTCVT
+#define FF_USE_FASTCVT	0
+#endif
+/* This option switches the direct-index code conversion tables. (0:Disable or 1:Enable)
+/  When enabled, the Unicode/OEM code conversions and the up-case conversion are
+/  done with two-level tables in ffunitbl.h instead of searching the tables, at
+/  the cost of larger .const section. ffunitbl.h is created for FF_CODE_PAGE by
+/  src/option/ffunigen.c and it needs to be re-created when FF_CODE_PAGE is
+/  changed. With FF_CODE_PAGE = 0, only the up-case conversion uses the table.
+/  The shipped ffunitbl.h is for FF_CODE_PAGE 932 and 'make unitbl' in the test
+/  directory checks it against the generator. */
+
+
 #define FF_USE_LFN		1
 
 #define FF_MAX_LFN		255
@@ -234,6 +283,48 @@
 /  buffer in the filesystem object (FATFS) is used for the file data transfer. */
 
 
+#ifndef FF_USE_CACHE
+#define FF_USE_CACHE		0
+#endif
+#ifndef FF_CACHE_FATSECT
+#define FF_CACHE_FATSECT	4
+#endif
+#ifndef FF_CACHE_DIRSECT
+#define FF_CACHE_DIRSECT	4
+#endif
+/* The option FF_USE_CACHE switches the write-back sector cache placed beneath the
+/  disk access window. (0:Disable or 1:Enable)
+/  When enabled, sectors evicted from the window are kept in an LRU cache in the
+/  filesystem object instead of being written back or discarded, so that FAT and
+/  directory accesses alternating each other do not re-read the same sectors.
+/  FF_CACHE_FATSECT and FF_CACHE_DIRSECT define the number of sectors reserved for
+/  the FAT area and for the other sectors (directory, allocation bitmap and so on).
+/  Each sector takes FF_MAX_SS bytes of RAM in the FATFS. Dirty sectors are written
+/  back on eviction and by f_sync(), f_close() and the other functions that flush
+/  the volume. The counters c_hit and c_miss in the FATFS count cache hits and
+/  misses on window moves. These options can be given by the project (compiler
+/  defines) to enable the cache where the RAM is available. */
+
+
+#ifndef FF_USE_FREEMAP
+#define FF_USE_FREEMAP		0
+#endif
+#ifndef FF_FREEMAP_SIZE
+#define FF_FREEMAP_SIZE		512
+#endif
+/* The option FF_USE_FREEMAP switches the free cluster map for FAT12/16/32 volumes.
+/  (0:Disable or 1:Enable)
+/  The map has a bit per group of clusters that tells whether the group can contain
+/  a free cluster, so that the cluster allocation and f_expand() skip the groups
+/  known to be fully allocated instead of reading their FAT entries one by one.
+/  FF_FREEMAP_SIZE defines the size of the map in bytes. The group size is chosen
+/  at mount time as the smallest power of 2 that fits the volume in the map.
+/  The map is learned while allocating and is built exactly by the first full FAT
+/  scan in f_getfree(). This option has no effect at read-only configuration.
+/  The map takes FF_FREEMAP_SIZE bytes of the FATFS, so it is disabled here and
+/  enabled by the project that needs it (e.g. a logger on a large card). */
+
+
 #define FF_FS_EXFAT		1
 /* This option switches support for exFAT filesystem. (0:Disable or 1:Enable)
 /  To enable exFAT, also LFN needs to be enabled. (FF_USE_LFN >= 1)
@@ -254,7 +345,9 @@
 /  These options have no effect at read-only configuration (FF_FS_READONLY = 1). */
 
 
+#ifndef FF_FS_LOCK
 #define FF_FS_LOCK		0
+#endif
 /* The option FF_FS_LOCK switches file lock function to control duplicated file open
 /  and illegal operation to open objects. This option must be 0 when FF_FS_READONLY
 /  is 1.
@@ -266,26 +359,64 @@
 /      lock control is independent of re-entrancy. */
 
 
-/* #include <somertos.h>	// O/S definitions */
+#ifndef FF_FS_REENTRANT
 #define FF_FS_REENTRANT	0
+#endif
+#ifndef FF_FS_TIMEOUT
 #define FF_FS_TIMEOUT	1000
+#endif
+#ifndef FF_SYNC_PORT
+#define FF_SYNC_PORT	0
+#endif
+#if FF_FS_REENTRANT
+#if FF_SYNC_PORT == 1		/* FreeRTOS */
+#include "FreeRTOS.h"
+#include "semphr.h"
+#define FF_SYNC_t		SemaphoreHandle_t
+#elif FF_SYNC_PORT == 2		/* CMSIS-RTOS2 */
+#include "cmsis_os2.h"
+#define FF_SYNC_t		osMutexId_t
+#elif FF_SYNC_PORT == 3		/* Bare-metal spinlock */
+#define FF_SYNC_t		volatile unsigned char*
+#elif FF_SYNC_PORT == 4		/* POSIX threads */
+#include <pthread.h>
+#define FF_SYNC_t		pthread_mutex_t*
+#else						/* User provided */
+/* #include <somertos.h>	// O/S definitions */
 #define FF_SYNC_t		HANDLE
+#endif
+#endif
 /* The option FF_FS_REENTRANT switches the re-entrancy (thread safe) of the FatFs
 /  module itself. Note that regardless of this option, file access to different
 /  volume is always re-entrant and volume control functions, f_mount(), f_mkfs()
 /  and f_fdisk() function, are always not re-entrant. Only file/directory access
 /  to the same volume is under control of this function.
 /
-/   0: Disable re-entrancy. FF_FS_TIMEOUT and FF_SYNC_t have no effect.
-/   1: Enable re-entrancy. Also user provided synchronization handlers,
-/      ff_req_grant(), ff_rel_grant(), ff_del_syncobj() and ff_cre_syncobj()
-/      function, must be added to the project. Samples are available in
-/      option/syscall.c.
+/   0: Disable re-entrancy. FF_FS_TIMEOUT, FF_SYNC_PORT and FF_SYNC_t have no effect.
+/   1: Enable re-entrancy. Also synchronization handlers, ff_req_grant(),
+/      ff_rel_grant(), ff_del_syncobj() and ff_cre_syncobj() function, must be
+/      added to the project. They are available in ffsystem.c for the port
+/      selected by FF_SYNC_PORT.
+/
+/  Each volume has its own sync object, so that accesses to different volumes
+/  proceed in parallel. With FF_USE_LFN == 1, the LFN working buffer is held in
+/  each filesystem object instead of the static one. With FF_FS_LOCK > 0, an
+/  additional sync object guards the open object table shared by the volumes.
+/
+/  The FF_SYNC_PORT selects the implementation of the synchronization handlers
+/  in ffsystem.c and the FF_SYNC_t defines O/S dependent sync object type.
 /
-/  The FF_FS_TIMEOUT defines timeout period in unit of time tick.
-/  The FF_SYNC_t defines O/S dependent sync object type. e.g. HANDLE, ID, OS_EVENT*,
-/  SemaphoreHandle_t and etc. A header file for O/S definitions needs to be
-/  included somewhere in the scope of ff.h. */
+/   0: User provided. Define FF_SYNC_t (e.g. HANDLE, ID, OS_EVENT*) and the
+/      handlers in the project.
+/   1: FreeRTOS mutex. FF_FS_TIMEOUT is in unit of RTOS tick.
+/   2: CMSIS-RTOS2 mutex. FF_FS_TIMEOUT is in unit of kernel tick.
+/   3: Bare-metal spinlock. The lock is taken with interrupts masked, so that it
+/      can be used from interrupt context as well. A request that cannot get the
+/      grant waits FF_SYNC_YIELD() between the retries and fails with FR_TIMEOUT
+/      after FF_FS_TIMEOUT of them. The default FF_SYNC_YIELD() is a 1 ms busy
+/      wait on the DWT cycle counter, so FF_FS_TIMEOUT is in unit of millisecond.
+/      Define FF_SYNC_YIELD() to yield to a scheduler or to wait for interrupt.
+/   4: POSIX threads mutex. FF_FS_TIMEOUT is in unit of millisecond. */
 
 
 
@@ -54,7 +54,6 @@
 
 /* Additional file access control and file status flags for internal use */
 #define FA_SEEKEND	0x20	/* Seek to end of the file on file open */
-#define FA_MODIFIED	0x40	/* File has been modified */
 #define FA_DIRTY	0x80	/* FIL.buf[] needs to be written-back */
 
 
@@ -211,8 +210,8 @@
 
 /* Re-entrancy related */
 #if FF_FS_REENTRANT
-#if FF_USE_LFN == 1
-#error Static LFN work area cannot be used at thread-safe configuration
+#if FF_SYNC_PORT < 0 || FF_SYNC_PORT > 4
+#error Wrong FF_SYNC_PORT setting
 #endif
 #define LEAVE_FF(fs, res)	{ unlock_fs(fs, res); return res; }
 #else
@@ -252,6 +251,21 @@
 #endif
 
 
+/* Sector cache */
+#if FF_USE_CACHE
+#if FF_CACHE_FATSECT < 0 || FF_CACHE_DIRSECT < 0 || FF_CACHE_FATSECT + FF_CACHE_DIRSECT == 0 || FF_CACHE_FATSECT + FF_CACHE_DIRSECT > 255
+#error Wrong FF_CACHE_FATSECT or FF_CACHE_DIRSECT setting
+#endif
+#define N_CACHE	(FF_CACHE_FATSECT + FF_CACHE_DIRSECT)
+#endif
+
+
+/* Directory entry cache */
+#if FF_USE_DIRCACHE && (FF_DIRCACHE_SIZE < 2 || FF_DIRCACHE_SIZE % 2)
+#error FF_DIRCACHE_SIZE must be an even number of 2 or larger
+#endif
+
+
 /* File lock controls */
 #if FF_FS_LOCK != 0
 #if FF_FS_READONLY
@@ -444,6 +458,10 @@ static BYTE CurrVol;				/* Current drive */
 
 #if FF_FS_LOCK != 0
 static FILESEM Files[FF_FS_LOCK];	/* Open object lock semaphores */
+#if FF_FS_REENTRANT
+static FF_SYNC_t SysObj;			/* Sync object to guard Files[] shared by the volumes */
+static BYTE SysObjValid;			/* SysObj has been created */
+#endif
 #endif
 
 #if FF_STR_VOLUME_ID
@@ -480,10 +498,12 @@ static const BYTE LfnOfs[] = {1,3,5,7,9,14,16,18,20,22,24,28,30};	/* FAT: Offset
 #define MAXDIRB(nc)	((nc + 44U) / 15 * SZDIRE)	/* exFAT: Size of directory entry block scratchpad buffer needed for the name length */
 
 #if FF_USE_LFN == 1		/* LFN enabled with static working buffer */
+#if !FF_FS_REENTRANT	/* The buffers are in each filesystem object at thread-safe configuration */
 #if FF_FS_EXFAT
 static BYTE	DirBuf[MAXDIRB(FF_MAX_LFN)];	/* Directory entry block scratchpad buffer */
 #endif
 static WCHAR LfnBuf[FF_MAX_LFN + 1];		/* LFN working buffer */
+#endif
 #define DEF_NAMBUF
 #define INIT_NAMBUF(fs)
 #define FREE_NAMBUF()
@@ -930,6 +950,13 @@ static void unlock_fs (
 /*-----------------------------------------------------------------------*/
 /* File lock control functions                                           */
 /*-----------------------------------------------------------------------*/
+#if FF_FS_REENTRANT
+#define LOCK_SYS()		ff_req_grant(SysObj)	/* Files[] is shared by the volumes locked individually */
+#define UNLOCK_SYS()	ff_rel_grant(SysObj)
+#else
+#define LOCK_SYS()		1
+#define UNLOCK_SYS()
+#endif
 
 static FRESULT chk_lock (	/* Check if the file can be accessed */
 	DIR* dp,		/* Directory object pointing the file to be checked */
@@ -937,6 +964,10 @@ static FRESULT chk_lock (	/* Check if the file can be accessed */
 )
 {
 	UINT i, be;
+	FRESULT res;
+
+
+	if (!LOCK_SYS()) return FR_TIMEOUT;
 
 	/* Search open object table for the object */
 	be = 0;
@@ -950,11 +981,14 @@ static FRESULT chk_lock (	/* Check if the file can be accessed */
 		}
 	}
 	if (i == FF_FS_LOCK) {	/* The object has not been opened */
-		return (!be && acc != 2) ? FR_TOO_MANY_OPEN_FILES : FR_OK;	/* Is there a blank entry for new object? */
+		res = (!be && acc != 2) ? FR_TOO_MANY_OPEN_FILES : FR_OK;	/* Is there a blank entry for new object? */
+	} else {
+		/* The object was opened. Reject any open against writing file and all write mode open */
+		res = (acc != 0 || Files[i].ctr == 0x100) ? FR_LOCKED : FR_OK;
 	}
 
-	/* The object was opened. Reject any open against writing file and all write mode open */
-	return (acc != 0 || Files[i].ctr == 0x100) ? FR_LOCKED : FR_OK;
+	UNLOCK_SYS();
+	return res;
 }
 
 
@@ -962,7 +996,10 @@ static int enq_lock (void)	/* Check if an entry is available for a new object */
 {
 	UINT i;
 
+
+	if (!LOCK_SYS()) return 0;
 	for (i = 0; i < FF_FS_LOCK && Files[i].fs; i++) ;
+	UNLOCK_SYS();
 	return (i == FF_FS_LOCK) ? 0 : 1;
 }
 
@@ -975,6 +1012,7 @@ static UINT inc_lock (	/* Increment object open counter and returns its index (0
 	UINT i;
 
 
+	if (!LOCK_SYS()) return 0;
 	for (i = 0; i < FF_FS_LOCK; i++) {	/* Find the object */
 		if (Files[i].fs == dp->obj.fs &&
 			Files[i].clu == dp->obj.sclust &&
@@ -983,17 +1021,24 @@ static UINT inc_lock (	/* Increment object open counter and returns its index (0
 
 	if (i == FF_FS_LOCK) {				/* Not opened. Register it as new. */
 		for (i = 0; i < FF_FS_LOCK && Files[i].fs; i++) ;
-		if (i == FF_FS_LOCK) return 0;	/* No free entry to register (int err) */
+		if (i == FF_FS_LOCK) {			/* No free entry to register (int err) */
+			UNLOCK_SYS();
+			return 0;
+		}
 		Files[i].fs = dp->obj.fs;
 		Files[i].clu = dp->obj.sclust;
 		Files[i].ofs = dp->dptr;
 		Files[i].ctr = 0;
 	}
 
-	if (acc >= 1 && Files[i].ctr) return 0;	/* Access violation (int err) */
+	if (acc >= 1 && Files[i].ctr) {		/* Access violation (int err) */
+		UNLOCK_SYS();
+		return 0;
+	}
 
 	Files[i].ctr = acc ? 0x100 : Files[i].ctr + 1;	/* Set semaphore value */
 
+	UNLOCK_SYS();
 	return i + 1;	/* Index number origin from 1 */
 }
 
@@ -1006,6 +1051,7 @@ static FRESULT dec_lock (	/* Decrement object open counter */
 	FRESULT res;
 
 
+	if (!LOCK_SYS()) return FR_TIMEOUT;
 	if (--i < FF_FS_LOCK) {	/* Index number origin from 0 */
 		n = Files[i].ctr;
 		if (n == 0x100) n = 0;		/* If write mode open, delete the entry */
@@ -1016,6 +1062,7 @@ static FRESULT dec_lock (	/* Decrement object open counter */
 	} else {
 		res = FR_INT_ERR;			/* Invalid index nunber */
 	}
+	UNLOCK_SYS();
 	return res;
 }
 
@@ -1025,10 +1072,14 @@ static void clear_lock (	/* Clear lock entries of the volume */
 )
 {
 	UINT i;
+	int lk;
+
 
+	lk = LOCK_SYS();
 	for (i = 0; i < FF_FS_LOCK; i++) {
 		if (Files[i].fs == fs) Files[i].fs = 0;
 	}
+	if (lk) UNLOCK_SYS();
 }
 
 #endif	/* FF_FS_LOCK != 0 */
@@ -1039,6 +1090,20 @@ static void clear_lock (	/* Clear lock entries of the volume */
 /* Move/Flush disk access window in the filesystem object                */
 /*-----------------------------------------------------------------------*/
 #if !FF_FS_READONLY
+static FRESULT write_sector (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs,			/* Filesystem object */
+	const BYTE* buff,	/* Sector data to be written */
+	DWORD sect			/* Sector to write */
+)
+{
+	if (disk_write(fs->pdrv, buff, sect, 1) != RES_OK) return FR_DISK_ERR;	/* Write back the sector */
+	if (sect - fs->fatbase < fs->fsize) {	/* Is it in the 1st FAT? */
+		if (fs->n_fats == 2) disk_write(fs->pdrv, buff, sect + fs->fsize, 1);	/* Reflect it to 2nd FAT if needed */
+	}
+	return FR_OK;
+}
+
+
 static FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERR */
 	FATFS* fs			/* Filesystem object */
 )
@@ -1047,20 +1112,154 @@ static FRESULT sync_window (	/* Returns FR_OK or FR_DISK_ERR */
 
 
 	if (fs->wflag) {	/* Is the disk access window dirty */
-		if (disk_write(fs->pdrv, fs->win, fs->winsect, 1) == RES_OK) {	/* Write back the window */
-			fs->wflag = 0;	/* Clear window dirty flag */
-			if (fs->winsect - fs->fatbase < fs->fsize) {	/* Is it in the 1st FAT? */
-				if (fs->n_fats == 2) disk_write(fs->pdrv, fs->win, fs->winsect + fs->fsize, 1);	/* Reflect it to 2nd FAT if needed */
-			}
-		} else {
-			res = FR_DISK_ERR;
-		}
+		res = write_sector(fs, fs->win, fs->winsect);	/* Write back the window */
+		if (res == FR_OK) fs->wflag = 0;	/* Clear window dirty flag */
 	}
 	return res;
 }
 #endif
 
 
+#if FF_USE_CACHE
+/*-----------------------------------------------------------------------*/
+/* Sector cache beneath the window                                       */
+/*-----------------------------------------------------------------------*/
+/* A sector is held either in the window or in a cache slot, never in both.
+/  The window is stored into the cache when it moves away and is loaded back
+/  from the cache on a hit, so the dirty state follows the sector data. */
+
+static UINT cache_part (	/* Returns index of the first slot of the partition */
+	FATFS* fs,			/* Filesystem object */
+	DWORD sect,			/* Sector to be cached */
+	UINT* n				/* Number of slots in the partition */
+)
+{
+	if ((sect - fs->fatbase < fs->fsize && FF_CACHE_FATSECT > 0) || FF_CACHE_DIRSECT == 0) {	/* FAT area? */
+		*n = FF_CACHE_FATSECT;
+		return 0;
+	}
+	*n = FF_CACHE_DIRSECT;
+	return FF_CACHE_FATSECT;
+}
+
+
+static FRESULT cache_store (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs			/* Filesystem object */
+)
+{
+	UINT i, n, v;
+
+
+	if (fs->winsect == 0xFFFFFFFF) return FR_OK;	/* Window is not valid */
+	i = cache_part(fs, fs->winsect, &n);
+	for (v = i; n; i++, n--) {	/* Find a blank slot or the least recently used one */
+		if (fs->c_sect[i] == 0xFFFFFFFF) { v = i; break; }
+		if (fs->c_lru[i] - fs->c_lru[v] > 0x7FFFFFFF) v = i;
+	}
+#if !FF_FS_READONLY
+	if ((fs->c_flag[v] & 1) && fs->c_sect[v] != 0xFFFFFFFF) {	/* Write back the victim if it is dirty */
+		if (write_sector(fs, fs->c_buf[v], fs->c_sect[v]) != FR_OK) return FR_DISK_ERR;
+	}
+#endif
+	mem_cpy(fs->c_buf[v], fs->win, SS(fs));
+	fs->c_sect[v] = fs->winsect;
+	fs->c_flag[v] = fs->wflag;
+	fs->c_lru[v] = ++fs->c_seq;
+	fs->wflag = 0;
+	return FR_OK;
+}
+
+
+static int cache_load (	/* 1:Hit, 0:Miss */
+	FATFS* fs,			/* Filesystem object */
+	DWORD sect			/* Sector to be loaded into the window */
+)
+{
+	UINT i, n;
+
+
+	for (i = cache_part(fs, sect, &n); n; i++, n--) {
+		if (fs->c_sect[i] == sect) {	/* Hit: move the sector to the window with its dirty state */
+			mem_cpy(fs->win, fs->c_buf[i], SS(fs));
+			fs->wflag = fs->c_flag[i];
+			fs->c_sect[i] = 0xFFFFFFFF;
+			fs->c_hit++;
+			return 1;
+		}
+	}
+	fs->c_miss++;
+	return 0;
+}
+
+
+static void cache_discard (
+	FATFS* fs,			/* Filesystem object */
+	DWORD sect,			/* Top of the sector range overwritten or released */
+	UINT cnt			/* Number of sectors */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < N_CACHE; i++) {
+		if (fs->c_sect[i] - sect < cnt) {
+			fs->c_sect[i] = 0xFFFFFFFF;
+			fs->c_flag[i] = 0;
+		}
+	}
+}
+
+
+static void cache_reset (
+	FATFS* fs			/* Filesystem object */
+)
+{
+	cache_discard(fs, 0, 0xFFFFFFFF);	/* Drop all slots without write-back */
+	fs->c_seq = 0;
+	fs->c_hit = fs->c_miss = 0;
+}
+
+
+#if !FF_FS_READONLY
+static FRESULT cache_flush (	/* Returns FR_OK or FR_DISK_ERR */
+	FATFS* fs			/* Filesystem object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < N_CACHE; i++) {	/* FAT partition comes first */
+		if ((fs->c_flag[i] & 1) && fs->c_sect[i] != 0xFFFFFFFF) {
+			if (write_sector(fs, fs->c_buf[i], fs->c_sect[i]) != FR_OK) return FR_DISK_ERR;
+			fs->c_flag[i] = 0;
+		}
+	}
+	return FR_OK;
+}
+
+
+#if FF_FS_TINY && FF_FS_MINIMIZE <= 2
+static void cache_merge (
+	FATFS* fs,			/* Filesystem object */
+	BYTE* buff,			/* Data read directly from the disk */
+	DWORD sect,			/* Top sector of the data */
+	UINT cnt			/* Number of sectors */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < N_CACHE; i++) {	/* Replace the sectors that are dirty in the cache */
+		if ((fs->c_flag[i] & 1) && fs->c_sect[i] - sect < cnt) {
+			mem_cpy(buff + ((fs->c_sect[i] - sect) * SS(fs)), fs->c_buf[i], SS(fs));
+		}
+	}
+}
+#endif
+#endif	/* !FF_FS_READONLY */
+#endif	/* FF_USE_CACHE */
+
+
 static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 	FATFS* fs,			/* Filesystem object */
 	DWORD sector		/* Sector number to make appearance in the fs->win[] */
@@ -1070,7 +1269,13 @@ static FRESULT move_window (	/* Returns FR_OK or FR_DISK_ERR */
 
 
 	if (sector != fs->winsect) {	/* Window offset changed? */
-#if !FF_FS_READONLY
+#if FF_USE_CACHE
+		res = cache_store(fs);		/* Put the window into the cache */
+		if (res == FR_OK && cache_load(fs, sector)) {	/* Is the new sector in the cache? */
+			fs->winsect = sector;
+			return FR_OK;
+		}
+#elif !FF_FS_READONLY
 		res = sync_window(fs);		/* Write-back changes */
 #endif
 		if (res == FR_OK) {			/* Fill sector window with new data */
@@ -1100,6 +1305,9 @@ static FRESULT sync_fs (	/* Returns FR_OK or FR_DISK_ERR */
 
 
 	res = sync_window(fs);
+#if FF_USE_CACHE
+	if (res == FR_OK) res = cache_flush(fs);	/* Write-back dirty sectors in the cache */
+#endif
 	if (res == FR_OK) {
 		if (fs->fs_type == FS_FAT32 && fs->fsi_flag == 1) {	/* FAT32: Update FSInfo sector if needed */
 			/* Create FSInfo structure */
@@ -1111,6 +1319,9 @@ static FRESULT sync_fs (	/* Returns FR_OK or FR_DISK_ERR */
 			st_dword(fs->win + FSI_Nxt_Free, fs->last_clst);
 			/* Write it into the FSInfo sector */
 			fs->winsect = fs->volbase + 1;
+#if FF_USE_CACHE
+			cache_discard(fs, fs->winsect, 1);
+#endif
 			disk_write(fs->pdrv, fs->win, fs->winsect, 1);
 			fs->fsi_flag = 0;
 		}
@@ -1218,6 +1429,62 @@ static DWORD get_fat (		/* 0xFFFFFFFF:Disk error, 1:Internal error, 2..0x7FFFFFF
 
 
 
+#if FF_USE_FREEMAP && !FF_FS_READONLY
+/*-----------------------------------------------------------------------*/
+/* FAT access - Free cluster map                                         */
+/*-----------------------------------------------------------------------*/
+/* A bit in the map stands for a group of 2^fm_shift clusters. It is set when
+/  a cluster in the group is freed and cleared only when all clusters in the
+/  group are found in use, so that a cleared bit guarantees the group has no
+/  free cluster. */
+
+static void fm_init (
+	FATFS* fs,		/* Filesystem object */
+	BYTE val		/* 0xFF:Every group may have free cluster, 0:Every group is in use */
+)
+{
+	mem_set(fs->freemap, val, sizeof fs->freemap);
+}
+
+
+static int fm_test (	/* 0:Group is in use, !=0:Group may have free cluster */
+	FATFS* fs,		/* Filesystem object */
+	DWORD clst		/* Cluster number in the group */
+)
+{
+	clst >>= fs->fm_shift;
+	return fs->freemap[clst / 8] & (1 << (clst % 8));
+}
+
+
+static void fm_mark (
+	FATFS* fs,		/* Filesystem object */
+	DWORD clst,		/* Cluster number in the group */
+	int avail		/* 0:Group is in use, 1:Group may have free cluster */
+)
+{
+	clst >>= fs->fm_shift;
+	if (avail) {
+		fs->freemap[clst / 8] |= (BYTE)(1 << (clst % 8));
+	} else {
+		fs->freemap[clst / 8] &= (BYTE)~(1 << (clst % 8));
+	}
+}
+
+
+static DWORD fm_next (	/* Returns the top cluster of the next group */
+	FATFS* fs,		/* Filesystem object */
+	DWORD clst		/* Cluster number in the group */
+)
+{
+	return ((clst >> fs->fm_shift) + 1) << fs->fm_shift;
+}
+
+#endif /* FF_USE_FREEMAP && !FF_FS_READONLY */
+
+
+
+
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* FAT access - Change value of a FAT entry                              */
@@ -1235,6 +1502,9 @@ static FRESULT put_fat (	/* FR_OK(0):succeeded, !=0:error */
 
 
 	if (clst >= 2 && clst < fs->n_fatent) {	/* Check if in valid range */
+#if FF_USE_FREEMAP
+		if (val == 0) fm_mark(fs, clst, 1);	/* The group gets a free cluster */
+#endif
 		switch (fs->fs_type) {
 		case FS_FAT12 :
 			bc = (UINT)clst; bc += bc / 2;	/* bc: byte offset of the entry */
@@ -1408,6 +1678,137 @@ static FRESULT fill_last_frag (
 
 
 
+#if FF_USE_FASTSEEK
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Create a cluster link map table                        */
+/*-----------------------------------------------------------------------*/
+
+static FRESULT create_clmt (	/* FR_OK, FR_NOT_ENOUGH_CORE:Table is too small, FR_INT_ERR or FR_DISK_ERR */
+	FIL* fp			/* Pointer to the file object with the table to be filled */
+)
+{
+	DWORD cl, pcl, ncl, tcl, tlen, ulen, *tbl;
+	FATFS *fs = fp->obj.fs;
+
+
+	tbl = fp->cltbl;
+	tlen = *tbl++; ulen = 2;	/* Given table size and required table size */
+	cl = fp->obj.sclust;		/* Origin of the chain */
+	if (cl != 0) {
+		do {
+			/* Get a fragment */
+			tcl = cl; ncl = 0; ulen += 2;	/* Top, length and used items */
+			do {
+				pcl = cl; ncl++;
+				cl = get_fat(&fp->obj, cl);
+				if (cl <= 1) return FR_INT_ERR;
+				if (cl == 0xFFFFFFFF) return FR_DISK_ERR;
+			} while (cl == pcl + 1);
+			if (ulen <= tlen) {		/* Store the length and top of the fragment */
+				*tbl++ = ncl; *tbl++ = tcl;
+			}
+		} while (cl < fs->n_fatent);	/* Repeat until end of chain */
+	}
+	*fp->cltbl = ulen;	/* Number of items used */
+	if (ulen > tlen) return FR_NOT_ENOUGH_CORE;	/* Given table size is smaller than required */
+	*tbl = 0;		/* Terminate table */
+	return FR_OK;
+}
+
+
+#if FF_CLMT_SLOTS
+/*-----------------------------------------------------------------------*/
+/* FAT handling - Link map tables managed in the filesystem object       */
+/*-----------------------------------------------------------------------*/
+
+static void clmt_attach (
+	FIL* fp			/* Pointer to the file object to switch to fast seek mode */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	UINT i, v;
+
+
+	if (fp->cltbl || fp->obj.sclust == 0 || fp->obj.objsize < FF_CLMT_MINSIZE) return;
+#if !FF_FS_READONLY
+	if (fp->flag & FA_WRITE) return;	/* Only for the files opened in read-only mode */
+#endif
+	for (i = 0; i < FF_CLMT_SLOTS; i++) {	/* Find the table of the file */
+		if (fs->clmt_scl[i] == fp->obj.sclust && fs->clmt_size[i] == fp->obj.objsize) break;
+	}
+	if (i == FF_CLMT_SLOTS) {	/* Not found. Create it in a blank or least recently used slot */
+		for (v = FF_CLMT_SLOTS, i = 0; i < FF_CLMT_SLOTS; i++) {
+			if (fs->clmt_ref[i]) continue;
+			if (fs->clmt_scl[i] == 0) { v = i; break; }
+			if (v == FF_CLMT_SLOTS || fs->clmt_lru[i] - fs->clmt_lru[v] > 0x7FFFFFFF) v = i;
+		}
+		if (v == FF_CLMT_SLOTS) return;		/* All slots are in use */
+		i = v;
+		fs->clmt_scl[i] = 0;
+		fs->clmt[i][0] = FF_CLMT_ITEMS;
+		fp->cltbl = fs->clmt[i];
+		if (create_clmt(fp) != FR_OK) {
+			fs->clmt[i][0] = 0;		/* Do not retry on this file until it is evicted */
+		}
+		fp->cltbl = 0;
+		fs->clmt_scl[i] = fp->obj.sclust;
+		fs->clmt_size[i] = fp->obj.objsize;
+	}
+	fs->clmt_lru[i] = ++fs->clmt_seq;
+	if (fs->clmt[i][0] != 0) {	/* Use the table if valid */
+		fs->clmt_ref[i]++;
+		fp->cltbl = fs->clmt[i];
+	}
+}
+
+
+static void clmt_detach (
+	FIL* fp			/* Pointer to the file object to be closed */
+)
+{
+	FATFS *fs = fp->obj.fs;
+	UINT i;
+
+
+	for (i = 0; i < FF_CLMT_SLOTS; i++) {
+		if (fp->cltbl == fs->clmt[i] && fs->clmt_ref[i]) fs->clmt_ref[i]--;
+	}
+}
+
+
+static void clmt_forget (
+	FATFS* fs,		/* Filesystem object */
+	DWORD scl		/* Start cluster of the file whose chain is changed */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_CLMT_SLOTS; i++) {
+		if (fs->clmt_scl[i] == scl) fs->clmt_scl[i] = 0;	/* The slot gets blank when it is no longer in use */
+	}
+}
+
+
+static void clmt_reset (
+	FATFS* fs		/* Filesystem object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_CLMT_SLOTS; i++) {
+		fs->clmt_scl[i] = 0;
+		fs->clmt_ref[i] = 0;
+	}
+	fs->clmt_seq = 0;
+}
+
+#endif	/* FF_CLMT_SLOTS */
+#endif	/* FF_USE_FASTSEEK */
+
+
+
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
 /* FAT handling - Remove a cluster chain                                 */
@@ -1430,6 +1831,9 @@ static FRESULT remove_chain (	/* FR_OK(0):succeeded, !=0:error */
 #endif
 
 	if (clst < 2 || clst >= fs->n_fatent) return FR_INT_ERR;	/* Check if in valid range */
+#if FF_USE_FASTSEEK && FF_CLMT_SLOTS
+	clmt_forget(fs, pclst ? obj->sclust : clst);	/* Link map of the file gets invalid */
+#endif
 
 	/* Mark the previous cluster 'EOC' on the FAT if it exists */
 	if (pclst != 0 && (!FF_FS_EXFAT || fs->fs_type != FS_EXFAT || obj->stat != 2)) {
@@ -1451,6 +1855,9 @@ static FRESULT remove_chain (	/* FR_OK(0):succeeded, !=0:error */
 			fs->free_clst++;
 			fs->fsi_flag |= 1;
 		}
+#if FF_USE_CACHE
+		cache_discard(fs, clst2sect(fs, clst), fs->csize);	/* Cached sectors of the cluster are no longer valid */
+#endif
 #if FF_FS_EXFAT || FF_USE_TRIM
 		if (ecl + 1 == nxt) {	/* Is next cluster contiguous? */
 			ecl = nxt;
@@ -1516,6 +1923,9 @@ static DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:D
 	DWORD cs, ncl, scl;
 	FRESULT res;
 	FATFS *fs = obj->fs;
+#if FF_USE_FREEMAP
+	int gtop = 0;
+#endif
 
 
 	if (clst == 0) {	/* Create a new chain */
@@ -1578,9 +1988,24 @@ static DWORD create_chain (	/* 0:No free cluster, 1:Internal error, 0xFFFFFFFF:D
 					ncl = 2;
 					if (ncl > scl) return 0;	/* No free cluster found? */
 				}
+#if FF_USE_FREEMAP
+				if (!fm_test(fs, ncl)) {		/* Skip the group that has no free cluster */
+					cs = fm_next(fs, ncl);
+					if (scl - ncl < cs - ncl) return 0;	/* No free cluster found? (start cluster is in the group) */
+					ncl = cs - 1; gtop = 0;
+					continue;
+				}
+				if (ncl == 2 || fm_next(fs, ncl - 1) == ncl) gtop = 1;	/* Scanning the group from its top */
+#endif
 				cs = get_fat(obj, ncl);			/* Get the cluster status */
 				if (cs == 0) break;				/* Found a free cluster? */
 				if (cs == 1 || cs == 0xFFFFFFFF) return cs;	/* Test for error */
+#if FF_USE_FREEMAP
+				if (gtop && (fm_next(fs, ncl) == ncl + 1 || ncl + 1 == fs->n_fatent)) {	/* Whole group is in use? */
+					fm_mark(fs, ncl, 0);
+					gtop = 0;
+				}
+#endif
 				if (ncl == scl) return 0;		/* No free cluster found? */
 			}
 		}
@@ -1654,6 +2079,9 @@ static FRESULT dir_clear (	/* Returns FR_OK or FR_DISK_ERR */
 	if (sync_window(fs) != FR_OK) return FR_DISK_ERR;	/* Flush disk access window */
 	sect = clst2sect(fs, clst);		/* Top of the cluster */
 	fs->winsect = sect;				/* Set window to top of the cluster */
+#if FF_USE_CACHE
+	cache_discard(fs, sect, fs->csize);	/* Drop stale sectors of the cluster */
+#endif
 	mem_set(fs->win, 0, sizeof fs->win);	/* Clear window buffer */
 #if FF_USE_LFN == 3		/* Quick table clear by using multi-secter write */
 	/* Allocate a temporary buffer */
@@ -2406,11 +2834,12 @@ static FRESULT dir_read (
 
 
 /*-----------------------------------------------------------------------*/
-/* Directory handling - Find an object in the directory                  */
+/* Directory handling - Find the name in the FAT/FAT32 directory        */
 /*-----------------------------------------------------------------------*/
 
-static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
-	DIR* dp					/* Pointer to the directory object with the file name */
+static FRESULT dir_scan (	/* FR_OK(0):succeeded, !=0:error */
+	DIR* dp,				/* Pointer to the directory object with the file name */
+	DWORD lim				/* Offset of the last entry to be checked */
 )
 {
 	FRESULT res;
@@ -2418,32 +2847,8 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 	BYTE c;
 #if FF_USE_LFN
 	BYTE a, ord, sum;
-#endif
 
-	res = dir_sdi(dp, 0);			/* Rewind directory object */
-	if (res != FR_OK) return res;
-#if FF_FS_EXFAT
-	if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
-		BYTE nc;
-		UINT di, ni;
-		WORD hash = xname_sum(fs->lfnbuf);		/* Hash value of the name to find */
 
-		while ((res = DIR_READ_FILE(dp)) == FR_OK) {	/* Read an item */
-#if FF_MAX_LFN < 255
-			if (fs->dirbuf[XDIR_NumName] > FF_MAX_LFN) continue;			/* Skip comparison if inaccessible object name */
-#endif
-			if (ld_word(fs->dirbuf + XDIR_NameHash) != hash) continue;	/* Skip comparison if hash mismatched */
-			for (nc = fs->dirbuf[XDIR_NumName], di = SZDIRE * 2, ni = 0; nc; nc--, di += 2, ni++) {	/* Compare the name */
-				if ((di % SZDIRE) == 0) di += 2;
-				if (ff_wtoupper(ld_word(fs->dirbuf + di)) != ff_wtoupper(fs->lfnbuf[ni])) break;
-			}
-			if (nc == 0 && !fs->lfnbuf[ni]) break;	/* Name matched? */
-		}
-		return res;
-	}
-#endif
-	/* On the FAT/FAT32 volume */
-#if FF_USE_LFN
 	ord = sum = 0xFF; dp->blk_ofs = 0xFFFFFFFF;	/* Reset LFN sequence */
 #endif
 	do {
@@ -2476,6 +2881,7 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 		dp->obj.attr = dp->dir[DIR_Attr] & AM_MASK;
 		if (!(dp->dir[DIR_Attr] & AM_VOL) && !mem_cmp(dp->dir, dp->fn, 11)) break;	/* Is it a valid entry? */
 #endif
+		if (dp->dptr >= lim) { res = FR_NO_FILE; break; }	/* Reached to the last entry to be checked */
 		res = dir_next(dp, 0);	/* Next entry */
 	} while (res == FR_OK);
 
@@ -2484,6 +2890,193 @@ static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
 
 
 
+#if FF_USE_DIRCACHE
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Directory entry cache                            */
+/*-----------------------------------------------------------------------*/
+/* Each slot holds the location of an entry found by dir_find(), keyed by
+/  the start cluster of the directory and the hash of the name. It is only a
+/  hint: the entry at the location is compared with the name again. The slots
+/  are grouped in 2-way sets and the first slot of a set is the recently used.
+*/
+
+#define DC_SET(dsc, h)	((UINT)(((dsc) * 0x9E3779B1 + (h)) % (FF_DIRCACHE_SIZE / 2)) * 2)	/* First slot of the set for a name */
+
+static void dc_swap (
+	FATFS* fs,				/* Filesystem object */
+	UINT i					/* First slot of the set */
+)
+{
+	DWORD t;
+
+
+	t = fs->dc_dsc[i]; fs->dc_dsc[i] = fs->dc_dsc[i + 1]; fs->dc_dsc[i + 1] = t;
+	t = fs->dc_hash[i]; fs->dc_hash[i] = fs->dc_hash[i + 1]; fs->dc_hash[i + 1] = t;
+	t = fs->dc_ofs[i]; fs->dc_ofs[i] = fs->dc_ofs[i + 1]; fs->dc_ofs[i + 1] = t;
+	t = fs->dc_ptr[i]; fs->dc_ptr[i] = fs->dc_ptr[i + 1]; fs->dc_ptr[i + 1] = t;
+}
+
+
+static DWORD dc_hash (	/* Hash value of the name */
+	DIR* dp				/* Directory object with the file name */
+)
+{
+	DWORD h = 0;
+#if FF_USE_LFN
+	const WCHAR *p = dp->obj.fs->lfnbuf;
+
+
+	while (*p) h = h * 31 + ff_wtoupper(*p++);	/* The name is case-insensitive */
+#else
+	UINT i;
+
+
+	for (i = 0; i < 11; i++) h = h * 31 + dp->fn[i];
+#endif
+	return h;
+}
+
+
+static FRESULT dc_probe (	/* FR_OK:Found at the cached location, FR_NO_FILE:Not cached */
+	DIR* dp,				/* Directory object with the file name */
+	DWORD h					/* Hash value of the name */
+)
+{
+	FRESULT res;
+	FATFS *fs = dp->obj.fs;
+	UINT i = DC_SET(dp->obj.sclust, h);
+	DWORD ptr;
+
+
+	if (fs->dc_ptr[i] == 0xFFFFFFFF || fs->dc_dsc[i] != dp->obj.sclust || fs->dc_hash[i] != h) {
+		i++;	/* Check the second slot */
+		if (fs->dc_ptr[i] == 0xFFFFFFFF || fs->dc_dsc[i] != dp->obj.sclust || fs->dc_hash[i] != h) return FR_NO_FILE;
+	}
+	ptr = fs->dc_ptr[i];
+	res = dir_sdi(dp, fs->dc_ofs[i]);		/* Check the entry block at the cached location */
+	if (res == FR_OK) res = dir_scan(dp, ptr);
+	if (res == FR_OK && dp->dptr == ptr) {
+		if (i % 2) dc_swap(fs, i - 1);		/* Make it the recently used */
+		return FR_OK;
+	}
+	fs->dc_ptr[i] = 0xFFFFFFFF;				/* Discard the stale slot */
+	return FR_NO_FILE;
+}
+
+
+static void dc_store (
+	DIR* dp,				/* Directory object pointing the found entry */
+	DWORD h					/* Hash value of the name */
+)
+{
+	FATFS *fs = dp->obj.fs;
+	UINT i = DC_SET(dp->obj.sclust, h);
+
+
+	if (fs->dc_ptr[i] != 0xFFFFFFFF) dc_swap(fs, i);	/* Push out the least recently used */
+	fs->dc_dsc[i] = dp->obj.sclust;
+	fs->dc_hash[i] = h;
+#if FF_USE_LFN
+	fs->dc_ofs[i] = (dp->blk_ofs != 0xFFFFFFFF) ? dp->blk_ofs : dp->dptr;	/* Top of the entry block */
+#else
+	fs->dc_ofs[i] = dp->dptr;
+#endif
+	fs->dc_ptr[i] = dp->dptr;
+}
+
+
+#if !FF_FS_READONLY
+static void dc_forget (
+	FATFS* fs,				/* Filesystem object */
+	DWORD dsc,				/* Start cluster of the directory */
+	DWORD ofs,				/* Top of the changed entries */
+	DWORD ptr				/* Last of the changed entries */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_DIRCACHE_SIZE; i++) {	/* Discard the slots overlapping the entries */
+		if (fs->dc_ptr[i] != 0xFFFFFFFF && fs->dc_dsc[i] == dsc && fs->dc_ofs[i] <= ptr && fs->dc_ptr[i] >= ofs) {
+			fs->dc_ptr[i] = 0xFFFFFFFF;
+		}
+	}
+}
+#endif
+
+
+static void dc_reset (
+	FATFS* fs				/* Filesystem object */
+)
+{
+	UINT i;
+
+
+	for (i = 0; i < FF_DIRCACHE_SIZE; i++) fs->dc_ptr[i] = 0xFFFFFFFF;
+}
+
+#endif	/* FF_USE_DIRCACHE */
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Directory handling - Find an object in the directory                  */
+/*-----------------------------------------------------------------------*/
+
+static FRESULT dir_find (	/* FR_OK(0):succeeded, !=0:error */
+	DIR* dp					/* Pointer to the directory object with the file name */
+)
+{
+	FRESULT res;
+#if FF_FS_EXFAT
+	FATFS *fs = dp->obj.fs;
+#endif
+#if FF_USE_DIRCACHE
+	DWORD dch;
+#endif
+
+	res = dir_sdi(dp, 0);			/* Rewind directory object */
+	if (res != FR_OK) return res;
+#if FF_FS_EXFAT
+	if (fs->fs_type == FS_EXFAT) {	/* On the exFAT volume */
+		BYTE nc;
+		UINT di, ni;
+		WORD hash = xname_sum(fs->lfnbuf);		/* Hash value of the name to find */
+
+		while ((res = DIR_READ_FILE(dp)) == FR_OK) {	/* Read an item */
+#if FF_MAX_LFN < 255
+			if (fs->dirbuf[XDIR_NumName] > FF_MAX_LFN) continue;			/* Skip comparison if inaccessible object name */
+#endif
+			if (ld_word(fs->dirbuf + XDIR_NameHash) != hash) continue;	/* Skip comparison if hash mismatched */
+			for (nc = fs->dirbuf[XDIR_NumName], di = SZDIRE * 2, ni = 0; nc; nc--, di += 2, ni++) {	/* Compare the name */
+				if ((di % SZDIRE) == 0) di += 2;
+				if (ff_wtoupper(ld_word(fs->dirbuf + di)) != ff_wtoupper(fs->lfnbuf[ni])) break;
+			}
+			if (nc == 0 && !fs->lfnbuf[ni]) break;	/* Name matched? */
+		}
+		return res;
+	}
+#endif
+	/* On the FAT/FAT32 volume */
+#if FF_USE_DIRCACHE
+#if FF_USE_LFN
+	if (!(dp->fn[NSFLAG] & NS_NOLFN))	/* Not for the collision check of numbered SFN */
+#endif
+	{
+		dch = dc_hash(dp);
+		if (dc_probe(dp, dch) == FR_OK) return FR_OK;	/* Found at the cached location? */
+		res = dir_sdi(dp, 0);
+		if (res != FR_OK) return res;
+		res = dir_scan(dp, 0xFFFFFFFF);
+		if (res == FR_OK) dc_store(dp, dch);	/* Cache the location of the found entry */
+		return res;
+	}
+#endif
+	return dir_scan(dp, 0xFFFFFFFF);
+}
+
+
+
 
 #if !FF_FS_READONLY
 /*-----------------------------------------------------------------------*/
@@ -2552,6 +3145,9 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 	/* Create an SFN with/without LFNs. */
 	nent = (sn[NSFLAG] & NS_LFN) ? (nlen + 12) / 13 + 1 : 1;	/* Number of entries to allocate */
 	res = dir_alloc(dp, nent);		/* Allocate entries */
+#if FF_USE_DIRCACHE
+	if (res == FR_OK) dc_forget(fs, dp->obj.sclust, dp->dptr - (nent - 1) * SZDIRE, dp->dptr);
+#endif
 	if (res == FR_OK && --nent) {	/* Set LFN entry if needed */
 		res = dir_sdi(dp, dp->dptr - nent * SZDIRE);
 		if (res == FR_OK) {
@@ -2568,6 +3164,9 @@ static FRESULT dir_register (	/* FR_OK:succeeded, FR_DENIED:no free entry or too
 
 #else	/* Non LFN configuration */
 	res = dir_alloc(dp, 1);		/* Allocate an entry for SFN */
+#if FF_USE_DIRCACHE
+	if (res == FR_OK) dc_forget(fs, dp->obj.sclust, dp->dptr, dp->dptr);
+#endif
 
 #endif
 
@@ -2605,6 +3204,9 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 #if FF_USE_LFN		/* LFN configuration */
 	DWORD last = dp->dptr;
 
+#if FF_USE_DIRCACHE
+	dc_forget(fs, dp->obj.sclust, (dp->blk_ofs == 0xFFFFFFFF) ? last : dp->blk_ofs, last);
+#endif
 	res = (dp->blk_ofs == 0xFFFFFFFF) ? FR_OK : dir_sdi(dp, dp->blk_ofs);	/* Goto top of the entry block if LFN is exist */
 	if (res == FR_OK) {
 		do {
@@ -2623,6 +3225,9 @@ static FRESULT dir_remove (	/* FR_OK:Succeeded, FR_DISK_ERR:A disk error */
 	}
 #else			/* Non LFN configuration */
 
+#if FF_USE_DIRCACHE
+	dc_forget(fs, dp->obj.sclust, dp->dptr, dp->dptr);
+#endif
 	res = move_window(fs, dp->sect);
 	if (res == FR_OK) {
 		dp->dir[DIR_Name] = DDEM;	/* Mark the entry 'deleted'.*/
@@ -3188,6 +3793,9 @@ static BYTE check_fs (	/* 0:FAT, 1:exFAT, 2:Valid BS but not FAT, 3:Not a BS, 4:
 )
 {
 	fs->wflag = 0; fs->winsect = 0xFFFFFFFF;		/* Invaidate window */
+#if FF_USE_CACHE
+	cache_reset(fs);								/* Invalidate sector cache */
+#endif
 	if (move_window(fs, sect) != FR_OK) return 4;	/* Load boot record */
 
 	if (ld_word(fs->win + BS_55AA) != 0xAA55) return 3;	/* Check boot record signature (always here regardless of the sector size) */
@@ -3426,14 +4034,31 @@ static FRESULT find_volume (	/* FR_OK(0): successful, !=0: an error occurred */
 #endif	/* !FF_FS_READONLY */
 	}
 
+#if FF_USE_FREEMAP && !FF_FS_READONLY
+	for (fs->fm_shift = 0; (fs->n_fatent - 1) >> fs->fm_shift >= (DWORD)FF_FREEMAP_SIZE * 8; fs->fm_shift++) ;	/* Group size to fit the volume in the map */
+	fm_init(fs, 0xFF);		/* Every group may have free cluster until it is scanned */
+#endif
 	fs->fs_type = fmt;		/* FAT sub-type */
 	fs->id = ++Fsid;		/* Volume mount ID */
 #if FF_USE_LFN == 1
+#if FF_FS_REENTRANT
+	fs->lfnbuf = fs->lfnwork;	/* LFN working buffer of the volume */
+#if FF_FS_EXFAT
+	fs->dirbuf = fs->dirwork;	/* Directory block scratchpad buffer of the volume */
+#endif
+#else
 	fs->lfnbuf = LfnBuf;	/* Static LFN working buffer */
 #if FF_FS_EXFAT
 	fs->dirbuf = DirBuf;	/* Static directory block scratchpad buuffer */
 #endif
 #endif
+#endif
+#if FF_USE_FASTSEEK && FF_CLMT_SLOTS
+	clmt_reset(fs);			/* Discard the link maps of the previous mount */
+#endif
+#if FF_USE_DIRCACHE
+	dc_reset(fs);			/* Discard the entry locations of the previous mount */
+#endif
 #if FF_FS_RPATH != 0
 	fs->cdir = 0;			/* Initialize current directory */
 #endif
@@ -3524,6 +4149,12 @@ FRESULT f_mount (
 	if (fs) {
 		fs->fs_type = 0;				/* Clear new fs object */
 #if FF_FS_REENTRANT						/* Create sync object for the new volume */
+#if FF_FS_LOCK != 0
+		if (!SysObjValid) {				/* Create sync object for the open object table at first */
+			if (!ff_cre_syncobj(FF_VOLUMES, &SysObj)) return FR_INT_ERR;
+			SysObjValid = 1;
+		}
+#endif
 		if (!ff_cre_syncobj((BYTE)vol, &fs->sobj)) return FR_INT_ERR;
 #endif
 	}
@@ -3789,6 +4420,9 @@ FRESULT f_read (
 				if (fs->wflag && fs->winsect - sect < cc) {
 					mem_cpy(rbuff + ((fs->winsect - sect) * SS(fs)), fs->win, SS(fs));
 				}
+#if FF_USE_CACHE
+				cache_merge(fs, rbuff, sect, cc);
+#endif
 #else
 				if ((fp->flag & FA_DIRTY) && fp->sect - sect < cc) {
 					mem_cpy(rbuff + ((fp->sect - sect) * SS(fs)), fp->buf, SS(fs));
@@ -3905,6 +4539,9 @@ FRESULT f_write (
 					mem_cpy(fs->win, wbuff + ((fs->winsect - sect) * SS(fs)), SS(fs));
 					fs->wflag = 0;
 				}
+#if FF_USE_CACHE
+				cache_discard(fs, sect, cc);
+#endif
 #else
 				if (fp->sect - sect < cc) { /* Refill sector cache if it gets invalidated by the direct write */
 					mem_cpy(fp->buf, wbuff + ((fp->sect - sect) * SS(fs)), SS(fs));
@@ -3919,6 +4556,9 @@ FRESULT f_write (
 			if (fp->fptr >= fp->obj.objsize) {	/* Avoid silly cache filling on the growing edge */
 				if (sync_window(fs) != FR_OK) ABORT(fs, FR_DISK_ERR);
 				fs->winsect = sect;
+#if FF_USE_CACHE
+				cache_discard(fs, sect, 1);
+#endif
 			}
 #else
 			if (fp->sect != sect && 		/* Fill sector cache with file data */
@@ -4048,6 +4688,9 @@ FRESULT f_close (
 	{
 		res = validate(&fp->obj, &fs);	/* Lock volume */
 		if (res == FR_OK) {
+#if FF_USE_FASTSEEK && FF_CLMT_SLOTS
+			clmt_detach(fp);		/* Release the link map */
+#endif
 #if FF_FS_LOCK != 0
 			res = dec_lock(fp->obj.lockid);		/* Decrement file open counter */
 			if (res == FR_OK) fp->obj.fs = 0;	/* Invalidate file object */
@@ -4259,7 +4902,7 @@ FRESULT f_lseek (
 	DWORD clst, bcs, nsect;
 	FSIZE_t ifptr;
 #if FF_USE_FASTSEEK
-	DWORD cl, pcl, ncl, tcl, dsc, tlen, ulen, *tbl;
+	DWORD dsc;
 #endif
 
 	res = validate(&fp->obj, &fs);		/* Check validity of the file object */
@@ -4272,32 +4915,13 @@ FRESULT f_lseek (
 	if (res != FR_OK) LEAVE_FF(fs, res);
 
 #if FF_USE_FASTSEEK
+#if FF_CLMT_SLOTS
+	if (ofs != CREATE_LINKMAP) clmt_attach(fp);	/* Use a link map managed in the volume if applicable */
+#endif
 	if (fp->cltbl) {	/* Fast seek */
 		if (ofs == CREATE_LINKMAP) {	/* Create CLMT */
-			tbl = fp->cltbl;
-			tlen = *tbl++; ulen = 2;	/* Given table size and required table size */
-			cl = fp->obj.sclust;		/* Origin of the chain */
-			if (cl != 0) {
-				do {
-					/* Get a fragment */
-					tcl = cl; ncl = 0; ulen += 2;	/* Top, length and used items */
-					do {
-						pcl = cl; ncl++;
-						cl = get_fat(&fp->obj, cl);
-						if (cl <= 1) ABORT(fs, FR_INT_ERR);
-						if (cl == 0xFFFFFFFF) ABORT(fs, FR_DISK_ERR);
-					} while (cl == pcl + 1);
-					if (ulen <= tlen) {		/* Store the length and top of the fragment */
-						*tbl++ = ncl; *tbl++ = tcl;
-					}
-				} while (cl < fs->n_fatent);	/* Repeat until end of chain */
-			}
-			*fp->cltbl = ulen;	/* Number of items used */
-			if (ulen <= tlen) {
-				*tbl = 0;		/* Terminate table */
-			} else {
-				res = FR_NOT_ENOUGH_CORE;	/* Given table size is smaller than required */
-			}
+			res = create_clmt(fp);
+			if (res == FR_INT_ERR || res == FR_DISK_ERR) ABORT(fs, res);
 		} else {						/* Fast seek */
 			if (ofs > fp->obj.objsize) ofs = fp->obj.objsize;	/* Clip offset at the file size */
 			fp->fptr = ofs;				/* Set file pointer */
@@ -4652,13 +5276,21 @@ FRESULT f_getfree (
 		} else {
 			/* Scan FAT to obtain number of free clusters */
 			nfree = 0;
+#if FF_USE_FREEMAP
+			if (fs->fs_type != FS_EXFAT) fm_init(fs, 0);	/* Rebuild the free cluster map in this scan */
+#endif
 			if (fs->fs_type == FS_FAT12) {	/* FAT12: Scan bit field FAT entries */
 				clst = 2; obj.fs = fs;
 				do {
 					stat = get_fat(&obj, clst);
 					if (stat == 0xFFFFFFFF) { res = FR_DISK_ERR; break; }
 					if (stat == 1) { res = FR_INT_ERR; break; }
-					if (stat == 0) nfree++;
+					if (stat == 0) {
+						nfree++;
+#if FF_USE_FREEMAP
+						fm_mark(fs, clst, 1);
+#endif
+					}
 				} while (++clst < fs->n_fatent);
 			} else {
 #if FF_FS_EXFAT
@@ -4692,16 +5324,25 @@ FRESULT f_getfree (
 							if (res != FR_OK) break;
 						}
 						if (fs->fs_type == FS_FAT16) {
-							if (ld_word(fs->win + i) == 0) nfree++;
+							stat = ld_word(fs->win + i);
 							i += 2;
 						} else {
-							if ((ld_dword(fs->win + i) & 0x0FFFFFFF) == 0) nfree++;
+							stat = ld_dword(fs->win + i) & 0x0FFFFFFF;
 							i += 4;
 						}
+						if (stat == 0) {
+							nfree++;
+#if FF_USE_FREEMAP
+							fm_mark(fs, fs->n_fatent - clst, 1);
+#endif
+						}
 						i %= SS(fs);
 					} while (--clst);
 				}
 			}
+#if FF_USE_FREEMAP
+			if (res != FR_OK) fm_init(fs, 0xFF);	/* Partially scanned map is not reliable */
+#endif
 			*nclst = nfree;			/* Return the free clusters */
 			fs->free_clst = nfree;	/* Now free_clst is valid */
 			fs->fsi_flag |= 1;		/* FAT32: FSInfo is to be updated */
@@ -5405,6 +6046,16 @@ FRESULT f_expand (
 	{
 		scl = clst = stcl; ncl = 0;
 		for (;;) {	/* Find a contiguous cluster block */
+#if FF_USE_FREEMAP
+			if (!fm_test(fs, clst)) {	/* Skip the group that has no free cluster */
+				n = fm_next(fs, clst);
+				if (stcl - clst - 1 < n - clst - 1) { res = FR_DENIED; break; }	/* Start cluster is in the skipped part? */
+				clst = (n >= fs->n_fatent) ? 2 : n;
+				scl = clst; ncl = 0;
+				if (clst == stcl) { res = FR_DENIED; break; }
+				continue;
+			}
+#endif
 			n = get_fat(&fp->obj, clst);
 			if (++clst >= fs->n_fatent) clst = 2;
 			if (n == 1) { res = FR_INT_ERR; break; }
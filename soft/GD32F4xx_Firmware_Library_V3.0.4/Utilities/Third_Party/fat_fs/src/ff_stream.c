@@ -0,0 +1,240 @@
+/*!
+    \file    ff_stream.c
+    \brief   streaming writer on a pre-allocated contiguous file
+
+    \note    extension module of this FatFs tree, not part of the FatFs
+             release by ChaN or of the GigaDevice firmware library; it is
+             provided under the same terms as FatFs (see ff.h)
+*/
+
+#include <string.h>
+#include "ff_stream.h"
+
+#if FF_USE_EXPAND && !FF_FS_READONLY
+
+#if FF_MAX_SS == FF_MIN_SS
+#define STREAM_SS(fs)       ((UINT)FF_MAX_SS)
+#else
+#define STREAM_SS(fs)       ((UINT)(fs)->ssize)
+#endif
+
+/*!
+    \brief      get the number of sectors of the next media write
+    \param[in]  st: pointer to the streaming writer object
+    \param[out] none
+    \retval     number of sectors, up to the last erase block boundary the staging buffer can reach (0: extent is full)
+*/
+static UINT stream_chunk(FSTREAM *st)
+{
+    DWORD end, n;
+
+    end = st->sect + st->buf_sect;
+    if (end > st->sect_end) {
+        end = st->sect_end;
+    }
+    n = end / st->blk * st->blk;
+    if (n <= st->sect) {
+        /* the buffer does not reach the next boundary */
+        n = end;
+    }
+
+    return (UINT)(n - st->sect);
+}
+
+/*!
+    \brief      write sectors to the pre-allocated extent
+    \param[in]  st: pointer to the streaming writer object
+    \param[in]  data: pointer to the sector data
+    \param[in]  count: number of sectors to write
+    \param[out] none
+    \retval     FR_OK or FR_DISK_ERR
+*/
+static FRESULT stream_put(FSTREAM *st, const BYTE *data, UINT count)
+{
+    FATFS *fs = st->file.obj.fs;
+
+    if (RES_OK != disk_write(fs->pdrv, data, st->sect, count)) {
+        return FR_DISK_ERR;
+    }
+    st->sect += count;
+    st->written += (FSIZE_t)count * STREAM_SS(fs);
+
+    return FR_OK;
+}
+
+/*!
+    \brief      create a file and pre-allocate a contiguous extent for streaming
+    \note       the data are written to the media with disk_write() directly, in
+                multi-sector requests aligned to the erase block of the media
+                (GET_BLOCK_SIZE); the directory entry is updated only at the
+                checkpoints and on close. With FF_FS_REENTRANT, the disk driver
+                must accept requests from the stream and the other volume users
+                at the same time.
+    \param[in]  st: pointer to the streaming writer object
+    \param[in]  path: pointer to the file name
+    \param[in]  size: size of the extent to pre-allocate in bytes
+    \param[in]  buf: pointer to the staging buffer, a multiple of the erase block is recommended
+    \param[in]  bufsize: size of the staging buffer in bytes (at least a sector)
+    \param[in]  ckpt: checkpoint interval in bytes (0: only by f_stream_sync)
+    \param[out] none
+    \retval     FRESULT: FR_OK, FR_DENIED if no contiguous extent is available, or the error of f_open/f_expand
+*/
+FRESULT f_stream_open(FSTREAM *st, const TCHAR *path, FSIZE_t size, BYTE *buf, UINT bufsize, FSIZE_t ckpt)
+{
+    FIL *fp = &st->file;
+    FATFS *fs;
+    DWORD blk;
+    UINT ss;
+    FRESULT res;
+
+    res = f_open(fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (FR_OK != res) {
+        return res;
+    }
+
+    fs = fp->obj.fs;
+    ss = STREAM_SS(fs);
+    if ((NULL == buf) || (bufsize < ss)) {
+        res = FR_INVALID_PARAMETER;
+    } else {
+        /* allocate a contiguous extent, the FAT is written once here */
+        res = f_expand(fp, size, 1);
+    }
+
+    if (FR_OK == res) {
+        if ((RES_OK != disk_ioctl(fs->pdrv, GET_BLOCK_SIZE, &blk)) || (0U == blk)) {
+            blk = 1U;
+        }
+        st->buf = buf;
+        st->buf_sect = bufsize / ss;
+        st->fill = 0U;
+        st->blk = blk;
+        st->sect = fs->database + fs->csize * (fp->obj.sclust - 2U);
+        st->alloc = fp->obj.objsize;
+        st->sect_end = st->sect + (DWORD)((st->alloc + ss - 1U) / ss);
+        st->written = 0U;
+        st->ckpt_intv = ckpt;
+        st->chunk = stream_chunk(st);
+
+        /* record the allocation with no data yet */
+        res = f_stream_sync(st);
+    }
+
+    if (FR_OK != res) {
+        (void)f_close(fp);
+    }
+
+    return res;
+}
+
+/*!
+    \brief      write data to the stream
+    \note       full chunks are written from the caller's data without copy; the
+                rest is held in the staging buffer until a chunk is completed.
+                When the extent is full, *bw is less than len.
+    \param[in]  st: pointer to the streaming writer object
+    \param[in]  data: pointer to the data to write
+    \param[in]  len: number of bytes to write
+    \param[out] bw: number of bytes accepted
+    \retval     FRESULT: FR_OK or FR_DISK_ERR
+*/
+FRESULT f_stream_write(FSTREAM *st, const void *data, UINT len, UINT *bw)
+{
+    const BYTE *p = (const BYTE *)data;
+    const BYTE *src;
+    UINT ss = STREAM_SS(st->file.obj.fs);
+    UINT n, room;
+    FRESULT res = FR_OK;
+
+    *bw = 0U;
+    while ((len > 0U) && (st->chunk > 0U)) {
+        room = st->chunk * ss - st->fill;
+        n = (len < room) ? len : room;
+        if ((0U == st->fill) && (n == room)) {
+            src = p;
+        } else {
+            memcpy(st->buf + st->fill, p, n);
+            st->fill += n;
+            src = (st->fill == st->chunk * ss) ? st->buf : NULL;
+        }
+
+        if (NULL != src) {
+            res = stream_put(st, src, st->chunk);
+            if (FR_OK != res) {
+                break;
+            }
+            st->fill = 0U;
+            st->chunk = stream_chunk(st);
+        }
+        p += n;
+        len -= n;
+        *bw += n;
+    }
+
+    if ((FR_OK == res) && (0U != st->ckpt_intv) && (st->written >= st->ckpt_next)) {
+        res = f_stream_sync(st);
+    }
+
+    return res;
+}
+
+/*!
+    \brief      checkpoint the stream
+    \note       the directory entry gets the size of the data on the media; data
+                held in the staging buffer are not included
+    \param[in]  st: pointer to the streaming writer object
+    \param[out] none
+    \retval     FRESULT: result of f_sync
+*/
+FRESULT f_stream_sync(FSTREAM *st)
+{
+    FIL *fp = &st->file;
+
+    fp->obj.objsize = st->written;
+    fp->flag |= FA_MODIFIED;
+    st->ckpt_next = st->written + st->ckpt_intv;
+
+    return f_sync(fp);
+}
+
+/*!
+    \brief      flush the stream, trim the file to the written size and close it
+    \param[in]  st: pointer to the streaming writer object
+    \param[out] none
+    \retval     FRESULT: FR_OK or the first error met
+*/
+FRESULT f_stream_close(FSTREAM *st)
+{
+    FIL *fp = &st->file;
+    UINT ss = STREAM_SS(fp->obj.fs);
+    UINT n, bw;
+    FRESULT res = FR_OK, res2;
+
+    /* full sectors left in the buffer go to the media directly */
+    n = st->fill / ss;
+    if (n > 0U) {
+        res = stream_put(st, st->buf, n);
+    }
+
+    /* the last partial sector is written through the file object, then the
+       extent beyond the data is released and the entry gets the final size */
+    if (FR_OK == res) {
+        fp->obj.objsize = st->alloc;
+        fp->flag |= FA_MODIFIED;
+        res = f_lseek(fp, st->written);
+    }
+    if ((FR_OK == res) && (0U != (st->fill % ss))) {
+        res = f_write(fp, st->buf + n * ss, st->fill % ss, &bw);
+    }
+    if (FR_OK == res) {
+        res = f_truncate(fp);
+    }
+    st->fill = 0U;
+    st->chunk = 0U;
+
+    res2 = f_close(fp);
+
+    return (FR_OK != res) ? res : res2;
+}
+
+#endif /* FF_USE_EXPAND && !FF_FS_READONLY */
@@ -38,6 +38,37 @@ void ff_memfree (
 
 #if FF_FS_REENTRANT	/* Mutal exclusion */
 
+/* The sync objects are created for each volume (vol = 0..FF_VOLUMES-1) and,
+/  when FF_FS_LOCK > 0, for the open object table shared by all volumes
+/  (vol = FF_VOLUMES). The port is selected by FF_SYNC_PORT in ffconf.h. */
+
+#if FF_SYNC_PORT == 3
+#include "gd32f4xx.h"
+static volatile BYTE SpinLock[FF_VOLUMES + 1];	/* Lock flags (0:Free, 1:Taken) */
+
+#ifndef FF_SYNC_YIELD
+/* Default wait between the retries: 1 ms busy wait on the DWT cycle counter,
+/  which makes FF_FS_TIMEOUT the timeout in milliseconds. A project with a
+/  scheduler or a low power wait can define FF_SYNC_YIELD() to replace it. */
+static void sync_wait (void)
+{
+	uint32_t t0 = DWT->CYCCNT;
+
+	while (DWT->CYCCNT - t0 < SystemCoreClock / 1000U) ;
+}
+#define FF_SYNC_YIELD()	sync_wait()
+#define SYNC_DWT	1
+#endif
+
+#elif FF_SYNC_PORT == 4
+#include <time.h>
+#include <errno.h>
+static pthread_mutex_t Mutex[FF_VOLUMES + 1];	/* Table of POSIX mutex */
+
+#endif
+
+
+#if FF_SYNC_PORT != 0
 /*------------------------------------------------------------------------*/
 /* Create a Synchronization Object                                        */
 /*------------------------------------------------------------------------*/
@@ -46,35 +77,35 @@ void ff_memfree (
 /  When a 0 is returned, the f_mount() function fails with FR_INT_ERR.
 */
 
-//const osMutexDef_t Mutex[FF_VOLUMES];	/* Table of CMSIS-RTOS mutex */
-
-
 int ff_cre_syncobj (	/* 1:Function succeeded, 0:Could not create the sync object */
 	BYTE vol,			/* Corresponding volume (logical drive number) */
 	FF_SYNC_t* sobj		/* Pointer to return the created sync object */
 )
 {
-	/* Win32 */
-	*sobj = CreateMutex(NULL, FALSE, NULL);
-	return (int)(*sobj != INVALID_HANDLE_VALUE);
-
-	/* uITRON */
-//	T_CSEM csem = {TA_TPRI,1,1};
-//	*sobj = acre_sem(&csem);
-//	return (int)(*sobj > 0);
-
-	/* uC/OS-II */
-//	OS_ERR err;
-//	*sobj = OSMutexCreate(0, &err);
-//	return (int)(err == OS_NO_ERR);
-
-	/* FreeRTOS */
-//	*sobj = xSemaphoreCreateMutex();
-//	return (int)(*sobj != NULL);
-
-	/* CMSIS-RTOS */
-//	*sobj = osMutexCreate(&Mutex[vol]);
-//	return (int)(*sobj != NULL);
+#if FF_SYNC_PORT == 1		/* FreeRTOS */
+	(void)vol;
+	*sobj = xSemaphoreCreateMutex();
+	return (int)(*sobj != NULL);
+
+#elif FF_SYNC_PORT == 2		/* CMSIS-RTOS2 */
+	(void)vol;
+	*sobj = osMutexNew(NULL);
+	return (int)(*sobj != NULL);
+
+#elif FF_SYNC_PORT == 3		/* Bare-metal spinlock */
+#ifdef SYNC_DWT
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;	/* Start the cycle counter for sync_wait() */
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	SpinLock[vol] = 0;
+	*sobj = &SpinLock[vol];
+	return 1;
+
+#else						/* POSIX threads */
+	*sobj = &Mutex[vol];
+	return (int)(pthread_mutex_init(*sobj, NULL) == 0);
+
+#endif
 }
 
 
@@ -90,23 +121,21 @@ int ff_del_syncobj (	/* 1:Function succeeded, 0:Could not delete due to an error
 	FF_SYNC_t sobj		/* Sync object tied to the logical drive to be deleted */
 )
 {
-	/* Win32 */
-	return (int)CloseHandle(sobj);
+#if FF_SYNC_PORT == 1		/* FreeRTOS */
+	vSemaphoreDelete(sobj);
+	return 1;
 
-	/* uITRON */
-//	return (int)(del_sem(sobj) == E_OK);
+#elif FF_SYNC_PORT == 2		/* CMSIS-RTOS2 */
+	return (int)(osMutexDelete(sobj) == osOK);
 
-	/* uC/OS-II */
-//	OS_ERR err;
-//	OSMutexDel(sobj, OS_DEL_ALWAYS, &err);
-//	return (int)(err == OS_NO_ERR);
+#elif FF_SYNC_PORT == 3		/* Bare-metal spinlock */
+	*sobj = 0;
+	return 1;
 
-	/* FreeRTOS */
-//  vSemaphoreDelete(sobj);
-//	return 1;
+#else						/* POSIX threads */
+	return (int)(pthread_mutex_destroy(sobj) == 0);
 
-	/* CMSIS-RTOS */
-//	return (int)(osMutexDelete(sobj) == osOK);
+#endif
 }
 
 
@@ -121,22 +150,44 @@ int ff_req_grant (	/* 1:Got a grant to access the volume, 0:Could not get a gran
 	FF_SYNC_t sobj	/* Sync object to wait */
 )
 {
-	/* Win32 */
-	return (int)(WaitForSingleObject(sobj, FF_FS_TIMEOUT) == WAIT_OBJECT_0);
-
-	/* uITRON */
-//	return (int)(wai_sem(sobj) == E_OK);
-
-	/* uC/OS-II */
-//	OS_ERR err;
-//	OSMutexPend(sobj, FF_FS_TIMEOUT, &err));
-//	return (int)(err == OS_NO_ERR);
+#if FF_SYNC_PORT == 1		/* FreeRTOS */
+	return (int)(xSemaphoreTake(sobj, FF_FS_TIMEOUT) == pdTRUE);
+
+#elif FF_SYNC_PORT == 2		/* CMSIS-RTOS2 */
+	return (int)(osMutexAcquire(sobj, FF_FS_TIMEOUT) == osOK);
+
+#elif FF_SYNC_PORT == 3		/* Bare-metal spinlock */
+	UINT n = FF_FS_TIMEOUT;
+	uint32_t pm;
+	int ok;
+
+	/* The flag is tested and set with interrupts masked, so that an interrupt
+	/  handler racing with the thread cannot take the same volume. A context
+	/  that finds the volume taken waits FF_SYNC_YIELD() between the retries
+	/  and fails after FF_FS_TIMEOUT of them instead of spinning forever. */
+	for (;;) {
+		pm = __get_PRIMASK();
+		__disable_irq();
+		ok = (*sobj == 0);
+		if (ok) *sobj = 1;
+		__set_PRIMASK(pm);
+		if (ok || n-- == 0) break;
+		FF_SYNC_YIELD();
+	}
+	return ok;
+
+#else						/* POSIX threads */
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += FF_FS_TIMEOUT / 1000;
+	ts.tv_nsec += (long)(FF_FS_TIMEOUT % 1000) * 1000000;
+	if (ts.tv_nsec >= 1000000000) {
+		ts.tv_sec++; ts.tv_nsec -= 1000000000;
+	}
+	return (int)(pthread_mutex_timedlock(sobj, &ts) == 0);
 
-	/* FreeRTOS */
-//	return (int)(xSemaphoreTake(sobj, FF_FS_TIMEOUT) == pdTRUE);
-
-	/* CMSIS-RTOS */
-//	return (int)(osMutexWait(sobj, FF_FS_TIMEOUT) == osOK);
+#endif
 }
 
 
@@ -150,21 +201,21 @@ void ff_rel_grant (
 	FF_SYNC_t sobj	/* Sync object to be signaled */
 )
 {
-	/* Win32 */
-	ReleaseMutex(sobj);
+#if FF_SYNC_PORT == 1		/* FreeRTOS */
+	xSemaphoreGive(sobj);
 
-	/* uITRON */
-//	sig_sem(sobj);
+#elif FF_SYNC_PORT == 2		/* CMSIS-RTOS2 */
+	osMutexRelease(sobj);
 
-	/* uC/OS-II */
-//	OSMutexPost(sobj);
+#elif FF_SYNC_PORT == 3		/* Bare-metal spinlock */
+	__DMB();
+	*sobj = 0;
 
-	/* FreeRTOS */
-//	xSemaphoreGive(sobj);
-
-	/* CMSIS-RTOS */
-//	osMutexRelease(sobj);
-}
+#else						/* POSIX threads */
+	pthread_mutex_unlock(sobj);
 
 #endif
+}
 
+#endif	/* FF_SYNC_PORT != 0 */
+#endif	/* FF_FS_REENTRANT */
@@ -34,7 +34,20 @@
 #define MERGE2(a, b) a ## b
 #define CVTBL(tbl, cp) MERGE2(tbl, cp)
 
+#if FF_USE_FASTCVT && !defined FF_UNITBL_GEN
+#include "ffunitbl.h"	/* Direct-index tables generated by option/ffunigen.c */
+#if FF_UNITBL_CP != FF_CODE_PAGE
+#error ffunitbl.h is not for this code page. Re-generate it with option/ffunigen.c.
+#endif
+#define FASTCVT_OEM	(FF_CODE_PAGE != 0)	/* OEM code conversions with the direct-index tables */
+#define FASTCVT_UPC	1					/* Up-case conversion with the direct-index table */
+#else
+#define FASTCVT_OEM	0
+#define FASTCVT_UPC	0
+#endif
 
+
+#if !FASTCVT_OEM
 /*------------------------------------------------------------------------*/
 /* Code Conversion Tables                                                 */
 /*------------------------------------------------------------------------*/
@@ -15213,6 +15226,7 @@ static const WCHAR uc869[] = {	/*  CP869(Greek 2) to Unicode conversion table */
 	0x00AD, 0x00B1, 0x03C5, 0x03C6, 0x03C7, 0x00A7, 0x03C8, 0x0385, 0x00B0, 0x00A8, 0x03C9, 0x03CB, 0x03B0, 0x03CE, 0x25A0, 0x00A0
 };
 #endif
+#endif	/* !FASTCVT_OEM */
 
 
 
@@ -15222,7 +15236,7 @@ static const WCHAR uc869[] = {	/*  CP869(Greek 2) to Unicode conversion table */
 /* SBCS fixed code page                                                   */
 /*------------------------------------------------------------------------*/
 
-#if FF_CODE_PAGE != 0 && FF_CODE_PAGE < 900
+#if !FASTCVT_OEM && FF_CODE_PAGE != 0 && FF_CODE_PAGE < 900
 WCHAR ff_uni2oem (	/* Returns OEM code character, zero on error */
 	DWORD	uni,	/* UTF-16 encoded character to be converted */
 	WORD	cp		/* Code page for the conversion */
@@ -15275,7 +15289,7 @@ WCHAR ff_oem2uni (	/* Returns Unicode character, zero on error */
 /* DBCS fixed code page                                                   */
 /*------------------------------------------------------------------------*/
 
-#if FF_CODE_PAGE >= 900
+#if !FASTCVT_OEM && FF_CODE_PAGE >= 900
 WCHAR ff_uni2oem (	/* Returns OEM code character, zero on error */
 	DWORD	uni,	/* UTF-16 encoded character to be converted */
 	WORD	cp		/* Code page for the conversion */
@@ -15349,6 +15363,60 @@ WCHAR ff_oem2uni (	/* Returns Unicode character, zero on error */
 
 
 
+/*------------------------------------------------------------------------*/
+/* OEM <==> Unicode conversions for static code page configuration        */
+/* Direct-index tables                                                    */
+/*------------------------------------------------------------------------*/
+
+#if FASTCVT_OEM
+WCHAR ff_uni2oem (	/* Returns OEM code character, zero on error */
+	DWORD	uni,	/* UTF-16 encoded character to be converted */
+	WORD	cp		/* Code page for the conversion */
+)
+{
+	WCHAR c = 0;
+	UINT pg;
+
+
+	if (uni < 0x80) {	/* ASCII? */
+		c = (WCHAR)uni;
+
+	} else {			/* Non-ASCII */
+		if (uni < 0x10000 && cp == FF_CODE_PAGE) {	/* Is it in BMP and valid code page? */
+			pg = u2o_idx[uni >> 8];
+			if (pg) c = u2o_page[pg - 1][uni & 0xFF];
+		}
+	}
+
+	return c;
+}
+
+
+WCHAR ff_oem2uni (	/* Returns Unicode character, zero on error */
+	WCHAR	oem,	/* OEM code to be converted */
+	WORD	cp		/* Code page for the conversion */
+)
+{
+	WCHAR c = 0;
+	UINT pg;
+
+
+	if (oem < 0x80) {	/* ASCII? */
+		c = oem;
+
+	} else {			/* Extended char */
+		if (cp == FF_CODE_PAGE) {	/* Is it a valid code page? */
+			pg = o2u_idx[oem >> 8];
+			if (pg) c = o2u_page[pg - 1][oem & 0xFF];
+		}
+	}
+
+	return c;
+}
+#endif
+
+
+
 /*------------------------------------------------------------------------*/
 /* OEM <==> Unicode conversions for dynamic code page configuration       */
 /*------------------------------------------------------------------------*/
@@ -15469,6 +15537,23 @@ DWORD ff_wtoupper (	/* Returns up-converted code point */
 	DWORD uni		/* Unicode code point to be up-converted */
 )
 {
+#if FASTCVT_UPC
+	WCHAR uc;
+	UINT pg;
+
+
+	if (uni < 0x80) {	/* ASCII? */
+		if (uni >= 'a' && uni <= 'z') uni -= 0x20;
+	} else if (uni < 0x10000) {	/* Is it in BMP? */
+		pg = upc_idx[uni >> 8];
+		if (pg) {
+			uc = upc_page[pg - 1][uni & 0xFF];
+			if (uc) uni = uc;	/* Up-case mapped? */
+		}
+	}
+
+	return uni;
+#else
 	const WORD *p;
 	WORD uc, bc, nc, cmd;
 	static const WORD cvt1[] = {	/* Compressed up conversion table for U+0000 - U+0FFF */
@@ -15564,7 +15649,10 @@ DWORD ff_wtoupper (	/* Returns up-converted code point */
 	};
 
 
-	if (uni < 0x10000) {	/* Is it in BMP? */
+	if (uni < 0x80) {	/* ASCII? */
+		if (uni >= 'a' && uni <= 'z') uni -= 0x20;
+
+	} else if (uni < 0x10000) {	/* Is it in BMP? */
 		uc = (WORD)uni;
 		p = uc < 0x1000 ? cvt1 : cvt2;
 		for (;;) {
@@ -15591,6 +15679,7 @@ DWORD ff_wtoupper (	/* Returns up-converted code point */
 	}
 
 	return uni;
+#endif
 }
 
 
@@ -0,0 +1,107 @@
+/*------------------------------------------------------------------------*/
+/* Direct-index code conversion table generator for ffunicode.c           */
+/*------------------------------------------------------------------------*/
+/* This is a host program that creates ffunitbl.h used by ffunicode.c when
+/  FF_USE_FASTCVT is enabled. The tables are created by running the table
+/  search functions of ffunicode.c over all code points, so that the
+/  result is identical to the conversions without FF_USE_FASTCVT. The code
+/  page is taken from ffconf.h, so it must be re-run whenever FF_CODE_PAGE
+/  is changed. Run it in the src directory as:
+/
+/    cc -I../inc -o ffunigen option/ffunigen.c
+/    ./ffunigen > ffunitbl.h
+/
+/  Each table consists of a page index for the upper byte of the code and
+/  256-item pages for the lower byte. Page index 0 means there is no page
+/  for the upper byte (the code is not convertible or not up-case mapped).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FF_UNITBL_GEN	/* Use the table search functions in ffunicode.c */
+#include "../ffunicode.c"
+
+#if !FF_USE_LFN
+#error FF_USE_LFN needs to be enabled to create the tables.
+#endif
+
+
+static WCHAR Map[0x10000];
+
+
+/* Put a two-level table of Map[] */
+
+static void put_table (
+	const char* name,	/* Base name of the table */
+	const char* type,	/* Item type of the pages */
+	const char* desc	/* Description of the table */
+)
+{
+	unsigned int hi, lo, np = 0;
+	unsigned char idx[256];
+
+
+	for (hi = 0; hi < 256; hi++) {	/* Create page index */
+		for (lo = 0; lo < 256 && Map[hi << 8 | lo] == 0; lo++) ;
+		idx[hi] = 0;
+		if (lo < 256) {
+			if (++np > 255) {
+				fprintf(stderr, "ffunigen: too many pages in %s.\n", name);
+				exit(1);
+			}
+			idx[hi] = (unsigned char)np;
+		}
+	}
+
+	printf("static const BYTE %s_idx[256] = {\t/* %s (page number, 0:no page) */\n", name, desc);
+	for (hi = 0; hi < 256; hi++) {
+		printf("%s%3u,%s", (hi % 16) ? " " : "\t", idx[hi], (hi % 16 == 15) ? "\n" : "");
+	}
+	printf("};\n");
+	printf("static const %s %s_page[%u][256] = {\n", type, name, np ? np : 1);
+	if (np == 0) printf("\t{ 0 }\n");
+	for (hi = 0; hi < 256; hi++) {
+		if (idx[hi] == 0) continue;
+		printf("\t{\t/* U+%02X00 - U+%02XFF */\n", hi, hi);
+		for (lo = 0; lo < 256; lo++) {
+			printf("%s0x%04X,%s", (lo % 16) ? " " : "\t\t", Map[hi << 8 | lo], (lo % 16 == 15) ? "\n" : "");
+		}
+		printf("\t}%s\n", (idx[hi] == np) ? "" : ",");
+	}
+	printf("};\n\n");
+}
+
+
+int main (void)
+{
+	DWORD c;
+	WCHAR u;
+
+
+	printf("/*------------------------------------------------------------------------*/\n");
+	printf("/* Direct-index code conversion tables for ffunicode.c                    */\n");
+	printf("/* Generated by option/ffunigen.c. Do not edit.                           */\n");
+	printf("/*------------------------------------------------------------------------*/\n\n");
+	printf("#define FF_UNITBL_CP\t%u\n\n", (unsigned int)FF_CODE_PAGE);
+
+#if FF_CODE_PAGE != 0
+	for (c = 0; c < 0x10000; c++) {		/* Unicode --> OEM code */
+		Map[c] = (c < 0x80) ? 0 : ff_uni2oem(c, FF_CODE_PAGE);
+	}
+	put_table("u2o", FF_CODE_PAGE < 900 ? "BYTE" : "WCHAR", "Unicode --> OEM code");
+
+	for (c = 0; c < 0x10000; c++) {		/* OEM code --> Unicode */
+		Map[c] = (c < 0x80 || (FF_CODE_PAGE < 900 && c >= 0x100)) ? 0 : ff_oem2uni((WCHAR)c, FF_CODE_PAGE);
+	}
+	put_table("o2u", "WCHAR", "OEM code --> Unicode");
+#endif
+
+	for (c = 0; c < 0x10000; c++) {		/* Up-case conversion (only changed codes) */
+		u = (WCHAR)ff_wtoupper(c);
+		Map[c] = (c < 0x80 || u == c) ? 0 : u;
+	}
+	put_table("upc", "WCHAR", "Unicode up-case conversion");
+
+	return 0;
+}
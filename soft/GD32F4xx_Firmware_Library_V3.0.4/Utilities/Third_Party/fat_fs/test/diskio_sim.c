@@ -0,0 +1,234 @@
+/*------------------------------------------------------------------------*/
+/* Simulated media for the FatFs host test bench                          */
+/*------------------------------------------------------------------------*/
+
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "diskio.h"
+#include "diskio_sim.h"
+
+
+const SIM_MEDIA SimMedia[] = {
+	/* name   cmd_us rd_us wr_us  blk erase_us  ra nor */
+	{ "sd",     100,   25,   35, 128,    3000,  64, 0 },	/* SD card, 4-bit bus at 25 MHz */
+	{ "usb",   1500,  550,  600, 256,   10000, 128, 0 },	/* USB stick on a full-speed host */
+	{ "nor",      5,   45, 1400,   8,   45000,   0, 1 },	/* Quad-SPI NOR flash, 4 KB erase sectors */
+	{ 0 }
+};
+
+typedef struct {
+	int fd;					/* Image file */
+	int open;				/* 1:Image file is open */
+	DWORD nsect;			/* Number of sectors */
+	const SIM_MEDIA* m;		/* Media profile */
+	DWORD ra_start, ra_end;	/* Read-ahead window */
+	DWORD open_blk;			/* Erase block open for sequential writes */
+	DWORD open_next;		/* Next sector of the open block */
+	SIM_STAT st;
+} SIM_DRIVE;
+
+static SIM_DRIVE Drive[SIM_DRIVES];
+static UINT RealTime;	/* Percentage of the media time to sleep (0:No sleep) */
+
+
+
+/*------------------------------------------------------------------------*/
+/* Bench Functions                                                        */
+/*------------------------------------------------------------------------*/
+
+const SIM_MEDIA* sim_media (	/* Returns the profile or null */
+	const char* name	/* Profile name */
+)
+{
+	const SIM_MEDIA* m;
+
+
+	for (m = SimMedia; m->name; m++) {
+		if (!strcmp(m->name, name)) return m;
+	}
+	return 0;
+}
+
+
+int sim_open (			/* 0:Succeeded, -1:Failed */
+	BYTE pdrv,			/* Physical drive number */
+	const char* path,	/* Image file, created as a sparse file of nsect sectors */
+	DWORD nsect,		/* Number of sectors */
+	const SIM_MEDIA* m	/* Media profile */
+)
+{
+	SIM_DRIVE* d;
+
+
+	if (pdrv >= SIM_DRIVES || !m) return -1;
+	sim_close(pdrv);
+	d = &Drive[pdrv];
+	memset(d, 0, sizeof *d);
+	d->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (d->fd < 0 || ftruncate(d->fd, (off_t)nsect * FF_MAX_SS) != 0) {
+		perror(path);
+		if (d->fd >= 0) close(d->fd);
+		return -1;
+	}
+	d->open = 1;
+	d->nsect = nsect;
+	d->m = m;
+	d->open_blk = 0xFFFFFFFF;
+	return 0;
+}
+
+
+void sim_close (
+	BYTE pdrv	/* Physical drive number */
+)
+{
+	if (pdrv < SIM_DRIVES && Drive[pdrv].open) {
+		close(Drive[pdrv].fd);
+		Drive[pdrv].open = 0;
+	}
+}
+
+
+void sim_stat (
+	BYTE pdrv,		/* Physical drive number */
+	SIM_STAT* st,	/* Returns the counters (can be null) */
+	int reset		/* 1:Clear the counters */
+)
+{
+	if (pdrv >= SIM_DRIVES) return;
+	if (st) *st = Drive[pdrv].st;
+	if (reset) memset(&Drive[pdrv].st, 0, sizeof Drive[pdrv].st);
+}
+
+
+
+void sim_realtime (
+	UINT pct	/* Percentage of the media time to sleep in the disk functions (0:No sleep) */
+)
+{
+	RealTime = pct;
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Disk I/O Functions                                                     */
+/*------------------------------------------------------------------------*/
+
+static SIM_DRIVE* get_drive (BYTE pdrv)
+{
+	return (pdrv < SIM_DRIVES && Drive[pdrv].open) ? &Drive[pdrv] : 0;
+}
+
+
+static void media_time (SIM_DRIVE* d, unsigned long us)
+{
+	struct timespec ts;
+
+
+	d->st.us += us;
+	if (RealTime) {
+		us = us * RealTime / 100;
+		ts.tv_sec = us / 1000000;
+		ts.tv_nsec = (long)(us % 1000000) * 1000;
+		while (nanosleep(&ts, &ts) != 0) ;
+	}
+}
+
+
+DSTATUS disk_initialize (BYTE pdrv)
+{
+	return get_drive(pdrv) ? 0 : STA_NOINIT;
+}
+
+
+DSTATUS disk_status (BYTE pdrv)
+{
+	return get_drive(pdrv) ? 0 : STA_NOINIT;
+}
+
+
+DRESULT disk_read (BYTE pdrv, BYTE* buff, DWORD sector, UINT count)
+{
+	SIM_DRIVE* d = get_drive(pdrv);
+	unsigned long us;
+
+
+	if (!d) return RES_NOTRDY;
+	if (count == 0 || sector >= d->nsect || count > d->nsect - sector) return RES_PARERR;
+	if (pread(d->fd, buff, (size_t)count * FF_MAX_SS, (off_t)sector * FF_MAX_SS) != (ssize_t)count * FF_MAX_SS) return RES_ERROR;
+
+	us = (unsigned long)count * d->m->rd_us;
+	if (!(sector >= d->ra_start && sector + count <= d->ra_end)) {	/* Out of the read-ahead window */
+		us += d->m->cmd_us;
+	}
+	d->ra_start = sector + count;
+	d->ra_end = d->ra_start + d->m->ra;
+	d->st.reads++;
+	d->st.rsect += count;
+	media_time(d, us);
+	return RES_OK;
+}
+
+
+DRESULT disk_write (BYTE pdrv, const BYTE* buff, DWORD sector, UINT count)
+{
+	SIM_DRIVE* d = get_drive(pdrv);
+	DWORD s, blk;
+	unsigned long us;
+
+
+	if (!d) return RES_NOTRDY;
+	if (count == 0 || sector >= d->nsect || count > d->nsect - sector) return RES_PARERR;
+	if (pwrite(d->fd, buff, (size_t)count * FF_MAX_SS, (off_t)sector * FF_MAX_SS) != (ssize_t)count * FF_MAX_SS) return RES_ERROR;
+
+	us = d->m->cmd_us + (unsigned long)count * d->m->wr_us;
+	for (s = sector; s < sector + count; s = (blk + 1) * d->m->blk) {	/* Each erase block touched */
+		blk = s / d->m->blk;
+		if (d->m->nor || blk != d->open_blk || s != d->open_next) {
+			us += d->m->erase_us;
+			d->st.erases++;
+		}
+		d->open_blk = blk;
+	}
+	d->open_next = sector + count;
+	d->ra_end = d->ra_start;	/* Writing drops the read-ahead */
+	d->st.writes++;
+	d->st.wsect += count;
+	if (us > d->st.max_wr_us) d->st.max_wr_us = us;
+	media_time(d, us);
+	return RES_OK;
+}
+
+
+DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff)
+{
+	SIM_DRIVE* d = get_drive(pdrv);
+
+
+	if (!d) return RES_NOTRDY;
+	switch (cmd) {
+	case CTRL_SYNC:
+		return RES_OK;
+	case GET_SECTOR_COUNT:
+		*(DWORD*)buff = d->nsect;
+		return RES_OK;
+	case GET_SECTOR_SIZE:
+		*(WORD*)buff = FF_MAX_SS;
+		return RES_OK;
+	case GET_BLOCK_SIZE:
+		*(DWORD*)buff = d->m->blk;
+		return RES_OK;
+	}
+	return RES_PARERR;
+}
+
+
+DWORD get_fattime (void)
+{
+	return (DWORD)(2021 - 1980) << 25 | (DWORD)1 << 21 | (DWORD)1 << 16;	/* Fixed time stamp for reproducible images */
+}
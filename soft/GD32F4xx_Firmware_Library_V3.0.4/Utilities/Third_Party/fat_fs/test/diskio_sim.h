@@ -0,0 +1,61 @@
+/*------------------------------------------------------------------------*/
+/* Simulated media for the FatFs host test bench                          */
+/*------------------------------------------------------------------------*/
+/* The disk I/O functions of FatFs are served from image files on the host
+/  and every command is charged with the time it would take on the media
+/  described by a SIM_MEDIA profile. The model is:
+/
+/   read  = cmd_us + n * rd_us, cmd_us is saved when the read falls into the
+/           read-ahead window of ra sectors behind the previous read
+/   write = cmd_us + n * wr_us, plus erase_us for each erase block of blk
+/           sectors the write does not continue sequentially (SD, USB: the
+/           controller closes its open block) or touches at all (NOR: every
+/           program needs an erased block)
+/
+/  The profile values are rough figures of the media class, not of a
+/  particular part. They are meant to compare FatFs configurations against
+/  each other, not to predict absolute throughput.
+/
+/  With sim_realtime(), the disk functions also sleep for the modeled time,
+/  so that concurrent accesses to the drives take wall clock time as they
+/  would on the media. A drive is not thread safe by itself and must be
+/  accessed by one thread at a time, as the FatFs volume lock does.
+*/
+
+#ifndef DISKIO_SIM_DEF
+#define DISKIO_SIM_DEF
+
+#include "ff.h"
+
+#define SIM_DRIVES	4	/* Number of physical drives served */
+
+typedef struct {
+	const char* name;	/* Profile name */
+	DWORD cmd_us;		/* Command overhead */
+	DWORD rd_us;		/* Transfer time of a sector read */
+	DWORD wr_us;		/* Transfer and program time of a sector write */
+	DWORD blk;			/* Erase block size in sectors */
+	DWORD erase_us;		/* Erase block penalty */
+	DWORD ra;			/* Read-ahead window in sectors (0: none) */
+	BYTE nor;			/* 1: every written block is erased (no open block) */
+} SIM_MEDIA;
+
+typedef struct {
+	DWORD reads;		/* Number of disk_read() calls */
+	DWORD writes;		/* Number of disk_write() calls */
+	DWORD rsect;		/* Number of sectors read */
+	DWORD wsect;		/* Number of sectors written */
+	DWORD erases;		/* Number of erase block penalties */
+	unsigned long long us;	/* Simulated media time */
+	DWORD max_wr_us;	/* Longest disk_write() call */
+} SIM_STAT;
+
+extern const SIM_MEDIA SimMedia[];	/* Profiles: "sd", "usb", "nor", terminated by a null name */
+
+const SIM_MEDIA* sim_media (const char* name);
+int sim_open (BYTE pdrv, const char* path, DWORD nsect, const SIM_MEDIA* media);
+void sim_close (BYTE pdrv);
+void sim_stat (BYTE pdrv, SIM_STAT* st, int reset);
+void sim_realtime (UINT pct);
+
+#endif
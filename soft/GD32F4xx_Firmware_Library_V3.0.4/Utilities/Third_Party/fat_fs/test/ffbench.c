@@ -0,0 +1,687 @@
+/*------------------------------------------------------------------------*/
+/* FatFs host performance bench                                           */
+/*------------------------------------------------------------------------*/
+/* Runs a fixed set of workloads on a freshly formatted volume for each
+/  simulated media profile and reports the media time, MB/s, IOPS and the
+/  number of disk_read()/disk_write() calls. The results can be saved with
+/  -o and compared with a previous run or the committed baseline with -b,
+/  which fails when a workload needs more disk commands or media time than
+/  the baseline allows. The host CPU time is reported but not compared.
+/
+/  usage: ffbench [-m media] [-n files] [-o results] [-b baseline] [-t tol%]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ff.h"
+#include "ff_stream.h"
+#include "diskio_sim.h"
+
+
+#define SEQ_SIZE	(4UL * 1024 * 1024)	/* Size of the sequential file */
+#define SEQ_CHUNK	4096				/* Size of the sequential read/write requests */
+#define SEEK_OPS	1000				/* Number of random reads */
+#define OPEN_OPS	1000				/* Number of random opens */
+#define CVT_ROUNDS	16					/* Number of passes over the BMP in namecvt */
+#define FRAG_SIZE	(2UL * 1024 * 1024)	/* Size of the fragmented file */
+#define APPEND_OPS	500					/* Number of synced log appends */
+#define APPEND_LEN	64					/* Size of a log record */
+#define LOG_SIZE	(4UL * 1024 * 1024)	/* Size of the streamed log */
+#define LOG_REC		512					/* Size of a streamed log record */
+#define LOG_CKPT	(64UL * 1024)		/* Checkpoint interval of the streamed log */
+#define FILL_FILE	(256UL * 1024)		/* Size of the files filling the FAT32 volume */
+#define FILL_HOLE	64					/* Every FILL_HOLE-th fill file is removed */
+#define FILL_OPS	4000				/* Number of synced log appends on the full volume */
+#define FILL_LEN	4096				/* Size of a log record on the full volume */
+#define FILL_ROTATE	256					/* Number of records in a log file, two files are kept */
+#define MAX_RESULTS	64
+
+typedef struct {
+	char media[8];
+	char name[16];
+	SIM_STAT st;
+	DWORD ops;				/* Number of operations (files, records, requests) */
+	unsigned long long bytes;	/* Number of bytes transferred */
+	double cpu_ms;			/* Host CPU time */
+	DWORD max_op_us;		/* Longest operation timed with op_begin()/op_end() */
+} RESULT;
+
+static FATFS FatFs;
+static BYTE Work[FF_MAX_SS * 32];
+static BYTE Buff[SEQ_CHUNK];
+static BYTE StreamBuf[64 * 1024];	/* Staging buffer of the stream, an SD erase block */
+static RESULT Res[MAX_RESULTS];
+static int NumRes;
+static UINT NumFiles = 300;
+static const SIM_MEDIA* Media;
+static double CpuStart;
+static unsigned long long OpStart;
+static DWORD MaxOp;
+static unsigned long Rnd;
+
+
+
+/*------------------------------------------------------------------------*/
+/* Helpers                                                                */
+/*------------------------------------------------------------------------*/
+
+static void die (const char* what, FRESULT res)
+{
+	fprintf(stderr, "ffbench: %s: %s failed (%d)\n", Media->name, what, (int)res);
+	exit(2);
+}
+
+#define CHECK(what, call) do { FRESULT r_ = (call); if (r_ != FR_OK) die(what, r_); } while (0)
+
+
+static double cpu_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+static DWORD rnd (void)	/* Reproducible pseudo random numbers */
+{
+	Rnd = Rnd * 1103515245UL + 12345UL;
+	return (DWORD)(Rnd >> 8) & 0xFFFFFF;
+}
+
+
+static BYTE pattern (DWORD ofs)	/* Contents of the sequential file */
+{
+	return (BYTE)(ofs ^ ofs >> 9 ^ ofs >> 17);
+}
+
+
+static void fname (char* p, UINT n)
+{
+	sprintf(p, "dir/file_%05u.txt", n);
+}
+
+
+/* Drop the sector window and the open objects, then clear the counters */
+static void remount (void)
+{
+	CHECK("unmount", f_unmount(""));
+	CHECK("mount", f_mount(&FatFs, "", 1));
+	sim_stat(0, 0, 1);
+	CpuStart = cpu_ms();
+	MaxOp = 0;
+}
+
+
+/* Time an operation of the workload in the simulated media time */
+static void op_begin (void)
+{
+	SIM_STAT st;
+
+	sim_stat(0, &st, 0);
+	OpStart = st.us;
+}
+
+
+static void op_end (void)
+{
+	SIM_STAT st;
+
+	sim_stat(0, &st, 0);
+	if (st.us - OpStart > MaxOp) MaxOp = (DWORD)(st.us - OpStart);
+}
+
+
+static void record (const char* name, DWORD ops, unsigned long long bytes)
+{
+	RESULT* r;
+
+
+	if (NumRes >= MAX_RESULTS) return;
+	r = &Res[NumRes++];
+	strncpy(r->media, Media->name, sizeof r->media - 1);
+	strncpy(r->name, name, sizeof r->name - 1);
+	sim_stat(0, &r->st, 0);
+	r->ops = ops;
+	r->bytes = bytes;
+	r->cpu_ms = cpu_ms() - CpuStart;
+	r->max_op_us = MaxOp;
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Workloads                                                              */
+/*------------------------------------------------------------------------*/
+
+static void wl_seqwrite (void)
+{
+	FIL f;
+	UINT bw, i;
+	DWORD ofs;
+
+
+	remount();
+	CHECK("open", f_open(&f, "seq.bin", FA_WRITE | FA_CREATE_ALWAYS));
+	for (ofs = 0; ofs < SEQ_SIZE; ofs += SEQ_CHUNK) {
+		for (i = 0; i < SEQ_CHUNK; i++) Buff[i] = pattern(ofs + i);
+		CHECK("write", f_write(&f, Buff, SEQ_CHUNK, &bw));
+		if (bw != SEQ_CHUNK) die("write (disk full)", FR_DENIED);
+	}
+	CHECK("close", f_close(&f));
+	record("seqwrite", SEQ_SIZE / SEQ_CHUNK, SEQ_SIZE);
+}
+
+
+static void wl_seqread (void)
+{
+	FIL f;
+	UINT br, i;
+	DWORD ofs;
+
+
+	remount();
+	CHECK("open", f_open(&f, "seq.bin", FA_READ));
+	for (ofs = 0; ofs < SEQ_SIZE; ofs += SEQ_CHUNK) {
+		CHECK("read", f_read(&f, Buff, SEQ_CHUNK, &br));
+		for (i = 0; i < br && Buff[i] == pattern(ofs + i); i++) ;
+		if (br != SEQ_CHUNK || i != br) die("read (data mismatch)", FR_INT_ERR);
+	}
+	CHECK("close", f_close(&f));
+	record("seqread", SEQ_SIZE / SEQ_CHUNK, SEQ_SIZE);
+}
+
+
+static void wl_create (void)	/* Small file create storm */
+{
+	FIL f;
+	UINT bw, n;
+	char path[32];
+
+
+	remount();
+	CHECK("mkdir", f_mkdir("dir"));
+	for (n = 0; n < NumFiles; n++) {
+		fname(path, n);
+		memset(Buff, (int)n, 1024);
+		CHECK("create", f_open(&f, path, FA_WRITE | FA_CREATE_NEW));
+		CHECK("write", f_write(&f, Buff, 1024, &bw));
+		CHECK("close", f_close(&f));
+	}
+	record("create", NumFiles, (unsigned long long)NumFiles * 1024);
+}
+
+
+static void wl_list (void)	/* Directory listing */
+{
+	DIR d;
+	FILINFO fno;
+	UINT n = 0;
+
+
+	remount();
+	CHECK("opendir", f_opendir(&d, "dir"));
+	for (;;) {
+		CHECK("readdir", f_readdir(&d, &fno));
+		if (!fno.fname[0]) break;
+		if (fno.fsize != 1024) die("readdir (size mismatch)", FR_INT_ERR);
+		n++;
+	}
+	CHECK("closedir", f_closedir(&d));
+	if (n != NumFiles) die("readdir (count mismatch)", FR_INT_ERR);
+	record("list", n, 0);
+}
+
+
+static void wl_stat (void)	/* Name lookups in random order */
+{
+	FILINFO fno;
+	UINT i;
+	char path[32];
+
+
+	remount();
+	Rnd = 1;
+	for (i = 0; i < NumFiles; i++) {
+		fname(path, (UINT)(rnd() % NumFiles));
+		CHECK("stat", f_stat(path, &fno));
+	}
+	record("stat", NumFiles, 0);
+}
+
+
+static void wl_seek (void)	/* Random reads */
+{
+	FIL f;
+	UINT br, i, j;
+	DWORD ofs;
+
+
+	remount();
+	Rnd = 2;
+	CHECK("open", f_open(&f, "seq.bin", FA_READ));
+	for (i = 0; i < SEEK_OPS; i++) {
+		ofs = rnd() % (SEQ_SIZE - 512);
+		CHECK("lseek", f_lseek(&f, ofs));
+		CHECK("read", f_read(&f, Buff, 512, &br));
+		for (j = 0; j < br && Buff[j] == pattern(ofs + j); j++) ;
+		if (br != 512 || j != br) die("read (data mismatch)", FR_INT_ERR);
+	}
+	CHECK("close", f_close(&f));
+	record("seek", SEEK_OPS, (unsigned long long)SEEK_OPS * 512);
+}
+
+
+static void wl_fragseek (void)	/* Random reads of a file fragmented at every cluster */
+{
+	FIL f, pad;
+	UINT bw, br, i, j, cs = FatFs.csize * FF_MAX_SS;
+	DWORD ofs;
+
+
+	CHECK("open", f_open(&f, "frag.bin", FA_WRITE | FA_CREATE_ALWAYS));	/* Interleave two files cluster by cluster */
+	CHECK("open", f_open(&pad, "pad.bin", FA_WRITE | FA_CREATE_ALWAYS));
+	for (ofs = 0; ofs < FRAG_SIZE; ofs += cs) {
+		for (i = 0; i < cs; i += SEQ_CHUNK) {
+			for (j = 0; j < SEQ_CHUNK; j++) Buff[j] = pattern(ofs + i + j);
+			CHECK("write", f_write(&f, Buff, cs - i < SEQ_CHUNK ? cs - i : SEQ_CHUNK, &bw));
+		}
+		for (i = 0; i < cs; i += bw) CHECK("write", f_write(&pad, Buff, cs - i < SEQ_CHUNK ? cs - i : SEQ_CHUNK, &bw));
+	}
+	CHECK("close", f_close(&f));
+	CHECK("close", f_close(&pad));
+
+	remount();
+	Rnd = 3;
+	CHECK("open", f_open(&f, "frag.bin", FA_READ));
+	for (i = 0; i < SEEK_OPS; i++) {
+		ofs = rnd() % (FRAG_SIZE - 512);
+		CHECK("lseek", f_lseek(&f, ofs));
+		CHECK("read", f_read(&f, Buff, 512, &br));
+		for (j = 0; j < br && Buff[j] == pattern(ofs + j); j++) ;
+		if (br != 512 || j != br) die("read (data mismatch)", FR_INT_ERR);
+	}
+	CHECK("close", f_close(&f));
+	record("fragseek", SEEK_OPS, (unsigned long long)SEEK_OPS * 512);
+	CHECK("unlink", f_unlink("frag.bin"));
+	CHECK("unlink", f_unlink("pad.bin"));
+}
+
+
+static void wl_append (void)	/* Logger: small records, synced each */
+{
+	FIL f;
+	UINT bw, i;
+
+
+	remount();
+	CHECK("open", f_open(&f, "log.txt", FA_WRITE | FA_OPEN_APPEND));
+	for (i = 0; i < APPEND_OPS; i++) {
+		memset(Buff, 'a' + i % 26, APPEND_LEN);
+		op_begin();
+		CHECK("write", f_write(&f, Buff, APPEND_LEN, &bw));
+		CHECK("sync", f_sync(&f));
+		op_end();
+	}
+	if (f_size(&f) != APPEND_OPS * APPEND_LEN) die("append (size mismatch)", FR_INT_ERR);
+	CHECK("close", f_close(&f));
+	record("append", APPEND_OPS, APPEND_OPS * APPEND_LEN);
+}
+
+
+static void verify_log (const char* path)
+{
+	FIL f;
+	UINT br, i;
+	DWORD ofs;
+
+
+	CHECK("open", f_open(&f, path, FA_READ));
+	if (f_size(&f) != LOG_SIZE) die("log (size mismatch)", FR_INT_ERR);
+	for (ofs = 0; ofs < LOG_SIZE; ofs += SEQ_CHUNK) {
+		CHECK("read", f_read(&f, Buff, SEQ_CHUNK, &br));
+		for (i = 0; i < br && Buff[i] == pattern(ofs + i); i++) ;
+		if (br != SEQ_CHUNK || i != br) die("log (data mismatch)", FR_INT_ERR);
+	}
+	CHECK("close", f_close(&f));
+	CHECK("unlink", f_unlink(path));
+}
+
+
+static void wl_logwrite (void)	/* Logger with f_write(), synced at each LOG_CKPT */
+{
+	FIL f;
+	UINT bw, i;
+	DWORD ofs;
+
+
+	remount();
+	CHECK("open", f_open(&f, "flog.bin", FA_WRITE | FA_CREATE_ALWAYS));
+	for (ofs = 0; ofs < LOG_SIZE; ofs += LOG_REC) {
+		for (i = 0; i < LOG_REC; i++) Buff[i] = pattern(ofs + i);
+		op_begin();
+		CHECK("write", f_write(&f, Buff, LOG_REC, &bw));
+		if (bw != LOG_REC) die("write (disk full)", FR_DENIED);
+		if ((ofs + LOG_REC) % LOG_CKPT == 0) CHECK("sync", f_sync(&f));
+		op_end();
+	}
+	CHECK("close", f_close(&f));
+	record("logwrite", LOG_SIZE / LOG_REC, LOG_SIZE);
+	verify_log("flog.bin");
+}
+
+
+static void wl_stream (void)	/* The same log with the streaming writer */
+{
+	FSTREAM st;
+	UINT bw, i;
+	DWORD ofs;
+
+
+	remount();
+	CHECK("stream open", f_stream_open(&st, "slog.bin", LOG_SIZE, StreamBuf, sizeof StreamBuf, LOG_CKPT));
+	for (ofs = 0; ofs < LOG_SIZE; ofs += LOG_REC) {
+		for (i = 0; i < LOG_REC; i++) Buff[i] = pattern(ofs + i);
+		op_begin();
+		CHECK("stream write", f_stream_write(&st, Buff, LOG_REC, &bw));
+		if (bw != LOG_REC) die("stream write (extent full)", FR_DENIED);
+		op_end();
+	}
+	CHECK("stream close", f_stream_close(&st));
+	record("stream", LOG_SIZE / LOG_REC, LOG_SIZE);
+	verify_log("slog.bin");
+}
+
+
+static void wl_open (void)	/* Opens of random files, 3 of 4 reopen one of the last 16 files */
+{
+	FIL f;
+	UINT i, n, recent[16] = { 0 };
+	char path[32];
+
+
+	remount();
+	Rnd = 4;
+	for (i = 0; i < OPEN_OPS; i++) {
+		if (i < 16 || i % 4 == 0) {	/* A new file */
+			n = (UINT)(rnd() % NumFiles);
+			recent[i % 16] = n;
+		} else {					/* One opened recently */
+			n = recent[rnd() % 16];
+		}
+		fname(path, n);
+		op_begin();
+		CHECK("open", f_open(&f, path, FA_READ));
+		CHECK("close", f_close(&f));
+		op_end();
+	}
+	record("open", OPEN_OPS, 0);
+}
+
+
+static void wl_namecvt (void)	/* Code conversions of the LFN functions, CPU only */
+{
+	volatile DWORD sum = 0;
+	DWORD c;
+	UINT n;
+
+
+	remount();
+	for (n = 0; n < CVT_ROUNDS; n++) {
+		for (c = 0; c < 0x10000; c++) {
+			sum += ff_wtoupper(c);
+			sum += ff_uni2oem(c, FF_CODE_PAGE);
+			sum += ff_oem2uni((WCHAR)c, FF_CODE_PAGE);
+		}
+	}
+	record("namecvt", CVT_ROUNDS * 0x10000, 0);
+}
+
+
+static void wl_unlink (void)
+{
+	UINT n;
+	char path[32];
+
+
+	remount();
+	for (n = 0; n < NumFiles; n++) {
+		fname(path, n);
+		CHECK("unlink", f_unlink(path));
+	}
+	CHECK("unlink", f_unlink("dir"));
+	record("unlink", NumFiles, 0);
+}
+
+
+/* Fill a FAT32 volume with contiguous files and punch a hole of FILL_FILE
+/  bytes at every FILL_HOLE-th one, so that the free space is scattered over
+/  the volume and the allocation has to step over the allocated regions */
+static void fill_volume (void)
+{
+	FIL f;
+	FATFS* fs;
+	DWORD nfree;
+	UINT n, nfill;
+	char path[32];
+
+
+	CHECK("mkdir", f_mkdir("fill"));
+	for (nfill = 0; ; nfill++) {
+		sprintf(path, "fill/f%05u.bin", nfill);
+		CHECK("create", f_open(&f, path, FA_WRITE | FA_CREATE_NEW));
+		if (f_expand(&f, FILL_FILE, 1) != FR_OK) {	/* No contiguous space left */
+			CHECK("getfree", f_getfree("", &nfree, &fs));
+			CHECK("expand", f_expand(&f, (FSIZE_t)(nfree - 1) * fs->csize * FF_MAX_SS, 1));	/* Keep a cluster for the log */
+			CHECK("close", f_close(&f));
+			break;
+		}
+		CHECK("close", f_close(&f));
+	}
+	for (n = FILL_HOLE / 2; n < nfill; n += FILL_HOLE) {
+		sprintf(path, "fill/f%05u.bin", n);
+		CHECK("unlink", f_unlink(path));
+	}
+}
+
+
+/* Rotating logger on a nearly full, fragmented volume. The logs wrap around
+/  the volume several times, so that the allocation passes over the same
+/  allocated regions again and again */
+static void wl_fillappend (void)
+{
+	FIL f;
+	UINT bw, i;
+	char path[32];
+
+
+	remount();
+	for (i = 0; i < FILL_OPS; i++) {
+		if (i % FILL_ROTATE == 0) {	/* Start a new log file and remove the one before the last */
+			if (i > 0) CHECK("close", f_close(&f));
+			if (i >= 2 * FILL_ROTATE) {
+				sprintf(path, "log%u.bin", i / FILL_ROTATE - 2);
+				CHECK("unlink", f_unlink(path));
+			}
+			sprintf(path, "log%u.bin", i / FILL_ROTATE);
+			CHECK("open", f_open(&f, path, FA_WRITE | FA_CREATE_ALWAYS));
+		}
+		memset(Buff, 'a' + i % 26, FILL_LEN);
+		op_begin();
+		CHECK("write", f_write(&f, Buff, FILL_LEN, &bw));
+		if (bw != FILL_LEN) die("write (disk full)", FR_DENIED);
+		CHECK("sync", f_sync(&f));
+		op_end();
+	}
+	CHECK("close", f_close(&f));
+	record("fillappend", FILL_OPS, (unsigned long long)FILL_OPS * FILL_LEN);
+}
+
+
+static void run_media (const SIM_MEDIA* m, DWORD mbytes)
+{
+	static const char* const fstype[] = { "?", "FAT12", "FAT16", "FAT32", "exFAT" };
+
+
+	Media = m;
+	if (sim_open(0, "ffbench.img", mbytes * (1024 * 1024 / FF_MAX_SS), m)) exit(2);
+	CHECK("mkfs", f_mkfs("", FM_ANY, 0, Work, sizeof Work));
+	CHECK("mount", f_mount(&FatFs, "", 1));
+	printf("%s: %lu MB %s, %u bytes/cluster\n", m->name, (unsigned long)mbytes,
+		fstype[FatFs.fs_type <= FS_EXFAT ? FatFs.fs_type : 0], (UINT)FatFs.csize * FF_MAX_SS);
+
+	wl_seqwrite();
+	wl_seqread();
+	wl_create();
+	wl_list();
+	wl_stat();
+	wl_open();
+	wl_namecvt();
+	wl_seek();
+	wl_fragseek();
+	wl_append();
+	wl_logwrite();
+	wl_stream();
+	wl_unlink();
+
+	if (!m->nor) {	/* NOR volume is too small for FAT32 */
+		CHECK("unmount", f_unmount(""));
+		CHECK("mkfs", f_mkfs("", FM_FAT32, 1024, Work, sizeof Work));
+		CHECK("mount", f_mount(&FatFs, "", 1));
+		fill_volume();
+		wl_fillappend();
+	}
+
+	CHECK("unmount", f_unmount(""));
+	sim_close(0);
+	remove("ffbench.img");
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Results                                                                */
+/*------------------------------------------------------------------------*/
+
+static void print_results (void)
+{
+	const RESULT* r;
+	double s;
+
+
+	printf("\n%-5s %-10s %6s %9s %8s %9s %7s %7s %8s %8s %8s %8s %8s\n",
+		"media", "workload", "ops", "media_ms", "MB/s", "IOPS", "reads", "writes", "rsect", "wsect", "max_wr", "max_op", "cpu_ms");
+	for (r = Res; r < Res + NumRes; r++) {
+		s = r->st.us / 1e6;
+		printf("%-5s %-10s %6lu %9.1f %8.3f %9.1f %7lu %7lu %8lu %8lu %8lu %8lu %8.2f\n",
+			r->media, r->name, (unsigned long)r->ops, r->st.us / 1e3,
+			s > 0 ? r->bytes / s / (1024 * 1024) : 0.0, s > 0 ? r->ops / s : 0.0,
+			(unsigned long)r->st.reads, (unsigned long)r->st.writes,
+			(unsigned long)r->st.rsect, (unsigned long)r->st.wsect,
+			(unsigned long)r->st.max_wr_us, (unsigned long)r->max_op_us, r->cpu_ms);
+	}
+}
+
+
+static int save_results (const char* path)
+{
+	FILE* fp = fopen(path, "w");
+	const RESULT* r;
+
+
+	if (!fp) {
+		perror(path);
+		return -1;
+	}
+	fprintf(fp, "# media workload reads writes rsect wsect media_us max_wr_us max_op_us cpu_ms\n");
+	for (r = Res; r < Res + NumRes; r++) {
+		fprintf(fp, "%s %s %lu %lu %lu %lu %llu %lu %lu %.2f\n", r->media, r->name,
+			(unsigned long)r->st.reads, (unsigned long)r->st.writes,
+			(unsigned long)r->st.rsect, (unsigned long)r->st.wsect,
+			r->st.us, (unsigned long)r->st.max_wr_us, (unsigned long)r->max_op_us, r->cpu_ms);
+	}
+	fclose(fp);
+	return 0;
+}
+
+
+/* Compare with a results file: 0:No regression, 1:Regression, -1:Error */
+static int compare_results (const char* path, double tol)
+{
+	FILE* fp = fopen(path, "r");
+	char line[256], media[8], name[16];
+	unsigned long rd, wr, rs, ws, mw, mo;
+	unsigned long long us;
+	double cpu, d_rd, d_wr, d_cmd, d_us, d_mo, d_cpu;
+	const RESULT* r;
+	int bad = 0;
+
+
+	if (!fp) {
+		perror(path);
+		return -1;
+	}
+	printf("\n%-5s %-10s %9s %9s %9s %9s %9s  (vs %s)\n", "media", "workload", "reads", "writes", "media_us", "max_op", "cpu_ms", path);
+	while (fgets(line, sizeof line, fp)) {
+		mo = 0; cpu = 0;
+		if (line[0] == '#' || sscanf(line, "%7s %15s %lu %lu %lu %lu %llu %lu %lu %lf", media, name, &rd, &wr, &rs, &ws, &us, &mw, &mo, &cpu) < 8) continue;
+		for (r = Res; r < Res + NumRes && (strcmp(r->media, media) || strcmp(r->name, name)); r++) ;
+		if (r == Res + NumRes) continue;
+		d_rd = rd ? ((double)r->st.reads / rd - 1) * 100 : 0;
+		d_wr = wr ? ((double)r->st.writes / wr - 1) * 100 : 0;
+		d_cmd = (rd + wr) ? ((double)(r->st.reads + r->st.writes) / (rd + wr) - 1) * 100 : 0;
+		d_us = us ? ((double)r->st.us / us - 1) * 100 : 0;
+		d_mo = mo ? ((double)r->max_op_us / mo - 1) * 100 : 0;
+		d_cpu = cpu > 0 ? (r->cpu_ms / cpu - 1) * 100 : 0;
+		printf("%-5s %-10s %+8.1f%% %+8.1f%% %+8.1f%% %+8.1f%% %+8.1f%%", media, name, d_rd, d_wr, d_us, d_mo, d_cpu);
+		if (d_cmd > tol || d_us > tol) {
+			printf("  REGRESSION");
+			bad = 1;
+		}
+		printf("\n");
+	}
+	fclose(fp);
+	return bad;
+}
+
+
+int main (int argc, char* argv[])
+{
+	const char *media = 0, *out = 0, *base = 0;
+	const SIM_MEDIA* m;
+	double tol = 2.0;
+	int i, rc = 0;
+
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-m") && i + 1 < argc) media = argv[++i];
+		else if (!strcmp(argv[i], "-n") && i + 1 < argc) NumFiles = (UINT)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc) out = argv[++i];
+		else if (!strcmp(argv[i], "-b") && i + 1 < argc) base = argv[++i];
+		else if (!strcmp(argv[i], "-t") && i + 1 < argc) tol = atof(argv[++i]);
+		else {
+			fprintf(stderr, "usage: ffbench [-m media] [-n files] [-o results] [-b baseline] [-t tol%%]\n");
+			return 2;
+		}
+	}
+
+	for (m = SimMedia; m->name; m++) {
+		if (media && strcmp(media, m->name)) continue;
+		run_media(m, m->nor ? 16 : 256);
+	}
+	if (NumRes == 0) {
+		fprintf(stderr, "ffbench: unknown media %s\n", media);
+		return 2;
+	}
+
+	print_results();
+	if (out && save_results(out)) rc = 2;
+	if (base) {
+		i = compare_results(base, tol);
+		if (i) rc = i < 0 ? 2 : 1;
+	}
+	return rc;
+}
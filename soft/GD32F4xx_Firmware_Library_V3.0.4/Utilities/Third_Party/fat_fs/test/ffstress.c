@@ -0,0 +1,307 @@
+/*------------------------------------------------------------------------*/
+/* FatFs host stress test of the reentrant configuration                  */
+/*------------------------------------------------------------------------*/
+/* Built with FF_FS_REENTRANT = 1 and a sync port of ffsystem.c, it runs
+/  threads on two simulated volumes and checks:
+/
+/   correctness  each thread creates, verifies, renames and removes its own
+/                files and races with the others in a shared directory.
+/                The surviving files are verified again after a remount.
+/   scaling      with the media time slept for real, two threads on two
+/                volumes must finish in well under twice the time of one
+/                thread, as the volumes are locked individually.
+/
+/  usage: ffstress [-t threads] [-r rounds]
+*/
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "ff.h"
+#include "diskio_sim.h"
+
+#if !FF_FS_REENTRANT
+#error ffstress needs FF_FS_REENTRANT = 1
+#endif
+
+
+#define MAX_THREADS	8
+#define VOL_MB		64		/* Size of a volume */
+#define REC_LEN		700		/* Size of a record, not aligned to the sector */
+#define RECS		6		/* Number of records in a file */
+#define SCALE_OPS	40		/* Number of synced 4 KB writes in the scaling test */
+#define MIN_SPEEDUP	1.5		/* Required speedup of two volumes over one */
+
+#if FF_SYNC_PORT == 3
+pthread_mutex_t StubIrqMask = PTHREAD_MUTEX_INITIALIZER;	/* PRIMASK of stub/gd32f4xx.h */
+#endif
+
+static FATFS Fs[2];
+static BYTE Work[FF_MAX_SS * 32];
+static UINT NumThreads = 4, Rounds = 60;
+static volatile int Errors;
+
+
+
+/*------------------------------------------------------------------------*/
+/* Helpers                                                                */
+/*------------------------------------------------------------------------*/
+
+static void fail (UINT t, const char* what, FRESULT res)
+{
+	__sync_fetch_and_add(&Errors, 1);
+	fprintf(stderr, "ffstress: thread %u: %s failed (%d)\n", t, what, (int)res);
+}
+
+#define CHECK(t, what, call) do { FRESULT r_ = (call); if (r_ != FR_OK) { fail(t, what, r_); return 0; } } while (0)
+
+
+static BYTE pattern (UINT t, UINT r, DWORD ofs)	/* Contents of the file r of thread t */
+{
+	return (BYTE)(ofs * 7 + t * 31 + r * 13 + (ofs >> 8));
+}
+
+
+static double now_ms (void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+
+static int verify_file (UINT t, UINT r, const char* path)	/* 1:Ok, 0:Error */
+{
+	FIL f;
+	BYTE buf[REC_LEN];
+	UINT br, i, n;
+
+
+	CHECK(t, "open (verify)", f_open(&f, path, FA_READ));
+	if (f_size(&f) != RECS * REC_LEN) {
+		fail(t, "size", FR_INT_ERR);
+		f_close(&f);
+		return 0;
+	}
+	for (n = 0; n < RECS; n++) {
+		CHECK(t, "read", f_read(&f, buf, REC_LEN, &br));
+		for (i = 0; i < br && buf[i] == pattern(t, r, n * REC_LEN + i); i++) ;
+		if (br != REC_LEN || i != br) {
+			fprintf(stderr, "ffstress: thread %u: %s: data mismatch at %u\n", t, path, n * REC_LEN + i);
+			fail(t, "verify", FR_INT_ERR);
+			f_close(&f);
+			return 0;
+		}
+	}
+	CHECK(t, "close (verify)", f_close(&f));
+	return 1;
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Correctness                                                            */
+/*------------------------------------------------------------------------*/
+/* Thread t works on volume t % 2 in its directory tN. Each round writes a
+/  file in records, syncing in the middle, and verifies it. The files of the
+/  even rounds are renamed to kR and kept, the others are removed. A marker
+/  file in the shared directory is created and removed in each round so
+/  that the threads of a volume update the same directory. */
+
+static void* worker (void* arg)
+{
+	UINT t = (UINT)(size_t)arg, v = t % 2, r, n, i, bw;
+	char path[32], path2[32], dir[16];
+	BYTE buf[REC_LEN];
+	FILINFO fno;
+	FATFS* fs;
+	DWORD nfree;
+	DIR d;
+	FIL f;
+
+
+	sprintf(dir, "%u:/t%u", v, t);
+	CHECK(t, "mkdir", f_mkdir(dir));
+	for (r = 0; r < Rounds; r++) {
+		sprintf(path, "%s/f%u", dir, r);
+		CHECK(t, "create", f_open(&f, path, FA_WRITE | FA_CREATE_NEW));
+		for (n = 0; n < RECS; n++) {
+			for (i = 0; i < REC_LEN; i++) buf[i] = pattern(t, r, n * REC_LEN + i);
+			CHECK(t, "write", f_write(&f, buf, REC_LEN, &bw));
+			if (bw != REC_LEN) { fail(t, "write (disk full)", FR_DENIED); return 0; }
+			if (n == RECS / 2) CHECK(t, "sync", f_sync(&f));
+		}
+		CHECK(t, "close", f_close(&f));
+		if (!verify_file(t, r, path)) return 0;
+
+		CHECK(t, "stat", f_stat(path, &fno));
+		if (fno.fsize != RECS * REC_LEN) { fail(t, "stat (size)", FR_INT_ERR); return 0; }
+		if (r % 2 == 0) {
+			sprintf(path2, "%s/k%u", dir, r);
+			CHECK(t, "rename", f_rename(path, path2));
+		} else {
+			CHECK(t, "unlink", f_unlink(path));
+		}
+
+		sprintf(path, "%u:/shared/s%u_%u", v, t, r);
+		CHECK(t, "create (shared)", f_open(&f, path, FA_WRITE | FA_CREATE_NEW));
+		CHECK(t, "close (shared)", f_close(&f));
+		if (r > 0) {
+			sprintf(path, "%u:/shared/s%u_%u", v, t, r - 1);
+			CHECK(t, "unlink (shared)", f_unlink(path));
+		}
+		if (r % 10 == 0) {
+			sprintf(path, "%u:", v);
+			CHECK(t, "getfree", f_getfree(path, &nfree, &fs));
+		}
+	}
+
+	CHECK(t, "opendir", f_opendir(&d, dir));
+	for (n = 0; ; n++) {
+		CHECK(t, "readdir", f_readdir(&d, &fno));
+		if (!fno.fname[0]) break;
+		if (fno.fname[0] != 'k') { fail(t, "readdir (stray file)", FR_INT_ERR); break; }
+	}
+	CHECK(t, "closedir", f_closedir(&d));
+	if (n != (Rounds + 1) / 2) fail(t, "readdir (count)", FR_INT_ERR);
+	return 0;
+}
+
+
+static int run_correctness (void)
+{
+	pthread_t th[MAX_THREADS];
+	char path[32];
+	UINT t, r, v;
+
+
+	for (v = 0; v < 2; v++) {
+		sprintf(path, "%u:/shared", v);
+		if (f_mkdir(path) != FR_OK) return -1;
+	}
+	for (t = 0; t < NumThreads; t++) pthread_create(&th[t], 0, worker, (void*)(size_t)t);
+	for (t = 0; t < NumThreads; t++) pthread_join(th[t], 0);
+
+	for (v = 0; v < 2; v++) {	/* Verify the kept files on the remounted volumes */
+		sprintf(path, "%u:", v);
+		f_unmount(path);
+		if (f_mount(&Fs[v], path, 1) != FR_OK) return -1;
+	}
+	for (t = 0; t < NumThreads; t++) {
+		for (r = 0; r < Rounds; r += 2) {
+			sprintf(path, "%u:/t%u/k%u", t % 2, t, r);
+			verify_file(t, r, path);
+		}
+	}
+	printf("correctness: %u threads, %u rounds, %d errors\n", NumThreads, Rounds, Errors);
+	return Errors ? 1 : 0;
+}
+
+
+
+/*------------------------------------------------------------------------*/
+/* Scaling                                                                */
+/*------------------------------------------------------------------------*/
+
+static void* writer (void* arg)
+{
+	UINT v = (UINT)(size_t)arg >> 4, t = (UINT)(size_t)arg & 15, i, bw;
+	BYTE buf[4096];
+	char path[32];
+	FIL f;
+
+
+	memset(buf, (int)t, sizeof buf);
+	sprintf(path, "%u:/w%u.bin", v, t);
+	CHECK(t, "create", f_open(&f, path, FA_WRITE | FA_CREATE_ALWAYS));
+	for (i = 0; i < SCALE_OPS; i++) {
+		CHECK(t, "write", f_write(&f, buf, sizeof buf, &bw));
+		CHECK(t, "sync", f_sync(&f));
+	}
+	CHECK(t, "close", f_close(&f));
+	return 0;
+}
+
+
+static double run_writers (UINT n, const UINT* vol)	/* Returns the wall time in ms */
+{
+	pthread_t th[2];
+	double t0 = now_ms();
+	UINT i;
+
+
+	for (i = 0; i < n; i++) pthread_create(&th[i], 0, writer, (void*)(size_t)(vol[i] << 4 | i));
+	for (i = 0; i < n; i++) pthread_join(th[i], 0);
+	return now_ms() - t0;
+}
+
+
+static int run_scaling (void)
+{
+	static const UINT one[] = { 0 }, same[] = { 0, 0 }, split[] = { 0, 1 };
+	double t1, ts, t2, sp;
+
+
+	sim_realtime(100);
+	t1 = run_writers(1, one);
+	ts = run_writers(2, same);
+	t2 = run_writers(2, split);
+	sim_realtime(0);
+	sp = 2 * t1 / t2;
+	printf("scaling: 1 thread %.0f ms, 2 threads on 1 volume %.0f ms, on 2 volumes %.0f ms, speedup %.2f\n",
+		t1, ts, t2, sp);
+	if (Errors) return 1;
+	if (sp < MIN_SPEEDUP) {
+		printf("scaling: speedup below %.1f, the volumes are not accessed in parallel\n", MIN_SPEEDUP);
+		return 1;
+	}
+	return 0;
+}
+
+
+
+int main (int argc, char* argv[])
+{
+	char path[8], img[16];
+	UINT v;
+	int i, rc = 0;
+
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-t") && i + 1 < argc) NumThreads = (UINT)atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-r") && i + 1 < argc) Rounds = (UINT)atoi(argv[++i]);
+		else {
+			fprintf(stderr, "usage: ffstress [-t threads] [-r rounds]\n");
+			return 2;
+		}
+	}
+	if (NumThreads < 1 || NumThreads > MAX_THREADS) NumThreads = 4;
+	printf("sync port %d, file lock %d\n", FF_SYNC_PORT, FF_FS_LOCK);
+
+	for (v = 0; v < 2; v++) {
+		sprintf(img, "stress%u.img", v);
+		sprintf(path, "%u:", v);
+		if (sim_open((BYTE)v, img, VOL_MB * (1024 * 1024 / FF_MAX_SS), sim_media("sd"))) return 2;
+		if (f_mkfs(path, FM_ANY, 0, Work, sizeof Work) != FR_OK || f_mount(&Fs[v], path, 1) != FR_OK) {
+			fprintf(stderr, "ffstress: cannot create volume %u\n", v);
+			return 2;
+		}
+	}
+
+	rc = run_correctness();
+	if (rc == 0) rc = run_scaling();
+
+	for (v = 0; v < 2; v++) {
+		sprintf(img, "stress%u.img", v);
+		sprintf(path, "%u:", v);
+		f_unmount(path);
+		sim_close((BYTE)v);
+		remove(img);
+	}
+	printf("%s\n", rc ? "FAILED" : "PASSED");
+	return rc < 0 ? 2 : rc;
+}
@@ -0,0 +1,39 @@
+/*------------------------------------------------------------------------*/
+/* Host stand-in of the device header for the spinlock sync port          */
+/*------------------------------------------------------------------------*/
+/* ffsystem.c port 3 (FF_SYNC_PORT == 3) masks interrupts with PRIMASK to
+/  make the test-and-set of its lock flag atomic. On the host, raising
+/  PRIMASK takes a process wide mutex and restoring it releases the mutex,
+/  so the lock flag sees the same atomicity between the threads of ffstress.
+/  The retry wait is a 1 ms sleep, as the DWT busy wait on the device.
+*/
+
+#ifndef GD32F4XX_HOST_STUB
+#define GD32F4XX_HOST_STUB
+
+#include <stdint.h>
+#include <pthread.h>
+#include <unistd.h>
+
+extern pthread_mutex_t StubIrqMask;
+
+static inline uint32_t __get_PRIMASK (void)
+{
+	return 0;	/* Called with the interrupts enabled */
+}
+
+static inline void __disable_irq (void)
+{
+	pthread_mutex_lock(&StubIrqMask);
+}
+
+static inline void __set_PRIMASK (uint32_t pm)
+{
+	(void)pm;
+	pthread_mutex_unlock(&StubIrqMask);
+}
+
+#define __DMB()			__sync_synchronize()
+#define FF_SYNC_YIELD()	usleep(1000)
+
+#endif
@@ -0,0 +1,318 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_ncm.h
+  * @brief   header file for the usbd_cdc_ncm.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * Extension class of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USB_CDC_NCM_H
+#define __USB_CDC_NCM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include  "usbd_ioreq.h"
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+/** @defgroup usbd_cdc_ncm
+  * @brief This file is the Header file for usbd_cdc_ncm.c
+  * @{
+  */
+
+
+/** @defgroup usbd_cdc_ncm_Exported_Defines
+  * @{
+  */
+#ifndef CDC_NCM_IN_EP
+#define CDC_NCM_IN_EP                                   0x81U  /* EP1 for data IN */
+#endif /* CDC_NCM_IN_EP */
+#ifndef CDC_NCM_OUT_EP
+#define CDC_NCM_OUT_EP                                  0x01U  /* EP1 for data OUT */
+#endif /* CDC_NCM_OUT_EP */
+#ifndef CDC_NCM_CMD_EP
+#define CDC_NCM_CMD_EP                                  0x82U  /* EP2 for CDC NCM commands */
+#endif /* CDC_NCM_CMD_EP */
+
+#ifndef CDC_NCM_CMD_ITF_NBR
+#define CDC_NCM_CMD_ITF_NBR                             0x00U /* Command Interface Number 0 */
+#endif /* CDC_NCM_CMD_ITF_NBR */
+
+#ifndef CDC_NCM_COM_ITF_NBR
+#define CDC_NCM_COM_ITF_NBR                             0x01U /* Communication Interface Number 1 */
+#endif /* CDC_NCM_COM_ITF_NBR */
+
+#ifndef CDC_NCM_HS_BINTERVAL
+#define CDC_NCM_HS_BINTERVAL                            0x10U
+#endif /* CDC_NCM_HS_BINTERVAL */
+
+#ifndef CDC_NCM_FS_BINTERVAL
+#define CDC_NCM_FS_BINTERVAL                            0x10U
+#endif /* CDC_NCM_FS_BINTERVAL */
+
+#ifndef USBD_SUPPORT_USER_STRING_DESC
+#define USBD_SUPPORT_USER_STRING_DESC                   1U
+#endif /* USBD_SUPPORT_USER_STRING_DESC */
+
+/* NTB sizes: a larger NTB lets more datagrams share one bulk transfer.
+   Both values must be a multiple of the HS max packet size */
+#ifndef CDC_NCM_NTB_IN_MAX_SIZE
+#define CDC_NCM_NTB_IN_MAX_SIZE                         4096U
+#endif /* CDC_NCM_NTB_IN_MAX_SIZE */
+
+#ifndef CDC_NCM_NTB_OUT_MAX_SIZE
+#define CDC_NCM_NTB_OUT_MAX_SIZE                        4096U
+#endif /* CDC_NCM_NTB_OUT_MAX_SIZE */
+
+/* Maximum number of datagrams aggregated in one IN NTB */
+#ifndef CDC_NCM_NTB_IN_MAX_DATAGRAMS
+#define CDC_NCM_NTB_IN_MAX_DATAGRAMS                    16U
+#endif /* CDC_NCM_NTB_IN_MAX_DATAGRAMS */
+
+/* Datagram alignment requested from the host in OUT NTBs, set the remainder to
+   ETH_PAD_SIZE so that the IP header of a received frame is 32-bit aligned */
+#ifndef CDC_NCM_NDP_OUT_DIVISOR
+#define CDC_NCM_NDP_OUT_DIVISOR                         4U
+#endif /* CDC_NCM_NDP_OUT_DIVISOR */
+
+#ifndef CDC_NCM_NDP_OUT_PAYLOAD_REMAINDER
+#define CDC_NCM_NDP_OUT_PAYLOAD_REMAINDER               0U
+#endif /* CDC_NCM_NDP_OUT_PAYLOAD_REMAINDER */
+
+/* CDC_NCM Endpoints parameters: you can fine tune these values depending on the needed baudrates and performance. */
+#define CDC_NCM_DATA_HS_MAX_PACKET_SIZE                 512U  /* Endpoint IN & OUT Packet size */
+#define CDC_NCM_DATA_FS_MAX_PACKET_SIZE                 64U   /* Endpoint IN & OUT Packet size */
+#define CDC_NCM_CMD_PACKET_SIZE                         16U   /* Control Endpoint Packet size */
+
+#define CDC_NCM_CONFIG_DESC_SIZ                         94U
+
+#define CDC_NCM_DATA_BUFFER_SIZE                        32U
+
+#define CDC_NCM_DATA_HS_IN_PACKET_SIZE                  CDC_NCM_DATA_HS_MAX_PACKET_SIZE
+#define CDC_NCM_DATA_HS_OUT_PACKET_SIZE                 CDC_NCM_DATA_HS_MAX_PACKET_SIZE
+
+#define CDC_NCM_DATA_FS_IN_PACKET_SIZE                  CDC_NCM_DATA_FS_MAX_PACKET_SIZE
+#define CDC_NCM_DATA_FS_OUT_PACKET_SIZE                 CDC_NCM_DATA_FS_MAX_PACKET_SIZE
+
+/*---------------------------------------------------------------------*/
+/*  CDC_NCM definitions                                                */
+/*---------------------------------------------------------------------*/
+#define CDC_NCM_SEND_ENCAPSULATED_COMMAND                       0x00U
+#define CDC_NCM_GET_ENCAPSULATED_RESPONSE                       0x01U
+#define CDC_NCM_SET_ETH_MULTICAST_FILTERS                       0x40U
+#define CDC_NCM_SET_ETH_PWRM_PATTERN_FILTER                     0x41U
+#define CDC_NCM_GET_ETH_PWRM_PATTERN_FILTER                     0x42U
+#define CDC_NCM_SET_ETH_PACKET_FILTER                           0x43U
+#define CDC_NCM_GET_ETH_STATISTIC                               0x44U
+#define CDC_NCM_GET_NTB_PARAMETERS                              0x80U
+#define CDC_NCM_GET_NTB_FORMAT                                  0x83U
+#define CDC_NCM_SET_NTB_FORMAT                                  0x84U
+#define CDC_NCM_GET_NTB_INPUT_SIZE                              0x85U
+#define CDC_NCM_SET_NTB_INPUT_SIZE                              0x86U
+
+#define CDC_NCM_NET_DISCONNECTED                                0x00U
+#define CDC_NCM_NET_CONNECTED                                   0x01U
+
+#define CDC_NCM_BMREQUEST_TYPE_NCM                              0xA1U
+
+/* NCM Class specification revision 1.0, Table 6-3: NTB Parameter Structure */
+#define CDC_NCM_NTB_PARAMETERS_SIZE                             28U
+#define CDC_NCM_NTB16_FORMAT                                    0x0000U
+#define CDC_NCM_NTB16_FORMAT_SUPPORTED                          0x0001U
+
+/* NTB16 framing: NCM Class specification revision 1.0, Tables 3-1 and 3-3 */
+#define CDC_NCM_NTH16_SIGNATURE                                 0x484D434EU /* "NCMH" */
+#define CDC_NCM_NDP16_SIGNATURE                                 0x304D434EU /* "NCM0" */
+#define CDC_NCM_NTH16_SIZE                                      12U
+#define CDC_NCM_NDP16_HEADER_SIZE                               8U
+#define CDC_NCM_NDP16_ENTRY_SIZE                                4U
+#define CDC_NCM_NDP16_MIN_SIZE                                  16U
+#define CDC_NCM_NTB_ALIGNMENT                                   4U
+
+/* Maximum number of NDPs followed in one OUT NTB */
+#define CDC_NCM_NTB_OUT_MAX_NDP                                 8U
+
+/* MAC String index */
+#define CDC_NCM_MAC_STRING_INDEX                                6U
+
+/**
+  * @}
+  */
+
+
+/** @defgroup USBD_CORE_Exported_TypesDefinitions
+  * @{
+  */
+
+/**
+  * @}
+  */
+
+typedef struct
+{
+  int8_t (* Init)(void);
+  int8_t (* DeInit)(void);
+  int8_t (* Control)(uint8_t cmd, uint8_t *pbuf, uint16_t length);
+  int8_t (* Receive)(uint8_t *Buf, uint32_t *Len);
+  int8_t (* TransmitCplt)(uint8_t *Buf, uint32_t *Len, uint8_t epnum);
+  int8_t (* Process)(USBD_HandleTypeDef *pdev);
+  const uint8_t *pStrDesc;
+} USBD_CDC_NCM_ItfTypeDef;
+
+typedef struct
+{
+  uint8_t   bmRequest;
+  uint8_t   bRequest;
+  uint16_t  wValue;
+  uint16_t  wIndex;
+  uint16_t  wLength;
+  uint8_t   data[8];
+} USBD_CDC_NCM_NotifTypeDef;
+
+/*
+ * NCM Class specification revision 1.0
+ * Table 5-2: NCM Functional Descriptor
+ */
+
+typedef struct
+{
+  uint8_t bFunctionLength;
+  uint8_t bDescriptorType;
+  uint8_t bDescriptorSubType;
+  uint16_t bcdNcmVersion;
+  uint8_t bmNetworkCapabilities;
+} __PACKED USBD_NCMFuncDescTypeDef;
+
+/*
+ * ECM Class specification revision 1.2
+ * Table 3: Ethernet Networking Functional Descriptor, also used by NCM
+ */
+
+typedef struct
+{
+  uint8_t bFunctionLength;
+  uint8_t bDescriptorType;
+  uint8_t bDescriptorSubType;
+  uint8_t iMacAddress;
+  uint8_t bEthernetStatistics3;
+  uint8_t bEthernetStatistics2;
+  uint8_t bEthernetStatistics1;
+  uint8_t bEthernetStatistics0;
+  uint16_t wMaxSegmentSize;
+  uint16_t wNumberMCFilters;
+  uint8_t bNumberPowerFilters;
+} __PACKED USBD_NCMEthFuncDescTypeDef;
+
+/* Walks the datagrams of one received NTB16 */
+typedef struct
+{
+  uint8_t  *pNtb;
+  uint32_t BlockLength;
+  uint32_t NdpIndex;
+  uint32_t EntryIndex;
+  uint32_t NdpCount;
+} USBD_CDC_NCM_NtbParserTypeDef;
+
+typedef struct
+{
+  uint32_t data[CDC_NCM_DATA_BUFFER_SIZE / 4U];      /* Force 32-bit alignment */
+  uint8_t  CmdOpCode;
+  uint8_t  CmdLength;
+  uint8_t  AltSetting;
+  uint8_t  Reserved;   /* Reserved Byte to force 4 bytes alignment of following fields */
+  uint8_t  *RxBuffer;
+  uint8_t  *TxBuffer[2];
+  uint32_t RxLength;
+  uint32_t TxLength;
+  uint32_t NtbInMaxSize;
+  uint32_t TxOffset;                                 /* Next free byte of the pending NTB */
+  uint32_t TxCount;                                  /* Datagrams in the pending NTB */
+  uint16_t TxSequence;
+  uint8_t  TxPending;                                /* Index of the NTB being filled */
+  uint8_t  Reserved2;
+
+  __IO uint32_t TxState;
+  __IO uint32_t TxFilling;
+  __IO uint32_t RxState;
+
+  __IO uint32_t  MaxPcktLen;
+  __IO uint32_t  LinkStatus;
+  __IO uint32_t  NotificationStatus;
+  USBD_CDC_NCM_NotifTypeDef   Req;
+} USBD_CDC_NCM_HandleTypeDef;
+
+
+/** @defgroup USBD_CORE_Exported_Macros
+  * @{
+  */
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CORE_Exported_Variables
+  * @{
+  */
+
+extern USBD_ClassTypeDef  USBD_CDC_NCM;
+#define USBD_CDC_NCM_CLASS &USBD_CDC_NCM
+/**
+  * @}
+  */
+
+/** @defgroup USB_CORE_Exported_Functions
+  * @{
+  */
+uint8_t  USBD_CDC_NCM_RegisterInterface(USBD_HandleTypeDef *pdev,
+                                        USBD_CDC_NCM_ItfTypeDef *fops);
+
+uint8_t  USBD_CDC_NCM_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff0,
+                                  uint8_t *pbuff1);
+
+uint8_t  USBD_CDC_NCM_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff);
+
+uint8_t  USBD_CDC_NCM_ReceivePacket(USBD_HandleTypeDef *pdev);
+
+uint8_t *USBD_CDC_NCM_AllocTxDatagram(USBD_HandleTypeDef *pdev, uint16_t length);
+
+uint8_t  USBD_CDC_NCM_TransmitDatagram(USBD_HandleTypeDef *pdev);
+
+uint8_t  USBD_CDC_NCM_ParseNtb(USBD_CDC_NCM_NtbParserTypeDef *pParser,
+                               uint8_t *pNtb, uint32_t length);
+
+uint8_t  USBD_CDC_NCM_GetDatagram(USBD_CDC_NCM_NtbParserTypeDef *pParser,
+                                  uint8_t **pDatagram, uint16_t *pLength);
+
+uint8_t  USBD_CDC_NCM_SendNotification(USBD_HandleTypeDef *pdev,
+                                       USBD_CDC_NotifCodeTypeDef  Notif,
+                                       uint16_t bVal, uint8_t *pData);
+/**
+  * @}
+  */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __USB_CDC_NCM_H */
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
@@ -0,0 +1,69 @@
+/**
+  ******************************************************************************
+  * @file    Inc/usbd_cdc_ncm_if_template.h
+  * @brief   Header for usbd_cdc_ncm_if_template.c file.
+  ******************************************************************************
+  * @attention
+  *
+  * Extension class of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CDC_NCM_IF_H
+#define __USBD_CDC_NCM_IF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_cdc_ncm.h"
+#include "lwip/netif.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+
+/* MAC address given to the host side interface */
+#define CDC_NCM_MAC_STR_DESC                 (uint8_t *)"000202030000"
+
+/* MAC address of the lwIP interface, must differ from CDC_NCM_MAC_STR_DESC */
+#define CDC_NCM_MAC_ADDR0                    0x00U
+#define CDC_NCM_MAC_ADDR1                    0x02U
+#define CDC_NCM_MAC_ADDR2                    0x02U
+#define CDC_NCM_MAC_ADDR3                    0x03U
+#define CDC_NCM_MAC_ADDR4                    0x00U
+#define CDC_NCM_MAC_ADDR5                    0x01U
+
+/* Max Number of Trials waiting for room in the IN NTB */
+#define CDC_NCM_MAX_TX_WAIT_TRIALS           1000000U
+
+/* OUT NTB buffers: a buffer is reused once lwIP has freed all the pbufs
+   pointing into it, the OUT endpoint is NAKed while none is free */
+#define CDC_NCM_RX_NTB_NBR                   3U
+
+/* pbuf_custom descriptors for the received datagrams */
+#define CDC_NCM_RX_PBUF_NBR                  32U
+
+/* Ethernet Maximum Segment size, typically 1514 bytes */
+#define CDC_NCM_ETH_MAX_SEGSZE                                  1514U
+
+/* Number of Ethernet multicast filters */
+#define CDC_NCM_ETH_NBR_MACFILTERS                              0U
+
+/* Number of wakeup power filters */
+#define CDC_NCM_ETH_NBR_PWRFILTERS                              0U
+
+
+#define CDC_NCM_CONNECT_SPEED_UPSTREAM                          0x05F5E100U /* 100Mbps */
+#define CDC_NCM_CONNECT_SPEED_DOWNSTREAM                        0x05F5E100U /* 100Mbps */
+
+extern USBD_CDC_NCM_ItfTypeDef                          USBD_CDC_NCM_fops;
+
+/* Exported macro ------------------------------------------------------------*/
+/* Exported functions ------------------------------------------------------- */
+err_t CDC_NCM_Itf_NetifInit(struct netif *netif);
+
+#endif /* __USBD_CDC_NCM_IF_H */
+
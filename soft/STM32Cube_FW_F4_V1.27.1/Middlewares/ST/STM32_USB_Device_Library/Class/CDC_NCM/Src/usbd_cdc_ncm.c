@@ -0,0 +1,1455 @@
+/**
+  ******************************************************************************
+  * @file    usbd_cdc_ncm.c
+  * @brief   This file provides the high layer firmware functions to manage the
+  *          following functionalities of the USB CDC_NCM Class:
+  *           - Initialization and Configuration of high and low layer
+  *           - Enumeration as CDC_NCM Device (and enumeration for each implemented memory interface)
+  *           - OUT/IN data transfer of NTB16 blocks
+  *           - Aggregation of IN datagrams and parsing of OUT datagrams
+  *           - Command IN transfer (class requests management)
+  *           - Error management
+  *
+  ******************************************************************************
+  * @attention
+  *
+  * Extension class of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  * @verbatim
+  *
+  *          ===================================================================
+  *                                CDC NCM Class Driver Description
+  *          ===================================================================
+  *           This driver manages the "Universal Serial Bus Communications Class
+  *           Subclass Specification for Network Control Model Devices Revision 1.0"
+  *           with the 16-bit NTB format only.
+  *
+  *           IN datagrams are written by the application straight into the NTB
+  *           being built (USBD_CDC_NCM_AllocTxDatagram) and queued with
+  *           USBD_CDC_NCM_TransmitDatagram. Two NTB buffers are used: while one
+  *           is on the bus, the datagrams queued in the meantime are aggregated
+  *           in the other one and sent in a single bulk transfer as soon as the
+  *           endpoint is free.
+  *
+  *           A whole OUT NTB is received in one bulk transfer and handed to the
+  *           Receive callback. The application walks its datagrams in place with
+  *           USBD_CDC_NCM_ParseNtb/USBD_CDC_NCM_GetDatagram, then gives the class
+  *           a free buffer with USBD_CDC_NCM_SetRxBuffer/USBD_CDC_NCM_ReceivePacket.
+  *           The OUT endpoint is NAKed until it does so.
+  *
+  *  @endverbatim
+  *
+  ******************************************************************************
+  */
+
+/* BSPDependencies
+- "stm32xxxxx_{eval}{discovery}{nucleo_144}.c"
+- "stm32xxxxx_{eval}{discovery}_io.c"
+EndBSPDependencies */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_cdc_ncm.h"
+#include "usbd_ctlreq.h"
+
+#ifndef __USBD_CDC_NCM_IF_H
+#include "usbd_cdc_ncm_if_template.h"
+#endif /* __USBD_CDC_NCM_IF_H */
+
+
+/** @addtogroup STM32_USB_DEVICE_LIBRARY
+  * @{
+  */
+
+
+/** @defgroup USBD_CDC_NCM
+  * @brief usbd core module
+  * @{
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_TypesDefinitions
+  * @{
+  */
+
+/**
+  * @}
+  */
+
+
+/** @defgroup USBD_CDC_NCM_Private_Defines
+  * @{
+  */
+
+/* Smallest dwNtbInMaxSize a host is allowed to select */
+#define CDC_NCM_NTB_MIN_IN_SIZE                         2048U
+
+/* Layout of an IN NTB: NTH16, NDP16 sized for CDC_NCM_NTB_IN_MAX_DATAGRAMS, datagrams */
+#define CDC_NCM_TX_NDP_INDEX                            CDC_NCM_NTH16_SIZE
+#define CDC_NCM_TX_DATAGRAM_INDEX                       CDC_NCM_ALIGN(CDC_NCM_TX_NDP_INDEX + \
+                                                                      CDC_NCM_NDP16_HEADER_SIZE + \
+                                                                      ((CDC_NCM_NTB_IN_MAX_DATAGRAMS + 1U) * \
+                                                                       CDC_NCM_NDP16_ENTRY_SIZE))
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_Macros
+  * @{
+  */
+#define CDC_NCM_ALIGN(x)    (((x) + (CDC_NCM_NTB_ALIGNMENT - 1U)) & ~(CDC_NCM_NTB_ALIGNMENT - 1U))
+
+/* Interface numbers, assigned by the composite builder in a composite device */
+#ifdef USE_USBD_COMPOSITE
+#define CDC_NCM_CMD_ITF(pdev)     ((pdev)->tclasslist[(pdev)->classId].Ifs[0])
+#define CDC_NCM_DATA_ITF(pdev)    ((pdev)->tclasslist[(pdev)->classId].Ifs[1])
+#else
+#define CDC_NCM_CMD_ITF(pdev)     CDC_NCM_CMD_ITF_NBR
+#define CDC_NCM_DATA_ITF(pdev)    CDC_NCM_COM_ITF_NBR
+#endif /* USE_USBD_COMPOSITE */
+
+/**
+  * @}
+  */
+
+
+/** @defgroup USBD_CDC_NCM_Private_FunctionPrototypes
+  * @{
+  */
+
+static uint8_t USBD_CDC_NCM_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_CDC_NCM_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx);
+static uint8_t USBD_CDC_NCM_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_CDC_NCM_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum);
+static uint8_t USBD_CDC_NCM_EP0_RxReady(USBD_HandleTypeDef *pdev);
+static uint8_t USBD_CDC_NCM_Setup(USBD_HandleTypeDef *pdev,
+                                  USBD_SetupReqTypedef *req);
+static void USBD_CDC_NCM_SetAltSetting(USBD_HandleTypeDef *pdev, uint8_t alt);
+static void USBD_CDC_NCM_GetNtbParameters(uint8_t *pbuf);
+static void USBD_CDC_NCM_TxNtbSend(USBD_HandleTypeDef *pdev);
+static void USBD_CDC_NCM_PutU16(uint8_t *pbuf, uint16_t val);
+static void USBD_CDC_NCM_PutU32(uint8_t *pbuf, uint32_t val);
+static uint32_t USBD_CDC_NCM_GetU32(uint8_t *pbuf);
+#ifndef USE_USBD_COMPOSITE
+static uint8_t *USBD_CDC_NCM_GetFSCfgDesc(uint16_t *length);
+static uint8_t *USBD_CDC_NCM_GetHSCfgDesc(uint16_t *length);
+static uint8_t *USBD_CDC_NCM_GetOtherSpeedCfgDesc(uint16_t *length);
+#endif /* USE_USBD_COMPOSITE */
+#if (USBD_SUPPORT_USER_STRING_DESC == 1U)
+static uint8_t *USBD_CDC_NCM_USRStringDescriptor(USBD_HandleTypeDef *pdev,
+                                                 uint8_t index, uint16_t *length);
+#endif /* USBD_SUPPORT_USER_STRING_DESC */
+#ifndef USE_USBD_COMPOSITE
+uint8_t *USBD_CDC_NCM_GetDeviceQualifierDescriptor(uint16_t *length);
+#endif /* USE_USBD_COMPOSITE */
+#ifndef USE_USBD_COMPOSITE
+/* USB Standard Device Descriptor */
+__ALIGN_BEGIN static uint8_t USBD_CDC_NCM_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIER_DESC] __ALIGN_END =
+{
+  USB_LEN_DEV_QUALIFIER_DESC,
+  USB_DESC_TYPE_DEVICE_QUALIFIER,
+  0x00,
+  0x02,
+  0x00,
+  0x00,
+  0x00,
+  0x40,
+  0x01,
+  0x00,
+};
+#endif /* USE_USBD_COMPOSITE */
+static uint32_t ConnSpeedTab[2] = {CDC_NCM_CONNECT_SPEED_UPSTREAM,
+                                   CDC_NCM_CONNECT_SPEED_DOWNSTREAM
+                                  };
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_Variables
+  * @{
+  */
+
+
+/* CDC_NCM interface class callbacks structure */
+USBD_ClassTypeDef USBD_CDC_NCM =
+{
+  USBD_CDC_NCM_Init,
+  USBD_CDC_NCM_DeInit,
+  USBD_CDC_NCM_Setup,
+  NULL,                 /* EP0_TxSent, */
+  USBD_CDC_NCM_EP0_RxReady,
+  USBD_CDC_NCM_DataIn,
+  USBD_CDC_NCM_DataOut,
+  NULL,
+  NULL,
+  NULL,
+#ifdef USE_USBD_COMPOSITE
+  NULL,
+  NULL,
+  NULL,
+  NULL,
+#else
+  USBD_CDC_NCM_GetHSCfgDesc,
+  USBD_CDC_NCM_GetFSCfgDesc,
+  USBD_CDC_NCM_GetOtherSpeedCfgDesc,
+  USBD_CDC_NCM_GetDeviceQualifierDescriptor,
+#endif /* USE_USBD_COMPOSITE */
+#if (USBD_SUPPORT_USER_STRING_DESC == 1U)
+  USBD_CDC_NCM_USRStringDescriptor,
+#endif  /* USBD_SUPPORT_USER_STRING_DESC */
+};
+#ifndef USE_USBD_COMPOSITE
+
+/* USB CDC_NCM device Configuration Descriptor */
+__ALIGN_BEGIN static uint8_t USBD_CDC_NCM_CfgDesc[] __ALIGN_END =
+{
+  /* Configuration Descriptor */
+  0x09,                                     /* bLength: Configuration Descriptor size */
+  USB_DESC_TYPE_CONFIGURATION,              /* bDescriptorType: Configuration */
+  LOBYTE(CDC_NCM_CONFIG_DESC_SIZ),          /* wTotalLength: Total size of the Config descriptor */
+  HIBYTE(CDC_NCM_CONFIG_DESC_SIZ),
+  0x02,                                     /* bNumInterfaces: 2 interfaces */
+  0x01,                                     /* bConfigurationValue: Configuration value */
+  0x00,                                     /* iConfiguration: Index of string descriptor
+                                               describing the configuration */
+#if (USBD_SELF_POWERED == 1U)
+  0xC0,                                     /* bmAttributes: Bus Powered according to user configuration */
+#else
+  0x80,                                     /* bmAttributes: Bus Powered according to user configuration */
+#endif /* USBD_SELF_POWERED */
+  USBD_MAX_POWER,                           /* MaxPower (mA) */
+
+  /*---------------------------------------------------------------------------*/
+  /* IAD descriptor */
+  0x08,                                     /* bLength */
+  0x0B,                                     /* bDescriptorType */
+  CDC_NCM_CMD_ITF_NBR,                      /* bFirstInterface */
+  0x02,                                     /* bInterfaceCount */
+  0x02,                                     /* bFunctionClass: Communication Interface Class */
+  0x0D,                                     /* bFunctionSubClass: Network Control Model */
+  0x00,                                     /* bFunctionProtocol */
+  0x00,                                     /* iFunction */
+
+  /* Interface Descriptor */
+  0x09,                                     /* bLength: Interface Descriptor size */
+  USB_DESC_TYPE_INTERFACE,                  /* bDescriptorType: Interface descriptor type */
+  CDC_NCM_CMD_ITF_NBR,                      /* bInterfaceNumber: Number of Interface */
+  0x00,                                     /* bAlternateSetting: Alternate setting */
+  0x01,                                     /* bNumEndpoints: One endpoint used */
+  0x02,                                     /* bInterfaceClass: Communication Interface Class */
+  0x0D,                                     /* bInterfaceSubClass: Network Control Model */
+  0x00,                                     /* bInterfaceProtocol: No specific protocol required */
+  0x00,                                     /* iInterface */
+
+  /* Header Functional Descriptor */
+  0x05,                                     /* bLength: Endpoint Descriptor size */
+  0x24,                                     /* bDescriptorType: CS_INTERFACE */
+  0x00,                                     /* bDescriptorSubtype: Header functional descriptor */
+  0x10,                                     /* bcdCDC: spec release number: 1.10 */
+  0x01,
+
+  /* Union Functional Descriptor */
+  0x05,                                     /* bFunctionLength */
+  0x24,                                     /* bDescriptorType: CS_INTERFACE */
+  0x06,                                     /* bDescriptorSubtype: Union functional descriptor */
+  CDC_NCM_CMD_ITF_NBR,                      /* bMasterInterface: Communication class interface */
+  CDC_NCM_COM_ITF_NBR,                      /* bSlaveInterface0: Data Class Interface */
+
+  /* Ethernet Networking Functional Descriptor */
+  0x0D,                                     /* bFunctionLength */
+  0x24,                                     /* bDescriptorType: CS_INTERFACE */
+  0x0F,                                     /* Ethernet Networking functional descriptor subtype  */
+  CDC_NCM_MAC_STRING_INDEX,                 /* Device's MAC string index */
+  0x00,                                     /* Ethernet statistics byte 3 (bitmap) */
+  0x00,                                     /* Ethernet statistics byte 2 (bitmap) */
+  0x00,                                     /* Ethernet statistics byte 1 (bitmap) */
+  0x00,                                     /* Ethernet statistics byte 0 (bitmap) */
+  LOBYTE(CDC_NCM_ETH_MAX_SEGSZE),
+  HIBYTE(CDC_NCM_ETH_MAX_SEGSZE),           /* wMaxSegmentSize: Ethernet Maximum Segment size, typically 1514 bytes */
+  LOBYTE(CDC_NCM_ETH_NBR_MACFILTERS),
+  HIBYTE(CDC_NCM_ETH_NBR_MACFILTERS),       /* wNumberMCFilters: the number of multicast filters */
+  CDC_NCM_ETH_NBR_PWRFILTERS,               /* bNumberPowerFilters: the number of wakeup power filters */
+
+  /* NCM Functional Descriptor */
+  0x06,                                     /* bFunctionLength */
+  0x24,                                     /* bDescriptorType: CS_INTERFACE */
+  0x1A,                                     /* bDescriptorSubtype: NCM functional descriptor */
+  0x00,                                     /* bcdNcmVersion: spec release number: 1.00 */
+  0x01,
+  0x00,                                     /* bmNetworkCapabilities: no optional request */
+
+  /* Communication Endpoint Descriptor */
+  0x07,                                     /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_ENDPOINT,                   /* bDescriptorType: Endpoint */
+  CDC_NCM_CMD_EP,                           /* bEndpointAddress */
+  0x03,                                     /* bmAttributes: Interrupt */
+  LOBYTE(CDC_NCM_CMD_PACKET_SIZE),          /* wMaxPacketSize */
+  HIBYTE(CDC_NCM_CMD_PACKET_SIZE),
+  CDC_NCM_FS_BINTERVAL,                     /* bInterval */
+
+  /*----------------------*/
+
+  /* Data class interface descriptor, alternate setting 0: no traffic */
+  0x09,                                     /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_INTERFACE,                  /* bDescriptorType: */
+  CDC_NCM_COM_ITF_NBR,                      /* bInterfaceNumber: Number of Interface */
+  0x00,                                     /* bAlternateSetting: Alternate setting */
+  0x00,                                     /* bNumEndpoints: No endpoint */
+  0x0A,                                     /* bInterfaceClass: CDC Data */
+  0x00,                                     /* bInterfaceSubClass */
+  0x01,                                     /* bInterfaceProtocol: Network Transfer Block */
+  0x00,                                     /* iInterface */
+
+  /* Data class interface descriptor, alternate setting 1: NTB transfers */
+  0x09,                                     /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_INTERFACE,                  /* bDescriptorType: */
+  CDC_NCM_COM_ITF_NBR,                      /* bInterfaceNumber: Number of Interface */
+  0x01,                                     /* bAlternateSetting: Alternate setting */
+  0x02,                                     /* bNumEndpoints: Two endpoints used */
+  0x0A,                                     /* bInterfaceClass: CDC Data */
+  0x00,                                     /* bInterfaceSubClass */
+  0x01,                                     /* bInterfaceProtocol: Network Transfer Block */
+  0x00,                                     /* iInterface */
+
+  /* Endpoint OUT Descriptor */
+  0x07,                                     /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_ENDPOINT,                   /* bDescriptorType: Endpoint */
+  CDC_NCM_OUT_EP,                           /* bEndpointAddress */
+  0x02,                                     /* bmAttributes: Bulk */
+  LOBYTE(CDC_NCM_DATA_FS_MAX_PACKET_SIZE),  /* wMaxPacketSize */
+  HIBYTE(CDC_NCM_DATA_FS_MAX_PACKET_SIZE),
+  0x00,                                     /* bInterval */
+
+  /* Endpoint IN Descriptor */
+  0x07,                                     /* bLength: Endpoint Descriptor size */
+  USB_DESC_TYPE_ENDPOINT,                   /* bDescriptorType: Endpoint */
+  CDC_NCM_IN_EP,                            /* bEndpointAddress */
+  0x02,                                     /* bmAttributes: Bulk */
+  LOBYTE(CDC_NCM_DATA_FS_MAX_PACKET_SIZE),  /* wMaxPacketSize */
+  HIBYTE(CDC_NCM_DATA_FS_MAX_PACKET_SIZE),
+  0x00                                      /* bInterval */
+} ;
+#endif /* USE_USBD_COMPOSITE */
+
+static uint8_t NCMInEpAdd = CDC_NCM_IN_EP;
+static uint8_t NCMOutEpAdd = CDC_NCM_OUT_EP;
+static uint8_t NCMCmdEpAdd = CDC_NCM_CMD_EP;
+
+/**
+  * @}
+  */
+
+/** @defgroup USBD_CDC_NCM_Private_Functions
+  * @{
+  */
+
+/**
+  * @brief  USBD_CDC_NCM_Init
+  *         Initialize the CDC_NCM interface
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_Init(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  UNUSED(cfgidx);
+
+  USBD_CDC_NCM_HandleTypeDef *hcdc;
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  NCMCmdEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_INTR);
+#endif /* USE_USBD_COMPOSITE */
+
+  hcdc = (USBD_CDC_NCM_HandleTypeDef *)USBD_malloc(sizeof(USBD_CDC_NCM_HandleTypeDef));
+
+  if (hcdc == NULL)
+  {
+    pdev->pClassDataCmsit[pdev->classId] = NULL;
+    return (uint8_t)USBD_EMEM;
+  }
+
+  (void)USBD_memset(hcdc, 0, sizeof(USBD_CDC_NCM_HandleTypeDef));
+
+  pdev->pClassDataCmsit[pdev->classId] = (void *)hcdc;
+  pdev->pClassData = pdev->pClassDataCmsit[pdev->classId];
+
+  /* Set bInterval for CDC NCM CMD Endpoint */
+  if (pdev->dev_speed == USBD_SPEED_HIGH)
+  {
+    pdev->ep_in[NCMCmdEpAdd & 0xFU].bInterval = CDC_NCM_HS_BINTERVAL;
+  }
+  else
+  {
+    pdev->ep_in[NCMCmdEpAdd & 0xFU].bInterval = CDC_NCM_FS_BINTERVAL;
+  }
+
+  /* Open Command IN EP, the data endpoints are opened with alternate setting 1 */
+  (void)USBD_LL_OpenEP(pdev, NCMCmdEpAdd, USBD_EP_TYPE_INTR, CDC_NCM_CMD_PACKET_SIZE);
+  pdev->ep_in[NCMCmdEpAdd & 0xFU].is_used = 1U;
+
+  hcdc->RxBuffer = NULL;
+  hcdc->TxBuffer[0] = NULL;
+  hcdc->TxBuffer[1] = NULL;
+
+  /* Init  physical Interface components */
+  ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData[pdev->classId])->Init();
+
+  /* Init Xfer states */
+  hcdc->AltSetting = 0U;
+  hcdc->TxState = 0U;
+  hcdc->TxFilling = 0U;
+  hcdc->RxState = 0U;
+  hcdc->RxLength = 0U;
+  hcdc->TxLength = 0U;
+  hcdc->TxCount = 0U;
+  hcdc->TxPending = 0U;
+  hcdc->TxOffset = CDC_NCM_TX_DATAGRAM_INDEX;
+  hcdc->NtbInMaxSize = CDC_NCM_NTB_IN_MAX_SIZE;
+  hcdc->LinkStatus = 0U;
+  hcdc->NotificationStatus = 0U;
+  hcdc->MaxPcktLen = (pdev->dev_speed == USBD_SPEED_HIGH) ? CDC_NCM_DATA_HS_MAX_PACKET_SIZE : CDC_NCM_DATA_FS_MAX_PACKET_SIZE;
+
+  /* RxBuffer may still be NULL here: the interface provides it when an NTB buffer
+     becomes free, the OUT endpoint is armed with alternate setting 1 only if set */
+  if ((hcdc->TxBuffer[0] == NULL) || (hcdc->TxBuffer[1] == NULL))
+  {
+    return (uint8_t)USBD_EMEM;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_DeInit
+  *         DeInitialize the CDC_NCM layer
+  * @param  pdev: device instance
+  * @param  cfgidx: Configuration index
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
+{
+  UNUSED(cfgidx);
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  NCMInEpAdd  = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_BULK);
+  NCMOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK);
+  NCMCmdEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_INTR);
+#endif /* USE_USBD_COMPOSITE */
+
+  /* Close EP IN */
+  (void)USBD_LL_CloseEP(pdev, NCMInEpAdd);
+  pdev->ep_in[NCMInEpAdd & 0xFU].is_used = 0U;
+
+  /* Close EP OUT */
+  (void)USBD_LL_CloseEP(pdev, NCMOutEpAdd);
+  pdev->ep_out[NCMOutEpAdd & 0xFU].is_used = 0U;
+
+  /* Close Command IN EP */
+  (void)USBD_LL_CloseEP(pdev, NCMCmdEpAdd);
+  pdev->ep_in[NCMCmdEpAdd & 0xFU].is_used = 0U;
+  pdev->ep_in[NCMCmdEpAdd & 0xFU].bInterval = 0U;
+
+  /* DeInit  physical Interface components */
+  if (pdev->pClassDataCmsit[pdev->classId] != NULL)
+  {
+    ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData[pdev->classId])->DeInit();
+    USBD_free(pdev->pClassDataCmsit[pdev->classId]);
+    pdev->pClassDataCmsit[pdev->classId] = NULL;
+    pdev->pClassData = NULL;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_Setup
+  *         Handle the CDC_NCM specific requests
+  * @param  pdev: instance
+  * @param  req: usb requests
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_Setup(USBD_HandleTypeDef *pdev,
+                                  USBD_SetupReqTypedef *req)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *) pdev->pClassDataCmsit[pdev->classId];
+  USBD_CDC_NCM_ItfTypeDef *NcmInterface = (USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData[pdev->classId];
+  USBD_StatusTypeDef ret = USBD_OK;
+  uint16_t len;
+  uint16_t status_info = 0U;
+  uint8_t ifalt = 0U;
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  switch (req->bmRequest & USB_REQ_TYPE_MASK)
+  {
+    case USB_REQ_TYPE_CLASS :
+      switch (req->bRequest)
+      {
+        case CDC_NCM_GET_NTB_PARAMETERS:
+          USBD_CDC_NCM_GetNtbParameters((uint8_t *)hcdc->data);
+          len = MIN(CDC_NCM_NTB_PARAMETERS_SIZE, req->wLength);
+          (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, len);
+          break;
+
+        case CDC_NCM_GET_NTB_FORMAT:
+          USBD_CDC_NCM_PutU16((uint8_t *)hcdc->data, CDC_NCM_NTB16_FORMAT);
+          len = MIN(2U, req->wLength);
+          (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, len);
+          break;
+
+        case CDC_NCM_SET_NTB_FORMAT:
+          /* Only the 16-bit NTB format is supported */
+          if (req->wValue != CDC_NCM_NTB16_FORMAT)
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case CDC_NCM_GET_NTB_INPUT_SIZE:
+          USBD_CDC_NCM_PutU32((uint8_t *)hcdc->data, hcdc->NtbInMaxSize);
+          len = MIN(4U, req->wLength);
+          (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, len);
+          break;
+
+        default:
+          if (req->wLength != 0U)
+          {
+            if ((req->bmRequest & 0x80U) != 0U)
+            {
+              NcmInterface->Control(req->bRequest,
+                                    (uint8_t *)hcdc->data, req->wLength);
+
+              len = MIN(CDC_NCM_DATA_BUFFER_SIZE, req->wLength);
+              (void)USBD_CtlSendData(pdev, (uint8_t *)hcdc->data, len);
+            }
+            else
+            {
+              hcdc->CmdOpCode = req->bRequest;
+              hcdc->CmdLength = (uint8_t)MIN(req->wLength, CDC_NCM_DATA_BUFFER_SIZE);
+
+              (void)USBD_CtlPrepareRx(pdev, (uint8_t *)hcdc->data, hcdc->CmdLength);
+            }
+          }
+          else
+          {
+            NcmInterface->Control(req->bRequest, (uint8_t *)req, 0U);
+          }
+          break;
+      }
+      break;
+
+    case USB_REQ_TYPE_STANDARD:
+      switch (req->bRequest)
+      {
+        case USB_REQ_GET_STATUS:
+          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          {
+            (void)USBD_CtlSendData(pdev, (uint8_t *)&status_info, 2U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_GET_INTERFACE:
+          if (pdev->dev_state == USBD_STATE_CONFIGURED)
+          {
+            if (LOBYTE(req->wIndex) == CDC_NCM_DATA_ITF(pdev))
+            {
+              ifalt = hcdc->AltSetting;
+            }
+            (void)USBD_CtlSendData(pdev, &ifalt, 1U);
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_SET_INTERFACE:
+          if ((pdev->dev_state == USBD_STATE_CONFIGURED) && (req->wValue <= 1U) &&
+              ((LOBYTE(req->wIndex) == CDC_NCM_DATA_ITF(pdev)) || (req->wValue == 0U)))
+          {
+            if (LOBYTE(req->wIndex) == CDC_NCM_DATA_ITF(pdev))
+            {
+              USBD_CDC_NCM_SetAltSetting(pdev, (uint8_t)req->wValue);
+            }
+          }
+          else
+          {
+            USBD_CtlError(pdev, req);
+            ret = USBD_FAIL;
+          }
+          break;
+
+        case USB_REQ_CLEAR_FEATURE:
+          break;
+
+        default:
+          USBD_CtlError(pdev, req);
+          ret = USBD_FAIL;
+          break;
+      }
+      break;
+
+    default:
+      USBD_CtlError(pdev, req);
+      ret = USBD_FAIL;
+      break;
+  }
+
+  return (uint8_t)ret;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_DataIn
+  *         Data sent on non-control IN endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  PCD_HandleTypeDef *hpcd = (PCD_HandleTypeDef *)pdev->pData;
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  NCMInEpAdd  = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_BULK);
+#endif /* USE_USBD_COMPOSITE */
+
+  if (pdev->pClassDataCmsit[pdev->classId] == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (epnum == (NCMInEpAdd & 0x7FU))
+  {
+    if ((pdev->ep_in[epnum & 0xFU].total_length > 0U) &&
+        ((pdev->ep_in[epnum & 0xFU].total_length % hpcd->IN_ep[epnum & 0xFU].maxpacket) == 0U))
+    {
+      /* Update the packet total length */
+      pdev->ep_in[epnum & 0xFU].total_length = 0U;
+
+      /* Send ZLP */
+      (void)USBD_LL_Transmit(pdev, epnum, NULL, 0U);
+    }
+    else
+    {
+      if (((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData[pdev->classId])->TransmitCplt != NULL)
+      {
+        ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData[pdev->classId])->TransmitCplt(hcdc->TxBuffer[hcdc->TxPending ^ 1U],
+                                                                                  &hcdc->TxLength, epnum);
+      }
+
+      /* Send the datagrams aggregated while the previous NTB was on the bus,
+         unless the application is still writing one of them */
+      if ((hcdc->TxCount != 0U) && (hcdc->TxFilling == 0U))
+      {
+        USBD_CDC_NCM_TxNtbSend(pdev);
+      }
+      else
+      {
+        hcdc->TxState = 0U;
+      }
+    }
+  }
+  else if (epnum == (NCMCmdEpAdd & 0x7FU))
+  {
+    if (hcdc->NotificationStatus != 0U)
+    {
+      (void)USBD_CDC_NCM_SendNotification(pdev, CONNECTION_SPEED_CHANGE,
+                                          0U, (uint8_t *)ConnSpeedTab);
+
+      hcdc->NotificationStatus = 0U;
+    }
+  }
+  else
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_DataOut
+  *         Data received on non-control Out endpoint
+  * @param  pdev: device instance
+  * @param  epnum: endpoint number
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  NCMOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK);
+#endif /* USE_USBD_COMPOSITE */
+
+  if (pdev->pClassDataCmsit[pdev->classId] == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (epnum == NCMOutEpAdd)
+  {
+    /* The whole NTB was received in one transfer, terminated by a short packet
+       or by reaching dwNtbOutMaxSize */
+    hcdc->RxLength = USBD_LL_GetRxDataSize(pdev, epnum);
+
+    /* The OUT endpoint stays NAKed until the application provides the next
+       NTB buffer with USBD_CDC_NCM_ReceivePacket */
+    ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData[pdev->classId])->Receive(hcdc->RxBuffer, &hcdc->RxLength);
+  }
+  else
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_EP0_RxReady
+  *         Handle EP0 Rx Ready event
+  * @param  pdev: device instance
+  * @retval status
+  */
+static uint8_t USBD_CDC_NCM_EP0_RxReady(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint32_t NtbInSize;
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  if (hcdc->CmdOpCode == CDC_NCM_SET_NTB_INPUT_SIZE)
+  {
+    /* Sizes below the minimum allowed by the specification are ignored */
+    NtbInSize = USBD_CDC_NCM_GetU32((uint8_t *)hcdc->data);
+
+    if ((hcdc->CmdLength >= 4U) && (NtbInSize >= CDC_NCM_NTB_MIN_IN_SIZE))
+    {
+      hcdc->NtbInMaxSize = MIN(NtbInSize, CDC_NCM_NTB_IN_MAX_SIZE);
+    }
+    hcdc->CmdOpCode = 0xFFU;
+  }
+  else if ((pdev->pUserData[pdev->classId] != NULL) && (hcdc->CmdOpCode != 0xFFU))
+  {
+    ((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData[pdev->classId])->Control(hcdc->CmdOpCode,
+                                                                         (uint8_t *)hcdc->data,
+                                                                         (uint16_t)hcdc->CmdLength);
+    hcdc->CmdOpCode = 0xFFU;
+  }
+  else
+  {
+    /* nothing to do */
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_SetAltSetting
+  *         Select the alternate setting of the data interface
+  * @param  pdev: device instance
+  * @param  alt: alternate setting, 0 stops and 1 (re)starts the NTB transfers
+  * @retval None
+  */
+static void USBD_CDC_NCM_SetAltSetting(USBD_HandleTypeDef *pdev, uint8_t alt)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  NCMInEpAdd  = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_BULK);
+  NCMOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK);
+#endif /* USE_USBD_COMPOSITE */
+
+  /* Selecting any alternate setting resets the data interface */
+  if (pdev->ep_in[NCMInEpAdd & 0xFU].is_used != 0U)
+  {
+    (void)USBD_LL_CloseEP(pdev, NCMInEpAdd);
+    pdev->ep_in[NCMInEpAdd & 0xFU].is_used = 0U;
+  }
+
+  if (pdev->ep_out[NCMOutEpAdd & 0xFU].is_used != 0U)
+  {
+    (void)USBD_LL_CloseEP(pdev, NCMOutEpAdd);
+    pdev->ep_out[NCMOutEpAdd & 0xFU].is_used = 0U;
+  }
+
+  hcdc->AltSetting = alt;
+  hcdc->TxState = 0U;
+  hcdc->TxFilling = 0U;
+  hcdc->TxCount = 0U;
+  hcdc->TxPending = 0U;
+  hcdc->TxOffset = CDC_NCM_TX_DATAGRAM_INDEX;
+  hcdc->TxSequence = 0U;
+  hcdc->RxLength = 0U;
+
+  if (alt == 0U)
+  {
+    /* NTB parameters return to their default values */
+    hcdc->NtbInMaxSize = CDC_NCM_NTB_IN_MAX_SIZE;
+    hcdc->LinkStatus = 0U;
+    return;
+  }
+
+  /* Open EP IN */
+  (void)USBD_LL_OpenEP(pdev, NCMInEpAdd, USBD_EP_TYPE_BULK, (uint16_t)hcdc->MaxPcktLen);
+  pdev->ep_in[NCMInEpAdd & 0xFU].is_used = 1U;
+
+  /* Open EP OUT */
+  (void)USBD_LL_OpenEP(pdev, NCMOutEpAdd, USBD_EP_TYPE_BULK, (uint16_t)hcdc->MaxPcktLen);
+  pdev->ep_out[NCMOutEpAdd & 0xFU].is_used = 1U;
+
+  /* Prepare Out endpoint to receive the first NTB */
+  if (hcdc->RxBuffer != NULL)
+  {
+    (void)USBD_LL_PrepareReceive(pdev, NCMOutEpAdd, hcdc->RxBuffer, CDC_NCM_NTB_OUT_MAX_SIZE);
+  }
+
+  hcdc->LinkStatus = 1U;
+
+  /* Send notification: NETWORK_CONNECTION Event, followed by Connection Speed Change */
+  (void)USBD_CDC_NCM_SendNotification(pdev, NETWORK_CONNECTION,
+                                      CDC_NCM_NET_CONNECTED, NULL);
+  hcdc->NotificationStatus = 1U;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_GetNtbParameters
+  *         Fill the NTB Parameter Structure returned to GET_NTB_PARAMETERS
+  * @param  pbuf: destination buffer, at least CDC_NCM_NTB_PARAMETERS_SIZE bytes
+  * @retval None
+  */
+static void USBD_CDC_NCM_GetNtbParameters(uint8_t *pbuf)
+{
+  USBD_CDC_NCM_PutU16(&pbuf[0], (uint16_t)CDC_NCM_NTB_PARAMETERS_SIZE);    /* wLength */
+  USBD_CDC_NCM_PutU16(&pbuf[2], CDC_NCM_NTB16_FORMAT_SUPPORTED);           /* bmNtbFormatsSupported */
+  USBD_CDC_NCM_PutU32(&pbuf[4], CDC_NCM_NTB_IN_MAX_SIZE);                  /* dwNtbInMaxSize */
+  USBD_CDC_NCM_PutU16(&pbuf[8], (uint16_t)CDC_NCM_NTB_ALIGNMENT);          /* wNdpInDivisor */
+  USBD_CDC_NCM_PutU16(&pbuf[10], 0U);                                      /* wNdpInPayloadRemainder */
+  USBD_CDC_NCM_PutU16(&pbuf[12], (uint16_t)CDC_NCM_NTB_ALIGNMENT);         /* wNdpInAlignment */
+  USBD_CDC_NCM_PutU16(&pbuf[14], 0U);                                      /* wReserved */
+  USBD_CDC_NCM_PutU32(&pbuf[16], CDC_NCM_NTB_OUT_MAX_SIZE);                /* dwNtbOutMaxSize */
+  USBD_CDC_NCM_PutU16(&pbuf[20], (uint16_t)CDC_NCM_NDP_OUT_DIVISOR);       /* wNdpOutDivisor */
+  USBD_CDC_NCM_PutU16(&pbuf[22], (uint16_t)CDC_NCM_NDP_OUT_PAYLOAD_REMAINDER); /* wNdpOutPayloadRemainder */
+  USBD_CDC_NCM_PutU16(&pbuf[24], (uint16_t)CDC_NCM_NTB_ALIGNMENT);         /* wNdpOutAlignment */
+  USBD_CDC_NCM_PutU16(&pbuf[26], 0U);                                      /* wNtbOutMaxDatagrams: no limit */
+}
+
+/**
+  * @brief  USBD_CDC_NCM_TxNtbSend
+  *         Close the pending NTB and start its transfer on the IN endpoint
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void USBD_CDC_NCM_TxNtbSend(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint8_t *pNtb = hcdc->TxBuffer[hcdc->TxPending];
+  uint8_t *pNdp = &pNtb[CDC_NCM_TX_NDP_INDEX];
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  NCMInEpAdd  = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_BULK);
+#endif /* USE_USBD_COMPOSITE */
+
+  /* NTH16 */
+  USBD_CDC_NCM_PutU32(&pNtb[0], CDC_NCM_NTH16_SIGNATURE);
+  USBD_CDC_NCM_PutU16(&pNtb[4], (uint16_t)CDC_NCM_NTH16_SIZE);
+  USBD_CDC_NCM_PutU16(&pNtb[6], hcdc->TxSequence);
+  USBD_CDC_NCM_PutU16(&pNtb[8], (uint16_t)hcdc->TxOffset);
+  USBD_CDC_NCM_PutU16(&pNtb[10], (uint16_t)CDC_NCM_TX_NDP_INDEX);
+
+  /* NDP16, the datagram pointers were filled by USBD_CDC_NCM_AllocTxDatagram */
+  USBD_CDC_NCM_PutU32(&pNdp[0], CDC_NCM_NDP16_SIGNATURE);
+  USBD_CDC_NCM_PutU16(&pNdp[4], (uint16_t)(CDC_NCM_NDP16_HEADER_SIZE +
+                                           ((hcdc->TxCount + 1U) * CDC_NCM_NDP16_ENTRY_SIZE)));
+  USBD_CDC_NCM_PutU16(&pNdp[6], 0U);
+  USBD_CDC_NCM_PutU32(&pNdp[CDC_NCM_NDP16_HEADER_SIZE + (hcdc->TxCount * CDC_NCM_NDP16_ENTRY_SIZE)], 0U);
+
+  /* Tx Transfer in progress, the other NTB collects the next datagrams */
+  hcdc->TxState = 1U;
+  hcdc->TxLength = hcdc->TxOffset;
+  hcdc->TxSequence++;
+  hcdc->TxPending ^= 1U;
+  hcdc->TxCount = 0U;
+  hcdc->TxOffset = CDC_NCM_TX_DATAGRAM_INDEX;
+
+  /* An NTB of exactly dwNtbInMaxSize is not terminated by a ZLP */
+  pdev->ep_in[NCMInEpAdd & 0xFU].total_length = (hcdc->TxLength < hcdc->NtbInMaxSize) ? hcdc->TxLength : 0U;
+
+  (void)USBD_LL_Transmit(pdev, NCMInEpAdd, pNtb, hcdc->TxLength);
+}
+
+/**
+  * @brief  USBD_CDC_NCM_PutU16
+  *         Store a 16-bit value in little endian order
+  * @param  pbuf: destination
+  * @param  val: value
+  * @retval None
+  */
+static void USBD_CDC_NCM_PutU16(uint8_t *pbuf, uint16_t val)
+{
+  pbuf[0] = LOBYTE(val);
+  pbuf[1] = HIBYTE(val);
+}
+
+/**
+  * @brief  USBD_CDC_NCM_PutU32
+  *         Store a 32-bit value in little endian order
+  * @param  pbuf: destination
+  * @param  val: value
+  * @retval None
+  */
+static void USBD_CDC_NCM_PutU32(uint8_t *pbuf, uint32_t val)
+{
+  USBD_CDC_NCM_PutU16(&pbuf[0], (uint16_t)(val & 0xFFFFU));
+  USBD_CDC_NCM_PutU16(&pbuf[2], (uint16_t)(val >> 16));
+}
+
+/**
+  * @brief  USBD_CDC_NCM_GetU32
+  *         Read a 32-bit little endian value
+  * @param  pbuf: source
+  * @retval value
+  */
+static uint32_t USBD_CDC_NCM_GetU32(uint8_t *pbuf)
+{
+  return (uint32_t)SWAPBYTE(&pbuf[0]) | ((uint32_t)SWAPBYTE(&pbuf[2]) << 16);
+}
+
+#ifndef USE_USBD_COMPOSITE
+/**
+  * @brief  USBD_CDC_NCM_GetFSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_CDC_NCM_GetFSCfgDesc(uint16_t *length)
+{
+  USBD_EpDescTypeDef *pEpCmdDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_CMD_EP);
+  USBD_EpDescTypeDef *pEpOutDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_OUT_EP);
+  USBD_EpDescTypeDef *pEpInDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_IN_EP);
+
+  if (pEpCmdDesc != NULL)
+  {
+    pEpCmdDesc->bInterval = CDC_NCM_FS_BINTERVAL;
+  }
+
+  if (pEpOutDesc != NULL)
+  {
+    pEpOutDesc->wMaxPacketSize = CDC_NCM_DATA_FS_MAX_PACKET_SIZE;
+  }
+
+  if (pEpInDesc != NULL)
+  {
+    pEpInDesc->wMaxPacketSize = CDC_NCM_DATA_FS_MAX_PACKET_SIZE;
+  }
+
+  *length = (uint16_t) sizeof(USBD_CDC_NCM_CfgDesc);
+  return USBD_CDC_NCM_CfgDesc;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_GetHSCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_CDC_NCM_GetHSCfgDesc(uint16_t *length)
+{
+  USBD_EpDescTypeDef *pEpCmdDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_CMD_EP);
+  USBD_EpDescTypeDef *pEpOutDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_OUT_EP);
+  USBD_EpDescTypeDef *pEpInDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_IN_EP);
+
+  if (pEpCmdDesc != NULL)
+  {
+    pEpCmdDesc->bInterval = CDC_NCM_HS_BINTERVAL;
+  }
+
+  if (pEpOutDesc != NULL)
+  {
+    pEpOutDesc->wMaxPacketSize = CDC_NCM_DATA_HS_MAX_PACKET_SIZE;
+  }
+
+  if (pEpInDesc != NULL)
+  {
+    pEpInDesc->wMaxPacketSize = CDC_NCM_DATA_HS_MAX_PACKET_SIZE;
+  }
+
+  *length = (uint16_t) sizeof(USBD_CDC_NCM_CfgDesc);
+  return USBD_CDC_NCM_CfgDesc;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_GetOtherSpeedCfgDesc
+  *         Return configuration descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+static uint8_t *USBD_CDC_NCM_GetOtherSpeedCfgDesc(uint16_t *length)
+{
+  USBD_EpDescTypeDef *pEpCmdDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_CMD_EP);
+  USBD_EpDescTypeDef *pEpOutDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_OUT_EP);
+  USBD_EpDescTypeDef *pEpInDesc = USBD_GetEpDesc(USBD_CDC_NCM_CfgDesc, CDC_NCM_IN_EP);
+
+  if (pEpCmdDesc != NULL)
+  {
+    pEpCmdDesc->bInterval = CDC_NCM_FS_BINTERVAL;
+  }
+
+  if (pEpOutDesc != NULL)
+  {
+    pEpOutDesc->wMaxPacketSize = CDC_NCM_DATA_FS_MAX_PACKET_SIZE;
+  }
+
+  if (pEpInDesc != NULL)
+  {
+    pEpInDesc->wMaxPacketSize = CDC_NCM_DATA_FS_MAX_PACKET_SIZE;
+  }
+
+  *length = (uint16_t) sizeof(USBD_CDC_NCM_CfgDesc);
+  return USBD_CDC_NCM_CfgDesc;
+}
+
+/**
+  * @brief  DeviceQualifierDescriptor
+  *         return Device Qualifier descriptor
+  * @param  length : pointer data length
+  * @retval pointer to descriptor buffer
+  */
+uint8_t *USBD_CDC_NCM_GetDeviceQualifierDescriptor(uint16_t *length)
+{
+  *length = (uint16_t)sizeof(USBD_CDC_NCM_DeviceQualifierDesc);
+
+  return USBD_CDC_NCM_DeviceQualifierDesc;
+}
+#endif /* USE_USBD_COMPOSITE */
+/**
+  * @brief  USBD_CDC_NCM_RegisterInterface
+  * @param  pdev: device instance
+  * @param  fops: CD  Interface callback
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_RegisterInterface(USBD_HandleTypeDef *pdev,
+                                       USBD_CDC_NCM_ItfTypeDef *fops)
+{
+  if (fops == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  pdev->pUserData[pdev->classId] = fops;
+
+  return (uint8_t)USBD_OK;
+}
+
+
+/**
+  * @brief  USBD_CDC_NCM_USRStringDescriptor
+  *         Manages the transfer of user string descriptors.
+  * @param  pdev: device instance
+  * @param  index: descriptor index
+  * @param  length : pointer data length
+  * @retval pointer to the descriptor table or NULL if the descriptor is not supported.
+  */
+#if (USBD_SUPPORT_USER_STRING_DESC == 1U)
+static uint8_t *USBD_CDC_NCM_USRStringDescriptor(USBD_HandleTypeDef *pdev, uint8_t index, uint16_t *length)
+{
+  static uint8_t USBD_StrDesc[255];
+
+  /* Check if the requested string interface is supported */
+  if (index == CDC_NCM_MAC_STRING_INDEX)
+  {
+    USBD_GetString((uint8_t *)((USBD_CDC_NCM_ItfTypeDef *)pdev->pUserData[pdev->classId])->pStrDesc, USBD_StrDesc, length);
+    return USBD_StrDesc;
+  }
+  /* Not supported Interface Descriptor index */
+  else
+  {
+    return NULL;
+  }
+}
+#endif /* USBD_SUPPORT_USER_STRING_DESC */
+
+/**
+  * @brief  USBD_CDC_NCM_SetTxBuffer
+  *         Set the two buffers used alternately to build the IN NTBs
+  * @param  pdev: device instance
+  * @param  pbuff0: first NTB buffer, CDC_NCM_NTB_IN_MAX_SIZE bytes
+  * @param  pbuff1: second NTB buffer, CDC_NCM_NTB_IN_MAX_SIZE bytes
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_SetTxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff0, uint8_t *pbuff1)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc->TxBuffer[0] = pbuff0;
+  hcdc->TxBuffer[1] = pbuff1;
+
+  return (uint8_t)USBD_OK;
+}
+
+
+/**
+  * @brief  USBD_CDC_NCM_SetRxBuffer
+  * @param  pdev: device instance
+  * @param  pbuff: Rx Buffer, CDC_NCM_NTB_OUT_MAX_SIZE bytes
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_SetRxBuffer(USBD_HandleTypeDef *pdev, uint8_t *pbuff)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc->RxBuffer = pbuff;
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_AllocTxDatagram
+  *         Reserve room for one datagram in the pending IN NTB
+  *
+  *         @note
+  *         The caller writes the datagram at the returned address then calls
+  *         USBD_CDC_NCM_TransmitDatagram. NULL is returned when the link is down
+  *         or when the pending NTB is full; in the latter case the NTB is sent
+  *         as soon as the IN endpoint is free and the call can be retried.
+  *
+  * @param  pdev: device instance
+  * @param  length: datagram length
+  * @retval pointer to the datagram in the NTB, or NULL
+  */
+uint8_t *USBD_CDC_NCM_AllocTxDatagram(USBD_HandleTypeDef *pdev, uint16_t length)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint8_t *pDatagram = NULL;
+  uint8_t *pEntry;
+  uint32_t Offset;
+
+  if ((hcdc == NULL) || (hcdc->LinkStatus == 0U) || (length == 0U))
+  {
+    return NULL;
+  }
+
+  /* Keep the pending NTB out of DataIn until the datagram is written */
+  hcdc->TxFilling = 1U;
+
+  Offset = CDC_NCM_ALIGN(hcdc->TxOffset);
+
+  if ((hcdc->TxCount < CDC_NCM_NTB_IN_MAX_DATAGRAMS) &&
+      ((Offset + length) <= hcdc->NtbInMaxSize))
+  {
+    pEntry = &hcdc->TxBuffer[hcdc->TxPending][CDC_NCM_TX_NDP_INDEX + CDC_NCM_NDP16_HEADER_SIZE +
+                                              (hcdc->TxCount * CDC_NCM_NDP16_ENTRY_SIZE)];
+
+    USBD_CDC_NCM_PutU16(&pEntry[0], (uint16_t)Offset);
+    USBD_CDC_NCM_PutU16(&pEntry[2], length);
+
+    hcdc->TxOffset = Offset + length;
+    hcdc->TxCount++;
+
+    pDatagram = &hcdc->TxBuffer[hcdc->TxPending][Offset];
+  }
+  else
+  {
+    /* Pending NTB is full: hand it over to the IN endpoint */
+    (void)USBD_CDC_NCM_TransmitDatagram(pdev);
+  }
+
+  return pDatagram;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_TransmitDatagram
+  *         Queue the datagram written after USBD_CDC_NCM_AllocTxDatagram.
+  *         The pending NTB is sent at once if the IN endpoint is idle, otherwise
+  *         it keeps aggregating datagrams until the current transfer completes.
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_TransmitDatagram(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  hcdc->TxFilling = 0U;
+
+  if ((hcdc->TxState == 0U) && (hcdc->TxCount != 0U) && (hcdc->LinkStatus != 0U))
+  {
+    USBD_CDC_NCM_TxNtbSend(pdev);
+  }
+
+  return (uint8_t)USBD_OK;
+}
+
+
+/**
+  * @brief  USBD_CDC_NCM_ReceivePacket
+  *         prepare OUT Endpoint for reception of the next NTB
+  * @param  pdev: device instance
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_ReceivePacket(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  NCMOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK);
+#endif /* USE_USBD_COMPOSITE */
+
+  if ((hcdc == NULL) || (hcdc->RxBuffer == NULL) || (hcdc->AltSetting == 0U))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  /* Prepare Out endpoint to receive next NTB */
+  (void)USBD_LL_PrepareReceive(pdev, NCMOutEpAdd, hcdc->RxBuffer, CDC_NCM_NTB_OUT_MAX_SIZE);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_ParseNtb
+  *         Check the NTH16 of a received NTB and prepare the walk of its datagrams
+  * @param  pParser: parser state
+  * @param  pNtb: received NTB
+  * @param  length: number of bytes received
+  * @retval USBD_OK if the NTB header is valid, else USBD_FAIL
+  */
+uint8_t USBD_CDC_NCM_ParseNtb(USBD_CDC_NCM_NtbParserTypeDef *pParser,
+                              uint8_t *pNtb, uint32_t length)
+{
+  pParser->pNtb = pNtb;
+  pParser->NdpIndex = 0U;
+  pParser->EntryIndex = 0U;
+  pParser->NdpCount = 0U;
+
+  if ((length < CDC_NCM_NTH16_SIZE) ||
+      (USBD_CDC_NCM_GetU32(&pNtb[0]) != CDC_NCM_NTH16_SIGNATURE) ||
+      (SWAPBYTE(&pNtb[4]) != CDC_NCM_NTH16_SIZE))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  /* A null wBlockLength means the NTB ends with the transfer */
+  pParser->BlockLength = SWAPBYTE(&pNtb[8]);
+  if (pParser->BlockLength == 0U)
+  {
+    pParser->BlockLength = length;
+  }
+
+  if (pParser->BlockLength > length)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  pParser->NdpIndex = SWAPBYTE(&pNtb[10]);
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_GetDatagram
+  *         Return the next datagram of the NTB given to USBD_CDC_NCM_ParseNtb.
+  *         The datagram is left in place in the NTB buffer.
+  * @param  pParser: parser state
+  * @param  pDatagram: pointer to the datagram
+  * @param  pLength: datagram length
+  * @retval USBD_OK if a datagram is returned, USBD_FAIL at the end of the NTB
+  *         or if the NTB is malformed
+  */
+uint8_t USBD_CDC_NCM_GetDatagram(USBD_CDC_NCM_NtbParserTypeDef *pParser,
+                                 uint8_t **pDatagram, uint16_t *pLength)
+{
+  uint8_t *pNdp;
+  uint32_t NdpLength;
+  uint32_t Entry;
+  uint32_t Index;
+  uint32_t Length;
+
+  while (pParser->NdpIndex != 0U)
+  {
+    if (((pParser->NdpIndex % CDC_NCM_NTB_ALIGNMENT) != 0U) ||
+        ((pParser->NdpIndex + CDC_NCM_NDP16_MIN_SIZE) > pParser->BlockLength) ||
+        (pParser->NdpCount >= CDC_NCM_NTB_OUT_MAX_NDP))
+    {
+      return (uint8_t)USBD_FAIL;
+    }
+
+    pNdp = &pParser->pNtb[pParser->NdpIndex];
+    NdpLength = SWAPBYTE(&pNdp[4]);
+
+    if ((USBD_CDC_NCM_GetU32(&pNdp[0]) != CDC_NCM_NDP16_SIGNATURE) ||
+        (NdpLength < CDC_NCM_NDP16_MIN_SIZE) ||
+        ((pParser->NdpIndex + NdpLength) > pParser->BlockLength))
+    {
+      return (uint8_t)USBD_FAIL;
+    }
+
+    Entry = CDC_NCM_NDP16_HEADER_SIZE + (pParser->EntryIndex * CDC_NCM_NDP16_ENTRY_SIZE);
+
+    if ((Entry + CDC_NCM_NDP16_ENTRY_SIZE) <= NdpLength)
+    {
+      Index = SWAPBYTE(&pNdp[Entry]);
+      Length = SWAPBYTE(&pNdp[Entry + 2U]);
+
+      if ((Index != 0U) && (Length != 0U))
+      {
+        if ((Index < CDC_NCM_NTH16_SIZE) || ((Index + Length) > pParser->BlockLength))
+        {
+          return (uint8_t)USBD_FAIL;
+        }
+
+        pParser->EntryIndex++;
+        *pDatagram = &pParser->pNtb[Index];
+        *pLength = (uint16_t)Length;
+
+        return (uint8_t)USBD_OK;
+      }
+    }
+
+    /* End of this NDP, continue with the next one */
+    pParser->NdpIndex = SWAPBYTE(&pNdp[6]);
+    pParser->EntryIndex = 0U;
+    pParser->NdpCount++;
+  }
+
+  return (uint8_t)USBD_FAIL;
+}
+
+/**
+  * @brief  USBD_CDC_NCM_SendNotification
+  *         Transmit Notification packet on CMD IN interrupt endpoint
+  * @param  pdev: device instance
+  *         Notif: value of the notification type (from CDC_NCM_Notification_TypeDef enumeration list)
+  *         bVal: value of the notification switch (ie. 0x00 or 0x01 for Network Connection notification)
+  *         pData: pointer to data buffer (ie. upstream and downstream connection speed values)
+  * @retval status
+  */
+uint8_t USBD_CDC_NCM_SendNotification(USBD_HandleTypeDef *pdev,
+                                      USBD_CDC_NotifCodeTypeDef Notif,
+                                      uint16_t bVal, uint8_t *pData)
+{
+  uint32_t Idx;
+  uint32_t ReqSize = 0U;
+  USBD_CDC_NCM_HandleTypeDef *hcdc = (USBD_CDC_NCM_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_StatusTypeDef ret = USBD_OK;
+
+  if (hcdc == NULL)
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  NCMCmdEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_IN, USBD_EP_TYPE_INTR);
+#endif /* USE_USBD_COMPOSITE */
+
+  /* Initialize the request fields */
+  (hcdc->Req).bmRequest = CDC_NCM_BMREQUEST_TYPE_NCM;
+  (hcdc->Req).bRequest = (uint8_t)Notif;
+
+  switch ((hcdc->Req).bRequest)
+  {
+    case NETWORK_CONNECTION:
+      (hcdc->Req).wValue = bVal;
+      (hcdc->Req).wIndex = CDC_NCM_CMD_ITF(pdev);
+      (hcdc->Req).wLength = 0U;
+
+      for (Idx = 0U; Idx < 8U; Idx++)
+      {
+        (hcdc->Req).data[Idx] = 0U;
+      }
+      ReqSize = 8U;
+      break;
+
+    case RESPONSE_AVAILABLE:
+      (hcdc->Req).wValue = 0U;
+      (hcdc->Req).wIndex = CDC_NCM_CMD_ITF(pdev);
+      (hcdc->Req).wLength = 0U;
+      for (Idx = 0U; Idx < 8U; Idx++)
+      {
+        (hcdc->Req).data[Idx] = 0U;
+      }
+      ReqSize = 8U;
+      break;
+
+    case CONNECTION_SPEED_CHANGE:
+      (hcdc->Req).wValue = 0U;
+      (hcdc->Req).wIndex = CDC_NCM_CMD_ITF(pdev);
+      (hcdc->Req).wLength = 0x0008U;
+      ReqSize = 16U;
+
+      /* Check pointer to data buffer */
+      if (pData != NULL)
+      {
+        for (Idx = 0U; Idx < 8U; Idx++)
+        {
+          (hcdc->Req).data[Idx] = pData[Idx];
+        }
+      }
+      break;
+
+    default:
+      ret = USBD_FAIL;
+      break;
+  }
+
+  /* Transmit notification packet */
+  if (ReqSize != 0U)
+  {
+    (void)USBD_LL_Transmit(pdev, NCMCmdEpAdd, (uint8_t *)&hcdc->Req, ReqSize);
+  }
+
+  return (uint8_t)ret;
+}
+
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
+
+/**
+  * @}
+  */
@@ -0,0 +1,493 @@
+/**
+  ******************************************************************************
+  * @file    Src/usbd_cdc_ncm_if_template.c
+  * @brief   Source file for USBD CDC_NCM interface, lwIP network interface
+  *          glue for a NO_SYS lwIP stack running from the main loop.
+  ******************************************************************************
+  * @attention
+  *
+  * Extension class of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "usbd_cdc_ncm_if_template.h"
+#include "lwip/pbuf.h"
+#include "lwip/stats.h"
+#include "lwip/etharp.h"
+#include "netif/ethernet.h"
+#ifdef USE_USBD_COMPOSITE
+#include "usbd_composite_builder.h"
+#endif /* USE_USBD_COMPOSITE */
+
+#if !LWIP_SUPPORT_CUSTOM_PBUF
+#error "LWIP_SUPPORT_CUSTOM_PBUF is needed to pass received datagrams to lwIP in place"
+#endif /* LWIP_SUPPORT_CUSTOM_PBUF */
+
+/* Private typedef -----------------------------------------------------------*/
+/* pbuf referring to a datagram inside an OUT NTB buffer */
+typedef struct
+{
+  struct pbuf_custom pc;
+  uint8_t ntb;
+} CDC_NCM_RxPbufTypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define CDC_NCM_RX_NTB_FREE                  0U
+#define CDC_NCM_RX_NTB_ARMED                 1U
+#define CDC_NCM_RX_NTB_READY                 2U
+#define CDC_NCM_RX_NTB_IN_USE                3U
+
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Received NTBs over USB are stored in these buffers */
+#if defined ( __ICCARM__ ) /*!< IAR Compiler */
+#pragma data_alignment=4
+#endif /* ( __ICCARM__ ) */
+__ALIGN_BEGIN static uint8_t UserRxBuffer[CDC_NCM_RX_NTB_NBR][CDC_NCM_NTB_OUT_MAX_SIZE] __ALIGN_END;
+
+/* NTBs transmitted over CDC_NCM are built alternately in these buffers */
+#if defined ( __ICCARM__ ) /*!< IAR Compiler */
+#pragma data_alignment=4
+#endif /* ( __ICCARM__ ) */
+__ALIGN_BEGIN static uint8_t UserTxBuffer[2][CDC_NCM_NTB_IN_MAX_SIZE] __ALIGN_END;
+
+/* OUT NTB buffers bookkeeping, the ready queue is filled from the USB interrupt */
+static __IO uint8_t RxNtbState[CDC_NCM_RX_NTB_NBR];
+static uint32_t RxNtbLength[CDC_NCM_RX_NTB_NBR];
+static uint16_t RxNtbRef[CDC_NCM_RX_NTB_NBR];
+static uint8_t RxReadyQueue[CDC_NCM_RX_NTB_NBR + 1U];
+static __IO uint32_t RxReadyHead;
+static uint32_t RxReadyTail;
+static __IO uint8_t RxArmed;
+static __IO uint8_t RxStalled;
+
+/* Free list of the received datagram pbufs */
+static CDC_NCM_RxPbufTypeDef RxPbuf[CDC_NCM_RX_PBUF_NBR];
+static uint8_t RxPbufStack[CDC_NCM_RX_PBUF_NBR];
+static uint32_t RxPbufTop;
+
+static struct netif *CDC_NCM_netif;
+
+static uint8_t CDC_NCMInitialized = 0U;
+
+/* USB handler declaration */
+extern USBD_HandleTypeDef  USBD_Device;
+
+/* Private function prototypes -----------------------------------------------*/
+static int8_t CDC_NCM_Itf_Init(void);
+static int8_t CDC_NCM_Itf_DeInit(void);
+static int8_t CDC_NCM_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length);
+static int8_t CDC_NCM_Itf_Receive(uint8_t *pbuf, uint32_t *Len);
+static int8_t CDC_NCM_Itf_TransmitCplt(uint8_t *pbuf, uint32_t *Len, uint8_t epnum);
+static int8_t CDC_NCM_Itf_Process(USBD_HandleTypeDef *pdev);
+static void CDC_NCM_Itf_RxArm(void);
+static void CDC_NCM_Itf_RxRelease(uint8_t ntb);
+static void CDC_NCM_Itf_RxPbufFree(struct pbuf *p);
+static err_t CDC_NCM_Itf_LinkOutput(struct netif *netif, struct pbuf *p);
+
+USBD_CDC_NCM_ItfTypeDef USBD_CDC_NCM_fops =
+{
+  CDC_NCM_Itf_Init,
+  CDC_NCM_Itf_DeInit,
+  CDC_NCM_Itf_Control,
+  CDC_NCM_Itf_Receive,
+  CDC_NCM_Itf_TransmitCplt,
+  CDC_NCM_Itf_Process,
+  (uint8_t *)CDC_NCM_MAC_STR_DESC,
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  CDC_NCM_Itf_Init
+  *         Initializes the CDC_NCM media low layer
+  * @param  None
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_Init(void)
+{
+  uint32_t idx;
+
+  if (CDC_NCMInitialized == 0U)
+  {
+    for (idx = 0U; idx < CDC_NCM_RX_NTB_NBR; idx++)
+    {
+      RxNtbState[idx] = CDC_NCM_RX_NTB_FREE;
+    }
+
+    for (idx = 0U; idx < CDC_NCM_RX_PBUF_NBR; idx++)
+    {
+      RxPbufStack[idx] = (uint8_t)idx;
+    }
+    RxPbufTop = CDC_NCM_RX_PBUF_NBR;
+
+    RxReadyHead = 0U;
+    RxReadyTail = 0U;
+    RxArmed = 0U;
+    RxStalled = 0U;
+    RxNtbState[0] = CDC_NCM_RX_NTB_ARMED;
+
+    CDC_NCMInitialized = 1U;
+  }
+
+  /* Set Application Buffers, the OUT NTBs still held by lwIP are kept across a reset */
+  (void)USBD_CDC_NCM_SetTxBuffer(&USBD_Device, UserTxBuffer[0], UserTxBuffer[1]);
+
+  if (RxStalled == 0U)
+  {
+    (void)USBD_CDC_NCM_SetRxBuffer(&USBD_Device, UserRxBuffer[RxArmed]);
+  }
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_DeInit
+  *         DeInitializes the CDC_NCM media low layer
+  * @param  None
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_DeInit(void)
+{
+#ifdef USE_USBD_COMPOSITE
+  USBD_CDC_NCM_HandleTypeDef *hcdc_cdc_ncm = (USBD_CDC_NCM_HandleTypeDef *)(USBD_Device.pClassDataCmsit[USBD_Device.classId]);
+#else
+  USBD_CDC_NCM_HandleTypeDef *hcdc_cdc_ncm = (USBD_CDC_NCM_HandleTypeDef *)(USBD_Device.pClassData);
+#endif /* USE_USBD_COMPOSITE */
+
+  /* Notify application layer that link is down */
+  hcdc_cdc_ncm->LinkStatus = 0U;
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_Control
+  *         Manage the CDC_NCM class requests, the NTB requests are handled by the class
+  * @param  Cmd: Command code
+  * @param  Buf: Buffer containing command data (request parameters)
+  * @param  Len: Number of data to be sent (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  switch (cmd)
+  {
+    case CDC_NCM_SEND_ENCAPSULATED_COMMAND:
+      /* Add your code here */
+      break;
+
+    case CDC_NCM_GET_ENCAPSULATED_RESPONSE:
+      /* Add your code here */
+      break;
+
+    case CDC_NCM_SET_ETH_PACKET_FILTER:
+      /* Add your code here */
+      break;
+
+    default:
+      break;
+  }
+  UNUSED(length);
+  UNUSED(pbuf);
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_Receive
+  *         An NTB was received over USB OUT endpoint, it is queued for
+  *         CDC_NCM_Itf_Process and the endpoint is given the next free buffer.
+  *         Called from the USB interrupt.
+  * @param  Buf: Buffer of data received
+  * @param  Len: Number of data received (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_Receive(uint8_t *Buf, uint32_t *Len)
+{
+  uint8_t ntb = RxArmed;
+
+  UNUSED(Buf);
+
+  RxNtbLength[ntb] = *Len;
+  RxNtbState[ntb] = CDC_NCM_RX_NTB_READY;
+  RxReadyQueue[RxReadyHead] = ntb;
+  RxReadyHead = (RxReadyHead + 1U) % (CDC_NCM_RX_NTB_NBR + 1U);
+
+  CDC_NCM_Itf_RxArm();
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_TransmitCplt
+  *         Data transmitted callback
+  *
+  *         @note
+  *         This function is IN transfer complete callback used to inform user that
+  *         the submitted NTB is successfully sent over USB.
+  *
+  * @param  Buf: Buffer of data to be received
+  * @param  Len: Number of data received (in bytes)
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_TransmitCplt(uint8_t *Buf, uint32_t *Len, uint8_t epnum)
+{
+  UNUSED(Buf);
+  UNUSED(Len);
+  UNUSED(epnum);
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_Process
+  *         Pass the datagrams of the received NTBs to lwIP and follow the link
+  *         state. To be called from the main loop, like the lwIP timers.
+  * @param  pdef: pointer to the USB Device Handle
+  * @retval Result of the operation: USBD_OK if all operations are OK else USBD_FAIL
+  */
+static int8_t CDC_NCM_Itf_Process(USBD_HandleTypeDef *pdev)
+{
+  USBD_CDC_NCM_NtbParserTypeDef parser;
+  CDC_NCM_RxPbufTypeDef *pRxPbuf;
+  struct pbuf *p;
+  uint8_t *pDatagram;
+  uint16_t length;
+  uint8_t ntb;
+  USBD_CDC_NCM_HandleTypeDef *hcdc_cdc_ncm;
+
+  /* Get the CDC_NCM handler pointer, the class APIs called from here and from
+     CDC_NCM_Itf_LinkOutput work on the class selected in pdev->classId */
+#ifdef USE_USBD_COMPOSITE
+  (void)USBD_CMPSIT_SetClassID(pdev, CLASS_TYPE_NCM, 0U);
+  hcdc_cdc_ncm = (USBD_CDC_NCM_HandleTypeDef *)(pdev->pClassDataCmsit[pdev->classId]);
+#else
+  hcdc_cdc_ncm = (USBD_CDC_NCM_HandleTypeDef *)(pdev->pClassData);
+#endif /* USE_USBD_COMPOSITE */
+
+  if (CDC_NCM_netif == NULL)
+  {
+    return (-1);
+  }
+
+  /* The class data is released by a reset or SET_CONFIGURATION 0 */
+  if (hcdc_cdc_ncm == NULL)
+  {
+    if (netif_is_link_up(CDC_NCM_netif))
+    {
+      netif_set_link_down(CDC_NCM_netif);
+    }
+
+    return (-1);
+  }
+
+  if ((hcdc_cdc_ncm->LinkStatus != 0U) && !netif_is_link_up(CDC_NCM_netif))
+  {
+    netif_set_link_up(CDC_NCM_netif);
+  }
+  else if ((hcdc_cdc_ncm->LinkStatus == 0U) && netif_is_link_up(CDC_NCM_netif))
+  {
+    netif_set_link_down(CDC_NCM_netif);
+  }
+  else
+  {
+    /* no link change */
+  }
+
+  while (RxReadyTail != RxReadyHead)
+  {
+    ntb = RxReadyQueue[RxReadyTail];
+    RxReadyTail = (RxReadyTail + 1U) % (CDC_NCM_RX_NTB_NBR + 1U);
+
+    /* Hold the NTB while its datagrams are handed out */
+    RxNtbRef[ntb] = 1U;
+    RxNtbState[ntb] = CDC_NCM_RX_NTB_IN_USE;
+
+    if (USBD_CDC_NCM_ParseNtb(&parser, UserRxBuffer[ntb], RxNtbLength[ntb]) != (uint8_t)USBD_OK)
+    {
+      LINK_STATS_INC(link.proterr);
+    }
+
+    while (USBD_CDC_NCM_GetDatagram(&parser, &pDatagram, &length) == (uint8_t)USBD_OK)
+    {
+      if (RxPbufTop == 0U)
+      {
+        LINK_STATS_INC(link.memerr);
+        LINK_STATS_INC(link.drop);
+        continue;
+      }
+
+      /* The datagram stays in the NTB buffer, the pbuf only points to it */
+      pRxPbuf = &RxPbuf[RxPbufStack[--RxPbufTop]];
+      pRxPbuf->pc.custom_free_function = CDC_NCM_Itf_RxPbufFree;
+      pRxPbuf->ntb = ntb;
+      RxNtbRef[ntb]++;
+
+      p = pbuf_alloced_custom(PBUF_RAW, (u16_t)(length + ETH_PAD_SIZE), PBUF_REF, &pRxPbuf->pc,
+                              pDatagram - ETH_PAD_SIZE, (u16_t)(length + ETH_PAD_SIZE));
+
+      LINK_STATS_INC(link.recv);
+
+      if (CDC_NCM_netif->input(p, CDC_NCM_netif) != ERR_OK)
+      {
+        (void)pbuf_free(p);
+      }
+    }
+
+    CDC_NCM_Itf_RxRelease(ntb);
+  }
+
+  return (0);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_RxArm
+  *         Give a free NTB buffer to the OUT endpoint, or leave it NAKed
+  * @param  None
+  * @retval None
+  */
+static void CDC_NCM_Itf_RxArm(void)
+{
+  uint8_t idx;
+
+  for (idx = 0U; idx < CDC_NCM_RX_NTB_NBR; idx++)
+  {
+    if (RxNtbState[idx] == CDC_NCM_RX_NTB_FREE)
+    {
+      RxNtbState[idx] = CDC_NCM_RX_NTB_ARMED;
+      RxArmed = idx;
+      RxStalled = 0U;
+
+      (void)USBD_CDC_NCM_SetRxBuffer(&USBD_Device, UserRxBuffer[idx]);
+      (void)USBD_CDC_NCM_ReceivePacket(&USBD_Device);
+      return;
+    }
+  }
+
+  RxStalled = 1U;
+}
+
+/**
+  * @brief  CDC_NCM_Itf_RxRelease
+  *         Drop one reference to an OUT NTB buffer
+  * @param  ntb: NTB buffer index
+  * @retval None
+  */
+static void CDC_NCM_Itf_RxRelease(uint8_t ntb)
+{
+  RxNtbRef[ntb]--;
+
+  if (RxNtbRef[ntb] == 0U)
+  {
+    RxNtbState[ntb] = CDC_NCM_RX_NTB_FREE;
+
+    /* The OUT endpoint is NAKed only while no buffer is free: nothing can
+       be received here, so it can be restarted from the main loop */
+    if (RxStalled != 0U)
+    {
+      CDC_NCM_Itf_RxArm();
+    }
+  }
+}
+
+/**
+  * @brief  CDC_NCM_Itf_RxPbufFree
+  *         Called by lwIP when a received datagram is no longer used
+  * @param  p: pbuf to free
+  * @retval None
+  */
+static void CDC_NCM_Itf_RxPbufFree(struct pbuf *p)
+{
+  CDC_NCM_RxPbufTypeDef *pRxPbuf = (CDC_NCM_RxPbufTypeDef *)(void *)p;
+
+  RxPbufStack[RxPbufTop++] = (uint8_t)(pRxPbuf - RxPbuf);
+
+  CDC_NCM_Itf_RxRelease(pRxPbuf->ntb);
+}
+
+/**
+  * @brief  CDC_NCM_Itf_LinkOutput
+  *         Copy a pbuf chain straight into the IN NTB being aggregated
+  * @param  netif: lwIP network interface
+  * @param  p: frame to send
+  * @retval lwIP error code
+  */
+static err_t CDC_NCM_Itf_LinkOutput(struct netif *netif, struct pbuf *p)
+{
+  uint8_t *pDatagram;
+  uint16_t length = (uint16_t)(p->tot_len - ETH_PAD_SIZE);
+  uint32_t trials = 0U;
+
+  UNUSED(netif);
+
+  if (length > CDC_NCM_ETH_MAX_SEGSZE)
+  {
+    LINK_STATS_INC(link.lenerr);
+    return ERR_BUF;
+  }
+
+#ifdef USE_USBD_COMPOSITE
+  (void)USBD_CMPSIT_SetClassID(&USBD_Device, CLASS_TYPE_NCM, 0U);
+#endif /* USE_USBD_COMPOSITE */
+
+  /* Room is made as soon as the NTB on the bus is acknowledged */
+  pDatagram = USBD_CDC_NCM_AllocTxDatagram(&USBD_Device, length);
+
+  while (pDatagram == NULL)
+  {
+    if (!netif_is_link_up(CDC_NCM_netif) || (++trials >= CDC_NCM_MAX_TX_WAIT_TRIALS))
+    {
+      LINK_STATS_INC(link.drop);
+      return ERR_IF;
+    }
+
+    pDatagram = USBD_CDC_NCM_AllocTxDatagram(&USBD_Device, length);
+  }
+
+  (void)pbuf_copy_partial(p, pDatagram, length, ETH_PAD_SIZE);
+  (void)USBD_CDC_NCM_TransmitDatagram(&USBD_Device);
+
+  LINK_STATS_INC(link.xmit);
+
+  return ERR_OK;
+}
+
+/**
+  * @brief  CDC_NCM_Itf_NetifInit
+  *         lwIP network interface initialization, to be passed to netif_add()
+  * @param  netif: lwIP network interface
+  * @retval lwIP error code
+  */
+err_t CDC_NCM_Itf_NetifInit(struct netif *netif)
+{
+  netif->name[0] = 'u';
+  netif->name[1] = 's';
+
+  netif->hwaddr_len = ETH_HWADDR_LEN;
+  netif->hwaddr[0] = CDC_NCM_MAC_ADDR0;
+  netif->hwaddr[1] = CDC_NCM_MAC_ADDR1;
+  netif->hwaddr[2] = CDC_NCM_MAC_ADDR2;
+  netif->hwaddr[3] = CDC_NCM_MAC_ADDR3;
+  netif->hwaddr[4] = CDC_NCM_MAC_ADDR4;
+  netif->hwaddr[5] = CDC_NCM_MAC_ADDR5;
+
+  netif->mtu = (u16_t)(CDC_NCM_ETH_MAX_SEGSZE - 14U);
+  netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_ETHERNET;
+
+#if LWIP_IPV4
+  netif->output = etharp_output;
+#endif /* LWIP_IPV4 */
+  netif->linkoutput = CDC_NCM_Itf_LinkOutput;
+
+  CDC_NCM_netif = netif;
+
+  return ERR_OK;
+}
@@ -55,6 +55,14 @@ extern "C" {
 #endif /* __USBD_CDC_ECM_IF_H */
 #endif /* USBD_CMPSIT_ACTIVATE_CDC_ECM */
 
+#if USBD_CMPSIT_ACTIVATE_CDC_NCM == 1U
+#include "usbd_cdc_ncm.h"
+
+#ifndef __USBD_CDC_NCM_IF_H
+#include "usbd_cdc_ncm_if_template.h"
+#endif /* __USBD_CDC_NCM_IF_H */
+#endif /* USBD_CMPSIT_ACTIVATE_CDC_NCM */
+
 #if USBD_CMPSIT_ACTIVATE_AUDIO == 1
 #include "usbd_audio.h"
 #endif /* USBD_CMPSIT_ACTIVATE_AUDIO */
@@ -102,6 +110,10 @@ extern "C" {
 #define USBD_CMPSIT_ACTIVATE_CDC_ECM                       0U
 #endif /* USBD_CMPSIT_ACTIVATE_CDC_ECM */
 
+#ifndef USBD_CMPSIT_ACTIVATE_CDC_NCM
+#define USBD_CMPSIT_ACTIVATE_CDC_NCM                       0U
+#endif /* USBD_CMPSIT_ACTIVATE_CDC_NCM */
+
 #ifndef USBD_CMPSIT_ACTIVATE_RNDIS
 #define USBD_CMPSIT_ACTIVATE_RNDIS                         0U
 #endif /* USBD_CMPSIT_ACTIVATE_RNDIS */
@@ -169,7 +181,8 @@ typedef struct
   uint8_t           iInterface;
 } USBD_IfDescTypeDef;
 
-#if (USBD_CMPSIT_ACTIVATE_CDC == 1) || (USBD_CMPSIT_ACTIVATE_RNDIS == 1) || (USBD_CMPSIT_ACTIVATE_CDC_ECM == 1)
+#if (USBD_CMPSIT_ACTIVATE_CDC == 1) || (USBD_CMPSIT_ACTIVATE_RNDIS == 1) || (USBD_CMPSIT_ACTIVATE_CDC_ECM == 1) || \
+    (USBD_CMPSIT_ACTIVATE_CDC_NCM == 1)
 typedef struct
 {
 /*
@@ -216,7 +229,8 @@ typedef struct
   uint8_t           bSlaveInterface;
 } USBD_CDCUnionFuncDescTypeDef;
 
-#endif /* (USBD_CMPSIT_ACTIVATE_CDC == 1) || (USBD_CMPSIT_ACTIVATE_RNDIS == 1)  || (USBD_CMPSIT_ACTIVATE_CDC_ECM == 1)*/
+#endif /* (USBD_CMPSIT_ACTIVATE_CDC == 1) || (USBD_CMPSIT_ACTIVATE_RNDIS == 1)  || (USBD_CMPSIT_ACTIVATE_CDC_ECM == 1) ||
+          (USBD_CMPSIT_ACTIVATE_CDC_NCM == 1) */
 
 extern USBD_ClassTypeDef  USBD_CMPSIT;
 
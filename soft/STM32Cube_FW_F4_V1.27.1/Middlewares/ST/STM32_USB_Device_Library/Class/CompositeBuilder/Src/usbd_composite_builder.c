@@ -125,6 +125,10 @@ static void  USBD_CMPSIT_RNDISDesc(USBD_HandleTypeDef *pdev, uint32_t pConf, __I
 static void  USBD_CMPSIT_CDC_ECMDesc(USBD_HandleTypeDef *pdev, uint32_t pConf, __IO uint32_t *Sze, uint8_t speed);
 #endif /* USBD_CMPSIT_ACTIVATE_CDC_ECM == 1U */
 
+#if USBD_CMPSIT_ACTIVATE_CDC_NCM == 1U
+static void  USBD_CMPSIT_CDC_NCMDesc(USBD_HandleTypeDef *pdev, uint32_t pConf, __IO uint32_t *Sze, uint8_t speed);
+#endif /* USBD_CMPSIT_ACTIVATE_CDC_NCM == 1U */
+
 #if USBD_CMPSIT_ACTIVATE_AUDIO == 1U
 static void  USBD_CMPSIT_AUDIODesc(USBD_HandleTypeDef *pdev, uint32_t pConf, __IO uint32_t *Sze, uint8_t speed);
 #endif /* USBD_CMPSIT_ACTIVATE_AUDIO == 1U */
@@ -470,6 +474,42 @@ uint8_t  USBD_CMPSIT_AddToConfDesc(USBD_HandleTypeDef *pdev)
       break;
 #endif /* USBD_CMPSIT_ACTIVATE_CDC_ECM */
 
+#if USBD_CMPSIT_ACTIVATE_CDC_NCM == 1
+    case CLASS_TYPE_NCM:
+      /* Setup default Max packet size */
+      pdev->tclasslist[pdev->classId].CurrPcktSze = CDC_NCM_DATA_FS_MAX_PACKET_SIZE;
+
+      /* Find the first available interface slot and Assign number of interfaces */
+      idxIf = USBD_CMPSIT_FindFreeIFNbr(pdev);
+      pdev->tclasslist[pdev->classId].NumIf = 2U;
+      pdev->tclasslist[pdev->classId].Ifs[0] = idxIf;
+      pdev->tclasslist[pdev->classId].Ifs[1] = (uint8_t)(idxIf + 1U);
+
+      /* Assign endpoint numbers */
+      pdev->tclasslist[pdev->classId].NumEps = 3U; /* EP1_IN, EP1_OUT,CMD_EP2 */
+
+      /* Set IN endpoint slot */
+      iEp = pdev->tclasslist[pdev->classId].EpAdd[0];
+      USBD_CMPSIT_AssignEp(pdev, iEp, USBD_EP_TYPE_BULK, pdev->tclasslist[pdev->classId].CurrPcktSze);
+
+      /* Set OUT endpoint slot */
+      iEp = pdev->tclasslist[pdev->classId].EpAdd[1];
+      USBD_CMPSIT_AssignEp(pdev, iEp, USBD_EP_TYPE_BULK, pdev->tclasslist[pdev->classId].CurrPcktSze);
+
+      /* Set the second IN endpoint slot */
+      iEp = pdev->tclasslist[pdev->classId].EpAdd[2];
+      USBD_CMPSIT_AssignEp(pdev, iEp, USBD_EP_TYPE_INTR, CDC_NCM_CMD_PACKET_SIZE);
+
+      /* Configure and Append the Descriptor */
+      USBD_CMPSIT_CDC_NCMDesc(pdev, (uint32_t)pCmpstFSConfDesc, &CurrFSConfDescSz, (uint8_t)USBD_SPEED_FULL);
+
+#ifdef USE_USB_HS
+      USBD_CMPSIT_CDC_NCMDesc(pdev, (uint32_t)pCmpstHSConfDesc, &CurrHSConfDescSz, (uint8_t)USBD_SPEED_HIGH);
+#endif /* USE_USB_HS */
+
+      break;
+#endif /* USBD_CMPSIT_ACTIVATE_CDC_NCM */
+
 #if USBD_CMPSIT_ACTIVATE_AUDIO == 1
     case CLASS_TYPE_AUDIO:
       /* Setup Max packet sizes*/
@@ -1117,6 +1157,111 @@ static void  USBD_CMPSIT_CDC_ECMDesc(USBD_HandleTypeDef *pdev, uint32_t pConf, _
 }
 #endif /* USBD_CMPSIT_ACTIVATE_CDC_ECM */
 
+#if USBD_CMPSIT_ACTIVATE_CDC_NCM == 1
+/**
+  * @brief  USBD_CMPSIT_CDC_NCMDesc
+  *         Configure and Append the CDC_NCM Descriptor
+  * @param  pdev: device instance
+  * @param  pConf: Configuration descriptor pointer
+  * @param  Sze: pointer to the current configuration descriptor size
+  * @retval None
+  */
+static void  USBD_CMPSIT_CDC_NCMDesc(USBD_HandleTypeDef *pdev, uint32_t pConf, __IO uint32_t *Sze, uint8_t speed)
+{
+  static USBD_IfDescTypeDef             *pIfDesc;
+  static USBD_EpDescTypeDef             *pEpDesc;
+  static USBD_NCMEthFuncDescTypeDef     *pEthDesc;
+  static USBD_NCMFuncDescTypeDef        *pFuncDesc;
+  static USBD_IadDescTypeDef            *pIadDesc;
+
+  static USBD_CDCHeaderFuncDescTypeDef  *pHeadDesc;
+  static USBD_CDCUnionFuncDescTypeDef   *pUnionDesc;
+
+#if USBD_COMPOSITE_USE_IAD == 1
+  pIadDesc                          = ((USBD_IadDescTypeDef *)(pConf + *Sze));
+  pIadDesc->bLength                 = (uint8_t)sizeof(USBD_IadDescTypeDef);
+  pIadDesc->bDescriptorType         = USB_DESC_TYPE_IAD; /* IAD descriptor */
+  pIadDesc->bFirstInterface         = pdev->tclasslist[pdev->classId].Ifs[0];
+  pIadDesc->bInterfaceCount         = 2U;    /* 2 interfaces */
+  pIadDesc->bFunctionClass          = 0x02U;
+  pIadDesc->bFunctionSubClass       = 0x0DU;
+  pIadDesc->bFunctionProtocol       = 0x00U;
+  pIadDesc->iFunction               = 0U; /* String Index */
+  *Sze                             += (uint32_t)sizeof(USBD_IadDescTypeDef);
+#endif /* USBD_COMPOSITE_USE_IAD == 1 */
+
+  /* Append NCM Interface descriptor to Configuration descriptor */
+  __USBD_CMPSIT_SET_IF(pdev->tclasslist[pdev->classId].Ifs[0], 0U, 1U, 0x02U, 0x0DU, 0U, 0U);
+
+  /* Append NCM header functional descriptor to Configuration descriptor */
+  pHeadDesc = ((USBD_CDCHeaderFuncDescTypeDef *)(pConf + *Sze));
+  pHeadDesc->bLength                 = (uint8_t)sizeof(USBD_CDCHeaderFuncDescTypeDef);
+  pHeadDesc->bDescriptorType         = USBD_FUNC_DESCRIPTOR_TYPE;
+  pHeadDesc->bDescriptorSubtype      = 0x00U;
+  pHeadDesc->bcdCDC                  = 0x0110U;
+  *Sze += (uint32_t)sizeof(USBD_CDCHeaderFuncDescTypeDef);
+
+  /* Append NCM Union functional descriptor to Configuration descriptor */
+  pUnionDesc = ((USBD_CDCUnionFuncDescTypeDef *)(pConf + *Sze));
+  pUnionDesc->bLength             = (uint8_t)sizeof(USBD_CDCUnionFuncDescTypeDef);
+  pUnionDesc->bDescriptorType     = 0x24U;
+  pUnionDesc->bDescriptorSubtype  = 0x06U;
+  pUnionDesc->bMasterInterface    = pdev->tclasslist[pdev->classId].Ifs[0];
+  pUnionDesc->bSlaveInterface     = pdev->tclasslist[pdev->classId].Ifs[1];
+  *Sze += (uint32_t)sizeof(USBD_CDCUnionFuncDescTypeDef);
+
+  /* Append Ethernet Networking functional descriptor to Configuration descriptor */
+  pEthDesc = ((USBD_NCMEthFuncDescTypeDef *)(pConf + *Sze));
+  pEthDesc->bFunctionLength          = (uint8_t)sizeof(USBD_NCMEthFuncDescTypeDef);
+  pEthDesc->bDescriptorType          = USBD_FUNC_DESCRIPTOR_TYPE;
+  pEthDesc->bDescriptorSubType       = 0x0FU;
+  pEthDesc->iMacAddress              = CDC_NCM_MAC_STRING_INDEX;
+  pEthDesc->bEthernetStatistics3     = 0U;
+  pEthDesc->bEthernetStatistics2     = 0U;
+  pEthDesc->bEthernetStatistics1     = 0U;
+  pEthDesc->bEthernetStatistics0     = 0U;
+  pEthDesc->wMaxSegmentSize          = CDC_NCM_ETH_MAX_SEGSZE;
+  pEthDesc->wNumberMCFilters         = CDC_NCM_ETH_NBR_MACFILTERS;
+  pEthDesc->bNumberPowerFilters      = CDC_NCM_ETH_NBR_PWRFILTERS;
+  *Sze += (uint32_t)sizeof(USBD_NCMEthFuncDescTypeDef);
+
+  /* Append NCM functional descriptor to Configuration descriptor */
+  pFuncDesc = ((USBD_NCMFuncDescTypeDef *)(pConf + *Sze));
+  pFuncDesc->bFunctionLength         = (uint8_t)sizeof(USBD_NCMFuncDescTypeDef);
+  pFuncDesc->bDescriptorType         = USBD_FUNC_DESCRIPTOR_TYPE;
+  pFuncDesc->bDescriptorSubType      = 0x1AU;
+  pFuncDesc->bcdNcmVersion           = 0x0100U;
+  pFuncDesc->bmNetworkCapabilities   = 0U;
+  *Sze += (uint32_t)sizeof(USBD_NCMFuncDescTypeDef);
+
+  /* Append NCM Communication IN Endpoint Descriptor to Configuration descriptor */
+  __USBD_CMPSIT_SET_EP(pdev->tclasslist[pdev->classId].Eps[2].add, USBD_EP_TYPE_INTR, CDC_NCM_CMD_PACKET_SIZE, \
+                       CDC_NCM_HS_BINTERVAL, CDC_NCM_FS_BINTERVAL);
+
+  /* Append NCM Data class interface descriptors to Configuration descriptor:
+     alternate setting 0 without endpoints, alternate setting 1 for the NTB transfers */
+  __USBD_CMPSIT_SET_IF(pdev->tclasslist[pdev->classId].Ifs[1], 0U, 0U, 0x0AU, 0U, 0x01U, 0U);
+  __USBD_CMPSIT_SET_IF(pdev->tclasslist[pdev->classId].Ifs[1], 1U, 2U, 0x0AU, 0U, 0x01U, 0U);
+
+  if (speed == (uint8_t)USBD_SPEED_HIGH)
+  {
+    pdev->tclasslist[pdev->classId].CurrPcktSze = CDC_NCM_DATA_HS_MAX_PACKET_SIZE;
+  }
+
+  /* Append NCM OUT Endpoint Descriptor to Configuration descriptor */
+  __USBD_CMPSIT_SET_EP((pdev->tclasslist[pdev->classId].Eps[1].add), (USBD_EP_TYPE_BULK), \
+                       (pdev->tclasslist[pdev->classId].CurrPcktSze), (0U), (0U));
+
+  /* Append NCM IN Endpoint Descriptor to Configuration descriptor */
+  __USBD_CMPSIT_SET_EP((pdev->tclasslist[pdev->classId].Eps[0].add), (USBD_EP_TYPE_BULK), \
+                       (pdev->tclasslist[pdev->classId].CurrPcktSze), (0U), (0U));
+
+  /* Update Config Descriptor and IAD descriptor */
+  ((USBD_ConfigDescTypeDef *)pConf)->bNumInterfaces += 2U;
+  ((USBD_ConfigDescTypeDef *)pConf)->wTotalLength = *Sze;
+}
+#endif /* USBD_CMPSIT_ACTIVATE_CDC_NCM */
+
 #if USBD_CMPSIT_ACTIVATE_AUDIO == 1
 /**
   * @brief  USBD_CMPSIT_AUDIODesc
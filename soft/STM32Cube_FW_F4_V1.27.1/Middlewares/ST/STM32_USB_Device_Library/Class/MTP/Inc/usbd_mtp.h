@@ -120,6 +120,7 @@ extern "C" {
 #define MTP_RESPONSE_TRANSACTION_CANCELLED                          0x201FU
 #define MTP_RESPONSE_INVALID_OBJECT_PROP_CODE                       0xA801U
 #define MTP_RESPONSE_SPECIFICATION_BY_GROUP_UNSUPPORTED             0xA807U
+#define MTP_RESPONSE_SPECIFICATION_BY_DEPTH_UNSUPPORTED             0xA808U
 #define MTP_RESPONSE_OBJECT_PROP_NOT_SUPPORTED                      0xA80AU
 
 /*
@@ -208,6 +209,7 @@ typedef struct
   uint32_t totallen;
   uint32_t rx_length;
   uint32_t readbytes;  /* File write/read counts */
+  uint32_t maxlen;     /* Room available in the read buffer */
 } MTP_DataLengthTypeDef;
 
 typedef enum
@@ -217,6 +219,7 @@ typedef enum
   RECEIVE_FIRST_DATA     = 0x02U,
   RECEIVE_REST_OF_DATA   = 0x03U,
   SEND_RESPONSE          = 0x04U,
+  RECEIVE_STREAM_DATA    = 0x05U,  /* Object data received in multi-packet transfers */
 } MTP_RECEIVE_DATA_STATUS;
 
 typedef struct
@@ -311,6 +314,8 @@ typedef struct _USBD_MTP_ItfTypeDef
 {
   uint8_t (*Init)(void);
   uint8_t (*DeInit)(void);
+  /* Read at most data_length->maxlen bytes of the object into buff, set
+     readbytes and add it to temp_length (0 on the first call of an object) */
   uint32_t (*ReadData)(uint32_t Param1, uint8_t *buff, MTP_DataLengthTypeDef *data_length);
   uint16_t (*Create_NewObject)(MTP_ObjectInfoTypeDef ObjectInfo, uint32_t objhandle);
 
@@ -329,6 +334,9 @@ typedef struct _USBD_MTP_ItfTypeDef
   void (*Cancel)(uint32_t Phase);
   uint32_t                      *ScratchBuff;
   uint32_t                       ScratchBuffSze;
+  /* Optional, may be NULL: copy at most max object handles of Param3 starting
+     at the start'th one and return the total number of handles of Param3 */
+  uint32_t (*GetIdxRange)(uint32_t Param3, uint32_t start, uint32_t *obj_handle, uint32_t max);
 } USBD_MTP_ItfTypeDef;
 
 /**
@@ -57,7 +57,29 @@ extern "C" {
 #define SUPP_DEVICE_PROP_LEN                                    0U
 #endif /* USBD_MTP_DEVICE_PROP_SUPPORTED */
 
-#define MTP_IF_SCRATCH_BUFF_SZE                                1024U
+/* Object data is streamed through the two halves of the scratch buffer,
+   it shall hold at least two packets */
+#ifndef MTP_IF_SCRATCH_BUFF_SZE
+#define MTP_IF_SCRATCH_BUFF_SZE                                8192U
+#endif /* MTP_IF_SCRATCH_BUFF_SZE */
+
+/* Object handle index: objects of the volume and room for their names */
+#ifndef MTP_IF_MAX_OBJECTS
+#define MTP_IF_MAX_OBJECTS                                     2048U
+#endif /* MTP_IF_MAX_OBJECTS */
+
+#ifndef MTP_IF_NAME_POOL_SZE
+#define MTP_IF_NAME_POOL_SZE                                   32768U
+#endif /* MTP_IF_NAME_POOL_SZE */
+
+#ifndef MTP_IF_MAX_PATH
+#define MTP_IF_MAX_PATH                                        256U
+#endif /* MTP_IF_MAX_PATH */
+
+/* FatFs logical drive exposed as the MTP storage */
+#ifndef MTP_IF_VOLUME
+#define MTP_IF_VOLUME                                          "0:"
+#endif /* MTP_IF_VOLUME */
 
 /* Exported types ------------------------------------------------------------*/
 extern USBD_MTP_ItfTypeDef USBD_MTP_fops;
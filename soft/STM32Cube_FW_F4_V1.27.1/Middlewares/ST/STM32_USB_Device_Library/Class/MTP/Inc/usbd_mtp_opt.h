@@ -660,6 +660,7 @@ void USBD_MTP_OPT_GetDevicePropDesc(USBD_HandleTypeDef  *pdev);
 void USBD_MTP_OPT_SendObjectInfo(USBD_HandleTypeDef  *pdev, uint8_t *buff, uint32_t len);
 void USBD_MTP_OPT_SendObject(USBD_HandleTypeDef  *pdev, uint8_t *buff, uint32_t len);
 void USBD_MTP_OPT_GetObject(USBD_HandleTypeDef  *pdev);
+uint32_t USBD_MTP_OPT_ReadData(USBD_HandleTypeDef  *pdev, uint8_t *buff, MTP_DataLengthTypeDef *data_length);
 void USBD_MTP_OPT_DeleteObject(USBD_HandleTypeDef  *pdev);
 
 
@@ -62,6 +62,7 @@ typedef enum
 {
   READ_FIRST_DATA = 0x00,
   READ_REST_OF_DATA = 0x01,
+  READ_SEND_ZLP = 0x02,
 } MTP_READ_DATA_STATUS;
 
 
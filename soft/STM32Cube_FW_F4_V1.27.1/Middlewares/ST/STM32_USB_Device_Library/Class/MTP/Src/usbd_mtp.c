@@ -543,10 +543,14 @@ static uint8_t USBD_MTP_DataOut(USBD_HandleTypeDef *pdev, uint8_t epnum)
     case MTP_RECEIVE_DATA :
       (void)USBD_MTP_STORAGE_ReceiveData(pdev);
 
-      /* prepare endpoint to receive operations */
-      len = MIN(hmtp->MaxPcktLen, pdev->request.wLength);
+      /* object data being streamed has its own OUT transfers */
+      if (hmtp->RECEIVE_DATA_STATUS != RECEIVE_STREAM_DATA)
+      {
+        /* prepare endpoint to receive operations */
+        len = MIN(hmtp->MaxPcktLen, pdev->request.wLength);
 
-      (void)USBD_LL_PrepareReceive(pdev, MTPOutEpAdd, (uint8_t *)&hmtp->rx_buff, len);
+        (void)USBD_LL_PrepareReceive(pdev, MTPOutEpAdd, (uint8_t *)&hmtp->rx_buff, len);
+      }
       break;
 
     case MTP_PHASE_IDLE :
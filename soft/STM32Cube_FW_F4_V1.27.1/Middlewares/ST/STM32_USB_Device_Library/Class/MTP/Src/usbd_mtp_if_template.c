@@ -2,7 +2,8 @@
   ******************************************************************************
   * @file    usbd_mtp_if.c
   * @author  MCD Application Team
-  * @brief   Source file for USBD MTP file list_files.
+  * @brief   Source file for USBD MTP file list_files, FatFs volume with an
+  *          object handle index built once at init.
   ******************************************************************************
   * @attention
   *
@@ -18,30 +19,82 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_mtp_if_template.h"
+#include "usbd_mtp_opt.h"
+#include "ff.h"
 
 /* Private typedef -----------------------------------------------------------*/
+/* Object handle index entry, the handle of an object is its index + 1 and
+   stays valid until the object is deleted. The FatFs path of an object is
+   rebuilt from the names of its parents. */
+typedef struct
+{
+  uint32_t size;         /* file size in bytes */
+  uint16_t parent;       /* folder index, MTP_IF_NO_OBJ for the root folder */
+  uint16_t next;         /* next object of the same folder */
+  uint16_t child;        /* first object of a folder */
+  uint16_t format;       /* MTP object format */
+  uint16_t name;         /* offset of the name in ObjNames[] */
+  uint8_t  name_len;     /* name length, without terminator */
+  uint8_t  flags;
+} MTP_IF_ObjectTypeDef;
+
+/* Private define ------------------------------------------------------------*/
+#define MTP_IF_NO_OBJ                                          0xFFFFU
+
+#define MTP_IF_OBJ_USED                                        0x01U
+#define MTP_IF_OBJ_FOLDER                                      0x02U
+
+#define MTP_IF_FILE_CLOSED                                     0U
+#define MTP_IF_FILE_READ                                       1U
+#define MTP_IF_FILE_WRITE                                      2U
+
+/* GetIdxRange() selectors */
+#define MTP_IF_ALL_OBJ                                         0x00000000U
+#define MTP_IF_ROOT_OBJ                                        0xFFFFFFFFU
+
+#if MTP_IF_MAX_OBJECTS >= MTP_IF_NO_OBJ
+#error "MTP_IF_MAX_OBJECTS shall be lower than 65535"
+#endif /* MTP_IF_MAX_OBJECTS */
+
+#if MTP_IF_NAME_POOL_SZE > 65536U
+#error "MTP_IF_NAME_POOL_SZE shall not exceed 64KB"
+#endif /* MTP_IF_NAME_POOL_SZE */
+
+/* Private macro -------------------------------------------------------------*/
+#if FF_MAX_SS == FF_MIN_SS
+#define MTP_IF_SECTOR_SIZE(fs)                                 ((uint32_t)FF_MAX_SS)
+#else
+#define MTP_IF_SECTOR_SIZE(fs)                                 ((uint32_t)(fs)->ssize)
+#endif /* FF_MAX_SS */
+
 /* Private variables ---------------------------------------------------------*/
-/*
-static FILE MyFile;
-static FATFS SDFatFs;
-static char SDPath[4];
-static FolderLevel Fold_Lvl;
-static FOLD_INFTypeDef FoldStruct;
-static FILE_INFTypeDef FileStruct;
-static SD_Object_TypeDef sd_object;
-*/
 extern USBD_HandleTypeDef USBD_Device;
 
-uint32_t idx[200];
-uint32_t parent;
-/* static char path[255]; */
 uint32_t sc_buff[MTP_IF_SCRATCH_BUFF_SZE / 4U];
-uint32_t sc_len = 0U;
-uint32_t pckt_cnt = 1U;
-uint32_t foldsize;
 
-/* Private define ------------------------------------------------------------*/
-/* Private macro -------------------------------------------------------------*/
+static FATFS MTP_FatFs;
+static FIL MTP_File;
+static uint8_t  FileMode;
+static uint16_t FileObj;
+
+static MTP_IF_ObjectTypeDef Obj[MTP_IF_MAX_OBJECTS];
+static char ObjNames[MTP_IF_NAME_POOL_SZE];
+static uint32_t ObjCount;      /* deleted entries are not reused */
+static uint32_t ObjNamesLen;
+static uint16_t RootChild;
+static uint16_t NewObj;
+
+/* GetIdxRange() resumes a listing where the previous call stopped */
+static uint8_t  IdxValid;
+static uint32_t IdxSel;
+static uint32_t IdxPos;
+static uint32_t IdxCount;
+static uint16_t IdxObj;
+
+static char Path[MTP_IF_MAX_PATH];
+static DIR Dir;
+static FILINFO FileInfo;
+
 /* Private function prototypes -----------------------------------------------*/
 static uint8_t  USBD_MTP_Itf_Init(void);
 static uint8_t  USBD_MTP_Itf_DeInit(void);
@@ -60,9 +113,19 @@ static uint32_t USBD_MTP_Itf_GetNewIndex(uint16_t objformat);
 static void     USBD_MTP_Itf_WriteData(uint16_t len, uint8_t *buff);
 static uint32_t USBD_MTP_Itf_GetContainerLength(uint32_t Param1);
 static uint16_t USBD_MTP_Itf_DeleteObject(uint32_t Param1);
+static uint32_t USBD_MTP_Itf_GetIdxRange(uint32_t Param3, uint32_t start, uint32_t *obj_handle, uint32_t max);
 
 static void     USBD_MTP_Itf_Cancel(uint32_t Phase);
-/* static uint32_t USBD_MTP_Get_idx_to_delete(uint32_t Param, uint8_t *tab); */
+
+static void     MTP_IF_BuildIndex(void);
+static uint16_t MTP_IF_AddObject(uint16_t parent, const char *name, uint32_t len, uint32_t size, uint8_t folder);
+static void     MTP_IF_RemoveObject(uint16_t obj);
+static uint16_t MTP_IF_GetObject(uint32_t handle);
+static uint16_t MTP_IF_GetFormat(const char *name, uint32_t len);
+static uint32_t MTP_IF_GetPath(uint16_t obj, char *path);
+static uint16_t MTP_IF_FirstObject(uint32_t sel);
+static uint16_t MTP_IF_NextObject(uint32_t sel, uint16_t obj);
+static void     MTP_IF_CloseFile(void);
 
 USBD_MTP_ItfTypeDef USBD_MTP_fops =
 {
@@ -85,6 +148,7 @@ USBD_MTP_ItfTypeDef USBD_MTP_fops =
   USBD_MTP_Itf_Cancel,
   sc_buff,
   MTP_IF_SCRATCH_BUFF_SZE,
+  USBD_MTP_Itf_GetIdxRange,
 };
 
 /* Private functions ---------------------------------------------------------*/
@@ -97,6 +161,18 @@ USBD_MTP_ItfTypeDef USBD_MTP_fops =
   */
 static uint8_t USBD_MTP_Itf_Init(void)
 {
+  FileMode = MTP_IF_FILE_CLOSED;
+
+  if (f_mount(&MTP_FatFs, MTP_IF_VOLUME, 1U) != FR_OK)
+  {
+    ObjCount = 0U;
+    RootChild = MTP_IF_NO_OBJ;
+    return 1U;
+  }
+
+  /* The volume is walked once, requests are then served from the index */
+  MTP_IF_BuildIndex();
+
   return 0;
 }
 
@@ -108,6 +184,9 @@ static uint8_t USBD_MTP_Itf_Init(void)
   */
 static uint8_t USBD_MTP_Itf_DeInit(void)
 {
+  MTP_IF_CloseFile();
+  (void)f_mount(NULL, MTP_IF_VOLUME, 0U);
+
   return 0;
 }
 
@@ -120,11 +199,58 @@ static uint8_t USBD_MTP_Itf_DeInit(void)
   */
 static uint32_t USBD_MTP_Itf_GetIdx(uint32_t Param3, uint32_t *obj_handle)
 {
-  uint32_t count = 0U;
-  UNUSED(Param3);
-  UNUSED(obj_handle);
+  uint32_t count;
+
+  count = USBD_MTP_Itf_GetIdxRange(Param3, 0U, obj_handle, MAX_OBJECT_HANDLE_LEN);
 
-  return count;
+  return MIN(count, MAX_OBJECT_HANDLE_LEN);
+}
+
+/**
+  * @brief  USBD_MTP_Itf_GetIdxRange
+  *         Get a range of the object handles of a folder
+  * @param  Param3: folder handle, 0xFFFFFFFF for the root folder, 0 for all
+  *         the objects of the storage
+  * @param  start: position of the first handle to get
+  * @param  obj_handle: object handles, may be NULL when max is 0
+  * @param  max: number of handles to get
+  * @retval number of object handles in the folder
+  */
+static uint32_t USBD_MTP_Itf_GetIdxRange(uint32_t Param3, uint32_t start, uint32_t *obj_handle, uint32_t max)
+{
+  uint32_t cnt;
+  uint16_t obj;
+
+  if ((IdxValid == 0U) || (IdxSel != Param3) || (start < IdxPos))
+  {
+    /* New listing, count the objects once */
+    IdxSel = Param3;
+    IdxCount = 0U;
+
+    for (obj = MTP_IF_FirstObject(Param3); obj != MTP_IF_NO_OBJ; obj = MTP_IF_NextObject(Param3, obj))
+    {
+      IdxCount++;
+    }
+
+    IdxPos = 0U;
+    IdxObj = MTP_IF_FirstObject(Param3);
+    IdxValid = 1U;
+  }
+
+  while ((IdxPos < start) && (IdxObj != MTP_IF_NO_OBJ))
+  {
+    IdxObj = MTP_IF_NextObject(Param3, IdxObj);
+    IdxPos++;
+  }
+
+  for (cnt = 0U; (cnt < max) && (IdxObj != MTP_IF_NO_OBJ); cnt++)
+  {
+    obj_handle[cnt] = (uint32_t)IdxObj + 1U;
+    IdxObj = MTP_IF_NextObject(Param3, IdxObj);
+    IdxPos++;
+  }
+
+  return IdxCount;
 }
 
 /**
@@ -136,7 +262,12 @@ static uint32_t USBD_MTP_Itf_GetIdx(uint32_t Param3, uint32_t *obj_handle)
 static uint32_t USBD_MTP_Itf_GetParentObject(uint32_t Param)
 {
   uint32_t parentobj = 0U;
-  UNUSED(Param);
+  uint16_t obj = MTP_IF_GetObject(Param);
+
+  if ((obj != MTP_IF_NO_OBJ) && (Obj[obj].parent != MTP_IF_NO_OBJ))
+  {
+    parentobj = (uint32_t)Obj[obj].parent + 1U;
+  }
 
   return parentobj;
 }
@@ -149,8 +280,13 @@ static uint32_t USBD_MTP_Itf_GetParentObject(uint32_t Param)
   */
 static uint16_t USBD_MTP_Itf_GetObjectFormat(uint32_t Param)
 {
-  uint16_t objformat = 0U;
-  UNUSED(Param);
+  uint16_t objformat = MTP_OBJ_FORMAT_UNDEFINED;
+  uint16_t obj = MTP_IF_GetObject(Param);
+
+  if (obj != MTP_IF_NO_OBJ)
+  {
+    objformat = Obj[obj].format;
+  }
 
   return objformat;
 }
@@ -159,12 +295,17 @@ static uint16_t USBD_MTP_Itf_GetObjectFormat(uint32_t Param)
   * @brief  USBD_MTP_Itf_GetObjectName_len
   *         Get object name length
   * @param  Param: object handle (object index)
-  * @retval object name length
+  * @retval object name length, including the terminating null character
   */
 static uint8_t USBD_MTP_Itf_GetObjectName_len(uint32_t Param)
 {
   uint8_t obj_len = 0U;
-  UNUSED(Param);
+  uint16_t obj = MTP_IF_GetObject(Param);
+
+  if (obj != MTP_IF_NO_OBJ)
+  {
+    obj_len = Obj[obj].name_len + 1U;
+  }
 
   return obj_len;
 }
@@ -179,11 +320,21 @@ static uint8_t USBD_MTP_Itf_GetObjectName_len(uint32_t Param)
   */
 static void USBD_MTP_Itf_GetObjectName(uint32_t Param, uint8_t obj_len, uint16_t *buf)
 {
-  UNUSED(Param);
-  UNUSED(obj_len);
-  UNUSED(buf);
+  uint16_t obj = MTP_IF_GetObject(Param);
+  uint32_t i = 0U;
+
+  if ((obj == MTP_IF_NO_OBJ) || (obj_len == 0U))
+  {
+    return;
+  }
+
+  /* Names are kept in the FatFs code page, ASCII maps as is */
+  for (; (i < ((uint32_t)obj_len - 1U)) && (i < Obj[obj].name_len); i++)
+  {
+    buf[i] = (uint8_t)ObjNames[Obj[obj].name + i];
+  }
 
-  return;
+  buf[i] = 0U;
 }
 
 /**
@@ -195,7 +346,12 @@ static void USBD_MTP_Itf_GetObjectName(uint32_t Param, uint8_t obj_len, uint16_t
 static uint32_t USBD_MTP_Itf_GetObjectSize(uint32_t Param)
 {
   uint32_t ObjCompSize = 0U;
-  UNUSED(Param);
+  uint16_t obj = MTP_IF_GetObject(Param);
+
+  if (obj != MTP_IF_NO_OBJ)
+  {
+    ObjCompSize = Obj[obj].size;
+  }
 
   return ObjCompSize;
 }
@@ -209,11 +365,79 @@ static uint32_t USBD_MTP_Itf_GetObjectSize(uint32_t Param)
   */
 static uint16_t USBD_MTP_Itf_Create_NewObject(MTP_ObjectInfoTypeDef ObjectInfo, uint32_t objhandle)
 {
-  uint16_t rep_code = 0U;
-  UNUSED(ObjectInfo);
-  UNUSED(objhandle);
-
-  return rep_code;
+  char name[MAX_FILE_NAME];
+  uint16_t parent = MTP_IF_NO_OBJ;
+  uint16_t obj;
+  uint16_t c;
+  uint32_t len;
+  uint32_t i;
+  uint8_t folder = (ObjectInfo.ObjectFormat == MTP_OBJ_FORMAT_ASSOCIATION) ? 1U : 0U;
+  FRESULT res;
+
+  if (objhandle != 0U)
+  {
+    parent = MTP_IF_GetObject(objhandle);
+
+    if ((parent == MTP_IF_NO_OBJ) || ((Obj[parent].flags & MTP_IF_OBJ_FOLDER) == 0U))
+    {
+      return MTP_RESPONSE_INVALID_PARENT_OBJECT;
+    }
+  }
+
+  /* Filename_len counts the terminating null character */
+  len = (ObjectInfo.Filename_len > 1U) ? ((uint32_t)ObjectInfo.Filename_len - 1U) : 0U;
+
+  if (len == 0U)
+  {
+    return MTP_RESPONSE_INVALID_PARAMETER;
+  }
+
+  for (i = 0U; i < len; i++)
+  {
+    c = ObjectInfo.Filename[i];
+    name[i] = ((c < 0x80U) && (c != (uint16_t)'/') && (c != (uint16_t)'\\') && (c != (uint16_t)':')) ? (char)c : '_';
+  }
+
+  MTP_IF_CloseFile();
+
+  obj = MTP_IF_AddObject(parent, name, len, 0U, folder);
+  if (obj == MTP_IF_NO_OBJ)
+  {
+    return MTP_RESPONSE_STORE_FULL;
+  }
+
+  if (MTP_IF_GetPath(obj, Path) == 0U)
+  {
+    res = FR_INVALID_NAME;
+  }
+  else if (folder != 0U)
+  {
+    res = f_mkdir(Path);
+    if (res == FR_EXIST)
+    {
+      res = FR_OK;
+    }
+  }
+  else
+  {
+    /* SendObject data is written straight from the USB buffers */
+    res = f_open(&MTP_File, Path, FA_CREATE_ALWAYS | FA_WRITE);
+    if (res == FR_OK)
+    {
+      FileMode = MTP_IF_FILE_WRITE;
+      FileObj = obj;
+    }
+  }
+
+  if (res != FR_OK)
+  {
+    MTP_IF_RemoveObject(obj);
+    return MTP_RESPONSE_ACCESS_DENIED;
+  }
+
+  NewObj = obj;
+
+  return MTP_RESPONSE_OK;
 }
 
 /**
@@ -226,6 +450,11 @@ static uint64_t USBD_MTP_Itf_GetMaxCapability(void)
 {
   uint64_t max_cap = 0U;
 
+  if (MTP_FatFs.fs_type != 0U)
+  {
+    max_cap = (uint64_t)(MTP_FatFs.n_fatent - 2U) * MTP_FatFs.csize * MTP_IF_SECTOR_SIZE(&MTP_FatFs);
+  }
+
   return max_cap;
 }
 
@@ -238,6 +467,13 @@ static uint64_t USBD_MTP_Itf_GetMaxCapability(void)
 static uint64_t USBD_MTP_Itf_GetFreeSpaceInBytes(void)
 {
   uint64_t f_space_inbytes = 0U;
+  FATFS *fs;
+  DWORD nclst;
+
+  if (f_getfree(MTP_IF_VOLUME, &nclst, &fs) == FR_OK)
+  {
+    f_space_inbytes = (uint64_t)nclst * fs->csize * MTP_IF_SECTOR_SIZE(fs);
+  }
 
   return f_space_inbytes;
 }
@@ -250,25 +486,40 @@ static uint64_t USBD_MTP_Itf_GetFreeSpaceInBytes(void)
   */
 static uint32_t USBD_MTP_Itf_GetNewIndex(uint16_t objformat)
 {
-  uint32_t n_index = 0U;
   UNUSED(objformat);
 
-  return n_index;
+  /* The handle was allocated by USBD_MTP_Itf_Create_NewObject */
+  return (uint32_t)NewObj + 1U;
 }
 
 /**
   * @brief  USBD_MTP_Itf_WriteData
   *         Write file data to SD card
-  * @param  len: size of data to write
+  * @param  len: size of data to write, 0 to close the file
   * @param  buff: data to write in SD card
   * @retval None
   */
 static void USBD_MTP_Itf_WriteData(uint16_t len, uint8_t *buff)
 {
-  UNUSED(len);
-  UNUSED(buff);
-
-  return;
+  UINT bw;
+
+  if (FileMode != MTP_IF_FILE_WRITE)
+  {
+    return;
+  }
+
+  if (len == 0U)
+  {
+    MTP_IF_CloseFile();
+  }
+  else if (f_write(&MTP_File, buff, len, &bw) != FR_OK)
+  {
+    MTP_IF_CloseFile();
+  }
+  else
+  {
+    /* whole sectors go from buff to the disk without a copy */
+  }
 }
 
 /**
@@ -280,7 +531,12 @@ static void USBD_MTP_Itf_WriteData(uint16_t len, uint8_t *buff)
 static uint32_t USBD_MTP_Itf_GetContainerLength(uint32_t Param1)
 {
   uint32_t length = 0U;
-  UNUSED(Param1);
+  uint16_t obj = MTP_IF_GetObject(Param1);
+
+  if (obj != MTP_IF_NO_OBJ)
+  {
+    length = Obj[obj].size + MTP_CONT_HEADER_SIZE;
+  }
 
   return length;
 }
@@ -293,27 +549,39 @@ static uint32_t USBD_MTP_Itf_GetContainerLength(uint32_t Param1)
   */
 static uint16_t USBD_MTP_Itf_DeleteObject(uint32_t Param1)
 {
-  uint16_t rep_code = 0U;
-  UNUSED(Param1);
-
-  return rep_code;
+  uint16_t obj = MTP_IF_GetObject(Param1);
+  uint16_t cur;
+  FRESULT res;
+
+  if (obj == MTP_IF_NO_OBJ)
+  {
+    return MTP_RESPONSE_INVALID_OBJECT_HANDLE;
+  }
+
+  MTP_IF_CloseFile();
+
+  /* Remove the deepest first child until the object itself is removed,
+     each one is then the head of its folder list */
+  do
+  {
+    cur = obj;
+    while (Obj[cur].child != MTP_IF_NO_OBJ)
+    {
+      cur = Obj[cur].child;
+    }
+
+    res = (MTP_IF_GetPath(cur, Path) != 0U) ? f_unlink(Path) : FR_INVALID_NAME;
+    if ((res != FR_OK) && (res != FR_NO_FILE))
+    {
+      return MTP_RESPONSE_ACCESS_DENIED;
+    }
+
+    MTP_IF_RemoveObject(cur);
+  } while (cur != obj);
+
+  return MTP_RESPONSE_OK;
 }
 
-/**
-  * @brief  USBD_MTP_Get_idx_to_delete
-  *         Get all files/foldres index to delete with descending order ( max depth)
-  * @param  Param: object handle (file/folder index)
-  * @param  tab: pointer to list of files/folders to delete
-  * @retval Number of files/folders to delete
-  */
-/* static uint32_t USBD_MTP_Get_idx_to_delete(uint32_t Param, uint8_t *tab)
-{
-  uint32_t cnt = 0U;
-
-  return cnt;
-}
-*/
-
 /**
   * @brief  USBD_MTP_Itf_ReadData
   *         Read data from SD card
@@ -324,11 +592,39 @@ static uint16_t USBD_MTP_Itf_DeleteObject(uint32_t Param1)
   */
 static uint32_t USBD_MTP_Itf_ReadData(uint32_t Param1, uint8_t *buff, MTP_DataLengthTypeDef *data_length)
 {
-  UNUSED(Param1);
-  UNUSED(buff);
-  UNUSED(data_length);
-
-  return 0U;
+  uint16_t obj = MTP_IF_GetObject(Param1);
+  UINT br = 0U;
+
+  if (data_length->temp_length == 0U)
+  {
+    MTP_IF_CloseFile();
+
+    if ((obj != MTP_IF_NO_OBJ) && ((Obj[obj].flags & MTP_IF_OBJ_FOLDER) == 0U) &&
+        (MTP_IF_GetPath(obj, Path) != 0U) && (f_open(&MTP_File, Path, FA_READ) == FR_OK))
+    {
+      FileMode = MTP_IF_FILE_READ;
+      FileObj = obj;
+    }
+  }
+
+  if ((FileMode == MTP_IF_FILE_READ) && (FileObj == obj))
+  {
+    /* Whole sectors are read by FatFs straight into buff */
+    if (f_read(&MTP_File, buff, data_length->maxlen, &br) != FR_OK)
+    {
+      br = 0U;
+    }
+  }
+
+  data_length->readbytes = br;
+  data_length->temp_length += br;
+
+  if ((br == 0U) || (data_length->temp_length >= data_length->totallen))
+  {
+    MTP_IF_CloseFile();
+  }
+
+  return br;
 }
 
 /**
@@ -339,9 +635,350 @@ static uint32_t USBD_MTP_Itf_ReadData(uint32_t Param1, uint8_t *buff, MTP_DataLe
   */
 static void USBD_MTP_Itf_Cancel(uint32_t Phase)
 {
-  UNUSED(Phase);
+  uint16_t obj = FileObj;
 
   /* Make sure to close open file while canceling transaction */
+  if ((Phase == 1U) && (FileMode == MTP_IF_FILE_WRITE))
+  {
+    /* drop the partially received object */
+    MTP_IF_CloseFile();
+
+    if (MTP_IF_GetPath(obj, Path) != 0U)
+    {
+      (void)f_unlink(Path);
+    }
+    MTP_IF_RemoveObject(obj);
+  }
+  else
+  {
+    MTP_IF_CloseFile();
+  }
+}
 
-  return;
+/**
+  * @brief  MTP_IF_BuildIndex
+  *         Walk the volume breadth first, the index itself is the queue of
+  *         folders to scan
+  * @param  None
+  * @retval None
+  */
+static void MTP_IF_BuildIndex(void)
+{
+  uint16_t folder = MTP_IF_NO_OBJ;
+  uint32_t i = 0U;
+
+  ObjCount = 0U;
+  ObjNamesLen = 0U;
+  RootChild = MTP_IF_NO_OBJ;
+  IdxValid = 0U;
+
+  for (;;)
+  {
+    if ((MTP_IF_GetPath(folder, Path) != 0U) && (f_opendir(&Dir, Path) == FR_OK))
+    {
+      while ((f_readdir(&Dir, &FileInfo) == FR_OK) && (FileInfo.fname[0] != '\0'))
+      {
+        if ((FileInfo.fattrib & (AM_HID | AM_SYS)) != 0U)
+        {
+          continue;
+        }
+
+        if (MTP_IF_AddObject(folder, FileInfo.fname, strlen(FileInfo.fname), (uint32_t)FileInfo.fsize,
+                             ((FileInfo.fattrib & AM_DIR) != 0U) ? 1U : 0U) == MTP_IF_NO_OBJ)
+        {
+          break;
+        }
+      }
+      (void)f_closedir(&Dir);
+    }
+
+    /* next folder in index order */
+    while ((i < ObjCount) && ((Obj[i].flags & MTP_IF_OBJ_FOLDER) == 0U))
+    {
+      i++;
+    }
+
+    if (i >= ObjCount)
+    {
+      break;
+    }
+
+    folder = (uint16_t)i;
+    i++;
+  }
+}
+
+/**
+  * @brief  MTP_IF_AddObject
+  *         Add an object at the head of its folder list
+  * @param  parent: folder index, MTP_IF_NO_OBJ for the root folder
+  * @param  name: object name, not null terminated
+  * @param  len: name length
+  * @param  size: file size
+  * @param  folder: 1 for a folder
+  * @retval object index, MTP_IF_NO_OBJ if the index is full
+  */
+static uint16_t MTP_IF_AddObject(uint16_t parent, const char *name, uint32_t len, uint32_t size, uint8_t folder)
+{
+  uint16_t obj;
+
+  if ((len >= MAX_FILE_NAME) || (ObjCount >= MTP_IF_MAX_OBJECTS) ||
+      ((ObjNamesLen + len) > MTP_IF_NAME_POOL_SZE))
+  {
+    return MTP_IF_NO_OBJ;
+  }
+
+  obj = (uint16_t)ObjCount;
+  ObjCount++;
+
+  (void)memcpy(&ObjNames[ObjNamesLen], name, len);
+  Obj[obj].name = (uint16_t)ObjNamesLen;
+  Obj[obj].name_len = (uint8_t)len;
+  ObjNamesLen += len;
+
+  Obj[obj].size = size;
+  Obj[obj].parent = parent;
+  Obj[obj].child = MTP_IF_NO_OBJ;
+  Obj[obj].flags = (folder != 0U) ? (MTP_IF_OBJ_USED | MTP_IF_OBJ_FOLDER) : MTP_IF_OBJ_USED;
+  Obj[obj].format = (folder != 0U) ? MTP_OBJ_FORMAT_ASSOCIATION : MTP_IF_GetFormat(name, len);
+
+  if (parent == MTP_IF_NO_OBJ)
+  {
+    Obj[obj].next = RootChild;
+    RootChild = obj;
+  }
+  else
+  {
+    Obj[obj].next = Obj[parent].child;
+    Obj[parent].child = obj;
+  }
+
+  IdxValid = 0U;
+
+  return obj;
+}
+
+/**
+  * @brief  MTP_IF_RemoveObject
+  *         Unlink an object from its folder list, its handle is not reused
+  *         unless it is the last one allocated
+  * @param  obj: object index
+  * @retval None
+  */
+static void MTP_IF_RemoveObject(uint16_t obj)
+{
+  uint16_t *link;
+
+  link = (Obj[obj].parent == MTP_IF_NO_OBJ) ? &RootChild : &Obj[Obj[obj].parent].child;
+
+  while ((*link != obj) && (*link != MTP_IF_NO_OBJ))
+  {
+    link = &Obj[*link].next;
+  }
+
+  if (*link == obj)
+  {
+    *link = Obj[obj].next;
+  }
+
+  Obj[obj].flags = 0U;
+
+  if ((uint32_t)obj == (ObjCount - 1U))
+  {
+    ObjCount--;
+    ObjNamesLen = Obj[obj].name;
+  }
+
+  IdxValid = 0U;
+}
+
+/**
+  * @brief  MTP_IF_GetObject
+  *         Get the index entry of an object handle
+  * @param  handle: object handle
+  * @retval object index, MTP_IF_NO_OBJ if the handle is not valid
+  */
+static uint16_t MTP_IF_GetObject(uint32_t handle)
+{
+  if ((handle == 0U) || (handle > ObjCount) || ((Obj[handle - 1U].flags & MTP_IF_OBJ_USED) == 0U))
+  {
+    return MTP_IF_NO_OBJ;
+  }
+
+  return (uint16_t)(handle - 1U);
+}
+
+/**
+  * @brief  MTP_IF_GetFormat
+  *         Get the object format of a file from its extension
+  * @param  name: file name
+  * @param  len: name length
+  * @retval object format
+  */
+static uint16_t MTP_IF_GetFormat(const char *name, uint32_t len)
+{
+  static const struct
+  {
+    char ext[4];
+    uint16_t format;
+  } formats[] =
+  {
+    {"TXT", MTP_OBJ_FORMAT_TEXT}, {"LOG", MTP_OBJ_FORMAT_TEXT}, {"CSV", MTP_OBJ_FORMAT_TEXT},
+    {"HTM", MTP_OBJ_FORMAT_HTML}, {"WAV", MTP_OBJ_FORMAT_WAV}, {"MP3", MTP_OBJ_FORMAT_MP3},
+    {"AVI", MTP_OBJ_FORMAT_AVI}, {"JPG", MTP_OBJ_FORMAT_EXIF_JPEG}, {"BMP", MTP_OBJ_FORMAT_BMP},
+    {"PNG", MTP_OBJ_FORMAT_PNG}, {"MP4", MTP_OBJ_FORMAT_MP4_CONTAINER},
+  };
+  uint32_t i;
+  uint32_t j;
+  char c;
+
+  if ((len < 4U) || (name[len - 4U] != '.'))
+  {
+    return MTP_OBJ_FORMAT_UNDEFINED;
+  }
+
+  for (i = 0U; i < (sizeof(formats) / sizeof(formats[0])); i++)
+  {
+    for (j = 0U; j < 3U; j++)
+    {
+      c = name[len - 3U + j];
+      if ((c >= 'a') && (c <= 'z'))
+      {
+        c -= 'a' - 'A';
+      }
+      if (c != formats[i].ext[j])
+      {
+        break;
+      }
+    }
+
+    if (j == 3U)
+    {
+      return formats[i].format;
+    }
+  }
+
+  return MTP_OBJ_FORMAT_UNDEFINED;
+}
+
+/**
+  * @brief  MTP_IF_GetPath
+  *         Build the FatFs path of an object from the names of its parents
+  * @param  obj: object index, MTP_IF_NO_OBJ for the root folder
+  * @param  path: destination, MTP_IF_MAX_PATH bytes
+  * @retval path length, 0 if it does not fit
+  */
+static uint32_t MTP_IF_GetPath(uint16_t obj, char *path)
+{
+  uint32_t len = sizeof(MTP_IF_VOLUME) - 1U;
+  uint32_t pos;
+  uint16_t i;
+
+  for (i = obj; i != MTP_IF_NO_OBJ; i = Obj[i].parent)
+  {
+    len += (uint32_t)Obj[i].name_len + 1U;
+  }
+
+  if (len >= MTP_IF_MAX_PATH)
+  {
+    return 0U;
+  }
+
+  path[len] = '\0';
+  pos = len;
+
+  for (i = obj; i != MTP_IF_NO_OBJ; i = Obj[i].parent)
+  {
+    pos -= Obj[i].name_len;
+    (void)memcpy(&path[pos], &ObjNames[Obj[i].name], Obj[i].name_len);
+    pos--;
+    path[pos] = '/';
+  }
+
+  (void)memcpy(path, MTP_IF_VOLUME, pos);
+
+  return len;
+}
+
+/**
+  * @brief  MTP_IF_FirstObject
+  *         Get the first object of a GetIdxRange() selection
+  * @param  sel: folder handle, MTP_IF_ROOT_OBJ or MTP_IF_ALL_OBJ
+  * @retval object index, MTP_IF_NO_OBJ if none
+  */
+static uint16_t MTP_IF_FirstObject(uint32_t sel)
+{
+  uint16_t obj;
+
+  if (sel == MTP_IF_ALL_OBJ)
+  {
+    obj = MTP_IF_NextObject(sel, MTP_IF_NO_OBJ);
+  }
+  else if (sel == MTP_IF_ROOT_OBJ)
+  {
+    obj = RootChild;
+  }
+  else
+  {
+    obj = MTP_IF_GetObject(sel);
+
+    if ((obj != MTP_IF_NO_OBJ) && ((Obj[obj].flags & MTP_IF_OBJ_FOLDER) != 0U))
+    {
+      obj = Obj[obj].child;
+    }
+    else
+    {
+      obj = MTP_IF_NO_OBJ;
+    }
+  }
+
+  return obj;
+}
+
+/**
+  * @brief  MTP_IF_NextObject
+  *         Get the next object of a GetIdxRange() selection
+  * @param  sel: folder handle, MTP_IF_ROOT_OBJ or MTP_IF_ALL_OBJ
+  * @param  obj: current object index
+  * @retval object index, MTP_IF_NO_OBJ at the end
+  */
+static uint16_t MTP_IF_NextObject(uint32_t sel, uint16_t obj)
+{
+  uint32_t i;
+
+  if (sel != MTP_IF_ALL_OBJ)
+  {
+    return Obj[obj].next;
+  }
+
+  /* all objects: index order, skipping deleted entries */
+  for (i = (obj == MTP_IF_NO_OBJ) ? 0U : ((uint32_t)obj + 1U); i < ObjCount; i++)
+  {
+    if ((Obj[i].flags & MTP_IF_OBJ_USED) != 0U)
+    {
+      return (uint16_t)i;
+    }
+  }
+
+  return MTP_IF_NO_OBJ;
+}
+
+/**
+  * @brief  MTP_IF_CloseFile
+  *         Close the object file, the index gets the size of a written file
+  * @param  None
+  * @retval None
+  */
+static void MTP_IF_CloseFile(void)
+{
+  if (FileMode == MTP_IF_FILE_WRITE)
+  {
+    Obj[FileObj].size = (uint32_t)f_size(&MTP_File);
+  }
+
+  if (FileMode != MTP_IF_FILE_CLOSED)
+  {
+    (void)f_close(&MTP_File);
+    FileMode = MTP_IF_FILE_CLOSED;
+  }
 }
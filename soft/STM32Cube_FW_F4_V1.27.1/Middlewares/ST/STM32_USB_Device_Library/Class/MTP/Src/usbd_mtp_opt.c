@@ -21,6 +21,18 @@
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* Selects all objects in GetObjectPropList and all properties */
+#define MTP_ALL_OBJ                                                 0xFFFFFFFFU
+#define MTP_ALL_PROP                                                0xFFFFFFFFU
+
+/* Size of an element header of an ObjectPropList dataset */
+#define MTP_PROP_ELEM_HDR                                           8U
+
+/* Largest ObjectPropList part of one object: an element for each
+   supported property, the two names being the only strings */
+#define MTP_PROPLIST_REC_MAX          ((SUPP_OBJ_PROP_LEN * (MTP_PROP_ELEM_HDR + 16U)) + \
+                                       (2U * ((2U * MAX_FILE_NAME) + 1U)))
+
 /* Private macro -------------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
 static uint8_t  ObjInfo_buff[255];
@@ -35,28 +47,43 @@ static MTP_ObjectHandleTypeDef   MTP_ObjectHandle;
 static MTP_ObjectInfoTypeDef     MTP_ObjectInfo;
 static MTP_ObjectPropSuppTypeDef MTP_ObjectPropSupp;
 static MTP_ObjectPropDescTypeDef MTP_ObjectPropDesc;
-static MTP_PropertiesListTypedef MTP_PropertiesList;
 static MTP_RefTypeDef            MTP_Ref;
 static MTP_PropertyValueTypedef  MTP_PropertyValue;
 static MTP_FileNameTypeDef       MTP_FileName;
 static MTP_DevicePropDescTypeDef MTP_DevicePropDesc;
 
+/* Objects of the GetObjectHandles / GetObjectPropList data phase, either a
+   GetIdxRange() selection or a single object */
+static uint32_t ObjList_parent;
+static uint32_t ObjList_handle;
+static uint32_t ObjList_len;
+static uint32_t ObjList_pos;
+
+/* GetObjectPropList: property code and the part of the dataset of the
+   current object not sent yet */
+static uint32_t PropList_code;
+static uint8_t  PropList_rec[MTP_PROPLIST_REC_MAX];
+static uint32_t PropList_rec_len;
+static uint32_t PropList_rec_ofs;
+
 /* Private function prototypes -----------------------------------------------*/
 static void MTP_Get_DeviceInfo(void);
 static void MTP_Get_StorageIDS(void);
 static void MTP_Get_PayloadContent(USBD_HandleTypeDef *pdev);
 static void MTP_Get_ObjectInfo(USBD_HandleTypeDef *pdev);
 static void MTP_Get_StorageInfo(USBD_HandleTypeDef *pdev);
-static void MTP_Get_ObjectHandle(USBD_HandleTypeDef *pdev);
 static void MTP_Get_ObjectPropSupp(void);
 static void MTP_Get_ObjectPropDesc(USBD_HandleTypeDef *pdev);
-static void MTP_Get_ObjectPropList(USBD_HandleTypeDef *pdev);
+static uint16_t MTP_Get_ObjectPropList(USBD_HandleTypeDef *pdev);
 static void MTP_Get_DevicePropDesc(void);
 static uint8_t *MTP_Get_ObjectPropValue(USBD_HandleTypeDef *pdev);
+static uint32_t MTP_Get_ListObject(USBD_HandleTypeDef *pdev, uint32_t idx);
+static uint32_t MTP_Read_ObjectHandles(USBD_HandleTypeDef *pdev, uint8_t *buff, uint32_t pos, uint32_t len);
+static uint32_t MTP_Read_ObjectPropList(USBD_HandleTypeDef *pdev, uint8_t *buff, uint32_t pos, uint32_t len);
 static uint32_t MTP_build_data_propdesc(USBD_HandleTypeDef *pdev, MTP_ObjectPropDescTypeDef def);
 static uint32_t MTP_build_data_ObjInfo(USBD_HandleTypeDef *pdev, MTP_ObjectInfoTypeDef objinfo);
-static uint32_t MTP_build_data_proplist(USBD_HandleTypeDef *pdev,
-                                        MTP_PropertiesListTypedef proplist, uint32_t idx);
+static uint32_t MTP_build_data_proplist(USBD_HandleTypeDef *pdev, uint32_t handle, uint8_t *buff);
+static uint32_t MTP_build_data_propval(USBD_HandleTypeDef *pdev, uint32_t handle, uint16_t code, uint8_t *buff);
 
 /* Private functions ---------------------------------------------------------*/
 
@@ -184,20 +211,35 @@ void USBD_MTP_OPT_GetStorageInfo(USBD_HandleTypeDef  *pdev)
 
 /**
   * @brief  USBD_MTP_OPT_GetObjectHandle
-  *         Get all object handles
+  *         Get all object handles, the array is sent by USBD_MTP_OPT_ReadData
   * @param  pdev: device instance
   * @retval None
   */
 void USBD_MTP_OPT_GetObjectHandle(USBD_HandleTypeDef  *pdev)
 {
   USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_MTP_ItfTypeDef     *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
+
   hmtp->GenericContainer.code =  MTP_OP_GET_OBJECT_HANDLES;
   hmtp->GenericContainer.trans_id = hmtp->OperationsContainer.trans_id;
   hmtp->GenericContainer.type = MTP_CONT_TYPE_DATA;
 
-  (void)MTP_Get_PayloadContent(pdev);
+  ObjList_parent = hmtp->OperationsContainer.Param3;
+  ObjList_handle = 0U;
 
-  hmtp->ResponseLength = hmtp->ResponseLength + MTP_CONT_HEADER_SIZE;
+  if (hmtpif->GetIdxRange != NULL)
+  {
+    /* handles are fetched from the interface chunk by chunk */
+    ObjList_len = hmtpif->GetIdxRange(ObjList_parent, 0U, NULL, 0U);
+  }
+  else
+  {
+    MTP_ObjectHandle.ObjectHandle_len = (uint32_t)(hmtpif->GetIdx(hmtp->OperationsContainer.Param3,
+                                                                  MTP_ObjectHandle.ObjectHandle));
+    ObjList_len = MIN(MTP_ObjectHandle.ObjectHandle_len, MAX_OBJECT_HANDLE_LEN);
+  }
+
+  hmtp->ResponseLength = (ObjList_len * sizeof(uint32_t)) + sizeof(uint32_t) + MTP_CONT_HEADER_SIZE;
   hmtp->GenericContainer.length =  hmtp->ResponseLength;
 
   hmtp->ResponseCode = MTP_RESPONSE_OK;
@@ -293,24 +335,39 @@ void USBD_MTP_OPT_GetObjectPropDesc(USBD_HandleTypeDef  *pdev)
 
 /**
   * @brief  USBD_MTP_OPT_GetObjectPropList
-  *         Get the list of object properties
+  *         Get the list of object properties, the dataset is sent by
+  *         USBD_MTP_OPT_ReadData
   * @param  pdev: device instance
   * @retval None
   */
 void USBD_MTP_OPT_GetObjectPropList(USBD_HandleTypeDef  *pdev)
 {
   USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint32_t i;
 
   hmtp->GenericContainer.code = MTP_OP_GET_OBJECT_PROPLIST;
   hmtp->GenericContainer.trans_id = hmtp->OperationsContainer.trans_id;
   hmtp->GenericContainer.type = MTP_CONT_TYPE_DATA;
 
-  (void)MTP_Get_PayloadContent(pdev);
+  hmtp->ResponseCode = MTP_Get_ObjectPropList(pdev);
 
-  hmtp->ResponseLength = hmtp->ResponseLength + MTP_CONT_HEADER_SIZE;
-  hmtp->GenericContainer.length =  hmtp->ResponseLength;
+  if (hmtp->ResponseCode == MTP_RESPONSE_OK)
+  {
+    /* The container length comes first: size the dataset without building it */
+    hmtp->ResponseLength = MTP_CONT_HEADER_SIZE + sizeof(uint32_t);
 
-  hmtp->ResponseCode = MTP_RESPONSE_OK;
+    for (i = 0U; i < ObjList_len; i++)
+    {
+      hmtp->ResponseLength += MTP_build_data_proplist(pdev, MTP_Get_ListObject(pdev, i), NULL);
+    }
+  }
+  else
+  {
+    hmtp->GenericContainer.type = MTP_CONT_TYPE_RESPONSE;
+    hmtp->ResponseLength = MTP_CONT_HEADER_SIZE;
+  }
+
+  hmtp->GenericContainer.length =  hmtp->ResponseLength;
 }
 
 /**
@@ -346,11 +403,51 @@ void USBD_MTP_OPT_GetObject(USBD_HandleTypeDef  *pdev)
   USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
   USBD_MTP_ItfTypeDef     *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
 
+  hmtp->GenericContainer.code = MTP_OP_GET_OBJECT;
   hmtp->GenericContainer.length = hmtpif->GetContainerLength(hmtp->OperationsContainer.Param1);
   hmtp->GenericContainer.trans_id = hmtp->OperationsContainer.trans_id;
   hmtp->GenericContainer.type = MTP_CONT_TYPE_DATA;
 
-  hmtp->ResponseCode = MTP_RESPONSE_OK;
+  if (hmtp->GenericContainer.length < MTP_CONT_HEADER_SIZE)
+  {
+    hmtp->GenericContainer.type = MTP_CONT_TYPE_RESPONSE;
+    hmtp->ResponseLength = MTP_CONT_HEADER_SIZE;
+    hmtp->GenericContainer.length = hmtp->ResponseLength;
+    hmtp->ResponseCode = MTP_RESPONSE_INVALID_OBJECT_HANDLE;
+  }
+  else
+  {
+    hmtp->ResponseCode = MTP_RESPONSE_OK;
+  }
+}
+
+/**
+  * @brief  USBD_MTP_OPT_ReadData
+  *         Fill the next chunk of a GetObjectHandles or GetObjectPropList
+  *         data phase
+  * @param  pdev: device instance
+  * @param  buff: chunk to fill
+  * @param  data_length: data phase progress, at most maxlen bytes are copied
+  * @retval number of bytes copied
+  */
+uint32_t USBD_MTP_OPT_ReadData(USBD_HandleTypeDef  *pdev, uint8_t *buff, MTP_DataLengthTypeDef *data_length)
+{
+  USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint32_t len;
+
+  if (hmtp->OperationsContainer.code == MTP_OP_GET_OBJECT_HANDLES)
+  {
+    len = MTP_Read_ObjectHandles(pdev, buff, data_length->temp_length, data_length->maxlen);
+  }
+  else
+  {
+    len = MTP_Read_ObjectPropList(pdev, buff, data_length->temp_length, data_length->maxlen);
+  }
+
+  data_length->readbytes = len;
+  data_length->temp_length += len;
+
+  return len;
 }
 
 /**
@@ -415,6 +512,7 @@ void USBD_MTP_OPT_SendObject(USBD_HandleTypeDef  *pdev, uint8_t *buff, uint32_t
       break;
 
     case RECEIVE_REST_OF_DATA:
+    case RECEIVE_STREAM_DATA:
       hmtpif->WriteData(len, buff);
       break;
 
@@ -573,16 +671,6 @@ static void MTP_Get_PayloadContent(USBD_HandleTypeDef *pdev)
       }
       break;
 
-    case MTP_OP_GET_OBJECT_HANDLES:
-      (void)MTP_Get_ObjectHandle(pdev);
-      (void)USBD_memcpy(buffer, (const uint8_t *)&MTP_ObjectHandle, hmtp->ResponseLength);
-
-      for (i = 0U; i < hmtp->ResponseLength; i++)
-      {
-        hmtp->GenericContainer.data[i] = buffer[i];
-      }
-      break;
-
     case MTP_OP_GET_OBJECT_INFO:
       (void)MTP_Get_ObjectInfo(pdev);
       break;
@@ -612,10 +700,6 @@ static void MTP_Get_PayloadContent(USBD_HandleTypeDef *pdev)
       }
       break;
 
-    case MTP_OP_GET_OBJECT_PROPLIST:
-      (void)MTP_Get_ObjectPropList(pdev);
-      break;
-
     case MTP_OP_GET_OBJECT_PROP_VALUE:
       buffer = MTP_Get_ObjectPropValue(pdev);
       for (i = 0U; i < hmtp->ResponseLength; i++)
@@ -757,23 +841,6 @@ static void MTP_Get_StorageInfo(USBD_HandleTypeDef  *pdev)
   MTP_StorageInfo.VolumeLabel = 0U;
 }
 
-/**
-  * @brief  MTP_Get_ObjectHandle
-  *         Fill the MTP_ObjectHandle struct
-  * @param  pdev: device instance
-  * @retval None
-  */
-static void MTP_Get_ObjectHandle(USBD_HandleTypeDef  *pdev)
-{
-  USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
-  USBD_MTP_ItfTypeDef     *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
-
-  MTP_ObjectHandle.ObjectHandle_len = (uint32_t)(hmtpif->GetIdx(hmtp->OperationsContainer.Param3,
-                                                                MTP_ObjectHandle.ObjectHandle));
-
-  hmtp->ResponseLength = (MTP_ObjectHandle.ObjectHandle_len * sizeof(uint32_t)) + sizeof(uint32_t);
-}
-
 /**
   * @brief  MTP_Get_ObjectPropSupp
   *         Fill the MTP_ObjectPropSupp struct
@@ -945,98 +1012,190 @@ static uint8_t *MTP_Get_ObjectPropValue(USBD_HandleTypeDef *pdev)
 
 /**
   * @brief  MTP_Get_ObjectPropList
-  *         Get the object property list data to be transmitted
+  *         Select the objects and properties of GetObjectPropList
   * @param  pdev: device instance
-  * @retval None
+  * @retval response code
   */
-static void MTP_Get_ObjectPropList(USBD_HandleTypeDef  *pdev)
+static uint16_t MTP_Get_ObjectPropList(USBD_HandleTypeDef  *pdev)
 {
   USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
   USBD_MTP_ItfTypeDef     *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
-  uint16_t filename[255];
-  uint32_t storageid = MTP_STORAGE_ID;
-  uint32_t default_val = 0U;
+  uint32_t handle = hmtp->OperationsContainer.Param1;
+  uint32_t depth = hmtp->OperationsContainer.Param5;
   uint32_t i;
-  uint16_t format;
-  uint64_t objsize;
-  uint32_t parent_proval;
 
-  MTP_PropertiesList.MTP_Properties_len = SUPP_OBJ_PROP_LEN;
-  hmtp->ResponseLength = 4U;    /* size of MTP_PropertiesList.MTP_Properties_len */
-  (void)USBD_memcpy(hmtp->GenericContainer.data,
-                    (const uint8_t *)&MTP_PropertiesList.MTP_Properties_len, hmtp->ResponseLength);
-
-  for (i = 0U; i < SUPP_OBJ_PROP_LEN; i++)
+  /* Param3 == 0: properties selected by the group code in Param4 */
+  PropList_code = hmtp->OperationsContainer.Param3;
+  if (PropList_code == 0U)
   {
-    MTP_PropertiesList.MTP_Properties[i].ObjectHandle = hmtp->OperationsContainer.Param1;
+    return MTP_RESPONSE_SPECIFICATION_BY_GROUP_UNSUPPORTED;
+  }
 
-    switch (ObjectPropSupp[i])
+  if (PropList_code != MTP_ALL_PROP)
+  {
+    for (i = 0U; i < SUPP_OBJ_PROP_LEN; i++)
     {
-      case MTP_OB_PROP_STORAGE_ID :
-        MTP_PropertiesList.MTP_Properties[i].PropertyCode = MTP_OB_PROP_STORAGE_ID;
-        MTP_PropertiesList.MTP_Properties[i].Datatype = MTP_DATATYPE_UINT32;
-        MTP_PropertiesList.MTP_Properties[i].propval = (uint8_t *)&storageid;
+      if (ObjectPropSupp[i] == PropList_code)
+      {
         break;
+      }
+    }
 
-      case MTP_OB_PROP_OBJECT_FORMAT :
-        MTP_PropertiesList.MTP_Properties[i].PropertyCode = MTP_OB_PROP_OBJECT_FORMAT;
-        MTP_PropertiesList.MTP_Properties[i].Datatype = MTP_DATATYPE_UINT16;
-        format = hmtpif->GetObjectFormat(hmtp->OperationsContainer.Param1);
-        MTP_PropertiesList.MTP_Properties[i].propval = (uint8_t *)&format;
-        break;
+    if (i == SUPP_OBJ_PROP_LEN)
+    {
+      return MTP_RESPONSE_INVALID_OBJECT_PROP_CODE;
+    }
+  }
 
-      case MTP_OB_PROP_OBJ_FILE_NAME:
-        MTP_PropertiesList.MTP_Properties[i].PropertyCode = MTP_OB_PROP_OBJ_FILE_NAME;
-        MTP_PropertiesList.MTP_Properties[i].Datatype = MTP_DATATYPE_STR;
-        /* MTP_FileName.FileName_len value shall be set before USBD_MTP_FS_GetObjectName */
-        MTP_FileName.FileName_len = hmtpif->GetObjectName_len(hmtp->OperationsContainer.Param1);
-        hmtpif->GetObjectName(hmtp->OperationsContainer.Param1, MTP_FileName.FileName_len, filename);
-        (void)USBD_memcpy(MTP_FileName.FileName, filename, ((uint32_t)MTP_FileName.FileName_len * 2U) + 1U);
-        MTP_PropertiesList.MTP_Properties[i].propval = (uint8_t *)&MTP_FileName;
-        break;
+  ObjList_handle = 0U;
 
-      case MTP_OB_PROP_PARENT_OBJECT :
-        MTP_PropertiesList.MTP_Properties[i].PropertyCode = MTP_OB_PROP_PARENT_OBJECT;
-        MTP_PropertiesList.MTP_Properties[i].Datatype = MTP_DATATYPE_UINT32;
-        parent_proval = hmtpif->GetParentObject(hmtp->OperationsContainer.Param1);
-        MTP_PropertiesList.MTP_Properties[i].propval = (uint8_t *)&parent_proval;
-        break;
+  if (handle == MTP_ALL_OBJ)
+  {
+    ObjList_parent = 0U;           /* all objects of the storage */
+  }
+  else if (depth == 0U)
+  {
+    if (handle == 0U)
+    {
+      return MTP_RESPONSE_INVALID_OBJECT_HANDLE;
+    }
 
-      case MTP_OB_PROP_OBJECT_SIZE :
-        MTP_PropertiesList.MTP_Properties[i].PropertyCode = MTP_OB_PROP_OBJECT_SIZE;
-        MTP_PropertiesList.MTP_Properties[i].Datatype = MTP_DATATYPE_UINT64;
-        objsize = hmtpif->GetObjectSize(hmtp->OperationsContainer.Param1);
-        MTP_PropertiesList.MTP_Properties[i].propval = (uint8_t *)&objsize;
-        break;
+    ObjList_handle = handle;
+    ObjList_len = 1U;
 
-      case MTP_OB_PROP_NAME :
-        MTP_PropertiesList.MTP_Properties[i].PropertyCode = MTP_OB_PROP_NAME;
-        MTP_PropertiesList.MTP_Properties[i].Datatype = MTP_DATATYPE_STR;
-        /* MTP_FileName.FileName_len value shall be set before USBD_MTP_FS_GetObjectName */
-        MTP_FileName.FileName_len = hmtpif->GetObjectName_len(hmtp->OperationsContainer.Param1);
-        hmtpif->GetObjectName(hmtp->OperationsContainer.Param1, MTP_FileName.FileName_len, filename);
-        (void)USBD_memcpy(MTP_FileName.FileName, filename, ((uint32_t)MTP_FileName.FileName_len * 2U) + 1U);
-        MTP_PropertiesList.MTP_Properties[i].propval = (uint8_t *)&MTP_FileName;
-        break;
+    return MTP_RESPONSE_OK;
+  }
+  else if (depth == 1U)
+  {
+    /* children of the object, 0 is the root folder */
+    ObjList_parent = (handle == 0U) ? 0xFFFFFFFFU : handle;
+  }
+  else
+  {
+    return MTP_RESPONSE_SPECIFICATION_BY_DEPTH_UNSUPPORTED;
+  }
 
-      case MTP_OB_PROP_PERS_UNIQ_OBJ_IDEN :
-        MTP_PropertiesList.MTP_Properties[i].PropertyCode = MTP_OB_PROP_PERS_UNIQ_OBJ_IDEN;
-        MTP_PropertiesList.MTP_Properties[i].Datatype = MTP_DATATYPE_UINT128;
-        MTP_PropertiesList.MTP_Properties[i].propval = (uint8_t *)&hmtp->OperationsContainer.Param1;
-        break;
+  if (hmtpif->GetIdxRange == NULL)
+  {
+    return MTP_RESPONSE_SPECIFICATION_BY_DEPTH_UNSUPPORTED;
+  }
 
-      case MTP_OB_PROP_PROTECTION_STATUS :
-        MTP_PropertiesList.MTP_Properties[i].PropertyCode = MTP_OB_PROP_PROTECTION_STATUS;
-        MTP_PropertiesList.MTP_Properties[i].Datatype = MTP_DATATYPE_UINT16;
-        MTP_PropertiesList.MTP_Properties[i].propval = (uint8_t *)&default_val;
-        break;
+  ObjList_len = hmtpif->GetIdxRange(ObjList_parent, 0U, NULL, 0U);
+
+  return MTP_RESPONSE_OK;
+}
+
+/**
+  * @brief  MTP_Get_ListObject
+  *         Get an object of the current GetObjectHandles/GetObjectPropList list
+  * @param  pdev: device instance
+  * @param  idx: object position in the list
+  * @retval object handle
+  */
+static uint32_t MTP_Get_ListObject(USBD_HandleTypeDef  *pdev, uint32_t idx)
+{
+  USBD_MTP_ItfTypeDef *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
+  uint32_t handle = 0U;
+
+  if (ObjList_handle != 0U)
+  {
+    handle = ObjList_handle;
+  }
+  else
+  {
+    (void)hmtpif->GetIdxRange(ObjList_parent, idx, &handle, 1U);
+  }
+
+  return handle;
+}
+
+/**
+  * @brief  MTP_Read_ObjectHandles
+  *         Copy a part of the ObjectHandle array
+  * @param  pdev: device instance
+  * @param  buff: destination, 32-bit aligned
+  * @param  pos: offset of the part in the array
+  * @param  len: size of the part
+  * @retval number of bytes copied
+  */
+static uint32_t MTP_Read_ObjectHandles(USBD_HandleTypeDef  *pdev, uint8_t *buff, uint32_t pos, uint32_t len)
+{
+  USBD_MTP_ItfTypeDef *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
+  uint32_t count = 0U;
+  uint32_t first;
+  uint32_t nbr;
+
+  if (pos == 0U)
+  {
+    (void)USBD_memcpy(buff, (const uint8_t *)&ObjList_len, sizeof(uint32_t));
+    count = sizeof(uint32_t);
+  }
 
-      default:
+  first = ((pos + count) / sizeof(uint32_t)) - 1U;
+  nbr = MIN((len - count) / sizeof(uint32_t), ObjList_len - first);
+
+  if (hmtpif->GetIdxRange != NULL)
+  {
+    /* the interface writes the handles in place */
+    (void)hmtpif->GetIdxRange(ObjList_parent, first, (uint32_t *)(void *)(buff + count), nbr);
+  }
+  else
+  {
+    (void)USBD_memcpy(buff + count, (const uint8_t *)&MTP_ObjectHandle.ObjectHandle[first],
+                      nbr * sizeof(uint32_t));
+  }
+
+  return count + (nbr * sizeof(uint32_t));
+}
+
+/**
+  * @brief  MTP_Read_ObjectPropList
+  *         Copy a part of the ObjectPropList dataset, the elements of one
+  *         object are built at a time
+  * @param  pdev: device instance
+  * @param  buff: destination
+  * @param  pos: offset of the part in the dataset
+  * @param  len: size of the part
+  * @retval number of bytes copied
+  */
+static uint32_t MTP_Read_ObjectPropList(USBD_HandleTypeDef  *pdev, uint8_t *buff, uint32_t pos, uint32_t len)
+{
+  uint32_t count = 0U;
+  uint32_t elements;
+  uint32_t n;
+
+  if (pos == 0U)
+  {
+    elements = (PropList_code == MTP_ALL_PROP) ? (ObjList_len * SUPP_OBJ_PROP_LEN) : ObjList_len;
+    (void)USBD_memcpy(buff, (const uint8_t *)&elements, sizeof(uint32_t));
+    count = sizeof(uint32_t);
+
+    ObjList_pos = 0U;
+    PropList_rec_len = 0U;
+    PropList_rec_ofs = 0U;
+  }
+
+  while (count < len)
+  {
+    if (PropList_rec_ofs == PropList_rec_len)
+    {
+      if (ObjList_pos >= ObjList_len)
+      {
         break;
+      }
+
+      PropList_rec_len = MTP_build_data_proplist(pdev, MTP_Get_ListObject(pdev, ObjList_pos), PropList_rec);
+      PropList_rec_ofs = 0U;
+      ObjList_pos++;
     }
 
-    hmtp->ResponseLength = MTP_build_data_proplist(pdev, MTP_PropertiesList, i);
+    n = MIN(len - count, PropList_rec_len - PropList_rec_ofs);
+    (void)USBD_memcpy(buff + count, PropList_rec + PropList_rec_ofs, n);
+    count += n;
+    PropList_rec_ofs += n;
   }
+
+  return count;
 }
 
 /**
@@ -1099,7 +1258,7 @@ static void MTP_Get_ObjectInfo(USBD_HandleTypeDef  *pdev)
   /* we have to get this value before MTP_ObjectInfo.Filename */
   MTP_ObjectInfo.Filename_len = hmtpif->GetObjectName_len(hmtp->OperationsContainer.Param1);
   hmtpif->GetObjectName(hmtp->OperationsContainer.Param1, MTP_ObjectInfo.Filename_len, filename);
-  (void)USBD_memcpy(MTP_ObjectInfo.Filename, filename, ((uint32_t)MTP_FileName.FileName_len * 2U) + 1U);
+  (void)USBD_memcpy(MTP_ObjectInfo.Filename, filename, (uint32_t)MTP_ObjectInfo.Filename_len * 2U);
 
   MTP_ObjectInfo.CaptureDate = 0U;
   MTP_ObjectInfo.ModificationDate = 0U;
@@ -1179,66 +1338,125 @@ static uint32_t MTP_build_data_propdesc(USBD_HandleTypeDef  *pdev, MTP_ObjectPro
 
 /**
   * @brief  MTP_build_data_proplist
-  *         Copy the MTP_PropertiesList dataset to the payload data
+  *         Build the ObjectPropList elements of an object
   * @param  pdev: device instance
-  * @retval None
+  * @param  handle: object handle
+  * @param  buff: destination, NULL to get the size only
+  * @retval size of the elements
   */
-static uint32_t MTP_build_data_proplist(USBD_HandleTypeDef  *pdev,
-                                        MTP_PropertiesListTypedef proplist, uint32_t idx)
+static uint32_t MTP_build_data_proplist(USBD_HandleTypeDef  *pdev, uint32_t handle, uint8_t *buff)
 {
-  USBD_MTP_HandleTypeDef *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
-  uint8_t propval_size = (MTP_FileName.FileName_len * 2U) + 1U;
-  uint32_t dataLength;
+  uint32_t dataLength = 0U;
+  uint32_t i;
 
-  dataLength = offsetof(MTP_PropertiesTypedef, propval);
+  for (i = 0U; i < SUPP_OBJ_PROP_LEN; i++)
+  {
+    if ((PropList_code == MTP_ALL_PROP) || (PropList_code == ObjectPropSupp[i]))
+    {
+      dataLength += MTP_build_data_propval(pdev, handle, ObjectPropSupp[i],
+                                           (buff != NULL) ? (buff + dataLength) : NULL);
+    }
+  }
 
-  (void)USBD_memcpy(hmtp->GenericContainer.data + hmtp->ResponseLength,
-                    (const uint8_t *)&proplist.MTP_Properties[idx], dataLength);
+  return dataLength;
+}
+
+/**
+  * @brief  MTP_build_data_propval
+  *         Build one ObjectPropList element
+  * @param  pdev: device instance
+  * @param  handle: object handle
+  * @param  code: object property code
+  * @param  buff: destination, NULL to get the size only
+  * @retval size of the element
+  */
+static uint32_t MTP_build_data_propval(USBD_HandleTypeDef  *pdev, uint32_t handle, uint16_t code, uint8_t *buff)
+{
+  USBD_MTP_ItfTypeDef *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
+  MTP_PropertiesTypedef prop;
+  uint16_t filename[MAX_FILE_NAME];
+  uint32_t value[4] = {0U, 0U, 0U, 0U};
+  uint64_t objsize;
+  uint32_t size = 0U;
+  uint8_t name_len;
 
-  dataLength += hmtp->ResponseLength;
+  prop.ObjectHandle = handle;
+  prop.PropertyCode = code;
+  prop.Datatype = MTP_DATATYPE_UINT32;
 
-  switch (proplist.MTP_Properties[idx].Datatype)
+  switch (code)
   {
-    case MTP_DATATYPE_UINT16:
-      (void)USBD_memcpy(hmtp->GenericContainer.data + dataLength,
-                        proplist.MTP_Properties[idx].propval, sizeof(uint16_t));
-
-      dataLength += sizeof(uint16_t);
+    case MTP_OB_PROP_STORAGE_ID :
+      value[0] = MTP_STORAGE_ID;
+      size = sizeof(uint32_t);
       break;
 
-    case MTP_DATATYPE_UINT32:
-      (void)USBD_memcpy(hmtp->GenericContainer.data + dataLength,
-                        proplist.MTP_Properties[idx].propval, sizeof(uint32_t));
-
-      dataLength += sizeof(uint32_t);
+    case MTP_OB_PROP_OBJECT_FORMAT :
+      prop.Datatype = MTP_DATATYPE_UINT16;
+      size = sizeof(uint16_t);
+      if (buff != NULL)
+      {
+        value[0] = hmtpif->GetObjectFormat(handle);
+      }
       break;
 
-    case MTP_DATATYPE_STR:
-      (void)USBD_memcpy(hmtp->GenericContainer.data + dataLength,
-                        proplist.MTP_Properties[idx].propval, propval_size);
-
-      dataLength += propval_size;
+    case MTP_OB_PROP_OBJ_FILE_NAME :
+    case MTP_OB_PROP_NAME :
+      prop.Datatype = MTP_DATATYPE_STR;
+      name_len = hmtpif->GetObjectName_len(handle);
+      size = ((uint32_t)name_len * 2U) + 1U;
+      if (buff != NULL)
+      {
+        hmtpif->GetObjectName(handle, name_len, filename);
+        buff[MTP_PROP_ELEM_HDR] = name_len;
+        (void)USBD_memcpy(buff + MTP_PROP_ELEM_HDR + 1U, filename, (uint32_t)name_len * 2U);
+      }
       break;
 
-    case MTP_DATATYPE_UINT64:
-      (void)USBD_memcpy(hmtp->GenericContainer.data + dataLength,
-                        proplist.MTP_Properties[idx].propval, sizeof(uint64_t));
+    case MTP_OB_PROP_PARENT_OBJECT :
+      size = sizeof(uint32_t);
+      if (buff != NULL)
+      {
+        value[0] = hmtpif->GetParentObject(handle);
+      }
+      break;
 
-      dataLength += sizeof(uint64_t);
+    case MTP_OB_PROP_OBJECT_SIZE :
+      prop.Datatype = MTP_DATATYPE_UINT64;
+      size = sizeof(uint64_t);
+      if (buff != NULL)
+      {
+        objsize = hmtpif->GetObjectSize(handle);
+        (void)USBD_memcpy(value, &objsize, sizeof(uint64_t));
+      }
       break;
 
-    case MTP_DATATYPE_UINT128:
-      (void)USBD_memcpy(hmtp->GenericContainer.data + dataLength,
-                        proplist.MTP_Properties[idx].propval, (sizeof(uint64_t) * 2U));
+    case MTP_OB_PROP_PERS_UNIQ_OBJ_IDEN :
+      prop.Datatype = MTP_DATATYPE_UINT128;
+      value[0] = handle;
+      size = sizeof(value);
+      break;
 
-      dataLength += (sizeof(uint64_t) * 2U);
+    case MTP_OB_PROP_PROTECTION_STATUS :
+      prop.Datatype = MTP_DATATYPE_UINT16;
+      size = sizeof(uint16_t);
       break;
 
     default:
       break;
   }
 
-  return dataLength;
+  if (buff != NULL)
+  {
+    (void)USBD_memcpy(buff, (const uint8_t *)&prop, MTP_PROP_ELEM_HDR);
+
+    if (prop.Datatype != MTP_DATATYPE_STR)
+    {
+      (void)USBD_memcpy(buff + MTP_PROP_ELEM_HDR, (const uint8_t *)value, size);
+    }
+  }
+
+  return MTP_PROP_ELEM_HDR + size;
 }
 
 /**
@@ -21,6 +21,9 @@
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
+/* Largest streamed transfer, WriteData() takes a 16-bit length */
+#define MTP_STORAGE_MAX_CHUNK                                       0x8000U
+
 /* Private macro -------------------------------------------------------------*/
 extern uint8_t MTPInEpAdd;
 extern uint8_t MTPOutEpAdd;
@@ -29,10 +32,25 @@ extern uint8_t MTPOutEpAdd;
 static MTP_DataLengthTypeDef MTP_DataLength;
 static MTP_READ_DATA_STATUS ReadDataStatus;
 
+/* Object data is streamed through the two halves of the interface scratch
+   buffer: one half is on the bus while the other is read or written */
+static uint32_t ChunkSize;
+static uint32_t ChunkLength;
+static uint8_t  ChunkIdx;
+
+/* Data of the last OUT transfer */
+static uint8_t *MTP_RxData;
+
 /* Private function prototypes -----------------------------------------------*/
 static uint8_t USBD_MTP_STORAGE_DecodeOperations(USBD_HandleTypeDef  *pdev);
 static uint8_t USBD_MTP_STORAGE_ReceiveContainer(USBD_HandleTypeDef  *pdev, uint32_t *pDst, uint32_t len);
 static uint8_t USBD_MTP_STORAGE_SendData(USBD_HandleTypeDef  *pdev, uint8_t *buf, uint32_t len);
+static uint32_t USBD_MTP_STORAGE_GetChunkSize(USBD_HandleTypeDef  *pdev);
+static uint8_t *USBD_MTP_STORAGE_GetChunk(USBD_HandleTypeDef  *pdev, uint8_t idx);
+static void USBD_MTP_STORAGE_ReadChunk(USBD_HandleTypeDef  *pdev, uint8_t *buf);
+static void USBD_MTP_STORAGE_ReadNext(USBD_HandleTypeDef  *pdev);
+static uint8_t USBD_MTP_STORAGE_ReceiveNext(USBD_HandleTypeDef  *pdev);
+static void USBD_MTP_STORAGE_ReceiveDone(USBD_HandleTypeDef  *pdev);
 
 /* Private functions ---------------------------------------------------------*/
 /**
@@ -56,6 +74,8 @@ uint8_t USBD_MTP_STORAGE_Init(USBD_HandleTypeDef  *pdev)
   /* Initialize the HW layyer of the file system */
   (void)((USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId])->Init();
 
+  MTP_RxData = (uint8_t *)hmtp->rx_buff;
+
   /* Prepare EP to Receive First Operation */
   (void)USBD_LL_PrepareReceive(pdev, MTPOutEpAdd, (uint8_t *)&hmtp->rx_buff,
                                hmtp->MaxPcktLen);
@@ -94,66 +114,48 @@ uint8_t USBD_MTP_STORAGE_DeInit(USBD_HandleTypeDef  *pdev)
 uint8_t USBD_MTP_STORAGE_ReadData(USBD_HandleTypeDef  *pdev)
 {
   USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
-  uint32_t *data_buff;
-
-  /* Get the data buffer pointer from the low layer interface */
-  data_buff = ((USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId])->ScratchBuff;
+  uint8_t *data_buff;
 
   switch (ReadDataStatus)
   {
     case READ_FIRST_DATA:
+      ChunkSize = USBD_MTP_STORAGE_GetChunkSize(pdev);
+      ChunkIdx = 0U;
+      data_buff = USBD_MTP_STORAGE_GetChunk(pdev, ChunkIdx);
+
       /* Reset the data length */
       MTP_DataLength.temp_length = 0U;
+      MTP_DataLength.totallen = hmtp->GenericContainer.length - MTP_CONT_HEADER_SIZE;
 
-      /* Perform the low layer read operation on the scratch buffer */
-      (void)((USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId])->ReadData(hmtp->OperationsContainer.Param1,
-                                                                              (uint8_t *)data_buff, &MTP_DataLength);
+      /* The container header and the first data go out in the same transfer */
+      MTP_DataLength.maxlen = ChunkSize - MTP_CONT_HEADER_SIZE;
+      USBD_MTP_STORAGE_ReadChunk(pdev, data_buff + MTP_CONT_HEADER_SIZE);
 
       /* Add the container header to the data buffer */
-      (void)USBD_memcpy((uint8_t *)data_buff, (uint8_t *)&hmtp->GenericContainer, MTP_CONT_HEADER_SIZE);
+      (void)USBD_memcpy(data_buff, (uint8_t *)&hmtp->GenericContainer, MTP_CONT_HEADER_SIZE);
+      ChunkLength = MTP_DataLength.readbytes + MTP_CONT_HEADER_SIZE;
 
       /* Start USB data transmission to the host */
-      (void)USBD_MTP_STORAGE_SendData(pdev, (uint8_t *)data_buff,
-                                      MTP_DataLength.readbytes + MTP_CONT_HEADER_SIZE);
+      (void)USBD_MTP_STORAGE_SendData(pdev, data_buff, ChunkLength);
 
-      /* Check if this will be the last packet to send ? */
-      if (MTP_DataLength.readbytes < ((uint32_t)hmtp->MaxPcktLen - MTP_CONT_HEADER_SIZE))
-      {
-        /* Move to response phase */
-        hmtp->MTP_ResponsePhase = MTP_RESPONSE_PHASE;
-      }
-      else
-      {
-        /* Continue to the next packets sending */
-        ReadDataStatus = READ_REST_OF_DATA;
-      }
+      /* Read the next chunk while this one is sent */
+      USBD_MTP_STORAGE_ReadNext(pdev);
       break;
 
     case READ_REST_OF_DATA:
-      /* Perform the low layer read operation on the scratch buffer */
-      (void)((USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId])->ReadData(hmtp->OperationsContainer.Param1,
-                                                                              (uint8_t *)data_buff, &MTP_DataLength);
+      /* This chunk was read while the previous one was on the bus */
+      (void)USBD_MTP_STORAGE_SendData(pdev, USBD_MTP_STORAGE_GetChunk(pdev, ChunkIdx), ChunkLength);
 
-      /* Check if more data need to be sent */
-      if (MTP_DataLength.temp_length == MTP_DataLength.totallen)
-      {
-        /* Start USB data transmission to the host */
-        (void)USBD_MTP_STORAGE_SendData(pdev, (uint8_t *)data_buff, MTP_DataLength.readbytes);
-
-        /* Move to response phase */
-        hmtp->MTP_ResponsePhase = MTP_RESPONSE_PHASE;
+      USBD_MTP_STORAGE_ReadNext(pdev);
+      break;
 
-        /* Reset the stat machine */
-        ReadDataStatus = READ_FIRST_DATA;
-      }
-      else
-      {
-        /* Start USB data transmission to the host */
-        (void)USBD_MTP_STORAGE_SendData(pdev, (uint8_t *)data_buff, MTP_DataLength.readbytes);
+    case READ_SEND_ZLP:
+      /* The data phase ended on a packet boundary */
+      (void)USBD_MTP_STORAGE_SendData(pdev, NULL, 0U);
 
-        /* Keep the state machine into sending next packet of data */
-        ReadDataStatus = READ_REST_OF_DATA;
-      }
+      /* Move to response phase */
+      hmtp->MTP_ResponsePhase = MTP_RESPONSE_PHASE;
+      ReadDataStatus = READ_FIRST_DATA;
       break;
 
     default:
@@ -212,6 +214,7 @@ uint8_t USBD_MTP_STORAGE_ReceiveOpt(USBD_HandleTypeDef  *pdev)
   switch (hmtp->RECEIVE_DATA_STATUS)
   {
     case RECEIVE_REST_OF_DATA:
+    case RECEIVE_STREAM_DATA:
       /* we don't need to do anything here because we receive only data without operation header*/
       break;
 
@@ -224,12 +227,16 @@ uint8_t USBD_MTP_STORAGE_ReceiveOpt(USBD_HandleTypeDef  *pdev)
       break;
 
     default:
-      /* Expected Data Length Packet Received */
-      pMsgBuffer = (uint32_t *) &hmtp->OperationsContainer;
+      /* A zero length packet closing the previous data phase carries no operation */
+      if (MTP_DataLength.rx_length != 0U)
+      {
+        /* Expected Data Length Packet Received */
+        pMsgBuffer = (uint32_t *) &hmtp->OperationsContainer;
 
-      /* Fill hmtp->OperationsContainer Data Buffer from USB Buffer */
-      (void)USBD_MTP_STORAGE_ReceiveContainer(pdev, pMsgBuffer, MTP_DataLength.rx_length);
-      (void)USBD_MTP_STORAGE_DecodeOperations(pdev);
+        /* Fill hmtp->OperationsContainer Data Buffer from USB Buffer */
+        (void)USBD_MTP_STORAGE_ReceiveContainer(pdev, pMsgBuffer, MTP_DataLength.rx_length);
+        (void)USBD_MTP_STORAGE_DecodeOperations(pdev);
+      }
       break;
 
   }
@@ -246,6 +253,8 @@ uint8_t USBD_MTP_STORAGE_ReceiveOpt(USBD_HandleTypeDef  *pdev)
 uint8_t USBD_MTP_STORAGE_ReceiveData(USBD_HandleTypeDef  *pdev)
 {
   USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  uint8_t armed;
+
   switch (hmtp->RECEIVE_DATA_STATUS)
   {
     case RECEIVE_COMMAND_DATA :
@@ -264,15 +273,34 @@ uint8_t USBD_MTP_STORAGE_ReceiveData(USBD_HandleTypeDef  *pdev)
         MTP_DataLength.totallen = hmtp->OperationsContainer.length;
         MTP_DataLength.temp_length = MTP_DataLength.rx_length;
         MTP_DataLength.rx_length = MTP_DataLength.temp_length - MTP_CONT_HEADER_SIZE;
+        MTP_RxData = (uint8_t *)hmtp->rx_buff;
         (void)USBD_MTP_STORAGE_DecodeOperations(pdev);
 
         if (MTP_DataLength.temp_length < hmtp->MaxPcktLen) /* we received all data, we don't need to go to next state */
         {
-          hmtp->RECEIVE_DATA_STATUS = SEND_RESPONSE;
-          (void)USBD_MTP_STORAGE_DecodeOperations(pdev);
-
-          /* send response header after receiving all data successfully */
-          (void)USBD_MTP_STORAGE_SendContainer(pdev, DATA_TYPE);
+          USBD_MTP_STORAGE_ReceiveDone(pdev);
+        }
+        else if (hmtp->OperationsContainer.code == MTP_OP_SEND_OBJECT)
+        {
+          /* Receive the rest of the object in multi-packet transfers */
+          ChunkSize = USBD_MTP_STORAGE_GetChunkSize(pdev);
+          ChunkIdx = 1U;
+
+          if (ChunkSize != 0U)
+          {
+            if (USBD_MTP_STORAGE_ReceiveNext(pdev) != 0U)
+            {
+              hmtp->RECEIVE_DATA_STATUS = RECEIVE_STREAM_DATA;
+            }
+            else
+            {
+              USBD_MTP_STORAGE_ReceiveDone(pdev);
+            }
+          }
+        }
+        else
+        {
+          /* packet by packet reception */
         }
       }
 
@@ -280,16 +308,33 @@ uint8_t USBD_MTP_STORAGE_ReceiveData(USBD_HandleTypeDef  *pdev)
 
     case RECEIVE_REST_OF_DATA :
       MTP_DataLength.prv_len = MTP_DataLength.temp_length - MTP_CONT_HEADER_SIZE;
+      MTP_RxData = (uint8_t *)hmtp->rx_buff;
       (void)USBD_MTP_STORAGE_DecodeOperations(pdev);
       MTP_DataLength.temp_length = MTP_DataLength.temp_length + MTP_DataLength.rx_length;
 
       if (MTP_DataLength.temp_length == MTP_DataLength.totallen) /* we received all data*/
       {
-        hmtp->RECEIVE_DATA_STATUS = SEND_RESPONSE;
-        (void)USBD_MTP_STORAGE_DecodeOperations(pdev);
+        USBD_MTP_STORAGE_ReceiveDone(pdev);
+      }
+      break;
+
+    case RECEIVE_STREAM_DATA :
+      MTP_RxData = USBD_MTP_STORAGE_GetChunk(pdev, ChunkIdx);
+      MTP_DataLength.temp_length = MTP_DataLength.temp_length + MTP_DataLength.rx_length;
 
-        /* send response header after receiving all data successfully  */
-        (void)USBD_MTP_STORAGE_SendContainer(pdev, DATA_TYPE);
+      if (MTP_DataLength.rx_length < ChunkLength)
+      {
+        /* short transfer, the host ended the data phase */
+        MTP_DataLength.totallen = MTP_DataLength.temp_length;
+      }
+
+      /* Get the next chunk on its way before writing this one */
+      armed = USBD_MTP_STORAGE_ReceiveNext(pdev);
+      (void)USBD_MTP_STORAGE_DecodeOperations(pdev);
+
+      if (armed == 0U) /* we received all data*/
+      {
+        USBD_MTP_STORAGE_ReceiveDone(pdev);
       }
       break;
 
@@ -300,7 +345,6 @@ uint8_t USBD_MTP_STORAGE_ReceiveData(USBD_HandleTypeDef  *pdev)
   return (uint8_t)USBD_OK;
 }
 
-
 /**
   * @brief  USBD_MTP_STORAGE_DecodeOperations
   *         Parse the operations and Process operations
@@ -334,7 +378,7 @@ static uint8_t USBD_MTP_STORAGE_DecodeOperations(USBD_HandleTypeDef  *pdev)
 
     case MTP_OP_GET_OBJECT_HANDLES:
       USBD_MTP_OPT_GetObjectHandle(pdev);
-      hmtp->MTP_ResponsePhase = MTP_RESPONSE_PHASE;
+      hmtp->MTP_ResponsePhase = MTP_READ_DATA;
       break;
 
     case MTP_OP_GET_OBJECT_INFO:
@@ -359,7 +403,14 @@ static uint8_t USBD_MTP_STORAGE_DecodeOperations(USBD_HandleTypeDef  *pdev)
 
     case MTP_OP_GET_OBJECT_PROPLIST:
       USBD_MTP_OPT_GetObjectPropList(pdev);
-      hmtp->MTP_ResponsePhase = MTP_RESPONSE_PHASE;
+      if (hmtp->ResponseCode == MTP_RESPONSE_OK)
+      {
+        hmtp->MTP_ResponsePhase = MTP_READ_DATA;
+      }
+      else
+      {
+        hmtp->MTP_ResponsePhase = MTP_RESPONSE_PHASE;
+      }
       break;
 
     case MTP_OP_GET_OBJECT_PROP_VALUE:
@@ -374,7 +425,14 @@ static uint8_t USBD_MTP_STORAGE_DecodeOperations(USBD_HandleTypeDef  *pdev)
 
     case MTP_OP_GET_OBJECT:
       USBD_MTP_OPT_GetObject(pdev);
-      hmtp->MTP_ResponsePhase = MTP_READ_DATA;
+      if (hmtp->ResponseCode == MTP_RESPONSE_OK)
+      {
+        hmtp->MTP_ResponsePhase = MTP_READ_DATA;
+      }
+      else
+      {
+        hmtp->MTP_ResponsePhase = MTP_RESPONSE_PHASE;
+      }
       break;
 
     case MTP_OP_SEND_OBJECT_INFO:
@@ -383,7 +441,7 @@ static uint8_t USBD_MTP_STORAGE_DecodeOperations(USBD_HandleTypeDef  *pdev)
       break;
 
     case MTP_OP_SEND_OBJECT:
-      USBD_MTP_OPT_SendObject(pdev, (uint8_t *)(hmtp->rx_buff), MTP_DataLength.rx_length);
+      USBD_MTP_OPT_SendObject(pdev, MTP_RxData, MTP_DataLength.rx_length);
       hmtp->MTP_ResponsePhase = MTP_RECEIVE_DATA;
       break;
 
@@ -413,10 +471,19 @@ static uint8_t USBD_MTP_STORAGE_ReceiveContainer(USBD_HandleTypeDef  *pdev,
   USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
   uint32_t Counter;
   uint32_t *pdst = pDst;
+  uint32_t nwords = (len + 3U) / 4U;
 
-  for (Counter = 0; Counter < len; Counter++)
+  /* len is in bytes, parameters missing from the container read as 0 */
+  for (Counter = 0U; Counter < (sizeof(MTP_OperationsTypeDef) / 4U); Counter++)
   {
-    *pdst = (hmtp->rx_buff[Counter]);
+    if (Counter < nwords)
+    {
+      *pdst = (hmtp->rx_buff[Counter]);
+    }
+    else
+    {
+      *pdst = 0U;
+    }
     pdst++;
   }
   return (uint8_t)USBD_OK;
@@ -437,6 +504,7 @@ void USBD_MTP_STORAGE_Cancel(USBD_HandleTypeDef  *pdev,
   hmtp->MTP_ResponsePhase = MTP_PHASE_IDLE;
   ReadDataStatus = READ_FIRST_DATA;
   hmtp->RECEIVE_DATA_STATUS = RECEIVE_IDLE_STATE;
+  MTP_RxData = (uint8_t *)hmtp->rx_buff;
 
   if (MTP_ResponsePhase == MTP_RECEIVE_DATA)
   {
@@ -470,3 +538,157 @@ static uint8_t USBD_MTP_STORAGE_SendData(USBD_HandleTypeDef  *pdev, uint8_t *buf
 
   return (uint8_t)USBD_OK;
 }
+
+/**
+  * @brief  USBD_MTP_STORAGE_GetChunkSize
+  *         Size of one half of the scratch buffer, in whole packets
+  * @param  pdev: device instance
+  * @retval chunk size, 0 if the scratch buffer is smaller than two packets
+  */
+static uint32_t USBD_MTP_STORAGE_GetChunkSize(USBD_HandleTypeDef  *pdev)
+{
+  USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_MTP_ItfTypeDef     *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
+  uint32_t size = MIN(hmtpif->ScratchBuffSze / 2U, MTP_STORAGE_MAX_CHUNK);
+
+  /* A short packet would end the data phase */
+  return size - (size % hmtp->MaxPcktLen);
+}
+
+/**
+  * @brief  USBD_MTP_STORAGE_GetChunk
+  *         Get one half of the scratch buffer
+  * @param  pdev: device instance
+  * @param  idx: half index, 0 or 1
+  * @retval pointer to the chunk
+  */
+static uint8_t *USBD_MTP_STORAGE_GetChunk(USBD_HandleTypeDef  *pdev, uint8_t idx)
+{
+  USBD_MTP_ItfTypeDef *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
+
+  return (uint8_t *)hmtpif->ScratchBuff + ((uint32_t)idx * ChunkSize);
+}
+
+/**
+  * @brief  USBD_MTP_STORAGE_ReadChunk
+  *         Fill a chunk with the next data of the current data phase
+  * @param  pdev: device instance
+  * @param  buf: chunk to fill, MTP_DataLength.maxlen bytes are available
+  * @retval None
+  */
+static void USBD_MTP_STORAGE_ReadChunk(USBD_HandleTypeDef  *pdev, uint8_t *buf)
+{
+  USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+  USBD_MTP_ItfTypeDef     *hmtpif = (USBD_MTP_ItfTypeDef *)pdev->pUserData[pdev->classId];
+
+  MTP_DataLength.readbytes = 0U;
+
+  if (MTP_DataLength.temp_length >= MTP_DataLength.totallen)
+  {
+    return;
+  }
+
+  MTP_DataLength.maxlen = MIN(MTP_DataLength.maxlen, MTP_DataLength.totallen - MTP_DataLength.temp_length);
+
+  switch (hmtp->OperationsContainer.code)
+  {
+    case MTP_OP_GET_OBJECT_HANDLES:
+    case MTP_OP_GET_OBJECT_PROPLIST:
+      (void)USBD_MTP_OPT_ReadData(pdev, buf, &MTP_DataLength);
+      break;
+
+    default:
+      (void)hmtpif->ReadData(hmtp->OperationsContainer.Param1, buf, &MTP_DataLength);
+      break;
+  }
+}
+
+/**
+  * @brief  USBD_MTP_STORAGE_ReadNext
+  *         Read the next chunk while the current one is sent, or end the
+  *         data phase after it
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void USBD_MTP_STORAGE_ReadNext(USBD_HandleTypeDef  *pdev)
+{
+  USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  if ((MTP_DataLength.temp_length < MTP_DataLength.totallen) && (ChunkLength == ChunkSize))
+  {
+    ChunkIdx ^= 1U;
+    MTP_DataLength.maxlen = ChunkSize;
+    USBD_MTP_STORAGE_ReadChunk(pdev, USBD_MTP_STORAGE_GetChunk(pdev, ChunkIdx));
+    ChunkLength = MTP_DataLength.readbytes;
+
+    /* Continue to the next chunk sending */
+    ReadDataStatus = READ_REST_OF_DATA;
+  }
+  else
+  {
+    if (MTP_DataLength.temp_length < MTP_DataLength.totallen)
+    {
+      /* The object could not be read up to its announced size */
+      hmtp->ResponseCode = MTP_RESPONSE_INCOMPLETE_TRANSFER;
+    }
+
+    if ((ChunkLength != 0U) && ((ChunkLength % hmtp->MaxPcktLen) == 0U))
+    {
+      ReadDataStatus = READ_SEND_ZLP;
+    }
+    else
+    {
+      /* Move to response phase */
+      hmtp->MTP_ResponsePhase = MTP_RESPONSE_PHASE;
+      ReadDataStatus = READ_FIRST_DATA;
+    }
+  }
+}
+
+/**
+  * @brief  USBD_MTP_STORAGE_ReceiveNext
+  *         Prepare the OUT endpoint to receive the next chunk of object data
+  *         in the other half of the scratch buffer
+  * @param  pdev: device instance
+  * @retval 1 if a transfer was started, 0 if all data was received
+  */
+static uint8_t USBD_MTP_STORAGE_ReceiveNext(USBD_HandleTypeDef  *pdev)
+{
+  uint32_t remaining;
+
+  if (MTP_DataLength.temp_length >= MTP_DataLength.totallen)
+  {
+    return 0U;
+  }
+
+  remaining = MTP_DataLength.totallen - MTP_DataLength.temp_length;
+
+#ifdef USE_USBD_COMPOSITE
+  /* Get the Endpoints addresses allocated for this class instance */
+  MTPOutEpAdd = USBD_CoreGetEPAdd(pdev, USBD_EP_OUT, USBD_EP_TYPE_BULK);
+#endif /* USE_USBD_COMPOSITE */
+
+  ChunkIdx ^= 1U;
+  ChunkLength = MIN(ChunkSize, remaining);
+
+  (void)USBD_LL_PrepareReceive(pdev, MTPOutEpAdd, USBD_MTP_STORAGE_GetChunk(pdev, ChunkIdx), ChunkLength);
+
+  return 1U;
+}
+
+/**
+  * @brief  USBD_MTP_STORAGE_ReceiveDone
+  *         Complete the object reception and send the response
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void USBD_MTP_STORAGE_ReceiveDone(USBD_HandleTypeDef  *pdev)
+{
+  USBD_MTP_HandleTypeDef  *hmtp = (USBD_MTP_HandleTypeDef *)pdev->pClassDataCmsit[pdev->classId];
+
+  hmtp->RECEIVE_DATA_STATUS = SEND_RESPONSE;
+  (void)USBD_MTP_STORAGE_DecodeOperations(pdev);
+
+  /* send response header after receiving all data successfully */
+  (void)USBD_MTP_STORAGE_SendContainer(pdev, DATA_TYPE);
+}
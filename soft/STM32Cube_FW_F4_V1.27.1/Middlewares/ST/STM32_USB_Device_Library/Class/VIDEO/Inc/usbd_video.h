@@ -120,6 +120,22 @@ extern "C" {
 #define UVC_HEADER_PACKET_CNT                         0x01U
 #endif /* UVC_HEADER_PACKET_CNT */
 
+/* Maximum number of frame buffers given to USBD_VIDEO_SetFrameRing() */
+#ifndef UVC_FRAME_RING_MAX
+#define UVC_FRAME_RING_MAX                            4U
+#endif /* UVC_FRAME_RING_MAX */
+
+/* The frame ring is shared between the capture interrupt and the USB
+   interrupt, these shall mask one of them when their priorities differ */
+#ifndef UVC_FRAME_LOCK
+#define UVC_FRAME_LOCK()
+#define UVC_FRAME_UNLOCK()
+#endif /* UVC_FRAME_LOCK */
+
+#define UVC_PAYLOAD_HEADER_SIZE                       0x02U
+#define UVC_PAYLOAD_HEADER_FID                        0x01U
+#define UVC_PAYLOAD_HEADER_EOF                        0x02U
+
 
 #define UVC_REQ_READ_MASK                             0x80U
 #define UVC_VC_IF_NUM                                 0x00U
@@ -373,6 +389,14 @@ typedef struct
   uint8_t unit;
 } USBD_VIDEO_ControlTypeDef;
 
+typedef struct
+{
+  uint32_t captured;          /* frames published by the capture side */
+  uint32_t sent;              /* frames completely sent to the host */
+  uint32_t dropped;           /* frames overwritten or aborted before being sent */
+  uint32_t fps;               /* frames sent during the last second */
+} USBD_VIDEO_StatsTypeDef;
+
 typedef struct
 {
   uint32_t                   interface;
@@ -547,6 +571,11 @@ extern USBD_ClassTypeDef    USBD_VIDEO;
 
 uint8_t USBD_VIDEO_RegisterInterface(USBD_HandleTypeDef *pdev, USBD_VIDEO_ItfTypeDef *fops);
 
+uint8_t USBD_VIDEO_SetFrameRing(uint8_t *const *frames, uint8_t count, uint32_t size);
+uint8_t *USBD_VIDEO_GetCaptureFrame(void);
+uint8_t *USBD_VIDEO_FrameCaptured(uint32_t len);
+void USBD_VIDEO_GetStats(USBD_VIDEO_StatsTypeDef *stats);
+
 /**
   * @}
   */
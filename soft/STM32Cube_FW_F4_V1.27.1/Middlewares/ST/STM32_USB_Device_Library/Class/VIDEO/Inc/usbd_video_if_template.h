@@ -50,6 +50,17 @@ extern "C" {
 
 /* USER CODE END EXPORTED_DEFINES */
 
+/* Number of camera frame buffers, one is written by the DCMI while the
+   others are ready or being sent */
+#ifndef UVC_FRAME_RING_SIZE
+#define UVC_FRAME_RING_SIZE                       3U
+#endif /* UVC_FRAME_RING_SIZE */
+
+/* Size of a camera frame buffer, shall hold the largest JPEG frame */
+#ifndef UVC_FRAME_BUFF_SIZE
+#define UVC_FRAME_BUFF_SIZE                       0x8000U
+#endif /* UVC_FRAME_BUFF_SIZE */
+
 /**
   * @}
   */
@@ -114,24 +125,6 @@ void TransferComplete_CallBack_FS(void);
 void HalfTransfer_CallBack_FS(void);
 
 
-
-#define IMG_NBR                   1U
-#define IMAGE_SIZE              0x1U
-
-const  uint8_t image[] = {0x00};
-const  uint8_t *tImagesList[] = {image};
-uint16_t tImagesSizes[] = {IMAGE_SIZE};
-
-/* Time laps between video frames in ms.
-   Please adjust this value depending on required speed.
-   Please note that this define uses the system HAL_Delay() which uses the systick.
-   In case of changes on HAL_Delay, please ensure the values in ms correspond. */
-#ifdef USE_USB_HS
-#define USBD_VIDEO_IMAGE_LAPS                     160U
-#else
-#define USBD_VIDEO_IMAGE_LAPS                     80U
-#endif /* USE_USB_HS */
-
 /* USER CODE BEGIN EXPORTED_FUNCTIONS */
 
 /* USER CODE END EXPORTED_FUNCTIONS */
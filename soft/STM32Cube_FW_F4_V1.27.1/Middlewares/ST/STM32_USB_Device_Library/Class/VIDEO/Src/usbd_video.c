@@ -38,6 +38,8 @@
   *          The current  Video class version supports the following Video features:
   *             - image JPEG format
   *             - Asynchronous Endpoints
+  *             - Frame ring filled in place by the capture side (USBD_VIDEO_SetFrameRing),
+  *               payloads are sent from the frame buffers without copy
   *
   * @note     In HS mode and when the USB DMA is used, all variables and data structures
   *           dealing with the DMA during the transaction process should be 32-bit aligned.
@@ -65,6 +67,31 @@
 /** @defgroup USBD_VIDEO_Private_TypesDefinitions
   * @{
   */
+typedef enum
+{
+  VIDEO_FRAME_FREE = 0U,
+  VIDEO_FRAME_CAPTURE,
+  VIDEO_FRAME_READY,
+  VIDEO_FRAME_SEND,
+} VIDEO_FrameStateTypeDef;
+
+typedef struct
+{
+  uint8_t                 *buf[UVC_FRAME_RING_MAX];
+  uint32_t                 len[UVC_FRAME_RING_MAX];
+  uint32_t                 seq[UVC_FRAME_RING_MAX];
+  uint8_t                  state[UVC_FRAME_RING_MAX];
+  uint32_t                 size;
+  uint32_t                 next_seq;
+  uint32_t                 offset;
+  uint8_t                  count;
+  uint8_t                  capture;
+  uint8_t                  send;
+  uint8_t                  fid;
+  uint32_t                 sof_cnt;
+  uint32_t                 sent_mark;
+  USBD_VIDEO_StatsTypeDef  stats;
+} VIDEO_FrameRingTypeDef;
 
 /**
   * @}
@@ -73,6 +100,7 @@
 /** @defgroup USBD_VIDEO_Private_Defines
   * @{
   */
+#define VIDEO_FRAME_NONE                              0xFFU
 
 /**
   * @}
@@ -109,6 +137,10 @@ static void *USBD_VIDEO_GetVSFrameDesc(uint8_t *pConfDesc);
 
 static void *USBD_VIDEO_GetVideoHeaderDesc(uint8_t *pConfDesc);
 
+static void VIDEO_FrameSendNext(USBD_HandleTypeDef *pdev);
+static uint8_t VIDEO_FrameSelect(uint8_t state);
+static void VIDEO_FrameAbort(void);
+
 /**
   * @}
   */
@@ -338,6 +370,12 @@ __ALIGN_BEGIN static uint8_t USBD_VIDEO_DeviceQualifierDesc[USB_LEN_DEV_QUALIFIE
 
 static uint8_t VIDEOinEpAdd = UVC_IN_EP;
 
+/* Frame ring, set by the application before the streaming starts */
+static VIDEO_FrameRingTypeDef VIDEO_FrameRing;
+
+/* Header only payload, sent while no frame is ready */
+__ALIGN_BEGIN static uint8_t VIDEO_EmptyPayload[UVC_PAYLOAD_HEADER_SIZE] __ALIGN_END = {UVC_PAYLOAD_HEADER_SIZE, 0x00U};
+
 /* Video Commit data structure */
 static USBD_VideoControlTypeDef video_Commit_Control =
 {
@@ -472,6 +510,7 @@ static uint8_t USBD_VIDEO_DeInit(USBD_HandleTypeDef *pdev, uint8_t cfgidx)
   /* Close EP IN */
   (void)USBD_LL_CloseEP(pdev, VIDEOinEpAdd);
   pdev->ep_in[VIDEOinEpAdd & 0xFU].is_used = 0U;
+  VIDEO_FrameAbort();
 
   /* DeInit  physical Interface components */
   ((USBD_VIDEO_ItfTypeDef *)pdev->pUserData[pdev->classId])->DeInit();
@@ -589,6 +628,7 @@ static uint8_t USBD_VIDEO_Setup(USBD_HandleTypeDef *pdev, USBD_SetupReqTypedef *
                 /* Stop Streaming */
                 hVIDEO->uvc_state = UVC_PLAY_STATUS_STOP;
                 (void)USBD_LL_FlushEP(pdev, VIDEOinEpAdd);
+                VIDEO_FrameAbort();
               }
             }
             else
@@ -642,8 +682,13 @@ static uint8_t  USBD_VIDEO_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
   uint8_t i = 0U;
   uint32_t RemainData, DataOffset = 0U;
 
+  /* Frames from the frame ring are sent in place */
+  if ((hVIDEO->uvc_state == UVC_PLAY_STATUS_STREAMING) && (VIDEO_FrameRing.count != 0U))
+  {
+    VIDEO_FrameSendNext(pdev);
+  }
   /* Check if the Streaming has already been started */
-  if (hVIDEO->uvc_state == UVC_PLAY_STATUS_STREAMING)
+  else if (hVIDEO->uvc_state == UVC_PLAY_STATUS_STREAMING)
   {
     /* Get the current packet buffer, index and size from the application layer */
     ((USBD_VIDEO_ItfTypeDef *)pdev->pUserData[pdev->classId])->Data(&Pcktdata, &PcktSze, &PcktIdx);
@@ -709,18 +754,29 @@ static uint8_t  USBD_VIDEO_DataIn(USBD_HandleTypeDef *pdev, uint8_t epnum)
 static uint8_t  USBD_VIDEO_SOF(USBD_HandleTypeDef *pdev)
 {
   USBD_VIDEO_HandleTypeDef *hVIDEO = (USBD_VIDEO_HandleTypeDef *) pdev->pClassDataCmsit[pdev->classId];
-  uint8_t payload[2] = {0x02U, 0x00U};
+  uint32_t sof_rate = (pdev->dev_speed == USBD_SPEED_HIGH) ? 8000U : 1000U;
 
   /* Check if the Streaming has already been started by SetInterface AltSetting 1 */
   if (hVIDEO->uvc_state == UVC_PLAY_STATUS_READY)
   {
-    /* Transmit the first packet indicating that Streaming is starting */
-    (void)USBD_LL_Transmit(pdev, VIDEOinEpAdd, (uint8_t *)payload, 2U);
+    /* Transmit the first packet indicating that Streaming is starting,
+       the buffer is static as it is read by the core after this call */
+    VIDEO_EmptyPayload[1] = 0x00U;
+    (void)USBD_LL_Transmit(pdev, VIDEOinEpAdd, VIDEO_EmptyPayload, UVC_PAYLOAD_HEADER_SIZE);
 
     /* Enable Streaming state */
     hVIDEO->uvc_state = UVC_PLAY_STATUS_STREAMING;
   }
 
+  /* Frames sent during the last second */
+  VIDEO_FrameRing.sof_cnt++;
+  if (VIDEO_FrameRing.sof_cnt >= sof_rate)
+  {
+    VIDEO_FrameRing.stats.fps = VIDEO_FrameRing.stats.sent - VIDEO_FrameRing.sent_mark;
+    VIDEO_FrameRing.sent_mark = VIDEO_FrameRing.stats.sent;
+    VIDEO_FrameRing.sof_cnt = 0U;
+  }
+
   /* Exit with no error code */
   return (uint8_t)USBD_OK;
 }
@@ -734,12 +790,136 @@ static uint8_t  USBD_VIDEO_SOF(USBD_HandleTypeDef *pdev)
   */
 static uint8_t USBD_VIDEO_IsoINIncomplete(USBD_HandleTypeDef *pdev, uint8_t epnum)
 {
-  UNUSED(pdev);
+  USBD_VIDEO_HandleTypeDef *hVIDEO = (USBD_VIDEO_HandleTypeDef *) pdev->pClassDataCmsit[pdev->classId];
+
   UNUSED(epnum);
 
+  /* A payload of the current frame was not taken by the host: drop the frame
+     and restart with the next one, no DataIn will come for this packet */
+  if ((hVIDEO != NULL) && (hVIDEO->uvc_state == UVC_PLAY_STATUS_STREAMING) && (VIDEO_FrameRing.count != 0U))
+  {
+    (void)USBD_LL_FlushEP(pdev, VIDEOinEpAdd);
+    VIDEO_FrameAbort();
+    VIDEO_FrameSendNext(pdev);
+  }
+
   return (uint8_t)USBD_OK;
 }
 
+/**
+  * @brief  VIDEO_FrameSendNext
+  *         Transmit the next payload of the frame being sent, or start the
+  *         oldest ready frame. The payload header is written over the last
+  *         two bytes of the previous payload, already sent, so that the
+  *         payload is transmitted from the frame buffer without copy.
+  * @param  pdev: device instance
+  * @retval None
+  */
+static void VIDEO_FrameSendNext(USBD_HandleTypeDef *pdev)
+{
+  VIDEO_FrameRingTypeDef *ring = &VIDEO_FrameRing;
+  uint32_t payload;
+  uint32_t len;
+  uint8_t *pkt;
+
+  UVC_FRAME_LOCK();
+
+  /* The last payload of the frame has been sent */
+  if ((ring->send != VIDEO_FRAME_NONE) && (ring->offset >= ring->len[ring->send]))
+  {
+    ring->state[ring->send] = (uint8_t)VIDEO_FRAME_FREE;
+    ring->send = VIDEO_FRAME_NONE;
+    ring->stats.sent++;
+  }
+
+  if (ring->send == VIDEO_FRAME_NONE)
+  {
+    ring->send = VIDEO_FrameSelect((uint8_t)VIDEO_FRAME_READY);
+
+    if (ring->send != VIDEO_FRAME_NONE)
+    {
+      ring->state[ring->send] = (uint8_t)VIDEO_FRAME_SEND;
+      ring->offset = 0U;
+      ring->fid ^= UVC_PAYLOAD_HEADER_FID;
+    }
+  }
+
+  UVC_FRAME_UNLOCK();
+
+  if (ring->send == VIDEO_FRAME_NONE)
+  {
+    /* No frame ready, keep the isochronous stream alive */
+    VIDEO_EmptyPayload[1] = ring->fid;
+    (void)USBD_LL_Transmit(pdev, VIDEOinEpAdd, VIDEO_EmptyPayload, UVC_PAYLOAD_HEADER_SIZE);
+    return;
+  }
+
+  /* Payload sizes are a multiple of 4 bytes so that every packet starts on
+     a 32-bit boundary of the frame buffer, as required by the USB DMA */
+  payload = ((uint32_t)pdev->ep_in[VIDEOinEpAdd & 0xFU].maxpacket - UVC_PAYLOAD_HEADER_SIZE) & ~3U;
+  len = MIN(payload, ring->len[ring->send] - ring->offset);
+
+  pkt = ring->buf[ring->send] + ring->offset;
+  pkt[0] = UVC_PAYLOAD_HEADER_SIZE;
+  pkt[1] = ring->fid;
+
+  ring->offset += len;
+  if (ring->offset >= ring->len[ring->send])
+  {
+    pkt[1] |= UVC_PAYLOAD_HEADER_EOF;
+  }
+
+  (void)USBD_LL_Transmit(pdev, VIDEOinEpAdd, pkt, len + UVC_PAYLOAD_HEADER_SIZE);
+}
+
+/**
+  * @brief  VIDEO_FrameSelect
+  *         Find a frame of the ring, the oldest one for ready frames
+  * @param  state: frame state to look for
+  * @retval frame index, VIDEO_FRAME_NONE if none
+  */
+static uint8_t VIDEO_FrameSelect(uint8_t state)
+{
+  VIDEO_FrameRingTypeDef *ring = &VIDEO_FrameRing;
+  uint8_t idx = VIDEO_FRAME_NONE;
+  uint8_t i;
+
+  for (i = 0U; i < ring->count; i++)
+  {
+    if (ring->state[i] == state)
+    {
+      if ((idx == VIDEO_FRAME_NONE) || ((int32_t)(ring->seq[i] - ring->seq[idx]) < 0))
+      {
+        idx = i;
+      }
+    }
+  }
+
+  return idx;
+}
+
+/**
+  * @brief  VIDEO_FrameAbort
+  *         Give back the frame being sent, it is counted as dropped
+  * @param  None
+  * @retval None
+  */
+static void VIDEO_FrameAbort(void)
+{
+  VIDEO_FrameRingTypeDef *ring = &VIDEO_FrameRing;
+
+  UVC_FRAME_LOCK();
+
+  if (ring->send != VIDEO_FRAME_NONE)
+  {
+    ring->state[ring->send] = (uint8_t)VIDEO_FRAME_FREE;
+    ring->send = VIDEO_FRAME_NONE;
+    ring->stats.dropped++;
+  }
+
+  UVC_FRAME_UNLOCK();
+}
+
 /**
   * @brief  VIDEO_Req_GetCurrent
   *         Handles the GET_CUR VIDEO control request.
@@ -1049,6 +1229,127 @@ uint8_t USBD_VIDEO_RegisterInterface(USBD_HandleTypeDef   *pdev, USBD_VIDEO_ItfT
   return (uint8_t)USBD_OK;
 }
 
+/**
+  * @brief  USBD_VIDEO_SetFrameRing
+  *         Set the frame buffers filled by the capture side. When set, the
+  *         interface Data callback is no longer used. Each buffer shall be
+  *         32-bit aligned, the frame is written UVC_PAYLOAD_HEADER_SIZE
+  *         bytes after its start (see USBD_VIDEO_GetCaptureFrame).
+  * @param  frames: frame buffers
+  * @param  count: number of buffers, 2 to UVC_FRAME_RING_MAX
+  * @param  size: size of each buffer
+  * @retval status
+  */
+uint8_t USBD_VIDEO_SetFrameRing(uint8_t *const *frames, uint8_t count, uint32_t size)
+{
+  VIDEO_FrameRingTypeDef *ring = &VIDEO_FrameRing;
+  uint8_t i;
+
+  if ((frames == NULL) || (count < 2U) || (count > UVC_FRAME_RING_MAX) ||
+      (size <= UVC_PAYLOAD_HEADER_SIZE))
+  {
+    return (uint8_t)USBD_FAIL;
+  }
+
+  UVC_FRAME_LOCK();
+
+  (void)USBD_memset(ring, 0, sizeof(VIDEO_FrameRingTypeDef));
+
+  for (i = 0U; i < count; i++)
+  {
+    ring->buf[i] = frames[i];
+    ring->state[i] = (uint8_t)VIDEO_FRAME_FREE;
+  }
+
+  ring->size = size;
+  ring->count = count;
+  ring->send = VIDEO_FRAME_NONE;
+
+  /* The first buffer is given to the capture side */
+  ring->capture = 0U;
+  ring->state[0] = (uint8_t)VIDEO_FRAME_CAPTURE;
+
+  UVC_FRAME_UNLOCK();
+
+  return (uint8_t)USBD_OK;
+}
+
+/**
+  * @brief  USBD_VIDEO_GetCaptureFrame
+  *         Get where the capture side shall write the current frame
+  * @param  None
+  * @retval frame data, 16-bit aligned, NULL if no frame ring is set
+  */
+uint8_t *USBD_VIDEO_GetCaptureFrame(void)
+{
+  if (VIDEO_FrameRing.count == 0U)
+  {
+    return NULL;
+  }
+
+  return VIDEO_FrameRing.buf[VIDEO_FrameRing.capture] + UVC_PAYLOAD_HEADER_SIZE;
+}
+
+/**
+  * @brief  USBD_VIDEO_FrameCaptured
+  *         Publish the frame written at USBD_VIDEO_GetCaptureFrame() and get
+  *         the buffer of the next frame. When the host falls behind, the
+  *         oldest frame not yet being sent is dropped for the new one.
+  * @param  len: frame length, 0 to discard the frame
+  * @retval next frame data, NULL if no frame ring is set
+  */
+uint8_t *USBD_VIDEO_FrameCaptured(uint32_t len)
+{
+  VIDEO_FrameRingTypeDef *ring = &VIDEO_FrameRing;
+  uint8_t idx;
+
+  if (ring->count == 0U)
+  {
+    return NULL;
+  }
+
+  UVC_FRAME_LOCK();
+
+  if ((len != 0U) && (len <= (ring->size - UVC_PAYLOAD_HEADER_SIZE)))
+  {
+    idx = ring->capture;
+    ring->len[idx] = len;
+    ring->seq[idx] = ring->next_seq;
+    ring->next_seq++;
+    ring->state[idx] = (uint8_t)VIDEO_FRAME_READY;
+    ring->stats.captured++;
+
+    idx = VIDEO_FrameSelect((uint8_t)VIDEO_FRAME_FREE);
+
+    if (idx == VIDEO_FRAME_NONE)
+    {
+      /* Host behind: reuse the oldest ready frame, possibly this one */
+      idx = VIDEO_FrameSelect((uint8_t)VIDEO_FRAME_READY);
+      ring->stats.dropped++;
+    }
+
+    ring->state[idx] = (uint8_t)VIDEO_FRAME_CAPTURE;
+    ring->capture = idx;
+  }
+
+  UVC_FRAME_UNLOCK();
+
+  return ring->buf[ring->capture] + UVC_PAYLOAD_HEADER_SIZE;
+}
+
+/**
+  * @brief  USBD_VIDEO_GetStats
+  *         Get the frame ring counters
+  * @param  stats: counters
+  * @retval None
+  */
+void USBD_VIDEO_GetStats(USBD_VIDEO_StatsTypeDef *stats)
+{
+  UVC_FRAME_LOCK();
+  *stats = VIDEO_FrameRing.stats;
+  UVC_FRAME_UNLOCK();
+}
+
 /**
   * @}
   */
@@ -19,16 +19,12 @@
 /* Includes ------------------------------------------------------------------*/
 #include "usbd_video_if_template.h"
 
-/* Include you image binary file here
-    Binary image template shall provide:
-     - tImagesList: table containing pointers to all images
-     - tImagesSizes: table containing sizes of each image respectively
-     - img_count: global image counter variable
-     - IMG_NBR: Total image number
-
-     To generate such file, it is possible to use tools converting video to MJPEG then to JPEG images.
- */
-/* #include "img_bin.h" */
+/* The frames are captured by the DCMI, with the camera sensor (e.g. OV2640)
+   configured in JPEG output mode by the application. The DCMI handle shall be
+   initialized with snapshot capture and JPEG mode, its DMA stream with a
+   32-bit peripheral and a 16-bit memory data width (FIFO enabled): each frame
+   is written 2 bytes after a 32-bit boundary so that the class can send it in
+   place, see USBD_VIDEO_SetFrameRing(). */
 
 /* USER CODE BEGIN INCLUDE */
 
@@ -40,7 +36,6 @@
 
 /* USER CODE BEGIN PV */
 /* Private variables ---------------------------------------------------------*/
-uint8_t img_count;
 /* USER CODE END PV */
 
 /** @addtogroup STM32_USB_OTG_DEVICE_LIBRARY
@@ -74,6 +69,12 @@ uint8_t img_count;
 
 /* USER CODE END PRIVATE_DEFINES */
 
+/* A capture is a single DMA transfer, without the double buffer mode the HAL
+   uses for more than 65535 data items */
+#if (UVC_FRAME_BUFF_SIZE / 4U) > 0xFFFFU
+#error "UVC_FRAME_BUFF_SIZE shall not exceed 256KB"
+#endif /* UVC_FRAME_BUFF_SIZE */
+
 /**
   * @}
   */
@@ -100,6 +101,12 @@ uint8_t img_count;
 
 /* USER CODE END PRIVATE_VARIABLES */
 
+extern DCMI_HandleTypeDef hdcmi;
+
+static uint32_t VIDEO_FrameBuff[UVC_FRAME_RING_SIZE][UVC_FRAME_BUFF_SIZE / 4U];
+static uint8_t *VIDEO_CaptureBuff;
+static uint32_t VIDEO_CaptureLen;
+
 /**
   * @}
   */
@@ -129,6 +136,9 @@ static int8_t VIDEO_Itf_DeInit(void);
 static int8_t VIDEO_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length);
 static int8_t VIDEO_Itf_Data(uint8_t **pbuf, uint16_t *psize, uint16_t *pcktidx);
 
+static void VIDEO_Itf_StartCapture(void);
+static uint32_t VIDEO_Itf_JpegLength(const uint8_t *frame, uint32_t len);
+
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_DECLARATION */
 
@@ -156,9 +166,23 @@ USBD_VIDEO_ItfTypeDef USBD_VIDEO_fops_FS =
   */
 static int8_t VIDEO_Itf_Init(void)
 {
-  /*
-     Add your initialization code here
-  */
+  uint8_t *frames[UVC_FRAME_RING_SIZE];
+  uint32_t i;
+
+  for (i = 0U; i < UVC_FRAME_RING_SIZE; i++)
+  {
+    frames[i] = (uint8_t *)VIDEO_FrameBuff[i];
+  }
+
+  if (USBD_VIDEO_SetFrameRing(frames, (uint8_t)UVC_FRAME_RING_SIZE, UVC_FRAME_BUFF_SIZE) != (uint8_t)USBD_OK)
+  {
+    return (-1);
+  }
+
+  /* Frames are captured as long as the device is configured, the class
+     drops the oldest ones when the host does not stream */
+  VIDEO_CaptureBuff = USBD_VIDEO_GetCaptureFrame();
+  VIDEO_Itf_StartCapture();
 
   return (0);
 }
@@ -171,9 +195,8 @@ static int8_t VIDEO_Itf_Init(void)
   */
 static int8_t VIDEO_Itf_DeInit(void)
 {
-  /*
-     Add your deinitialization code here
-  */
+  (void)HAL_DCMI_Stop(&hdcmi);
+
   return (0);
 }
 
@@ -205,82 +228,82 @@ static int8_t VIDEO_Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
   */
 static int8_t VIDEO_Itf_Data(uint8_t **pbuf, uint16_t *psize, uint16_t *pcktidx)
 {
-  /*
-    Implementation of this function is mandatory to provide the video data to the USB video class
-    This function shall parse the MJPEG images and provide each time the buffer packet relative to
-    current packet index and its size.
-    If the packet is the first packet in the current MJPEG image, then packet size shall be zero and
-    the pbuf is ignored and pcktidx shall be zero.
-    Below is typical implementation of this function based on a binary image template.
-
-    Binary image template shall provide:
-     - tImagesList: table containing pointers to all images
-     - tImagesSizes: table containing sizes of each image respectively
-     - img_count: global image counter variable
-     - IMG_NBR: Total image number
-
-     To generate such file, it is possible to use tools converting video to MJPEG then to JPEG images.
+  /* Not used: the frames are sent from the frame ring set at init */
+  UNUSED(pbuf);
+
+  *psize = UVC_PAYLOAD_HEADER_SIZE;
+  *pcktidx = 0U;
+
+  return (0);
+}
 
+/**
+  * @brief  VIDEO_Itf_StartCapture
+  *         Capture the next frame in the current frame buffer
+  * @param  None
+  * @retval None
   */
-  const uint8_t *(*ImagePtr) = tImagesList;
-  uint32_t packet_count = (tImagesSizes[img_count]) / ((UVC_PACKET_SIZE - (UVC_HEADER_PACKET_CNT * 2U)));
-  uint32_t packet_remainder = (tImagesSizes[img_count]) % ((UVC_PACKET_SIZE - (UVC_HEADER_PACKET_CNT * 2U)));
-  static uint8_t packet_index = 0U;
+static void VIDEO_Itf_StartCapture(void)
+{
+  /* DMA length in 32-bit words read from the DCMI */
+  VIDEO_CaptureLen = (UVC_FRAME_BUFF_SIZE - UVC_PAYLOAD_HEADER_SIZE) / 4U;
 
-  /* Check if end of current image has been reached */
-  if (packet_index < packet_count)
-  {
-    /* Set the current packet size */
-    *psize = (uint16_t)UVC_PACKET_SIZE;
+  (void)HAL_DCMI_Start_DMA(&hdcmi, DCMI_MODE_SNAPSHOT, (uint32_t)VIDEO_CaptureBuff, VIDEO_CaptureLen);
+}
 
-    /* Get the pointer to the next packet to be transmitted */
-    *pbuf = (uint8_t *)(*(ImagePtr + img_count) + (packet_index * ((uint16_t)(UVC_PACKET_SIZE - (UVC_HEADER_PACKET_CNT * 2U)))));
-  }
-  else if ((packet_index == packet_count))
+/**
+  * @brief  VIDEO_Itf_JpegLength
+  *         Get the length of a JPEG frame, up to its EOI marker
+  * @param  frame: captured frame
+  * @param  len: captured length, a multiple of the DMA data width
+  * @retval JPEG frame length, 0 if the frame is not a complete JPEG image
+  */
+static uint32_t VIDEO_Itf_JpegLength(const uint8_t *frame, uint32_t len)
+{
+  uint32_t i;
+
+  if ((len < 4U) || (frame[0] != 0xFFU) || (frame[1] != 0xD8U))
   {
-    if (packet_remainder != 0U)
-    {
-      /* Get the pointer to the next packet to be transmitted */
-      *pbuf = (uint8_t *)(*(ImagePtr + img_count) + (packet_index * ((uint16_t)(UVC_PACKET_SIZE - (UVC_HEADER_PACKET_CNT * 2U)))));
+    return 0U;
+  }
 
-      /* Set the current packet size */
-      *psize = (uint16_t)(packet_remainder + (UVC_HEADER_PACKET_CNT * 2U));
-    }
-    else
+  for (i = len; i >= 4U; i--)
+  {
+    if ((frame[i - 2U] == 0xFFU) && (frame[i - 1U] == 0xD9U))
     {
-      packet_index++;
-
-      /* New image to be started, send only the packet header */
-      *psize = 2;
+      return i;
     }
   }
-  else
-  {
-    /* New image to be started, send only the packet header */
-    *psize = 2;
-  }
 
-  /* Update the packet index */
-  *pcktidx = packet_index;
+  return 0U;
+}
 
-  /* Increment the packet count and check if it reached the end of current image buffer */
-  if (packet_index++ >= (packet_count + 1U))
-  {
-    /* Reset the packet count to zero */
-    packet_index = 0U;
+/**
+  * @brief  Frame event callback, a frame has been captured
+  * @param  hdcmi: DCMI handle
+  * @retval None
+  */
+void HAL_DCMI_FrameEventCallback(DCMI_HandleTypeDef *hdcmi)
+{
+  uint32_t len = (VIDEO_CaptureLen - __HAL_DMA_GET_COUNTER(hdcmi->DMA_Handle)) * 4U;
 
-    /* Move to the next image in the images table */
+  (void)HAL_DCMI_Stop(hdcmi);
 
-    img_count++;
-    USBD_Delay(USBD_VIDEO_IMAGE_LAPS);
-    /* Check if images count has been reached, then reset to zero (go back to first image in circular loop) */
-    if (img_count == IMG_NBR)
-    {
-      img_count = 0U;
-    }
-  }
+  /* Publish the frame and capture the next one in the buffer given back,
+     an incomplete frame is captured again in the same buffer */
+  VIDEO_CaptureBuff = USBD_VIDEO_FrameCaptured(VIDEO_Itf_JpegLength(VIDEO_CaptureBuff, len));
+  VIDEO_Itf_StartCapture();
+}
 
-  return (0);
+/**
+  * @brief  Error callback, the frame did not fit or was corrupted
+  * @param  hdcmi: DCMI handle
+  * @retval None
+  */
+void HAL_DCMI_ErrorCallback(DCMI_HandleTypeDef *hdcmi)
+{
+  (void)HAL_DCMI_Stop(hdcmi);
+  VIDEO_Itf_StartCapture();
 }
 
 /* USER CODE BEGIN PRIVATE_FUNCTIONS_IMPLEMENTATION */
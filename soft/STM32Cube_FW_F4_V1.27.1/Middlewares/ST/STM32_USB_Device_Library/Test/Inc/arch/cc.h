@@ -0,0 +1,29 @@
+/**
+  ******************************************************************************
+  * @file    arch/cc.h
+  * @brief   lwIP port of the host test: host compiler, no operating system.
+  ******************************************************************************
+  * @attention
+  *
+  * Test harness of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __CC_H__
+#define __CC_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define LWIP_RAND()                 ((u32_t)rand())
+
+#define LWIP_PLATFORM_DIAG(x)       do { printf x; } while (0)
+#define LWIP_PLATFORM_ASSERT(x)     do { printf("lwIP assertion \"%s\" failed at line %d in %s\n", \
+                                            x, __LINE__, __FILE__); abort(); } while (0)
+
+#endif /* __CC_H__ */
@@ -0,0 +1,59 @@
+/**
+  ******************************************************************************
+  * @file    lwipopts.h
+  * @brief   lwIP options of the host test, those of a NO_SYS device that
+  *          answers ARP and ICMP echo over CDC NCM.
+  ******************************************************************************
+  * @attention
+  *
+  * Test harness of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+#define NO_SYS                          1
+#define SYS_LIGHTWEIGHT_PROT            0
+#define LWIP_NETCONN                    0
+#define LWIP_SOCKET                     0
+
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
+#define ETH_PAD_SIZE                    0
+
+#define MEM_ALIGNMENT                   4
+#define MEM_SIZE                        (16 * 1024)
+#define MEMP_NUM_PBUF                   32
+#define PBUF_POOL_SIZE                  16
+
+#define LWIP_ARP                        1
+#define LWIP_ETHERNET                   1
+#define LWIP_ICMP                       1
+#define LWIP_RAW                        0
+#define LWIP_UDP                        1
+#define LWIP_TCP                        0
+#define LWIP_DHCP                       0
+#define LWIP_IPV6                       0
+
+#define LWIP_NETIF_LINK_CALLBACK        0
+#define LWIP_HAVE_LOOPIF                0
+
+/* The counters checked by the test */
+#define LWIP_STATS                      1
+#define LINK_STATS                      1
+#define MEM_STATS                       1
+#define MEMP_STATS                      1
+#define ICMP_STATS                      1
+#define LWIP_STATS_DISPLAY              0
+
+#define CHECKSUM_GEN_IP                 1
+#define CHECKSUM_GEN_ICMP               1
+#define CHECKSUM_CHECK_IP               1
+#define CHECKSUM_CHECK_ICMP             1
+
+#endif /* __LWIPOPTS_H__ */
@@ -0,0 +1,95 @@
+/**
+  ******************************************************************************
+  * @file    usbd_conf.h
+  * @brief   USB device library configuration of the host test: the HAL types
+  *          the classes refer to are replaced by the minimum they use.
+  ******************************************************************************
+  * @attention
+  *
+  * Test harness of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CONF_H
+#define __USBD_CONF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Exported constants --------------------------------------------------------*/
+#define USBD_MAX_NUM_INTERFACES                     4U
+#define USBD_MAX_NUM_CONFIGURATION                  1U
+#define USBD_MAX_STR_DESC_SIZ                       0x100U
+#define USBD_SELF_POWERED                           1U
+#define USBD_DEBUG_LEVEL                            0U
+#define USBD_SUPPORT_USER_STRING_DESC               1U
+
+/* CDC ACM, the other function of the composite build */
+#define USBD_CDC_INTERVAL                           2000U
+
+/* The composite build puts CDC ACM first, so that CDC NCM gets interfaces 2 and 3 */
+#ifdef USE_USBD_COMPOSITE
+#define USBD_MAX_SUPPORTED_CLASS                    2U
+#define USBD_COMPOSITE_USE_IAD                      1U
+#define USBD_CMPSIT_ACTIVATE_CDC                    1U
+#define USBD_CMPSIT_ACTIVATE_CDC_NCM                1U
+#endif /* USE_USBD_COMPOSITE */
+
+/* Compiler and CMSIS definitions of the target, for the host compiler */
+#define __IO                                        volatile
+#define __PACKED                                    __attribute__((packed))
+#define __PACKED_STRUCT                             struct __attribute__((packed))
+#define __STATIC_INLINE                             static inline
+#define __ALIGN_BEGIN
+#define __ALIGN_END                                 __attribute__((aligned(4)))
+#define UNUSED(X)                                   (void)(X)
+
+/* Exported types ------------------------------------------------------------*/
+/* The part of the HAL PCD handle read by the classes */
+typedef struct
+{
+  uint32_t maxpacket;
+} PCD_EPTypeDef;
+
+typedef struct
+{
+  PCD_EPTypeDef IN_ep[16];
+  PCD_EPTypeDef OUT_ep[16];
+} PCD_HandleTypeDef;
+
+/* Exported macro ------------------------------------------------------------*/
+/* Memory management macros, one static block per class instance */
+#define USBD_malloc         (void *)USBD_static_malloc
+#define USBD_free           USBD_static_free
+#define USBD_memset         memset
+#define USBD_memcpy         memcpy
+#define USBD_Delay          USBD_LL_Delay
+
+/* DEBUG macros */
+#define USBD_UsrLog(...)    do {} while (0)
+#define USBD_ErrLog(...)    do {} while (0)
+#define USBD_DbgLog(...)    do {} while (0)
+
+/* Exported functions ------------------------------------------------------- */
+void *USBD_static_malloc(uint32_t size);
+void USBD_static_free(void *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_CONF_H */
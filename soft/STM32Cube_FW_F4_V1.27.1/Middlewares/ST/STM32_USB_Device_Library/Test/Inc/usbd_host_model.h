@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file    usbd_host_model.h
+  * @brief   Host side of the test: a USBD_LL layer that keeps the transfers
+  *          the device core prepares and serves them when the test asks.
+  ******************************************************************************
+  * @attention
+  *
+  * Test harness of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_HOST_MODEL_H
+#define __USBD_HOST_MODEL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_core.h"
+
+/* Exported constants --------------------------------------------------------*/
+#define HOST_EP0_SIZE                      64U
+
+/* Returned instead of a length */
+#define HOST_STALL                         (-1)    /* the device stalled the request */
+#define HOST_NAK                           (-2)    /* no transfer prepared by the device */
+#define HOST_OVERRUN                       (-3)    /* more data than the host asked for */
+
+/* Exported types ------------------------------------------------------------*/
+/* Endpoint as seen from the bus */
+typedef struct
+{
+  uint8_t  *pBuf;                 /* transfer prepared by the device */
+  uint32_t Length;
+  uint32_t RxCount;
+  uint32_t Transfers;             /* transfers prepared since the endpoint was opened */
+  uint32_t Rearmed;               /* IN transfers prepared over a pending one */
+  uint16_t MaxPacket;
+  uint8_t  Type;
+  uint8_t  Open;
+  uint8_t  Armed;
+  uint8_t  Stalled;
+} HOST_EpTypeDef;
+
+/* Exported functions ------------------------------------------------------- */
+void HOST_Attach(USBD_HandleTypeDef *pdev);
+int  HOST_Control(USBD_HandleTypeDef *pdev, uint8_t bmRequest, uint8_t bRequest,
+                  uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *pData);
+int  HOST_BulkOut(USBD_HandleTypeDef *pdev, uint8_t ep_addr, const uint8_t *pData, uint32_t len);
+int  HOST_BulkIn(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pData, uint32_t size);
+int  HOST_IsoIn(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pData, uint32_t size);
+void HOST_IsoInMissed(USBD_HandleTypeDef *pdev, uint8_t ep_addr);
+HOST_EpTypeDef *HOST_GetEp(uint8_t ep_addr);
+uint32_t HOST_AllocatedBlocks(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __USBD_HOST_MODEL_H */
@@ -0,0 +1,1379 @@
+/**
+  ******************************************************************************
+  * @file    test_cdc_ncm.c
+  * @brief   Host test of the CDC NCM class and of its lwIP interface template.
+  *          The device core, the class, usbd_cdc_ncm_if_template.c and lwIP run
+  *          unmodified on top of usbd_host_model.c; this file is the host: it
+  *          enumerates the device, sends the NCM requests, exchanges NTBs that
+  *          carry ARP and ICMP echo with the lwIP stack and checks the framing
+  *          of every NTB the device sends.
+  *          Built with USE_USBD_COMPOSITE, the device is CDC ACM + CDC NCM
+  *          assembled by the composite builder.
+  ******************************************************************************
+  * @attention
+  *
+  * Test harness of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_host_model.h"
+#include "usbd_ctlreq.h"
+#include "usbd_cdc_ncm.h"
+#include "usbd_cdc_ncm_if_template.h"
+#ifdef USE_USBD_COMPOSITE
+#include "usbd_composite_builder.h"
+#endif /* USE_USBD_COMPOSITE */
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/stats.h"
+#include "lwip/timeouts.h"
+#include "netif/ethernet.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_DEV_ADDRESS                5U
+#define TEST_ECHO_ID                    0x4E43U
+#define TEST_ECHO_MAX                   1024U
+#define TEST_FRAME_MAX                  1536U
+#define TEST_NTB_MAX                    CDC_NCM_NTB_OUT_MAX_SIZE
+#define TEST_BURST_MAX                  24U
+
+#define TEST_ETH_HLEN                   14U
+#define TEST_IP_HLEN                    20U
+#define TEST_ECHO_HLEN                  (TEST_ETH_HLEN + TEST_IP_HLEN + 8U)
+
+/* Layout of the IN NTBs, as the class builds them */
+#define TEST_IN_NDP_INDEX               CDC_NCM_NTH16_SIZE
+#define TEST_IN_DATAGRAM_INDEX          88U
+
+/* Private macro -------------------------------------------------------------*/
+#define TEST_CHECK(cond, ...)                                         \
+  do {                                                                \
+    if (!(cond))                                                      \
+    {                                                                 \
+      Failures++;                                                     \
+      printf("FAIL %s:%d: ", __func__, __LINE__);                     \
+      printf(__VA_ARGS__);                                            \
+      printf("\n");                                                   \
+    }                                                                 \
+  } while (0)
+
+#define TEST_ALIGN(x)                   (((x) + 3U) & ~3U)
+
+/* Private typedef -----------------------------------------------------------*/
+/* The NCM function found in the configuration descriptor */
+typedef struct
+{
+  uint8_t  CmdItf;
+  uint8_t  DataItf;
+  uint8_t  EpIn;
+  uint8_t  EpOut;
+  uint8_t  EpNotif;
+  uint16_t MaxPacket;
+  uint8_t  MacIndex;
+  uint32_t NtbInMaxSize;
+  uint16_t InSequence;                  /* expected wSequence of the next IN NTB */
+  uint16_t OutSequence;
+} TEST_NcmTypeDef;
+
+/* IN NTB traffic, for the aggregation figures */
+typedef struct
+{
+  uint32_t Ntbs;
+  uint32_t Datagrams;
+  uint32_t Bytes;
+} TEST_InStatsTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+USBD_HandleTypeDef USBD_Device;
+
+static uint32_t Failures;
+static uint32_t Ticks;
+static struct netif NetIf;
+static TEST_NcmTypeDef Ncm;
+static TEST_InStatsTypeDef InStats;
+
+static const uint8_t HostMac[6] = {0x00U, 0x02U, 0x02U, 0x03U, 0x00U, 0x00U};
+static const uint8_t DevMac[6] = {CDC_NCM_MAC_ADDR0, CDC_NCM_MAC_ADDR1, CDC_NCM_MAC_ADDR2,
+                                  CDC_NCM_MAC_ADDR3, CDC_NCM_MAC_ADDR4, CDC_NCM_MAC_ADDR5
+                                 };
+static const uint8_t HostIp[4] = {192U, 168U, 7U, 2U};
+static const uint8_t DevIp[4] = {192U, 168U, 7U, 1U};
+
+/* Replies received per echo sequence number */
+static uint8_t EchoReplies[TEST_ECHO_MAX];
+static uint32_t EchoPayload[TEST_ECHO_MAX];
+static uint32_t ArpReplies;
+static uint32_t GratuitousArps;
+static uint32_t OtherFrames;
+
+static uint8_t Frames[TEST_BURST_MAX][TEST_FRAME_MAX];
+static uint16_t FrameLen[TEST_BURST_MAX];
+static uint8_t OutNtb[TEST_NTB_MAX];
+static uint8_t InNtb[CDC_NCM_NTB_IN_MAX_SIZE];
+
+/* Device descriptors ------------------------------------------------------- */
+__ALIGN_BEGIN static uint8_t DeviceDesc[USB_LEN_DEV_DESC] __ALIGN_END =
+{
+  0x12, USB_DESC_TYPE_DEVICE, 0x00, 0x02,
+  0xEF, 0x02, 0x01,                     /* IAD */
+  USB_MAX_EP0_SIZE,
+  0x83, 0x04, 0x40, 0x57,               /* VID 0x0483, PID 0x5740 */
+  0x00, 0x02, 1U, 2U, 3U, 1U
+};
+
+__ALIGN_BEGIN static uint8_t LangIdDesc[USB_LEN_LANGID_STR_DESC] __ALIGN_END =
+{
+  USB_LEN_LANGID_STR_DESC, USB_DESC_TYPE_STRING, 0x09, 0x04
+};
+
+__ALIGN_BEGIN static uint8_t StrDesc[USBD_MAX_STR_DESC_SIZ] __ALIGN_END;
+
+/* CDC ACM function of the composite device ----------------------------------*/
+#ifdef USE_USBD_COMPOSITE
+static uint8_t AcmRxBuffer[CDC_DATA_FS_MAX_PACKET_SIZE];
+static uint8_t AcmTxBuffer[CDC_DATA_FS_MAX_PACKET_SIZE];
+static uint8_t AcmLineCoding[7] = {0x00U, 0xC2U, 0x01U, 0x00U, 0x00U, 0x00U, 0x08U};
+static uint8_t NcmEpAdd[3] = {0x83U, 0x03U, 0x84U};
+static uint8_t AcmEpAdd[3] = {0x81U, 0x01U, 0x82U};
+#endif /* USE_USBD_COMPOSITE */
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t *Desc_Device(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_LangId(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Manufacturer(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Product(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Serial(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Config(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Interface(USBD_SpeedTypeDef speed, uint16_t *length);
+
+static USBD_DescriptorsTypeDef TestDesc =
+{
+  Desc_Device,
+  Desc_LangId,
+  Desc_Manufacturer,
+  Desc_Product,
+  Desc_Serial,
+  Desc_Config,
+  Desc_Interface,
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint8_t *Desc_Device(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(DeviceDesc);
+  return DeviceDesc;
+}
+
+static uint8_t *Desc_LangId(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(LangIdDesc);
+  return LangIdDesc;
+}
+
+static uint8_t *Desc_Manufacturer(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"STMicroelectronics", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Product(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"CDC NCM host test", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Serial(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"00000000001A", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Config(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"NCM Config", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Interface(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"NCM Interface", StrDesc, length);
+  return StrDesc;
+}
+
+#ifdef USE_USBD_COMPOSITE
+static int8_t Acm_Init(void)
+{
+  (void)USBD_CDC_SetTxBuffer(&USBD_Device, AcmTxBuffer, 0U);
+  (void)USBD_CDC_SetRxBuffer(&USBD_Device, AcmRxBuffer);
+  return (0);
+}
+
+static int8_t Acm_DeInit(void)
+{
+  return (0);
+}
+
+static int8_t Acm_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  if ((cmd == CDC_GET_LINE_CODING) && (length >= sizeof(AcmLineCoding)))
+  {
+    (void)memcpy(pbuf, AcmLineCoding, sizeof(AcmLineCoding));
+  }
+  return (0);
+}
+
+static int8_t Acm_Receive(uint8_t *pbuf, uint32_t *Len)
+{
+  UNUSED(pbuf);
+  UNUSED(Len);
+  (void)USBD_CDC_ReceivePacket(&USBD_Device);
+  return (0);
+}
+
+static USBD_CDC_ItfTypeDef AcmFops =
+{
+  Acm_Init,
+  Acm_DeInit,
+  Acm_Control,
+  Acm_Receive,
+  NULL,
+};
+#endif /* USE_USBD_COMPOSITE */
+
+/**
+  * @brief  sys_now
+  *         lwIP time base, one millisecond per main loop pass
+  */
+u32_t sys_now(void)
+{
+  return Ticks;
+}
+
+static uint16_t Get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t Get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void Put16(uint8_t *p, uint16_t v)
+{
+  p[0] = LOBYTE(v);
+  p[1] = HIBYTE(v);
+}
+
+static void Put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t Checksum(const uint8_t *p, uint32_t len)
+{
+  uint32_t sum = 0U;
+  uint32_t idx;
+
+  for (idx = 0U; (idx + 1U) < len; idx += 2U)
+  {
+    sum += ((uint32_t)p[idx] << 8) | p[idx + 1U];
+  }
+  if ((len & 1U) != 0U)
+  {
+    sum += (uint32_t)p[len - 1U] << 8;
+  }
+  while ((sum >> 16) != 0U)
+  {
+    sum = (sum & 0xFFFFU) + (sum >> 16);
+  }
+
+  return (uint16_t)~sum;
+}
+
+static uint8_t EchoByte(uint16_t seq, uint32_t idx)
+{
+  return (uint8_t)((idx * 7U) + seq);
+}
+
+/**
+  * @brief  Device_Poll
+  *         One pass of the device main loop: the NCM interface and the lwIP timers
+  */
+static void Device_Poll(void)
+{
+#ifdef USE_USBD_COMPOSITE
+  /* As if the last interrupt served the CDC ACM function */
+  (void)USBD_CMPSIT_SetClassID(&USBD_Device, CLASS_TYPE_CDC, 0U);
+#endif /* USE_USBD_COMPOSITE */
+  (void)USBD_CDC_NCM_fops.Process(&USBD_Device);
+
+#ifdef USE_USBD_COMPOSITE
+  (void)USBD_CMPSIT_SetClassID(&USBD_Device, CLASS_TYPE_CDC, 0U);
+#endif /* USE_USBD_COMPOSITE */
+  sys_check_timeouts();
+  Ticks++;
+}
+
+/**
+  * @brief  Host_EchoRequest
+  *         Build an Ethernet frame with an ICMP echo request to the device
+  * @retval frame length
+  */
+static uint16_t Host_EchoRequest(uint8_t *f, uint16_t seq, uint32_t payload)
+{
+  uint8_t *ip = &f[TEST_ETH_HLEN];
+  uint8_t *icmp = &ip[TEST_IP_HLEN];
+  uint32_t idx;
+
+  (void)memcpy(&f[0], DevMac, 6U);
+  (void)memcpy(&f[6], HostMac, 6U);
+  f[12] = 0x08U;
+  f[13] = 0x00U;
+
+  (void)memset(ip, 0, TEST_IP_HLEN);
+  ip[0] = 0x45U;
+  ip[2] = HIBYTE(TEST_IP_HLEN + 8U + payload);
+  ip[3] = LOBYTE(TEST_IP_HLEN + 8U + payload);
+  ip[4] = HIBYTE(seq);
+  ip[5] = LOBYTE(seq);
+  ip[8] = 64U;
+  ip[9] = 1U;
+  (void)memcpy(&ip[12], HostIp, 4U);
+  (void)memcpy(&ip[16], DevIp, 4U);
+  ip[10] = HIBYTE(Checksum(ip, TEST_IP_HLEN));
+  ip[11] = LOBYTE(Checksum(ip, TEST_IP_HLEN));
+
+  icmp[0] = 8U;
+  icmp[1] = 0U;
+  icmp[2] = 0U;
+  icmp[3] = 0U;
+  icmp[4] = HIBYTE(TEST_ECHO_ID);
+  icmp[5] = LOBYTE(TEST_ECHO_ID);
+  icmp[6] = HIBYTE(seq);
+  icmp[7] = LOBYTE(seq);
+  for (idx = 0U; idx < payload; idx++)
+  {
+    icmp[8U + idx] = EchoByte(seq, idx);
+  }
+  idx = Checksum(icmp, 8U + payload);
+  icmp[2] = HIBYTE(idx);
+  icmp[3] = LOBYTE(idx);
+
+  EchoReplies[seq % TEST_ECHO_MAX] = 0U;
+  EchoPayload[seq % TEST_ECHO_MAX] = payload;
+
+  return (uint16_t)(TEST_ECHO_HLEN + payload);
+}
+
+/**
+  * @brief  Host_ArpRequest
+  *         Build an ARP request for the address of the device
+  * @retval frame length
+  */
+static uint16_t Host_ArpRequest(uint8_t *f)
+{
+  (void)memset(f, 0, 60U);
+  (void)memset(&f[0], 0xFF, 6U);
+  (void)memcpy(&f[6], HostMac, 6U);
+  f[12] = 0x08U;
+  f[13] = 0x06U;
+  f[15] = 0x01U;                        /* Ethernet */
+  f[16] = 0x08U;                        /* IPv4 */
+  f[18] = 6U;
+  f[19] = 4U;
+  f[21] = 0x01U;                        /* request */
+  (void)memcpy(&f[22], HostMac, 6U);
+  (void)memcpy(&f[28], HostIp, 4U);
+  (void)memcpy(&f[38], DevIp, 4U);
+
+  return 60U;
+}
+
+/**
+  * @brief  Host_Rx
+  *         Check a frame received from the device
+  */
+static void Host_Rx(const uint8_t *f, uint16_t len)
+{
+  const uint8_t *ip = &f[TEST_ETH_HLEN];
+  const uint8_t *icmp = &ip[TEST_IP_HLEN];
+  uint16_t seq;
+  uint32_t payload;
+  uint32_t idx;
+
+  TEST_CHECK(len >= TEST_ETH_HLEN, "runt frame of %u bytes", len);
+  if (len < TEST_ETH_HLEN)
+  {
+    return;
+  }
+
+  if ((f[12] == 0x08U) && (f[13] == 0x06U))
+  {
+    /* lwIP announces its address when the link comes up */
+    if ((len >= 42U) && (f[21] == 0x01U) && (memcmp(&f[28], DevIp, 4U) == 0) && (memcmp(&f[38], DevIp, 4U) == 0))
+    {
+      TEST_CHECK(memcmp(&f[22], DevMac, 6U) == 0, "gratuitous ARP sender MAC");
+      GratuitousArps++;
+      return;
+    }
+
+    TEST_CHECK((len >= 42U) && (f[21] == 0x02U) && (memcmp(&f[22], DevMac, 6U) == 0) &&
+               (memcmp(&f[28], DevIp, 4U) == 0) && (memcmp(&f[32], HostMac, 6U) == 0) &&
+               (memcmp(&f[0], HostMac, 6U) == 0), "unexpected ARP frame");
+    ArpReplies++;
+    return;
+  }
+
+  if ((f[12] != 0x08U) || (f[13] != 0x00U) || (len < TEST_ECHO_HLEN) || (ip[9] != 1U) || (icmp[0] != 0U))
+  {
+    OtherFrames++;
+    return;
+  }
+
+  seq = (uint16_t)((icmp[6] << 8) | icmp[7]);
+  payload = (uint32_t)len - TEST_ECHO_HLEN;
+
+  TEST_CHECK((memcmp(&f[0], HostMac, 6U) == 0) && (memcmp(&f[6], DevMac, 6U) == 0), "echo reply %u: MAC", seq);
+  TEST_CHECK((memcmp(&ip[12], DevIp, 4U) == 0) && (memcmp(&ip[16], HostIp, 4U) == 0), "echo reply %u: IP", seq);
+  TEST_CHECK(Checksum(ip, TEST_IP_HLEN) == 0U, "echo reply %u: IP checksum", seq);
+  TEST_CHECK(Checksum(icmp, 8U + payload) == 0U, "echo reply %u: ICMP checksum", seq);
+  TEST_CHECK(((icmp[4] << 8) | icmp[5]) == TEST_ECHO_ID, "echo reply %u: identifier", seq);
+  TEST_CHECK(payload == EchoPayload[seq % TEST_ECHO_MAX], "echo reply %u: %u bytes of payload, %u sent", seq,
+             payload, EchoPayload[seq % TEST_ECHO_MAX]);
+
+  for (idx = 0U; idx < payload; idx++)
+  {
+    if (icmp[8U + idx] != EchoByte(seq, idx))
+    {
+      TEST_CHECK(0, "echo reply %u: payload differs at byte %u", seq, idx);
+      break;
+    }
+  }
+
+  EchoReplies[seq % TEST_ECHO_MAX]++;
+}
+
+/**
+  * @brief  Host_BuildNtb
+  *         Build an OUT NTB16: NTH16, the datagrams aligned on wNdpOutDivisor,
+  *         then the NDPs, the datagrams shared among them
+  * @param  pNtb: NTB buffer
+  * @param  count: number of datagrams, from Frames[]
+  * @param  ndps: number of NDPs
+  * @retval NTB length
+  */
+static uint32_t Host_BuildNtb(uint8_t *pNtb, uint32_t count, uint32_t ndps)
+{
+  uint32_t offset = CDC_NCM_NTH16_SIZE;
+  uint32_t index[TEST_BURST_MAX];
+  uint32_t ndp;
+  uint32_t first;
+  uint32_t last;
+  uint32_t entry;
+  uint32_t idx;
+  uint32_t next;
+  uint32_t ndp_index;
+
+  (void)memset(pNtb, 0, TEST_NTB_MAX);
+
+  for (idx = 0U; idx < count; idx++)
+  {
+    offset = TEST_ALIGN(offset);
+    index[idx] = offset;
+    (void)memcpy(&pNtb[offset], Frames[idx], FrameLen[idx]);
+    offset += FrameLen[idx];
+  }
+
+  ndp_index = TEST_ALIGN(offset);
+  Put32(&pNtb[0], CDC_NCM_NTH16_SIGNATURE);
+  Put16(&pNtb[4], (uint16_t)CDC_NCM_NTH16_SIZE);
+  Put16(&pNtb[6], Ncm.OutSequence++);
+  Put16(&pNtb[10], (uint16_t)ndp_index);
+
+  for (ndp = 0U; ndp < ndps; ndp++)
+  {
+    first = (count * ndp) / ndps;
+    last = (count * (ndp + 1U)) / ndps;
+    offset = ndp_index;
+
+    Put32(&pNtb[offset], CDC_NCM_NDP16_SIGNATURE);
+    Put16(&pNtb[offset + 4U], (uint16_t)(CDC_NCM_NDP16_HEADER_SIZE +
+                                         ((last - first + 1U) * CDC_NCM_NDP16_ENTRY_SIZE)));
+    entry = offset + CDC_NCM_NDP16_HEADER_SIZE;
+
+    for (idx = first; idx < last; idx++)
+    {
+      Put16(&pNtb[entry], (uint16_t)index[idx]);
+      Put16(&pNtb[entry + 2U], FrameLen[idx]);
+      entry += CDC_NCM_NDP16_ENTRY_SIZE;
+    }
+    entry += CDC_NCM_NDP16_ENTRY_SIZE;                      /* null entry */
+
+    next = ((ndp + 1U) < ndps) ? TEST_ALIGN(entry) : 0U;
+    Put16(&pNtb[offset + 6U], (uint16_t)next);
+    ndp_index = next;
+    offset = entry;
+  }
+
+  Put16(&pNtb[8], (uint16_t)offset);
+
+  return offset;
+}
+
+/**
+  * @brief  Host_SendFrames
+  *         Send Frames[0..count-1] in one OUT NTB
+  * @retval HOST_BulkOut result
+  */
+static int Host_SendFrames(uint32_t count, uint32_t ndps)
+{
+  uint32_t len = Host_BuildNtb(OutNtb, count, ndps);
+
+  return HOST_BulkOut(&USBD_Device, Ncm.EpOut, OutNtb, len);
+}
+
+/**
+  * @brief  Host_CheckInNtb
+  *         Check the framing of an IN NTB and hand its datagrams to Host_Rx
+  * @retval number of datagrams
+  */
+static uint32_t Host_CheckInNtb(const uint8_t *pNtb, uint32_t len)
+{
+  uint32_t ndp;
+  uint32_t ndp_len;
+  uint32_t entry;
+  uint32_t index;
+  uint32_t dlen;
+  uint32_t count = 0U;
+
+  TEST_CHECK((len >= CDC_NCM_NTH16_SIZE) && (len <= Ncm.NtbInMaxSize), "IN NTB of %u bytes", len);
+  if (len < (CDC_NCM_NTH16_SIZE + CDC_NCM_NDP16_MIN_SIZE))
+  {
+    return 0U;
+  }
+
+  TEST_CHECK(Get32(&pNtb[0]) == CDC_NCM_NTH16_SIGNATURE, "NTH16 signature");
+  TEST_CHECK(Get16(&pNtb[4]) == CDC_NCM_NTH16_SIZE, "NTH16 header length");
+  TEST_CHECK(Get16(&pNtb[6]) == Ncm.InSequence, "NTB sequence %u, %u expected", Get16(&pNtb[6]), Ncm.InSequence);
+  TEST_CHECK(Get16(&pNtb[8]) == len, "wBlockLength %u, transfer of %u bytes", Get16(&pNtb[8]), len);
+  Ncm.InSequence = (uint16_t)(Get16(&pNtb[6]) + 1U);
+
+  ndp = Get16(&pNtb[10]);
+  TEST_CHECK(((ndp % 4U) == 0U) && ((ndp + CDC_NCM_NDP16_MIN_SIZE) <= len), "wNdpIndex %u", ndp);
+  if (((ndp % 4U) != 0U) || ((ndp + CDC_NCM_NDP16_MIN_SIZE) > len))
+  {
+    return 0U;
+  }
+
+  ndp_len = Get16(&pNtb[ndp + 4U]);
+  TEST_CHECK(Get32(&pNtb[ndp]) == CDC_NCM_NDP16_SIGNATURE, "NDP16 signature");
+  TEST_CHECK((ndp_len >= CDC_NCM_NDP16_MIN_SIZE) && ((ndp_len % 4U) == 0U) && ((ndp + ndp_len) <= len),
+             "wLength %u of the NDP16", ndp_len);
+  TEST_CHECK(Get16(&pNtb[ndp + 6U]) == 0U, "wNextNdpIndex of a single NDP");
+
+  for (entry = ndp + CDC_NCM_NDP16_HEADER_SIZE; (entry + 4U) <= (ndp + ndp_len); entry += 4U)
+  {
+    index = Get16(&pNtb[entry]);
+    dlen = Get16(&pNtb[entry + 2U]);
+
+    if ((index == 0U) || (dlen == 0U))
+    {
+      TEST_CHECK((entry + 4U) == (ndp + ndp_len), "null entry before the end of the NDP16");
+      break;
+    }
+
+    /* wNdpInDivisor 4, wNdpInPayloadRemainder 0, after the NDP16 */
+    TEST_CHECK(((index % 4U) == 0U) && (index >= (ndp + ndp_len)) && ((index + dlen) <= len),
+               "datagram at %u of %u bytes", index, dlen);
+    if ((index + dlen) <= len)
+    {
+      Host_Rx(&pNtb[index], (uint16_t)dlen);
+      count++;
+    }
+  }
+
+  TEST_CHECK(count != 0U, "IN NTB without datagram");
+
+  return count;
+}
+
+/**
+  * @brief  Host_ReadIn
+  *         Read the IN NTBs until the endpoint NAKs
+  * @retval number of NTBs read
+  */
+static uint32_t Host_ReadIn(void)
+{
+  uint32_t ntbs = 0U;
+  int len;
+
+  for (;;)
+  {
+    len = HOST_BulkIn(&USBD_Device, Ncm.EpIn, InNtb, Ncm.NtbInMaxSize);
+
+    if (len == HOST_NAK)
+    {
+      break;
+    }
+
+    TEST_CHECK(len > 0, "IN transfer result %d", len);
+    if (len <= 0)
+    {
+      break;
+    }
+
+    InStats.Ntbs++;
+    InStats.Bytes += (uint32_t)len;
+    InStats.Datagrams += Host_CheckInNtb(InNtb, (uint32_t)len);
+    ntbs++;
+  }
+
+  return ntbs;
+}
+
+/**
+  * @brief  Host_Echo
+  *         Send a burst of echo requests in one NTB, let the device answer and
+  *         read the answers
+  * @param  seq: sequence number of the first request
+  * @param  count: number of requests
+  * @param  payload: payload of each request, a list of count values
+  * @param  ndps: number of NDPs of the OUT NTB
+  * @retval number of IN NTBs that carried the replies
+  */
+static uint32_t Host_Echo(uint16_t seq, uint32_t count, const uint32_t *payload, uint32_t ndps)
+{
+  uint32_t idx;
+  int ret;
+
+  for (idx = 0U; idx < count; idx++)
+  {
+    FrameLen[idx] = Host_EchoRequest(Frames[idx], (uint16_t)(seq + idx), payload[idx]);
+  }
+
+  ret = Host_SendFrames(count, ndps);
+  TEST_CHECK(ret > 0, "OUT NTB result %d", ret);
+
+  Device_Poll();
+
+  return Host_ReadIn();
+}
+
+static uint32_t Host_EchoMissing(uint16_t seq, uint32_t count)
+{
+  uint32_t idx;
+  uint32_t missing = 0U;
+
+  for (idx = 0U; idx < count; idx++)
+  {
+    if (EchoReplies[(seq + idx) % TEST_ECHO_MAX] != 1U)
+    {
+      missing++;
+    }
+  }
+
+  return missing;
+}
+
+/**
+  * @brief  Test_ParseConfig
+  *         Find the NCM function in the configuration descriptor
+  */
+static void Test_ParseConfig(const uint8_t *cfg, uint32_t len)
+{
+  uint32_t ofs = 0U;
+  uint8_t cur_itf = 0xFFU;
+  uint8_t cur_alt = 0U;
+  uint8_t cur_class = 0U;
+  uint8_t found_header = 0U;
+  uint8_t found_union = 0U;
+  uint8_t found_eth = 0U;
+  uint8_t found_ncm = 0U;
+  uint8_t found_alt0 = 0U;
+  uint8_t found_alt1 = 0U;
+
+  (void)memset(&Ncm, 0, sizeof(Ncm));
+  Ncm.CmdItf = 0xFFU;
+  Ncm.DataItf = 0xFFU;
+
+  while ((ofs + 2U) <= len)
+  {
+    const uint8_t *d = &cfg[ofs];
+
+    if ((d[0] < 2U) || ((ofs + d[0]) > len))
+    {
+      TEST_CHECK(0, "descriptor of %u bytes at offset %u", d[0], ofs);
+      return;
+    }
+
+    switch (d[1])
+    {
+      case USB_DESC_TYPE_INTERFACE:
+        cur_itf = d[2];
+        cur_alt = d[3];
+        cur_class = d[5];
+        if ((d[5] == 0x02U) && (d[6] == 0x0DU))
+        {
+          Ncm.CmdItf = d[2];
+          TEST_CHECK(d[4] == 1U, "NCM communication interface with %u endpoints", d[4]);
+        }
+        else if ((d[5] == 0x0AU) && (cur_itf == (uint8_t)(Ncm.CmdItf + 1U)))
+        {
+          TEST_CHECK(d[7] == 0x01U, "NCM data interface protocol %u", d[7]);
+          Ncm.DataItf = d[2];
+          if (d[3] == 0U)
+          {
+            TEST_CHECK(d[4] == 0U, "NCM data interface alternate setting 0 with %u endpoints", d[4]);
+            found_alt0 = 1U;
+          }
+          else
+          {
+            TEST_CHECK((d[3] == 1U) && (d[4] == 2U), "NCM data interface alternate setting %u with %u endpoints",
+                       d[3], d[4]);
+            found_alt1 = 1U;
+          }
+        }
+        else
+        {
+          /* another function */
+        }
+        break;
+
+      case 0x24U:
+        if (cur_itf == Ncm.CmdItf)
+        {
+          switch (d[2])
+          {
+            case 0x00U:
+              TEST_CHECK((d[0] == 5U) && (Get16(&d[3]) == 0x0110U), "CDC header functional descriptor");
+              found_header = 1U;
+              break;
+
+            case 0x06U:
+              TEST_CHECK((d[0] == 5U) && (d[3] == Ncm.CmdItf) && (d[4] == (uint8_t)(Ncm.CmdItf + 1U)),
+                         "union functional descriptor %u/%u", d[3], d[4]);
+              found_union = 1U;
+              break;
+
+            case 0x0FU:
+              TEST_CHECK((d[0] == 13U) && (Get16(&d[8]) == CDC_NCM_ETH_MAX_SEGSZE),
+                         "Ethernet networking functional descriptor");
+              Ncm.MacIndex = d[3];
+              found_eth = 1U;
+              break;
+
+            case 0x1AU:
+              TEST_CHECK((d[0] == 6U) && (Get16(&d[3]) == 0x0100U), "NCM functional descriptor");
+              found_ncm = 1U;
+              break;
+
+            default:
+              TEST_CHECK(0, "functional descriptor subtype 0x%02X in the NCM function", d[2]);
+              break;
+          }
+        }
+        break;
+
+      case USB_DESC_TYPE_ENDPOINT:
+        if ((cur_itf == Ncm.CmdItf) && (cur_class == 0x02U))
+        {
+          TEST_CHECK(((d[2] & 0x80U) != 0U) && (d[3] == 0x03U) && (Get16(&d[4]) == CDC_NCM_CMD_PACKET_SIZE),
+                     "notification endpoint 0x%02X", d[2]);
+          Ncm.EpNotif = d[2];
+        }
+        else if ((cur_itf == Ncm.DataItf) && (cur_alt == 1U))
+        {
+          TEST_CHECK(d[3] == 0x02U, "NCM data endpoint 0x%02X type %u", d[2], d[3]);
+          Ncm.MaxPacket = Get16(&d[4]);
+          if ((d[2] & 0x80U) != 0U)
+          {
+            Ncm.EpIn = d[2];
+          }
+          else
+          {
+            Ncm.EpOut = d[2];
+          }
+        }
+        else
+        {
+          /* endpoint of another function */
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    ofs += d[0];
+  }
+
+  TEST_CHECK(found_header && found_union && found_eth && found_ncm, "NCM functional descriptors missing");
+  TEST_CHECK(found_alt0 && found_alt1, "NCM data interface alternate settings missing");
+  TEST_CHECK((Ncm.EpIn != 0U) && (Ncm.EpOut != 0U) && (Ncm.EpNotif != 0U), "NCM endpoints missing");
+  TEST_CHECK(Ncm.MaxPacket == CDC_NCM_DATA_FS_MAX_PACKET_SIZE, "bulk max packet size %u", Ncm.MaxPacket);
+}
+
+/**
+  * @brief  Test_Enumerate
+  *         Reset, address, descriptors and configuration
+  */
+static void Test_Enumerate(void)
+{
+  uint8_t buf[512];
+  uint16_t total;
+  uint32_t idx;
+  int ret;
+
+  HOST_Attach(&USBD_Device);
+
+  ret = HOST_Control(&USBD_Device, 0x80U, USB_REQ_GET_DESCRIPTOR, 0x0100U, 0U, 64U, buf);
+  TEST_CHECK((ret == USB_LEN_DEV_DESC) && (buf[7] == USB_MAX_EP0_SIZE), "device descriptor: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x00U, USB_REQ_SET_ADDRESS, TEST_DEV_ADDRESS, 0U, 0U, NULL);
+  TEST_CHECK((ret == 0) && (USBD_Device.dev_state == USBD_STATE_ADDRESSED), "SET_ADDRESS: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x80U, USB_REQ_GET_DESCRIPTOR, 0x0200U, 0U, 9U, buf);
+  TEST_CHECK(ret == 9, "configuration descriptor header: %d", ret);
+  total = Get16(&buf[2]);
+
+  ret = HOST_Control(&USBD_Device, 0x80U, USB_REQ_GET_DESCRIPTOR, 0x0200U, 0U, sizeof(buf), buf);
+  TEST_CHECK(ret == (int)total, "configuration descriptor: %d bytes, wTotalLength %u", ret, total);
+  if (ret > 0)
+  {
+    Test_ParseConfig(buf, (uint32_t)ret);
+  }
+
+#ifdef USE_USBD_COMPOSITE
+  TEST_CHECK(buf[4] == 4U, "bNumInterfaces %u", buf[4]);
+  TEST_CHECK((Ncm.CmdItf == 2U) && (Ncm.DataItf == 3U), "NCM interfaces %u/%u after CDC ACM",
+             Ncm.CmdItf, Ncm.DataItf);
+  TEST_CHECK((Ncm.EpIn == NcmEpAdd[0]) && (Ncm.EpOut == NcmEpAdd[1]) && (Ncm.EpNotif == NcmEpAdd[2]),
+             "NCM endpoints 0x%02X 0x%02X 0x%02X", Ncm.EpIn, Ncm.EpOut, Ncm.EpNotif);
+#else
+  TEST_CHECK((Ncm.CmdItf == CDC_NCM_CMD_ITF_NBR) && (Ncm.DataItf == CDC_NCM_COM_ITF_NBR), "NCM interfaces %u/%u",
+             Ncm.CmdItf, Ncm.DataItf);
+#endif /* USE_USBD_COMPOSITE */
+
+  /* MAC address string of the host side interface */
+  ret = HOST_Control(&USBD_Device, 0x80U, USB_REQ_GET_DESCRIPTOR, (uint16_t)(0x0300U | Ncm.MacIndex), 0x0409U,
+                     255U, buf);
+  TEST_CHECK((ret == 26) && (buf[0] == 26U) && (buf[1] == USB_DESC_TYPE_STRING), "MAC string: %d", ret);
+  for (idx = 0U; (ret == 26) && (idx < 12U); idx++)
+  {
+    TEST_CHECK(buf[2U + (2U * idx)] == (CDC_NCM_MAC_STR_DESC)[idx], "MAC string character %u", idx);
+  }
+
+  /* Nothing moves before the configuration */
+  TEST_CHECK(HOST_BulkIn(&USBD_Device, Ncm.EpNotif, buf, 16U) == HOST_NAK, "notification before SET_CONFIGURATION");
+
+  ret = HOST_Control(&USBD_Device, 0x00U, USB_REQ_SET_CONFIGURATION, 1U, 0U, 0U, NULL);
+  TEST_CHECK((ret == 0) && (USBD_Device.dev_state == USBD_STATE_CONFIGURED), "SET_CONFIGURATION: %d", ret);
+}
+
+/**
+  * @brief  Test_NtbRequests
+  *         NCM class requests before the data interface is selected
+  */
+static void Test_NtbRequests(void)
+{
+  uint8_t buf[64];
+  int ret;
+
+  ret = HOST_Control(&USBD_Device, 0xA1U, CDC_NCM_GET_NTB_PARAMETERS, 0U, Ncm.CmdItf, 28U, buf);
+  TEST_CHECK(ret == 28, "GET_NTB_PARAMETERS: %d", ret);
+  TEST_CHECK((Get16(&buf[0]) == 28U) && (Get16(&buf[2]) == CDC_NCM_NTB16_FORMAT_SUPPORTED), "NTB formats");
+  TEST_CHECK(Get32(&buf[4]) == CDC_NCM_NTB_IN_MAX_SIZE, "dwNtbInMaxSize %u", Get32(&buf[4]));
+  TEST_CHECK((Get16(&buf[8]) == 4U) && (Get16(&buf[10]) == 0U) && (Get16(&buf[12]) == 4U), "IN alignment");
+  TEST_CHECK(Get32(&buf[16]) == CDC_NCM_NTB_OUT_MAX_SIZE, "dwNtbOutMaxSize %u", Get32(&buf[16]));
+  TEST_CHECK((Get16(&buf[20]) == CDC_NCM_NDP_OUT_DIVISOR) && (Get16(&buf[22]) == CDC_NCM_NDP_OUT_PAYLOAD_REMAINDER) &&
+             (Get16(&buf[24]) == 4U), "OUT alignment");
+
+  ret = HOST_Control(&USBD_Device, 0xA1U, CDC_NCM_GET_NTB_FORMAT, 0U, Ncm.CmdItf, 2U, buf);
+  TEST_CHECK((ret == 2) && (Get16(buf) == CDC_NCM_NTB16_FORMAT), "GET_NTB_FORMAT: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x21U, CDC_NCM_SET_NTB_FORMAT, 1U, Ncm.CmdItf, 0U, NULL);
+  TEST_CHECK(ret == HOST_STALL, "SET_NTB_FORMAT NTB32 not refused: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x21U, CDC_NCM_SET_NTB_FORMAT, 0U, Ncm.CmdItf, 0U, NULL);
+  TEST_CHECK(ret == 0, "SET_NTB_FORMAT NTB16: %d", ret);
+
+  /* Below the 2048 bytes minimum: ignored */
+  Put32(buf, 1024U);
+  ret = HOST_Control(&USBD_Device, 0x21U, CDC_NCM_SET_NTB_INPUT_SIZE, 0U, Ncm.CmdItf, 4U, buf);
+  TEST_CHECK(ret == 4, "SET_NTB_INPUT_SIZE: %d", ret);
+  ret = HOST_Control(&USBD_Device, 0xA1U, CDC_NCM_GET_NTB_INPUT_SIZE, 0U, Ncm.CmdItf, 4U, buf);
+  TEST_CHECK((ret == 4) && (Get32(buf) == CDC_NCM_NTB_IN_MAX_SIZE), "NTB input size %u after 1024", Get32(buf));
+
+  Put32(buf, 2048U);
+  ret = HOST_Control(&USBD_Device, 0x21U, CDC_NCM_SET_NTB_INPUT_SIZE, 0U, Ncm.CmdItf, 4U, buf);
+  TEST_CHECK(ret == 4, "SET_NTB_INPUT_SIZE: %d", ret);
+  ret = HOST_Control(&USBD_Device, 0xA1U, CDC_NCM_GET_NTB_INPUT_SIZE, 0U, Ncm.CmdItf, 4U, buf);
+  TEST_CHECK((ret == 4) && (Get32(buf) == 2048U), "NTB input size %u after 2048", Get32(buf));
+  Ncm.NtbInMaxSize = 2048U;
+
+  /* Alternate setting 0: no data endpoint */
+  ret = HOST_Control(&USBD_Device, 0x81U, USB_REQ_GET_INTERFACE, 0U, Ncm.DataItf, 1U, buf);
+  TEST_CHECK((ret == 1) && (buf[0] == 0U), "GET_INTERFACE: %d", ret);
+  TEST_CHECK(HOST_BulkOut(&USBD_Device, Ncm.EpOut, buf, 16U) == HOST_NAK, "OUT endpoint open in alternate setting 0");
+}
+
+/**
+  * @brief  Test_Connect
+  *         Select alternate setting 1 and read the two notifications
+  */
+static void Test_Connect(void)
+{
+  uint8_t buf[64];
+  int ret;
+
+  ret = HOST_Control(&USBD_Device, 0x01U, USB_REQ_SET_INTERFACE, 1U, Ncm.DataItf, 0U, NULL);
+  TEST_CHECK(ret == 0, "SET_INTERFACE 1: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x81U, USB_REQ_GET_INTERFACE, 0U, Ncm.DataItf, 1U, buf);
+  TEST_CHECK((ret == 1) && (buf[0] == 1U), "GET_INTERFACE after SET_INTERFACE 1");
+
+  ret = HOST_BulkIn(&USBD_Device, Ncm.EpNotif, buf, 16U);
+  TEST_CHECK((ret == 8) && (buf[0] == 0xA1U) && (buf[1] == NETWORK_CONNECTION) && (Get16(&buf[2]) == 1U) &&
+             (Get16(&buf[4]) == Ncm.CmdItf) && (Get16(&buf[6]) == 0U), "NETWORK_CONNECTION notification: %d", ret);
+
+  ret = HOST_BulkIn(&USBD_Device, Ncm.EpNotif, buf, 16U);
+  TEST_CHECK((ret == 16) && (buf[0] == 0xA1U) && (buf[1] == CONNECTION_SPEED_CHANGE) &&
+             (Get16(&buf[4]) == Ncm.CmdItf) && (Get16(&buf[6]) == 8U) &&
+             (Get32(&buf[8]) == CDC_NCM_CONNECT_SPEED_UPSTREAM) &&
+             (Get32(&buf[12]) == CDC_NCM_CONNECT_SPEED_DOWNSTREAM), "CONNECTION_SPEED_CHANGE notification: %d", ret);
+
+  TEST_CHECK(HOST_BulkIn(&USBD_Device, Ncm.EpNotif, buf, 16U) == HOST_NAK, "third notification");
+
+  /* The link comes up in the main loop, lwIP announces its address in the
+     first NTB of the new sequence */
+  Ncm.InSequence = 0U;
+  GratuitousArps = 0U;
+  Device_Poll();
+  TEST_CHECK(netif_is_link_up(&NetIf), "lwIP link down after SET_INTERFACE 1");
+  (void)Host_ReadIn();
+  TEST_CHECK(GratuitousArps == 1U, "%u gratuitous ARPs after SET_INTERFACE 1", GratuitousArps);
+}
+
+/**
+  * @brief  Test_Arp
+  *         The device answers the ARP request of the host
+  */
+static void Test_Arp(void)
+{
+  int ret;
+
+  ArpReplies = 0U;
+  FrameLen[0] = Host_ArpRequest(Frames[0]);
+  ret = Host_SendFrames(1U, 1U);
+  TEST_CHECK(ret > 0, "OUT NTB result %d", ret);
+
+  Device_Poll();
+  (void)Host_ReadIn();
+
+  TEST_CHECK(ArpReplies == 1U, "%u ARP replies", ArpReplies);
+}
+
+/**
+  * @brief  Test_EchoBursts
+  *         Bursts of echo requests in one OUT NTB: the first reply leaves at
+  *         once, the others are aggregated while it is on the bus
+  */
+static void Test_EchoBursts(void)
+{
+  static const uint32_t bursts[] = {1U, 2U, 4U, 8U, 12U, 16U, 17U};
+  uint32_t payload[TEST_BURST_MAX];
+  uint32_t idx;
+  uint32_t k;
+  uint32_t ntbs;
+  uint16_t seq = 100U;
+
+  printf("  burst  payload  NDPs  IN NTBs  datagrams/NTB\n");
+
+  for (idx = 0U; idx < (sizeof(bursts) / sizeof(bursts[0])); idx++)
+  {
+    for (k = 0U; k < bursts[idx]; k++)
+    {
+      payload[k] = 16U + ((k * 13U) % 48U);
+    }
+
+    InStats.Ntbs = 0U;
+    InStats.Datagrams = 0U;
+    ntbs = Host_Echo(seq, bursts[idx], payload, (bursts[idx] > 4U) ? 2U : 1U);
+
+    TEST_CHECK(Host_EchoMissing(seq, bursts[idx]) == 0U, "burst of %u: %u replies missing", bursts[idx],
+               Host_EchoMissing(seq, bursts[idx]));
+    TEST_CHECK(ntbs == ((bursts[idx] > 1U) ? 2U : 1U), "burst of %u: %u IN NTBs", bursts[idx], ntbs);
+
+    printf("  %5u  %7s  %4u  %7u  %13.1f\n", bursts[idx], "16-63", (bursts[idx] > 4U) ? 2U : 1U, ntbs,
+           (ntbs != 0U) ? ((double)InStats.Datagrams / ntbs) : 0.0);
+
+    seq = (uint16_t)(seq + bursts[idx]);
+  }
+
+  /* Large frames: the second NTB takes three of them within dwNtbInMaxSize,
+     88 + 644 + 644 + 642 = 2018 bytes */
+  for (k = 0U; k < 4U; k++)
+  {
+    payload[k] = 600U;
+  }
+  InStats.Bytes = 0U;
+  ntbs = Host_Echo(seq, 4U, payload, 1U);
+  TEST_CHECK(Host_EchoMissing(seq, 4U) == 0U, "large frames: %u replies missing", Host_EchoMissing(seq, 4U));
+  TEST_CHECK((ntbs == 2U) && (InStats.Bytes == (88U + 642U + 2018U)), "large frames: %u IN NTBs, %u bytes", ntbs,
+             InStats.Bytes);
+}
+
+/**
+  * @brief  Test_Zlp
+  *         IN NTBs that end on a packet boundary: a ZLP follows, except when the
+  *         NTB is dwNtbInMaxSize long
+  */
+static void Test_Zlp(void)
+{
+  uint32_t payload[3];
+  uint32_t len;
+  uint16_t seq = 400U;
+  int ret;
+
+  /* One datagram: 88 + 104 = 192 bytes, three full packets */
+  payload[0] = 104U - TEST_ECHO_HLEN;
+  FrameLen[0] = Host_EchoRequest(Frames[0], seq, payload[0]);
+  ret = Host_SendFrames(1U, 1U);
+  TEST_CHECK(ret > 0, "OUT NTB result %d", ret);
+  Device_Poll();
+
+  ret = HOST_BulkIn(&USBD_Device, Ncm.EpIn, InNtb, Ncm.NtbInMaxSize);
+  TEST_CHECK(ret == 192, "NTB of 192 bytes: transfer of %d bytes", ret);
+  if (ret > 0)
+  {
+    (void)Host_CheckInNtb(InNtb, (uint32_t)ret);
+  }
+  TEST_CHECK(HOST_BulkIn(&USBD_Device, Ncm.EpIn, InNtb, Ncm.NtbInMaxSize) == HOST_NAK, "extra IN transfer");
+  TEST_CHECK(EchoReplies[seq] == 1U, "reply of the 192 bytes NTB");
+
+  /* Three datagrams: the first one alone, the two others fill 2048 bytes exactly:
+     88 + 1000 + 960 */
+  seq++;
+  payload[0] = 64U;
+  payload[1] = 1000U - TEST_ECHO_HLEN;
+  payload[2] = 960U - TEST_ECHO_HLEN;
+  for (len = 0U; len < 3U; len++)
+  {
+    FrameLen[len] = Host_EchoRequest(Frames[len], (uint16_t)(seq + len), payload[len]);
+  }
+  ret = Host_SendFrames(3U, 1U);
+  TEST_CHECK(ret > 0, "OUT NTB result %d", ret);
+  Device_Poll();
+
+  ret = HOST_BulkIn(&USBD_Device, Ncm.EpIn, InNtb, Ncm.NtbInMaxSize);
+  TEST_CHECK(ret > 0, "first NTB: %d", ret);
+  if (ret > 0)
+  {
+    (void)Host_CheckInNtb(InNtb, (uint32_t)ret);
+  }
+
+  ret = HOST_BulkIn(&USBD_Device, Ncm.EpIn, InNtb, Ncm.NtbInMaxSize);
+  TEST_CHECK(ret == (int)Ncm.NtbInMaxSize, "NTB of dwNtbInMaxSize: transfer of %d bytes", ret);
+  if (ret > 0)
+  {
+    (void)Host_CheckInNtb(InNtb, (uint32_t)ret);
+  }
+  TEST_CHECK(HOST_BulkIn(&USBD_Device, Ncm.EpIn, InNtb, Ncm.NtbInMaxSize) == HOST_NAK,
+             "ZLP after an NTB of dwNtbInMaxSize");
+  TEST_CHECK(Host_EchoMissing(seq, 3U) == 0U, "%u replies missing", Host_EchoMissing(seq, 3U));
+}
+
+/**
+  * @brief  Test_OutFlowControl
+  *         The OUT endpoint takes CDC_NCM_RX_NTB_NBR NTBs, then NAKs until the
+  *         main loop has passed them to lwIP
+  */
+static void Test_OutFlowControl(void)
+{
+  uint32_t payload[4] = {32U, 32U, 32U, 32U};
+  uint32_t ntb;
+  uint32_t idx;
+  uint16_t seq = 500U;
+  int ret;
+
+  for (ntb = 0U; ntb < CDC_NCM_RX_NTB_NBR; ntb++)
+  {
+    for (idx = 0U; idx < 4U; idx++)
+    {
+      FrameLen[idx] = Host_EchoRequest(Frames[idx], (uint16_t)(seq + (ntb * 4U) + idx), payload[idx]);
+    }
+    ret = Host_SendFrames(4U, 1U);
+    TEST_CHECK(ret > 0, "NTB %u not taken: %d", ntb, ret);
+  }
+
+  FrameLen[0] = Host_EchoRequest(Frames[0], (uint16_t)(seq + (CDC_NCM_RX_NTB_NBR * 4U)), 32U);
+  ret = Host_SendFrames(1U, 1U);
+  TEST_CHECK(ret == HOST_NAK, "NTB taken with all the buffers in use: %d", ret);
+
+  Device_Poll();
+  ret = HOST_BulkOut(&USBD_Device, Ncm.EpOut, OutNtb, Get16(&OutNtb[8]));
+  TEST_CHECK(ret > 0, "OUT endpoint not restarted by the main loop: %d", ret);
+  Device_Poll();
+  (void)Host_ReadIn();
+
+  TEST_CHECK(Host_EchoMissing(seq, (CDC_NCM_RX_NTB_NBR * 4U) + 1U) == 0U, "%u replies missing",
+             Host_EchoMissing(seq, (CDC_NCM_RX_NTB_NBR * 4U) + 1U));
+}
+
+/**
+  * @brief  Test_InOverflow
+  *         More replies than one IN NTB holds while the previous one is still
+  *         on the bus: the device drops and counts the excess
+  */
+static void Test_InOverflow(void)
+{
+  uint32_t payload[TEST_BURST_MAX];
+  uint32_t drops = lwip_stats.link.drop;
+  uint32_t idx;
+  uint32_t missing;
+  uint16_t seq = 600U;
+
+  for (idx = 0U; idx < 20U; idx++)
+  {
+    payload[idx] = 16U;
+  }
+
+  (void)Host_Echo(seq, 20U, payload, 2U);
+  missing = Host_EchoMissing(seq, 20U);
+
+  TEST_CHECK(missing == (20U - 1U - CDC_NCM_NTB_IN_MAX_DATAGRAMS), "%u replies missing", missing);
+  TEST_CHECK((lwip_stats.link.drop - drops) == missing, "%u drops counted for %u replies missing",
+             lwip_stats.link.drop - drops, missing);
+}
+
+/**
+  * @brief  Test_Malformed
+  *         Broken OUT NTBs are dropped, the device keeps working
+  */
+static void Test_Malformed(void)
+{
+  static const char *const cases[] =
+  {
+    "short transfer", "NTH16 signature", "wHeaderLength", "wBlockLength past the transfer",
+    "NDP16 index not aligned", "NDP16 index past the block", "NDP16 signature", "NDP16 wLength too small",
+    "datagram past the block", "datagram in the NTH16", "NDP16 loop", "NDP16 wLength past the block",
+  };
+  uint32_t proterr = lwip_stats.link.proterr;
+  uint32_t idx;
+  uint32_t len;
+  uint32_t ndp;
+  uint16_t seq = 700U;
+  int ret;
+
+  for (idx = 0U; idx < (sizeof(cases) / sizeof(cases[0])); idx++)
+  {
+    FrameLen[0] = Host_EchoRequest(Frames[0], seq, 40U);
+    len = Host_BuildNtb(OutNtb, 1U, 1U);
+    ndp = Get16(&OutNtb[10]);
+
+    switch (idx)
+    {
+      case 0U:
+        len = 10U;
+        break;
+      case 1U:
+        OutNtb[3] ^= 0x01U;
+        break;
+      case 2U:
+        Put16(&OutNtb[4], 16U);
+        break;
+      case 3U:
+        Put16(&OutNtb[8], (uint16_t)(len + 4U));
+        break;
+      case 4U:
+        Put16(&OutNtb[10], (uint16_t)(ndp + 2U));
+        break;
+      case 5U:
+        Put16(&OutNtb[10], (uint16_t)(len + 4U));
+        break;
+      case 6U:
+        OutNtb[ndp + 3U] = '1';
+        break;
+      case 7U:
+        Put16(&OutNtb[ndp + 4U], 8U);
+        break;
+      case 8U:
+        Put16(&OutNtb[ndp + 10U], (uint16_t)len);
+        break;
+      case 9U:
+        Put16(&OutNtb[ndp + 8U], 4U);
+        break;
+      case 10U:
+        Put16(&OutNtb[ndp + 6U], (uint16_t)ndp);
+        break;
+      default:
+        Put16(&OutNtb[ndp + 4U], 0xFFF0U);
+        break;
+    }
+
+    ret = HOST_BulkOut(&USBD_Device, Ncm.EpOut, OutNtb, len);
+    TEST_CHECK(ret > 0, "%s: OUT result %d", cases[idx], ret);
+    Device_Poll();
+    (void)Host_ReadIn();
+
+    /* The NDP16 loop still delivers its datagram once per pass, up to the NDP limit */
+    if (idx == 10U)
+    {
+      TEST_CHECK(EchoReplies[seq] == CDC_NCM_NTB_OUT_MAX_NDP, "%s: %u replies", cases[idx], EchoReplies[seq]);
+    }
+    else
+    {
+      TEST_CHECK(EchoReplies[seq] == 0U, "%s: %u replies", cases[idx], EchoReplies[seq]);
+    }
+    seq++;
+
+    /* The next valid NTB is answered */
+    {
+      uint32_t one = 40U;
+
+      (void)Host_Echo(seq, 1U, &one, 1U);
+      TEST_CHECK(EchoReplies[seq] == 1U, "no reply after a %s error", cases[idx]);
+      seq++;
+    }
+  }
+
+  TEST_CHECK((lwip_stats.link.proterr - proterr) == 4U, "%u NTB header errors counted",
+             lwip_stats.link.proterr - proterr);
+}
+
+/**
+  * @brief  Test_AltSettingReset
+  *         Alternate setting 0 stops the data interface and restores the NTB
+  *         parameters, alternate setting 1 starts it again from sequence 0
+  */
+static void Test_AltSettingReset(void)
+{
+  uint8_t buf[8];
+  uint32_t one = 24U;
+  int ret;
+
+  ret = HOST_Control(&USBD_Device, 0x01U, USB_REQ_SET_INTERFACE, 0U, Ncm.DataItf, 0U, NULL);
+  TEST_CHECK(ret == 0, "SET_INTERFACE 0: %d", ret);
+  Device_Poll();
+  TEST_CHECK(!netif_is_link_up(&NetIf), "lwIP link up after SET_INTERFACE 0");
+  TEST_CHECK(HOST_BulkOut(&USBD_Device, Ncm.EpOut, OutNtb, 16U) == HOST_NAK, "OUT endpoint open after SET_INTERFACE 0");
+
+  ret = HOST_Control(&USBD_Device, 0xA1U, CDC_NCM_GET_NTB_INPUT_SIZE, 0U, Ncm.CmdItf, 4U, buf);
+  TEST_CHECK((ret == 4) && (Get32(buf) == CDC_NCM_NTB_IN_MAX_SIZE), "NTB input size %u after SET_INTERFACE 0",
+             Get32(buf));
+  Ncm.NtbInMaxSize = CDC_NCM_NTB_IN_MAX_SIZE;
+
+  Test_Connect();
+
+  (void)Host_Echo(800U, 1U, &one, 1U);
+  TEST_CHECK(EchoReplies[800] == 1U, "no reply after SET_INTERFACE 1");
+}
+
+#ifdef USE_USBD_COMPOSITE
+/**
+  * @brief  Test_AcmFunction
+  *         The CDC ACM function next to NCM still answers its requests
+  */
+static void Test_AcmFunction(void)
+{
+  uint8_t buf[8];
+  int ret;
+
+  ret = HOST_Control(&USBD_Device, 0xA1U, CDC_GET_LINE_CODING, 0U, 0U, 7U, buf);
+  TEST_CHECK((ret == 7) && (memcmp(buf, AcmLineCoding, 7U) == 0), "CDC ACM GET_LINE_CODING: %d", ret);
+}
+#endif /* USE_USBD_COMPOSITE */
+
+/**
+  * @brief  Test_Deconfigure
+  *         SET_CONFIGURATION 0 releases the class data, lwIP holds no memory
+  */
+static void Test_Deconfigure(void)
+{
+  int ret;
+
+  ret = HOST_Control(&USBD_Device, 0x00U, USB_REQ_SET_CONFIGURATION, 0U, 0U, 0U, NULL);
+  TEST_CHECK(ret == 0, "SET_CONFIGURATION 0: %d", ret);
+  Device_Poll();
+
+  TEST_CHECK(HOST_AllocatedBlocks() == 0U, "%u class data blocks left", HOST_AllocatedBlocks());
+  TEST_CHECK(!netif_is_link_up(&NetIf), "lwIP link up after SET_CONFIGURATION 0");
+  TEST_CHECK(lwip_stats.mem.used == 0U, "lwIP heap holds %u bytes", (unsigned)lwip_stats.mem.used);
+}
+
+int main(void)
+{
+  ip4_addr_t ipaddr;
+  ip4_addr_t netmask;
+  ip4_addr_t gw;
+
+  lwip_init();
+
+  IP4_ADDR(&ipaddr, DevIp[0], DevIp[1], DevIp[2], DevIp[3]);
+  IP4_ADDR(&netmask, 255U, 255U, 255U, 0U);
+  IP4_ADDR(&gw, 0U, 0U, 0U, 0U);
+  (void)netif_add(&NetIf, &ipaddr, &netmask, &gw, NULL, CDC_NCM_Itf_NetifInit, ethernet_input);
+  netif_set_default(&NetIf);
+  netif_set_up(&NetIf);
+
+  (void)USBD_Init(&USBD_Device, &TestDesc, 0U);
+
+#ifdef USE_USBD_COMPOSITE
+  (void)USBD_CDC_RegisterInterface(&USBD_Device, &AcmFops);
+  (void)USBD_RegisterClassComposite(&USBD_Device, USBD_CDC_CLASS, CLASS_TYPE_CDC, AcmEpAdd);
+  (void)USBD_CDC_NCM_RegisterInterface(&USBD_Device, &USBD_CDC_NCM_fops);
+  (void)USBD_RegisterClassComposite(&USBD_Device, USBD_CDC_NCM_CLASS, CLASS_TYPE_NCM, NcmEpAdd);
+  printf("CDC NCM host test, composite device (CDC ACM + CDC NCM)\n");
+#else
+  (void)USBD_RegisterClass(&USBD_Device, USBD_CDC_NCM_CLASS);
+  (void)USBD_CDC_NCM_RegisterInterface(&USBD_Device, &USBD_CDC_NCM_fops);
+  printf("CDC NCM host test, single function device\n");
+#endif /* USE_USBD_COMPOSITE */
+
+  (void)USBD_Start(&USBD_Device);
+
+  Test_Enumerate();
+  Test_NtbRequests();
+  Test_Connect();
+  Test_Arp();
+  Test_EchoBursts();
+  Test_Zlp();
+  Test_OutFlowControl();
+  Test_InOverflow();
+  Test_Malformed();
+  Test_AltSettingReset();
+#ifdef USE_USBD_COMPOSITE
+  Test_AcmFunction();
+#endif /* USE_USBD_COMPOSITE */
+  Test_Deconfigure();
+
+  printf("IN NTBs: %u, datagrams: %u, bytes: %u, other frames: %u\n", InStats.Ntbs, InStats.Datagrams,
+         InStats.Bytes, OtherFrames);
+
+  if (Failures != 0U)
+  {
+    printf("%u checks failed\n", Failures);
+    return 1;
+  }
+
+  printf("all checks passed\n");
+  return 0;
+}
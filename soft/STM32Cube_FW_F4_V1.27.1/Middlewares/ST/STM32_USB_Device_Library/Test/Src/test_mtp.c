@@ -0,0 +1,1082 @@
+/**
+  ******************************************************************************
+  * @file    test_mtp.c
+  * @brief   Host test of the MTP class and of its FatFs interface template
+  *          on a volume of 10101 objects. The device core, the class,
+  *          usbd_mtp_if_template.c and FatFs run unmodified on top of
+  *          usbd_host_model.c and of a RAM disk; this file is the host: it
+  *          formats the volume, enumerates it as an MTP initiator does
+  *          (object handles, object info, object property list), reads and
+  *          writes objects, checks every dataset against the files it created
+  *          and reports the sector reads, the bulk transfers and the CPU time
+  *          of each phase.
+  ******************************************************************************
+  * @attention
+  *
+  * Test harness of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include <time.h>
+#include "usbd_host_model.h"
+#include "usbd_ctlreq.h"
+#include "usbd_mtp.h"
+#include "usbd_mtp_opt.h"
+#include "usbd_mtp_if_template.h"
+#include "ff.h"
+#include "diskio.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_DEV_ADDRESS                5U
+#define TEST_SESSION_ID                 1U
+
+/* Volume: TEST_FOLDERS folders of TEST_FILES files, and one large file in the root */
+#define TEST_FOLDERS                    100U
+#define TEST_FILES                      100U
+#define TEST_OBJECTS                    ((TEST_FOLDERS * (TEST_FILES + 1U)) + 1U)
+#define TEST_BIG_NAME                   "BIG.BIN"
+#define TEST_BIG_SIZE                   (1024U * 1024U)
+#define TEST_UP_NAME                    "UP.BIN"
+#define TEST_UP_SIZE                    ((256U * 1024U) + 100U)
+
+#define TEST_SECTOR_SIZE                512U
+#define TEST_DISK_SECTORS               32768U
+#define TEST_HOST_BUF_SIZE              (4U * 1024U * 1024U)
+#define TEST_PROPS                      SUPP_OBJ_PROP_LEN
+
+#define TEST_ALL_OBJ                    0xFFFFFFFFU
+#define TEST_ALL_PROP                   0xFFFFFFFFU
+#define TEST_ROOT                       0xFFFFFFFFU
+
+/* Offsets in the ObjectInfo dataset */
+#define TEST_OI_FORMAT                  4U
+#define TEST_OI_SIZE                    8U
+#define TEST_OI_PARENT                  38U
+#define TEST_OI_NAME                    52U
+
+/* Private macro -------------------------------------------------------------*/
+#define TEST_CHECK(cond, ...)                                         \
+  do {                                                                \
+    if (!(cond))                                                      \
+    {                                                                 \
+      Failures++;                                                     \
+      printf("FAIL %s:%d: ", __func__, __LINE__);                     \
+      printf(__VA_ARGS__);                                            \
+      printf("\n");                                                   \
+    }                                                                 \
+  } while (0)
+
+/* Private typedef -----------------------------------------------------------*/
+/* What the host learnt about an object, by handle */
+typedef struct
+{
+  uint8_t  Seen;                        /* listed by GetObjectHandles */
+  uint8_t  Folder;
+  uint16_t Format;
+  uint32_t Parent;
+  uint32_t Size;
+  char     Name[16];
+} TEST_ObjectTypeDef;
+
+/* Counters at the start of a phase */
+typedef struct
+{
+  const char *Name;
+  uint32_t Reads;
+  uint32_t Writes;
+  uint32_t InTransfers;
+  uint32_t OutTransfers;
+  uint64_t CpuNs;
+} TEST_PhaseTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+USBD_HandleTypeDef USBD_Device;
+
+static uint32_t Failures;
+static uint32_t TransId;
+
+/* RAM disk of the FatFs volume */
+static uint8_t Disk[TEST_DISK_SECTORS][TEST_SECTOR_SIZE];
+static uint32_t DiskReads;
+static uint32_t DiskWrites;
+
+static FATFS HostFs;
+static FIL HostFile;
+static uint8_t MkfsWork[4096];
+static uint8_t FileBuf[4096];
+
+static uint8_t HostBuf[TEST_HOST_BUF_SIZE];
+static uint8_t OutBuf[TEST_UP_SIZE + MTP_CONT_HEADER_SIZE];
+static uint8_t Rsp[64];
+static uint32_t Handles[TEST_OBJECTS + 8U];
+static uint32_t HandleCount;
+static TEST_ObjectTypeDef Objects[TEST_OBJECTS + 8U];
+static uint32_t FolderHandle[TEST_FOLDERS];
+static uint32_t BigHandle;
+
+/* Device descriptors ------------------------------------------------------- */
+__ALIGN_BEGIN static uint8_t DeviceDesc[USB_LEN_DEV_DESC] __ALIGN_END =
+{
+  0x12, USB_DESC_TYPE_DEVICE, 0x00, 0x02,
+  0x00, 0x00, 0x00,
+  USB_MAX_EP0_SIZE,
+  0x83, 0x04, 0x41, 0x57,               /* VID 0x0483, PID 0x5741 */
+  0x00, 0x02, 1U, 2U, 3U, 1U
+};
+
+__ALIGN_BEGIN static uint8_t LangIdDesc[USB_LEN_LANGID_STR_DESC] __ALIGN_END =
+{
+  USB_LEN_LANGID_STR_DESC, USB_DESC_TYPE_STRING, 0x09, 0x04
+};
+
+__ALIGN_BEGIN static uint8_t StrDesc[USBD_MAX_STR_DESC_SIZ] __ALIGN_END;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t *Desc_Device(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_LangId(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Manufacturer(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Product(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Serial(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Config(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Interface(USBD_SpeedTypeDef speed, uint16_t *length);
+
+static USBD_DescriptorsTypeDef TestDesc =
+{
+  Desc_Device,
+  Desc_LangId,
+  Desc_Manufacturer,
+  Desc_Product,
+  Desc_Serial,
+  Desc_Config,
+  Desc_Interface,
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint8_t *Desc_Device(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(DeviceDesc);
+  return DeviceDesc;
+}
+
+static uint8_t *Desc_LangId(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(LangIdDesc);
+  return LangIdDesc;
+}
+
+static uint8_t *Desc_Manufacturer(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"STMicroelectronics", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Product(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"MTP host test", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Serial(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"00000000001B", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Config(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"MTP Config", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Interface(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"MTP Interface", StrDesc, length);
+  return StrDesc;
+}
+
+/*******************************************************************************
+                       RAM disk of the FatFs volume
+*******************************************************************************/
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+  return (pdrv == 0U) ? 0U : STA_NOINIT;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+  return (pdrv == 0U) ? 0U : STA_NOINIT;
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, DWORD sector, UINT count)
+{
+  if ((pdrv != 0U) || (sector >= TEST_DISK_SECTORS) || (count > (TEST_DISK_SECTORS - sector)))
+  {
+    return RES_PARERR;
+  }
+
+  (void)memcpy(buff, Disk[sector], (size_t)count * TEST_SECTOR_SIZE);
+  DiskReads += count;
+
+  return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, const BYTE *buff, DWORD sector, UINT count)
+{
+  if ((pdrv != 0U) || (sector >= TEST_DISK_SECTORS) || (count > (TEST_DISK_SECTORS - sector)))
+  {
+    return RES_PARERR;
+  }
+
+  (void)memcpy(Disk[sector], buff, (size_t)count * TEST_SECTOR_SIZE);
+  DiskWrites += count;
+
+  return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+  if (pdrv != 0U)
+  {
+    return RES_PARERR;
+  }
+
+  switch (cmd)
+  {
+    case CTRL_SYNC:
+      return RES_OK;
+
+    case GET_SECTOR_COUNT:
+      *(DWORD *)buff = TEST_DISK_SECTORS;
+      return RES_OK;
+
+    case GET_SECTOR_SIZE:
+      *(WORD *)buff = TEST_SECTOR_SIZE;
+      return RES_OK;
+
+    case GET_BLOCK_SIZE:
+      *(DWORD *)buff = 1U;
+      return RES_OK;
+
+    default:
+      return RES_PARERR;
+  }
+}
+
+DWORD get_fattime(void)
+{
+  /* 2022-01-01 00:00:00 */
+  return ((DWORD)(2022U - 1980U) << 25) | ((DWORD)1U << 21) | ((DWORD)1U << 16);
+}
+
+/*******************************************************************************
+                       Host side
+*******************************************************************************/
+
+static uint16_t Get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t Get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void Put16(uint8_t *p, uint16_t v)
+{
+  p[0] = LOBYTE(v);
+  p[1] = HIBYTE(v);
+}
+
+static void Put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static uint64_t CpuNs(void)
+{
+  struct timespec ts;
+
+  (void)clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+
+  return ((uint64_t)ts.tv_sec * 1000000000ULL) + (uint64_t)ts.tv_nsec;
+}
+
+/* Contents of the files of the volume */
+static uint32_t FileSize(uint32_t folder, uint32_t file)
+{
+  return 1U + (((folder * 31U) + (file * 7U)) % 500U);
+}
+
+static uint8_t FileByte(uint32_t folder, uint32_t file, uint32_t ofs)
+{
+  return (uint8_t)((ofs * 3U) + folder + (file * 5U));
+}
+
+static uint8_t BigByte(uint32_t ofs)
+{
+  return (uint8_t)((ofs * 13U) + (ofs >> 11));
+}
+
+static uint8_t UpByte(uint32_t ofs)
+{
+  return (uint8_t)((ofs * 7U) ^ (ofs >> 9));
+}
+
+/**
+  * @brief  Phase_Begin
+  *         Note the counters at the start of a phase
+  */
+static void Phase_Begin(TEST_PhaseTypeDef *ph, const char *name)
+{
+  ph->Name = name;
+  ph->Reads = DiskReads;
+  ph->Writes = DiskWrites;
+  ph->InTransfers = HOST_GetEp(MTP_IN_EP)->Transfers;
+  ph->OutTransfers = HOST_GetEp(MTP_OUT_EP)->Transfers;
+  ph->CpuNs = CpuNs();
+}
+
+/**
+  * @brief  Phase_End
+  *         Print what the phase cost
+  * @retval sector reads of the phase
+  */
+static uint32_t Phase_End(const TEST_PhaseTypeDef *ph, uint32_t ops, uint32_t bytes)
+{
+  uint64_t ns = CpuNs() - ph->CpuNs;
+
+  printf("%-28s %6u ops %9u bytes %6u IN %6u OUT %6u rd %6u wr %8.1f ms\n", ph->Name, ops, bytes,
+         HOST_GetEp(MTP_IN_EP)->Transfers - ph->InTransfers,
+         HOST_GetEp(MTP_OUT_EP)->Transfers - ph->OutTransfers,
+         DiskReads - ph->Reads, DiskWrites - ph->Writes, (double)ns / 1e6);
+
+  return DiskReads - ph->Reads;
+}
+
+/**
+  * @brief  Host_DataOut
+  *         Send a container to the bulk OUT endpoint in the transfers the
+  *         device prepares, packet by packet or chunk by chunk
+  * @retval 0 if all of it was taken
+  */
+static int Host_DataOut(const uint8_t *data, uint32_t len)
+{
+  HOST_EpTypeDef *ep = HOST_GetEp(MTP_OUT_EP);
+  uint32_t sent = 0U;
+  uint32_t n;
+  int ret;
+
+  while (sent < len)
+  {
+    n = MIN(len - sent, ep->Length);
+    ret = HOST_BulkOut(&USBD_Device, MTP_OUT_EP, &data[sent], n);
+    if (ret != (int)n)
+    {
+      TEST_CHECK(0, "bulk OUT of %u bytes at %u of %u: %d", n, sent, len, ret);
+      return -1;
+    }
+    sent += n;
+  }
+
+  return 0;
+}
+
+/**
+  * @brief  Host_Request
+  *         One MTP transaction: command, optional data phase, response
+  * @param  code: operation code
+  * @param  params, nparams: operation parameters
+  * @param  data, size: IN data phase buffer, NULL when the operation has no
+  *         IN data phase
+  * @param  out, out_len: OUT data phase, without its container header
+  * @param  data_len: length of the IN data phase, container header included
+  * @retval response code, 0 if the transaction failed
+  */
+static uint16_t Host_Request(uint16_t code, const uint32_t *params, uint32_t nparams, uint8_t *data, uint32_t size,
+                             uint8_t *out, uint32_t out_len, uint32_t *data_len)
+{
+  uint8_t cmd[MTP_CONT_HEADER_SIZE + 20U];
+  uint32_t len = MTP_CONT_HEADER_SIZE + (4U * nparams);
+  uint32_t idx;
+  int ret;
+
+  Put32(&cmd[0], len);
+  Put16(&cmd[4], MTP_CONT_TYPE_COMMAND);
+  Put16(&cmd[6], code);
+  Put32(&cmd[8], TransId);
+  for (idx = 0U; idx < nparams; idx++)
+  {
+    Put32(&cmd[MTP_CONT_HEADER_SIZE + (4U * idx)], params[idx]);
+  }
+
+  ret = HOST_BulkOut(&USBD_Device, MTP_OUT_EP, cmd, len);
+  TEST_CHECK(ret == (int)len, "operation 0x%04X: command %d", code, ret);
+  if (ret != (int)len)
+  {
+    return 0U;
+  }
+
+  if (out != NULL)
+  {
+    /* The container header is written in front of the data */
+    Put32(&out[0], out_len + MTP_CONT_HEADER_SIZE);
+    Put16(&out[4], MTP_CONT_TYPE_DATA);
+    Put16(&out[6], code);
+    Put32(&out[8], TransId);
+    if (Host_DataOut(out, out_len + MTP_CONT_HEADER_SIZE) != 0)
+    {
+      return 0U;
+    }
+  }
+
+  if (data != NULL)
+  {
+    ret = HOST_BulkIn(&USBD_Device, MTP_IN_EP, data, size);
+    TEST_CHECK(ret >= (int)MTP_CONT_HEADER_SIZE, "operation 0x%04X: data phase %d", code, ret);
+    if (ret < (int)MTP_CONT_HEADER_SIZE)
+    {
+      return 0U;
+    }
+
+    /* A transfer longer than the container ran into the response: the ZLP is missing */
+    TEST_CHECK(Get32(&data[0]) == (uint32_t)ret, "operation 0x%04X: container of %u bytes in a transfer of %d",
+               code, Get32(&data[0]), ret);
+    TEST_CHECK((Get16(&data[4]) == MTP_CONT_TYPE_DATA) && (Get16(&data[6]) == code) &&
+               (Get32(&data[8]) == TransId), "operation 0x%04X: data container type %u code 0x%04X id %u",
+               code, Get16(&data[4]), Get16(&data[6]), Get32(&data[8]));
+    if (data_len != NULL)
+    {
+      *data_len = (uint32_t)ret;
+    }
+  }
+
+  ret = HOST_BulkIn(&USBD_Device, MTP_IN_EP, Rsp, sizeof(Rsp));
+  TEST_CHECK(ret >= (int)MTP_CONT_HEADER_SIZE, "operation 0x%04X: response %d", code, ret);
+  if (ret < (int)MTP_CONT_HEADER_SIZE)
+  {
+    return 0U;
+  }
+
+  TEST_CHECK((Get32(&Rsp[0]) == (uint32_t)ret) && (Get16(&Rsp[4]) == MTP_CONT_TYPE_RESPONSE) &&
+             (Get32(&Rsp[8]) == TransId), "operation 0x%04X: response container length %u type %u id %u",
+             code, Get32(&Rsp[0]), Get16(&Rsp[4]), Get32(&Rsp[8]));
+
+  TransId++;
+
+  return Get16(&Rsp[6]);
+}
+
+/**
+  * @brief  Host_GetString
+  *         Read an MTP string (length, UTF-16 characters with terminator)
+  * @retval bytes read from the dataset
+  */
+static uint32_t Host_GetString(const uint8_t *p, char *str, uint32_t size)
+{
+  uint32_t len = p[0];
+  uint32_t idx;
+
+  for (idx = 0U; (idx < len) && (idx < (size - 1U)); idx++)
+  {
+    str[idx] = (char)Get16(&p[1U + (2U * idx)]);
+  }
+  str[MIN(len, size - 1U)] = '\0';
+
+  return 1U + (2U * len);
+}
+
+/**
+  * @brief  Host_PutString
+  *         Write an MTP string
+  * @retval bytes written
+  */
+static uint32_t Host_PutString(uint8_t *p, const char *str)
+{
+  uint32_t len = (uint32_t)strlen(str) + 1U;
+  uint32_t idx;
+
+  p[0] = (uint8_t)len;
+  for (idx = 0U; idx < len; idx++)
+  {
+    Put16(&p[1U + (2U * idx)], (uint16_t)str[idx]);
+  }
+
+  return 1U + (2U * len);
+}
+
+/**
+  * @brief  Test_Volume
+  *         Format the RAM disk and create the objects the host will find
+  */
+static void Test_Volume(void)
+{
+  /* FatFs looks at the character after the end of a path: paths are built in
+     buffers larger than them */
+  char path[32];
+  uint32_t folder;
+  uint32_t file;
+  uint32_t size;
+  uint32_t idx;
+  UINT n;
+  FRESULT res;
+
+  res = f_mkfs("0:", FM_FAT | FM_SFD, TEST_SECTOR_SIZE, MkfsWork, sizeof(MkfsWork));
+  TEST_CHECK(res == FR_OK, "f_mkfs: %u", res);
+  res = f_mount(&HostFs, "0:", 1U);
+  TEST_CHECK(res == FR_OK, "f_mount: %u", res);
+
+  for (folder = 0U; folder < TEST_FOLDERS; folder++)
+  {
+    (void)snprintf(path, sizeof(path), "0:/%02u", folder);
+    res = f_mkdir(path);
+    TEST_CHECK(res == FR_OK, "f_mkdir %s: %u", path, res);
+
+    for (file = 0U; file < TEST_FILES; file++)
+    {
+      (void)snprintf(path, sizeof(path), "0:/%02u/%02u.LOG", folder, file);
+      size = FileSize(folder, file);
+      for (idx = 0U; idx < size; idx++)
+      {
+        FileBuf[idx] = FileByte(folder, file, idx);
+      }
+
+      res = f_open(&HostFile, path, FA_CREATE_NEW | FA_WRITE);
+      if (res == FR_OK)
+      {
+        res = f_write(&HostFile, FileBuf, size, &n);
+        (void)f_close(&HostFile);
+      }
+      TEST_CHECK((res == FR_OK) && (n == size), "%s: %u", path, res);
+    }
+  }
+
+  (void)snprintf(path, sizeof(path), "0:/%s", TEST_BIG_NAME);
+  res = f_open(&HostFile, path, FA_CREATE_NEW | FA_WRITE);
+  TEST_CHECK(res == FR_OK, "f_open %s: %u", TEST_BIG_NAME, res);
+  for (size = 0U; (res == FR_OK) && (size < TEST_BIG_SIZE); size += sizeof(FileBuf))
+  {
+    for (idx = 0U; idx < sizeof(FileBuf); idx++)
+    {
+      FileBuf[idx] = BigByte(size + idx);
+    }
+    res = f_write(&HostFile, FileBuf, sizeof(FileBuf), &n);
+  }
+  (void)f_close(&HostFile);
+  TEST_CHECK(res == FR_OK, "f_write %s: %u", TEST_BIG_NAME, res);
+
+  /* The device mounts the volume itself */
+  (void)f_mount(NULL, "0:", 0U);
+
+  printf("volume: %u folders of %u files and %s, %u objects\n", TEST_FOLDERS, TEST_FILES, TEST_BIG_NAME,
+         TEST_OBJECTS);
+}
+
+/**
+  * @brief  Test_Enumerate
+  *         Enumeration; SET_CONFIGURATION mounts the volume and builds the index
+  */
+static void Test_Enumerate(void)
+{
+  TEST_PhaseTypeDef ph;
+  uint8_t buf[256];
+  int ret;
+
+  HOST_Attach(&USBD_Device);
+
+  ret = HOST_Control(&USBD_Device, 0x80U, USB_REQ_GET_DESCRIPTOR, 0x0100U, 0U, 64U, buf);
+  TEST_CHECK(ret == USB_LEN_DEV_DESC, "device descriptor: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x00U, USB_REQ_SET_ADDRESS, TEST_DEV_ADDRESS, 0U, 0U, NULL);
+  TEST_CHECK((ret == 0) && (USBD_Device.dev_state == USBD_STATE_ADDRESSED), "SET_ADDRESS: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x80U, USB_REQ_GET_DESCRIPTOR, 0x0200U, 0U, sizeof(buf), buf);
+  TEST_CHECK((ret > 9) && (ret == (int)Get16(&buf[2])), "configuration descriptor: %d", ret);
+
+  Phase_Begin(&ph, "SET_CONFIGURATION (index)");
+  ret = HOST_Control(&USBD_Device, 0x00U, USB_REQ_SET_CONFIGURATION, 1U, 0U, 0U, NULL);
+  TEST_CHECK((ret == 0) && (USBD_Device.dev_state == USBD_STATE_CONFIGURED), "SET_CONFIGURATION: %d", ret);
+  TEST_CHECK(Phase_End(&ph, 1U, 0U) != 0U, "the volume was not read");
+}
+
+/**
+  * @brief  Test_Session
+  *         DeviceInfo outside a session, OpenSession, storage datasets
+  */
+static void Test_Session(void)
+{
+  uint8_t buf[MTP_MEDIA_PACKET + MTP_CONT_HEADER_SIZE];
+  uint32_t param = 0U;
+  uint32_t len = 0U;
+  uint16_t rc;
+
+  rc = Host_Request(MTP_OP_GET_DEVICE_INFO, &param, 1U, buf, sizeof(buf), NULL, 0U, &len);
+  TEST_CHECK(rc == MTP_RESPONSE_OK, "GetDeviceInfo: 0x%04X", rc);
+
+  param = TEST_SESSION_ID;
+  rc = Host_Request(MTP_OP_OPEN_SESSION, &param, 1U, NULL, 0U, NULL, 0U, NULL);
+  TEST_CHECK(rc == MTP_RESPONSE_OK, "OpenSession: 0x%04X", rc);
+
+  rc = Host_Request(MTP_OP_GET_STORAGE_IDS, NULL, 0U, buf, sizeof(buf), NULL, 0U, &len);
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (len >= 20U) && (Get32(&buf[12]) == 1U) &&
+             (Get32(&buf[16]) == MTP_STORAGE_ID), "GetStorageIDs: 0x%04X, %u bytes", rc, len);
+
+  param = MTP_STORAGE_ID;
+  rc = Host_Request(MTP_OP_GET_STORAGE_INFO, &param, 1U, buf, sizeof(buf), NULL, 0U, &len);
+  TEST_CHECK(rc == MTP_RESPONSE_OK, "GetStorageInfo: 0x%04X", rc);
+}
+
+/**
+  * @brief  Test_Handles
+  *         GetObjectHandles of the whole storage, of the root and of each folder
+  */
+static void Test_Handles(void)
+{
+  TEST_PhaseTypeDef ph;
+  uint32_t params[3];
+  uint32_t len = 0U;
+  uint32_t count;
+  uint32_t idx;
+  uint32_t h;
+  uint16_t rc;
+
+  params[0] = TEST_ALL_OBJ;
+  params[1] = 0U;
+  params[2] = 0U;
+
+  Phase_Begin(&ph, "GetObjectHandles (storage)");
+  rc = Host_Request(MTP_OP_GET_OBJECT_HANDLES, params, 3U, HostBuf, sizeof(HostBuf), NULL, 0U, &len);
+  TEST_CHECK(Phase_End(&ph, 1U, len) == 0U, "sector reads for the handles of the storage");
+
+  count = (len >= 16U) ? Get32(&HostBuf[12]) : 0U;
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (count == TEST_OBJECTS) && (len == (16U + (4U * count))),
+             "GetObjectHandles: 0x%04X, %u handles in %u bytes", rc, count, len);
+
+  HandleCount = 0U;
+  for (idx = 0U; (idx < count) && (idx < TEST_OBJECTS); idx++)
+  {
+    h = Get32(&HostBuf[16U + (4U * idx)]);
+    if ((h == 0U) || (h >= (TEST_OBJECTS + 8U)) || (Objects[h].Seen != 0U))
+    {
+      TEST_CHECK(0, "handle %u at %u: out of range or listed twice", h, idx);
+      continue;
+    }
+    Objects[h].Seen = 1U;
+    Handles[HandleCount] = h;
+    HandleCount++;
+  }
+
+  params[2] = TEST_ROOT;
+  Phase_Begin(&ph, "GetObjectHandles (root)");
+  rc = Host_Request(MTP_OP_GET_OBJECT_HANDLES, params, 3U, HostBuf, sizeof(HostBuf), NULL, 0U, &len);
+  TEST_CHECK(Phase_End(&ph, 1U, len) == 0U, "sector reads for the handles of the root");
+  count = (len >= 16U) ? Get32(&HostBuf[12]) : 0U;
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (count == (TEST_FOLDERS + 1U)), "root: 0x%04X, %u handles", rc, count);
+}
+
+/**
+  * @brief  Test_FolderHandles
+  *         GetObjectHandles of each folder, once Test_ObjectInfo found them
+  */
+static void Test_FolderHandles(void)
+{
+  TEST_PhaseTypeDef ph;
+  uint32_t params[3];
+  uint32_t len = 0U;
+  uint32_t count;
+  uint32_t total = 0U;
+  uint32_t bytes = 0U;
+  uint32_t idx;
+  uint32_t h;
+  uint16_t rc;
+
+  params[0] = TEST_ALL_OBJ;
+  params[1] = 0U;
+
+  Phase_Begin(&ph, "GetObjectHandles (folders)");
+  for (idx = 0U; idx < TEST_FOLDERS; idx++)
+  {
+    params[2] = FolderHandle[idx];
+    rc = Host_Request(MTP_OP_GET_OBJECT_HANDLES, params, 3U, HostBuf, sizeof(HostBuf), NULL, 0U, &len);
+    count = (len >= 16U) ? Get32(&HostBuf[12]) : 0U;
+    TEST_CHECK((rc == MTP_RESPONSE_OK) && (count == TEST_FILES), "folder %02u: 0x%04X, %u handles", idx, rc, count);
+
+    for (h = 0U; (h < count) && (h < TEST_FILES); h++)
+    {
+      TEST_CHECK(Objects[Get32(&HostBuf[16U + (4U * h)]) % (TEST_OBJECTS + 8U)].Parent == FolderHandle[idx],
+                 "folder %02u lists handle %u of another folder", idx, Get32(&HostBuf[16U + (4U * h)]));
+    }
+    total += count;
+    bytes += len;
+  }
+  TEST_CHECK(Phase_End(&ph, TEST_FOLDERS, bytes) == 0U, "sector reads for the handles of the folders");
+  TEST_CHECK(total == (TEST_FOLDERS * TEST_FILES), "%u handles in the folders", total);
+}
+
+/**
+  * @brief  Test_ObjectInfo
+  *         GetObjectInfo of every object, checked against the volume
+  */
+static void Test_ObjectInfo(void)
+{
+  TEST_PhaseTypeDef ph;
+  uint8_t buf[MTP_MEDIA_PACKET + MTP_CONT_HEADER_SIZE];
+  TEST_ObjectTypeDef *obj;
+  uint32_t folder;
+  uint32_t file;
+  uint32_t len = 0U;
+  uint32_t bytes = 0U;
+  uint32_t files = 0U;
+  uint32_t idx;
+  uint32_t h;
+  uint16_t rc;
+
+  Phase_Begin(&ph, "GetObjectInfo (all)");
+  for (idx = 0U; idx < HandleCount; idx++)
+  {
+    h = Handles[idx];
+    obj = &Objects[h];
+
+    rc = Host_Request(MTP_OP_GET_OBJECT_INFO, &h, 1U, buf, sizeof(buf), NULL, 0U, &len);
+    if ((rc != MTP_RESPONSE_OK) || (len < (MTP_CONT_HEADER_SIZE + TEST_OI_NAME + 1U)))
+    {
+      TEST_CHECK(0, "GetObjectInfo %u: 0x%04X, %u bytes", h, rc, len);
+      continue;
+    }
+    bytes += len;
+
+    obj->Format = Get16(&buf[MTP_CONT_HEADER_SIZE + TEST_OI_FORMAT]);
+    obj->Size = Get32(&buf[MTP_CONT_HEADER_SIZE + TEST_OI_SIZE]);
+    obj->Parent = Get32(&buf[MTP_CONT_HEADER_SIZE + TEST_OI_PARENT]);
+    obj->Folder = (obj->Format == MTP_OBJ_FORMAT_ASSOCIATION) ? 1U : 0U;
+    (void)Host_GetString(&buf[MTP_CONT_HEADER_SIZE + TEST_OI_NAME], obj->Name, sizeof(obj->Name));
+
+    if ((obj->Parent == 0U) && (strcmp(obj->Name, TEST_BIG_NAME) == 0))
+    {
+      BigHandle = h;
+    }
+    else if ((obj->Parent == 0U) && (obj->Folder != 0U) && (sscanf(obj->Name, "%u", &folder) == 1) &&
+             (folder < TEST_FOLDERS))
+    {
+      FolderHandle[folder] = h;
+    }
+  }
+  (void)Phase_End(&ph, HandleCount, bytes);
+
+  /* Files: a name of their folder, and the size written */
+  for (idx = 0U; idx < HandleCount; idx++)
+  {
+    obj = &Objects[Handles[idx]];
+    if ((obj->Parent == 0U) || (obj->Parent >= (TEST_OBJECTS + 8U)))
+    {
+      continue;
+    }
+
+    if (sscanf(Objects[obj->Parent].Name, "%u", &folder) != 1)
+    {
+      folder = TEST_FOLDERS;
+    }
+    if (sscanf(obj->Name, "%u.LOG", &file) != 1)
+    {
+      file = TEST_FILES;
+    }
+
+    TEST_CHECK((folder < TEST_FOLDERS) && (file < TEST_FILES) && (obj->Folder == 0U) &&
+               (obj->Size == FileSize(folder, file)), "object %u: %s/%s of %u bytes", Handles[idx],
+               Objects[obj->Parent].Name, obj->Name, obj->Size);
+    files++;
+  }
+
+  TEST_CHECK(files == (TEST_FOLDERS * TEST_FILES), "%u files found", files);
+  TEST_CHECK((BigHandle != 0U) && (Objects[BigHandle].Size == TEST_BIG_SIZE), "%s: handle %u", TEST_BIG_NAME,
+             BigHandle);
+  for (folder = 0U; folder < TEST_FOLDERS; folder++)
+  {
+    TEST_CHECK(FolderHandle[folder] != 0U, "folder %02u not found", folder);
+  }
+}
+
+/**
+  * @brief  Test_PropList
+  *         GetObjectPropList of all the objects, then of the files of a folder
+  */
+static void Test_PropList(void)
+{
+  TEST_PhaseTypeDef ph;
+  TEST_ObjectTypeDef *obj;
+  uint32_t params[5];
+  uint32_t len = 0U;
+  uint32_t count;
+  uint32_t pos;
+  uint32_t idx;
+  uint32_t h;
+  uint32_t names = 0U;
+  uint16_t prop;
+  uint16_t type;
+  uint16_t rc;
+  char name[16];
+
+  params[0] = TEST_ALL_OBJ;
+  params[1] = 0U;
+  params[2] = TEST_ALL_PROP;
+  params[3] = 0U;
+  params[4] = 0U;
+
+  Phase_Begin(&ph, "GetObjectPropList (storage)");
+  rc = Host_Request(MTP_OP_GET_OBJECT_PROPLIST, params, 5U, HostBuf, sizeof(HostBuf), NULL, 0U, &len);
+  TEST_CHECK(Phase_End(&ph, 1U, len) == 0U, "sector reads for the property list");
+
+  count = (len >= 16U) ? Get32(&HostBuf[12]) : 0U;
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (count == (TEST_OBJECTS * TEST_PROPS)),
+             "GetObjectPropList: 0x%04X, %u elements in %u bytes", rc, count, len);
+
+  /* Every element against what GetObjectInfo returned */
+  pos = 16U;
+  for (idx = 0U; (idx < count) && ((pos + 8U) <= len); idx++)
+  {
+    h = Get32(&HostBuf[pos]);
+    prop = Get16(&HostBuf[pos + 4U]);
+    type = Get16(&HostBuf[pos + 6U]);
+    pos += 8U;
+    obj = &Objects[(h < (TEST_OBJECTS + 8U)) ? h : 0U];
+
+    switch (type)
+    {
+      case MTP_DATATYPE_STR:
+        pos += Host_GetString(&HostBuf[pos], name, sizeof(name));
+        TEST_CHECK(strcmp(name, obj->Name) == 0, "element %u: name %s of object %u, %s", idx, name, h, obj->Name);
+        names++;
+        break;
+
+      case MTP_DATATYPE_UINT16:
+        TEST_CHECK((prop != MTP_OB_PROP_OBJECT_FORMAT) || (Get16(&HostBuf[pos]) == obj->Format),
+                   "element %u: format 0x%04X of object %u", idx, Get16(&HostBuf[pos]), h);
+        pos += 2U;
+        break;
+
+      case MTP_DATATYPE_UINT32:
+        TEST_CHECK((prop != MTP_OB_PROP_PARENT_OBJECT) || (Get32(&HostBuf[pos]) == obj->Parent),
+                   "element %u: parent %u of object %u", idx, Get32(&HostBuf[pos]), h);
+        pos += 4U;
+        break;
+
+      case MTP_DATATYPE_UINT64:
+        TEST_CHECK((prop != MTP_OB_PROP_OBJECT_SIZE) || ((Get32(&HostBuf[pos]) == obj->Size) &&
+                                                         (Get32(&HostBuf[pos + 4U]) == 0U)),
+                   "element %u: size %u of object %u", idx, Get32(&HostBuf[pos]), h);
+        pos += 8U;
+        break;
+
+      case MTP_DATATYPE_UINT128:
+        pos += 16U;
+        break;
+
+      default:
+        TEST_CHECK(0, "element %u: data type 0x%04X", idx, type);
+        pos = len;
+        break;
+    }
+
+    TEST_CHECK(obj->Seen != 0U, "element %u: handle %u", idx, h);
+  }
+  TEST_CHECK((idx == count) && (pos == len), "%u elements parsed, %u of %u bytes", idx, pos, len);
+  TEST_CHECK(names == (2U * TEST_OBJECTS), "%u names", names);
+
+  /* File names of one folder */
+  params[0] = FolderHandle[TEST_FOLDERS - 1U];
+  params[2] = MTP_OB_PROP_OBJ_FILE_NAME;
+  params[4] = 1U;
+
+  Phase_Begin(&ph, "GetObjectPropList (folder)");
+  rc = Host_Request(MTP_OP_GET_OBJECT_PROPLIST, params, 5U, HostBuf, sizeof(HostBuf), NULL, 0U, &len);
+  TEST_CHECK(Phase_End(&ph, 1U, len) == 0U, "sector reads for the property list of a folder");
+  count = (len >= 16U) ? Get32(&HostBuf[12]) : 0U;
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (count == TEST_FILES), "GetObjectPropList of a folder: 0x%04X, %u elements",
+             rc, count);
+}
+
+/**
+  * @brief  Test_GetObject
+  *         Read the large file and a small one
+  */
+static void Test_GetObject(void)
+{
+  TEST_PhaseTypeDef ph;
+  uint32_t len = 0U;
+  uint32_t idx;
+  uint32_t bad = 0U;
+  uint32_t h;
+  uint32_t folder;
+  uint32_t file;
+  uint32_t reads;
+  uint16_t rc;
+
+  Phase_Begin(&ph, "GetObject (" TEST_BIG_NAME ")");
+  rc = Host_Request(MTP_OP_GET_OBJECT, &BigHandle, 1U, HostBuf, sizeof(HostBuf), NULL, 0U, &len);
+  reads = Phase_End(&ph, 1U, len);
+
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (len == (TEST_BIG_SIZE + MTP_CONT_HEADER_SIZE)), "GetObject: 0x%04X, %u bytes",
+             rc, len);
+  for (idx = 0U; (idx < TEST_BIG_SIZE) && (len == (TEST_BIG_SIZE + MTP_CONT_HEADER_SIZE)); idx++)
+  {
+    bad += (HostBuf[MTP_CONT_HEADER_SIZE + idx] != BigByte(idx)) ? 1U : 0U;
+  }
+  TEST_CHECK(bad == 0U, "%u bytes of %s differ", bad, TEST_BIG_NAME);
+  TEST_CHECK(reads >= (TEST_BIG_SIZE / TEST_SECTOR_SIZE), "%u sector reads", reads);
+
+  /* The last file of the last folder */
+  h = 0U;
+  for (idx = 0U; idx < HandleCount; idx++)
+  {
+    if ((Objects[Handles[idx]].Parent == FolderHandle[TEST_FOLDERS - 1U]) &&
+        (strcmp(Objects[Handles[idx]].Name, "99.LOG") == 0))
+    {
+      h = Handles[idx];
+    }
+  }
+  folder = TEST_FOLDERS - 1U;
+  file = TEST_FILES - 1U;
+
+  rc = Host_Request(MTP_OP_GET_OBJECT, &h, 1U, HostBuf, sizeof(HostBuf), NULL, 0U, &len);
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (len == (FileSize(folder, file) + MTP_CONT_HEADER_SIZE)),
+             "GetObject %u: 0x%04X, %u bytes", h, rc, len);
+  for (idx = 0U, bad = 0U; (idx < FileSize(folder, file)) && (idx < len); idx++)
+  {
+    bad += (HostBuf[MTP_CONT_HEADER_SIZE + idx] != FileByte(folder, file, idx)) ? 1U : 0U;
+  }
+  TEST_CHECK(bad == 0U, "%u bytes of 99/99.LOG differ", bad);
+}
+
+/**
+  * @brief  Test_SendObject
+  *         Create a file in the root folder, check it on the volume, delete it
+  */
+static void Test_SendObject(void)
+{
+  TEST_PhaseTypeDef ph;
+  uint8_t info[MTP_CONT_HEADER_SIZE + 128U];
+  uint8_t buf[MTP_MEDIA_PACKET + MTP_CONT_HEADER_SIZE];
+  uint32_t params[3];
+  uint32_t len;
+  uint32_t idx;
+  uint32_t bad = 0U;
+  uint32_t h;
+  UINT n;
+  FRESULT res;
+  uint16_t rc;
+  char name[16];
+  char path[32];
+
+  /* ObjectInfo dataset, after the container header */
+  (void)memset(info, 0, sizeof(info));
+  Put32(&info[MTP_CONT_HEADER_SIZE + 0U], MTP_STORAGE_ID);
+  Put16(&info[MTP_CONT_HEADER_SIZE + TEST_OI_FORMAT], MTP_OBJ_FORMAT_UNDEFINED);
+  Put32(&info[MTP_CONT_HEADER_SIZE + TEST_OI_SIZE], TEST_UP_SIZE);
+  len = TEST_OI_NAME + Host_PutString(&info[MTP_CONT_HEADER_SIZE + TEST_OI_NAME], TEST_UP_NAME);
+  len += 3U;                            /* empty capture and modification dates, keywords */
+
+  params[0] = MTP_STORAGE_ID;
+  params[1] = TEST_ROOT;
+
+  Phase_Begin(&ph, "SendObjectInfo");
+  rc = Host_Request(MTP_OP_SEND_OBJECT_INFO, params, 2U, NULL, 0U, info, len, NULL);
+  (void)Phase_End(&ph, 1U, len);
+  h = Get32(&Rsp[MTP_CONT_HEADER_SIZE + 8U]);
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (Get32(&Rsp[0]) == (MTP_CONT_HEADER_SIZE + 12U)) &&
+             (h > TEST_OBJECTS) && (h < (TEST_OBJECTS + 8U)), "SendObjectInfo: 0x%04X, handle %u", rc, h);
+
+  for (idx = 0U; idx < TEST_UP_SIZE; idx++)
+  {
+    OutBuf[MTP_CONT_HEADER_SIZE + idx] = UpByte(idx);
+  }
+
+  Phase_Begin(&ph, "SendObject (" TEST_UP_NAME ")");
+  rc = Host_Request(MTP_OP_SEND_OBJECT, NULL, 0U, NULL, 0U, OutBuf, TEST_UP_SIZE, NULL);
+  (void)Phase_End(&ph, 1U, TEST_UP_SIZE + MTP_CONT_HEADER_SIZE);
+  TEST_CHECK(rc == MTP_RESPONSE_OK, "SendObject: 0x%04X", rc);
+  TEST_CHECK((DiskWrites - ph.Writes) >= (TEST_UP_SIZE / TEST_SECTOR_SIZE), "%u sector writes",
+             DiskWrites - ph.Writes);
+
+  /* The index and the volume have the new file */
+  rc = Host_Request(MTP_OP_GET_OBJECT_INFO, &h, 1U, buf, sizeof(buf), NULL, 0U, &len);
+  (void)Host_GetString(&buf[MTP_CONT_HEADER_SIZE + TEST_OI_NAME], name, sizeof(name));
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (Get32(&buf[MTP_CONT_HEADER_SIZE + TEST_OI_SIZE]) == TEST_UP_SIZE) &&
+             (Get32(&buf[MTP_CONT_HEADER_SIZE + TEST_OI_PARENT]) == 0U) && (strcmp(name, TEST_UP_NAME) == 0),
+             "GetObjectInfo of the new object: 0x%04X, %s", rc, name);
+
+  (void)snprintf(path, sizeof(path), "0:/%s", TEST_UP_NAME);
+  res = f_open(&HostFile, path, FA_READ);
+  TEST_CHECK((res == FR_OK) && (f_size(&HostFile) == TEST_UP_SIZE), "%s on the volume: %u", TEST_UP_NAME, res);
+  for (len = 0U; (res == FR_OK) && (len < TEST_UP_SIZE); len += n)
+  {
+    res = f_read(&HostFile, FileBuf, sizeof(FileBuf), &n);
+    if (n == 0U)
+    {
+      break;
+    }
+    for (idx = 0U; idx < n; idx++)
+    {
+      bad += (FileBuf[idx] != UpByte(len + idx)) ? 1U : 0U;
+    }
+  }
+  (void)f_close(&HostFile);
+  TEST_CHECK((len == TEST_UP_SIZE) && (bad == 0U), "%s: %u bytes read, %u differ", TEST_UP_NAME, len, bad);
+
+  rc = Host_Request(MTP_OP_DELETE_OBJECT, &h, 1U, NULL, 0U, NULL, 0U, NULL);
+  TEST_CHECK(rc == MTP_RESPONSE_OK, "DeleteObject: 0x%04X", rc);
+  TEST_CHECK(f_stat(path, NULL) == FR_NO_FILE, "%s still on the volume", TEST_UP_NAME);
+
+  params[0] = TEST_ALL_OBJ;
+  params[1] = 0U;
+  params[2] = TEST_ROOT;
+  rc = Host_Request(MTP_OP_GET_OBJECT_HANDLES, params, 3U, HostBuf, sizeof(HostBuf), NULL, 0U, &len);
+  TEST_CHECK((rc == MTP_RESPONSE_OK) && (Get32(&HostBuf[12]) == (TEST_FOLDERS + 1U)),
+             "root after DeleteObject: 0x%04X, %u handles", rc, Get32(&HostBuf[12]));
+}
+
+int main(void)
+{
+  (void)USBD_Init(&USBD_Device, &TestDesc, 0U);
+  (void)USBD_RegisterClass(&USBD_Device, USBD_MTP_CLASS);
+  (void)USBD_MTP_RegisterInterface(&USBD_Device, &USBD_MTP_fops);
+  (void)USBD_Start(&USBD_Device);
+
+  printf("MTP host test, full speed, index of %u objects\n", MTP_IF_MAX_OBJECTS);
+
+  Test_Volume();
+  Test_Enumerate();
+  Test_Session();
+  Test_Handles();
+  Test_ObjectInfo();
+  Test_FolderHandles();
+  Test_PropList();
+  Test_GetObject();
+  Test_SendObject();
+
+  if (Failures != 0U)
+  {
+    printf("%u checks failed\n", Failures);
+    return 1;
+  }
+
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,782 @@
+/**
+  ******************************************************************************
+  * @file    test_video.c
+  * @brief   Host test of the frame ring of the VIDEO class. The device core
+  *          and usbd_video.c run unmodified on top of usbd_host_model.c;
+  *          this file is a synthetic capture source, which publishes frames
+  *          of random size in the ring as the DCMI interrupt of the interface
+  *          template does, and the host, which polls the isochronous
+  *          endpoint once per frame, rebuilds the frames from the payloads
+  *          and checks each one against the frame the source captured.
+  ******************************************************************************
+  * @attention
+  *
+  * Test harness of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_host_model.h"
+#include "usbd_ctlreq.h"
+#include "usbd_video.h"
+
+/* Private define ------------------------------------------------------------*/
+#define TEST_DEV_ADDRESS                6U
+#define TEST_VS_IF                      UVC_VS_IF_NUM
+
+/* Frame ring: TEST_RING buffers of TEST_FRAME_BUF bytes */
+#define TEST_RING                       3U
+#define TEST_FRAME_BUF                  8192U
+#define TEST_FRAME_MAX                  (TEST_FRAME_BUF - UVC_PAYLOAD_HEADER_SIZE)
+#define TEST_MAX_FRAMES                 4096U
+
+/* SOFs run after a phase for the frames left in the ring */
+#define TEST_DRAIN_SOFS                 1000U
+
+/* Private macro -------------------------------------------------------------*/
+#define TEST_CHECK(cond, ...)                                         \
+  do {                                                                \
+    if (!(cond))                                                      \
+    {                                                                 \
+      Failures++;                                                     \
+      printf("FAIL %s:%d: ", __func__, __LINE__);                     \
+      printf(__VA_ARGS__);                                            \
+      printf("\n");                                                   \
+    }                                                                 \
+  } while (0)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Streaming conditions of a phase */
+typedef struct
+{
+  const char *Name;
+  uint32_t Sofs;                        /* frames of the bus */
+  uint32_t Interval;                    /* SOFs between two captured frames */
+  uint32_t MinLen;                      /* frame size range */
+  uint32_t MaxLen;
+  uint32_t MissPeriod;                  /* the host misses one poll out of MissPeriod, 0 for none */
+} TEST_StreamTypeDef;
+
+/* What the host rebuilt from the payloads */
+typedef struct
+{
+  int32_t  Fid;                         /* FID of the frame being received, -1 before the first */
+  uint32_t Len;
+  uint32_t Frames;                      /* frames received with EOF and checked */
+  uint32_t Partial;                     /* frames ended by a FID toggle, without EOF */
+  uint32_t Skipped;                     /* sequence numbers never received */
+  uint32_t Packets;
+  uint32_t Bytes;                       /* frame data, payload headers excluded */
+  int32_t  LastSeq;
+  uint8_t  Data[TEST_FRAME_MAX];
+} TEST_RxTypeDef;
+
+/* Private variables ---------------------------------------------------------*/
+USBD_HandleTypeDef USBD_Device;
+
+static uint32_t Failures;
+static uint32_t Seed = 1U;
+static uint32_t DataCalls;
+
+/* Frame ring and synthetic capture source */
+static uint32_t FrameMem[TEST_RING][TEST_FRAME_BUF / 4U];
+static uint8_t *Frames[UVC_FRAME_RING_MAX + 1U];
+static uint8_t *Capture;
+static uint32_t Produced;
+static uint32_t FrameLen[TEST_MAX_FRAMES];
+
+static TEST_RxTypeDef Rx;
+static uint8_t Packet[UVC_ISO_FS_MPS];
+
+/* Device descriptors ------------------------------------------------------- */
+__ALIGN_BEGIN static uint8_t DeviceDesc[USB_LEN_DEV_DESC] __ALIGN_END =
+{
+  0x12, USB_DESC_TYPE_DEVICE, 0x00, 0x02,
+  0xEF, 0x02, 0x01,                     /* IAD: miscellaneous, common class */
+  USB_MAX_EP0_SIZE,
+  0x83, 0x04, 0x42, 0x57,               /* VID 0x0483, PID 0x5742 */
+  0x00, 0x02, 1U, 2U, 3U, 1U
+};
+
+__ALIGN_BEGIN static uint8_t LangIdDesc[USB_LEN_LANGID_STR_DESC] __ALIGN_END =
+{
+  USB_LEN_LANGID_STR_DESC, USB_DESC_TYPE_STRING, 0x09, 0x04
+};
+
+__ALIGN_BEGIN static uint8_t StrDesc[USBD_MAX_STR_DESC_SIZ] __ALIGN_END;
+
+/* Private function prototypes -----------------------------------------------*/
+static uint8_t *Desc_Device(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_LangId(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Manufacturer(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Product(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Serial(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Config(USBD_SpeedTypeDef speed, uint16_t *length);
+static uint8_t *Desc_Interface(USBD_SpeedTypeDef speed, uint16_t *length);
+
+static int8_t Itf_Init(void);
+static int8_t Itf_DeInit(void);
+static int8_t Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length);
+static int8_t Itf_Data(uint8_t **pbuf, uint16_t *psize, uint16_t *pcktidx);
+
+static USBD_DescriptorsTypeDef TestDesc =
+{
+  Desc_Device,
+  Desc_LangId,
+  Desc_Manufacturer,
+  Desc_Product,
+  Desc_Serial,
+  Desc_Config,
+  Desc_Interface,
+};
+
+/* The frame ring replaces the Data callback: it is only counted */
+static USBD_VIDEO_ItfTypeDef TestItf =
+{
+  Itf_Init,
+  Itf_DeInit,
+  Itf_Control,
+  Itf_Data,
+};
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint8_t *Desc_Device(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(DeviceDesc);
+  return DeviceDesc;
+}
+
+static uint8_t *Desc_LangId(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  *length = sizeof(LangIdDesc);
+  return LangIdDesc;
+}
+
+static uint8_t *Desc_Manufacturer(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"STMicroelectronics", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Product(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"VIDEO host test", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Serial(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"00000000001C", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Config(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"VIDEO Config", StrDesc, length);
+  return StrDesc;
+}
+
+static uint8_t *Desc_Interface(USBD_SpeedTypeDef speed, uint16_t *length)
+{
+  UNUSED(speed);
+  USBD_GetString((uint8_t *)"VIDEO Interface", StrDesc, length);
+  return StrDesc;
+}
+
+static int8_t Itf_Init(void)
+{
+  return (int8_t)USBD_OK;
+}
+
+static int8_t Itf_DeInit(void)
+{
+  return (int8_t)USBD_OK;
+}
+
+static int8_t Itf_Control(uint8_t cmd, uint8_t *pbuf, uint16_t length)
+{
+  UNUSED(cmd);
+  UNUSED(pbuf);
+  UNUSED(length);
+  return (int8_t)USBD_OK;
+}
+
+static int8_t Itf_Data(uint8_t **pbuf, uint16_t *psize, uint16_t *pcktidx)
+{
+  UNUSED(pbuf);
+  DataCalls++;
+  *psize = UVC_PAYLOAD_HEADER_SIZE;
+  *pcktidx = 0U;
+  return (int8_t)USBD_OK;
+}
+
+static uint16_t Get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | ((uint16_t)p[1] << 8));
+}
+
+static uint32_t Get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void Put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+/* Reproducible pseudo-random sizes, whatever the C library */
+static uint32_t Rand(void)
+{
+  Seed = (Seed * 1103515245U) + 12345U;
+  return Seed >> 16;
+}
+
+/* Frame contents: the sequence number, then a pattern of it */
+static uint8_t FrameByte(uint32_t seq, uint32_t ofs)
+{
+  return (uint8_t)((seq * 7U) + (ofs * 13U) + (ofs >> 8));
+}
+
+static uint8_t *Video_Ep(void)
+{
+  return HOST_GetEp(UVC_IN_EP)->pBuf;
+}
+
+/*******************************************************************************
+                       Synthetic capture source
+*******************************************************************************/
+
+/**
+  * @brief  Source_Capture
+  *         Write a frame where the class asked for it and publish it, as the
+  *         DCMI frame interrupt of the interface template does
+  * @param  len: frame length
+  * @retval None
+  */
+static void Source_Capture(uint32_t len)
+{
+  uint32_t ofs;
+
+  if (Produced >= TEST_MAX_FRAMES)
+  {
+    return;
+  }
+
+  Put32(Capture, Produced);
+  for (ofs = 4U; ofs < len; ofs++)
+  {
+    Capture[ofs] = FrameByte(Produced, ofs);
+  }
+
+  FrameLen[Produced] = len;
+  Produced++;
+
+  Capture = USBD_VIDEO_FrameCaptured(len);
+}
+
+/*******************************************************************************
+                       Host
+*******************************************************************************/
+
+/**
+  * @brief  Host_Reset
+  *         Forget the frame being received, as a host does on SET_INTERFACE
+  * @param  None
+  * @retval None
+  */
+static void Host_Reset(void)
+{
+  Rx.Fid = -1;
+  Rx.Len = 0U;
+}
+
+/**
+  * @brief  Host_CheckFrame
+  *         Check a frame received with EOF against the captured one
+  * @param  None
+  * @retval None
+  */
+static void Host_CheckFrame(void)
+{
+  uint32_t seq;
+  uint32_t ofs;
+
+  TEST_CHECK(Rx.Len >= 4U, "frame of %u bytes", Rx.Len);
+  if (Rx.Len < 4U)
+  {
+    return;
+  }
+
+  seq = Get32(Rx.Data);
+  TEST_CHECK((seq < Produced) && ((int32_t)seq > Rx.LastSeq),
+             "frame %u received after frame %d, %u captured", seq, Rx.LastSeq, Produced);
+  if ((seq >= Produced) || ((int32_t)seq <= Rx.LastSeq))
+  {
+    return;
+  }
+
+  TEST_CHECK(Rx.Len == FrameLen[seq], "frame %u: %u bytes received, %u captured", seq, Rx.Len, FrameLen[seq]);
+
+  for (ofs = 4U; ofs < Rx.Len; ofs++)
+  {
+    if (Rx.Data[ofs] != FrameByte(seq, ofs))
+    {
+      TEST_CHECK(0, "frame %u differs at byte %u", seq, ofs);
+      break;
+    }
+  }
+
+  Rx.Skipped += seq - (uint32_t)(Rx.LastSeq + 1);
+  Rx.LastSeq = (int32_t)seq;
+  Rx.Frames++;
+}
+
+/**
+  * @brief  Host_Poll
+  *         Poll the isochronous endpoint in the current frame and add the
+  *         payload to the frame being received
+  * @param  None
+  * @retval None
+  */
+static void Host_Poll(void)
+{
+  const uint8_t *pbuf = Video_Ep();
+  uint32_t data;
+  uint32_t idx;
+  int32_t fid;
+  int ret;
+
+  ret = HOST_IsoIn(&USBD_Device, UVC_IN_EP, Packet, sizeof(Packet));
+  if (ret == HOST_NAK)
+  {
+    return;
+  }
+
+  TEST_CHECK(ret >= (int)UVC_PAYLOAD_HEADER_SIZE, "payload of %d", ret);
+  if (ret < (int)UVC_PAYLOAD_HEADER_SIZE)
+  {
+    return;
+  }
+
+  TEST_CHECK((Packet[0] == UVC_PAYLOAD_HEADER_SIZE) &&
+             ((Packet[1] & ~(UVC_PAYLOAD_HEADER_FID | UVC_PAYLOAD_HEADER_EOF)) == 0U),
+             "payload header %02x %02x", Packet[0], Packet[1]);
+
+  /* Every packet starts 32-bit aligned, frame data is sent from the ring */
+  TEST_CHECK(((uintptr_t)pbuf & 3U) == 0U, "packet at %p", (const void *)pbuf);
+
+  data = (uint32_t)ret - UVC_PAYLOAD_HEADER_SIZE;
+  if (data != 0U)
+  {
+    for (idx = 0U; idx < TEST_RING; idx++)
+    {
+      if ((pbuf >= Frames[idx]) && ((pbuf + ret) <= (Frames[idx] + TEST_FRAME_BUF)))
+      {
+        break;
+      }
+    }
+    TEST_CHECK(idx < TEST_RING, "payload of %u bytes not sent from a frame buffer", data);
+  }
+
+  Rx.Packets++;
+  Rx.Bytes += data;
+
+  fid = (int32_t)(Packet[1] & UVC_PAYLOAD_HEADER_FID);
+  if (fid != Rx.Fid)
+  {
+    if (Rx.Len != 0U)
+    {
+      Rx.Partial++;
+    }
+    Rx.Fid = fid;
+    Rx.Len = 0U;
+  }
+
+  TEST_CHECK((Rx.Len + data) <= TEST_FRAME_MAX, "frame longer than %u bytes", TEST_FRAME_MAX);
+  if ((Rx.Len + data) > TEST_FRAME_MAX)
+  {
+    Rx.Len = 0U;
+    return;
+  }
+
+  (void)memcpy(&Rx.Data[Rx.Len], &Packet[UVC_PAYLOAD_HEADER_SIZE], data);
+  Rx.Len += data;
+
+  if ((Packet[1] & UVC_PAYLOAD_HEADER_EOF) != 0U)
+  {
+    Host_CheckFrame();
+    Rx.Len = 0U;
+  }
+}
+
+/**
+  * @brief  Bus_Frame
+  *         One frame of the bus: SOF, then the IN token of the host or the
+  *         end of frame without it
+  * @param  poll: the host polls the endpoint in this frame
+  * @retval None
+  */
+static void Bus_Frame(uint8_t poll)
+{
+  (void)USBD_LL_SOF(&USBD_Device);
+
+  if (poll != 0U)
+  {
+    Host_Poll();
+  }
+  else
+  {
+    HOST_IsoInMissed(&USBD_Device, UVC_IN_EP);
+  }
+}
+
+/**
+  * @brief  Ring_Idle
+  *         Every frame published has been sent or dropped
+  * @param  None
+  * @retval 1 if idle
+  */
+static uint8_t Ring_Idle(void)
+{
+  USBD_VIDEO_StatsTypeDef st;
+
+  USBD_VIDEO_GetStats(&st);
+
+  return (st.captured == (st.sent + st.dropped)) ? 1U : 0U;
+}
+
+/*******************************************************************************
+                       Tests
+*******************************************************************************/
+
+static void Test_FrameRing(void)
+{
+  uint8_t idx;
+
+  for (idx = 0U; idx <= UVC_FRAME_RING_MAX; idx++)
+  {
+    Frames[idx] = (uint8_t *)FrameMem[(idx < TEST_RING) ? idx : 0U];
+  }
+
+  TEST_CHECK(USBD_VIDEO_GetCaptureFrame() == NULL, "capture frame without a ring");
+  TEST_CHECK(USBD_VIDEO_FrameCaptured(100U) == NULL, "frame captured without a ring");
+  TEST_CHECK(USBD_VIDEO_SetFrameRing(Frames, 1U, TEST_FRAME_BUF) != (uint8_t)USBD_OK, "ring of 1 frame");
+  TEST_CHECK(USBD_VIDEO_SetFrameRing(Frames, UVC_FRAME_RING_MAX + 1U, TEST_FRAME_BUF) != (uint8_t)USBD_OK,
+             "ring of %u frames", UVC_FRAME_RING_MAX + 1U);
+  TEST_CHECK(USBD_VIDEO_SetFrameRing(Frames, TEST_RING, UVC_PAYLOAD_HEADER_SIZE) != (uint8_t)USBD_OK,
+             "ring of empty frames");
+  TEST_CHECK(USBD_VIDEO_SetFrameRing(Frames, TEST_RING, TEST_FRAME_BUF) == (uint8_t)USBD_OK, "frame ring");
+
+  Capture = USBD_VIDEO_GetCaptureFrame();
+  TEST_CHECK(Capture == (Frames[0] + UVC_PAYLOAD_HEADER_SIZE), "first capture frame");
+
+  /* Out of range sizes are not published, the same buffer is given back */
+  TEST_CHECK(USBD_VIDEO_FrameCaptured(0U) == Capture, "frame of 0 bytes published");
+  TEST_CHECK(USBD_VIDEO_FrameCaptured(TEST_FRAME_MAX + 1U) == Capture, "frame larger than its buffer published");
+}
+
+static void Test_Enumerate(void)
+{
+  uint8_t buf[256];
+  uint32_t ofs;
+  uint8_t iso = 0U;
+  uint8_t alt = 0xFFU;
+  int ret;
+
+  HOST_Attach(&USBD_Device);
+
+  ret = HOST_Control(&USBD_Device, 0x80U, USB_REQ_GET_DESCRIPTOR, 0x0100U, 0U, 64U, buf);
+  TEST_CHECK(ret == USB_LEN_DEV_DESC, "device descriptor: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x00U, USB_REQ_SET_ADDRESS, TEST_DEV_ADDRESS, 0U, 0U, NULL);
+  TEST_CHECK((ret == 0) && (USBD_Device.dev_state == USBD_STATE_ADDRESSED), "SET_ADDRESS: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x80U, USB_REQ_GET_DESCRIPTOR, 0x0200U, 0U, sizeof(buf), buf);
+  TEST_CHECK((ret > 9) && (ret == (int)Get16(&buf[2])), "configuration descriptor: %d", ret);
+
+  /* The isochronous endpoint is in alternate setting 1 of the streaming interface */
+  for (ofs = 0U; (ret > 0) && ((ofs + 2U) <= (uint32_t)ret) && (buf[ofs] != 0U); ofs += buf[ofs])
+  {
+    if ((buf[ofs + 1U] == USB_DESC_TYPE_INTERFACE) && (buf[ofs + 2U] == TEST_VS_IF))
+    {
+      alt = buf[ofs + 3U];
+    }
+
+    if ((buf[ofs + 1U] == USB_DESC_TYPE_ENDPOINT) && (buf[ofs + 2U] == UVC_IN_EP))
+    {
+      TEST_CHECK(alt == 1U, "streaming endpoint in alternate setting %u", alt);
+      TEST_CHECK((buf[ofs + 3U] & 0x03U) == USBD_EP_TYPE_ISOC, "endpoint attributes %02x", buf[ofs + 3U]);
+      TEST_CHECK(Get16(&buf[ofs + 4U]) == UVC_ISO_FS_MPS, "wMaxPacketSize %u", Get16(&buf[ofs + 4U]));
+      iso = 1U;
+    }
+  }
+  TEST_CHECK(iso != 0U, "no streaming endpoint");
+
+  ret = HOST_Control(&USBD_Device, 0x00U, USB_REQ_SET_CONFIGURATION, 1U, 0U, 0U, NULL);
+  TEST_CHECK((ret == 0) && (USBD_Device.dev_state == USBD_STATE_CONFIGURED), "SET_CONFIGURATION: %d", ret);
+  TEST_CHECK(HOST_GetEp(UVC_IN_EP)->Open != 0U, "streaming endpoint not open");
+}
+
+/**
+  * @brief  Test_Start
+  *         Negotiate the stream and select the alternate setting with the
+  *         endpoint, as a host starting a capture does
+  * @param  None
+  * @retval None
+  */
+static void Test_Start(void)
+{
+  uint8_t ctl[26];
+  int ret;
+
+  (void)memset(ctl, 0, sizeof(ctl));
+
+  ret = HOST_Control(&USBD_Device, 0x21U, UVC_SET_CUR, VS_PROBE_CONTROL, TEST_VS_IF, sizeof(ctl), ctl);
+  TEST_CHECK(ret == (int)sizeof(ctl), "SET_CUR probe: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0xA1U, UVC_GET_CUR, VS_PROBE_CONTROL, TEST_VS_IF, sizeof(ctl), ctl);
+  TEST_CHECK(ret == (int)sizeof(ctl), "GET_CUR probe: %d", ret);
+  TEST_CHECK(Get32(&ctl[22]) == UVC_ISO_FS_MPS, "dwMaxPayloadTransferSize %u", Get32(&ctl[22]));
+
+  ret = HOST_Control(&USBD_Device, 0x21U, UVC_SET_CUR, VS_COMMIT_CONTROL, TEST_VS_IF, sizeof(ctl), ctl);
+  TEST_CHECK(ret == (int)sizeof(ctl), "SET_CUR commit: %d", ret);
+
+  ret = HOST_Control(&USBD_Device, 0x01U, USB_REQ_SET_INTERFACE, 1U, TEST_VS_IF, 0U, NULL);
+  TEST_CHECK(ret == 0, "SET_INTERFACE 1: %d", ret);
+
+  Host_Reset();
+
+  /* The stream starts with a header-only payload on the next SOF */
+  (void)USBD_LL_SOF(&USBD_Device);
+  TEST_CHECK((HOST_GetEp(UVC_IN_EP)->Armed != 0U) && (HOST_GetEp(UVC_IN_EP)->Length == UVC_PAYLOAD_HEADER_SIZE),
+             "no start payload");
+  Host_Poll();
+  TEST_CHECK(HOST_GetEp(UVC_IN_EP)->Armed != 0U, "stream not kept alive");
+}
+
+/**
+  * @brief  Test_Stream
+  *         Stream with the given capture rate and host behaviour, then let
+  *         the ring empty; check that every frame sent arrived intact and in
+  *         order and that the frames the host never saw are the dropped ones
+  * @param  cond: streaming conditions
+  * @param  stats: counters of the phase
+  * @param  rx: what the host received during the phase
+  * @retval None
+  */
+static void Test_Stream(const TEST_StreamTypeDef *cond, USBD_VIDEO_StatsTypeDef *stats, TEST_RxTypeDef *rx)
+{
+  USBD_VIDEO_StatsTypeDef st0;
+  USBD_VIDEO_StatsTypeDef st;
+  TEST_RxTypeDef rx0 = Rx;
+  uint32_t fps;
+  uint32_t sof;
+  uint8_t poll;
+
+  USBD_VIDEO_GetStats(&st0);
+
+  for (sof = 0U; sof < cond->Sofs; sof++)
+  {
+    if ((sof % cond->Interval) == 0U)
+    {
+      Source_Capture(cond->MinLen + (Rand() % ((cond->MaxLen - cond->MinLen) + 1U)));
+    }
+
+    poll = ((cond->MissPeriod == 0U) || ((sof % cond->MissPeriod) != (cond->MissPeriod - 1U))) ? 1U : 0U;
+    Bus_Frame(poll);
+  }
+
+  /* Frames sent during the last second of streaming */
+  USBD_VIDEO_GetStats(&st);
+  fps = st.fps;
+
+  for (sof = 0U; (sof < TEST_DRAIN_SOFS) && (Ring_Idle() == 0U); sof++)
+  {
+    Bus_Frame(1U);
+  }
+  TEST_CHECK(Ring_Idle() != 0U, "%s: frames left in the ring", cond->Name);
+
+  /* The ring is idle: the frames after the last one received were dropped */
+  Rx.Skipped += (uint32_t)((int32_t)Produced - 1 - Rx.LastSeq);
+  Rx.LastSeq = (int32_t)Produced - 1;
+
+  USBD_VIDEO_GetStats(&st);
+  stats->captured = st.captured - st0.captured;
+  stats->sent = st.sent - st0.sent;
+  stats->dropped = st.dropped - st0.dropped;
+  stats->fps = fps;
+
+  rx->Frames = Rx.Frames - rx0.Frames;
+  rx->Partial = Rx.Partial - rx0.Partial;
+  rx->Skipped = Rx.Skipped - rx0.Skipped;
+  rx->Packets = Rx.Packets - rx0.Packets;
+  rx->Bytes = Rx.Bytes - rx0.Bytes;
+
+  TEST_CHECK(rx->Frames == stats->sent, "%s: %u frames received, %u sent", cond->Name, rx->Frames, stats->sent);
+  TEST_CHECK(rx->Skipped == stats->dropped, "%s: %u frames never received, %u dropped",
+             cond->Name, rx->Skipped, stats->dropped);
+  TEST_CHECK(HOST_GetEp(UVC_IN_EP)->Rearmed == 0U, "%s: %u packets prepared over a pending one",
+             cond->Name, HOST_GetEp(UVC_IN_EP)->Rearmed);
+
+  printf("  %-28s captured %5u sent %5u dropped %5u partial %3u fps %3u, %6u packets, %4u bytes/packet\n",
+         cond->Name, stats->captured, stats->sent, stats->dropped, rx->Partial, stats->fps,
+         rx->Packets, (rx->Packets != 0U) ? (rx->Bytes / rx->Packets) : 0U);
+}
+
+static void Test_HostKeepsUp(void)
+{
+  static const TEST_StreamTypeDef cond = { "host keeps up", 20000U, 33U, 1U, 6000U, 0U };
+  USBD_VIDEO_StatsTypeDef st;
+  TEST_RxTypeDef rx;
+
+  Test_Stream(&cond, &st, &rx);
+
+  TEST_CHECK(st.captured == (cond.Sofs / cond.Interval) + 1U, "%u frames captured", st.captured);
+  TEST_CHECK(st.dropped == 0U, "%u frames dropped", st.dropped);
+  TEST_CHECK(rx.Partial == 0U, "%u partial frames", rx.Partial);
+  TEST_CHECK((st.fps >= 29U) && (st.fps <= 31U), "%u frames per second", st.fps);
+}
+
+static void Test_HostBehind(void)
+{
+  static const TEST_StreamTypeDef cond = { "capture faster than the bus", 20000U, 10U, 2000U, 6000U, 0U };
+  USBD_VIDEO_StatsTypeDef st;
+  TEST_RxTypeDef rx;
+
+  Test_Stream(&cond, &st, &rx);
+
+  /* Only frames waiting in the ring are dropped, never the one on the bus */
+  TEST_CHECK(st.dropped != 0U, "no frame dropped");
+  TEST_CHECK(rx.Partial == 0U, "%u partial frames", rx.Partial);
+  TEST_CHECK(st.captured == (st.sent + st.dropped), "%u captured, %u sent, %u dropped",
+             st.captured, st.sent, st.dropped);
+}
+
+static void Test_MissedPolls(void)
+{
+  static const TEST_StreamTypeDef cond = { "host misses 1 poll in 50", 20000U, 33U, 1U, 6000U, 50U };
+  USBD_VIDEO_StatsTypeDef st;
+  TEST_RxTypeDef rx;
+
+  Test_Stream(&cond, &st, &rx);
+
+  /* An incomplete isochronous IN drops the frame on the bus */
+  TEST_CHECK(rx.Partial != 0U, "no partial frame");
+  TEST_CHECK(st.dropped >= rx.Partial, "%u frames dropped, %u partial", st.dropped, rx.Partial);
+}
+
+static void Test_StopStart(void)
+{
+  USBD_VIDEO_StatsTypeDef st0;
+  USBD_VIDEO_StatsTypeDef st;
+  uint32_t sof;
+  int ret;
+
+  /* Stop in the middle of a frame */
+  Source_Capture(TEST_FRAME_MAX);
+  Bus_Frame(1U);
+  Bus_Frame(1U);
+  Bus_Frame(1U);
+
+  USBD_VIDEO_GetStats(&st0);
+
+  ret = HOST_Control(&USBD_Device, 0x01U, USB_REQ_SET_INTERFACE, 0U, TEST_VS_IF, 0U, NULL);
+  TEST_CHECK(ret == 0, "SET_INTERFACE 0: %d", ret);
+  Host_Reset();
+
+  USBD_VIDEO_GetStats(&st);
+  TEST_CHECK(st.dropped == (st0.dropped + 1U), "frame on the bus not dropped on stop");
+
+  /* Nothing is sent while stopped; the capture side keeps publishing */
+  for (sof = 0U; sof < 200U; sof++)
+  {
+    if ((sof % 33U) == 0U)
+    {
+      Source_Capture(1000U);
+    }
+    (void)USBD_LL_SOF(&USBD_Device);
+    TEST_CHECK(HOST_GetEp(UVC_IN_EP)->Armed == 0U, "packet prepared while stopped");
+  }
+
+  ret = HOST_Control(&USBD_Device, 0x01U, USB_REQ_SET_INTERFACE, 1U, TEST_VS_IF, 0U, NULL);
+  TEST_CHECK(ret == 0, "SET_INTERFACE 1: %d", ret);
+
+  /* The frames captured while stopped that are still in the ring are sent */
+  USBD_VIDEO_GetStats(&st0);
+  for (sof = 0U; (sof < TEST_DRAIN_SOFS) && (Ring_Idle() == 0U); sof++)
+  {
+    Bus_Frame(1U);
+  }
+  USBD_VIDEO_GetStats(&st);
+
+  TEST_CHECK(Ring_Idle() != 0U, "frames left in the ring after restart");
+  TEST_CHECK(st.sent > st0.sent, "nothing sent after restart");
+  TEST_CHECK(Rx.LastSeq == (int32_t)(Produced - 1U), "last frame %d received, %u captured", Rx.LastSeq, Produced);
+}
+
+static void Test_Deconfigure(void)
+{
+  USBD_VIDEO_StatsTypeDef st;
+  int ret;
+
+  ret = HOST_Control(&USBD_Device, 0x00U, USB_REQ_SET_CONFIGURATION, 0U, 0U, 0U, NULL);
+  TEST_CHECK((ret == 0) && (USBD_Device.dev_state == USBD_STATE_ADDRESSED), "SET_CONFIGURATION 0: %d", ret);
+  TEST_CHECK(HOST_GetEp(UVC_IN_EP)->Open == 0U, "streaming endpoint left open");
+  TEST_CHECK(HOST_AllocatedBlocks() == 0U, "%u class data blocks left", HOST_AllocatedBlocks());
+
+  /* Overall: every frame captured was sent once or dropped */
+  USBD_VIDEO_GetStats(&st);
+  TEST_CHECK(st.captured == Produced, "%u frames captured, %u produced", st.captured, Produced);
+  TEST_CHECK(Rx.Frames == st.sent, "%u frames received, %u sent", Rx.Frames, st.sent);
+  TEST_CHECK(Rx.Skipped == st.dropped, "%u frames never received, %u dropped", Rx.Skipped, st.dropped);
+  TEST_CHECK(DataCalls == 0U, "Data callback called %u times with a frame ring", DataCalls);
+
+  printf("  %-28s captured %5u sent %5u dropped %5u\n", "total", st.captured, st.sent, st.dropped);
+}
+
+int main(void)
+{
+  (void)USBD_Init(&USBD_Device, &TestDesc, 0U);
+  (void)USBD_RegisterClass(&USBD_Device, USBD_VIDEO_CLASS);
+  (void)USBD_VIDEO_RegisterInterface(&USBD_Device, &TestItf);
+
+  Rx.LastSeq = -1;
+
+  Test_FrameRing();
+  (void)USBD_Start(&USBD_Device);
+
+  printf("VIDEO host test, full speed, %u frame buffers of %u bytes\n", TEST_RING, TEST_FRAME_BUF);
+
+  Test_Enumerate();
+  Test_Start();
+  Test_HostKeepsUp();
+  Test_HostBehind();
+  Test_MissedPolls();
+  Test_StopStart();
+  Test_Deconfigure();
+
+  if (Failures != 0U)
+  {
+    printf("%u checks failed\n", Failures);
+    return 1;
+  }
+
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,659 @@
+/**
+  ******************************************************************************
+  * @file    usbd_host_model.c
+  * @brief   USBD_LL layer of the host test. It replaces usbd_conf.c and the
+  *          HAL PCD driver: the transfers prepared by the device core are kept
+  *          per endpoint and the host functions below serve them, calling the
+  *          core back the way the PCD interrupt handler does:
+  *           - EP0 moves one packet per callback, bulk and interrupt endpoints
+  *             a whole transfer
+  *           - a bulk IN transfer ends with a short packet or when the host
+  *             buffer is full, so a missing or extra ZLP shows in the result
+  *           - a bulk OUT transfer is given at once, up to the length the
+  *             device prepared; a reception prepared with 0 bytes takes one
+  *             packet of up to the max packet size, as on the OTG core
+  *           - an isochronous IN endpoint gives one packet per frame; a frame
+  *             the host did not poll ends with the incomplete isochronous IN
+  *             event when a packet was pending
+  *          There is no timing: a transfer the device did not prepare is
+  *          reported as NAKed instead of being retried.
+  ******************************************************************************
+  * @attention
+  *
+  * Test harness of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "usbd_host_model.h"
+
+/* Private define ------------------------------------------------------------*/
+#define HOST_MEM_BLOCKS                    4U
+#define HOST_MEM_BLOCK_SIZE                2048U
+
+/* Private variables ---------------------------------------------------------*/
+static PCD_HandleTypeDef hpcd;
+static HOST_EpTypeDef EpIn[16];
+static HOST_EpTypeDef EpOut[16];
+static uint8_t DevAddress;
+
+/* Class data blocks of USBD_malloc, one per class instance */
+static uint32_t MemBlock[HOST_MEM_BLOCKS][HOST_MEM_BLOCK_SIZE / 4U];
+static uint8_t MemUsed[HOST_MEM_BLOCKS];
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  HOST_Attach
+  *         Reset the bus and the device, as a full speed port
+  * @param  pdev: device handle
+  * @retval None
+  */
+void HOST_Attach(USBD_HandleTypeDef *pdev)
+{
+  (void)memset(EpIn, 0, sizeof(EpIn));
+  (void)memset(EpOut, 0, sizeof(EpOut));
+  DevAddress = 0U;
+
+  (void)USBD_LL_SetSpeed(pdev, USBD_SPEED_FULL);
+  (void)USBD_LL_Reset(pdev);
+}
+
+/**
+  * @brief  HOST_Control
+  *         Run a control transfer on EP0: setup, data and status stages
+  * @param  pdev: device handle
+  * @param  bmRequest, bRequest, wValue, wIndex, wLength: setup packet
+  * @param  pData: data stage buffer, wLength bytes
+  * @retval number of data bytes transferred, HOST_STALL, HOST_NAK or HOST_OVERRUN
+  */
+int HOST_Control(USBD_HandleTypeDef *pdev, uint8_t bmRequest, uint8_t bRequest,
+                 uint16_t wValue, uint16_t wIndex, uint16_t wLength, uint8_t *pData)
+{
+  HOST_EpTypeDef *in0 = &EpIn[0];
+  HOST_EpTypeDef *out0 = &EpOut[0];
+  uint8_t setup[8];
+  uint32_t count = 0U;
+  uint32_t n;
+
+  setup[0] = bmRequest;
+  setup[1] = bRequest;
+  setup[2] = LOBYTE(wValue);
+  setup[3] = HIBYTE(wValue);
+  setup[4] = LOBYTE(wIndex);
+  setup[5] = HIBYTE(wIndex);
+  setup[6] = LOBYTE(wLength);
+  setup[7] = HIBYTE(wLength);
+
+  /* A SETUP packet clears the EP0 stall and aborts the previous transfer */
+  in0->Armed = 0U;
+  in0->Stalled = 0U;
+  out0->Armed = 0U;
+  out0->Stalled = 0U;
+
+  (void)USBD_LL_SetupStage(pdev, setup);
+
+  if (((bmRequest & 0x80U) != 0U) && (wLength != 0U))
+  {
+    /* IN data stage, ends with a short packet or wLength bytes */
+    for (;;)
+    {
+      if (in0->Stalled != 0U)
+      {
+        return HOST_STALL;
+      }
+
+      if (in0->Armed == 0U)
+      {
+        return HOST_NAK;
+      }
+
+      n = MIN(in0->Length, HOST_EP0_SIZE);
+      if ((count + n) > wLength)
+      {
+        return HOST_OVERRUN;
+      }
+
+      if (n != 0U)
+      {
+        (void)memcpy(&pData[count], in0->pBuf, n);
+      }
+      count += n;
+      in0->Armed = 0U;
+
+      (void)USBD_LL_DataInStage(pdev, 0U, (in0->pBuf != NULL) ? &in0->pBuf[n] : NULL);
+
+      if ((n < HOST_EP0_SIZE) || (count == wLength))
+      {
+        break;
+      }
+    }
+
+    /* OUT status stage */
+    if (out0->Armed == 0U)
+    {
+      return HOST_NAK;
+    }
+    out0->Armed = 0U;
+    out0->RxCount = 0U;
+    (void)USBD_LL_DataOutStage(pdev, 0U, out0->pBuf);
+  }
+  else
+  {
+    /* OUT data stage, one packet at a time */
+    while (count < wLength)
+    {
+      if (out0->Stalled != 0U)
+      {
+        return HOST_STALL;
+      }
+
+      if (out0->Armed == 0U)
+      {
+        return HOST_NAK;
+      }
+
+      n = MIN((uint32_t)wLength - count, HOST_EP0_SIZE);
+      if (n > out0->Length)
+      {
+        return HOST_OVERRUN;
+      }
+
+      (void)memcpy(out0->pBuf, &pData[count], n);
+      out0->RxCount = n;
+      out0->Armed = 0U;
+      count += n;
+
+      (void)USBD_LL_DataOutStage(pdev, 0U, &out0->pBuf[n]);
+    }
+
+    /* IN status stage */
+    if (in0->Stalled != 0U)
+    {
+      return HOST_STALL;
+    }
+
+    if ((in0->Armed == 0U) || (in0->Length != 0U))
+    {
+      return HOST_NAK;
+    }
+    in0->Armed = 0U;
+    (void)USBD_LL_DataInStage(pdev, 0U, NULL);
+  }
+
+  return (int)count;
+}
+
+/**
+  * @brief  HOST_BulkOut
+  *         Send one transfer to a bulk OUT endpoint
+  * @param  pdev: device handle
+  * @param  ep_addr: endpoint address
+  * @param  pData: data
+  * @param  len: length of the transfer
+  * @retval len, HOST_STALL, HOST_NAK or HOST_OVERRUN
+  */
+int HOST_BulkOut(USBD_HandleTypeDef *pdev, uint8_t ep_addr, const uint8_t *pData, uint32_t len)
+{
+  HOST_EpTypeDef *ep = &EpOut[ep_addr & 0xFU];
+
+  if (ep->Stalled != 0U)
+  {
+    return HOST_STALL;
+  }
+
+  if ((ep->Open == 0U) || (ep->Armed == 0U))
+  {
+    return HOST_NAK;
+  }
+
+  if (len > ep->Length)
+  {
+    return HOST_OVERRUN;
+  }
+
+  (void)memcpy(ep->pBuf, pData, len);
+  ep->RxCount = len;
+  ep->Armed = 0U;
+
+  (void)USBD_LL_DataOutStage(pdev, ep_addr & 0xFU, ep->pBuf);
+
+  return (int)len;
+}
+
+/**
+  * @brief  HOST_BulkIn
+  *         Read one transfer from a bulk or interrupt IN endpoint
+  * @param  pdev: device handle
+  * @param  ep_addr: endpoint address
+  * @param  pData: host buffer
+  * @param  size: size of the host buffer
+  * @retval length of the transfer, HOST_STALL, HOST_NAK or HOST_OVERRUN
+  */
+int HOST_BulkIn(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pData, uint32_t size)
+{
+  HOST_EpTypeDef *ep = &EpIn[ep_addr & 0xFU];
+  uint32_t count = 0U;
+  uint32_t n;
+
+  for (;;)
+  {
+    if (ep->Stalled != 0U)
+    {
+      return HOST_STALL;
+    }
+
+    /* NAKed: nothing was sent yet, or the transfer was left without its
+       terminating short packet */
+    if ((ep->Open == 0U) || (ep->Armed == 0U))
+    {
+      return HOST_NAK;
+    }
+
+    n = ep->Length;
+    if ((count + n) > size)
+    {
+      return HOST_OVERRUN;
+    }
+
+    if (n != 0U)
+    {
+      (void)memcpy(&pData[count], ep->pBuf, n);
+    }
+    count += n;
+    ep->Armed = 0U;
+
+    (void)USBD_LL_DataInStage(pdev, ep_addr & 0xFU, (ep->pBuf != NULL) ? &ep->pBuf[n] : NULL);
+
+    if (((n % ep->MaxPacket) != 0U) || (n == 0U) || (count == size))
+    {
+      return (int)count;
+    }
+  }
+}
+
+/**
+  * @brief  HOST_IsoIn
+  *         Read the packet of the current frame from an isochronous IN endpoint
+  * @param  pdev: device handle
+  * @param  ep_addr: endpoint address
+  * @param  pData: host buffer
+  * @param  size: size of the host buffer
+  * @retval length of the packet, HOST_NAK if none was prepared or HOST_OVERRUN
+  */
+int HOST_IsoIn(USBD_HandleTypeDef *pdev, uint8_t ep_addr, uint8_t *pData, uint32_t size)
+{
+  HOST_EpTypeDef *ep = &EpIn[ep_addr & 0xFU];
+  uint32_t n;
+
+  if ((ep->Open == 0U) || (ep->Armed == 0U))
+  {
+    return HOST_NAK;
+  }
+
+  /* One packet per frame: a longer transfer does not fit the frame */
+  n = ep->Length;
+  if ((n > size) || (n > ep->MaxPacket))
+  {
+    return HOST_OVERRUN;
+  }
+
+  if (n != 0U)
+  {
+    (void)memcpy(pData, ep->pBuf, n);
+  }
+  ep->Armed = 0U;
+
+  (void)USBD_LL_DataInStage(pdev, ep_addr & 0xFU, (ep->pBuf != NULL) ? &ep->pBuf[n] : NULL);
+
+  return (int)n;
+}
+
+/**
+  * @brief  HOST_IsoInMissed
+  *         End a frame in which the host did not poll an isochronous IN
+  *         endpoint: a pending packet is reported incomplete, as the OTG
+  *         core does at the end of the frame
+  * @param  pdev: device handle
+  * @param  ep_addr: endpoint address
+  * @retval None
+  */
+void HOST_IsoInMissed(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  HOST_EpTypeDef *ep = &EpIn[ep_addr & 0xFU];
+
+  if ((ep->Open != 0U) && (ep->Armed != 0U))
+  {
+    (void)USBD_LL_IsoINIncomplete(pdev, ep_addr & 0xFU);
+  }
+}
+
+/**
+  * @brief  HOST_GetEp
+  *         Endpoint state, for the checks of the test
+  * @param  ep_addr: endpoint address
+  * @retval endpoint
+  */
+HOST_EpTypeDef *HOST_GetEp(uint8_t ep_addr)
+{
+  return ((ep_addr & 0x80U) != 0U) ? &EpIn[ep_addr & 0xFU] : &EpOut[ep_addr & 0xFU];
+}
+
+/**
+  * @brief  HOST_AllocatedBlocks
+  *         Number of class data blocks in use
+  * @param  None
+  * @retval count
+  */
+uint32_t HOST_AllocatedBlocks(void)
+{
+  uint32_t idx;
+  uint32_t count = 0U;
+
+  for (idx = 0U; idx < HOST_MEM_BLOCKS; idx++)
+  {
+    count += MemUsed[idx];
+  }
+
+  return count;
+}
+
+/*******************************************************************************
+                       LL Driver Interface (USB Device Library --> PCD)
+*******************************************************************************/
+
+/**
+  * @brief  Initializes the low level portion of the device driver.
+  * @param  pdev: Device handle
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_Init(USBD_HandleTypeDef *pdev)
+{
+  (void)memset(&hpcd, 0, sizeof(hpcd));
+  pdev->pData = &hpcd;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  De-Initializes the low level portion of the device driver.
+  * @param  pdev: Device handle
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_DeInit(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Starts the low level portion of the device driver.
+  * @param  pdev: Device handle
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_Start(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Stops the low level portion of the device driver.
+  * @param  pdev: Device handle
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_Stop(USBD_HandleTypeDef *pdev)
+{
+  UNUSED(pdev);
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Opens an endpoint of the low level driver.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @param  ep_type: Endpoint type
+  * @param  ep_mps: Endpoint max packet size
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_OpenEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                  uint8_t ep_type, uint16_t ep_mps)
+{
+  HOST_EpTypeDef *ep = HOST_GetEp(ep_addr);
+
+  UNUSED(pdev);
+
+  ep->Open = 1U;
+  ep->Armed = 0U;
+  ep->Stalled = 0U;
+  ep->Transfers = 0U;
+  ep->Rearmed = 0U;
+  ep->Type = ep_type;
+  ep->MaxPacket = ep_mps;
+
+  if ((ep_addr & 0x80U) != 0U)
+  {
+    hpcd.IN_ep[ep_addr & 0xFU].maxpacket = ep_mps;
+  }
+  else
+  {
+    hpcd.OUT_ep[ep_addr & 0xFU].maxpacket = ep_mps;
+  }
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Closes an endpoint of the low level driver.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_CloseEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  HOST_EpTypeDef *ep = HOST_GetEp(ep_addr);
+
+  UNUSED(pdev);
+
+  ep->Open = 0U;
+  ep->Armed = 0U;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Flushes an endpoint of the Low Level Driver.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_FlushEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+
+  HOST_GetEp(ep_addr)->Armed = 0U;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Sets a Stall condition on an endpoint of the Low Level Driver.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_StallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+
+  HOST_GetEp(ep_addr)->Stalled = 1U;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Clears a Stall condition on an endpoint of the Low Level Driver.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_ClearStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+
+  HOST_GetEp(ep_addr)->Stalled = 0U;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Returns Stall condition.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @retval Stall (1: Yes, 0: No)
+  */
+uint8_t USBD_LL_IsStallEP(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+
+  return HOST_GetEp(ep_addr)->Stalled;
+}
+
+/**
+  * @brief  Assigns a USB address to the device.
+  * @param  pdev: Device handle
+  * @param  dev_addr: USB address
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_SetUSBAddress(USBD_HandleTypeDef *pdev, uint8_t dev_addr)
+{
+  UNUSED(pdev);
+
+  DevAddress = dev_addr;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Transmits data over an endpoint.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @param  pbuf: Pointer to data to be sent
+  * @param  size: Data size
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_Transmit(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                    uint8_t *pbuf, uint32_t size)
+{
+  HOST_EpTypeDef *ep = &EpIn[ep_addr & 0xFU];
+
+  UNUSED(pdev);
+
+  if (ep->Armed != 0U)
+  {
+    ep->Rearmed++;
+  }
+
+  ep->pBuf = pbuf;
+  ep->Length = size;
+  ep->Armed = 1U;
+  ep->Transfers++;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Prepares an endpoint for reception.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @param  pbuf: Pointer to data to be received
+  * @param  size: Data size
+  * @retval USBD status
+  */
+USBD_StatusTypeDef USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, uint8_t ep_addr,
+                                          uint8_t *pbuf, uint32_t size)
+{
+  HOST_EpTypeDef *ep = &EpOut[ep_addr & 0xFU];
+
+  UNUSED(pdev);
+
+  ep->pBuf = pbuf;
+  ep->RxCount = 0U;
+  ep->Armed = 1U;
+  ep->Transfers++;
+
+  /* The OTG core programs one packet for a reception of 0 bytes */
+  ep->Length = ((size == 0U) && ((ep_addr & 0xFU) != 0U)) ? ep->MaxPacket : size;
+
+  return USBD_OK;
+}
+
+/**
+  * @brief  Returns the last transferred packet size.
+  * @param  pdev: Device handle
+  * @param  ep_addr: Endpoint number
+  * @retval Received Data Size
+  */
+uint32_t USBD_LL_GetRxDataSize(USBD_HandleTypeDef *pdev, uint8_t ep_addr)
+{
+  UNUSED(pdev);
+
+  return EpOut[ep_addr & 0xFU].RxCount;
+}
+
+/**
+  * @brief  Delays routine for the USB Device Library.
+  * @param  Delay: Delay in ms
+  * @retval None
+  */
+void USBD_LL_Delay(uint32_t Delay)
+{
+  UNUSED(Delay);
+}
+
+/**
+  * @brief  Static single allocation.
+  * @param  size: Size of allocated memory
+  * @retval a free class data block, NULL if none is left or it is too small
+  */
+void *USBD_static_malloc(uint32_t size)
+{
+  uint32_t idx;
+
+  for (idx = 0U; idx < HOST_MEM_BLOCKS; idx++)
+  {
+    if ((MemUsed[idx] == 0U) && (size <= HOST_MEM_BLOCK_SIZE))
+    {
+      MemUsed[idx] = 1U;
+      return MemBlock[idx];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+  * @brief  Static single free.
+  * @param  p: Pointer to allocated memory address
+  * @retval None
+  */
+void USBD_static_free(void *p)
+{
+  uint32_t idx;
+
+  for (idx = 0U; idx < HOST_MEM_BLOCKS; idx++)
+  {
+    if (p == (void *)MemBlock[idx])
+    {
+      MemUsed[idx] = 0U;
+    }
+  }
+}
@@ -0,0 +1,61 @@
+/**
+  ******************************************************************************
+  * @file    USB_Device/CDC_NCM_Standalone/Inc/lwipopts.h
+  * @brief   lwIP options: a NO_SYS stack answering ARP, ICMP echo and UDP
+  *          over the CDC NCM interface.
+  ******************************************************************************
+  * @attention
+  *
+  * Example of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __LWIPOPTS_H__
+#define __LWIPOPTS_H__
+
+/* No RTOS: lwIP runs from the main loop, next to USBD_CDC_NCM_fops.Process */
+#define NO_SYS                          1
+#define SYS_LIGHTWEIGHT_PROT            0
+#define LWIP_NETCONN                    0
+#define LWIP_SOCKET                     0
+
+/* The received datagrams stay in the OUT NTB buffers of the interface */
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
+#define ETH_PAD_SIZE                    0
+
+/* Memory options */
+#define MEM_ALIGNMENT                   4
+#define MEM_SIZE                        (10 * 1024)
+#define MEMP_NUM_PBUF                   16
+#define PBUF_POOL_SIZE                  8
+
+/* Protocols */
+#define LWIP_ARP                        1
+#define LWIP_ETHERNET                   1
+#define LWIP_ICMP                       1
+#define LWIP_RAW                        0
+#define LWIP_UDP                        1
+#define LWIP_TCP                        0
+#define LWIP_DHCP                       0
+#define LWIP_IPV6                       0
+
+#define LWIP_NETIF_LINK_CALLBACK        0
+#define LWIP_HAVE_LOOPIF                0
+
+#define LWIP_STATS                      0
+
+/* Checksums computed in software, the USB link does not offload them */
+#define CHECKSUM_GEN_IP                 1
+#define CHECKSUM_GEN_UDP                1
+#define CHECKSUM_GEN_ICMP               1
+#define CHECKSUM_CHECK_IP               1
+#define CHECKSUM_CHECK_UDP              1
+#define CHECKSUM_CHECK_ICMP             1
+
+#endif /* __LWIPOPTS_H__ */
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file    USB_Device/CDC_NCM_Standalone/Inc/main.h
+  * @brief   Header for main.c module
+  ******************************************************************************
+  * @attention
+  *
+  * Example of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __MAIN_H
+#define __MAIN_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal.h"
+
+/* Includes component */
+#include "stm32f4_discovery.h"
+
+/* USB Device includes component */
+#include "usbd_core.h"
+#include "usbd_desc.h"
+#include "usbd_cdc_ncm.h"
+#include "usbd_cdc_ncm_if_template.h"
+
+/* lwIP includes component */
+#include "lwip/init.h"
+#include "lwip/netif.h"
+#include "lwip/timeouts.h"
+#include "netif/ethernet.h"
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/* Address of the lwIP interface, the host side takes another address of the
+   same subnet (192.168.7.2 for instance) */
+#define IP_ADDR0   192U
+#define IP_ADDR1   168U
+#define IP_ADDR2   7U
+#define IP_ADDR3   1U
+
+#define NETMASK_ADDR0   255U
+#define NETMASK_ADDR1   255U
+#define NETMASK_ADDR2   255U
+#define NETMASK_ADDR3   0U
+
+#endif /* __MAIN_H */
@@ -0,0 +1,81 @@
+/**
+  ******************************************************************************
+  * @file    USB_Device/CDC_NCM_Standalone/Inc/usbd_conf.h
+  * @brief   General low level driver configuration
+  ******************************************************************************
+  * @attention
+  *
+  * Example of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __USBD_CONF_H
+#define __USBD_CONF_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Exported types ------------------------------------------------------------*/
+/* Exported constants --------------------------------------------------------*/
+/* Common Config */
+#define USBD_MAX_NUM_INTERFACES               2U
+#define USBD_MAX_NUM_CONFIGURATION            1U
+#define USBD_MAX_STR_DESC_SIZ                 0x100U
+#define USBD_SELF_POWERED                     1U
+#define USBD_DEBUG_LEVEL                      0U
+
+/* The class serves the MAC address string (iMACAddress) itself */
+#define USBD_SUPPORT_USER_STRING_DESC         1U
+
+/* Exported macro ------------------------------------------------------------*/
+/* Memory management macros: the class data is one static block */
+#define USBD_malloc               (void *)USBD_static_malloc
+#define USBD_free                 USBD_static_free
+#define USBD_memset               memset
+#define USBD_memcpy               memcpy
+#define USBD_Delay                HAL_Delay
+
+/* DEBUG macros */
+#if (USBD_DEBUG_LEVEL > 0U)
+#define  USBD_UsrLog(...)   do { \
+                              printf(__VA_ARGS__); \
+                              printf("\n"); \
+                            } while (0)
+#else
+#define USBD_UsrLog(...) do {} while (0)
+#endif /* (USBD_DEBUG_LEVEL > 0U) */
+
+#if (USBD_DEBUG_LEVEL > 1U)
+
+#define  USBD_ErrLog(...) do { \
+                            printf("ERROR: ") ; \
+                            printf(__VA_ARGS__); \
+                            printf("\n"); \
+                          } while (0)
+#else
+#define USBD_ErrLog(...) do {} while (0)
+#endif /* (USBD_DEBUG_LEVEL > 1U) */
+
+#if (USBD_DEBUG_LEVEL > 2U)
+#define  USBD_DbgLog(...)   do { \
+                              printf("DEBUG : ") ; \
+                              printf(__VA_ARGS__); \
+                              printf("\n"); \
+                            } while (0)
+#else
+#define USBD_DbgLog(...) do {} while (0)
+#endif /* (USBD_DEBUG_LEVEL > 2U) */
+
+/* Exported functions ------------------------------------------------------- */
+void *USBD_static_malloc(uint32_t size);
+void USBD_static_free(void *p);
+
+#endif /* __USBD_CONF_H */
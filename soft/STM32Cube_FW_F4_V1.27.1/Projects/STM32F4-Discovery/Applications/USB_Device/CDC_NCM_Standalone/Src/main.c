@@ -0,0 +1,232 @@
+/**
+  ******************************************************************************
+  * @file    USB_Device/CDC_NCM_Standalone/Src/main.c
+  * @brief   Main program body
+  *          This sample code shows how to use the CDC NCM class of the USB
+  *          device library with the lwIP stack: the board appears to the host
+  *          as a USB network adapter and answers ARP and ping.
+  ******************************************************************************
+  * @attention
+  *
+  * Example of this USB device library tree, not part of the
+  * STMicroelectronics release. It is provided under the same terms as the
+  * library: see the LICENSE file in the root directory of this software
+  * component. If no LICENSE file comes with this software, it is provided
+  * AS-IS.
+  *
+  ******************************************************************************
+  */
+/* Includes ------------------------------------------------------------------*/
+#include "main.h"
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private define ------------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+USBD_HandleTypeDef USBD_Device;  /* USB Device handle, used by the interface template */
+struct netif gnetif;             /* lwIP interface bound to the CDC NCM function */
+
+/* Private function prototypes -----------------------------------------------*/
+static void SystemClock_Config(void);
+static void Error_Handler(void);
+static void Netif_Config(void);
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+  * @brief  Main program
+  * @param  None
+  * @retval None
+  */
+int main(void)
+{
+  /* STM32F4xx HAL library initialization:
+       - Configure the Flash prefetch, instruction and Data caches
+       - Configure the Systick to generate an interrupt each 1 msec
+       - Set NVIC Group Priority to 4
+       - Global MSP (MCU Support Package) initialization
+     */
+  HAL_Init();
+
+  /* Configure LED4 and LED5 */
+  BSP_LED_Init(LED4);
+  BSP_LED_Init(LED5);
+
+  /* Configure the system clock to 168 MHz */
+  SystemClock_Config();
+
+  /*##-1- Initialize the lwIP stack and its interface ########################*/
+  lwip_init();
+  Netif_Config();
+
+  /*##-2- Init Device Library ################################################*/
+  if (USBD_Init(&USBD_Device, &NCM_Desc, 0) != USBD_OK)
+  {
+    Error_Handler();
+  }
+
+  /*##-3- Add Supported Class and its interface callbacks ####################*/
+  USBD_RegisterClass(&USBD_Device, USBD_CDC_NCM_CLASS);
+  USBD_CDC_NCM_RegisterInterface(&USBD_Device, &USBD_CDC_NCM_fops);
+
+  /*##-4- Start Device Process ###############################################*/
+  USBD_Start(&USBD_Device);
+
+  /*##-5- Run Application (Blocking mode) ####################################*/
+  while (1)
+  {
+    /* Pass the received NTBs to lwIP and send the pending IN NTB */
+    USBD_CDC_NCM_fops.Process(&USBD_Device);
+
+    /* lwIP timers (ARP cache, IP reassembly) */
+    sys_check_timeouts();
+
+    /* LED4 follows the link: on while the host has the data interface enabled */
+    if (netif_is_link_up(&gnetif))
+    {
+      BSP_LED_On(LED4);
+    }
+    else
+    {
+      BSP_LED_Off(LED4);
+    }
+  }
+}
+
+/**
+  * @brief  Adds the lwIP interface of the CDC NCM function
+  *         The link is brought up and down by the interface template, when
+  *         the host selects and leaves the data alternate setting.
+  * @param  None
+  * @retval None
+  */
+static void Netif_Config(void)
+{
+  ip4_addr_t ipaddr;
+  ip4_addr_t netmask;
+  ip4_addr_t gw;
+
+  IP4_ADDR(&ipaddr, IP_ADDR0, IP_ADDR1, IP_ADDR2, IP_ADDR3);
+  IP4_ADDR(&netmask, NETMASK_ADDR0, NETMASK_ADDR1, NETMASK_ADDR2, NETMASK_ADDR3);
+  IP4_ADDR(&gw, 0, 0, 0, 0);
+
+  if (netif_add(&gnetif, &ipaddr, &netmask, &gw, NULL, CDC_NCM_Itf_NetifInit, ethernet_input) == NULL)
+  {
+    Error_Handler();
+  }
+
+  netif_set_default(&gnetif);
+  netif_set_up(&gnetif);
+}
+
+/**
+  * @brief  Returns the current time in milliseconds, lwIP time base
+  * @param  None
+  * @retval Current time in milliseconds
+  */
+u32_t sys_now(void)
+{
+  return HAL_GetTick();
+}
+
+/**
+  * @brief  System Clock Configuration
+  *         The system Clock is configured as follow : 
+  *            System Clock source            = PLL (HSE)
+  *            SYSCLK(Hz)                     = 168000000
+  *            HCLK(Hz)                       = 168000000
+  *            AHB Prescaler                  = 1
+  *            APB1 Prescaler                 = 4
+  *            APB2 Prescaler                 = 2
+  *            HSE Frequency(Hz)              = 8000000
+  *            PLL_M                          = 8
+  *            PLL_N                          = 336
+  *            PLL_P                          = 2
+  *            PLL_Q                          = 7
+  *            VDD(V)                         = 3.3
+  *            Main regulator output voltage  = Scale1 mode
+  *            Flash Latency(WS)              = 5
+  *         PLL_Q gives the 48 MHz clock of the USB OTG FS core.
+  * @param  None
+  * @retval None
+  */
+static void SystemClock_Config(void)
+{
+  RCC_ClkInitTypeDef RCC_ClkInitStruct;
+  RCC_OscInitTypeDef RCC_OscInitStruct;
+
+  /* Enable Power Control clock */
+  __HAL_RCC_PWR_CLK_ENABLE();
+
+  /* The voltage scaling allows optimizing the power consumption when the device is 
+     clocked below the maximum system frequency, to update the voltage scaling value 
+     regarding system frequency refer to product datasheet.  */
+  __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
+
+  /* Enable HSE Oscillator and activate PLL with HSE as source */
+  RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+  RCC_OscInitStruct.HSEState = RCC_HSE_ON;
+  RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
+  RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
+  RCC_OscInitStruct.PLL.PLLM = 8;
+  RCC_OscInitStruct.PLL.PLLN = 336;
+  RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
+  RCC_OscInitStruct.PLL.PLLQ = 7;
+  if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* Select PLL as system clock source and configure the HCLK, PCLK1 and PCLK2 
+     clocks dividers */
+  RCC_ClkInitStruct.ClockType = (RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2);
+  RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+  RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
+  RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;
+  RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;
+  if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_5) != HAL_OK)
+  {
+    Error_Handler();
+  }
+
+  /* STM32F405x/407x/415x/417x Revision Z devices: prefetch is supported  */
+  if (HAL_GetREVID() == 0x1001)
+  {
+    /* Enable the Flash prefetch */
+    __HAL_FLASH_PREFETCH_BUFFER_ENABLE();
+  }
+}
+
+/**
+  * @brief  This function is executed in case of error occurrence.
+  * @param  None
+  * @retval None
+  */
+static void Error_Handler(void)
+{
+  /* Turn LED5 on */
+  BSP_LED_On(LED5);
+  while (1)
+  {
+  }
+}
+
+#ifdef  USE_FULL_ASSERT
+/**
+  * @brief  Reports the name of the source file and the source line number
+  *         where the assert_param error has occurred.
+  * @param  file: pointer to the source file name
+  * @param  line: assert_param error line source number
+  * @retval None
+  */
+void assert_failed(uint8_t* file, uint32_t line)
+{ 
+  /* User can add his own implementation to report the file name and line number,
+     ex: printf("Wrong parameters value: file %s on line %d\r\n", file, line) */
+
+  /* Infinite loop */
+  while (1)
+  {
+  }
+}
+#endif
@@ -0,0 +1,494 @@
+/**
+  ******************************************************************************
+  * @file    USB_Device/CDC_NCM_Standalone/Src/usbd_conf.c
+  * @brief   This file implements the USB Device library callbacks and MSP,
+  *          adapted from the Demonstrations project of this board.
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2017 STMicroelectronics.
+  * All rights reserved.
+  *
+  * This software is licensed under terms that can be found in the LICENSE file
+  * in the root directory of this software component.
+  * If no LICENSE file comes with this software, it is provided AS-IS.
+  *
+  ******************************************************************************
+  */
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f4xx_hal.h"
+#include "usbd_core.h"
+#include "usbd_cdc_ncm.h"
+
+PCD_HandleTypeDef hpcd;
+
+/*******************************************************************************
+                       PCD BSP Routines
+*******************************************************************************/
+/**
+  * @brief  Initializes the PCD MSP.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_MspInit(PCD_HandleTypeDef *hpcd)
+{
+  /* Note: On STM32F4-Discovery board only USB OTG FS core is supported. */
+  GPIO_InitTypeDef  GPIO_InitStruct;
+  
+  if(hpcd->Instance == USB_OTG_FS)
+  {
+    /* Configure USB FS GPIOs */
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    
+    /* Configure DM DP Pins */
+    GPIO_InitStruct.Pin = GPIO_PIN_11 | GPIO_PIN_12;
+    GPIO_InitStruct.Speed = GPIO_SPEED_HIGH;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    GPIO_InitStruct.Alternate = GPIO_AF10_OTG_FS;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct); 
+    
+	/* Configure VBUS Pin */
+    GPIO_InitStruct.Pin = GPIO_PIN_9;
+    GPIO_InitStruct.Mode = GPIO_MODE_INPUT;
+    GPIO_InitStruct.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);
+    
+    /* This for ID line debug */
+    GPIO_InitStruct.Pin = GPIO_PIN_10;
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+    GPIO_InitStruct.Pull = GPIO_PULLUP;
+    GPIO_InitStruct.Speed = GPIO_SPEED_HIGH;
+    GPIO_InitStruct.Alternate = GPIO_AF10_OTG_FS;
+    HAL_GPIO_Init(GPIOA, &GPIO_InitStruct); 
+    
+    /* Enable USB FS Clocks */ 
+    __HAL_RCC_USB_OTG_FS_CLK_ENABLE();
+    
+    /* Set USBFS Interrupt to the lowest priority */
+    HAL_NVIC_SetPriority(OTG_FS_IRQn, 3, 0);
+    
+    /* Enable USBFS Interrupt */
+    HAL_NVIC_EnableIRQ(OTG_FS_IRQn);
+  } 
+}
+
+/**
+  * @brief  DeInitializes the PCD MSP.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_MspDeInit(PCD_HandleTypeDef *hpcd)
+{
+  if(hpcd->Instance == USB_OTG_FS)
+  {  
+    /* Disable USB FS Clocks */ 
+    __HAL_RCC_USB_OTG_FS_CLK_DISABLE();
+  }
+}
+
+/*******************************************************************************
+                       LL Driver Callbacks (PCD -> USB Device Library)
+*******************************************************************************/
+
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd)
+{
+  USBD_LL_SetupStage(hpcd->pData, (uint8_t *)hpcd->Setup);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  USBD_LL_DataOutStage(hpcd->pData, epnum, hpcd->OUT_ep[epnum].xfer_buff);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  USBD_LL_DataInStage(hpcd->pData, epnum, hpcd->IN_ep[epnum].xfer_buff);
+} 
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_SOFCallback(PCD_HandleTypeDef *hpcd)
+{
+  USBD_LL_SOF(hpcd->pData);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd)
+{ 
+  USBD_SpeedTypeDef speed = USBD_SPEED_FULL;
+
+  /*Set USB Current Speed*/
+  switch (hpcd->Init.speed)
+  {
+  case PCD_SPEED_HIGH:
+    speed = USBD_SPEED_HIGH;
+    break;
+    
+  case PCD_SPEED_FULL:
+    speed = USBD_SPEED_FULL;    
+    break;
+    
+  default:
+    speed = USBD_SPEED_FULL;
+    break;
+  }
+  USBD_LL_SetSpeed(hpcd->pData, speed);  
+  
+  /*Reset Device*/
+  USBD_LL_Reset(hpcd->pData);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_SuspendCallback(PCD_HandleTypeDef *hpcd)
+{
+  USBD_LL_Suspend(hpcd->pData);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_ResumeCallback(PCD_HandleTypeDef *hpcd)
+{
+  USBD_LL_Resume(hpcd->pData);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_ISOOUTIncompleteCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  USBD_LL_IsoOUTIncomplete(hpcd->pData, epnum);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_ISOINIncompleteCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum)
+{
+  USBD_LL_IsoINIncomplete(hpcd->pData, epnum);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_ConnectCallback(PCD_HandleTypeDef *hpcd)
+{
+  USBD_LL_DevConnected(hpcd->pData);
+}
+
+/**
+  * @brief  SOF callback.
+  * @param  hpcd: PCD handle
+  * @retval None
+  */
+void HAL_PCD_DisconnectCallback(PCD_HandleTypeDef *hpcd)
+{
+  USBD_LL_DevDisconnected(hpcd->pData);
+}
+
+/*******************************************************************************
+                       LL Driver Interface (USB Device Library --> PCD)
+*******************************************************************************/
+/**
+  * @brief  USBD_LL_Init 
+  *         Initialize the Low Level portion of the Device driver.
+  * @param  pdev: Device handle
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_Init (USBD_HandleTypeDef *pdev)
+{
+   /* Change Systick prioity */
+  NVIC_SetPriority (SysTick_IRQn, 0);  
+  
+  /*Set LL Driver parameters */
+  hpcd.Instance = USB_OTG_FS;
+  hpcd.Init.dev_endpoints = 4; 
+  hpcd.Init.use_dedicated_ep1 = 0;  
+  hpcd.Init.dma_enable = 0;
+  hpcd.Init.low_power_enable = 0;
+  hpcd.Init.phy_itface = PCD_PHY_EMBEDDED; 
+  hpcd.Init.Sof_enable = 0;
+  hpcd.Init.speed = PCD_SPEED_FULL;
+  hpcd.Init.vbus_sensing_enable = 1;
+  /* Link The driver to the stack */
+   hpcd.pData = pdev;
+  pdev->pData = &hpcd;
+  /*Initialize LL Driver */
+  HAL_PCD_Init(&hpcd);
+  
+  /* 320 words of FIFO: OUT packets, EP0 IN, the NTB IN endpoint (EP1)
+     and the notification endpoint (EP2) */
+  HAL_PCDEx_SetRxFiFo(&hpcd, 0x80);
+  HAL_PCDEx_SetTxFiFo(&hpcd, 0, 0x40);
+  HAL_PCDEx_SetTxFiFo(&hpcd, 1, 0x60);
+  HAL_PCDEx_SetTxFiFo(&hpcd, 2, 0x20);
+ 
+  return USBD_OK;
+}
+
+/**
+  * @brief  USBD_LL_DeInit 
+  *         De-Initialize the Low Level portion of the Device driver.
+  * @param  pdev: Device handle
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_DeInit (USBD_HandleTypeDef *pdev)
+{
+  HAL_PCD_DeInit(pdev->pData);
+  return USBD_OK; 
+}
+
+/**
+  * @brief  USBD_LL_Start 
+  *         Start the Low Level portion of the Device driver.
+  * @param  pdev: Device handle
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_Start(USBD_HandleTypeDef *pdev)
+{
+  HAL_PCD_Start(pdev->pData);
+  return USBD_OK; 
+}
+
+/**
+  * @brief  USBD_LL_Stop 
+  *         Stop the Low Level portion of the Device driver.
+  * @param  pdev: Device handle
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_Stop (USBD_HandleTypeDef *pdev)
+{
+  HAL_PCD_Stop(pdev->pData);
+  return USBD_OK; 
+}
+
+/**
+  * @brief  USBD_LL_OpenEP 
+  *         Open an endpoint of the Low Level Driver.
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number
+  * @param  ep_type: Endpoint Type
+  * @param  ep_mps: Endpoint Max Packet Size                 
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_OpenEP  (USBD_HandleTypeDef *pdev, 
+                                      uint8_t  ep_addr,                                      
+                                      uint8_t  ep_type,
+                                      uint16_t ep_mps)
+{
+    
+  HAL_PCD_EP_Open(pdev->pData, 
+                  ep_addr, 
+                  ep_mps, 
+                  ep_type);
+    
+  return USBD_OK; 
+}
+
+/**
+  * @brief  USBD_LL_CloseEP 
+  *         Close an endpoint of the Low Level Driver.
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number      
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_CloseEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)   
+{
+  HAL_PCD_EP_Close(pdev->pData, ep_addr);
+  return USBD_OK; 
+}
+
+/**
+  * @brief  USBD_LL_FlushEP 
+  *         Flush an endpoint of the Low Level Driver.
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number      
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_FlushEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)   
+{
+  HAL_PCD_EP_Flush(pdev->pData, ep_addr);
+  return USBD_OK; 
+}
+
+/**
+  * @brief  USBD_LL_StallEP 
+  *         Set a Stall condition on an endpoint of the Low Level Driver.
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number      
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_StallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)   
+{
+  HAL_PCD_EP_SetStall(pdev->pData, ep_addr);
+  return USBD_OK; 
+}
+
+/**
+  * @brief  USBD_LL_ClearStallEP 
+  *         Clear a Stall condition on an endpoint of the Low Level Driver.
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number      
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_ClearStallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)   
+{
+  HAL_PCD_EP_ClrStall(pdev->pData, ep_addr);  
+  return USBD_OK; 
+}
+
+/**
+  * @brief  USBD_LL_IsStallEP 
+  *         Return Stall condition.
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number      
+* @retval Stall (1: yes, 0: No)
+  */
+uint8_t USBD_LL_IsStallEP (USBD_HandleTypeDef *pdev, uint8_t ep_addr)   
+{
+  PCD_HandleTypeDef *hpcd = pdev->pData; 
+  
+  if((ep_addr & 0x80) == 0x80)
+  {
+    return hpcd->IN_ep[ep_addr & 0x7F].is_stall; 
+  }
+  else
+  {
+    return hpcd->OUT_ep[ep_addr & 0x7F].is_stall; 
+  }
+}
+/**
+  * @brief  USBD_LL_SetDevAddress 
+  *         Assign an USB address to the device
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number      
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_SetUSBAddress (USBD_HandleTypeDef *pdev, uint8_t dev_addr)   
+{
+  HAL_PCD_SetAddress(pdev->pData, dev_addr);
+  return USBD_OK; 
+  }
+
+/**
+  * @brief  USBD_LL_Transmit 
+  *         Transmit data over an endpoint
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number
+  * @param  pbuf:pointer to data to be sent    
+  * @param  size: data size    
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_Transmit (USBD_HandleTypeDef *pdev, 
+                                      uint8_t  ep_addr,                                      
+                                      uint8_t  *pbuf,
+                                      uint32_t  size)
+  {
+  HAL_PCD_EP_Transmit(pdev->pData, ep_addr, pbuf, size);
+  return USBD_OK;   
+}
+
+/**
+  * @brief  USBD_LL_PrepareReceive 
+  *         prepare an endpoint for reception
+  * @param  pdev: device handle
+  * @param  ep_addr: Endpoint Number
+  * @param  pbuf:pointer to data to be received    
+  * @param  size: data size              
+  * @retval USBD Status
+  */
+USBD_StatusTypeDef  USBD_LL_PrepareReceive(USBD_HandleTypeDef *pdev, 
+                                           uint8_t  ep_addr,                                      
+                                           uint8_t  *pbuf,
+                                           uint32_t  size)
+{
+  
+  HAL_PCD_EP_Receive(pdev->pData, ep_addr, pbuf, size);
+  return USBD_OK;   
+  }
+
+/**
+  * @brief  USBD_LL_GetRxDataSize 
+  *         Return the last transferred packet size.
+  * @param  phost: Device handle
+  * @param  ep_addr: Endpoint Number
+  * @retval Received Data Size
+  */
+uint32_t USBD_LL_GetRxDataSize  (USBD_HandleTypeDef *pdev, uint8_t  ep_addr)  
+  {
+  return HAL_PCD_EP_GetRxCount(pdev->pData, ep_addr);
+}
+
+/**
+  * @brief  USBD_LL_Delay 
+  *         Delay routine for the USB Device Library
+  * @param  Delay: Delay in ms
+  * @retval None
+  */
+void  USBD_LL_Delay (uint32_t Delay)
+{
+  HAL_Delay(Delay);  
+}
+
+/**
+  * @brief  Static single allocation.
+  * @param  size: Size of allocated memory
+  * @retval Pointer to the class data block, NULL if it is too small
+  */
+void *USBD_static_malloc(uint32_t size)
+{
+  static uint32_t mem[(sizeof(USBD_CDC_NCM_HandleTypeDef) / 4U) + 1U]; /* On 32-bit boundary */
+
+  if (size > sizeof(mem))
+  {
+    return NULL;
+  }
+  return mem;
+}
+
+/**
+  * @brief  Dummy memory free
+  * @param  p: Pointer to allocated  memory address
+  * @retval None
+  */
+void USBD_static_free(void *p)
+{
+  UNUSED(p);
+}